@@ -130,6 +130,7 @@ bool WiiAudioDevice::initHardware(IOService *provider) {
     return kIOReturnNoResources;
   }
   workLoop->addEventSource(_interruptEventSource);
+  applyInterruptAffinity(this, _dspDevice, 0);
 
   //
   // Create audio engines for outputs.
@@ -28,23 +28,7 @@
  */
 
 #include "WiiAudioEngine.hpp"
-
-#define kMaxSInt16ValueInFloat           (3.2768000000000e4)
-#define kMaxFloatMinusLSBSInt32          (0.99999999953434)
-#define kMaxFloatMinusLSBSInt16          (0.99996948242188)
-#define kMaxFloatMinusLSBSInt8           (0.9921259843)
-#define kMinusOne                        (-1.0)
-
-#define ClipFloatValue(x)                \
-do {                                     \
-    if ((x) > kMaxFloatMinusLSBSInt16)   \
-        (x) = kMaxFloatMinusLSBSInt16;   \
-    else if ((x) < kMinusOne)            \
-        (x) = kMinusOne;                 \
-} while(0)
-
-#define ConvertFloatToSInt16(x)          \
-	((SInt16)((x) * kMaxSInt16ValueInFloat))
+#include "WiiPairedSingle.hpp"
 
 //
 // Overrides IOAudioEngine::clipOutputSamples().
@@ -56,13 +40,10 @@ IOReturn WiiAudioEngine::clipOutputSamples(const void *mixBuf, void *sampleBuf,
   float   *inFloatBufferPtr;
   SInt16  *outSInt16BufferPtr;
   UInt32  numSamples;
-  float   adjustment;
 
   numSamples         = numSampleFrames * streamFormat->fNumChannels;
   inFloatBufferPtr   = (float *) mixBuf + firstSampleFrame * streamFormat->fNumChannels;
   outSInt16BufferPtr = (SInt16 *) sampleBuf + firstSampleFrame * streamFormat->fNumChannels;
-  inFloatBufferPtr--;
-  outSInt16BufferPtr--;
 
   //
   // If we are muted, just zero out the sample buffer.
@@ -73,34 +54,8 @@ IOReturn WiiAudioEngine::clipOutputSamples(const void *mixBuf, void *sampleBuf,
   }
 
   //
-  // Clip/convert samples with volume adjustment.
+  // Clip/convert samples with volume adjustment, two at a time with paired-single quantized stores.
   //
-  adjustment = _logTable[_currentVolume];
-  for (UInt32 i = 0; i < (numSamples / 4); i++) {
-    float tempFloat1 = *(++inFloatBufferPtr) * adjustment;
-    float tempFloat2 = *(++inFloatBufferPtr) * adjustment;
-    float tempFloat3 = *(++inFloatBufferPtr) * adjustment;
-    float tempFloat4 = *(++inFloatBufferPtr) * adjustment;
-
-    ClipFloatValue(tempFloat1);
-    ClipFloatValue(tempFloat2);
-    ClipFloatValue(tempFloat3);
-    ClipFloatValue(tempFloat4);
-
-    *(++outSInt16BufferPtr) = ConvertFloatToSInt16(tempFloat1);
-    *(++outSInt16BufferPtr) = ConvertFloatToSInt16(tempFloat2);
-    *(++outSInt16BufferPtr) = ConvertFloatToSInt16(tempFloat3);
-    *(++outSInt16BufferPtr) = ConvertFloatToSInt16(tempFloat4);
-  }
-
-  //
-  // Clip/convert any remaining samples.
-  //
-  for (UInt32 i = 0; i < (numSamples % 4); i++) {
-    float tempFloat = *(++inFloatBufferPtr) * adjustment;
-    ClipFloatValue(tempFloat);
-    *(++outSInt16BufferPtr) = ConvertFloatToSInt16(tempFloat);
-  }
-
+  convertFloatToSInt16(inFloatBufferPtr, outSInt16BufferPtr, numSamples, _logTable[_currentVolume]);
   return kIOReturnSuccess;
 }
@@ -0,0 +1,56 @@
+//
+//  CryptoRegs.hpp
+//  Wii AES and SHA-1 engine registers
+//
+// See https://wiibrew.org/wiki/Hardware/AES_Engine and https://wiibrew.org/wiki/Hardware/SHA-1_Engine.
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef CryptoRegs_hpp
+#define CryptoRegs_hpp
+
+//
+// AES engine registers.
+// Key and IV are FIFOs, written one word at a time.
+//
+#define kWiiAESRegControl           0x00
+#define kWiiAESRegSource            0x04
+#define kWiiAESRegDest              0x08
+#define kWiiAESRegKey               0x0C
+#define kWiiAESRegIV                0x10
+
+#define kWiiAESControlExecute       BIT31
+#define kWiiAESControlIRQ           BIT30
+#define kWiiAESControlError         BIT29
+#define kWiiAESControlEnable        BIT28
+#define kWiiAESControlDecrypt       BIT27
+// Continue from the IV left by the previous operation instead of the IV FIFO.
+#define kWiiAESControlChainIV       BIT12
+#define kWiiAESControlBlocksMask    BITRange(0, 11)
+#define kWiiAESMaxBlocks            4096
+
+//
+// SHA-1 engine registers.
+// Hash state is read and written through the H registers and carries over between operations.
+//
+#define kWiiSHARegControl           0x00
+#define kWiiSHARegSource            0x04
+#define kWiiSHARegH0                0x08
+#define kWiiSHARegH1                0x0C
+#define kWiiSHARegH2                0x10
+#define kWiiSHARegH3                0x14
+#define kWiiSHARegH4                0x18
+
+#define kWiiSHAControlExecute       BIT31
+#define kWiiSHAControlIRQ           BIT30
+#define kWiiSHAControlError         BIT29
+#define kWiiSHAControlBlocksMask    BITRange(0, 9)
+#define kWiiSHAMaxBlocks            1024
+
+//
+// Engine sources and destinations must be 16 byte aligned physical addresses.
+//
+#define kWiiCryptoDMAAlignment      16
+
+#endif
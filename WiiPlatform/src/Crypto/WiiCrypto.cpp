@@ -0,0 +1,825 @@
+//
+//  WiiCrypto.cpp
+//  Wii AES and SHA-1 engines
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "WiiCrypto.hpp"
+#include "WiiHollywood.hpp"
+
+OSDefineMetaClassAndStructors(WiiCrypto, super);
+
+//
+// There is only one set of engines, the service functions are routed to its driver.
+//
+static WiiCrypto        *gWiiCrypto;
+static WiiCryptoService gCryptoService;
+
+static const UInt32 gSHA1InitialH[5] = {
+  0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+};
+
+//
+// Overrides IOService::init().
+//
+bool WiiCrypto::init(OSDictionary *dictionary) {
+  WiiCheckDebugArgs();
+
+  _workLoop             = NULL;
+  _commandGate          = NULL;
+  _invalidateCacheFunc  = NULL;
+  _mem2Service          = NULL;
+  _mem2Client           = NULL;
+
+  _aesMemoryMap             = NULL;
+  _aesBaseAddr              = NULL;
+  _aesInterruptEventSource  = NULL;
+  _aesBusy                  = false;
+  bzero(&_aesWait, sizeof (_aesWait));
+  _aesSrcBuffer             = NULL;
+  _aesSrcPhysAddr           = 0;
+  _aesDestBuffer            = NULL;
+  _aesDestPhysAddr          = 0;
+
+  _shaDevice                = NULL;
+  _shaMemoryMap             = NULL;
+  _shaBaseAddr              = NULL;
+  _shaInterruptEventSource  = NULL;
+  _shaBusy                  = false;
+  bzero(&_shaWait, sizeof (_shaWait));
+  _shaBuffer                = NULL;
+  _shaPhysAddr              = 0;
+
+  _waitGeneration           = 0;
+
+  return super::init(dictionary);
+}
+
+//
+// Overrides IOService::free().
+//
+void WiiCrypto::free(void) {
+  if (gWiiCrypto == this) {
+    gWiiCrypto = NULL;
+  }
+
+  if (_aesInterruptEventSource != NULL) {
+    _aesInterruptEventSource->disable();
+    _workLoop->removeEventSource(_aesInterruptEventSource);
+    OSSafeReleaseNULL(_aesInterruptEventSource);
+  }
+  if (_shaInterruptEventSource != NULL) {
+    _shaInterruptEventSource->disable();
+    _workLoop->removeEventSource(_shaInterruptEventSource);
+    OSSafeReleaseNULL(_shaInterruptEventSource);
+  }
+  if (_aesWait.timeoutThreadCall != NULL) {
+    thread_call_cancel(_aesWait.timeoutThreadCall);
+    thread_call_free(_aesWait.timeoutThreadCall);
+    _aesWait.timeoutThreadCall = NULL;
+  }
+  if (_shaWait.timeoutThreadCall != NULL) {
+    thread_call_cancel(_shaWait.timeoutThreadCall);
+    thread_call_free(_shaWait.timeoutThreadCall);
+    _shaWait.timeoutThreadCall = NULL;
+  }
+  if (_commandGate != NULL) {
+    _workLoop->removeEventSource(_commandGate);
+    OSSafeReleaseNULL(_commandGate);
+  }
+  OSSafeReleaseNULL(_workLoop);
+
+  freeBuffer(_aesSrcBuffer, _aesSrcPhysAddr);
+  freeBuffer(_aesDestBuffer, _aesDestPhysAddr);
+  freeBuffer(_shaBuffer, _shaPhysAddr);
+  if (_mem2Client != NULL) {
+    _mem2Service->destroyClient(_mem2Client);
+    _mem2Client = NULL;
+  }
+
+  OSSafeReleaseNULL(_aesMemoryMap);
+  OSSafeReleaseNULL(_shaMemoryMap);
+  OSSafeReleaseNULL(_shaDevice);
+
+  super::free();
+}
+
+//
+// Overrides IOService::start().
+//
+bool WiiCrypto::start(IOService *provider) {
+  const OSSymbol  *functionSymbol;
+  IOReturn        status;
+  UInt32          ahbProtect;
+  mach_timespec_t t;
+
+  if (!super::start(provider)) {
+    WIISYSLOG("super::start() returned false");
+    return false;
+  }
+
+  //
+  // Get cache invalidation function.
+  //
+  functionSymbol = OSSymbol::withCString(kWiiFuncPlatformGetInvalidateCache);
+  if (functionSymbol == NULL) {
+    return false;
+  }
+  status = getPlatform()->callPlatformFunction(functionSymbol, false, &_invalidateCacheFunc, 0, 0, 0);
+  functionSymbol->release();
+  if (status != kIOReturnSuccess) {
+    WIISYSLOG("Failed to get cache invalidation function");
+    return false;
+  }
+
+  _workLoop = IOWorkLoop::workLoop();
+  if (_workLoop == NULL) {
+    WIISYSLOG("Failed to create work loop");
+    return false;
+  }
+
+  _commandGate = IOCommandGate::commandGate(this);
+  if (_commandGate == NULL) {
+    WIISYSLOG("Failed to create command gate");
+    return false;
+  }
+  _workLoop->addEventSource(_commandGate);
+  _commandGate->enable();
+
+  _aesWait.timeoutThreadCall = thread_call_allocate(handleEngineTimeout, this);
+  _shaWait.timeoutThreadCall = thread_call_allocate(handleEngineTimeout, this);
+  if ((_aesWait.timeoutThreadCall == NULL) || (_shaWait.timeoutThreadCall == NULL)) {
+    WIISYSLOG("Failed to allocate engine timeout thread calls");
+    return false;
+  }
+
+  //
+  // Engines are only used if Broadway has been given access to them and there is MEM2 for bounce buffers.
+  // The Wii U engines belong to Starbuck.
+  //
+  if (!checkPlatformCafe()) {
+    ahbProtect = readAHBProtect();
+    WIIDBGLOG("AHB protection: 0x%X", ahbProtect);
+
+    functionSymbol = OSSymbol::withCString(kWiiFuncPlatformGetMem2Service);
+    if (functionSymbol == NULL) {
+      return false;
+    }
+    status = getPlatform()->callPlatformFunction(functionSymbol, false, &_mem2Service, 0, 0, 0);
+    functionSymbol->release();
+    if (status == kIOReturnSuccess) {
+      _mem2Client = _mem2Service->createClient(getName(), kWiiCryptoMem2Quota);
+    }
+    if (_mem2Client == NULL) {
+      WIISYSLOG("MEM2 is not available, engines will not be used");
+      ahbProtect = 0;
+    }
+
+    //
+    // Map AES engine.
+    //
+    if (ahbProtect & kWiiHollywoodAHBProtectBroadwayAES) {
+      _aesMemoryMap = provider->mapDeviceMemoryWithIndex(0);
+      if (_aesMemoryMap == NULL) {
+        WIISYSLOG("Failed to map AES memory");
+        return false;
+      }
+      _aesBaseAddr = (volatile void *)_aesMemoryMap->getVirtualAddress();
+      WIIDBGLOG("Mapped AES registers to %p (physical 0x%X), length: 0x%X", _aesBaseAddr,
+        _aesMemoryMap->getPhysicalAddress(), _aesMemoryMap->getLength());
+
+      _aesInterruptEventSource = createInterruptEventSource(provider,
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+        OSMemberFunctionCast(IOInterruptEventSource::Action, this, &WiiCrypto::handleAESInterrupt));
+#else
+        (IOInterruptEventSource::Action) &WiiCrypto::handleAESInterrupt);
+#endif
+      writeAESReg32(kWiiAESRegControl, 0);
+    }
+
+    //
+    // Map SHA-1 engine, this is a separate device.
+    //
+    if (ahbProtect & kWiiHollywoodAHBProtectBroadwaySHA1) {
+      t.tv_sec  = kWiiCryptoSHAWaitSecs;
+      t.tv_nsec = 0;
+      _shaDevice = waitForService(nameMatching("NTDOY,sha"), &t);
+      if (_shaDevice != NULL) {
+        _shaDevice->retain();
+
+        _shaMemoryMap = _shaDevice->mapDeviceMemoryWithIndex(0);
+        if (_shaMemoryMap == NULL) {
+          WIISYSLOG("Failed to map SHA-1 memory");
+          return false;
+        }
+        _shaBaseAddr = (volatile void *)_shaMemoryMap->getVirtualAddress();
+        WIIDBGLOG("Mapped SHA-1 registers to %p (physical 0x%X), length: 0x%X", _shaBaseAddr,
+          _shaMemoryMap->getPhysicalAddress(), _shaMemoryMap->getLength());
+
+        _shaInterruptEventSource = createInterruptEventSource(_shaDevice,
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+          OSMemberFunctionCast(IOInterruptEventSource::Action, this, &WiiCrypto::handleSHAInterrupt));
+#else
+          (IOInterruptEventSource::Action) &WiiCrypto::handleSHAInterrupt);
+#endif
+        writeSHAReg32(kWiiSHARegControl, 0);
+      } else {
+        WIISYSLOG("SHA-1 engine did not show up");
+      }
+    }
+  }
+
+  //
+  // Allocate bounce buffers, these are also used for software requests.
+  //
+  _aesSrcBuffer  = allocateBuffer(&_aesSrcPhysAddr);
+  _aesDestBuffer = allocateBuffer(&_aesDestPhysAddr);
+  _shaBuffer     = allocateBuffer(&_shaPhysAddr);
+  if ((_aesSrcBuffer == NULL) || (_aesDestBuffer == NULL) || (_shaBuffer == NULL)) {
+    WIISYSLOG("Failed to allocate buffers");
+    return false;
+  }
+
+  WIISYSLOG("AES engine: %s, SHA-1 engine: %s",
+    (_aesBaseAddr != NULL) ? ((_aesInterruptEventSource != NULL) ? "interrupt" : "polled") : "software",
+    (_shaBaseAddr != NULL) ? ((_shaInterruptEventSource != NULL) ? "interrupt" : "polled") : "software");
+
+  gCryptoService.aesCBC     = &WiiCrypto::serviceAESCBC;
+  gCryptoService.sha1Init   = &WiiCrypto::serviceSHA1Init;
+  gCryptoService.sha1Update = &WiiCrypto::serviceSHA1Update;
+  gCryptoService.sha1Final  = &WiiCrypto::serviceSHA1Final;
+  gWiiCrypto                = this;
+
+  registerService();
+  return true;
+}
+
+//
+// Overrides IOService::callPlatformFunction().
+//
+IOReturn WiiCrypto::callPlatformFunction(const OSSymbol *functionName, bool waitForFunction,
+                                         void *param1, void *param2, void *param3, void *param4) {
+  if (functionName->isEqualTo(kWiiFuncCryptoGetService)) {
+    *((const WiiCryptoService**) param1) = &gCryptoService;
+    return kIOReturnSuccess;
+  }
+
+  return super::callPlatformFunction(functionName, waitForFunction, param1, param2, param3, param4);
+}
+
+//
+// Reads the Hollywood AHB protection register, which controls which devices Broadway can access.
+//
+UInt32 WiiCrypto::readAHBProtect(void) {
+  IOMemoryDescriptor  *desc;
+  IOMemoryMap         *map;
+  UInt32              value;
+
+  value = 0;
+  desc  = IOMemoryDescriptor::withPhysicalAddress(kWiiHollywoodBaseAddress, kWiiHollywoodBaseLength, kIODirectionInOut);
+  if (desc != NULL) {
+    map = desc->map(kIOMapInhibitCache);
+    if (map != NULL) {
+      value = OSReadBigInt32((volatile void *) map->getVirtualAddress(), kWiiHollywoodAHBProtect);
+      map->release();
+    }
+    desc->release();
+  }
+
+  return value;
+}
+
+//
+// Creates the interrupt event source for an engine. Engines without an interrupt are polled.
+//
+IOInterruptEventSource *WiiCrypto::createInterruptEventSource(IOService *provider, IOInterruptEventSource::Action action) {
+  IOInterruptEventSource *intEventSource;
+
+  if (provider->getProperty(gIOInterruptSpecifiersKey) == NULL) {
+    return NULL;
+  }
+
+  intEventSource = IOInterruptEventSource::interruptEventSource(this, action, provider, 0);
+  if (intEventSource == NULL) {
+    WIISYSLOG("Failed to create interrupt for %s", provider->getName());
+    return NULL;
+  }
+  _workLoop->addEventSource(intEventSource);
+  applyInterruptAffinity(this, provider, 0);
+  intEventSource->enable();
+
+  return intEventSource;
+}
+
+//
+// Allocates a chunk buffer, from MEM2 if engines may use it.
+//
+UInt8 *WiiCrypto::allocateBuffer(IOPhysicalAddress *physAddr) {
+  void *buffer;
+
+  if (_mem2Client != NULL) {
+    if (_mem2Service->allocate(_mem2Client, kWiiCryptoChunkSize, kWiiMem2CacheModeCopyback, physAddr, &buffer) != kIOReturnSuccess) {
+      return NULL;
+    }
+  } else {
+    buffer    = IOMallocAligned(kWiiCryptoChunkSize, PAGE_SIZE);
+    *physAddr = 0;
+  }
+
+  return (UInt8 *) buffer;
+}
+
+//
+// Frees a chunk buffer.
+//
+void WiiCrypto::freeBuffer(UInt8 *buffer, IOPhysicalAddress physAddr) {
+  if (buffer == NULL) {
+    return;
+  }
+
+  if (_mem2Client != NULL) {
+    _mem2Service->deallocate(_mem2Client, physAddr);
+  } else {
+    IOFreeAligned(buffer, kWiiCryptoChunkSize);
+  }
+}
+
+//
+// Takes ownership of an engine and its buffers, waiting for any other request using them.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiCrypto::acquireEngine(bool *busy) {
+  while (*busy) {
+    _commandGate->commandSleep(busy);
+  }
+  *busy = true;
+}
+
+//
+// Releases an engine and its buffers.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiCrypto::releaseEngine(bool *busy) {
+  *busy = false;
+  _commandGate->commandWakeup(busy);
+}
+
+//
+// Waits for an engine operation to finish. The command gate is released while waiting on the interrupt.
+// On timeout the engine is stopped, it is reset by the next operation that uses it.
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiCrypto::waitEngine(WiiCryptoEngineWait *wait, IOInterruptEventSource *intEventSource, volatile void *baseAddr,
+                               UInt32 controlReg, UInt32 executeMask, UInt32 errorMask) {
+  AbsoluteTime  deadline;
+  AbsoluteTime  now;
+  UInt32        control;
+
+  clock_interval_to_deadline(kWiiCryptoEngineTimeoutMS, kMillisecondScale, &deadline);
+  if (intEventSource != NULL) {
+    wait->timedOut   = false;
+    wait->generation = ++_waitGeneration;
+    thread_call_enter1_delayed(wait->timeoutThreadCall, (thread_call_param_t) (uintptr_t) wait->generation, deadline);
+
+    while (wait->running && !wait->timedOut) {
+      _commandGate->commandSleep(&wait->running);
+    }
+    thread_call_cancel(wait->timeoutThreadCall);
+  } else {
+    while (OSReadBigInt32(baseAddr, controlReg) & executeMask) {
+      clock_get_uptime(&now);
+      if (CMP_ABSOLUTETIME(&now, &deadline) > 0) {
+        break;
+      }
+      IODelay(1);
+    }
+  }
+
+  //
+  // Check once more, the engine may have finished without an interrupt.
+  //
+  control       = OSReadBigInt32(baseAddr, controlReg);
+  wait->running = false;
+  if (control & executeMask) {
+    WIISYSLOG("Timed out waiting for engine, control: 0x%X", control);
+    OSWriteBigInt32(baseAddr, controlReg, 0);
+    return kIOReturnTimeout;
+  }
+
+  if (control & errorMask) {
+    WIISYSLOG("Engine error, control: 0x%X", control);
+    OSWriteBigInt32(baseAddr, controlReg, 0);
+    return kIOReturnIOError;
+  }
+
+  return kIOReturnSuccess;
+}
+
+//
+// Times out an engine wait, if it is still the one the timeout was set for.
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiCrypto::timeoutEngineGated(UInt32 *generation) {
+  WiiCryptoEngineWait *waits[] = { &_aesWait, &_shaWait };
+
+  for (UInt32 i = 0; i < (sizeof (waits) / sizeof (waits[0])); i++) {
+    if (waits[i]->running && (waits[i]->generation == *generation)) {
+      waits[i]->timedOut = true;
+      _commandGate->commandWakeup(&waits[i]->running);
+    }
+  }
+  return kIOReturnSuccess;
+}
+
+//
+// Handles the engine timeout thread calls.
+//
+void WiiCrypto::handleEngineTimeout(thread_call_param_t param0, thread_call_param_t param1) {
+  WiiCrypto *crypto     = (WiiCrypto *) param0;
+  UInt32    generation  = (UInt32) (uintptr_t) param1;
+
+  crypto->_commandGate->runAction(
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+    OSMemberFunctionCast(IOCommandGate::Action, crypto, &WiiCrypto::timeoutEngineGated),
+#else
+    (IOCommandGate::Action) &WiiCrypto::timeoutEngineGated,
+#endif
+    &generation);
+}
+
+//
+// Handles AES engine completion interrupts.
+//
+void WiiCrypto::handleAESInterrupt(IOInterruptEventSource *intEventSource, int count) {
+  if (_aesWait.running && ((readAESReg32(kWiiAESRegControl) & kWiiAESControlExecute) == 0)) {
+    _aesWait.running = false;
+    _commandGate->commandWakeup(&_aesWait.running);
+  }
+}
+
+//
+// Handles SHA-1 engine completion interrupts.
+//
+void WiiCrypto::handleSHAInterrupt(IOInterruptEventSource *intEventSource, int count) {
+  if (_shaWait.running && ((readSHAReg32(kWiiSHARegControl) & kWiiSHAControlExecute) == 0)) {
+    _shaWait.running = false;
+    _commandGate->commandWakeup(&_shaWait.running);
+  }
+}
+
+//
+// Runs the AES engine over the source bounce buffer into the destination bounce buffer.
+// Each run resets the engine and loads the key and IV, the caller carries the chain between runs.
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiCrypto::runAESEngine(const UInt8 *key, const UInt8 *iv, bool decrypt, IOByteCount length) {
+  UInt32 control;
+
+  writeAESReg32(kWiiAESRegControl, 0);
+  for (UInt32 i = 0; i < kWiiCryptoAESKeySize; i += sizeof (UInt32)) {
+    writeAESReg32(kWiiAESRegKey, OSReadBigInt32((void *) key, i));
+  }
+  for (UInt32 i = 0; i < kWiiCryptoAESBlockSize; i += sizeof (UInt32)) {
+    writeAESReg32(kWiiAESRegIV, OSReadBigInt32((void *) iv, i));
+  }
+  writeAESReg32(kWiiAESRegSource, _aesSrcPhysAddr);
+  writeAESReg32(kWiiAESRegDest, _aesDestPhysAddr);
+
+  control = kWiiAESControlExecute | kWiiAESControlEnable | (((length / kWiiCryptoAESBlockSize) - 1) & kWiiAESControlBlocksMask);
+  if (decrypt) {
+    control |= kWiiAESControlDecrypt;
+  }
+  if (_aesInterruptEventSource != NULL) {
+    control |= kWiiAESControlIRQ;
+  }
+
+  _aesWait.running = true;
+  writeAESReg32(kWiiAESRegControl, control);
+
+  return waitEngine(&_aesWait, _aesInterruptEventSource, _aesBaseAddr, kWiiAESRegControl,
+                    kWiiAESControlExecute, kWiiAESControlError);
+}
+
+//
+// Runs the SHA-1 engine over the bounce buffer, updating the hash state.
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiCrypto::runSHAEngine(UInt32 *h, IOByteCount length) {
+  UInt32    control;
+  IOReturn  status;
+
+  writeSHAReg32(kWiiSHARegControl, 0);
+  for (UInt32 i = 0; i < 5; i++) {
+    writeSHAReg32(kWiiSHARegH0 + (i * sizeof (UInt32)), h[i]);
+  }
+  writeSHAReg32(kWiiSHARegSource, _shaPhysAddr);
+
+  control = kWiiSHAControlExecute | (((length / kWiiCryptoSHA1BlockSize) - 1) & kWiiSHAControlBlocksMask);
+  if (_shaInterruptEventSource != NULL) {
+    control |= kWiiSHAControlIRQ;
+  }
+
+  _shaWait.running = true;
+  writeSHAReg32(kWiiSHARegControl, control);
+
+  status = waitEngine(&_shaWait, _shaInterruptEventSource, _shaBaseAddr, kWiiSHARegControl,
+                      kWiiSHAControlExecute, kWiiSHAControlError);
+  if (status != kIOReturnSuccess) {
+    return status;
+  }
+
+  for (UInt32 i = 0; i < 5; i++) {
+    h[i] = readSHAReg32(kWiiSHARegH0 + (i * sizeof (UInt32)));
+  }
+  return kIOReturnSuccess;
+}
+
+//
+// Encrypts or decrypts with AES-128-CBC.
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiCrypto::aesCBCGated(WiiCryptoAESRequest *request) {
+  UInt32      roundKeys[kWiiCryptoAESRoundKeyCount];
+  UInt8       *chainBuffer;
+  bool        roundKeysValid;
+  bool        useEngine;
+  IOByteCount srcOffset;
+  IOByteCount destOffset;
+  IOByteCount length;
+  IOByteCount chunkLength;
+  IOByteCount copied;
+  IOReturn    status;
+
+  srcOffset       = request->srcOffset;
+  destOffset      = request->destOffset;
+  length          = request->length;
+  roundKeysValid  = false;
+  status          = kIOReturnSuccess;
+
+  acquireEngine(&_aesBusy);
+  while (length > 0) {
+    chunkLength = (length > kWiiCryptoChunkSize) ? kWiiCryptoChunkSize : length;
+    useEngine   = (_aesBaseAddr != NULL) && (chunkLength >= kWiiCryptoEngineMinLength);
+
+    if (useEngine) {
+      copied = readToDMABuffer(request->src, srcOffset, _aesSrcBuffer, chunkLength);
+    } else {
+      copied = request->src->readBytes(srcOffset, _aesSrcBuffer, chunkLength);
+    }
+    if (copied != chunkLength) {
+      status = kIOReturnDMAError;
+      break;
+    }
+
+    if (useEngine) {
+      status = runAESEngine(request->key, request->iv, request->decrypt, chunkLength);
+      if (status != kIOReturnSuccess) {
+        break;
+      }
+      copied = writeFromDMABuffer(request->dest, destOffset, _aesDestBuffer, chunkLength, _invalidateCacheFunc);
+
+      //
+      // The chain continues from the last ciphertext block, which is the source when decrypting.
+      // The engine only reads the source buffer, so it still holds the block.
+      //
+      chainBuffer = request->decrypt ? _aesSrcBuffer : _aesDestBuffer;
+      bcopy(&chainBuffer[chunkLength - kWiiCryptoAESBlockSize], request->iv, kWiiCryptoAESBlockSize);
+    } else {
+      if (!roundKeysValid) {
+        expandAESKey(request->key, roundKeys);
+        roundKeysValid = true;
+      }
+
+      if (request->decrypt) {
+        decryptAESCBCSoftware(roundKeys, request->iv, _aesSrcBuffer, _aesDestBuffer, chunkLength);
+      } else {
+        encryptAESCBCSoftware(roundKeys, request->iv, _aesSrcBuffer, _aesDestBuffer, chunkLength);
+      }
+      copied = request->dest->writeBytes(destOffset, _aesDestBuffer, chunkLength);
+    }
+    if (copied != chunkLength) {
+      status = kIOReturnDMAError;
+      break;
+    }
+
+    srcOffset  += chunkLength;
+    destOffset += chunkLength;
+    length     -= chunkLength;
+  }
+  releaseEngine(&_aesBusy);
+
+  bzero(roundKeys, sizeof (roundKeys));
+  return status;
+}
+
+//
+// Adds data to a SHA-1 hash.
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiCrypto::sha1UpdateGated(WiiCryptoSHA1Context *context, IOMemoryDescriptor *src, IOByteCount offset, IOByteCount length) {
+  UInt32      used;
+  bool        useEngine;
+  IOByteCount chunkLength;
+  IOByteCount copied;
+  IOReturn    status;
+
+  //
+  // Complete any partial block first.
+  //
+  used = (UInt32) (context->length % kWiiCryptoSHA1BlockSize);
+  if (used > 0) {
+    chunkLength = kWiiCryptoSHA1BlockSize - used;
+    if (chunkLength > length) {
+      chunkLength = length;
+    }
+    if (src->readBytes(offset, &context->buffer[used], chunkLength) != chunkLength) {
+      return kIOReturnDMAError;
+    }
+    if ((used + chunkLength) == kWiiCryptoSHA1BlockSize) {
+      hashSHA1Software(context->h, context->buffer, kWiiCryptoSHA1BlockSize);
+    }
+
+    context->length += chunkLength;
+    offset          += chunkLength;
+    length          -= chunkLength;
+  }
+
+  //
+  // Hash whole blocks.
+  //
+  status = kIOReturnSuccess;
+  acquireEngine(&_shaBusy);
+  while (length >= kWiiCryptoSHA1BlockSize) {
+    chunkLength = (length > kWiiCryptoChunkSize) ? kWiiCryptoChunkSize : (length & ~(kWiiCryptoSHA1BlockSize - 1));
+    useEngine   = (_shaBaseAddr != NULL) && (chunkLength >= kWiiCryptoEngineMinLength);
+
+    if (useEngine) {
+      copied = readToDMABuffer(src, offset, _shaBuffer, chunkLength);
+    } else {
+      copied = src->readBytes(offset, _shaBuffer, chunkLength);
+    }
+    if (copied != chunkLength) {
+      status = kIOReturnDMAError;
+      break;
+    }
+
+    if (useEngine) {
+      status = runSHAEngine(context->h, chunkLength);
+      if (status != kIOReturnSuccess) {
+        break;
+      }
+    } else {
+      hashSHA1Software(context->h, _shaBuffer, chunkLength);
+    }
+
+    context->length += chunkLength;
+    offset          += chunkLength;
+    length          -= chunkLength;
+  }
+  releaseEngine(&_shaBusy);
+
+  //
+  // Keep any remainder for later.
+  //
+  if ((status == kIOReturnSuccess) && (length > 0)) {
+    if (src->readBytes(offset, context->buffer, length) != length) {
+      return kIOReturnDMAError;
+    }
+    context->length += length;
+  }
+
+  return status;
+}
+
+//
+// Encrypts or decrypts with AES-128-CBC.
+//
+IOReturn WiiCrypto::aesCBC(const UInt8 *key, UInt8 *iv, bool decrypt, IOMemoryDescriptor *src, IOByteCount srcOffset,
+                           IOMemoryDescriptor *dest, IOByteCount destOffset, IOByteCount length) {
+  WiiCryptoAESRequest request;
+
+  if ((key == NULL) || (iv == NULL) || (src == NULL) || (dest == NULL)
+      || ((length % kWiiCryptoAESBlockSize) != 0)
+      || ((srcOffset + length) > src->getLength()) || ((destOffset + length) > dest->getLength())) {
+    return kIOReturnBadArgument;
+  }
+  if (length == 0) {
+    return kIOReturnSuccess;
+  }
+
+  request.key         = key;
+  request.iv          = iv;
+  request.decrypt     = decrypt;
+  request.src         = src;
+  request.srcOffset   = srcOffset;
+  request.dest        = dest;
+  request.destOffset  = destOffset;
+  request.length      = length;
+
+  return _commandGate->runAction(
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+    OSMemberFunctionCast(IOCommandGate::Action, this, &WiiCrypto::aesCBCGated),
+#else
+    (IOCommandGate::Action) &WiiCrypto::aesCBCGated,
+#endif
+    &request);
+}
+
+//
+// Starts a SHA-1 hash.
+//
+void WiiCrypto::sha1Init(WiiCryptoSHA1Context *context) {
+  serviceSHA1Init(context);
+}
+
+//
+// Adds data to a SHA-1 hash.
+//
+IOReturn WiiCrypto::sha1Update(WiiCryptoSHA1Context *context, IOMemoryDescriptor *src, IOByteCount offset, IOByteCount length) {
+  if ((context == NULL) || (src == NULL) || ((offset + length) > src->getLength())) {
+    return kIOReturnBadArgument;
+  }
+  if (length == 0) {
+    return kIOReturnSuccess;
+  }
+
+  return _commandGate->runAction(
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+    OSMemberFunctionCast(IOCommandGate::Action, this, &WiiCrypto::sha1UpdateGated),
+#else
+    (IOCommandGate::Action) &WiiCrypto::sha1UpdateGated,
+#endif
+    context, src, (void *) offset, (void *) length);
+}
+
+//
+// Finishes a SHA-1 hash. Padding is at most two blocks and is always hashed in software.
+//
+IOReturn WiiCrypto::sha1Final(WiiCryptoSHA1Context *context, UInt8 *digest) {
+  UInt32 used;
+  UInt64 bitLength;
+
+  if ((context == NULL) || (digest == NULL)) {
+    return kIOReturnBadArgument;
+  }
+
+  used      = (UInt32) (context->length % kWiiCryptoSHA1BlockSize);
+  bitLength = context->length * 8;
+
+  context->buffer[used++] = 0x80;
+  if (used > (kWiiCryptoSHA1BlockSize - sizeof (bitLength))) {
+    bzero(&context->buffer[used], kWiiCryptoSHA1BlockSize - used);
+    hashSHA1Software(context->h, context->buffer, kWiiCryptoSHA1BlockSize);
+    used = 0;
+  }
+  bzero(&context->buffer[used], (kWiiCryptoSHA1BlockSize - sizeof (bitLength)) - used);
+  OSWriteBigInt32(context->buffer, kWiiCryptoSHA1BlockSize - sizeof (bitLength), (UInt32) (bitLength >> 32));
+  OSWriteBigInt32(context->buffer, kWiiCryptoSHA1BlockSize - sizeof (UInt32), (UInt32) bitLength);
+  hashSHA1Software(context->h, context->buffer, kWiiCryptoSHA1BlockSize);
+
+  for (UInt32 i = 0; i < 5; i++) {
+    OSWriteBigInt32(digest, i * sizeof (UInt32), context->h[i]);
+  }
+
+  bzero(context, sizeof (*context));
+  return kIOReturnSuccess;
+}
+
+//
+// Service functions.
+//
+IOReturn WiiCrypto::serviceAESCBC(const UInt8 *key, UInt8 *iv, bool decrypt, IOMemoryDescriptor *src, IOByteCount srcOffset,
+                                  IOMemoryDescriptor *dest, IOByteCount destOffset, IOByteCount length) {
+  if (gWiiCrypto == NULL) {
+    return kIOReturnNotReady;
+  }
+  return gWiiCrypto->aesCBC(key, iv, decrypt, src, srcOffset, dest, destOffset, length);
+}
+
+void WiiCrypto::serviceSHA1Init(WiiCryptoSHA1Context *context) {
+  bcopy(gSHA1InitialH, context->h, sizeof (context->h));
+  context->length = 0;
+}
+
+IOReturn WiiCrypto::serviceSHA1Update(WiiCryptoSHA1Context *context, IOMemoryDescriptor *src, IOByteCount offset, IOByteCount length) {
+  if (gWiiCrypto == NULL) {
+    return kIOReturnNotReady;
+  }
+  return gWiiCrypto->sha1Update(context, src, offset, length);
+}
+
+IOReturn WiiCrypto::serviceSHA1Final(WiiCryptoSHA1Context *context, UInt8 *digest) {
+  if (gWiiCrypto == NULL) {
+    return kIOReturnNotReady;
+  }
+  return gWiiCrypto->sha1Final(context, digest);
+}
@@ -0,0 +1,175 @@
+//
+//  WiiCrypto.hpp
+//  Wii AES and SHA-1 engines
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef WiiCrypto_hpp
+#define WiiCrypto_hpp
+
+#include <IOKit/IOCommandGate.h>
+#include <IOKit/IOInterruptEventSource.h>
+#include <IOKit/IOService.h>
+#include <IOKit/IOWorkLoop.h>
+#include <kern/thread_call.h>
+
+#include "WiiCacheCopy.hpp"
+#include "WiiCryptoService.hpp"
+#include "WiiMem2.hpp"
+#include "CryptoRegs.hpp"
+
+//
+// Requests are split into chunks that are copied through MEM2 bounce buffers.
+//
+#define kWiiCryptoChunkSize           (16 * kByte)
+#define kWiiCryptoMem2Quota           (kWiiCryptoChunkSize * 3)
+
+//
+// Chunks shorter than this are done in software, the interrupt round trip costs more than the work itself.
+//
+#define kWiiCryptoEngineMinLength     512
+
+#define kWiiCryptoSHAWaitSecs         2
+
+//
+// Longest an engine may take for a chunk, whether waiting on its interrupt or polling.
+// A chunk takes well under a millisecond, anything longer is a hung engine or a lost interrupt.
+//
+#define kWiiCryptoEngineTimeoutMS     1000
+
+#define kWiiCryptoAESRoundKeyCount    44
+
+//
+// AES request, passed through the command gate.
+//
+typedef struct {
+  const UInt8         *key;
+  UInt8               *iv;
+  bool                decrypt;
+  IOMemoryDescriptor  *src;
+  IOByteCount         srcOffset;
+  IOMemoryDescriptor  *dest;
+  IOByteCount         destOffset;
+  IOByteCount         length;
+} WiiCryptoAESRequest;
+
+//
+// Engine operation in progress. A timeout thread call ends the wait if the completion interrupt never comes.
+//
+typedef struct {
+  bool          running;
+  bool          timedOut;
+  UInt32        generation;
+  thread_call_t timeoutThreadCall;
+} WiiCryptoEngineWait;
+
+//
+// Represents the Hollywood AES and SHA-1 engines.
+//
+class WiiCrypto : public IOService {
+  OSDeclareDefaultStructors(WiiCrypto);
+  WiiDeclareLogFunctions("crypto");
+  typedef IOService super;
+
+private:
+  IOWorkLoop                  *_workLoop;
+  IOCommandGate               *_commandGate;
+  WiiInvalidateDataCacheFunc  _invalidateCacheFunc;
+  const WiiMem2Service        *_mem2Service;
+  WiiMem2Client               *_mem2Client;
+
+  //
+  // AES engine, NULL base address if the engine is not available.
+  //
+  IOMemoryMap             *_aesMemoryMap;
+  volatile void           *_aesBaseAddr;
+  IOInterruptEventSource  *_aesInterruptEventSource;
+  bool                    _aesBusy;
+  WiiCryptoEngineWait     _aesWait;
+  UInt8                   *_aesSrcBuffer;
+  IOPhysicalAddress       _aesSrcPhysAddr;
+  UInt8                   *_aesDestBuffer;
+  IOPhysicalAddress       _aesDestPhysAddr;
+
+  //
+  // SHA-1 engine, NULL base address if the engine is not available.
+  //
+  IOService               *_shaDevice;
+  IOMemoryMap             *_shaMemoryMap;
+  volatile void           *_shaBaseAddr;
+  IOInterruptEventSource  *_shaInterruptEventSource;
+  bool                    _shaBusy;
+  WiiCryptoEngineWait     _shaWait;
+  UInt8                   *_shaBuffer;
+  IOPhysicalAddress       _shaPhysAddr;
+
+  UInt32                  _waitGeneration;
+
+  inline UInt32 readAESReg32(UInt32 offset) {
+    return OSReadBigInt32(_aesBaseAddr, offset);
+  }
+  inline void writeAESReg32(UInt32 offset, UInt32 data) {
+    OSWriteBigInt32(_aesBaseAddr, offset, data);
+  }
+  inline UInt32 readSHAReg32(UInt32 offset) {
+    return OSReadBigInt32(_shaBaseAddr, offset);
+  }
+  inline void writeSHAReg32(UInt32 offset, UInt32 data) {
+    OSWriteBigInt32(_shaBaseAddr, offset, data);
+  }
+
+  UInt32 readAHBProtect(void);
+  IOInterruptEventSource *createInterruptEventSource(IOService *provider, IOInterruptEventSource::Action action);
+  UInt8 *allocateBuffer(IOPhysicalAddress *physAddr);
+  void freeBuffer(UInt8 *buffer, IOPhysicalAddress physAddr);
+
+  void acquireEngine(bool *busy);
+  void releaseEngine(bool *busy);
+  IOReturn waitEngine(WiiCryptoEngineWait *wait, IOInterruptEventSource *intEventSource, volatile void *baseAddr,
+                      UInt32 controlReg, UInt32 executeMask, UInt32 errorMask);
+  IOReturn timeoutEngineGated(UInt32 *generation);
+  static void handleEngineTimeout(thread_call_param_t param0, thread_call_param_t param1);
+  void handleAESInterrupt(IOInterruptEventSource *intEventSource, int count);
+  void handleSHAInterrupt(IOInterruptEventSource *intEventSource, int count);
+
+  IOReturn runAESEngine(const UInt8 *key, const UInt8 *iv, bool decrypt, IOByteCount length);
+  IOReturn runSHAEngine(UInt32 *h, IOByteCount length);
+  IOReturn aesCBCGated(WiiCryptoAESRequest *request);
+  IOReturn sha1UpdateGated(WiiCryptoSHA1Context *context, IOMemoryDescriptor *src, IOByteCount offset, IOByteCount length);
+
+  static IOReturn serviceAESCBC(const UInt8 *key, UInt8 *iv, bool decrypt, IOMemoryDescriptor *src, IOByteCount srcOffset,
+                                IOMemoryDescriptor *dest, IOByteCount destOffset, IOByteCount length);
+  static void serviceSHA1Init(WiiCryptoSHA1Context *context);
+  static IOReturn serviceSHA1Update(WiiCryptoSHA1Context *context, IOMemoryDescriptor *src, IOByteCount offset, IOByteCount length);
+  static IOReturn serviceSHA1Final(WiiCryptoSHA1Context *context, UInt8 *digest);
+
+public:
+  //
+  // Overrides.
+  //
+  bool init(OSDictionary *dictionary = 0);
+  void free(void);
+  bool start(IOService *provider);
+  IOReturn callPlatformFunction(const OSSymbol *functionName, bool waitForFunction,
+                                void *param1, void *param2, void *param3, void *param4);
+
+  //
+  // Crypto functions.
+  //
+  IOReturn aesCBC(const UInt8 *key, UInt8 *iv, bool decrypt, IOMemoryDescriptor *src, IOByteCount srcOffset,
+                  IOMemoryDescriptor *dest, IOByteCount destOffset, IOByteCount length);
+  void sha1Init(WiiCryptoSHA1Context *context);
+  IOReturn sha1Update(WiiCryptoSHA1Context *context, IOMemoryDescriptor *src, IOByteCount offset, IOByteCount length);
+  IOReturn sha1Final(WiiCryptoSHA1Context *context, UInt8 *digest);
+
+  //
+  // Software implementations, on whole blocks.
+  //
+  static void expandAESKey(const UInt8 *key, UInt32 *roundKeys);
+  static void encryptAESCBCSoftware(const UInt32 *roundKeys, UInt8 *iv, const UInt8 *in, UInt8 *out, IOByteCount length);
+  static void decryptAESCBCSoftware(const UInt32 *roundKeys, UInt8 *iv, const UInt8 *in, UInt8 *out, IOByteCount length);
+  static void hashSHA1Software(UInt32 *h, const UInt8 *data, IOByteCount length);
+};
+
+#endif
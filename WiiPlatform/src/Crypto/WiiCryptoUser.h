@@ -0,0 +1,69 @@
+//
+//  WiiCryptoUser.h
+//  Wii AES and SHA-1 engine user client interface
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  Shared between the kernel extension and user space tools, must remain plain C.
+//
+
+#ifndef WiiCryptoUser_h
+#define WiiCryptoUser_h
+
+//
+// User client methods.
+//
+// AESCBC:  AES-128-CBC over a user buffer, outputs the IV to continue the chain.
+//          Source and destination may be the same buffer.
+// SHA1:    adds a user buffer to a SHA-1 hash, outputs the updated state.
+//          When final is set the hash is finished and the output H words are the digest.
+//
+enum {
+  kWiiCryptoMethodAESCBC  = 0,
+  kWiiCryptoMethodSHA1    = 1,
+  kWiiCryptoMethodCount
+};
+
+//
+// Largest user buffer for a single call, buffers are wired for the duration of the call.
+//
+#define kWiiCryptoUserMaxLength   (1024 * 1024)
+
+typedef struct {
+  UInt8   key[16];
+  UInt8   iv[16];
+  // User space addresses.
+  UInt32  source;
+  UInt32  dest;
+  // Length in bytes, a multiple of 16.
+  UInt32  length;
+  // Non-zero to decrypt.
+  UInt32  decrypt;
+} WiiCryptoUserAESRequest;
+
+typedef struct {
+  UInt8   iv[16];
+} WiiCryptoUserAESResult;
+
+//
+// SHA-1 state. Start a hash with the standard initial H words and a zero length.
+//
+typedef struct {
+  UInt32  h[5];
+  // Total bytes hashed so far.
+  UInt32  lengthHigh;
+  UInt32  lengthLow;
+  // Partial block, the first (length % 64) bytes are valid.
+  UInt8   buffer[64];
+} WiiCryptoUserSHA1State;
+
+typedef struct {
+  WiiCryptoUserSHA1State  state;
+  // User space address.
+  UInt32                  source;
+  UInt32                  length;
+  // Non-zero to finish the hash.
+  UInt32                  final;
+} WiiCryptoUserSHA1Request;
+
+#endif
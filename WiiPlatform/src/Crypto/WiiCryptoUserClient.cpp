@@ -0,0 +1,190 @@
+//
+//  WiiCryptoUserClient.cpp
+//  Wii AES and SHA-1 engine user client
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "WiiCryptoUserClient.hpp"
+
+OSDefineMetaClassAndStructors(WiiCryptoUserClient, super);
+
+//
+// Overrides IOUserClient::initWithTask().
+//
+bool WiiCryptoUserClient::initWithTask(task_t owningTask, void *securityToken, UInt32 type) {
+  WiiCheckDebugArgs();
+
+  //
+  // Requests wire client memory and occupy the engines, restrict to administrators.
+  //
+  if (clientHasPrivilege(securityToken, kIOClientPrivilegeAdministrator) != kIOReturnSuccess) {
+    return false;
+  }
+
+  _crypto = NULL;
+  _task   = owningTask;
+
+  return super::initWithTask(owningTask, securityToken, type);
+}
+
+//
+// Overrides IOUserClient::start().
+//
+bool WiiCryptoUserClient::start(IOService *provider) {
+  _crypto = OSDynamicCast(WiiCrypto, provider);
+  if (_crypto == NULL) {
+    return false;
+  }
+
+  if (!super::start(provider)) {
+    return false;
+  }
+
+  _methods[kWiiCryptoMethodAESCBC].object = this;
+  _methods[kWiiCryptoMethodAESCBC].func   = (IOMethod) &WiiCryptoUserClient::aesCBC;
+  _methods[kWiiCryptoMethodAESCBC].flags  = kIOUCStructIStructO;
+  _methods[kWiiCryptoMethodAESCBC].count0 = sizeof (WiiCryptoUserAESRequest);
+  _methods[kWiiCryptoMethodAESCBC].count1 = sizeof (WiiCryptoUserAESResult);
+
+  _methods[kWiiCryptoMethodSHA1].object = this;
+  _methods[kWiiCryptoMethodSHA1].func   = (IOMethod) &WiiCryptoUserClient::sha1;
+  _methods[kWiiCryptoMethodSHA1].flags  = kIOUCStructIStructO;
+  _methods[kWiiCryptoMethodSHA1].count0 = sizeof (WiiCryptoUserSHA1Request);
+  _methods[kWiiCryptoMethodSHA1].count1 = sizeof (WiiCryptoUserSHA1State);
+
+  return true;
+}
+
+//
+// Overrides IOUserClient::clientClose().
+//
+IOReturn WiiCryptoUserClient::clientClose(void) {
+  _crypto = NULL;
+
+  terminate();
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUserClient::getTargetAndMethodForIndex().
+//
+IOExternalMethod *WiiCryptoUserClient::getTargetAndMethodForIndex(IOService **targetP, UInt32 index) {
+  if ((index >= kWiiCryptoMethodCount) || (_crypto == NULL)) {
+    return NULL;
+  }
+
+  *targetP = this;
+  return &_methods[index];
+}
+
+//
+// Creates and prepares a memory descriptor for a client buffer.
+//
+IOMemoryDescriptor *WiiCryptoUserClient::createUserDescriptor(UInt32 address, UInt32 length, IODirection direction) {
+  IOMemoryDescriptor *desc;
+
+  desc = IOMemoryDescriptor::withAddress((vm_address_t) address, length, direction, _task);
+  if (desc == NULL) {
+    return NULL;
+  }
+
+  if (desc->prepare() != kIOReturnSuccess) {
+    desc->release();
+    return NULL;
+  }
+  return desc;
+}
+
+//
+// Completes and releases a client buffer memory descriptor.
+//
+void WiiCryptoUserClient::releaseUserDescriptor(IOMemoryDescriptor *desc) {
+  if (desc != NULL) {
+    desc->complete();
+    desc->release();
+  }
+}
+
+//
+// Encrypts or decrypts a client buffer with AES-128-CBC.
+//
+IOReturn WiiCryptoUserClient::aesCBC(WiiCryptoUserAESRequest *request, WiiCryptoUserAESResult *result,
+                                     IOByteCount requestSize, IOByteCount *resultSize) {
+  IOMemoryDescriptor  *srcDesc;
+  IOMemoryDescriptor  *destDesc;
+  IOReturn            status;
+
+  if ((requestSize != sizeof (*request)) || (*resultSize < sizeof (*result))
+      || (request->length == 0) || (request->length > kWiiCryptoUserMaxLength)
+      || ((request->length % kWiiCryptoAESBlockSize) != 0)) {
+    return kIOReturnBadArgument;
+  }
+
+  srcDesc  = createUserDescriptor(request->source, request->length, kIODirectionOut);
+  destDesc = createUserDescriptor(request->dest, request->length, kIODirectionIn);
+  if ((srcDesc == NULL) || (destDesc == NULL)) {
+    releaseUserDescriptor(srcDesc);
+    releaseUserDescriptor(destDesc);
+    return kIOReturnVMError;
+  }
+
+  status = _crypto->aesCBC(request->key, request->iv, request->decrypt != 0, srcDesc, 0, destDesc, 0, request->length);
+  releaseUserDescriptor(srcDesc);
+  releaseUserDescriptor(destDesc);
+
+  if (status == kIOReturnSuccess) {
+    bcopy(request->iv, result->iv, sizeof (result->iv));
+    *resultSize = sizeof (*result);
+  } else {
+    *resultSize = 0;
+  }
+  bzero(request->key, sizeof (request->key));
+  return status;
+}
+
+//
+// Adds a client buffer to a SHA-1 hash.
+//
+IOReturn WiiCryptoUserClient::sha1(WiiCryptoUserSHA1Request *request, WiiCryptoUserSHA1State *state,
+                                   IOByteCount requestSize, IOByteCount *stateSize) {
+  WiiCryptoSHA1Context  context;
+  IOMemoryDescriptor    *srcDesc;
+  IOReturn              status;
+
+  if ((requestSize != sizeof (*request)) || (*stateSize < sizeof (*state))
+      || (request->length > kWiiCryptoUserMaxLength)) {
+    return kIOReturnBadArgument;
+  }
+
+  bcopy(request->state.h, context.h, sizeof (context.h));
+  context.length = ((UInt64) request->state.lengthHigh << 32) | request->state.lengthLow;
+  bcopy(request->state.buffer, context.buffer, sizeof (context.buffer));
+
+  status = kIOReturnSuccess;
+  if (request->length > 0) {
+    srcDesc = createUserDescriptor(request->source, request->length, kIODirectionOut);
+    if (srcDesc == NULL) {
+      return kIOReturnVMError;
+    }
+    status = _crypto->sha1Update(&context, srcDesc, 0, request->length);
+    releaseUserDescriptor(srcDesc);
+  }
+  if (status != kIOReturnSuccess) {
+    *stateSize = 0;
+    return status;
+  }
+
+  bzero(state, sizeof (*state));
+  if (request->final) {
+    status = _crypto->sha1Final(&context, (UInt8 *) state->h);
+  } else {
+    bcopy(context.h, state->h, sizeof (state->h));
+    state->lengthHigh = (UInt32) (context.length >> 32);
+    state->lengthLow  = (UInt32) context.length;
+    bcopy(context.buffer, state->buffer, sizeof (state->buffer));
+  }
+
+  *stateSize = sizeof (*state);
+  return status;
+}
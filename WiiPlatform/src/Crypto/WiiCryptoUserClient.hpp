@@ -0,0 +1,44 @@
+//
+//  WiiCryptoUserClient.hpp
+//  Wii AES and SHA-1 engine user client
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef WiiCryptoUserClient_hpp
+#define WiiCryptoUserClient_hpp
+
+#include <IOKit/IOUserClient.h>
+
+#include "WiiCrypto.hpp"
+#include "WiiCryptoUser.h"
+
+//
+// Represents a user client running requests on user space buffers.
+//
+class WiiCryptoUserClient : public IOUserClient {
+  OSDeclareDefaultStructors(WiiCryptoUserClient);
+  WiiDeclareLogFunctions("crypto");
+  typedef IOUserClient super;
+
+private:
+  WiiCrypto         *_crypto;
+  task_t            _task;
+  IOExternalMethod  _methods[kWiiCryptoMethodCount];
+
+  IOMemoryDescriptor *createUserDescriptor(UInt32 address, UInt32 length, IODirection direction);
+  void releaseUserDescriptor(IOMemoryDescriptor *desc);
+
+public:
+  bool initWithTask(task_t owningTask, void *securityToken, UInt32 type);
+  bool start(IOService *provider);
+  IOReturn clientClose(void);
+  IOExternalMethod *getTargetAndMethodForIndex(IOService **targetP, UInt32 index);
+
+  IOReturn aesCBC(WiiCryptoUserAESRequest *request, WiiCryptoUserAESResult *result,
+                  IOByteCount requestSize, IOByteCount *resultSize);
+  IOReturn sha1(WiiCryptoUserSHA1Request *request, WiiCryptoUserSHA1State *state,
+                IOByteCount requestSize, IOByteCount *stateSize);
+};
+
+#endif
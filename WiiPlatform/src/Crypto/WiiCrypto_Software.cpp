@@ -0,0 +1,272 @@
+//
+//  WiiCrypto_Software.cpp
+//  Wii AES and SHA-1 engines - software implementations
+//
+// Used when an engine is not available to Broadway and for requests too short to be worth an engine round trip.
+// Both follow FIPS 197 and FIPS 180 directly, favouring small tables over speed.
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "WiiCrypto.hpp"
+
+static const UInt8 gAESSBox[256] = {
+0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+  0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+  0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+  0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+  0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+  0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+  0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+  0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+  0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+  0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+  0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+  0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+  0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+  0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+  0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+  0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
+};
+
+static const UInt8 gAESInvSBox[256] = {
+  0x52, 0x09, 0x6A, 0xD5, 0x30, 0x36, 0xA5, 0x38, 0xBF, 0x40, 0xA3, 0x9E, 0x81, 0xF3, 0xD7, 0xFB,
+  0x7C, 0xE3, 0x39, 0x82, 0x9B, 0x2F, 0xFF, 0x87, 0x34, 0x8E, 0x43, 0x44, 0xC4, 0xDE, 0xE9, 0xCB,
+  0x54, 0x7B, 0x94, 0x32, 0xA6, 0xC2, 0x23, 0x3D, 0xEE, 0x4C, 0x95, 0x0B, 0x42, 0xFA, 0xC3, 0x4E,
+  0x08, 0x2E, 0xA1, 0x66, 0x28, 0xD9, 0x24, 0xB2, 0x76, 0x5B, 0xA2, 0x49, 0x6D, 0x8B, 0xD1, 0x25,
+  0x72, 0xF8, 0xF6, 0x64, 0x86, 0x68, 0x98, 0x16, 0xD4, 0xA4, 0x5C, 0xCC, 0x5D, 0x65, 0xB6, 0x92,
+  0x6C, 0x70, 0x48, 0x50, 0xFD, 0xED, 0xB9, 0xDA, 0x5E, 0x15, 0x46, 0x57, 0xA7, 0x8D, 0x9D, 0x84,
+  0x90, 0xD8, 0xAB, 0x00, 0x8C, 0xBC, 0xD3, 0x0A, 0xF7, 0xE4, 0x58, 0x05, 0xB8, 0xB3, 0x45, 0x06,
+  0xD0, 0x2C, 0x1E, 0x8F, 0xCA, 0x3F, 0x0F, 0x02, 0xC1, 0xAF, 0xBD, 0x03, 0x01, 0x13, 0x8A, 0x6B,
+  0x3A, 0x91, 0x11, 0x41, 0x4F, 0x67, 0xDC, 0xEA, 0x97, 0xF2, 0xCF, 0xCE, 0xF0, 0xB4, 0xE6, 0x73,
+  0x96, 0xAC, 0x74, 0x22, 0xE7, 0xAD, 0x35, 0x85, 0xE2, 0xF9, 0x37, 0xE8, 0x1C, 0x75, 0xDF, 0x6E,
+  0x47, 0xF1, 0x1A, 0x71, 0x1D, 0x29, 0xC5, 0x89, 0x6F, 0xB7, 0x62, 0x0E, 0xAA, 0x18, 0xBE, 0x1B,
+  0xFC, 0x56, 0x3E, 0x4B, 0xC6, 0xD2, 0x79, 0x20, 0x9A, 0xDB, 0xC0, 0xFE, 0x78, 0xCD, 0x5A, 0xF4,
+  0x1F, 0xDD, 0xA8, 0x33, 0x88, 0x07, 0xC7, 0x31, 0xB1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xEC, 0x5F,
+  0x60, 0x51, 0x7F, 0xA9, 0x19, 0xB5, 0x4A, 0x0D, 0x2D, 0xE5, 0x7A, 0x9F, 0x93, 0xC9, 0x9C, 0xEF,
+  0xA0, 0xE0, 0x3B, 0x4D, 0xAE, 0x2A, 0xF5, 0xB0, 0xC8, 0xEB, 0xBB, 0x3C, 0x83, 0x53, 0x99, 0x61,
+  0x17, 0x2B, 0x04, 0x7E, 0xBA, 0x77, 0xD6, 0x26, 0xE1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0C, 0x7D
+};
+
+static const UInt8 gAESRoundConstants[10] = {
+  0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36
+};
+
+#define kWiiCryptoAESRounds   10
+
+//
+// Multiplies by x in GF(2^8).
+//
+static inline UInt8 multiplyAESX(UInt8 value) {
+  return (UInt8) ((value << 1) ^ ((value & 0x80) ? 0x1B : 0x00));
+}
+
+static inline UInt32 rotateLeft32(UInt32 value, UInt32 count) {
+  return (value << count) | (value >> (32 - count));
+}
+
+//
+// Adds a round key to the state. The state is column major, as the block is laid out in memory.
+//
+static inline void addAESRoundKey(UInt8 *state, const UInt32 *roundKeys) {
+  for (UInt32 column = 0; column < 4; column++) {
+    state[(column * 4) + 0] ^= (UInt8) (roundKeys[column] >> 24);
+    state[(column * 4) + 1] ^= (UInt8) (roundKeys[column] >> 16);
+    state[(column * 4) + 2] ^= (UInt8) (roundKeys[column] >> 8);
+    state[(column * 4) + 3] ^= (UInt8) roundKeys[column];
+  }
+}
+
+//
+// SubBytes and ShiftRows, or their inverses.
+//
+static inline void substituteAESState(UInt8 *state, const UInt8 *box, bool inverse) {
+  UInt8 temp[16];
+
+  for (UInt32 column = 0; column < 4; column++) {
+    for (UInt32 row = 0; row < 4; row++) {
+      if (inverse) {
+        temp[(((column + row) % 4) * 4) + row] = box[state[(column * 4) + row]];
+      } else {
+        temp[(column * 4) + row] = box[state[(((column + row) % 4) * 4) + row]];
+      }
+    }
+  }
+  bcopy(temp, state, sizeof (temp));
+}
+
+static inline void mixAESColumns(UInt8 *state) {
+  UInt8 *column;
+  UInt8 a0, a1, a2, a3;
+  UInt8 all;
+
+  for (UInt32 i = 0; i < 4; i++) {
+    column = &state[i * 4];
+    a0  = column[0];
+    a1  = column[1];
+    a2  = column[2];
+    a3  = column[3];
+    all = a0 ^ a1 ^ a2 ^ a3;
+
+    column[0] = a0 ^ all ^ multiplyAESX(a0 ^ a1);
+    column[1] = a1 ^ all ^ multiplyAESX(a1 ^ a2);
+    column[2] = a2 ^ all ^ multiplyAESX(a2 ^ a3);
+    column[3] = a3 ^ all ^ multiplyAESX(a3 ^ a0);
+  }
+}
+
+//
+// InvMixColumns is MixColumns after multiplying columns by {04}x^2 + {05}.
+//
+static inline void unmixAESColumns(UInt8 *state) {
+  UInt8 *column;
+  UInt8 even;
+  UInt8 odd;
+
+  for (UInt32 i = 0; i < 4; i++) {
+    column = &state[i * 4];
+    even = multiplyAESX(multiplyAESX(column[0] ^ column[2]));
+    odd  = multiplyAESX(multiplyAESX(column[1] ^ column[3]));
+
+    column[0] ^= even;
+    column[1] ^= odd;
+    column[2] ^= even;
+    column[3] ^= odd;
+  }
+  mixAESColumns(state);
+}
+
+static void encryptAESBlock(const UInt32 *roundKeys, UInt8 *state) {
+  addAESRoundKey(state, &roundKeys[0]);
+  for (UInt32 round = 1; round < kWiiCryptoAESRounds; round++) {
+    substituteAESState(state, gAESSBox, false);
+    mixAESColumns(state);
+    addAESRoundKey(state, &roundKeys[round * 4]);
+  }
+  substituteAESState(state, gAESSBox, false);
+  addAESRoundKey(state, &roundKeys[kWiiCryptoAESRounds * 4]);
+}
+
+static void decryptAESBlock(const UInt32 *roundKeys, UInt8 *state) {
+  addAESRoundKey(state, &roundKeys[kWiiCryptoAESRounds * 4]);
+  for (UInt32 round = kWiiCryptoAESRounds - 1; round > 0; round--) {
+    substituteAESState(state, gAESInvSBox, true);
+    addAESRoundKey(state, &roundKeys[round * 4]);
+    unmixAESColumns(state);
+  }
+  substituteAESState(state, gAESInvSBox, true);
+  addAESRoundKey(state, &roundKeys[0]);
+}
+
+//
+// Expands an AES-128 key into the round keys.
+//
+void WiiCrypto::expandAESKey(const UInt8 *key, UInt32 *roundKeys) {
+  UInt32 temp;
+
+  for (UInt32 i = 0; i < 4; i++) {
+    roundKeys[i] = ((UInt32) key[(i * 4) + 0] << 24) | ((UInt32) key[(i * 4) + 1] << 16)
+                 | ((UInt32) key[(i * 4) + 2] << 8) | (UInt32) key[(i * 4) + 3];
+  }
+
+  for (UInt32 i = 4; i < kWiiCryptoAESRoundKeyCount; i++) {
+    temp = roundKeys[i - 1];
+    if ((i % 4) == 0) {
+      temp = rotateLeft32(temp, 8);
+      temp = ((UInt32) gAESSBox[(temp >> 24) & 0xFF] << 24) | ((UInt32) gAESSBox[(temp >> 16) & 0xFF] << 16)
+           | ((UInt32) gAESSBox[(temp >> 8) & 0xFF] << 8) | (UInt32) gAESSBox[temp & 0xFF];
+      temp ^= (UInt32) gAESRoundConstants[(i / 4) - 1] << 24;
+    }
+    roundKeys[i] = roundKeys[i - 4] ^ temp;
+  }
+}
+
+//
+// Encrypts with AES-128-CBC, updating the IV to the last ciphertext block.
+//
+void WiiCrypto::encryptAESCBCSoftware(const UInt32 *roundKeys, UInt8 *iv, const UInt8 *in, UInt8 *out, IOByteCount length) {
+  for (IOByteCount offset = 0; offset < length; offset += kWiiCryptoAESBlockSize) {
+    for (UInt32 i = 0; i < kWiiCryptoAESBlockSize; i++) {
+      iv[i] ^= in[offset + i];
+    }
+    encryptAESBlock(roundKeys, iv);
+    bcopy(iv, &out[offset], kWiiCryptoAESBlockSize);
+  }
+}
+
+//
+// Decrypts with AES-128-CBC, updating the IV to the last ciphertext block. The buffers may be the same.
+//
+void WiiCrypto::decryptAESCBCSoftware(const UInt32 *roundKeys, UInt8 *iv, const UInt8 *in, UInt8 *out, IOByteCount length) {
+  UInt8 block[kWiiCryptoAESBlockSize];
+  UInt8 cipherBlock[kWiiCryptoAESBlockSize];
+
+  for (IOByteCount offset = 0; offset < length; offset += kWiiCryptoAESBlockSize) {
+    bcopy(&in[offset], cipherBlock, kWiiCryptoAESBlockSize);
+    bcopy(cipherBlock, block, kWiiCryptoAESBlockSize);
+    decryptAESBlock(roundKeys, block);
+
+    for (UInt32 i = 0; i < kWiiCryptoAESBlockSize; i++) {
+      out[offset + i] = block[i] ^ iv[i];
+    }
+    bcopy(cipherBlock, iv, kWiiCryptoAESBlockSize);
+  }
+}
+
+//
+// Hashes whole SHA-1 blocks into the hash state.
+//
+void WiiCrypto::hashSHA1Software(UInt32 *h, const UInt8 *data, IOByteCount length) {
+  UInt32 w[16];
+  UInt32 a, b, c, d, e;
+  UInt32 f, k, temp;
+
+  for (IOByteCount offset = 0; offset < length; offset += kWiiCryptoSHA1BlockSize) {
+    for (UInt32 i = 0; i < 16; i++) {
+      w[i] = ((UInt32) data[offset + (i * 4) + 0] << 24) | ((UInt32) data[offset + (i * 4) + 1] << 16)
+           | ((UInt32) data[offset + (i * 4) + 2] << 8) | (UInt32) data[offset + (i * 4) + 3];
+    }
+
+    a = h[0];
+    b = h[1];
+    c = h[2];
+    d = h[3];
+    e = h[4];
+
+    //
+    // The message schedule is kept as a rolling window of 16 words.
+    //
+    for (UInt32 i = 0; i < 80; i++) {
+      if (i >= 16) {
+        w[i % 16] = rotateLeft32(w[(i + 13) % 16] ^ w[(i + 8) % 16] ^ w[(i + 2) % 16] ^ w[i % 16], 1);
+      }
+
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+
+      temp = rotateLeft32(a, 5) + f + e + k + w[i % 16];
+      e    = d;
+      d    = c;
+      c    = rotateLeft32(b, 30);
+      b    = a;
+      a    = temp;
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+}
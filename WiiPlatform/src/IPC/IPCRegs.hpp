@@ -18,4 +18,30 @@
 #define kWiiIPCARMMSG        0x08
 #define kWiiIPCARMCTRL       0x0C
 
+#define kWiiIPCCTRLX1        BIT0
+#define kWiiIPCCTRLY2        BIT1
+#define kWiiIPCCTRLY1        BIT2
+#define kWiiIPCCTRLX2        BIT3
+#define kWiiIPCCTRLIY1       BIT4
+#define kWiiIPCCTRLIY2       BIT5
+
+//
+// Shared log ring (Cafe only).
+//
+// The ring is a cache-inhibited page, all fields are big endian.
+// Head is written by the PowerPC after data is written, tail by the ARM after data is consumed.
+// Both are free running and wrap at the data size.
+//
+#define kWiiIPCLogRingMagic       0x4C4F4752 // 'LOGR'
+#define kWiiIPCLogRingDataSize    2048
+
+typedef struct {
+  UInt32  magic;
+  UInt32  size;
+  UInt32  head;
+  UInt32  tail;
+  UInt32  reserved[4];
+  char    data[kWiiIPCLogRingDataSize];
+} WiiIPCLogRing;
+
 #endif
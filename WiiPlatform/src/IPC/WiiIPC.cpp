@@ -5,8 +5,8 @@
 //  Copyright © 2025 John Davis. All rights reserved.
 //
 
+#include <IOKit/IOBufferMemoryDescriptor.h>
 #include <IOKit/IOPlatformExpert.h>
-#include "IPCRegs.hpp"
 #include "WiiIPC.hpp"
 
 OSDefineMetaClassAndStructors(WiiIPC, super);
@@ -26,6 +26,10 @@ static WiiIPC *gWiiIPC;
 // Print (Cafe only).
 #define CMD_PRINT       0xCAFE6400
 #define CMD_PRINT_MASK  0xFFFFFF00
+// Set up the shared log ring (Cafe only), echoed in the ARM message if supported. Followed by the ring physical address.
+#define CMD_PRINT_RING_INIT   0xCAFE6500
+// Drain the shared log ring (Cafe only). Acknowledged before the ring is drained.
+#define CMD_PRINT_RING_FLUSH  0xCAFE6501
 
 static int handleWiiPEHaltRestart(unsigned int type) {
   return gWiiIPC->doHaltRestart(type);
@@ -37,8 +41,40 @@ static int handleWiiPEHaltRestart(unsigned int type) {
 bool WiiIPC::init(OSDictionary *dictionary) {
   WiiCheckDebugArgs();
 
-  _memoryMap    = NULL;
-  _baseAddr     = NULL;
+  _memoryMap             = NULL;
+  _baseAddr              = NULL;
+  _workLoop              = NULL;
+  _interruptEventSource  = NULL;
+  _commandGate           = NULL;
+  _ctrlIntEnable         = 0;
+
+  _syncTimeoutThreadCall = NULL;
+  _syncRequest           = NULL;
+  _syncBusy              = false;
+  _syncTimedOut          = false;
+  _syncGeneration        = 0;
+
+  //
+  // Build the free request list.
+  //
+  bzero(_requests, sizeof (_requests));
+  for (int i = 0; i < kWiiIPCRequestCount - 1; i++) {
+    _requests[i].next = &_requests[i + 1];
+  }
+  _freeRequestHeadPtr = &_requests[0];
+  _requestHeadPtr     = NULL;
+  _requestTailPtr     = NULL;
+  _logDoorbellRequest = NULL;
+
+  _logRingDesc    = NULL;
+  _logRing        = NULL;
+  _logRingReserve = 0;
+  _logRingCommit  = 0;
+
+  _messageLock = IOSimpleLockAlloc();
+  if (_messageLock == NULL) {
+    return false;
+  }
 
   return super::init(dictionary);
 }
@@ -66,6 +102,60 @@ bool WiiIPC::start(IOService *provider) {
   WIIDBGLOG("Mapped registers to %p (physical 0x%X), length: 0x%X", _baseAddr,
     _memoryMap->getPhysicalAddress(), _memoryMap->getLength());
 
+  //
+  // Use the IPC interrupt for acknowledgements if present, otherwise acknowledgements are polled.
+  //
+  if (provider->getProperty(gIOInterruptSpecifiersKey) != NULL) {
+    _workLoop = IOWorkLoop::workLoop();
+    if (_workLoop == NULL) {
+      WIISYSLOG("Failed to create work loop");
+      return false;
+    }
+
+    _interruptEventSource = IOInterruptEventSource::interruptEventSource(this,
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+      OSMemberFunctionCast(IOInterruptEventSource::Action, this, &WiiIPC::handleInterrupt),
+#else
+      (IOInterruptEventSource::Action) &WiiIPC::handleInterrupt,
+#endif
+      provider, 0);
+    if (_interruptEventSource == NULL) {
+      WIISYSLOG("Failed to create interrupt");
+      return false;
+    }
+    _workLoop->addEventSource(_interruptEventSource);
+    _interruptEventSource->enable();
+
+    _commandGate = IOCommandGate::commandGate(this);
+    if (_commandGate == NULL) {
+      WIISYSLOG("Failed to create command gate");
+      return false;
+    }
+    _workLoop->addEventSource(_commandGate);
+
+    _syncTimeoutThreadCall = thread_call_allocate(handleSyncTimeout, this);
+    if (_syncTimeoutThreadCall == NULL) {
+      WIISYSLOG("Failed to allocate sync timeout thread call");
+      return false;
+    }
+
+    _ctrlIntEnable = kWiiIPCCTRLIY1 | kWiiIPCCTRLIY2;
+    writeReg32(kWiiIPCPPCCTRL, _ctrlIntEnable | kWiiIPCCTRLY1 | kWiiIPCCTRLY2);
+  } else {
+    WIIDBGLOG("No IPC interrupt, acknowledgements will be polled");
+  }
+
+  //
+  // Switch logging to the shared ring if supported by the ARM firmware.
+  //
+  if (checkPlatformCafe()) {
+    if (initLogRing()) {
+      WIIDBGLOG("Using shared log ring at physical 0x%X", _logRingDesc->getPhysicalSegment(0, NULL));
+    } else {
+      WIIDBGLOG("Shared log ring not supported, using per-character logging");
+    }
+  }
+
   //
   // Register to handle halts and restarts.
   //
@@ -81,24 +171,16 @@ bool WiiIPC::start(IOService *provider) {
 IOReturn WiiIPC::callPlatformFunction(const OSSymbol *functionName, bool waitForFunction,
                                       void *param1, void *param2, void *param3, void *param4) {
   if (functionName->isEqualTo(kWiiFuncIPCGetRTCBias)) {
-    writeReg32(kWiiIPCPPCMSG, CMD_RTC_BIAS);
-    writeReg32(kWiiIPCPPCCTRL, 0x1);
-    while (readReg32(kWiiIPCPPCCTRL) & 0x1);
-    *((UInt32*) param1) = readReg32(kWiiIPCARMMSG);
-    return kIOReturnSuccess;
+    return sendMessageSync(CMD_RTC_BIAS, (UInt32 *) param1);
   } else if (functionName->isEqualTo(kWiiFuncIPCCafeLog)) {
     doLog((const char *) param1);
     return kIOReturnSuccess;
   } else if (functionName->isEqualTo(kWiiFuncIPCRvlStartFB)) {
-    writeReg32(kWiiIPCPPCMSG, CMD_START_FB);
-    writeReg32(kWiiIPCPPCCTRL, 0x1);
-    while (readReg32(kWiiIPCPPCCTRL) & 0x1);
-    return kIOReturnSuccess;
+    return sendMessageSync(CMD_START_FB, NULL);
   } else if (functionName->isEqualTo(kWiiFuncIPCRvlStopFB)) {
-    writeReg32(kWiiIPCPPCMSG, CMD_STOP_FB);
-    writeReg32(kWiiIPCPPCCTRL, 0x1);
-    while (readReg32(kWiiIPCPPCCTRL) & 0x1);
-    return kIOReturnSuccess;
+    return sendMessageSync(CMD_STOP_FB, NULL);
+  } else if (functionName->isEqualTo(kWiiFuncIPCSendMessageAsync)) {
+    return sendMessageAsync((UInt32) (uintptr_t) param1, (WiiIPCCompletion *) param2);
   }
 
   return super::callPlatformFunction(functionName, waitForFunction, param1, param2, param3, param4);
@@ -107,34 +189,534 @@ IOReturn WiiIPC::callPlatformFunction(const OSSymbol *functionName, bool waitFor
 //
 // Shuts down or restarts the system via IPC.
 //
+// The command is sent once messages already queued are acknowledged, spinning as this may be called with
+// interrupts disabled. If the ARM stops acknowledging, the command is written directly as a last resort.
+//
 int WiiIPC::doHaltRestart(unsigned int type) {
+  UInt32 message;
+
   WIIDBGLOG("Halt type: %u", type);
 
   switch (type) {
     case kPERestartCPU:
-      writeReg32(kWiiIPCPPCMSG, CMD_REBOOT);
-      writeReg32(kWiiIPCPPCCTRL, 0x1);
-      return 0;
+      message = CMD_REBOOT;
+      break;
 
     case kPEHaltCPU:
-      writeReg32(kWiiIPCPPCMSG, CMD_POWEROFF);
-      writeReg32(kWiiIPCPPCCTRL, 0x1);
-      return 0;
+      message = CMD_POWEROFF;
+      break;
 
     default:
       return -1;
   }
+
+  if (sendMessageSpin(message, NULL, kWiiIPCPollTimeoutUS) != kIOReturnSuccess) {
+    writeReg32(kWiiIPCPPCMSG, message);
+    writeReg32(kWiiIPCPPCCTRL, _ctrlIntEnable | kWiiIPCCTRLX1);
+  }
+  return 0;
+}
+
+//
+// Gets a free request.
+// Must be called with the message lock held.
+//
+WiiIPCRequest *WiiIPC::getFreeRequest(void) {
+  WiiIPCRequest *request;
+
+  request = _freeRequestHeadPtr;
+  if (request != NULL) {
+    _freeRequestHeadPtr = request->next;
+    request->next = NULL;
+  }
+  return request;
+}
+
+//
+// Returns a request to the free list.
+// Must be called with the message lock held.
+//
+void WiiIPC::returnRequest(WiiIPCRequest *request) {
+  request->next       = _freeRequestHeadPtr;
+  _freeRequestHeadPtr = request;
+}
+
+//
+// Sends a request's message to the ARM.
+// Must be called with the message lock held.
+//
+void WiiIPC::startRequest(WiiIPCRequest *request) {
+  writeReg32(kWiiIPCPPCMSG, request->message);
+  writeReg32(kWiiIPCPPCCTRL, _ctrlIntEnable | kWiiIPCCTRLX1);
+}
+
+//
+// Queues a message, sending it immediately if no other message is in flight.
+// Must be called with the message lock held.
+//
+WiiIPCRequest *WiiIPC::enqueueRequest(UInt32 message, WiiIPCCompletion *completion, bool isSync) {
+  WiiIPCRequest *request;
+
+  request = getFreeRequest();
+  if (request == NULL) {
+    return NULL;
+  }
+
+  request->message   = message;
+  request->reply     = 0;
+  request->status    = kIOReturnNotReady;
+  request->done      = false;
+  request->abandoned = false;
+  request->isSync    = isSync;
+  if (completion != NULL) {
+    request->completion = *completion;
+  } else {
+    bzero(&request->completion, sizeof (request->completion));
+  }
+
+  if (_requestTailPtr != NULL) {
+    _requestTailPtr->next = request;
+    _requestTailPtr       = request;
+  } else {
+    _requestHeadPtr = request;
+    _requestTailPtr = request;
+    startRequest(request);
+  }
+
+  return request;
+}
+
+//
+// Completes the in flight request if the ARM has acknowledged it, and sends the next one.
+// The ARM clears X1 once it has processed the message, with any reply in the ARM message register.
+// Returns a list of completed async requests that need their completions called.
+//
+// Must be called with the message lock held.
+//
+WiiIPCRequest *WiiIPC::checkRequests(void) {
+  WiiIPCRequest *request;
+  WiiIPCRequest *completedHeadPtr;
+  WiiIPCRequest *completedTailPtr;
+
+  completedHeadPtr = NULL;
+  completedTailPtr = NULL;
+  while ((_requestHeadPtr != NULL) && ((readReg32(kWiiIPCPPCCTRL) & kWiiIPCCTRLX1) == 0)) {
+    request = _requestHeadPtr;
+    request->reply  = readReg32(kWiiIPCARMMSG);
+    request->status = kIOReturnSuccess;
+
+    _requestHeadPtr = request->next;
+    if (_requestHeadPtr != NULL) {
+      startRequest(_requestHeadPtr);
+    } else {
+      _requestTailPtr = NULL;
+    }
+    request->next = NULL;
+
+    if (_logDoorbellRequest == request) {
+      _logDoorbellRequest = NULL;
+    }
+
+    if (request->isSync) {
+      if (request->abandoned) {
+        returnRequest(request);
+      } else {
+        request->done = true;
+      }
+    } else if (completedTailPtr != NULL) {
+      completedTailPtr->next = request;
+      completedTailPtr       = request;
+    } else {
+      completedHeadPtr = request;
+      completedTailPtr = request;
+    }
+  }
+
+  return completedHeadPtr;
+}
+
+//
+// Calls completions for completed async requests and frees them.
+// Must be called without the message lock held.
+//
+void WiiIPC::completeRequests(WiiIPCRequest *completedHeadPtr) {
+  IOInterruptState  intState;
+  WiiIPCRequest     *request;
+  WiiIPCRequest     *nextRequest;
+
+  request = completedHeadPtr;
+  while (request != NULL) {
+    nextRequest = request->next;
+    if (request->completion.action != NULL) {
+      request->completion.action(request->completion.target, request->completion.parameter,
+                                 request->status, request->reply);
+    }
+
+    intState = IOSimpleLockLockDisableInterrupt(_messageLock);
+    returnRequest(request);
+    IOSimpleLockUnlockEnableInterrupt(_messageLock, intState);
+    request = nextRequest;
+  }
+}
+
+//
+// Handles the IPC interrupt.
+// This function is called within the workloop context.
+//
+void WiiIPC::handleInterrupt(IOInterruptEventSource *intEventSource, int count) {
+  IOInterruptState  intState;
+  WiiIPCRequest     *completedHeadPtr;
+  UInt32            ctrl;
+
+  intState = IOSimpleLockLockDisableInterrupt(_messageLock);
+  ctrl = readReg32(kWiiIPCPPCCTRL);
+  writeReg32(kWiiIPCPPCCTRL, _ctrlIntEnable | (ctrl & (kWiiIPCCTRLY1 | kWiiIPCCTRLY2)));
+  completedHeadPtr = checkRequests();
+  IOSimpleLockUnlockEnableInterrupt(_messageLock, intState);
+
+  completeRequests(completedHeadPtr);
+
+  //
+  // Wake the sync waiter if its message has been acknowledged, here or by another thread checking.
+  //
+  if ((_syncRequest != NULL) && _syncRequest->done) {
+    _commandGate->commandWakeup(&_syncRequest);
+  }
+}
+
+//
+// Sends a message to the ARM without waiting.
+// The completion is optional, and is called once the ARM has acknowledged the message.
+// Without the IPC interrupt, completions are called when another message is sent or waited on.
+//
+IOReturn WiiIPC::sendMessageAsync(UInt32 message, WiiIPCCompletion *completion) {
+  IOInterruptState  intState;
+  WiiIPCRequest     *request;
+  WiiIPCRequest     *completedHeadPtr;
+
+  intState = IOSimpleLockLockDisableInterrupt(_messageLock);
+  completedHeadPtr = checkRequests();
+  request = enqueueRequest(message, completion, false);
+  IOSimpleLockUnlockEnableInterrupt(_messageLock, intState);
+
+  completeRequests(completedHeadPtr);
+  return (request != NULL) ? kIOReturnSuccess : kIOReturnNoResources;
+}
+
+//
+// Gets the result of a sync request once acknowledged or timed out, and frees it.
+// A timed out request is dropped if not yet sent, otherwise it is freed once acknowledged.
+//
+// Must be called with the message lock held.
+//
+IOReturn WiiIPC::finishSyncRequest(WiiIPCRequest *request, UInt32 *reply) {
+  WiiIPCRequest *prevRequest;
+
+  if (request->done) {
+    if (reply != NULL) {
+      *reply = request->reply;
+    }
+    returnRequest(request);
+    return kIOReturnSuccess;
+  }
+
+  if (request != _requestHeadPtr) {
+    prevRequest = _requestHeadPtr;
+    while (prevRequest->next != request) {
+      prevRequest = prevRequest->next;
+    }
+    prevRequest->next = request->next;
+    if (_requestTailPtr == request) {
+      _requestTailPtr = prevRequest;
+    }
+    returnRequest(request);
+  } else {
+    request->abandoned = true;
+  }
+  return kIOReturnTimeout;
+}
+
+//
+// Sends a message to the ARM and waits for it to be acknowledged.
+//
+// With the IPC interrupt, the calling thread sleeps until the interrupt sees the acknowledgement. This must
+// not be called from the IPC work loop or with interrupts disabled. Without it, acknowledgements are spun on.
+// Timeouts are not logged here, as logging itself may be going through IPC.
+//
+IOReturn WiiIPC::sendMessageSync(UInt32 message, UInt32 *reply, UInt32 timeoutMS) {
+  if (_commandGate == NULL) {
+    return sendMessageSpin(message, reply, timeoutMS * kWiiMicrosecondMS);
+  }
+
+  return _commandGate->runAction(
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+    OSMemberFunctionCast(IOCommandGate::Action, this, &WiiIPC::sendMessageSyncGated),
+#else
+    (IOCommandGate::Action) &WiiIPC::sendMessageSyncGated,
+#endif
+    &message, reply, &timeoutMS);
+}
+
+//
+// Sends a message to the ARM and sleeps until the IPC interrupt sees it acknowledged.
+// This function is called within the workloop context.
+//
+IOReturn WiiIPC::sendMessageSyncGated(UInt32 *message, UInt32 *reply, UInt32 *timeoutMS) {
+  IOInterruptState  intState;
+  WiiIPCRequest     *request;
+  WiiIPCRequest     *completedHeadPtr;
+  AbsoluteTime      deadline;
+  IOReturn          status;
+
+  //
+  // Only one sync message waits at a time, as they share the timeout thread call.
+  //
+  while (_syncBusy) {
+    _commandGate->commandSleep(&_syncBusy);
+  }
+  _syncBusy = true;
+
+  intState = IOSimpleLockLockDisableInterrupt(_messageLock);
+  completedHeadPtr = checkRequests();
+  request = enqueueRequest(*message, NULL, true);
+  IOSimpleLockUnlockEnableInterrupt(_messageLock, intState);
+  completeRequests(completedHeadPtr);
+
+  if (request != NULL) {
+    _syncRequest  = request;
+    _syncTimedOut = false;
+    _syncGeneration++;
+    clock_interval_to_deadline(*timeoutMS, kMillisecondScale, &deadline);
+    thread_call_enter1_delayed(_syncTimeoutThreadCall, (thread_call_param_t) (uintptr_t) _syncGeneration, deadline);
+
+    while (!request->done && !_syncTimedOut) {
+      _commandGate->commandSleep(&_syncRequest);
+    }
+    thread_call_cancel(_syncTimeoutThreadCall);
+    _syncRequest = NULL;
+
+    //
+    // Check once more, the acknowledgement may have arrived without an interrupt.
+    //
+    intState = IOSimpleLockLockDisableInterrupt(_messageLock);
+    completedHeadPtr = checkRequests();
+    status = finishSyncRequest(request, reply);
+    IOSimpleLockUnlockEnableInterrupt(_messageLock, intState);
+    completeRequests(completedHeadPtr);
+  } else {
+    status = kIOReturnNoResources;
+  }
+
+  _syncBusy = false;
+  _commandGate->commandWakeup(&_syncBusy, true);
+  return status;
+}
+
+//
+// Times out the sync message, if it is still the one the timeout was set for.
+// This function is called within the workloop context.
+//
+IOReturn WiiIPC::timeoutSyncGated(UInt32 *generation) {
+  if ((_syncRequest != NULL) && (*generation == _syncGeneration)) {
+    _syncTimedOut = true;
+    _commandGate->commandWakeup(&_syncRequest);
+  }
+  return kIOReturnSuccess;
+}
+
+//
+// Handles the sync message timeout thread call.
+//
+void WiiIPC::handleSyncTimeout(thread_call_param_t param0, thread_call_param_t param1) {
+  WiiIPC  *ipc        = (WiiIPC *) param0;
+  UInt32  generation  = (UInt32) (uintptr_t) param1;
+
+  ipc->_commandGate->runAction(
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+    OSMemberFunctionCast(IOCommandGate::Action, ipc, &WiiIPC::timeoutSyncGated),
+#else
+    (IOCommandGate::Action) &WiiIPC::timeoutSyncGated,
+#endif
+    &generation);
+}
+
+//
+// Sends a message to the ARM and spins until it is acknowledged, never sleeping.
+// Used without the IPC interrupt, and for logging and halting, which may happen with interrupts disabled.
+//
+IOReturn WiiIPC::sendMessageSpin(UInt32 message, UInt32 *reply, UInt32 timeoutUS) {
+  IOInterruptState  intState;
+  WiiIPCRequest     *request;
+  WiiIPCRequest     *completedHeadPtr;
+  AbsoluteTime      deadline;
+  AbsoluteTime      now;
+  bool              finished;
+  IOReturn          status;
+
+  intState = IOSimpleLockLockDisableInterrupt(_messageLock);
+  completedHeadPtr = checkRequests();
+  request = enqueueRequest(message, NULL, true);
+  IOSimpleLockUnlockEnableInterrupt(_messageLock, intState);
+
+  completeRequests(completedHeadPtr);
+  if (request == NULL) {
+    return kIOReturnNoResources;
+  }
+
+  //
+  // Each poll takes longer than its delay, the timeout is measured against the uptime clock instead of counted.
+  //
+  clock_interval_to_deadline(timeoutUS, kMicrosecondScale, &deadline);
+  while (true) {
+    clock_get_uptime(&now);
+    intState = IOSimpleLockLockDisableInterrupt(_messageLock);
+    completedHeadPtr = checkRequests();
+    finished = request->done || (CMP_ABSOLUTETIME(&now, &deadline) > 0);
+    if (finished) {
+      status = finishSyncRequest(request, reply);
+    }
+    IOSimpleLockUnlockEnableInterrupt(_messageLock, intState);
+
+    completeRequests(completedHeadPtr);
+    if (finished) {
+      break;
+    }
+
+    IODelay(kWiiIPCPollDelayUS);
+  }
+
+  return status;
+}
+
+//
+// Allocates the shared log ring and passes it to the ARM.
+// Older ARM firmware does not echo the setup command, and the per-character protocol remains in use.
+//
+bool WiiIPC::initLogRing(void) {
+  IOByteCount length;
+  UInt32      physAddr;
+  UInt32      reply;
+
+  //
+  // Allocate an entire page to ensure nothing else will occupy this cache-inhibited area.
+  //
+  _logRingDesc = IOBufferMemoryDescriptor::withOptions(kIOMemoryPhysicallyContiguous, PAGE_SIZE, PAGE_SIZE);
+  if (_logRingDesc == NULL) {
+    return false;
+  }
+  physAddr = _logRingDesc->getPhysicalSegment(0, &length);
+
+  if (IOSetProcessorCacheMode(kernel_task, (IOVirtualAddress) _logRingDesc->getBytesNoCopy(),
+                              PAGE_SIZE, kIOInhibitCache) != kIOReturnSuccess) {
+    _logRingDesc->release();
+    _logRingDesc = NULL;
+    return false;
+  }
+
+  bzero(_logRingDesc->getBytesNoCopy(), PAGE_SIZE);
+  OSWriteBigInt32(_logRingDesc->getBytesNoCopy(), offsetof (WiiIPCLogRing, magic), kWiiIPCLogRingMagic);
+  OSWriteBigInt32(_logRingDesc->getBytesNoCopy(), offsetof (WiiIPCLogRing, size), kWiiIPCLogRingDataSize);
+  sync();
+
+  if ((sendMessageSync(CMD_PRINT_RING_INIT, &reply) != kIOReturnSuccess) || (reply != CMD_PRINT_RING_INIT)) {
+    _logRingDesc->release();
+    _logRingDesc = NULL;
+    return false;
+  }
+  if (sendMessageSync(physAddr, NULL) != kIOReturnSuccess) {
+    _logRingDesc->release();
+    _logRingDesc = NULL;
+    return false;
+  }
+
+  _logRing = (volatile WiiIPCLogRing *) _logRingDesc->getBytesNoCopy();
+  return true;
+}
+
+//
+// Writes a string to the shared log ring, and rings the doorbell.
+//
+// Producers reserve space with a compare and swap, and publish the head in reservation order.
+// Strings that do not fit are truncated.
+//
+void WiiIPC::writeLogRing(const char *str) {
+  boolean_t intsEnabled;
+  UInt32    length;
+  UInt32    start;
+  UInt32    space;
+  UInt32    count;
+
+  length = strlen(str);
+  if (length == 0) {
+    return;
+  }
+
+  //
+  // Interrupts must be disabled, a producer interrupted between reserving and publishing would block any
+  // producer in the interrupt handler.
+  //
+  intsEnabled = ml_set_interrupts_enabled(false);
+
+  do {
+    start = _logRingReserve;
+    space = kWiiIPCLogRingDataSize - (start - OSReadBigInt32(&_logRing->tail, 0));
+    count = (length < space) ? length : space;
+  } while ((count != 0) && !OSCompareAndSwap(start, start + count, &_logRingReserve));
+
+  if (count != 0) {
+    for (UInt32 i = 0; i < count; i++) {
+      _logRing->data[(start + i) % kWiiIPCLogRingDataSize] = str[i];
+    }
+
+    //
+    // Wait for earlier reservations on other processors to publish.
+    //
+    while (_logRingCommit != start);
+    sync();
+    OSWriteBigInt32(&_logRing->head, 0, start + count);
+    _logRingCommit = start + count;
+    sync();
+  }
+
+  ringLogDoorbell();
+  ml_set_interrupts_enabled(intsEnabled);
+}
+
+//
+// Queues a doorbell for the shared log ring, unless one is pending that will pick up the current head.
+// The ARM acknowledges the doorbell before draining, a doorbell still unacknowledged after checking
+// for acknowledgements will see all data published so far.
+//
+void WiiIPC::ringLogDoorbell(void) {
+  IOInterruptState  intState;
+  WiiIPCRequest     *completedHeadPtr;
+
+  intState = IOSimpleLockLockDisableInterrupt(_messageLock);
+  completedHeadPtr = checkRequests();
+  if (_logDoorbellRequest == NULL) {
+    _logDoorbellRequest = enqueueRequest(CMD_PRINT_RING_FLUSH, NULL, false);
+  }
+  IOSimpleLockUnlockEnableInterrupt(_messageLock, intState);
+
+  completeRequests(completedHeadPtr);
 }
 
 //
 // Writes a string to the log.
 //
 void WiiIPC::doLog(const char *str) {
-  const char *strPtr = str;
+  const char *strPtr;
+
+  if (_logRing != NULL) {
+    writeLogRing(str);
+    return;
+  }
+
+  strPtr = str;
   while (*strPtr != 0) {
-    writeReg32(kWiiIPCPPCMSG, CMD_PRINT | (UInt32)(*strPtr));
-    writeReg32(kWiiIPCPPCCTRL, 0x1);
-    while (readReg32(kWiiIPCPPCCTRL) & 0x1);
+    if (sendMessageSpin(CMD_PRINT | (UInt32)(*strPtr), NULL, kWiiIPCPollTimeoutUS) != kIOReturnSuccess) {
+      break;
+    }
     strPtr++;
   }
 }
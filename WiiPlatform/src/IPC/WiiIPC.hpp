@@ -9,7 +9,35 @@
 #define WiiIPC_hpp
 
 #include <IOKit/IOService.h>
+#include <IOKit/IOCommandGate.h>
+#include <IOKit/IOInterruptEventSource.h>
+#include <IOKit/IOWorkLoop.h>
+#include <kern/thread_call.h>
 #include "WiiCommon.hpp"
+#include "IPCRegs.hpp"
+
+//
+// Outstanding IPC requests.
+// Only one message can be sent to the ARM at a time, the rest wait in a queue.
+//
+#define kWiiIPCRequestCount       32
+#define kWiiIPCDefaultTimeoutMS   5000
+// Spin limit for messages sent without the queue, and for sync messages without the IPC interrupt.
+#define kWiiIPCPollTimeoutUS      100000
+#define kWiiIPCPollDelayUS        1
+
+typedef struct WiiIPCRequest {
+  struct WiiIPCRequest  *next;
+  UInt32                message;
+  UInt32                reply;
+  IOReturn              status;
+  // Set when acknowledged, sync requests are then freed by the waiter.
+  bool                  done;
+  // Sync request whose waiter has timed out, freed on acknowledgement.
+  bool                  abandoned;
+  bool                  isSync;
+  WiiIPCCompletion      completion;
+} WiiIPCRequest;
 
 //
 // Represents the the IPC channel between ARM Starlet/Starbuck and the PowerPC Broadway/Espresso.
@@ -20,8 +48,33 @@ class WiiIPC : public IOService {
   typedef IOService super;
 
 private:
-  IOMemoryMap         *_memoryMap;
-  volatile void       *_baseAddr;
+  IOMemoryMap             *_memoryMap;
+  volatile void           *_baseAddr;
+  IOWorkLoop              *_workLoop;
+  IOInterruptEventSource  *_interruptEventSource;
+  IOCommandGate           *_commandGate;
+  UInt32                  _ctrlIntEnable;
+
+  // Sync message waiting for the IPC interrupt, one at a time. Protected by the command gate.
+  thread_call_t       _syncTimeoutThreadCall;
+  WiiIPCRequest       *_syncRequest;
+  bool                _syncBusy;
+  bool                _syncTimedOut;
+  UInt32              _syncGeneration;
+
+  // Request queue, protected by the message lock. The head of the queue is in flight.
+  IOSimpleLock        *_messageLock;
+  WiiIPCRequest       _requests[kWiiIPCRequestCount];
+  WiiIPCRequest       *_freeRequestHeadPtr;
+  WiiIPCRequest       *_requestHeadPtr;
+  WiiIPCRequest       *_requestTailPtr;
+  WiiIPCRequest       *_logDoorbellRequest;
+
+  // Shared log ring (Cafe only).
+  IOBufferMemoryDescriptor  *_logRingDesc;
+  volatile WiiIPCLogRing    *_logRing;
+  volatile UInt32           _logRingReserve;
+  volatile UInt32           _logRingCommit;
 
   inline UInt32 readReg32(UInt32 offset) {
     return OSReadBigInt32(_baseAddr, offset);
@@ -30,6 +83,23 @@ private:
     OSWriteBigInt32(_baseAddr, offset, data);
   }
 
+  WiiIPCRequest *getFreeRequest(void);
+  void returnRequest(WiiIPCRequest *request);
+  void startRequest(WiiIPCRequest *request);
+  WiiIPCRequest *enqueueRequest(UInt32 message, WiiIPCCompletion *completion, bool isSync);
+  WiiIPCRequest *checkRequests(void);
+  void completeRequests(WiiIPCRequest *completedHeadPtr);
+  void handleInterrupt(IOInterruptEventSource *intEventSource, int count);
+  IOReturn sendMessageSyncGated(UInt32 *message, UInt32 *reply, UInt32 *timeoutMS);
+  IOReturn timeoutSyncGated(UInt32 *generation);
+  static void handleSyncTimeout(thread_call_param_t param0, thread_call_param_t param1);
+  IOReturn finishSyncRequest(WiiIPCRequest *request, UInt32 *reply);
+  IOReturn sendMessageSpin(UInt32 message, UInt32 *reply, UInt32 timeoutUS);
+
+  bool initLogRing(void);
+  void writeLogRing(const char *str);
+  void ringLogDoorbell(void);
+
 public:
   //
   // Overrides.
@@ -39,6 +109,9 @@ public:
   IOReturn callPlatformFunction(const OSSymbol *functionName, bool waitForFunction,
                                 void *param1, void *param2, void *param3, void *param4);
 
+  IOReturn sendMessageAsync(UInt32 message, WiiIPCCompletion *completion);
+  IOReturn sendMessageSync(UInt32 message, UInt32 *reply, UInt32 timeoutMS = kWiiIPCDefaultTimeoutMS);
+
   int doHaltRestart(unsigned int type);
   void doLog(const char *str);
 };
@@ -21,6 +21,9 @@ bool HollywoodInterruptController::init(OSDictionary *dictionary) {
 
   _memoryMap  = NULL;
   _baseAddr   = NULL;
+  _priorityCount  = 0;
+  _spuriousCount  = 0;
+  bzero(_vectorStats, sizeof (_vectorStats));
 
   return super::init(dictionary);
 }
@@ -98,6 +101,11 @@ bool HollywoodInterruptController::start(IOService *provider) {
     return false;
   }
 
+  //
+  // Get the vector priority order.
+  //
+  _priorityCount = loadInterruptPriority(this, _priorityVectors, kWiiHollywoodICVectorCount);
+
   registerService();
 
   //
@@ -131,9 +139,9 @@ IOInterruptAction HollywoodInterruptController::getInterruptHandlerAddress(void)
 // Handles all incoming interrupts for this controller and forwards to the appropriate vectors.
 //
 IOReturn HollywoodInterruptController::handleInterrupt(void *refCon, IOService *nub, int source) {
-  IOInterruptVector *vector;
-  UInt32            cause;
-  UInt32            mask;
+  UInt32  cause;
+  UInt32  mask;
+  UInt32  pending;
 
   //
   // Get interrupt status/mask and ensure no spurious interrupt.
@@ -141,43 +149,16 @@ IOReturn HollywoodInterruptController::handleInterrupt(void *refCon, IOService *
   cause = readReg32(kWiiHollywoodICBroadwayIRQCause);
   mask  = readReg32(kWiiHollywoodICBroadwayIRQMask);
   if ((cause & mask) == 0) {
+    _spuriousCount++;
     return kIOReturnSuccess;
   }
   cause &= mask;
 
   //
-  // Check all vectors.
+  // Dispatch priority vectors first, then the remaining asserted vectors.
   //
-  for (int vectorIndex = 0; vectorIndex < kWiiHollywoodICVectorCount; vectorIndex++) {
-    //
-    // Check if this vector is active.
-    //
-    if ((cause & (1 << vectorIndex)) == 0) {
-      continue;
-    }
-
-    vector = &vectors[vectorIndex];
-    vector->interruptActive = 1;
-    sync();
-    isync();
-
-    if (!vector->interruptDisabledSoft) {
-      isync();
-
-      //
-      // Call the handler if it exists.
-      //
-      if (vector->interruptRegistered) {
-        vector->handler(vector->target, vector->refCon, vector->nub, vector->source);
-      }
-
-    } else {
-      vector->interruptDisabledHard = 1;
-      disableVectorHard(vectorIndex, vector);
-    }
-
-    vector->interruptActive = 0;
-  }
+  pending = cause;
+  dispatchPendingVectors(this, vectors, _vectorStats, _priorityVectors, _priorityCount, &pending, 1);
 
   //
   // Acknowledge all asserted interrupts on the controller. Any interrupts will be re-asserted if the
@@ -226,3 +207,13 @@ void HollywoodInterruptController::enableVector(IOInterruptVectorNumber vectorNu
   writeReg32(kWiiHollywoodICBroadwayIRQMask, mask);
   eieio();
 }
+
+//
+// Overrides IORegistryEntry::serializeProperties().
+//
+// Refreshes the interrupt statistics when properties are read.
+//
+bool HollywoodInterruptController::serializeProperties(OSSerialize *serialize) const {
+  publishInterruptStatistics((HollywoodInterruptController *) this, _vectorStats, kWiiHollywoodICVectorCount, _spuriousCount);
+  return super::serializeProperties(serialize);
+}
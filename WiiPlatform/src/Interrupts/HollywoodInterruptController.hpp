@@ -13,6 +13,7 @@
 
 #include "WiiCommon.hpp"
 #include "WiiHollywood.hpp"
+#include "WiiInterruptDispatch.hpp"
 
 //
 // Represents the Hollywood platform interrupt controller.
@@ -26,6 +27,12 @@ private:
   IOMemoryMap         *_memoryMap;
   volatile void       *_baseAddr;
 
+  // Vector dispatch order and statistics.
+  UInt8                   _priorityVectors[kWiiInterruptPriorityMaxCount];
+  UInt32                  _priorityCount;
+  UInt32                  _spuriousCount;
+  WiiInterruptVectorStats _vectorStats[kWiiHollywoodICVectorCount];
+
   inline UInt32 readReg32(UInt32 offset) {
     return OSReadBigInt32(_baseAddr, offset - kWiiHollywoodICOffset);
   }
@@ -44,6 +51,7 @@ public:
   int getVectorType(IOInterruptVectorNumber vectorNumber, IOInterruptVector *vector);
   void disableVectorHard(IOInterruptVectorNumber vectorNumber, IOInterruptVector *vector);
   void enableVector(IOInterruptVectorNumber vectorNumber, IOInterruptVector *vector);
+  bool serializeProperties(OSSerialize *serialize) const;
 };
 
 #endif
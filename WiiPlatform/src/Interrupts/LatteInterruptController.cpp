@@ -10,7 +10,7 @@
 #include <IOKit/IOPlatformExpert.h>
 
 #include "LatteInterruptController.hpp"
-#include "LatteRegs.hpp"
+#include "WiiCPU.hpp"
 #include "WiiProcessorInterface.hpp"
 
 OSDefineMetaClassAndStructors(LatteInterruptController, super);
@@ -24,6 +24,16 @@ bool LatteInterruptController::init(OSDictionary *dictionary) {
   _memoryMap  = NULL;
   _baseAddr   = NULL;
 
+  bzero(_vectorCore, sizeof (_vectorCore));
+  _priorityCount  = 0;
+  _spuriousCount  = 0;
+  bzero(_vectorStats, sizeof (_vectorStats));
+
+  _maskLock = IOSimpleLockAlloc();
+  if (_maskLock == NULL) {
+    return false;
+  }
+
   return super::init(dictionary);
 }
 
@@ -102,6 +112,11 @@ bool LatteInterruptController::start(IOService *provider) {
     return false;
   }
 
+  //
+  // Get the vector priority order.
+  //
+  _priorityCount = loadInterruptPriority(this, _priorityVectors, kWiiLatteIntVectorCount);
+
   registerService();
 
   //
@@ -133,73 +148,44 @@ IOInterruptAction LatteInterruptController::getInterruptHandlerAddress(void) {
 // Overrides IOInterruptController::handleInterrupt().
 //
 // Handles all incoming interrupts for this controller and forwards to the appropriate vectors.
+// Each core only sees the vectors that are steered to it.
 //
 IOReturn LatteInterruptController::handleInterrupt(void *refCon, IOService *nub, int source) {
-  IOInterruptVector *vector;
-  UInt32            cause0;
-  UInt32            cause1;
-  UInt32            mask0;
-  UInt32            mask1;
+  UInt32  core;
+  UInt32  cause0;
+  UInt32  cause1;
+  UInt32  mask0;
+  UInt32  mask1;
+  UInt32  pending[2];
 
   //
   // Get interrupt status/mask and ensure no spurious interrupt.
   //
-  cause0 = readReg32(kWiiLatteIntRegPPCInterruptCause0);
-  cause1 = readReg32(kWiiLatteIntRegPPCInterruptCause1);
-  mask0  = readReg32(kWiiLatteIntRegPPCInterruptMask0);
-  mask1  = readReg32(kWiiLatteIntRegPPCInterruptMask1);
+  core   = cpu_number();
+  cause0 = readCoreReg32(core, kWiiLatteIntRegPPCInterruptCause0);
+  cause1 = readCoreReg32(core, kWiiLatteIntRegPPCInterruptCause1);
+  mask0  = readCoreReg32(core, kWiiLatteIntRegPPCInterruptMask0);
+  mask1  = readCoreReg32(core, kWiiLatteIntRegPPCInterruptMask1);
   if (((cause0 & mask0) == 0) && ((cause1 & mask1) == 0)) {
+    _spuriousCount++;
     return kIOReturnSuccess;
   }
   cause0 &= mask0;
   cause1 &= mask1;
 
   //
-  // Check all vectors.
+  // Dispatch priority vectors first, then the remaining asserted vectors.
   //
-  for (int vectorIndex = 0; vectorIndex < kWiiLatteIntVectorCount; vectorIndex++) {
-    //
-    // Check if this vector is active.
-    //
-    if (vectorIndex < kWiiLatteIntVectorPerRegCount) {
-      if ((cause0 & (1 << vectorIndex)) == 0) {
-        continue;
-      }
-    } else {
-      if ((cause1 & (1 << (vectorIndex - kWiiLatteIntVectorPerRegCount))) == 0) {
-        continue;
-      }
-    }
-
-    vector = &vectors[vectorIndex];
-    vector->interruptActive = 1;
-    sync();
-    isync();
-
-    if (!vector->interruptDisabledSoft) {
-      isync();
-
-      //
-      // Call the handler if it exists.
-      //
-      if (vector->interruptRegistered) {
-        vector->handler(vector->target, vector->refCon, vector->nub, vector->source);
-      }
-
-    } else {
-      vector->interruptDisabledHard = 1;
-      disableVectorHard(vectorIndex, vector);
-    }
-
-    vector->interruptActive = 0;
-  }
+  pending[0] = cause0;
+  pending[1] = cause1;
+  dispatchPendingVectors(this, vectors, _vectorStats, _priorityVectors, _priorityCount, pending, 2);
 
   //
   // Acknowledge all asserted interrupts on the controller. Any interrupts will be re-asserted if the
   // respective handlers did not clear the underlying hardware interrupts.
   //
-  writeReg32(kWiiLatteIntRegPPCInterruptCause0, cause0);
-  writeReg32(kWiiLatteIntRegPPCInterruptCause1, cause1);
+  writeCoreReg32(core, kWiiLatteIntRegPPCInterruptCause0, cause0);
+  writeCoreReg32(core, kWiiLatteIntRegPPCInterruptCause1, cause1);
   eieio();
 
   return kIOReturnSuccess;
@@ -223,16 +209,11 @@ int LatteInterruptController::getVectorType(IOInterruptVectorNumber vectorNumber
 // Masks and disables the specified vector.
 //
 void LatteInterruptController::disableVectorHard(IOInterruptVectorNumber vectorNumber, IOInterruptVector *vector) {
-  UInt32 mask;
-  if (vectorNumber < kWiiLatteIntVectorPerRegCount) {
-    mask = readReg32(kWiiLatteIntRegPPCInterruptMask0);
-    mask &= ~(1 << vectorNumber);
-    writeReg32(kWiiLatteIntRegPPCInterruptMask0, mask);
-  } else {
-    mask = readReg32(kWiiLatteIntRegPPCInterruptMask1);
-    mask &= ~(1 << (vectorNumber - kWiiLatteIntVectorPerRegCount));
-    writeReg32(kWiiLatteIntRegPPCInterruptMask1, mask);
-  }
+  IOInterruptState intState;
+
+  intState = IOSimpleLockLockDisableInterrupt(_maskLock);
+  setVectorMaskBit(_vectorCore[vectorNumber], vectorNumber, false);
+  IOSimpleLockUnlockEnableInterrupt(_maskLock, intState);
   eieio();
 }
 
@@ -243,17 +224,122 @@ void LatteInterruptController::disableVectorHard(IOInterruptVectorNumber vectorN
 // Acknowledge before masking otherwise a false interrupt may occur when IOInterruptEventSource re-enables the vector.
 //
 void LatteInterruptController::enableVector(IOInterruptVectorNumber vectorNumber, IOInterruptVector *vector) {
+  IOInterruptState  intState;
+  UInt32            core;
+
+  intState = IOSimpleLockLockDisableInterrupt(_maskLock);
+  core = _vectorCore[vectorNumber];
+  if (vectorNumber < kWiiLatteIntVectorPerRegCount) {
+    writeCoreReg32(core, kWiiLatteIntRegPPCInterruptCause0, 1 << vectorNumber);
+  } else {
+    writeCoreReg32(core, kWiiLatteIntRegPPCInterruptCause1, 1 << (vectorNumber - kWiiLatteIntVectorPerRegCount));
+  }
+  setVectorMaskBit(core, vectorNumber, true);
+  IOSimpleLockUnlockEnableInterrupt(_maskLock, intState);
+  eieio();
+}
+
+//
+// Overrides IOService::callPlatformFunction().
+//
+IOReturn LatteInterruptController::callPlatformFunction(const OSSymbol *functionName, bool waitForFunction,
+                                                        void *param1, void *param2, void *param3, void *param4) {
+  if (functionName->isEqualTo(kWiiFuncIntSetVectorAffinity)) {
+    return setVectorAffinity((IOInterruptVectorNumber) param1, (UInt32) param2);
+  }
+
+  return super::callPlatformFunction(functionName, waitForFunction, param1, param2, param3, param4);
+}
+
+//
+// Sets or clears the mask bit for a vector on the specified core.
+// Must be called with the mask lock held.
+//
+void LatteInterruptController::setVectorMaskBit(UInt32 core, IOInterruptVectorNumber vectorNumber, bool enable) {
+  UInt32 offset;
+  UInt32 bit;
   UInt32 mask;
+
+  if (vectorNumber < kWiiLatteIntVectorPerRegCount) {
+    offset = kWiiLatteIntRegPPCInterruptMask0;
+    bit    = 1 << vectorNumber;
+  } else {
+    offset = kWiiLatteIntRegPPCInterruptMask1;
+    bit    = 1 << (vectorNumber - kWiiLatteIntVectorPerRegCount);
+  }
+
+  mask = readCoreReg32(core, offset);
+  if (enable) {
+    mask |= bit;
+  } else {
+    mask &= ~bit;
+  }
+  writeCoreReg32(core, offset, mask);
+}
+
+//
+// Steers a vector to the lowest running core in the specified mask.
+// Latte can deliver to multiple cores, but a level interrupt would then be handled by all of them at once.
+//
+IOReturn LatteInterruptController::setVectorAffinity(IOInterruptVectorNumber vectorNumber, UInt32 coreMask) {
+  IOInterruptState  intState;
+  UInt32            core;
+  UInt32            cascadeMask;
+  bool              enabled;
+  IOReturn          status;
+
+  if (vectorNumber >= kWiiLatteIntVectorCount) {
+    return kIOReturnBadArgument;
+  }
+
+  coreMask &= WiiCPU::getActiveCoreMask();
+  for (core = 0; core < kWiiPICafeCoreCount; core++) {
+    if (coreMask & (1 << core)) {
+      break;
+    }
+  }
+  if (core == kWiiPICafeCoreCount) {
+    core = 0;
+  }
+
+  //
+  // Move the vector to the new core if currently enabled.
+  //
+  intState = IOSimpleLockLockDisableInterrupt(_maskLock);
   if (vectorNumber < kWiiLatteIntVectorPerRegCount) {
-    mask = readReg32(kWiiLatteIntRegPPCInterruptMask0);
-    writeReg32(kWiiLatteIntRegPPCInterruptCause0, 1 << vectorNumber);
-    mask |= (1 << vectorNumber);
-    writeReg32(kWiiLatteIntRegPPCInterruptMask0, mask);
+    enabled = (readCoreReg32(_vectorCore[vectorNumber], kWiiLatteIntRegPPCInterruptMask0) & (1 << vectorNumber)) != 0;
   } else {
-    mask = readReg32(kWiiLatteIntRegPPCInterruptMask1);
-    writeReg32(kWiiLatteIntRegPPCInterruptCause1, 1 << (vectorNumber - 32));
-    mask |= (1 << (vectorNumber - kWiiLatteIntVectorPerRegCount));
-    writeReg32(kWiiLatteIntRegPPCInterruptMask1, mask);
+    enabled = (readCoreReg32(_vectorCore[vectorNumber], kWiiLatteIntRegPPCInterruptMask1)
+      & (1 << (vectorNumber - kWiiLatteIntVectorPerRegCount))) != 0;
+  }
+  if (enabled) {
+    setVectorMaskBit(_vectorCore[vectorNumber], vectorNumber, false);
+    setVectorMaskBit(core, vectorNumber, true);
   }
+  _vectorCore[vectorNumber] = core;
+
+  cascadeMask = BIT0;
+  for (int i = 0; i < kWiiLatteIntVectorCount; i++) {
+    cascadeMask |= (1 << _vectorCore[i]);
+  }
+  IOSimpleLockUnlockEnableInterrupt(_maskLock, intState);
   eieio();
+
+  //
+  // The Latte cascade on the processor interface must reach every core with vectors steered to it.
+  //
+  status = setInterruptAffinity(getProvider(), 0, cascadeMask);
+
+  WIIDBGLOG("Vector %u now on core %u", vectorNumber, core);
+  return status;
+}
+
+//
+// Overrides IORegistryEntry::serializeProperties().
+//
+// Refreshes the interrupt statistics when properties are read.
+//
+bool LatteInterruptController::serializeProperties(OSSerialize *serialize) const {
+  publishInterruptStatistics((LatteInterruptController *) this, _vectorStats, kWiiLatteIntVectorCount, _spuriousCount);
+  return super::serializeProperties(serialize);
 }
@@ -12,6 +12,8 @@
 #include <IOKit/IOInterruptController.h>
 
 #include "WiiCommon.hpp"
+#include "LatteRegs.hpp"
+#include "WiiInterruptDispatch.hpp"
 
 //
 // Represents the Latte chipset interrupt controller.
@@ -24,6 +26,14 @@ class LatteInterruptController : public IOInterruptController {
 private:
   IOMemoryMap         *_memoryMap;
   volatile void       *_baseAddr;
+  IOSimpleLock        *_maskLock;
+  UInt8               _vectorCore[kWiiLatteIntVectorCount];
+
+  // Vector dispatch order and statistics.
+  UInt8                   _priorityVectors[kWiiInterruptPriorityMaxCount];
+  UInt32                  _priorityCount;
+  UInt32                  _spuriousCount;
+  WiiInterruptVectorStats _vectorStats[kWiiLatteIntVectorCount];
 
   inline UInt32 readReg32(UInt32 offset) {
     return OSReadBigInt32(_baseAddr, offset);
@@ -31,6 +41,15 @@ private:
   inline void writeReg32(UInt32 offset, UInt32 data) {
     OSWriteBigInt32(_baseAddr, offset, data);
   }
+  inline UInt32 readCoreReg32(UInt32 core, UInt32 offset) {
+    return readReg32(offset + (core * kWiiLatteIntPPCRegistersLength));
+  }
+  inline void writeCoreReg32(UInt32 core, UInt32 offset, UInt32 data) {
+    writeReg32(offset + (core * kWiiLatteIntPPCRegistersLength), data);
+  }
+
+  void setVectorMaskBit(UInt32 core, IOInterruptVectorNumber vectorNumber, bool enable);
+  IOReturn setVectorAffinity(IOInterruptVectorNumber vectorNumber, UInt32 coreMask);
 
 public:
   //
@@ -43,6 +62,9 @@ public:
   int getVectorType(IOInterruptVectorNumber vectorNumber, IOInterruptVector *vector);
   void disableVectorHard(IOInterruptVectorNumber vectorNumber, IOInterruptVector *vector);
   void enableVector(IOInterruptVectorNumber vectorNumber, IOInterruptVector *vector);
+  IOReturn callPlatformFunction(const OSSymbol *functionName, bool waitForFunction,
+                                void *param1, void *param2, void *param3, void *param4);
+  bool serializeProperties(OSSerialize *serialize) const;
 };
 
 #endif
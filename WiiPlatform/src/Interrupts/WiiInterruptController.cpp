@@ -11,6 +11,7 @@
 
 #include "WiiInterruptController.hpp"
 #include "WiiProcessorInterface.hpp"
+#include "WiiCPU.hpp"
 
 OSDefineMetaClassAndStructors(WiiInterruptController, super);
 
@@ -24,6 +25,20 @@ bool WiiInterruptController::init(OSDictionary *dictionary) {
   _baseAddr   = NULL;
   _isCafe     = false;
 
+  for (int i = 0; i < kWiiPIVectorCount; i++) {
+    _vectorCoreMask[i] = BIT0;
+  }
+  bzero(_coreInterruptCounts, sizeof (_coreInterruptCounts));
+
+  _priorityCount  = 0;
+  _spuriousCount  = 0;
+  bzero(_vectorStats, sizeof (_vectorStats));
+
+  _maskLock = IOSimpleLockAlloc();
+  if (_maskLock == NULL) {
+    return false;
+  }
+
   return super::init(dictionary);
 }
 
@@ -101,14 +116,24 @@ bool WiiInterruptController::start(IOService *provider) {
     return false;
   }
 
+  //
+  // Get the vector priority order.
+  //
+  _priorityCount = loadInterruptPriority(this, _priorityVectors, kWiiPIVectorCount);
+
   registerService();
 
   //
   // Register this as the platform interrupt controller.
+  // On Wii U, each CPU dispatches its own external interrupts along with its IPIs.
   //
   getPlatform()->setCPUInterruptProperties(provider);
-  provider->registerInterrupt(0, this, getInterruptHandlerAddress(), 0);
-  provider->enableInterrupt(0);
+  if (_isCafe) {
+    WiiCPU::setPlatformInterruptController(this);
+  } else {
+    provider->registerInterrupt(0, this, getInterruptHandlerAddress(), 0);
+    provider->enableInterrupt(0);
+  }
 
   getPlatform()->registerInterruptController(interruptControllerName, this);
 
@@ -135,58 +160,38 @@ IOInterruptAction WiiInterruptController::getInterruptHandlerAddress(void) {
 // Handles all incoming interrupts for this controller and forwards to the appropriate vectors.
 //
 IOReturn WiiInterruptController::handleInterrupt(void *refCon, IOService *nub, int source) {
-  IOInterruptVector *vector;
-  UInt32            cause;
-  UInt32            mask;
+  return handleCoreInterrupt(_isCafe ? cpu_number() : 0);
+}
+
+//
+// Handles all incoming interrupts for this controller on the specified core and forwards to the appropriate vectors.
+// Called on the core that took the interrupt.
+//
+IOReturn WiiInterruptController::handleCoreInterrupt(UInt32 core) {
+  UInt32  cause;
+  UInt32  mask;
 
   //
   // Get interrupt status/mask and ensure no spurious interrupt.
   //
   if (_isCafe) {
-    cause = readCafeIntCause32(0); // TODO
-    mask  = readCafeIntMask32(0);
+    cause = readCafeIntCause32(core);
+    mask  = readCafeIntMask32(core);
   } else {
     cause = readReg32(kWiiPIRegInterruptCause);
     mask  = readReg32(kWiiPIRegInterruptMask);
   }
   if ((cause & mask) == 0) {
+    _spuriousCount++;
     return kIOReturnSuccess;
   }
   cause &= mask;
+  _coreInterruptCounts[core]++;
 
   //
-  // Check all vectors.
+  // Dispatch priority vectors first, then the remaining asserted vectors.
   //
-  for (int vectorIndex = 0; vectorIndex < kWiiPIVectorCount; vectorIndex++) {
-    //
-    // Check if this vector is active.
-    //
-    if ((cause & (1 << vectorIndex)) == 0) {
-      continue;
-    }
-
-    vector = &vectors[vectorIndex];
-    vector->interruptActive = 1;
-    sync();
-    isync();
-
-    if (!vector->interruptDisabledSoft) {
-      isync();
-
-      //
-      // Call the handler if it exists.
-      //
-      if (vector->interruptRegistered) {
-        vector->handler(vector->target, vector->refCon, vector->nub, vector->source);
-      }
-
-    } else {
-      vector->interruptDisabledHard = 1;
-      disableVectorHard(vectorIndex, vector);
-    }
-
-    vector->interruptActive = 0;
-  }
+  dispatchPendingVectors(this, vectors, _vectorStats, _priorityVectors, _priorityCount, &cause, 1);
 
   return kIOReturnSuccess;
 }
@@ -209,12 +214,20 @@ int WiiInterruptController::getVectorType(IOInterruptVectorNumber vectorNumber,
 // Masks and disables the specified vector.
 //
 void WiiInterruptController::disableVectorHard(IOInterruptVectorNumber vectorNumber, IOInterruptVector *vector) {
-  UInt32 mask;
+  IOInterruptState  intState;
+  UInt32            mask;
 
   if (_isCafe) {
-    mask = readCafeIntMask32(0);
-    mask &= ~(1 << vectorNumber);
-    writeCafeIntMask32(0, mask);
+    //
+    // Mask on all cores, the vector may have been moved since it was enabled.
+    //
+    intState = IOSimpleLockLockDisableInterrupt(_maskLock);
+    for (UInt32 core = 0; core < kWiiPICafeCoreCount; core++) {
+      mask = readCafeIntMask32(core);
+      mask &= ~(1 << vectorNumber);
+      writeCafeIntMask32(core, mask);
+    }
+    IOSimpleLockUnlockEnableInterrupt(_maskLock, intState);
   } else {
     mask = readReg32(kWiiPIRegInterruptMask);
     mask &= ~(1 << vectorNumber);
@@ -230,12 +243,19 @@ void WiiInterruptController::disableVectorHard(IOInterruptVectorNumber vectorNum
 // Unmasks and enables the specified vector.
 //
 void WiiInterruptController::enableVector(IOInterruptVectorNumber vectorNumber, IOInterruptVector *vector) {
-  UInt32 mask;
+  IOInterruptState  intState;
+  UInt32            mask;
 
   if (_isCafe) {
-    mask = readCafeIntMask32(0);
-    mask |= (1 << vectorNumber);
-    writeCafeIntMask32(0, mask);
+    intState = IOSimpleLockLockDisableInterrupt(_maskLock);
+    for (UInt32 core = 0; core < kWiiPICafeCoreCount; core++) {
+      if (_vectorCoreMask[vectorNumber] & (1 << core)) {
+        mask = readCafeIntMask32(core);
+        mask |= (1 << vectorNumber);
+        writeCafeIntMask32(core, mask);
+      }
+    }
+    IOSimpleLockUnlockEnableInterrupt(_maskLock, intState);
   } else {
     mask = readReg32(kWiiPIRegInterruptMask);
     mask |= (1 << vectorNumber);
@@ -244,3 +264,96 @@ void WiiInterruptController::enableVector(IOInterruptVectorNumber vectorNumber,
 
   eieio();
 }
+
+//
+// Overrides IOService::callPlatformFunction().
+//
+IOReturn WiiInterruptController::callPlatformFunction(const OSSymbol *functionName, bool waitForFunction,
+                                                      void *param1, void *param2, void *param3, void *param4) {
+  if (functionName->isEqualTo(kWiiFuncIntSetVectorAffinity)) {
+    return setVectorAffinity((IOInterruptVectorNumber) param1, (UInt32) param2);
+  }
+
+  return super::callPlatformFunction(functionName, waitForFunction, param1, param2, param3, param4);
+}
+
+//
+// Overrides IORegistryEntry::serializeProperties().
+//
+// Refreshes the per-core interrupt counts and interrupt statistics when properties are read.
+//
+bool WiiInterruptController::serializeProperties(OSSerialize *serialize) const {
+  OSArray   *counts;
+  OSNumber  *number;
+
+  counts = OSArray::withCapacity(kWiiPICafeCoreCount);
+  if (counts != NULL) {
+    for (UInt32 core = 0; core < (_isCafe ? kWiiPICafeCoreCount : 1); core++) {
+      number = OSNumber::withNumber(_coreInterruptCounts[core], 32);
+      if (number != NULL) {
+        counts->setObject(number);
+        number->release();
+      }
+    }
+    ((WiiInterruptController *) this)->setProperty(kWiiPICoreInterruptCountsKey, counts);
+    counts->release();
+  }
+  publishInterruptStatistics((WiiInterruptController *) this, _vectorStats, kWiiPIVectorCount, _spuriousCount);
+
+  return super::serializeProperties(serialize);
+}
+
+//
+// Steers a vector to the lowest running core in the specified mask (Wii U only).
+// A level interrupt delivered to multiple cores would be handled by all of them at once. The exception is a cascaded
+// controller, it steers its own vectors and needs its cascade to reach every core in the mask.
+//
+IOReturn WiiInterruptController::setVectorAffinity(IOInterruptVectorNumber vectorNumber, UInt32 coreMask) {
+  IOInterruptState  intState;
+  UInt32            mask;
+  bool              enabled;
+
+  if (!_isCafe) {
+    return kIOReturnUnsupported;
+  }
+  if (vectorNumber >= kWiiPIVectorCount) {
+    return kIOReturnBadArgument;
+  }
+
+  coreMask &= WiiCPU::getActiveCoreMask();
+  if (OSDynamicCast(IOInterruptController, (OSObject *) vectors[vectorNumber].target) == NULL) {
+    coreMask &= ~(coreMask - 1);
+  }
+  if (coreMask == 0) {
+    coreMask = BIT0;
+  }
+
+  //
+  // Move the vector if it is currently enabled on any core.
+  //
+  intState = IOSimpleLockLockDisableInterrupt(_maskLock);
+  enabled = false;
+  for (UInt32 core = 0; core < kWiiPICafeCoreCount; core++) {
+    if (readCafeIntMask32(core) & (1 << vectorNumber)) {
+      enabled = true;
+    }
+  }
+
+  _vectorCoreMask[vectorNumber] = coreMask;
+  if (enabled) {
+    for (UInt32 core = 0; core < kWiiPICafeCoreCount; core++) {
+      mask = readCafeIntMask32(core);
+      if (coreMask & (1 << core)) {
+        mask |= (1 << vectorNumber);
+      } else {
+        mask &= ~(1 << vectorNumber);
+      }
+      writeCafeIntMask32(core, mask);
+    }
+  }
+  IOSimpleLockUnlockEnableInterrupt(_maskLock, intState);
+  eieio();
+
+  WIIDBGLOG("Vector %u now on core mask 0x%X", vectorNumber, coreMask);
+  return kIOReturnSuccess;
+}
@@ -12,6 +12,9 @@
 #include <IOKit/IOInterruptController.h>
 #include "WiiCommon.hpp"
 #include "WiiProcessorInterface.hpp"
+#include "WiiInterruptDispatch.hpp"
+
+#define kWiiPICoreInterruptCountsKey  "CoreInterruptCounts"
 
 //
 // Represents the Wii platform interrupt controller.
@@ -26,6 +29,17 @@ private:
   volatile void       *_baseAddr;
   bool                _isCafe;
 
+  // Per-core vector steering (Wii U only).
+  IOSimpleLock        *_maskLock;
+  UInt32              _vectorCoreMask[kWiiPIVectorCount];
+  UInt32              _coreInterruptCounts[kWiiPICafeCoreCount];
+
+  // Vector dispatch order and statistics.
+  UInt8                   _priorityVectors[kWiiInterruptPriorityMaxCount];
+  UInt32                  _priorityCount;
+  UInt32                  _spuriousCount;
+  WiiInterruptVectorStats _vectorStats[kWiiPIVectorCount];
+
   inline UInt32 readReg32(UInt32 offset) {
     return OSReadBigInt32(_baseAddr, offset);
   }
@@ -33,18 +47,20 @@ private:
     OSWriteBigInt32(_baseAddr, offset, data);
   }
   inline UInt32 readCafeIntCause32(UInt32 core) {
-    return OSReadBigInt32(_baseAddr, kWiiPIRegCafeInterruptCauseBase + (core * 8));
+    return OSReadBigInt32(_baseAddr, kWiiPIRegCafeInterruptCause(core));
   }
   inline void writeCafeIntCause32(UInt32 core, UInt32 data) {
-    OSWriteBigInt32(_baseAddr, kWiiPIRegCafeInterruptCauseBase + (core * 8), data);
+    OSWriteBigInt32(_baseAddr, kWiiPIRegCafeInterruptCause(core), data);
   }
   inline UInt32 readCafeIntMask32(UInt32 core) {
-    return OSReadBigInt32(_baseAddr, kWiiPIRegCafeInterruptMaskBase + (core * 8));
+    return OSReadBigInt32(_baseAddr, kWiiPIRegCafeInterruptMask(core));
   }
   inline void writeCafeIntMask32(UInt32 core, UInt32 data) {
-    OSWriteBigInt32(_baseAddr, kWiiPIRegCafeInterruptMaskBase + (core * 8), data);
+    OSWriteBigInt32(_baseAddr, kWiiPIRegCafeInterruptMask(core), data);
   }
 
+  IOReturn setVectorAffinity(IOInterruptVectorNumber vectorNumber, UInt32 coreMask);
+
 public:
   //
   // Overrides.
@@ -56,6 +72,11 @@ public:
   int getVectorType(IOInterruptVectorNumber vectorNumber, IOInterruptVector *vector);
   void disableVectorHard(IOInterruptVectorNumber vectorNumber, IOInterruptVector *vector);
   void enableVector(IOInterruptVectorNumber vectorNumber, IOInterruptVector *vector);
+  IOReturn callPlatformFunction(const OSSymbol *functionName, bool waitForFunction,
+                                void *param1, void *param2, void *param3, void *param4);
+  bool serializeProperties(OSSerialize *serialize) const;
+
+  IOReturn handleCoreInterrupt(UInt32 core);
 };
 
 #endif
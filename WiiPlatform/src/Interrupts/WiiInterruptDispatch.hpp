@@ -0,0 +1,198 @@
+//
+//  WiiInterruptDispatch.hpp
+//  Wii platform interrupt controller dispatch helpers
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef WiiInterruptDispatch_hpp
+#define WiiInterruptDispatch_hpp
+
+#include <ppc/proc_reg.h>
+#include <IOKit/IOInterrupts.h>
+#include <IOKit/IOInterruptController.h>
+
+#include "WiiCommon.hpp"
+
+//
+// Controller personality property, array of vectors dispatched before all others in the order listed.
+// Remaining asserted vectors are dispatched highest vector first.
+//
+#define kWiiInterruptPriorityKey        "InterruptPriority"
+#define kWiiInterruptPriorityMaxCount   8
+
+//
+// Controller properties refreshed when properties are read.
+// Handler times are in processor timebase ticks.
+//
+#define kWiiInterruptStatisticsKey      "InterruptStatistics"
+#define kWiiInterruptSpuriousKey        "SpuriousInterrupts"
+#define kWiiInterruptStatVectorKey      "Vector"
+#define kWiiInterruptStatCountKey       "Count"
+#define kWiiInterruptStatSpuriousKey    "Spurious"
+#define kWiiInterruptStatTotalTicksKey  "TotalTicks"
+#define kWiiInterruptStatMaxTicksKey    "MaxTicks"
+
+//
+// Per-vector interrupt statistics.
+// Updated without locking from interrupt context, values are approximate if a vector is steered to multiple cores.
+//
+typedef struct {
+  UInt64  totalTicks;
+  UInt32  count;
+  UInt32  maxTicks;
+  UInt32  spuriousCount;
+} WiiInterruptVectorStats;
+
+//
+// Dispatches an asserted vector to its handler, recording handler time.
+// Vectors asserted without a registered handler are counted as spurious.
+//
+inline void dispatchInterruptVector(IOInterruptController *controller, IOInterruptVector *vectors,
+                                    WiiInterruptVectorStats *stats, IOInterruptVectorNumber vectorNumber) {
+  IOInterruptVector       *vector;
+  WiiInterruptVectorStats *vectorStats;
+  UInt64                  startTicks;
+  UInt32                  ticks;
+
+  vector      = &vectors[vectorNumber];
+  vectorStats = &stats[vectorNumber];
+  vector->interruptActive = 1;
+  sync();
+  isync();
+
+  if (!vector->interruptDisabledSoft) {
+    isync();
+
+    //
+    // Call the handler if it exists.
+    //
+    if (vector->interruptRegistered) {
+      startTicks = getProcessorTimebase();
+      vector->handler(vector->target, vector->refCon, vector->nub, vector->source);
+      ticks = (UInt32) (getProcessorTimebase() - startTicks);
+
+      vectorStats->count++;
+      vectorStats->totalTicks += ticks;
+      if (ticks > vectorStats->maxTicks) {
+        vectorStats->maxTicks = ticks;
+      }
+    } else {
+      vectorStats->spuriousCount++;
+    }
+
+  } else {
+    vector->interruptDisabledHard = 1;
+    controller->disableVectorHard(vectorNumber, vector);
+  }
+
+  vector->interruptActive = 0;
+}
+
+//
+// Dispatches all asserted vectors, priority vectors first in the order listed, then the rest highest vector first.
+// Pending holds a word for each 32 vectors, and is cleared as vectors are dispatched.
+//
+inline void dispatchPendingVectors(IOInterruptController *controller, IOInterruptVector *vectors, WiiInterruptVectorStats *stats,
+                                   const UInt8 *priorityVectors, UInt32 priorityCount, UInt32 *pending, UInt32 pendingCount) {
+  UInt32 vectorIndex;
+  UInt32 bit;
+
+  for (UInt32 i = 0; i < priorityCount; i++) {
+    vectorIndex = priorityVectors[i];
+    bit         = 1 << (vectorIndex & 31);
+    if (pending[vectorIndex >> 5] & bit) {
+      pending[vectorIndex >> 5] &= ~bit;
+      dispatchInterruptVector(controller, vectors, stats, vectorIndex);
+    }
+  }
+
+  for (UInt32 word = 0; word < pendingCount; word++) {
+    while (pending[word] != 0) {
+      vectorIndex = getHighestBit32(pending[word]);
+      pending[word] &= ~(1 << vectorIndex);
+      dispatchInterruptVector(controller, vectors, stats, (word * 32) + vectorIndex);
+    }
+  }
+}
+
+//
+// Loads the vector priority order from the controller personality.
+// Returns the number of priority vectors, invalid and duplicate entries are skipped.
+//
+inline UInt32 loadInterruptPriority(IOService *controller, UInt8 *priorityVectors, UInt32 vectorCount) {
+  OSArray   *priorityArray;
+  OSNumber  *vectorNumber;
+  UInt32    priorityCount;
+  UInt32    vector;
+  bool      duplicate;
+
+  priorityArray = OSDynamicCast(OSArray, controller->getProperty(kWiiInterruptPriorityKey));
+  if (priorityArray == NULL) {
+    return 0;
+  }
+
+  priorityCount = 0;
+  for (UInt32 i = 0; (i < priorityArray->getCount()) && (priorityCount < kWiiInterruptPriorityMaxCount); i++) {
+    vectorNumber = OSDynamicCast(OSNumber, priorityArray->getObject(i));
+    if (vectorNumber == NULL) {
+      continue;
+    }
+    vector = vectorNumber->unsigned32BitValue();
+    if (vector >= vectorCount) {
+      continue;
+    }
+
+    duplicate = false;
+    for (UInt32 j = 0; j < priorityCount; j++) {
+      if (priorityVectors[j] == vector) {
+        duplicate = true;
+      }
+    }
+    if (!duplicate) {
+      priorityVectors[priorityCount++] = vector;
+    }
+  }
+
+  return priorityCount;
+}
+
+//
+// Publishes interrupt statistics for all vectors that have been asserted.
+//
+inline void publishInterruptStatistics(IOService *controller, const WiiInterruptVectorStats *stats,
+                                       UInt32 vectorCount, UInt32 spuriousCount) {
+  OSArray       *statsArray;
+  OSDictionary  *vectorDict;
+
+  statsArray = OSArray::withCapacity(vectorCount);
+  if (statsArray == NULL) {
+    return;
+  }
+
+  for (UInt32 i = 0; i < vectorCount; i++) {
+    if ((stats[i].count == 0) && (stats[i].spuriousCount == 0)) {
+      continue;
+    }
+
+    vectorDict = OSDictionary::withCapacity(5);
+    if (vectorDict == NULL) {
+      break;
+    }
+
+    setDictionaryNumber(vectorDict, kWiiInterruptStatVectorKey, i, 32);
+    setDictionaryNumber(vectorDict, kWiiInterruptStatCountKey, stats[i].count, 32);
+    setDictionaryNumber(vectorDict, kWiiInterruptStatSpuriousKey, stats[i].spuriousCount, 32);
+    setDictionaryNumber(vectorDict, kWiiInterruptStatTotalTicksKey, stats[i].totalTicks, 64);
+    setDictionaryNumber(vectorDict, kWiiInterruptStatMaxTicksKey, stats[i].maxTicks, 32);
+
+    statsArray->setObject(vectorDict);
+    vectorDict->release();
+  }
+
+  controller->setProperty(kWiiInterruptStatisticsKey, statsArray);
+  controller->setProperty(kWiiInterruptSpuriousKey, spuriousCount, 32);
+  statsArray->release();
+}
+
+#endif
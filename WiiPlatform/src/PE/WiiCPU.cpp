@@ -8,25 +8,115 @@
 #include <IOKit/IODeviceTreeSupport.h>
 #include "WiiCPU.hpp"
 #include "WiiPE.hpp"
+#include "WiiInterruptController.hpp"
+#include "WiiProcessorInterface.hpp"
 
 OSDefineMetaClassAndStructors(WiiCPU, super);
 
 static IOCPUInterruptController *gCPUIC;
+static WiiInterruptController   *gPlatformIC;
+static IOSimpleLock             *gSCRLock;
+static UInt32                   gNumCPUs;
 
 //
 // Overrides IOCPU::init()
 //
 bool WiiCPU::init(OSDictionary *dictionary) {
   WiiCheckDebugArgs();
+
+  _ipiCount = 0;
+
+  //
+  // The system control register is shared by all cores.
+  //
+  if (gSCRLock == NULL) {
+    gSCRLock = IOSimpleLockAlloc();
+    if (gSCRLock == NULL) {
+      return false;
+    }
+  }
+
   return super::init(dictionary);
 }
 
+//
+// Sets the platform interrupt controller dispatched by each CPU (Wii U only).
+// On Wii U, external interrupts and IPIs share each core's interrupt line.
+//
+void WiiCPU::setPlatformInterruptController(WiiInterruptController *interruptController) {
+  gPlatformIC = interruptController;
+  sync();
+}
+
+//
+// Gets the mask of cores that are brought up, the same count given to the CPU interrupt controller.
+// Only the boot CPU is counted until it has started.
+//
+UInt32 WiiCPU::getActiveCoreMask(void) {
+  return (gNumCPUs > 1) ? ((1 << gNumCPUs) - 1) : BIT0;
+}
+
+//
+// Atomically sets and clears bits in the system control register.
+//
+void WiiCPU::updateSystemControl(UInt32 setBits, UInt32 clearBits) {
+  IOInterruptState intState;
+
+  intState = IOSimpleLockLockDisableInterrupt(gSCRLock);
+  writeSystemControl((readSystemControl() & ~clearBits) | setBits);
+  IOSimpleLockUnlockEnableInterrupt(gSCRLock, intState);
+}
+
+//
+// Gets the number of CPUs to bring up.
+// All CPUs counted here must start, the CPU interrupt controller waits for each of them before accepting handlers.
+//
+UInt32 WiiCPU::getCPUCount(void) {
+  IORegistryEntry     *cpusRegEntry;
+  IORegistryEntry     *cpuRegEntry;
+  OSIterator          *childIterator;
+  OSData              *tmpData;
+  UInt32              numCPUs;
+  UInt32              maxCPUs;
+
+  cpusRegEntry = fromPath("/cpus", gIODTPlane);
+  if (cpusRegEntry == NULL) {
+    WIISYSLOG("Failed to get /cpus from the device tree");
+    return 0;
+  }
+
+  numCPUs       = 0;
+  childIterator = cpusRegEntry->getChildIterator(gIODTPlane);
+  if (childIterator != NULL) {
+    while ((cpuRegEntry = OSDynamicCast(IORegistryEntry, childIterator->getNextObject())) != NULL) {
+      tmpData = OSDynamicCast(OSData, cpuRegEntry->getProperty("device_type"));
+      if ((tmpData != NULL) && (strcmp((char *)tmpData->getBytesNoCopy(), "cpu") == 0)) {
+        numCPUs++;
+      }
+    }
+    childIterator->release();
+  }
+  cpusRegEntry->release();
+
+  //
+  // Only Espresso has secondary cores, the cpus boot argument can limit them further.
+  //
+  maxCPUs = checkPlatformCafe() ? kWiiPICafeCoreCount : 1;
+  if (PE_parse_boot_arg("cpus", &numCPUs) && (numCPUs == 0)) {
+    numCPUs = 1;
+  }
+  if (numCPUs > maxCPUs) {
+    numCPUs = maxCPUs;
+  }
+
+  return numCPUs;
+}
+
 //
 // Overrides IOCPU::start()
 //
 bool WiiCPU::start(IOService *provider) {
   kern_return_t       result;
-  IORegistryEntry     *cpusRegEntry;
   OSData              *tmpData;
   UInt32              physCPU;
   ml_processor_info_t processor_info;
@@ -47,13 +137,10 @@ bool WiiCPU::start(IOService *provider) {
   //
   // Get total CPU count.
   //
-  _numCPUs = 0;
-  cpusRegEntry = fromPath("/cpus", gIODTPlane);
-  if (cpusRegEntry == NULL) {
-    WIISYSLOG("Failed to get /cpus from the device tree");
+  _numCPUs = getCPUCount();
+  if (_numCPUs == 0) {
     return false;
   }
-  _numCPUs = 1; // TODO: Only handle one CPU.
 
   //
   // Set physical CPU number from the "reg" property.
@@ -69,7 +156,7 @@ bool WiiCPU::start(IOService *provider) {
   //
   // Check if boot CPU.
   //
-  _isBootCPU = true;
+  _isBootCPU = false;
   tmpData = OSDynamicCast(OSData, provider->getProperty("state"));
   if (tmpData == 0) {
     WIISYSLOG("Failed to read state property");
@@ -78,12 +165,18 @@ bool WiiCPU::start(IOService *provider) {
   if (strcmp((char *)tmpData->getBytesNoCopy(), "running") == 0) {
     _isBootCPU = true;
   }
-  WIIDBGLOG("Physical CPU number: %u, boot CPU: %u", physCPU, _isBootCPU);
+  WIIDBGLOG("Physical CPU number: %u, boot CPU: %u, CPUs: %u", physCPU, _isBootCPU, _numCPUs);
 
   //
-  // Create the CPU interrupt controller.
+  // Create the CPU interrupt controller, with a vector for each CPU.
+  // Secondary CPUs wait for the boot CPU to register it.
+  //
+  // The boot CPU also sets the CPU count in XNU before any CPU is registered, ml_get_max_cpus() blocks until then.
   //
   if (_isBootCPU) {
+    ml_init_max_cpus(_numCPUs);
+    gNumCPUs = _numCPUs;
+
     gCPUIC = new IOCPUInterruptController;
     if (gCPUIC == NULL) {
       WIISYSLOG("Failed to create IOCPUInterruptController");
@@ -95,6 +188,8 @@ bool WiiCPU::start(IOService *provider) {
     }
     gCPUIC->attach(this);
     gCPUIC->registerCPUInterruptController();
+  } else if (physCPU < _numCPUs) {
+    waitForService(serviceMatching("IOCPUInterruptController"));
   }
 
   //
@@ -109,7 +204,7 @@ bool WiiCPU::start(IOService *provider) {
   if (physCPU < _numCPUs) {
     processor_info.cpu_id           = (cpu_id_t)this;
     processor_info.boot_cpu         = _isBootCPU;
-    processor_info.start_paddr      = 0x0100;
+    processor_info.start_paddr      = kWiiCPUResetVectorPhysAddr;
     processor_info.l2cr_value       = 0;
     processor_info.supports_nap     = false;
     processor_info.time_base_enable = NULL;
@@ -149,7 +244,10 @@ void WiiCPU::initCPU(bool boot) {
   }
   else
   {
-    // TODO
+    //
+    // Returning from sleep, the IPI handler registered at first start only needs to be enabled again.
+    //
+    cpuNub->enableInterrupt(0);
   }
 
   //
@@ -161,23 +259,65 @@ void WiiCPU::initCPU(bool boot) {
 //
 // Overrides IOCPU::quiesceCPU()
 //
+// Called on the CPU being stopped, after XNU has moved all work off of it.
+//
 void WiiCPU::quiesceCPU(void) {
-  // TODO
+  //
+  // The boot CPU is never stopped.
+  // Secondary cores clear their own wake bit, which puts them back into reset until started again.
+  //
+  if (_isBootCPU) {
+    return;
+  }
+
+  ml_set_interrupts_enabled(false);
+  updateSystemControl(0, kWiiCPUSCRWakeCore(getCPUNumber()));
+  while (true) {
+    __asm__ volatile("isync");
+  }
 }
 
 //
 // Overrides IOCPU::startCPU()
 //
+// Called on the boot CPU to start a secondary CPU.
+// XNU has already written the reset handler pointing at its CPU startup code, which the core
+// picks up from the system reset vector.
+//
 kern_return_t WiiCPU::startCPU(vm_offset_t start_paddr, vm_offset_t arg_paddr) {
-  // TODO
+  UInt32 cpuNumber;
+
+  cpuNumber = getCPUNumber();
+  if (!checkPlatformCafe() || (cpuNumber == 0) || (cpuNumber >= kWiiPICafeCoreCount)) {
+    return KERN_FAILURE;
+  }
+  if (start_paddr != kWiiCPUResetVectorPhysAddr) {
+    WIISYSLOG("Unexpected start address 0x%X for CPU %u", start_paddr, cpuNumber);
+    return KERN_FAILURE;
+  }
+
+  //
+  // The core starts with caches disabled, the reset handler and vectors must be in memory.
+  //
+  flushDataCachePhys(0, PAGE_SIZE);
+
+  WIIDBGLOG("Starting CPU %u, arg 0x%X", cpuNumber, arg_paddr);
+  updateSystemControl(kWiiCPUSCRWakeCore(cpuNumber), 0);
   return KERN_SUCCESS;
 }
 
 //
 // Overrides IOCPU::haltCPU()
 //
+// Stops a secondary CPU. XNU moves work off of the CPU and then calls quiesceCPU() on it.
+//
 void WiiCPU::haltCPU(void) {
-  // TODO
+  if (_isBootCPU) {
+    return;
+  }
+
+  setCPUState(kIOCPUStateStopped);
+  processor_exit(machProcessor);
 }
 
 //
@@ -189,11 +329,69 @@ const OSSymbol *WiiCPU::getCPUName(void) {
   return OSSymbol::withCString(tmpStr);
 }
 
+//
+// Overrides IOCPU::signalCPU()
+//
+// Sends an IPI to the target CPU.
+//
+void WiiCPU::signalCPU(IOCPU *target) {
+  if (!checkPlatformCafe()) {
+    super::signalCPU(target);
+    return;
+  }
+
+  updateSystemControl(kWiiCPUSCRIPIPending(target->getCPUNumber()), 0);
+}
+
+//
+// Overrides IORegistryEntry::serializeProperties().
+//
+// Refreshes the IPI count when properties are read.
+//
+bool WiiCPU::serializeProperties(OSSerialize *serialize) const {
+  ((WiiCPU *) this)->setProperty(kWiiCPUIPICountKey, _ipiCount, 32);
+  return super::serializeProperties(serialize);
+}
+
+//
+// Handles the external interrupt for this CPU.
+//
 void WiiCPU::ipiHandler(void *refCon, void *nub, int source) {
+  IOInterruptState  intState;
+  UInt32            cpuNumber;
+  UInt32            scr;
+  bool              ipiPending;
+
+  //
+  // On Wii, this is only used for IPIs.
+  //
+  if (!checkPlatformCafe()) {
+    if (ipi_handler != NULL) {
+      ipi_handler();
+    }
+    return;
+  }
+
   //
-  // Call the IPI handler for this CPU.
+  // On Wii U, check and acknowledge the IPI pending bit for this CPU, then dispatch any external interrupts.
   //
-  if (ipi_handler != NULL) {
-    ipi_handler();
+  cpuNumber = getCPUNumber();
+  intState  = IOSimpleLockLockDisableInterrupt(gSCRLock);
+  scr       = readSystemControl();
+  ipiPending = (scr & kWiiCPUSCRIPIPending(cpuNumber)) != 0;
+  if (ipiPending) {
+    writeSystemControl(scr & ~(kWiiCPUSCRIPIPending(cpuNumber)));
+  }
+  IOSimpleLockUnlockEnableInterrupt(gSCRLock, intState);
+
+  if (ipiPending) {
+    _ipiCount++;
+    if (ipi_handler != NULL) {
+      ipi_handler();
+    }
+  }
+
+  if (gPlatformIC != NULL) {
+    gPlatformIC->handleCoreInterrupt(cpuNumber);
   }
 }
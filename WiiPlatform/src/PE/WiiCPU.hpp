@@ -11,6 +11,23 @@
 #include <IOKit/IOCPU.h>
 #include "WiiCommon.hpp"
 
+//
+// Espresso system control register (Wii U only).
+// Cores 1 and 2 are held in reset until their wake bit is set, and start at the system reset vector.
+//
+// See https://github.com/linux-wiiu/linux-wiiu/blob/rewrite-6.6/arch/powerpc/platforms/wiiu/smp.c.
+//
+#define kWiiCPUSPRSystemControl       947
+#define kWiiCPUSCRWakeCore(core)      (0x00200000 >> (core))
+#define kWiiCPUSCRIPIPending(core)    (0x00040000 >> (core))
+
+// Start address passed to XNU, the system reset vector.
+#define kWiiCPUResetVectorPhysAddr    0x0100
+
+#define kWiiCPUIPICountKey            "IPICount"
+
+class WiiInterruptController;
+
 //
 // Represents a Wii platform CPU.
 //
@@ -22,7 +39,19 @@ class WiiCPU : public IOCPU {
 private:
   bool                _isBootCPU;
   UInt32              _numCPUs;
+  UInt32              _ipiCount;
 
+  inline UInt32 readSystemControl(void) {
+    UInt32 value;
+    __asm__ volatile("mfspr %0, %1" : "=r" (value) : "i" (kWiiCPUSPRSystemControl));
+    return value;
+  }
+  inline void writeSystemControl(UInt32 value) {
+    __asm__ volatile("sync; mtspr %0, %1; isync" : : "i" (kWiiCPUSPRSystemControl), "r" (value) : "memory");
+  }
+
+  void updateSystemControl(UInt32 setBits, UInt32 clearBits);
+  UInt32 getCPUCount(void);
   void ipiHandler(void *refCon, void *nub, int source);
 
 public:
@@ -35,7 +64,19 @@ public:
   void quiesceCPU(void);
   kern_return_t startCPU(vm_offset_t start_paddr, vm_offset_t arg_paddr);
   void haltCPU(void);
+  void signalCPU(IOCPU *target);
   const OSSymbol *getCPUName(void);
+  bool serializeProperties(OSSerialize *serialize) const;
+
+  //
+  // Sets the platform interrupt controller dispatched by each CPU (Wii U only).
+  //
+  static void setPlatformInterruptController(WiiInterruptController *interruptController);
+
+  //
+  // Gets the mask of cores that are brought up.
+  //
+  static UInt32 getActiveCoreMask(void);
 };
 
 #endif
@@ -0,0 +1,155 @@
+//
+//  WiiKernelSymbols.cpp
+//  Wii kernel symbol index
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "WiiKernelSymbols.hpp"
+
+OSDefineMetaClassAndStructors(WiiKernelSymbols, super);
+
+//
+// Hashes a symbol name (FNV-1a).
+//
+static inline UInt32 hashSymbolName(const char *name) {
+  UInt32 hash;
+
+  hash = 2166136261U;
+  while (*name != '\0') {
+    hash = (hash ^ (UInt8) *name++) * 16777619U;
+  }
+  return hash;
+}
+
+//
+// Checks if a symbol is a defined, non-debugging symbol with a valid name.
+//
+static inline bool isIndexableSymbol(const struct nlist *nlistSym, UInt32 strTabSize) {
+  return ((nlistSym->n_type & N_STAB) == 0) && ((nlistSym->n_type & N_TYPE) != N_UNDF)
+    && (nlistSym->n_un.n_strx != 0) && ((UInt32) nlistSym->n_un.n_strx < strTabSize);
+}
+
+//
+// Overrides OSObject::free().
+//
+void WiiKernelSymbols::free(void) {
+  if (_symIndex != NULL) {
+    IOFree(_symIndex, _symIndexSize * sizeof (UInt32));
+    _symIndex = NULL;
+  }
+
+  super::free();
+}
+
+//
+// Creates the index for a symbol table.
+// If the index cannot be allocated, lookups fall back to a linear search.
+//
+WiiKernelSymbols *WiiKernelSymbols::withSymbolTable(void *symTab, UInt32 numSymbols, const void *strTab, UInt32 strTabSize) {
+  WiiKernelSymbols *symbols;
+
+  if ((symTab == NULL) || (strTab == NULL)) {
+    return NULL;
+  }
+
+  symbols = new WiiKernelSymbols;
+  if (symbols == NULL) {
+    return NULL;
+  }
+  if (!symbols->init()) {
+    symbols->release();
+    return NULL;
+  }
+
+  symbols->WiiCheckDebugArgs();
+  symbols->_symTab           = (struct nlist *) symTab;
+  symbols->_symTabNumSymbols = numSymbols;
+  symbols->_strTab           = (const char *) strTab;
+  symbols->_strTabSize       = strTabSize;
+
+  if (!symbols->buildIndex()) {
+    symbols->WIISYSLOG("Failed to build kernel symbol index, using linear lookups");
+  }
+  return symbols;
+}
+
+//
+// Builds the hashed symbol index. Debugging and undefined symbols are not indexed,
+// if a name occurs more than once the first symbol is kept.
+//
+bool WiiKernelSymbols::buildIndex(void) {
+  const char  *symStr;
+  UInt32      indexedCount;
+  UInt32      bucket;
+  UInt32      mask;
+
+  indexedCount = 0;
+  for (UInt32 i = 0; i < _symTabNumSymbols; i++) {
+    if (isIndexableSymbol(&_symTab[i], _strTabSize)) {
+      indexedCount++;
+    }
+  }
+
+  //
+  // Keep the table at most half full so probe sequences stay short.
+  //
+  _symIndexSize = 1;
+  while (_symIndexSize < (indexedCount * 2)) {
+    _symIndexSize <<= 1;
+  }
+  _symIndex = (UInt32 *) IOMalloc(_symIndexSize * sizeof (UInt32));
+  if (_symIndex == NULL) {
+    _symIndexSize = 0;
+    return false;
+  }
+  bzero(_symIndex, _symIndexSize * sizeof (UInt32));
+  mask = _symIndexSize - 1;
+
+  for (UInt32 i = 0; i < _symTabNumSymbols; i++) {
+    if (!isIndexableSymbol(&_symTab[i], _strTabSize)) {
+      continue;
+    }
+
+    symStr = _strTab + _symTab[i].n_un.n_strx;
+    for (bucket = hashSymbolName(symStr) & mask; _symIndex[bucket] != 0; bucket = (bucket + 1) & mask) {
+      if (strcmp(symStr, _strTab + _symTab[_symIndex[bucket] - 1].n_un.n_strx) == 0) {
+        break;
+      }
+    }
+    if (_symIndex[bucket] == 0) {
+      _symIndex[bucket] = i + 1;
+    }
+  }
+
+  WIIDBGLOG("Indexed %u of %u kernel symbols in %u buckets", indexedCount, _symTabNumSymbols, _symIndexSize);
+  return true;
+}
+
+//
+// Finds a symbol, returning its value or zero if not found.
+//
+UInt32 WiiKernelSymbols::findSymbol(const char *symbolName) {
+  UInt32 bucket;
+  UInt32 mask;
+
+  if (_symIndex != NULL) {
+    mask = _symIndexSize - 1;
+    for (bucket = hashSymbolName(symbolName) & mask; _symIndex[bucket] != 0; bucket = (bucket + 1) & mask) {
+      if (strcmp(symbolName, _strTab + _symTab[_symIndex[bucket] - 1].n_un.n_strx) == 0) {
+        return _symTab[_symIndex[bucket] - 1].n_value;
+      }
+    }
+    return 0;
+  }
+
+  for (UInt32 i = 0; i < _symTabNumSymbols; i++) {
+    if (!isIndexableSymbol(&_symTab[i], _strTabSize)) {
+      continue;
+    }
+    if (strcmp(symbolName, _strTab + _symTab[i].n_un.n_strx) == 0) {
+      return _symTab[i].n_value;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,55 @@
+//
+//  WiiKernelSymbols.hpp
+//  Wii kernel symbol index
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef WiiKernelSymbols_hpp
+#define WiiKernelSymbols_hpp
+
+#include <IOKit/IOService.h>
+
+#include <mach-o/nlist.h>
+
+#include "WiiCommon.hpp"
+
+//
+// Represents a hashed index of the kernel's Mach-O symbol table.
+//
+class WiiKernelSymbols : public OSObject {
+  OSDeclareDefaultStructors(WiiKernelSymbols);
+  WiiDeclareLogFunctions("pe");
+  typedef OSObject super;
+
+private:
+  struct nlist  *_symTab;
+  UInt32        _symTabNumSymbols;
+  const char    *_strTab;
+  UInt32        _strTabSize;
+
+  //
+  // Open addressed with linear probing, buckets hold the symbol number plus one, zero is empty.
+  //
+  UInt32        *_symIndex;
+  UInt32        _symIndexSize;
+
+  bool buildIndex(void);
+
+public:
+  //
+  // Overrides.
+  //
+  void free(void);
+
+  //
+  // Symbol functions.
+  //
+  static WiiKernelSymbols *withSymbolTable(void *symTab, UInt32 numSymbols, const void *strTab, UInt32 strTabSize);
+  UInt32 findSymbol(const char *symbolName);
+  bool isIndexed(void) const {
+    return _symIndex != NULL;
+  }
+};
+
+#endif
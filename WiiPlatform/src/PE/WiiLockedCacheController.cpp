@@ -0,0 +1,381 @@
+//
+//  WiiLockedCacheController.cpp
+//  Wii locked L1 data cache scratchpad
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include <ppc/proc_reg.h>
+
+#include "WiiLockedCacheController.hpp"
+
+OSDefineMetaClassAndStructors(WiiLockedCacheController, super);
+
+//
+// dcbz_l r0, r9, allocates a zeroed line in the locked cache.
+// The kernel assembler does not know this instruction.
+//
+#define kWiiLCInstructionDcbzLR9      "0x100047EC"
+
+//
+// There is only one locked cache, the service functions are routed to its controller.
+//
+static WiiLockedCacheController *gLockedCacheController;
+static WiiLockedCacheService    gLockedCacheService;
+
+//
+// Overrides OSObject::free().
+//
+void WiiLockedCacheController::free(void) {
+  if (gLockedCacheController == this) {
+    gLockedCacheController = NULL;
+  }
+
+  if (_backingBuffer != NULL) {
+    IOFreeContiguous(_backingBuffer, kWiiLockedCacheSize);
+    _backingBuffer = NULL;
+  }
+  if (_sweepBuffer != NULL) {
+    IOFreeAligned(_sweepBuffer, kWiiLCSweepSize);
+    _sweepBuffer = NULL;
+  }
+  if (_lock != NULL) {
+    IOSimpleLockFree(_lock);
+    _lock = NULL;
+  }
+
+  super::free();
+}
+
+//
+// Creates the locked cache controller. The locked cache itself is not enabled until a buffer is allocated.
+//
+WiiLockedCacheController *WiiLockedCacheController::lockedCacheController(WiiInvalidateDataCacheFunc invalidateCacheFunc) {
+  WiiLockedCacheController *controller;
+
+  controller = new WiiLockedCacheController;
+  if (controller == NULL) {
+    return NULL;
+  }
+  if (!controller->init()) {
+    controller->release();
+    return NULL;
+  }
+
+  controller->WiiCheckDebugArgs();
+  controller->_invalidateCacheFunc = invalidateCacheFunc;
+  controller->_allocatedLines      = 0;
+  controller->_enabled             = false;
+  controller->_submittedCount      = 0;
+  bzero(controller->_lineMask, sizeof (controller->_lineMask));
+
+  controller->_lock = IOSimpleLockAlloc();
+  if (controller->_lock == NULL) {
+    controller->release();
+    return NULL;
+  }
+
+  controller->_backingBuffer = (UInt8 *) IOMallocContiguous(kWiiLockedCacheSize, PAGE_SIZE, &controller->_backingPhysAddr);
+  controller->_sweepBuffer   = (UInt8 *) IOMallocAligned(kWiiLCSweepSize, PAGE_SIZE);
+  if ((controller->_backingBuffer == NULL) || (controller->_sweepBuffer == NULL)) {
+    controller->release();
+    return NULL;
+  }
+
+  gLockedCacheService.allocate    = &WiiLockedCacheController::serviceAllocate;
+  gLockedCacheService.deallocate  = &WiiLockedCacheController::serviceDeallocate;
+  gLockedCacheService.load        = &WiiLockedCacheController::serviceLoad;
+  gLockedCacheService.store       = &WiiLockedCacheController::serviceStore;
+  gLockedCacheService.isComplete  = &WiiLockedCacheController::serviceIsComplete;
+  gLockedCacheService.wait        = &WiiLockedCacheController::serviceWait;
+  gLockedCacheController          = controller;
+
+  controller->WIIDBGLOG("Locked cache backing at %p (phys 0x%X)", controller->_backingBuffer, controller->_backingPhysAddr);
+  return controller;
+}
+
+//
+// Gets the locked cache service function table.
+//
+const WiiLockedCacheService *WiiLockedCacheController::getService(void) {
+  return &gLockedCacheService;
+}
+
+//
+// Locks half of the data cache and allocates every scratchpad line in it.
+//
+// Any dirty line in the ways being locked would be lost. Reading the sweep buffer evicts every line in the cache,
+// writing back dirty ones, and nothing else can dirty a line until HID2 is written as the sequence does not store.
+//
+// This relies on the L1 data cache being 32 KB, 8-way with 128 sets, and on its tree pseudo-LRU replacement.
+// The sweep buffer touches each set with 8 lines, 127 other lines apart. Tree pseudo-LRU only replaces every way
+// in 8 misses when nothing hits in between, a hit can leave an older line in place. The sweep buffer is
+// invalidated first, so none of its lines can hit. It is only ever read, so no data is lost.
+//
+// Host builds have no cache to lock, the scratchpad is the backing memory itself and dcbz_l only zeroes it.
+//
+// Must be called with the lock held and interrupts disabled.
+//
+void WiiLockedCacheController::enableLockedCache(void) {
+#if defined(__ppc__)
+  UInt8 *sweepPtr;
+#endif
+
+  flushDataCache(_backingBuffer, kWiiLockedCacheSize);
+  for (UInt32 i = 0; i < kWiiLCSweepSize; i += kWiiLockedCacheLineSize) {
+    invalidateLine(_sweepBuffer + i);
+  }
+
+#if defined(__ppc__)
+  sweepPtr = _sweepBuffer;
+  __asm__ volatile(
+    "mtctr  %2\n"
+    "1:\n"
+    "lwz    r0, 0(%0)\n"
+    "addi   %0, %0, 32\n"
+    "bdnz   1b\n"
+    "sync\n"
+    "mtspr  %5, %3\n"
+    "isync\n"
+    "mr     r9, %1\n"
+    "mtctr  %4\n"
+    "2:\n"
+    ".long  " kWiiLCInstructionDcbzLR9 "\n"
+    "addi   r9, r9, 32\n"
+    "bdnz   2b\n"
+    "sync\n"
+    : "+b" (sweepPtr)
+    : "b" (_backingBuffer), "r" (kWiiLCSweepSize / kWiiLockedCacheLineSize),
+      "r" (readHID2() | kWiiLCHID2LockedCacheEnable), "r" (kWiiLCLineCount), "i" (kWiiLCSPRHID2)
+    : "r0", "r9", "ctr", "memory");
+#else
+  writeHID2(readHID2() | kWiiLCHID2LockedCacheEnable);
+  bzero(_backingBuffer, kWiiLockedCacheSize);
+#endif
+
+  _enabled = true;
+  WIIDBGLOG("Enabled locked cache");
+}
+
+//
+// Discards the scratchpad lines and unlocks the data cache. DMA must not be in progress.
+//
+// Must be called with the lock held and interrupts disabled.
+//
+void WiiLockedCacheController::disableLockedCache(void) {
+  for (UInt32 i = 0; i < kWiiLockedCacheSize; i += kWiiLockedCacheLineSize) {
+    invalidateLine(_backingBuffer + i);
+  }
+  writeHID2(readHID2() & ~kWiiLCHID2LockedCacheEnable);
+
+  _enabled = false;
+  WIIDBGLOG("Disabled locked cache");
+}
+
+//
+// Checks if a ticket is complete. The DMA queue length counts commands not yet finished.
+//
+// Must be called with the lock held.
+//
+bool WiiLockedCacheController::checkTicket(WiiLockedCacheTicket ticket) {
+  return (SInt32) ((_submittedCount - getDMAQueueLength()) - ticket) >= 0;
+}
+
+//
+// Queues DMA between a scratchpad buffer and main memory, split into commands of at most 128 lines.
+//
+IOReturn WiiLockedCacheController::submitDMA(bool load, const void *buffer, IOPhysicalAddress physAddr,
+                                             IOByteCount length, WiiLockedCacheTicket *ticket) {
+  IOInterruptState  intState;
+  IOPhysicalAddress lcPhysAddr;
+  UInt32            lines;
+  UInt32            lengthField;
+
+  if ((buffer == NULL) || (ticket == NULL) || (length == 0)
+      || ((((vm_offset_t) buffer) | physAddr | length) & (kWiiLockedCacheLineSize - 1))
+      || ((const UInt8 *) buffer < _backingBuffer)
+      || (((const UInt8 *) buffer + length) > (_backingBuffer + kWiiLockedCacheSize))) {
+    return kIOReturnBadArgument;
+  }
+
+  //
+  // Main memory must be coherent with the data cache around the DMA, the engine does not snoop it.
+  //
+  if (load) {
+    flushDataCachePhys(physAddr, length);
+  } else {
+    _invalidateCacheFunc(physAddr, length, true);
+  }
+
+  lcPhysAddr = _backingPhysAddr + ((const UInt8 *) buffer - _backingBuffer);
+
+  intState = IOSimpleLockLockDisableInterrupt(_lock);
+  if (!_enabled) {
+    IOSimpleLockUnlockEnableInterrupt(_lock, intState);
+    return kIOReturnNotReady;
+  }
+
+  while (length > 0) {
+    lines       = length / kWiiLockedCacheLineSize;
+    lines       = (lines > kWiiLCDMAMaxLines) ? kWiiLCDMAMaxLines : lines;
+    lengthField = lines % kWiiLCDMAMaxLines;
+
+    while (getDMAQueueLength() >= kWiiLCDMAQueueMax);
+
+    writeDMA((physAddr & kWiiLCDMAAddressMask) | ((lengthField >> kWiiLCDMAUpperLengthShift) & kWiiLCDMAUpperLengthMask),
+             (lcPhysAddr & kWiiLCDMAAddressMask) | (load ? kWiiLCDMALowerLoad : 0)
+             | ((lengthField << 2) & kWiiLCDMALowerLengthMask) | kWiiLCDMALowerTrigger);
+    _submittedCount++;
+
+    physAddr   += lines * kWiiLockedCacheLineSize;
+    lcPhysAddr += lines * kWiiLockedCacheLineSize;
+    length     -= lines * kWiiLockedCacheLineSize;
+  }
+
+  *ticket = _submittedCount;
+  IOSimpleLockUnlockEnableInterrupt(_lock, intState);
+  return kIOReturnSuccess;
+}
+
+//
+// Allocates a scratchpad buffer, enabling the locked cache for the first buffer.
+//
+void *WiiLockedCacheController::allocate(IOByteCount length) {
+  IOInterruptState  intState;
+  UInt32            lines;
+  UInt32            runStart;
+  UInt32            runLength;
+
+  if ((length == 0) || (length > kWiiLockedCacheSize)) {
+    return NULL;
+  }
+  lines = (length + kWiiLockedCacheLineSize - 1) / kWiiLockedCacheLineSize;
+
+  intState = IOSimpleLockLockDisableInterrupt(_lock);
+
+  //
+  // First fit search for a run of free lines.
+  //
+  runStart  = 0;
+  runLength = 0;
+  for (UInt32 i = 0; (i < kWiiLCLineCount) && (runLength < lines); i++) {
+    if (_lineMask[i / 32] & (BIT0 << (i % 32))) {
+      runStart  = i + 1;
+      runLength = 0;
+    } else {
+      runLength++;
+    }
+  }
+  if (runLength < lines) {
+    IOSimpleLockUnlockEnableInterrupt(_lock, intState);
+    WIIDBGLOG("No run of %u free lines", lines);
+    return NULL;
+  }
+
+  for (UInt32 i = runStart; i < (runStart + lines); i++) {
+    _lineMask[i / 32] |= BIT0 << (i % 32);
+  }
+  _allocatedLines += lines;
+
+  if (!_enabled) {
+    enableLockedCache();
+  }
+  IOSimpleLockUnlockEnableInterrupt(_lock, intState);
+
+  return _backingBuffer + (runStart * kWiiLockedCacheLineSize);
+}
+
+//
+// Frees a scratchpad buffer, disabling the locked cache once no buffers remain.
+//
+void WiiLockedCacheController::deallocate(void *buffer, IOByteCount length) {
+  IOInterruptState  intState;
+  UInt32            lines;
+  UInt32            firstLine;
+
+  if ((buffer == NULL) || ((UInt8 *) buffer < _backingBuffer) || ((UInt8 *) buffer >= (_backingBuffer + kWiiLockedCacheSize))) {
+    WIISYSLOG("Invalid free of %p", buffer);
+    return;
+  }
+  firstLine = ((UInt8 *) buffer - _backingBuffer) / kWiiLockedCacheLineSize;
+  lines     = (length + kWiiLockedCacheLineSize - 1) / kWiiLockedCacheLineSize;
+
+  intState = IOSimpleLockLockDisableInterrupt(_lock);
+  for (UInt32 i = firstLine; i < (firstLine + lines); i++) {
+    _lineMask[i / 32] &= ~(BIT0 << (i % 32));
+  }
+  _allocatedLines -= lines;
+
+  if (_allocatedLines == 0) {
+    while (getDMAQueueLength() != 0);
+    disableLockedCache();
+  }
+  IOSimpleLockUnlockEnableInterrupt(_lock, intState);
+}
+
+//
+// Starts DMA from main memory into a scratchpad buffer.
+//
+IOReturn WiiLockedCacheController::load(void *buffer, IOPhysicalAddress physAddr, IOByteCount length, WiiLockedCacheTicket *ticket) {
+  return submitDMA(true, buffer, physAddr, length, ticket);
+}
+
+//
+// Starts DMA from a scratchpad buffer to main memory.
+//
+IOReturn WiiLockedCacheController::store(const void *buffer, IOPhysicalAddress physAddr, IOByteCount length, WiiLockedCacheTicket *ticket) {
+  return submitDMA(false, buffer, physAddr, length, ticket);
+}
+
+//
+// Checks if DMA for a ticket is complete.
+//
+bool WiiLockedCacheController::isComplete(WiiLockedCacheTicket ticket) {
+  IOInterruptState  intState;
+  bool              complete;
+
+  intState = IOSimpleLockLockDisableInterrupt(_lock);
+  complete = checkTicket(ticket);
+  IOSimpleLockUnlockEnableInterrupt(_lock, intState);
+  return complete;
+}
+
+//
+// Spins until DMA for a ticket is complete.
+//
+void WiiLockedCacheController::wait(WiiLockedCacheTicket ticket) {
+  while (!isComplete(ticket));
+}
+
+//
+// Service functions.
+//
+void *WiiLockedCacheController::serviceAllocate(IOByteCount length) {
+  return (gLockedCacheController != NULL) ? gLockedCacheController->allocate(length) : NULL;
+}
+
+void WiiLockedCacheController::serviceDeallocate(void *buffer, IOByteCount length) {
+  if (gLockedCacheController != NULL) {
+    gLockedCacheController->deallocate(buffer, length);
+  }
+}
+
+IOReturn WiiLockedCacheController::serviceLoad(void *buffer, IOPhysicalAddress physAddr, IOByteCount length,
+                                               WiiLockedCacheTicket *ticket) {
+  return (gLockedCacheController != NULL) ? gLockedCacheController->load(buffer, physAddr, length, ticket) : kIOReturnNotReady;
+}
+
+IOReturn WiiLockedCacheController::serviceStore(const void *buffer, IOPhysicalAddress physAddr, IOByteCount length,
+                                                WiiLockedCacheTicket *ticket) {
+  return (gLockedCacheController != NULL) ? gLockedCacheController->store(buffer, physAddr, length, ticket) : kIOReturnNotReady;
+}
+
+bool WiiLockedCacheController::serviceIsComplete(WiiLockedCacheTicket ticket) {
+  return (gLockedCacheController != NULL) ? gLockedCacheController->isComplete(ticket) : true;
+}
+
+void WiiLockedCacheController::serviceWait(WiiLockedCacheTicket ticket) {
+  if (gLockedCacheController != NULL) {
+    gLockedCacheController->wait(ticket);
+  }
+}
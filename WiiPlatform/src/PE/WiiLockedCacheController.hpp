@@ -0,0 +1,151 @@
+//
+//  WiiLockedCacheController.hpp
+//  Wii locked L1 data cache scratchpad
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef WiiLockedCacheController_hpp
+#define WiiLockedCacheController_hpp
+
+#include <IOKit/IOService.h>
+
+#include "WiiLockedCache.hpp"
+
+//
+// HID2 and locked cache DMA SPRs.
+//
+#define kWiiLCSPRHID2                 920
+#define kWiiLCSPRDMAUpper             922
+#define kWiiLCSPRDMALower             923
+
+#define kWiiLCHID2LockedCacheEnable   BIT28
+#define kWiiLCHID2DMAQueueLengthMask  BITRange(24, 27)
+#define kWiiLCHID2DMAQueueLengthShift 24
+
+//
+// DMA upper register holds the memory address and upper length bits, lower register holds the
+// locked cache address, direction, lower length bits, and trigger.
+// Lengths are in cache lines, zero is the maximum of 128.
+//
+#define kWiiLCDMAUpperLengthShift     2
+#define kWiiLCDMAUpperLengthMask      BITRange(0, 4)
+#define kWiiLCDMALowerLoad            BIT4
+#define kWiiLCDMALowerLengthMask      BITRange(2, 3)
+#define kWiiLCDMALowerTrigger         BIT1
+#define kWiiLCDMAAddressMask          (~(kWiiLockedCacheLineSize - 1))
+
+#define kWiiLCDMAMaxLines             128
+#define kWiiLCDMAQueueMax             15
+
+#define kWiiLCLineCount               (kWiiLockedCacheSize / kWiiLockedCacheLineSize)
+
+//
+// Sweep buffer covering the whole L1 data cache, 8 lines for each of its 128 sets.
+//
+#define kWiiLCSweepSize               (32 * kByte)
+
+//
+// Represents the locked cache scratchpad controller.
+//
+class WiiLockedCacheController : public OSObject {
+  OSDeclareDefaultStructors(WiiLockedCacheController);
+  WiiDeclareLogFunctions("lc");
+  typedef OSObject super;
+
+private:
+  IOSimpleLock                *_lock;
+  WiiInvalidateDataCacheFunc  _invalidateCacheFunc;
+
+  //
+  // Backing memory is never accessed while the cache is locked, its physical addresses tag the locked lines.
+  // The sweep buffer is read to evict everything else from the data cache before locking.
+  //
+  UInt8                       *_backingBuffer;
+  IOPhysicalAddress           _backingPhysAddr;
+  UInt8                       *_sweepBuffer;
+
+  UInt32                      _lineMask[kWiiLCLineCount / 32];
+  UInt32                      _allocatedLines;
+  bool                        _enabled;
+  WiiLockedCacheTicket        _submittedCount;
+
+  inline UInt32 readHID2(void) {
+#if defined(__ppc__)
+    UInt32 value;
+    __asm__ volatile("mfspr %0, %1" : "=r" (value) : "i" (kWiiLCSPRHID2));
+    return value;
+#elif defined(WII_HOST_TEST)
+    return hostReadSPR(kWiiLCSPRHID2);
+#else
+    return 0;
+#endif
+  }
+
+  inline void writeHID2(UInt32 value) {
+#if defined(__ppc__)
+    __asm__ volatile("sync; mtspr %0, %1; isync" : : "i" (kWiiLCSPRHID2), "r" (value) : "memory");
+#elif defined(WII_HOST_TEST)
+    hostWriteSPR(kWiiLCSPRHID2, value);
+#endif
+  }
+
+  //
+  // Queues a DMA command, writing the lower register triggers it.
+  //
+  inline void writeDMA(UInt32 upper, UInt32 lower) {
+#if defined(__ppc__)
+    __asm__ volatile("mtspr %0, %1" : : "i" (kWiiLCSPRDMAUpper), "r" (upper));
+    __asm__ volatile("mtspr %0, %1" : : "i" (kWiiLCSPRDMALower), "r" (lower) : "memory");
+#elif defined(WII_HOST_TEST)
+    hostWriteSPR(kWiiLCSPRDMAUpper, upper);
+    hostWriteSPR(kWiiLCSPRDMALower, lower);
+#endif
+  }
+
+  //
+  // Discards a line from the data cache without writing it back.
+  //
+  inline void invalidateLine(const void *buffer) {
+#if defined(__ppc__)
+    __asm__ volatile("dcbi 0, %0" : : "r" (buffer) : "memory");
+#endif
+  }
+
+  inline UInt32 getDMAQueueLength(void) {
+    return (readHID2() & kWiiLCHID2DMAQueueLengthMask) >> kWiiLCHID2DMAQueueLengthShift;
+  }
+
+  void enableLockedCache(void);
+  void disableLockedCache(void);
+  bool checkTicket(WiiLockedCacheTicket ticket);
+  IOReturn submitDMA(bool load, const void *buffer, IOPhysicalAddress physAddr, IOByteCount length, WiiLockedCacheTicket *ticket);
+
+  void *allocate(IOByteCount length);
+  void deallocate(void *buffer, IOByteCount length);
+  IOReturn load(void *buffer, IOPhysicalAddress physAddr, IOByteCount length, WiiLockedCacheTicket *ticket);
+  IOReturn store(const void *buffer, IOPhysicalAddress physAddr, IOByteCount length, WiiLockedCacheTicket *ticket);
+  bool isComplete(WiiLockedCacheTicket ticket);
+  void wait(WiiLockedCacheTicket ticket);
+
+  static void *serviceAllocate(IOByteCount length);
+  static void serviceDeallocate(void *buffer, IOByteCount length);
+  static IOReturn serviceLoad(void *buffer, IOPhysicalAddress physAddr, IOByteCount length, WiiLockedCacheTicket *ticket);
+  static IOReturn serviceStore(const void *buffer, IOPhysicalAddress physAddr, IOByteCount length, WiiLockedCacheTicket *ticket);
+  static bool serviceIsComplete(WiiLockedCacheTicket ticket);
+  static void serviceWait(WiiLockedCacheTicket ticket);
+
+public:
+  //
+  // Overrides.
+  //
+  void free(void);
+
+  //
+  // Locked cache functions.
+  //
+  static WiiLockedCacheController *lockedCacheController(WiiInvalidateDataCacheFunc invalidateCacheFunc);
+  const WiiLockedCacheService *getService(void);
+};
+
+#endif
@@ -0,0 +1,655 @@
+//
+//  WiiLogger.cpp
+//  Wii deferred debug logging
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include <ppc/proc_reg.h>
+
+#include "WiiLogger.hpp"
+
+OSDefineMetaClassAndStructors(WiiLogger, super);
+
+//
+// There is only one logger, the service functions are routed to it.
+//
+static WiiLogger      *gLogger;
+static WiiLogService  gLogService;
+
+//
+// Argument types of a format conversion.
+//
+typedef enum {
+  kWiiLogArgNone = 0,
+  kWiiLogArgInt,
+  kWiiLogArgLong,
+  kWiiLogArgLongLong,
+  kWiiLogArgPointer,
+  kWiiLogArgString,
+  kWiiLogArgInvalid
+} WiiLogArgType;
+
+typedef struct {
+  WiiLogArgType type;
+  UInt32        starCount;
+} WiiLogConversion;
+
+#define kWiiLogStringNull   0xFFFF
+
+//
+// Formats a single argument with up to two '*' width and precision arguments before it.
+//
+#define WiiLogFormatArgument(line, size, spec, starCount, stars, value)                       \
+  (((starCount) == 0) ? snprintf(line, size, spec, value) :                                   \
+  (((starCount) == 1) ? snprintf(line, size, spec, (stars)[0], value) :                       \
+                        snprintf(line, size, spec, (stars)[0], (stars)[1], value)))
+
+//
+// Parses a conversion specification starting at the '%', returning a pointer to its last character.
+// Only conversions supported by the kernel printf are accepted, anything else stops capturing and formatting.
+//
+static const char *parseLogConversion(const char *format, WiiLogConversion *conversion) {
+  UInt32 longCount;
+
+  conversion->type      = kWiiLogArgInvalid;
+  conversion->starCount = 0;
+  longCount             = 0;
+  format++;
+
+  //
+  // Flags, width, and precision.
+  //
+  while ((*format == '-') || (*format == '+') || (*format == ' ') || (*format == '#') || (*format == '0')) {
+    format++;
+  }
+  if (*format == '*') {
+    conversion->starCount++;
+    format++;
+  }
+  while ((*format >= '0') && (*format <= '9')) {
+    format++;
+  }
+  if (*format == '.') {
+    format++;
+    if (*format == '*') {
+      conversion->starCount++;
+      format++;
+    }
+    while ((*format >= '0') && (*format <= '9')) {
+      format++;
+    }
+  }
+
+  //
+  // Length modifiers.
+  //
+  while (*format == 'h') {
+    format++;
+  }
+  while (*format == 'l') {
+    longCount++;
+    format++;
+  }
+  if (*format == 'q') {
+    longCount = 2;
+    format++;
+  } else if (*format == 'z') {
+    longCount = 1;
+    format++;
+  }
+
+  switch (*format) {
+    case '%':
+      conversion->type = kWiiLogArgNone;
+      break;
+
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+    case 'c':
+      conversion->type = (longCount >= 2) ? kWiiLogArgLongLong : ((longCount == 1) ? kWiiLogArgLong : kWiiLogArgInt);
+      break;
+
+    case 'p':
+      conversion->type = kWiiLogArgPointer;
+      break;
+
+    case 's':
+      conversion->type = kWiiLogArgString;
+      break;
+
+    case '\0':
+      format--;
+      break;
+
+    default:
+      break;
+  }
+  return format;
+}
+
+//
+// Appends an argument to a record, aligned to 32 bits.
+//
+static bool appendRecordData(WiiLogRecord *record, const void *data, UInt32 length) {
+  UInt32 offset;
+
+  offset = (record->dataLength + 3) & ~3;
+  if ((offset + length) > sizeof (record->data)) {
+    return false;
+  }
+
+  bcopy(data, &record->data[offset], length);
+  record->dataLength = offset + length;
+  return true;
+}
+
+//
+// Appends a copy of a string argument to a record, truncated to the remaining space.
+//
+static bool appendRecordString(WiiLogRecord *record, const char *string) {
+  UInt16 length;
+  UInt32 maxLength;
+
+  if (string == NULL) {
+    length = kWiiLogStringNull;
+    return appendRecordData(record, &length, sizeof (length));
+  }
+
+  maxLength = (record->dataLength + 3) & ~3;
+  if ((maxLength + sizeof (length) + 1) > sizeof (record->data)) {
+    return false;
+  }
+  maxLength = sizeof (record->data) - maxLength - sizeof (length) - 1;
+
+  length = 0;
+  while ((length < maxLength) && (string[length] != '\0')) {
+    length++;
+  }
+
+  appendRecordData(record, &length, sizeof (length));
+  bcopy(string, &record->data[record->dataLength], length);
+  record->dataLength += length;
+  record->data[record->dataLength++] = '\0';
+  return true;
+}
+
+//
+// Reads an argument from a record.
+//
+static void readRecordData(const WiiLogRecord *record, UInt32 *offset, void *data, UInt32 length) {
+  *offset = (*offset + 3) & ~3;
+  bcopy(&record->data[*offset], data, length);
+  *offset += length;
+}
+
+//
+// Reads a string argument from a record.
+//
+static const char *readRecordString(const WiiLogRecord *record, UInt32 *offset) {
+  const char  *string;
+  UInt16      length;
+
+  readRecordData(record, offset, &length, sizeof (length));
+  if (length == kWiiLogStringNull) {
+    return NULL;
+  }
+
+  string = (const char *) &record->data[*offset];
+  *offset += length + 1;
+  return string;
+}
+
+//
+// Overrides OSObject::free().
+//
+void WiiLogger::free(void) {
+  if (gLogger == this) {
+    gLogger = NULL;
+  }
+
+  if (_ipcNotifier != NULL) {
+    _ipcNotifier->remove();
+    _ipcNotifier = NULL;
+  }
+  if (_drainThreadCall != NULL) {
+    thread_call_cancel(_drainThreadCall);
+    thread_call_free(_drainThreadCall);
+    _drainThreadCall = NULL;
+  }
+  for (UInt32 i = 0; i < kWiiLogMaxCPUCount; i++) {
+    if (_rings[i].records != NULL) {
+      IOFree(_rings[i].records, kWiiLogRingRecordCount * sizeof (WiiLogRecord));
+      _rings[i].records = NULL;
+    }
+  }
+  if (_drainLock != NULL) {
+    IOLockFree(_drainLock);
+    _drainLock = NULL;
+  }
+  OSSafeReleaseNULL(_ipcLogSymbol);
+
+  super::free();
+}
+
+//
+// Creates the logger, with a log ring for each CPU.
+//
+WiiLogger *WiiLogger::logger(void) {
+  WiiLogger *logger;
+
+  logger = new WiiLogger;
+  if (logger == NULL) {
+    return NULL;
+  }
+  if (!logger->init()) {
+    logger->release();
+    return NULL;
+  }
+
+  logger->_isCafe          = checkPlatformCafe();
+  logger->_cpuCount        = logger->_isCafe ? kWiiPICafeCoreCount : 1;
+  logger->_sequence        = 0;
+  logger->_drainPending    = 0;
+  logger->_drainThreadCall = NULL;
+  logger->_ipcNotifier     = NULL;
+  logger->_ipcService      = NULL;
+  logger->_ipcLogSymbol    = NULL;
+  bzero(logger->_rings, sizeof (logger->_rings));
+
+  for (UInt32 i = 0; i < logger->_cpuCount; i++) {
+    logger->_rings[i].records = (WiiLogRecord *) IOMalloc(kWiiLogRingRecordCount * sizeof (WiiLogRecord));
+    if (logger->_rings[i].records == NULL) {
+      logger->release();
+      return NULL;
+    }
+  }
+
+  logger->_drainLock = IOLockAlloc();
+  if (logger->_drainLock == NULL) {
+    logger->release();
+    return NULL;
+  }
+  logger->_drainThreadCall = thread_call_allocate(&WiiLogger::handleDrain, logger);
+  if (logger->_drainThreadCall == NULL) {
+    logger->release();
+    return NULL;
+  }
+
+  //
+  // Lines are also sent over IPC on Wii U once the IPC service is published.
+  // Anything logged before then only goes to the system log.
+  //
+  if (logger->_isCafe) {
+    logger->_ipcLogSymbol = OSSymbol::withCString(kWiiFuncIPCCafeLog);
+    if (logger->_ipcLogSymbol == NULL) {
+      logger->release();
+      return NULL;
+    }
+    logger->_ipcNotifier = IOService::addNotification(gIOPublishNotification, IOService::nameMatching("WiiIPC"),
+                                                      &WiiLogger::handleIPCPublished, logger);
+  }
+
+  gLogService.logLine     = &WiiLogger::serviceLogLine;
+  gLogService.logDeferred = &WiiLogger::serviceLogDeferred;
+  gLogger                 = logger;
+  return logger;
+}
+
+//
+// Gets the logging service function table.
+//
+const WiiLogService *WiiLogger::getService(void) {
+  return &gLogService;
+}
+
+//
+// Prints all pending lines.
+//
+void WiiLogger::flush(void) {
+  drain();
+}
+
+//
+// Prints a formatted line to the system log and IPC.
+//
+void WiiLogger::printLine(const char *line) {
+  IOService *ipcService;
+
+  IOLog("%s", line);
+
+  ipcService = _ipcService;
+  if (ipcService != NULL) {
+    ipcService->callPlatformFunction(_ipcLogSymbol, true, (void *) line, NULL, NULL, NULL);
+  }
+}
+
+//
+// Formats and prints a line immediately.
+//
+void WiiLogger::logLine(const char *className, const char *locationName, const char *funcName,
+                        const char *format, va_list va) {
+  char line[kWiiLogLineLength];
+
+  logFormatLine(line, className, locationName, funcName, format, va);
+  printLine(line);
+}
+
+//
+// Captures a line into the current CPU's log ring.
+// Interrupts are disabled while the record is written, so each ring only ever has a single writer.
+// Lines are dropped and counted if the ring is full.
+//
+void WiiLogger::logDeferred(const char *className, const char *locationName, const char *funcName,
+                            const char *format, va_list va) {
+  WiiLogRing        *ring;
+  WiiLogRecord      *record;
+  WiiLogConversion  conversion;
+  const char        *current;
+  boolean_t         interruptsEnabled;
+  AbsoluteTime      deadline;
+  UInt32            cpu;
+  int               intValue;
+  long              longValue;
+  long long         longLongValue;
+  void              *pointerValue;
+  bool              captured;
+
+  interruptsEnabled = ml_set_interrupts_enabled(false);
+  cpu = cpu_number();
+  if (cpu >= _cpuCount) {
+    ml_set_interrupts_enabled(interruptsEnabled);
+    return;
+  }
+
+  ring = &_rings[cpu];
+  if ((ring->head - ring->tail) >= kWiiLogRingRecordCount) {
+    ring->droppedCount++;
+    ml_set_interrupts_enabled(interruptsEnabled);
+    return;
+  }
+
+  record = &ring->records[ring->head & (kWiiLogRingRecordCount - 1)];
+  record->sequence      = OSIncrementAtomic(&_sequence);
+  record->className     = className;
+  record->locationName  = locationName;
+  record->funcName      = funcName;
+  record->format        = format;
+  record->dataLength    = 0;
+  record->argumentCount = 0;
+  record->flags         = 0;
+
+  //
+  // Store the arguments by walking the format, the types are not otherwise known.
+  //
+  for (current = format; *current != '\0'; current++) {
+    if (*current != '%') {
+      continue;
+    }
+
+    current = parseLogConversion(current, &conversion);
+    if (conversion.type == kWiiLogArgNone) {
+      continue;
+    } else if (conversion.type == kWiiLogArgInvalid) {
+      break;
+    }
+
+    captured = true;
+    for (UInt32 i = 0; i < conversion.starCount; i++) {
+      intValue = va_arg(va, int);
+      captured &= appendRecordData(record, &intValue, sizeof (intValue));
+    }
+
+    switch (conversion.type) {
+      case kWiiLogArgInt:
+        intValue = va_arg(va, int);
+        captured &= appendRecordData(record, &intValue, sizeof (intValue));
+        break;
+
+      case kWiiLogArgLong:
+        longValue = va_arg(va, long);
+        captured &= appendRecordData(record, &longValue, sizeof (longValue));
+        break;
+
+      case kWiiLogArgLongLong:
+        longLongValue = va_arg(va, long long);
+        captured &= appendRecordData(record, &longLongValue, sizeof (longLongValue));
+        break;
+
+      case kWiiLogArgPointer:
+        pointerValue = va_arg(va, void *);
+        captured &= appendRecordData(record, &pointerValue, sizeof (pointerValue));
+        break;
+
+      case kWiiLogArgString:
+        captured &= appendRecordString(record, va_arg(va, const char *));
+        break;
+
+      default:
+        break;
+    }
+
+    if (!captured) {
+      record->flags |= kWiiLogRecordFlagTruncated;
+      break;
+    }
+    record->argumentCount++;
+  }
+
+  //
+  // Record must be visible to the drain before the head is.
+  //
+  eieio();
+  ring->head++;
+  ml_set_interrupts_enabled(interruptsEnabled);
+
+  //
+  // Drain shortly after, so a burst of lines only wakes the drain thread once.
+  //
+  if (OSCompareAndSwap(0, 1, &_drainPending)) {
+    clock_interval_to_deadline(kWiiLogDrainDelayMS, kMillisecondScale, &deadline);
+    thread_call_enter_delayed(_drainThreadCall, deadline);
+  }
+}
+
+//
+// Formats a captured line, one conversion at a time with its stored arguments.
+//
+void WiiLogger::formatRecord(const WiiLogRecord *record, char *line) {
+  WiiLogConversion  conversion;
+  const char        *current;
+  const char        *start;
+  char              spec[kWiiLogSpecLength];
+  int               stars[2];
+  int               length;
+  int               written;
+  int               size;
+  UInt32            offset;
+  UInt32            argumentIndex;
+  int               intValue;
+  long              longValue;
+  long long         longLongValue;
+  void              *pointerValue;
+
+  length        = logFormatPrefix(line, record->className, record->locationName, record->funcName);
+  offset        = 0;
+  argumentIndex = 0;
+
+  for (current = record->format; (*current != '\0') && (length < (kWiiLogLineLength - 2)); current++) {
+    if (*current != '%') {
+      line[length++] = *current;
+      continue;
+    }
+
+    start   = current;
+    current = parseLogConversion(current, &conversion);
+    if (conversion.type == kWiiLogArgNone) {
+      line[length++] = '%';
+      continue;
+    }
+    if ((conversion.type == kWiiLogArgInvalid) || (argumentIndex >= record->argumentCount)
+        || ((current - start + 1) >= kWiiLogSpecLength)) {
+      break;
+    }
+
+    bcopy(start, spec, current - start + 1);
+    spec[current - start + 1] = '\0';
+    for (UInt32 i = 0; i < conversion.starCount; i++) {
+      readRecordData(record, &offset, &stars[i], sizeof (stars[i]));
+    }
+
+    size = kWiiLogLineLength - 1 - length;
+    switch (conversion.type) {
+      case kWiiLogArgInt:
+        readRecordData(record, &offset, &intValue, sizeof (intValue));
+        written = WiiLogFormatArgument(&line[length], size, spec, conversion.starCount, stars, intValue);
+        break;
+
+      case kWiiLogArgLong:
+        readRecordData(record, &offset, &longValue, sizeof (longValue));
+        written = WiiLogFormatArgument(&line[length], size, spec, conversion.starCount, stars, longValue);
+        break;
+
+      case kWiiLogArgLongLong:
+        readRecordData(record, &offset, &longLongValue, sizeof (longLongValue));
+        written = WiiLogFormatArgument(&line[length], size, spec, conversion.starCount, stars, longLongValue);
+        break;
+
+      case kWiiLogArgPointer:
+        readRecordData(record, &offset, &pointerValue, sizeof (pointerValue));
+        written = WiiLogFormatArgument(&line[length], size, spec, conversion.starCount, stars, pointerValue);
+        break;
+
+      case kWiiLogArgString:
+        written = WiiLogFormatArgument(&line[length], size, spec, conversion.starCount, stars,
+                                       readRecordString(record, &offset));
+        break;
+
+      default:
+        written = 0;
+        break;
+    }
+
+    if (written > 0) {
+      length += (written < size) ? written : (size - 1);
+    }
+    argumentIndex++;
+  }
+
+  //
+  // Mark lines whose arguments did not fit in the record.
+  //
+  if ((record->flags & kWiiLogRecordFlagTruncated) && (length < (kWiiLogLineLength - 5))) {
+    bcopy("...", &line[length], 3);
+    length += 3;
+  }
+  logTerminateLine(line, length);
+}
+
+//
+// Prints all pending lines in the order they were logged across all CPUs.
+//
+void WiiLogger::drain(void) {
+  WiiLogRing    *ring;
+  WiiLogRing    *oldestRing;
+  WiiLogRecord  *record;
+  WiiLogRecord  *oldestRecord;
+  UInt32        droppedCount;
+
+  IOLockLock(_drainLock);
+
+  while (true) {
+    oldestRing   = NULL;
+    oldestRecord = NULL;
+    for (UInt32 cpu = 0; cpu < _cpuCount; cpu++) {
+      ring = &_rings[cpu];
+      if (ring->head == ring->tail) {
+        continue;
+      }
+      sync();
+
+      record = &ring->records[ring->tail & (kWiiLogRingRecordCount - 1)];
+      if ((oldestRecord == NULL) || ((SInt32) (record->sequence - oldestRecord->sequence) < 0)) {
+        oldestRing   = ring;
+        oldestRecord = record;
+      }
+    }
+
+    //
+    // Writers do not schedule another drain while this one is pending.
+    // Once empty, allow them to again, and pick up anything logged before they could.
+    //
+    if (oldestRing == NULL) {
+      _drainPending = 0;
+      sync();
+      for (UInt32 cpu = 0; cpu < _cpuCount; cpu++) {
+        if (_rings[cpu].head != _rings[cpu].tail) {
+          oldestRing = &_rings[cpu];
+          break;
+        }
+      }
+      if ((oldestRing == NULL) || !OSCompareAndSwap(0, 1, &_drainPending)) {
+        break;
+      }
+      continue;
+    }
+
+    //
+    // Record must be read before its slot is released to the writer.
+    //
+    formatRecord(oldestRecord, _drainLine);
+    sync();
+    oldestRing->tail++;
+
+    printLine(_drainLine);
+  }
+
+  for (UInt32 cpu = 0; cpu < _cpuCount; cpu++) {
+    ring = &_rings[cpu];
+    droppedCount = ring->droppedCount;
+    if (droppedCount != ring->reportedDroppedCount) {
+      snprintf(_drainLine, sizeof (_drainLine), "WiiLogger: %u lines dropped on CPU %u\n",
+               (unsigned int) (droppedCount - ring->reportedDroppedCount), (unsigned int) cpu);
+      ring->reportedDroppedCount = droppedCount;
+      printLine(_drainLine);
+    }
+  }
+
+  IOLockUnlock(_drainLock);
+}
+
+//
+// Service functions.
+//
+void WiiLogger::serviceLogLine(const char *className, const char *locationName, const char *funcName,
+                               const char *format, va_list va) {
+  if (gLogger != NULL) {
+    gLogger->logLine(className, locationName, funcName, format, va);
+  }
+}
+
+void WiiLogger::serviceLogDeferred(const char *className, const char *locationName, const char *funcName,
+                                   const char *format, va_list va) {
+  if (gLogger != NULL) {
+    gLogger->logDeferred(className, locationName, funcName, format, va);
+  }
+}
+
+//
+// Drains the log rings from a thread call.
+//
+void WiiLogger::handleDrain(thread_call_param_t param0, thread_call_param_t param1) {
+  ((WiiLogger *) param0)->drain();
+}
+
+//
+// Called when the IPC service is published on Wii U.
+//
+bool WiiLogger::handleIPCPublished(void *target, void *refCon, IOService *newService) {
+  ((WiiLogger *) target)->_ipcService = newService;
+  return true;
+}
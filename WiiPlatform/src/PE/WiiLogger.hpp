@@ -0,0 +1,108 @@
+//
+//  WiiLogger.hpp
+//  Wii deferred debug logging
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef WiiLogger_hpp
+#define WiiLogger_hpp
+
+#include <IOKit/IOService.h>
+#include <kern/thread_call.h>
+
+#include "WiiCommon.hpp"
+#include "WiiProcessorInterface.hpp"
+
+//
+// Per-CPU log rings, each a power of two number of fixed size records.
+// Arguments are stored in the record data as captured, strings are copied with a 16-bit length.
+//
+#define kWiiLogRingRecordCount    256
+#define kWiiLogRecordDataSize     96
+#define kWiiLogMaxCPUCount        kWiiPICafeCoreCount
+#define kWiiLogSpecLength         32
+#define kWiiLogDrainDelayMS       1
+
+//
+// Record flags.
+//
+#define kWiiLogRecordFlagTruncated  BIT0
+
+typedef struct {
+  UInt32      sequence;
+  const char  *className;
+  const char  *locationName;
+  const char  *funcName;
+  const char  *format;
+  UInt16      dataLength;
+  UInt8       argumentCount;
+  UInt8       flags;
+  UInt8       data[kWiiLogRecordDataSize];
+} WiiLogRecord;
+
+//
+// Log ring of a single CPU. Only that CPU writes the head with interrupts disabled, only the drain writes the tail.
+//
+typedef struct {
+  volatile UInt32 head;
+  volatile UInt32 tail;
+  volatile UInt32 droppedCount;
+  UInt32          reportedDroppedCount;
+  WiiLogRecord    *records;
+} WiiLogRing;
+
+//
+// Represents the platform expert's logging service.
+//
+class WiiLogger : public OSObject {
+  OSDeclareDefaultStructors(WiiLogger);
+  typedef OSObject super;
+
+private:
+  bool              _isCafe;
+  UInt32            _cpuCount;
+  WiiLogRing        _rings[kWiiLogMaxCPUCount];
+  volatile SInt32   _sequence;
+  volatile UInt32   _drainPending;
+  thread_call_t     _drainThreadCall;
+  IOLock            *_drainLock;
+  char              _drainLine[kWiiLogLineLength];
+
+  //
+  // IPC service for logging on Wii U, set once published.
+  //
+  IONotifier        *_ipcNotifier;
+  IOService         *_ipcService;
+  const OSSymbol    *_ipcLogSymbol;
+
+  void printLine(const char *line);
+  void logLine(const char *className, const char *locationName, const char *funcName,
+               const char *format, va_list va);
+  void logDeferred(const char *className, const char *locationName, const char *funcName,
+                   const char *format, va_list va);
+  void formatRecord(const WiiLogRecord *record, char *line);
+  void drain(void);
+
+  static void serviceLogLine(const char *className, const char *locationName, const char *funcName,
+                             const char *format, va_list va);
+  static void serviceLogDeferred(const char *className, const char *locationName, const char *funcName,
+                                 const char *format, va_list va);
+  static void handleDrain(thread_call_param_t param0, thread_call_param_t param1);
+  static bool handleIPCPublished(void *target, void *refCon, IOService *newService);
+
+public:
+  //
+  // Overrides.
+  //
+  void free(void);
+
+  //
+  // Logger functions.
+  //
+  static WiiLogger *logger(void);
+  const WiiLogService *getService(void);
+  void flush(void);
+};
+
+#endif
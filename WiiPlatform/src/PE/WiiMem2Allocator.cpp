@@ -0,0 +1,592 @@
+//
+//  WiiMem2Allocator.cpp
+//  Wii MEM2 DMA memory slab allocator
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include <ppc/proc_reg.h>
+
+#include "WiiMem2Allocator.hpp"
+
+OSDefineMetaClassAndStructors(WiiMem2Allocator, super);
+
+//
+// There is only one MEM2 region, the service functions are routed to its allocator.
+//
+static WiiMem2Allocator *gMem2Allocator;
+static WiiMem2Service   gMem2Service;
+
+//
+// Gets the size class for a slab allocation length.
+//
+static inline UInt8 getMem2SizeClass(IOByteCount length) {
+  if (length <= kWiiMem2MinAlignment) {
+    return 0;
+  }
+  return (getHighestBit32(length - 1) + 1) - kWiiMem2SizeClassShift;
+}
+
+//
+// Overrides OSObject::free().
+//
+void WiiMem2Allocator::free(void) {
+  WiiMem2Slab *slab;
+
+  if (gMem2Allocator == this) {
+    gMem2Allocator = NULL;
+  }
+
+  if (_pageSlabs != NULL) {
+    //
+    // Only the empty slabs kept for each size class should remain.
+    //
+    for (UInt32 mode = 0; mode < kWiiMem2CacheModeCount; mode++) {
+      for (UInt32 sizeClass = 0; sizeClass < kWiiMem2SizeClassCount; sizeClass++) {
+        while (_partialSlabs[mode][sizeClass] != NULL) {
+          slab = _partialSlabs[mode][sizeClass];
+          unlinkPartialSlab(slab);
+          destroySlab(slab);
+        }
+      }
+    }
+    IOFree(_pageSlabs, _pageCount * sizeof (WiiMem2Slab *));
+    _pageSlabs = NULL;
+  }
+  OSSafeReleaseNULL(_rangeAllocator);
+  if (_lock != NULL) {
+    IOLockFree(_lock);
+    _lock = NULL;
+  }
+
+  super::free();
+}
+
+//
+// Creates the allocator for a MEM2 region.
+// The region is trimmed to whole pages, all slabs are page aligned.
+//
+WiiMem2Allocator *WiiMem2Allocator::withRange(IOPhysicalAddress physAddr, IOByteCount length) {
+  WiiMem2Allocator  *allocator;
+  IOPhysicalAddress startAddr;
+  IOPhysicalAddress endAddr;
+
+  startAddr = (physAddr + PAGE_MASK) & ~(PAGE_MASK);
+  endAddr   = (physAddr + length) & ~(PAGE_MASK);
+  if (endAddr <= startAddr) {
+    return NULL;
+  }
+
+  allocator = new WiiMem2Allocator;
+  if (allocator == NULL) {
+    return NULL;
+  }
+  if (!allocator->init()) {
+    allocator->release();
+    return NULL;
+  }
+
+  allocator->WiiCheckDebugArgs();
+  allocator->_physAddr  = startAddr;
+  allocator->_length    = endAddr - startAddr;
+  allocator->_pageCount = allocator->_length / PAGE_SIZE;
+
+  allocator->_lock = IOLockAlloc();
+  if (allocator->_lock == NULL) {
+    allocator->release();
+    return NULL;
+  }
+
+  //
+  // Page to slab lookup table for frees.
+  //
+  allocator->_pageSlabs = (WiiMem2Slab **) IOMalloc(allocator->_pageCount * sizeof (WiiMem2Slab *));
+  if (allocator->_pageSlabs == NULL) {
+    allocator->release();
+    return NULL;
+  }
+  bzero(allocator->_pageSlabs, allocator->_pageCount * sizeof (WiiMem2Slab *));
+
+  //
+  // The range allocator only hands out pages, locking is done by this allocator.
+  //
+  allocator->_rangeAllocator = IORangeAllocator::withRange(0, 0, 0, 0);
+  if (allocator->_rangeAllocator == NULL) {
+    allocator->release();
+    return NULL;
+  }
+  allocator->_rangeAllocator->deallocate(startAddr, allocator->_length);
+
+  gMem2Service.createClient  = &WiiMem2Allocator::serviceCreateClient;
+  gMem2Service.destroyClient = &WiiMem2Allocator::serviceDestroyClient;
+  gMem2Service.allocate      = &WiiMem2Allocator::serviceAllocate;
+  gMem2Service.deallocate    = &WiiMem2Allocator::serviceDeallocate;
+  gMem2Allocator             = allocator;
+
+  allocator->WIIDBGLOG("MEM2 allocator at 0x%X, %u pages", startAddr, allocator->_pageCount);
+  return allocator;
+}
+
+//
+// Gets the allocation service function table.
+//
+const WiiMem2Service *WiiMem2Allocator::getService(void) {
+  return &gMem2Service;
+}
+
+//
+// Creates a slab of one or more pages mapped with the specified cache mode.
+//
+// Must be called with the allocator lock held.
+//
+WiiMem2Slab *WiiMem2Allocator::createSlab(UInt8 sizeClass, UInt8 cacheMode, IOByteCount length) {
+  WiiMem2Slab       *slab;
+  IOPhysicalAddress physAddr;
+  UInt32            firstPage;
+
+  if (!_rangeAllocator->allocate(length, &physAddr, PAGE_SIZE)) {
+    return NULL;
+  }
+
+  slab = (WiiMem2Slab *) IOMalloc(sizeof (*slab));
+  if (slab == NULL) {
+    _rangeAllocator->deallocate(physAddr, length);
+    return NULL;
+  }
+  bzero(slab, sizeof (*slab));
+  slab->physAddr  = physAddr;
+  slab->length    = length;
+  slab->sizeClass = sizeClass;
+  slab->cacheMode = cacheMode;
+
+  slab->desc = IOMemoryDescriptor::withPhysicalAddress(physAddr, length, kIODirectionInOut);
+  if (slab->desc != NULL) {
+    slab->map = slab->desc->map((cacheMode == kWiiMem2CacheModeInhibit) ? kIOMapInhibitCache : kIOMapCopybackCache);
+  }
+  if (slab->map == NULL) {
+    OSSafeReleaseNULL(slab->desc);
+    IOFree(slab, sizeof (*slab));
+    _rangeAllocator->deallocate(physAddr, length);
+    return NULL;
+  }
+  slab->buffer = (UInt8 *) slab->map->getVirtualAddress();
+
+  //
+  // Large slabs hold a single allocation covering every page.
+  //
+  slab->objectCount = (sizeClass == kWiiMem2SizeClassLarge) ? 1 : (PAGE_SIZE >> (sizeClass + kWiiMem2SizeClassShift));
+  slab->freeCount   = slab->objectCount;
+  for (UInt32 i = 0; i < slab->objectCount; i++) {
+    slab->freeMask[i / 32] |= 0x80000000 >> (i % 32);
+  }
+
+  firstPage = (physAddr - _physAddr) / PAGE_SIZE;
+  for (UInt32 i = 0; i < (length / PAGE_SIZE); i++) {
+    _pageSlabs[firstPage + i] = slab;
+  }
+
+  _slabCount++;
+  _mappedBytes += length;
+  WIIDATADBGLOG("Created slab at 0x%X, length 0x%X, class %u, mode %u", physAddr, length, sizeClass, cacheMode);
+  return slab;
+}
+
+//
+// Destroys a slab, returning its pages to the range allocator.
+//
+// Must be called with the allocator lock held.
+//
+void WiiMem2Allocator::destroySlab(WiiMem2Slab *slab) {
+  UInt32 firstPage;
+
+  //
+  // Pages may next be mapped cache-inhibited, dirty lines must not be written back over them later.
+  //
+  if (slab->cacheMode == kWiiMem2CacheModeCopyback) {
+    flushDataCache(slab->buffer, slab->length);
+  }
+  OSSafeReleaseNULL(slab->map);
+  OSSafeReleaseNULL(slab->desc);
+
+  firstPage = (slab->physAddr - _physAddr) / PAGE_SIZE;
+  for (UInt32 i = 0; i < (slab->length / PAGE_SIZE); i++) {
+    _pageSlabs[firstPage + i] = NULL;
+  }
+  _rangeAllocator->deallocate(slab->physAddr, slab->length);
+
+  _slabCount--;
+  _mappedBytes -= slab->length;
+  IOFree(slab, sizeof (*slab));
+}
+
+//
+// Adds a slab to the head of its partial slab list.
+//
+// Must be called with the allocator lock held.
+//
+void WiiMem2Allocator::linkPartialSlab(WiiMem2Slab *slab) {
+  WiiMem2Slab **headPtr;
+
+  headPtr    = &_partialSlabs[slab->cacheMode][slab->sizeClass];
+  slab->prev = NULL;
+  slab->next = *headPtr;
+  if (*headPtr != NULL) {
+    (*headPtr)->prev = slab;
+  }
+  *headPtr = slab;
+}
+
+//
+// Removes a slab from its partial slab list.
+//
+// Must be called with the allocator lock held.
+//
+void WiiMem2Allocator::unlinkPartialSlab(WiiMem2Slab *slab) {
+  if (slab->prev != NULL) {
+    slab->prev->next = slab->next;
+  } else {
+    _partialSlabs[slab->cacheMode][slab->sizeClass] = slab->next;
+  }
+  if (slab->next != NULL) {
+    slab->next->prev = slab->prev;
+  }
+  slab->prev = NULL;
+  slab->next = NULL;
+}
+
+//
+// Allocates an object from the partial slabs, creating a new slab if none have free objects.
+//
+// Must be called with the allocator lock held.
+//
+bool WiiMem2Allocator::allocateObject(UInt8 sizeClass, UInt8 cacheMode, IOPhysicalAddress *physAddr, void **buffer) {
+  WiiMem2Slab *slab;
+  UInt32      maskIndex;
+  UInt32      bit;
+  IOByteCount offset;
+
+  slab = _partialSlabs[cacheMode][sizeClass];
+  if (slab == NULL) {
+    slab = createSlab(sizeClass, cacheMode, PAGE_SIZE);
+    if (slab == NULL) {
+      return false;
+    }
+    linkPartialSlab(slab);
+  }
+
+  //
+  // Take the lowest free object.
+  //
+  for (maskIndex = 0; slab->freeMask[maskIndex] == 0; maskIndex++);
+  bit = 31 - getHighestBit32(slab->freeMask[maskIndex]);
+  slab->freeMask[maskIndex] &= ~(0x80000000 >> bit);
+
+  slab->freeCount--;
+  if (slab->freeCount == 0) {
+    unlinkPartialSlab(slab);
+  }
+
+  offset    = ((maskIndex * 32) + bit) << (sizeClass + kWiiMem2SizeClassShift);
+  *physAddr = slab->physAddr + offset;
+  *buffer   = slab->buffer + offset;
+  return true;
+}
+
+//
+// Returns an object to its slab.
+// Empty slabs are destroyed unless they are the only partial slab for their size class.
+//
+// Must be called with the allocator lock held.
+//
+void WiiMem2Allocator::freeObject(WiiMem2Slab *slab, IOPhysicalAddress physAddr) {
+  UInt32 object;
+
+  object = (physAddr - slab->physAddr) >> (slab->sizeClass + kWiiMem2SizeClassShift);
+  if (slab->freeCount == 0) {
+    linkPartialSlab(slab);
+  }
+  slab->freeMask[object / 32] |= 0x80000000 >> (object % 32);
+  slab->freeCount++;
+
+  if ((slab->freeCount == slab->objectCount) && ((slab->prev != NULL) || (slab->next != NULL))) {
+    unlinkPartialSlab(slab);
+    destroySlab(slab);
+  }
+}
+
+//
+// Gets the slab containing a physical address.
+//
+// Can be called without the lock for any address that is currently allocated, as its slab cannot be destroyed.
+//
+WiiMem2Slab *WiiMem2Allocator::getSlab(IOPhysicalAddress physAddr) {
+  WiiMem2Slab *slab;
+
+  if ((physAddr < _physAddr) || (physAddr >= (_physAddr + _length))) {
+    return NULL;
+  }
+
+  slab = _pageSlabs[(physAddr - _physAddr) / PAGE_SIZE];
+  if (slab == NULL) {
+    return NULL;
+  }
+  if (slab->sizeClass == kWiiMem2SizeClassLarge) {
+    return (physAddr == slab->physAddr) ? slab : NULL;
+  }
+  return ((physAddr & ((kWiiMem2MinAlignment << slab->sizeClass) - 1)) == 0) ? slab : NULL;
+}
+
+//
+// Creates an allocation client.
+//
+WiiMem2Client *WiiMem2Allocator::createClient(const char *name, IOByteCount quota) {
+  WiiMem2Client *client;
+
+  client = (WiiMem2Client *) IOMalloc(sizeof (*client));
+  if (client == NULL) {
+    return NULL;
+  }
+  bzero(client, sizeof (*client));
+  strncpy(client->name, name, sizeof (client->name) - 1);
+  client->quota = quota;
+
+  IOLockLock(_lock);
+  client->next = _clients;
+  _clients     = client;
+  IOLockUnlock(_lock);
+
+  WIIDBGLOG("Created client %s, quota 0x%X", client->name, quota);
+  return client;
+}
+
+//
+// Destroys an allocation client, returning its cached objects to the slabs.
+//
+void WiiMem2Allocator::destroyClient(WiiMem2Client *client) {
+  WiiMem2Client   **clientPtr;
+  WiiMem2Magazine *magazine;
+
+  IOLockLock(_lock);
+  for (UInt32 mode = 0; mode < kWiiMem2CacheModeCount; mode++) {
+    for (UInt32 sizeClass = 0; sizeClass < kWiiMem2SizeClassCount; sizeClass++) {
+      magazine = &client->magazines[mode][sizeClass];
+      while (magazine->count > 0) {
+        magazine->count--;
+        freeObject(getSlab(magazine->physAddrs[magazine->count]), magazine->physAddrs[magazine->count]);
+      }
+    }
+  }
+
+  for (clientPtr = &_clients; *clientPtr != NULL; clientPtr = &(*clientPtr)->next) {
+    if (*clientPtr == client) {
+      *clientPtr = client->next;
+      break;
+    }
+  }
+  IOLockUnlock(_lock);
+
+  if (client->bytesInUse != 0) {
+    WIISYSLOG("Client %s destroyed with 0x%X bytes still allocated", client->name, client->bytesInUse);
+  }
+  IOFree(client, sizeof (*client));
+}
+
+//
+// Allocates a buffer for a client.
+//
+// Slab sized allocations are taken from the client's magazine, refilling half of it from the slabs when empty.
+//
+IOReturn WiiMem2Allocator::allocate(WiiMem2Client *client, IOByteCount length, UInt32 cacheMode,
+                                    IOPhysicalAddress *physAddr, void **buffer) {
+  WiiMem2Magazine *magazine;
+  WiiMem2Slab     *slab;
+  IOByteCount     allocLength;
+  UInt8           sizeClass;
+
+  if ((client == NULL) || (length == 0) || (cacheMode >= kWiiMem2CacheModeCount) || (physAddr == NULL) || (buffer == NULL)) {
+    return kIOReturnBadArgument;
+  }
+
+  if (length > kWiiMem2SlabMaxSize) {
+    sizeClass   = kWiiMem2SizeClassLarge;
+    allocLength = (length + PAGE_MASK) & ~(PAGE_MASK);
+  } else {
+    sizeClass   = getMem2SizeClass(length);
+    allocLength = kWiiMem2MinAlignment << sizeClass;
+  }
+
+  if ((client->quota != 0) && ((client->bytesInUse + allocLength) > client->quota)) {
+    client->failureCount++;
+    WIIDBGLOG("Client %s is over quota allocating 0x%X bytes", client->name, allocLength);
+    return kIOReturnNoSpace;
+  }
+
+  if (sizeClass == kWiiMem2SizeClassLarge) {
+    IOLockLock(_lock);
+    slab = createSlab(kWiiMem2SizeClassLarge, cacheMode, allocLength);
+    if (slab != NULL) {
+      slab->freeMask[0] = 0;
+      slab->freeCount   = 0;
+      _largeCount++;
+    }
+    IOLockUnlock(_lock);
+
+    if (slab == NULL) {
+      client->failureCount++;
+      return kIOReturnNoMemory;
+    }
+    *physAddr = slab->physAddr;
+    *buffer   = slab->buffer;
+
+  } else {
+    magazine = &client->magazines[cacheMode][sizeClass];
+    if (magazine->count == 0) {
+      IOLockLock(_lock);
+      while ((magazine->count < (kWiiMem2MagazineSize / 2))
+             && allocateObject(sizeClass, cacheMode, &magazine->physAddrs[magazine->count], &magazine->buffers[magazine->count])) {
+        magazine->count++;
+      }
+      IOLockUnlock(_lock);
+
+      if (magazine->count == 0) {
+        client->failureCount++;
+        return kIOReturnNoMemory;
+      }
+    } else {
+      client->magazineHitCount++;
+    }
+
+    magazine->count--;
+    *physAddr = magazine->physAddrs[magazine->count];
+    *buffer   = magazine->buffers[magazine->count];
+  }
+
+  client->allocationCount++;
+  client->bytesInUse += allocLength;
+  if (client->bytesInUse > client->peakBytes) {
+    client->peakBytes = client->bytesInUse;
+  }
+  return kIOReturnSuccess;
+}
+
+//
+// Frees a buffer for a client.
+//
+// Slab sized buffers are returned to the client's magazine, flushing half of it to the slabs when full.
+//
+void WiiMem2Allocator::deallocate(WiiMem2Client *client, IOPhysicalAddress physAddr) {
+  WiiMem2Magazine *magazine;
+  WiiMem2Slab     *slab;
+  IOByteCount     allocLength;
+
+  slab = getSlab(physAddr);
+  if ((client == NULL) || (slab == NULL)) {
+    WIISYSLOG("Invalid free of 0x%X", physAddr);
+    return;
+  }
+
+  if (slab->sizeClass == kWiiMem2SizeClassLarge) {
+    allocLength = slab->length;
+
+    IOLockLock(_lock);
+    destroySlab(slab);
+    _largeCount--;
+    IOLockUnlock(_lock);
+
+  } else {
+    allocLength = kWiiMem2MinAlignment << slab->sizeClass;
+    magazine    = &client->magazines[slab->cacheMode][slab->sizeClass];
+    if (magazine->count == kWiiMem2MagazineSize) {
+      IOLockLock(_lock);
+      while (magazine->count > (kWiiMem2MagazineSize / 2)) {
+        magazine->count--;
+        freeObject(getSlab(magazine->physAddrs[magazine->count]), magazine->physAddrs[magazine->count]);
+      }
+      IOLockUnlock(_lock);
+    }
+
+    magazine->physAddrs[magazine->count] = physAddr;
+    magazine->buffers[magazine->count]   = slab->buffer + (physAddr - slab->physAddr);
+    magazine->count++;
+  }
+
+  client->bytesInUse -= allocLength;
+}
+
+//
+// Service functions.
+//
+WiiMem2Client *WiiMem2Allocator::serviceCreateClient(const char *name, IOByteCount quota) {
+  return (gMem2Allocator != NULL) ? gMem2Allocator->createClient(name, quota) : NULL;
+}
+
+void WiiMem2Allocator::serviceDestroyClient(WiiMem2Client *client) {
+  if ((gMem2Allocator != NULL) && (client != NULL)) {
+    gMem2Allocator->destroyClient(client);
+  }
+}
+
+IOReturn WiiMem2Allocator::serviceAllocate(WiiMem2Client *client, IOByteCount length, UInt32 cacheMode,
+                                           IOPhysicalAddress *physAddr, void **buffer) {
+  return (gMem2Allocator != NULL) ? gMem2Allocator->allocate(client, length, cacheMode, physAddr, buffer) : kIOReturnNotReady;
+}
+
+void WiiMem2Allocator::serviceDeallocate(WiiMem2Client *client, IOPhysicalAddress physAddr) {
+  if (gMem2Allocator != NULL) {
+    gMem2Allocator->deallocate(client, physAddr);
+  }
+}
+
+//
+// Publishes allocator and per-client statistics on a service.
+// Client counters are updated without the allocator lock and are approximate.
+//
+void WiiMem2Allocator::publishStatistics(IOService *service) {
+  OSDictionary  *statsDict;
+  OSDictionary  *clientDict;
+  OSArray       *clientsArray;
+  OSString      *clientName;
+  WiiMem2Client *client;
+
+  statsDict    = OSDictionary::withCapacity(5);
+  clientsArray = OSArray::withCapacity(4);
+  if ((statsDict == NULL) || (clientsArray == NULL)) {
+    OSSafeReleaseNULL(statsDict);
+    OSSafeReleaseNULL(clientsArray);
+    return;
+  }
+
+  IOLockLock(_lock);
+  setDictionaryNumber(statsDict, kWiiMem2StatTotalKey, _length, 32);
+  setDictionaryNumber(statsDict, kWiiMem2StatMappedKey, _mappedBytes, 32);
+  setDictionaryNumber(statsDict, kWiiMem2StatSlabsKey, _slabCount, 32);
+  setDictionaryNumber(statsDict, kWiiMem2StatLargeKey, _largeCount, 32);
+
+  for (client = _clients; client != NULL; client = client->next) {
+    clientDict = OSDictionary::withCapacity(7);
+    if (clientDict == NULL) {
+      break;
+    }
+
+    clientName = OSString::withCString(client->name);
+    if (clientName != NULL) {
+      clientDict->setObject(kWiiMem2StatNameKey, clientName);
+      clientName->release();
+    }
+    setDictionaryNumber(clientDict, kWiiMem2StatQuotaKey, client->quota, 32);
+    setDictionaryNumber(clientDict, kWiiMem2StatInUseKey, client->bytesInUse, 32);
+    setDictionaryNumber(clientDict, kWiiMem2StatPeakKey, client->peakBytes, 32);
+    setDictionaryNumber(clientDict, kWiiMem2StatAllocationsKey, client->allocationCount, 32);
+    setDictionaryNumber(clientDict, kWiiMem2StatFailuresKey, client->failureCount, 32);
+    setDictionaryNumber(clientDict, kWiiMem2StatMagazineHitsKey, client->magazineHitCount, 32);
+
+    clientsArray->setObject(clientDict);
+    clientDict->release();
+  }
+  IOLockUnlock(_lock);
+
+  statsDict->setObject(kWiiMem2StatClientsKey, clientsArray);
+  service->setProperty(kWiiMem2StatisticsKey, statsDict);
+  clientsArray->release();
+  statsDict->release();
+}
@@ -0,0 +1,144 @@
+//
+//  WiiMem2Allocator.hpp
+//  Wii MEM2 DMA memory slab allocator
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef WiiMem2Allocator_hpp
+#define WiiMem2Allocator_hpp
+
+#include <IOKit/IOMemoryDescriptor.h>
+#include <IOKit/IORangeAllocator.h>
+#include <IOKit/IOService.h>
+
+#include "WiiMem2.hpp"
+
+//
+// Size classes are powers of two from the minimum alignment up to the maximum slab size.
+// Each slab is a single page of one size class and cache mode, larger allocations get their own pages.
+//
+#define kWiiMem2SizeClassShift        5
+#define kWiiMem2SizeClassCount        7
+#define kWiiMem2SizeClassLarge        0xFF
+#define kWiiMem2SlabObjectMaskCount   ((PAGE_SIZE / kWiiMem2MinAlignment) / 32)
+
+//
+// Per-client magazine size, refills and flushes move half a magazine at a time.
+//
+#define kWiiMem2MagazineSize          8
+#define kWiiMem2ClientNameLength      16
+
+//
+// Statistics properties, refreshed when the platform expert properties are read.
+//
+#define kWiiMem2StatisticsKey         "Mem2Statistics"
+#define kWiiMem2StatTotalKey          "TotalBytes"
+#define kWiiMem2StatMappedKey         "MappedBytes"
+#define kWiiMem2StatSlabsKey          "Slabs"
+#define kWiiMem2StatLargeKey          "LargeAllocations"
+#define kWiiMem2StatClientsKey        "Clients"
+#define kWiiMem2StatNameKey           "Name"
+#define kWiiMem2StatQuotaKey          "Quota"
+#define kWiiMem2StatInUseKey          "BytesInUse"
+#define kWiiMem2StatPeakKey           "PeakBytes"
+#define kWiiMem2StatAllocationsKey    "Allocations"
+#define kWiiMem2StatFailuresKey       "Failures"
+#define kWiiMem2StatMagazineHitsKey   "MagazineHits"
+
+//
+// Slab of MEM2 pages mapped with a single cache mode.
+//
+typedef struct WiiMem2Slab {
+  IOMemoryDescriptor  *desc;
+  IOMemoryMap         *map;
+  IOPhysicalAddress   physAddr;
+  UInt8               *buffer;
+  IOByteCount         length;
+  struct WiiMem2Slab  *prev;
+  struct WiiMem2Slab  *next;
+  // Free objects, bit 31 of the first word is object 0.
+  UInt32              freeMask[kWiiMem2SlabObjectMaskCount];
+  UInt16              objectCount;
+  UInt16              freeCount;
+  UInt8               sizeClass;
+  UInt8               cacheMode;
+} WiiMem2Slab;
+
+//
+// Per-client magazine of free objects of one size class and cache mode.
+//
+typedef struct {
+  UInt32            count;
+  IOPhysicalAddress physAddrs[kWiiMem2MagazineSize];
+  void              *buffers[kWiiMem2MagazineSize];
+} WiiMem2Magazine;
+
+struct WiiMem2Client {
+  char            name[kWiiMem2ClientNameLength];
+  IOByteCount     quota;
+  IOByteCount     bytesInUse;
+  IOByteCount     peakBytes;
+  UInt32          allocationCount;
+  UInt32          failureCount;
+  UInt32          magazineHitCount;
+  WiiMem2Client   *next;
+  WiiMem2Magazine magazines[kWiiMem2CacheModeCount][kWiiMem2SizeClassCount];
+};
+
+//
+// Represents the MEM2 allocator.
+//
+class WiiMem2Allocator : public OSObject {
+  OSDeclareDefaultStructors(WiiMem2Allocator);
+  WiiDeclareLogFunctions("mem2");
+  typedef OSObject super;
+
+private:
+  IOLock              *_lock;
+  IORangeAllocator    *_rangeAllocator;
+  IOPhysicalAddress   _physAddr;
+  IOByteCount         _length;
+  UInt32              _pageCount;
+  WiiMem2Slab         **_pageSlabs;
+  WiiMem2Slab         *_partialSlabs[kWiiMem2CacheModeCount][kWiiMem2SizeClassCount];
+  WiiMem2Client       *_clients;
+  IOByteCount         _mappedBytes;
+  UInt32              _slabCount;
+  UInt32              _largeCount;
+
+  WiiMem2Slab *createSlab(UInt8 sizeClass, UInt8 cacheMode, IOByteCount length);
+  void destroySlab(WiiMem2Slab *slab);
+  void linkPartialSlab(WiiMem2Slab *slab);
+  void unlinkPartialSlab(WiiMem2Slab *slab);
+  bool allocateObject(UInt8 sizeClass, UInt8 cacheMode, IOPhysicalAddress *physAddr, void **buffer);
+  void freeObject(WiiMem2Slab *slab, IOPhysicalAddress physAddr);
+  WiiMem2Slab *getSlab(IOPhysicalAddress physAddr);
+
+  WiiMem2Client *createClient(const char *name, IOByteCount quota);
+  void destroyClient(WiiMem2Client *client);
+  IOReturn allocate(WiiMem2Client *client, IOByteCount length, UInt32 cacheMode,
+                    IOPhysicalAddress *physAddr, void **buffer);
+  void deallocate(WiiMem2Client *client, IOPhysicalAddress physAddr);
+
+  static WiiMem2Client *serviceCreateClient(const char *name, IOByteCount quota);
+  static void serviceDestroyClient(WiiMem2Client *client);
+  static IOReturn serviceAllocate(WiiMem2Client *client, IOByteCount length, UInt32 cacheMode,
+                                  IOPhysicalAddress *physAddr, void **buffer);
+  static void serviceDeallocate(WiiMem2Client *client, IOPhysicalAddress physAddr);
+
+public:
+  //
+  // Overrides.
+  //
+  void free(void);
+
+  //
+  // Allocator functions.
+  //
+  static WiiMem2Allocator *withRange(IOPhysicalAddress physAddr, IOByteCount length);
+  const WiiMem2Service *getService(void);
+  void publishStatistics(IOService *service);
+};
+
+#endif
@@ -9,6 +9,7 @@
 #include <IOKit/pwr_mgt/RootDomain.h>
 #include <IOKit/platform/ApplePlatformExpert.h>
 #include <IOKit/IODeviceTreeSupport.h>
+#include <IOKit/IOUserClient.h>
 
 #include "WiiPE.hpp"
 
@@ -22,6 +23,23 @@ bool WiiPE::init(OSDictionary *dictionary) {
 
   _invalidateCacheFunc = NULL;
   _mem2Allocator       = NULL;
+  _lockedCache         = NULL;
+  _logger              = NULL;
+  _kernelSymbols       = NULL;
+  _symLookupsClosed    = false;
+  _bsdNotifier         = NULL;
+
+  _symLock = IOLockAlloc();
+  if (_symLock == NULL) {
+    return false;
+  }
+
+  bzero(_logSubsystems, sizeof (_logSubsystems));
+  _logSubsystemCount = 0;
+  _logLevelLock = IOLockAlloc();
+  if (_logLevelLock == NULL) {
+    return false;
+  }
 
   return super::init(dictionary);
 }
@@ -47,6 +65,23 @@ bool WiiPE::start(IOService *provider) {
   _pePrivPMFeatures = kStdDesktopPrivPMFeatures;
   _peNumBatteriesSupported = kStdDesktopNumBatteries;
 
+#if DEBUG
+  //
+  // Move this platform expert's own log level into the shared table.
+  //
+  _debugLevel = getSubsystemLogLevel("pe", _debugLevelLocal);
+
+  //
+  // Create the logger, drivers log through it from here on.
+  //
+  _logger = WiiLogger::logger();
+  if (_logger == NULL) {
+    WIISYSLOG("Failed to create logger");
+    return false;
+  }
+  _logService = _logger->getService();
+#endif
+
   isCafe = checkPlatformCafe();
   WIIDBGLOG("Initializing %s platform expert", isCafe ? "Wii U" : "Wii");
   WIIDBGLOG("PowerPC PVR: 0x%x", getProcessorPVR());
@@ -76,12 +111,20 @@ bool WiiPE::start(IOService *provider) {
     mem2Addr = (UInt32 *) mem2Data->getBytesNoCopy();
     WIIDBGLOG("MEM2 buffer: 0x%x, length: 0x%x", mem2Addr[0], mem2Addr[1]);
 
-    _mem2Allocator = IORangeAllocator::withRange(0, 0, 0, IORangeAllocator::kLocking);
+    _mem2Allocator = WiiMem2Allocator::withRange(mem2Addr[0], mem2Addr[1]);
     if (_mem2Allocator == NULL) {
       WIISYSLOG("Failed to create MEM2 allocator");
       return false;
     }
-    _mem2Allocator->deallocate(mem2Addr[0], mem2Addr[1]);
+
+    //
+    // Locked cache is only used on Wii, threads can migrate between the Wii U cores and their caches.
+    //
+    _lockedCache = WiiLockedCacheController::lockedCacheController(_invalidateCacheFunc);
+    if (_lockedCache == NULL) {
+      WIISYSLOG("Failed to create locked cache controller");
+      return false;
+    }
   }
 
   if (!super::start(provider)) {
@@ -94,6 +137,11 @@ bool WiiPE::start(IOService *provider) {
   //
   publishResource("IONVRAM");
 
+  //
+  // Kernel symbols are only needed during boot, free the symbol index once BSD has started.
+  //
+  _bsdNotifier = addNotification(gIOPublishNotification, resourceMatching("IOBSD"), &WiiPE::handleBSDPublished, this);
+
   //
   // Prevent sleep/doze, Wii hardware is incapable of sleeping but unsure of doze. Seems to cause issues on Wii U and the GPU.
   //
@@ -121,21 +169,231 @@ IOReturn WiiPE::callPlatformFunction(const OSSymbol *functionName, bool waitForF
   }
 
   //
-  // Get MEM2 allocator.
+  // Get MEM2 allocation service.
   //
-  if (functionName->isEqualTo(kWiiFuncPlatformGetMem2Allocator)) {
-    WIIDBGLOG("Called %s", kWiiFuncPlatformGetMem2Allocator);
+  if (functionName->isEqualTo(kWiiFuncPlatformGetMem2Service)) {
+    WIIDBGLOG("Called %s", kWiiFuncPlatformGetMem2Service);
     if (_mem2Allocator == NULL) {
       return kIOReturnUnsupported;
     }
 
-    *((IORangeAllocator**) param1) = _mem2Allocator;
+    *((const WiiMem2Service**) param1) = _mem2Allocator->getService();
+    return kIOReturnSuccess;
+  }
+
+  //
+  // Get locked cache service.
+  //
+  if (functionName->isEqualTo(kWiiFuncPlatformGetLockedCacheService)) {
+    WIIDBGLOG("Called %s", kWiiFuncPlatformGetLockedCacheService);
+    if (_lockedCache == NULL) {
+      return kIOReturnUnsupported;
+    }
+
+    *((const WiiLockedCacheService**) param1) = _lockedCache->getService();
+    return kIOReturnSuccess;
+  }
+
+  //
+  // Get logging service.
+  //
+  if (functionName->isEqualTo(kWiiFuncPlatformGetLogService)) {
+    if (_logger == NULL) {
+      return kIOReturnUnsupported;
+    }
+
+    *((const WiiLogService**) param1) = _logger->getService();
     return kIOReturnSuccess;
   }
 
+  //
+  // Resolve kernel symbols.
+  //
+  if (functionName->isEqualTo(kWiiFuncPlatformResolveSymbols)) {
+    return resolveKernelSymbols((const char **) param1, (UInt32 *) param2, (UInt32) param3);
+  }
+
+  //
+  // Set interrupt affinity of a nub interrupt.
+  //
+  if (functionName->isEqualTo(kWiiFuncPlatformSetIntAffinity)) {
+    return setInterruptAffinity((IOService *) param1, (int) param2, (UInt32) param3);
+  }
+
+  //
+  // Get the shared log level for a subsystem.
+  //
+  if (functionName->isEqualTo(kWiiFuncPlatformGetLogLevel)) {
+    *((volatile UInt8 **) param3) = getSubsystemLogLevel((const char *) param1, (UInt8) (UInt32) param2);
+    return (*((volatile UInt8 **) param3) != NULL) ? kIOReturnSuccess : kIOReturnNoResources;
+  }
+
   return super::callPlatformFunction(functionName, waitForFunction, param1, param2, param3, param4);
 }
 
+//
+// Overrides IORegistryEntry::setProperties().
+//
+// Sets subsystem log levels at runtime from a WiiLogLevels dictionary of subsystem names and levels.
+//
+IOReturn WiiPE::setProperties(OSObject *properties) {
+  OSDictionary          *propertiesDict;
+  OSDictionary          *levelsDict;
+  OSCollectionIterator  *iterator;
+  OSSymbol              *subsystem;
+  OSNumber              *level;
+  volatile UInt8        *levelPtr;
+
+  propertiesDict = OSDynamicCast(OSDictionary, properties);
+  if (propertiesDict == NULL) {
+    return super::setProperties(properties);
+  }
+  levelsDict = OSDynamicCast(OSDictionary, propertiesDict->getObject(kWiiLogLevelsKey));
+  if (levelsDict == NULL) {
+    return super::setProperties(properties);
+  }
+
+  if (IOUserClient::clientHasPrivilege(current_task(), kIOClientPrivilegeAdministrator) != kIOReturnSuccess) {
+    return kIOReturnNotPrivileged;
+  }
+
+  iterator = OSCollectionIterator::withCollection(levelsDict);
+  if (iterator == NULL) {
+    return kIOReturnNoMemory;
+  }
+  while ((subsystem = OSDynamicCast(OSSymbol, iterator->getNextObject())) != NULL) {
+    level = OSDynamicCast(OSNumber, levelsDict->getObject(subsystem));
+    if (level == NULL) {
+      continue;
+    }
+
+    levelPtr = getSubsystemLogLevel(subsystem->getCStringNoCopy(), kWiiLogLevelNone);
+    if (levelPtr != NULL) {
+      *levelPtr = (UInt8) level->unsigned32BitValue();
+    }
+  }
+  iterator->release();
+
+  publishLogLevels();
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IORegistryEntry::serializeProperties().
+//
+// Refreshes the MEM2 allocator statistics when properties are read.
+//
+bool WiiPE::serializeProperties(OSSerialize *serialize) const {
+  if (_mem2Allocator != NULL) {
+    _mem2Allocator->publishStatistics((WiiPE *) this);
+  }
+  return super::serializeProperties(serialize);
+}
+
+//
+// Gets the shared log level for a subsystem, adding it with the initial level if not yet present.
+// Multiple drivers using the same subsystem share one level, enabled if any of them were enabled at boot.
+//
+volatile UInt8 *WiiPE::getSubsystemLogLevel(const char *subsystem, UInt8 initialLevel) {
+  WiiPELogSubsystem *logSubsystem;
+  bool              added;
+
+  logSubsystem = NULL;
+  added        = false;
+
+  IOLockLock(_logLevelLock);
+  for (UInt32 i = 0; i < _logSubsystemCount; i++) {
+    if (strncmp(_logSubsystems[i].name, subsystem, sizeof (_logSubsystems[i].name)) == 0) {
+      logSubsystem = &_logSubsystems[i];
+      break;
+    }
+  }
+
+  if (logSubsystem != NULL) {
+    if (initialLevel > logSubsystem->level) {
+      logSubsystem->level = initialLevel;
+    }
+  } else if (_logSubsystemCount < kWiiPELogSubsystemCount) {
+    logSubsystem = &_logSubsystems[_logSubsystemCount++];
+    strncpy(logSubsystem->name, subsystem, sizeof (logSubsystem->name) - 1);
+    logSubsystem->level = initialLevel;
+    added = true;
+  }
+  IOLockUnlock(_logLevelLock);
+
+  if (added) {
+    publishLogLevels();
+  }
+  return (logSubsystem != NULL) ? &logSubsystem->level : NULL;
+}
+
+//
+// Publishes the current subsystem log levels.
+//
+void WiiPE::publishLogLevels(void) {
+  OSDictionary  *levelsDict;
+  OSNumber      *level;
+
+  levelsDict = OSDictionary::withCapacity(kWiiPELogSubsystemCount);
+  if (levelsDict == NULL) {
+    return;
+  }
+
+  IOLockLock(_logLevelLock);
+  for (UInt32 i = 0; i < _logSubsystemCount; i++) {
+    level = OSNumber::withNumber(_logSubsystems[i].level, 8);
+    if (level != NULL) {
+      levelsDict->setObject(_logSubsystems[i].name, level);
+      level->release();
+    }
+  }
+  IOLockUnlock(_logLevelLock);
+
+  setProperty(kWiiLogLevelsKey, levelsDict);
+  levelsDict->release();
+}
+
+//
+// Steers an interrupt of a nub to the specified mask of cores.
+// The interrupt controller the nub interrupt is connected to handles the actual steering.
+//
+IOReturn WiiPE::setInterruptAffinity(IOService *nub, int source, UInt32 coreMask) {
+  OSArray               *controllers;
+  OSArray               *specifiers;
+  OSSymbol              *controllerName;
+  OSData                *specifier;
+  IOInterruptController *controller;
+
+  if (!checkPlatformCafe()) {
+    return kIOReturnUnsupported;
+  }
+  if (nub == NULL) {
+    return kIOReturnBadArgument;
+  }
+
+  controllers = OSDynamicCast(OSArray, nub->getProperty("IOInterruptControllers"));
+  specifiers  = OSDynamicCast(OSArray, nub->getProperty("IOInterruptSpecifiers"));
+  if ((controllers == NULL) || (specifiers == NULL)) {
+    return kIOReturnNoInterrupt;
+  }
+
+  controllerName = OSDynamicCast(OSSymbol, controllers->getObject(source));
+  specifier      = OSDynamicCast(OSData, specifiers->getObject(source));
+  if ((controllerName == NULL) || (specifier == NULL) || (specifier->getLength() < sizeof (UInt32))) {
+    return kIOReturnNoInterrupt;
+  }
+
+  controller = lookUpInterruptController(controllerName);
+  if (controller == NULL) {
+    return kIOReturnNoInterrupt;
+  }
+
+  WIIDBGLOG("Setting %s vector %u to core mask 0x%X", controllerName->getCStringNoCopy(),
+    *((UInt32 *) specifier->getBytesNoCopy()), coreMask);
+  return controller->callPlatformFunction(kWiiFuncIntSetVectorAffinity, false,
+    (void *) *((UInt32 *) specifier->getBytesNoCopy()), (void *) coreMask, NULL, NULL);
+}
+
 //
 // Overrides IODTPlatformExpert::deleteList()
 //
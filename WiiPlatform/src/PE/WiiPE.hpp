@@ -9,11 +9,25 @@
 #define WiiPE_hpp
 
 #include <IOKit/IOPlatformExpert.h>
-#include <IOKit/IORangeAllocator.h>
 
 #include <mach-o/loader.h>
 
 #include "WiiCommon.hpp"
+#include "WiiKernelSymbols.hpp"
+#include "WiiLockedCacheController.hpp"
+#include "WiiLogger.hpp"
+#include "WiiMem2Allocator.hpp"
+
+//
+// Subsystem log levels shared with all drivers.
+//
+#define kWiiPELogSubsystemCount       32
+#define kWiiPELogSubsystemNameLength  16
+
+typedef struct {
+  char            name[kWiiPELogSubsystemNameLength];
+  volatile UInt8  level;
+} WiiPELogSubsystem;
 
 //
 // Represents the platform expert for the Wii system.
@@ -24,7 +38,9 @@ class WiiPE : public IODTPlatformExpert {
   typedef IODTPlatformExpert super;
 
 private:
-  IORangeAllocator    *_mem2Allocator;
+  WiiMem2Allocator          *_mem2Allocator;
+  WiiLockedCacheController  *_lockedCache;
+  WiiLogger                 *_logger;
 
   //
   // Patching/symbol lookups.
@@ -34,11 +50,33 @@ private:
   UInt8     *_strTab;
   UInt32    _strTabSize;
 
+  //
+  // Kernel symbol index, built on first lookup and freed once the BSD layer has started.
+  //
+  IOLock            *_symLock;
+  WiiKernelSymbols  *_kernelSymbols;
+  bool              _symLookupsClosed;
+  IONotifier        *_bsdNotifier;
+
   // _invalidate_dcache pointer. This function is not exported on 10.4
   WiiInvalidateDataCacheFunc  _invalidateCacheFunc;
 
+  //
+  // Subsystem log levels.
+  //
+  IOLock              *_logLevelLock;
+  WiiPELogSubsystem   _logSubsystems[kWiiPELogSubsystemCount];
+  UInt32              _logSubsystemCount;
+
+  volatile UInt8 *getSubsystemLogLevel(const char *subsystem, UInt8 initialLevel);
+  void publishLogLevels(void);
+
   bool findKernelMachHeader(void);
+  IOReturn resolveKernelSymbols(const char **symbolNames, UInt32 *symbolValues, UInt32 count);
   UInt32 resolveKernelSymbol(const char *symbolName);
+  void closeKernelSymbols(void);
+  static bool handleBSDPublished(void *target, void *refCon, IOService *newService);
+  IOReturn setInterruptAffinity(IOService *nub, int source, UInt32 coreMask);
 
 public:
   //
@@ -48,6 +86,8 @@ public:
   bool start(IOService *provider);
   IOReturn callPlatformFunction(const OSSymbol *functionName, bool waitForFunction,
                                 void *param1, void *param2, void *param3, void *param4);
+  IOReturn setProperties(OSObject *properties);
+  bool serializeProperties(OSSerialize *serialize) const;
   const char *deleteList(void);
   const char *excludeList(void);
   bool getMachineName(char *name, int maxLength);
@@ -5,7 +5,6 @@
 //  Copyright © 2025 John Davis. All rights reserved.
 //
 
-#include <mach-o/nlist.h>
 #include <ppc/proc_reg.h>
 
 #include "WiiPE.hpp"
@@ -95,24 +94,78 @@ bool WiiPE::findKernelMachHeader(void) {
 }
 
 //
-// Resolve a kernel symbol. This function can only be called prior to kernel linker jettison.
+// Resolve kernel symbols. Symbols can only be resolved until the symbol index is freed,
+// which happens once the BSD layer has started and before kernel linker jettison.
 //
-UInt32 WiiPE::resolveKernelSymbol(const char *symbolName) {
-  struct nlist  *nlistSym;
-  char          *symStr;
-
-  nlistSym = reinterpret_cast<struct nlist*>(_symTab);
-  for (UInt32 i = 0; i < _symTabNumSymbols; i++, nlistSym++) {
-    //
-    // Get the symbol string for the symbol.
-    //
-    symStr = reinterpret_cast<char*>(_strTab + nlistSym->n_un.n_strx);
-    if (strncmp(symbolName, symStr, strlen(symbolName)) == 0) {
-      WIIDBGLOG("Found symbol '%s' at 0x%X", symbolName, nlistSym->n_value);
-      return nlistSym->n_value;
+IOReturn WiiPE::resolveKernelSymbols(const char **symbolNames, UInt32 *symbolValues, UInt32 count) {
+  IOReturn status;
+
+  if ((symbolNames == NULL) || (symbolValues == NULL)) {
+    return kIOReturnBadArgument;
+  }
+
+  IOLockLock(_symLock);
+  if (_symLookupsClosed) {
+    IOLockUnlock(_symLock);
+    WIISYSLOG("Kernel symbols are no longer available");
+    return kIOReturnNotReady;
+  }
+
+  if (_kernelSymbols == NULL) {
+    _kernelSymbols = WiiKernelSymbols::withSymbolTable(_symTab, _symTabNumSymbols, _strTab, _strTabSize);
+    if (_kernelSymbols == NULL) {
+      IOLockUnlock(_symLock);
+      WIISYSLOG("Failed to open kernel symbols");
+      return kIOReturnNoMemory;
     }
   }
 
-  WIISYSLOG("Failed to locate symbol '%s'", symbolName);
-  return 0;
+  status = kIOReturnSuccess;
+  for (UInt32 i = 0; i < count; i++) {
+    symbolValues[i] = _kernelSymbols->findSymbol(symbolNames[i]);
+    if (symbolValues[i] != 0) {
+      WIIDBGLOG("Found symbol '%s' at 0x%X", symbolNames[i], symbolValues[i]);
+    } else {
+      WIISYSLOG("Failed to locate symbol '%s'", symbolNames[i]);
+      status = kIOReturnNotFound;
+    }
+  }
+  IOLockUnlock(_symLock);
+
+  return status;
+}
+
+//
+// Resolve a kernel symbol.
+//
+UInt32 WiiPE::resolveKernelSymbol(const char *symbolName) {
+  UInt32 symbolValue;
+
+  symbolValue = 0;
+  resolveKernelSymbols(&symbolName, &symbolValue, 1);
+  return symbolValue;
+}
+
+//
+// Frees the symbol index and stops further symbol lookups.
+//
+void WiiPE::closeKernelSymbols(void) {
+  IOLockLock(_symLock);
+  OSSafeReleaseNULL(_kernelSymbols);
+  _symLookupsClosed = true;
+  IOLockUnlock(_symLock);
+
+  if (_bsdNotifier != NULL) {
+    _bsdNotifier->remove();
+    _bsdNotifier = NULL;
+  }
+  WIIDBGLOG("Closed kernel symbol lookups");
+}
+
+//
+// Called when the BSD layer resource is published.
+//
+bool WiiPE::handleBSDPublished(void *target, void *refCon, IOService *newService) {
+  ((WiiPE *) target)->closeKernelSymbols();
+  return true;
 }
@@ -108,6 +108,7 @@ bool WiiSDHC::start(IOService *provider) {
     return false;
   }
   _workLoop->addEventSource(_interruptEventSource);
+  applyInterruptAffinity(this, provider, 0);
   _interruptEventSource->enable();
 
   //
@@ -14,6 +14,7 @@
 #include <IOKit/IOInterruptEventSource.h>
 #include <IOKit/IOService.h>
 
+#include "WiiCacheCopy.hpp"
 #include "WiiCommon.hpp"
 #include "WiiSDCommand.hpp"
 #include "SDHCRegs.hpp"
@@ -486,9 +486,7 @@ IOReturn WiiSDHC::prepareDataTx(void) {
   if (_currentCommand->getBlockCount() > 0) {
     if (memoryDescriptor->getDirection() == kIODirectionOut) {
       memoryDescriptor->prepare();
-      memoryDescriptor->readBytes(_currentCommand->getBufferOffset(), _doubleBufferPtr, seg->length);
-
-      flushDataCache(_doubleBufferPtr, seg->length);
+      readToDMABuffer(memoryDescriptor, _currentCommand->getBufferOffset(), _doubleBufferPtr, seg->length);
       memoryDescriptor->complete();
     }
 
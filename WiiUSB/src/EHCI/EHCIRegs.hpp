@@ -0,0 +1,338 @@
+//
+//  EHCIRegs.hpp
+//  EHCI USB controller register definitions
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef EHCIRegs_hpp
+#define EHCIRegs_hpp
+
+#include <IOKit/usb/USB.h>
+#include "WiiCommon.hpp"
+
+#define USB_CONSTANT16(x)	((((x) >> 8) & 0x0FF) | (((x) & 0xFF) << 8))
+
+//
+// EHCI registers.
+// All are 32-bit and normally are little endian, but on Wii they are big endian.
+//
+// Capability registers.
+// Length and version share the first register.
+//
+#define kEHCIRegCapLength                     0x00
+#define kEHCIRegCapLengthMask                 BITRange(0, 7)
+#define kEHCIRegCapVersionMask                BITRange(16, 31)
+#define kEHCIRegCapVersionShift               16
+
+#define kEHCIRegHCSParams                     0x04
+#define kEHCIRegHCSParamsNumPortsMask         BITRange(0, 3)
+#define kEHCIRegHCSParamsPortPower            BIT4
+#define kEHCIRegHCSParamsNumCCMask            BITRange(12, 15)
+#define kEHCIRegHCSParamsNumCCShift           12
+
+#define kEHCIRegHCCParams                     0x08
+#define kEHCIRegHCCParams64Bit                BIT0
+#define kEHCIRegHCCParamsProgFrameList        BIT1
+#define kEHCIRegHCCParamsAsyncPark            BIT2
+
+//
+// Operational registers, offset from the capability length.
+//
+#define kEHCIRegCommand                       0x00
+#define kEHCIRegCommandRun                    BIT0
+#define kEHCIRegCommandHostControllerReset    BIT1
+#define kEHCIRegCommandFrameListSizeMask      BITRange(2, 3)
+#define kEHCIRegCommandFrameListSize1024      0
+#define kEHCIRegCommandPeriodicEnable         BIT4
+#define kEHCIRegCommandAsyncEnable            BIT5
+#define kEHCIRegCommandAsyncAdvanceDoorbell   BIT6
+#define kEHCIRegCommandIntThresholdMask       BITRange(16, 23)
+#define kEHCIRegCommandIntThreshold1          (1 << 16)
+
+#define kEHCIRegStatus                        0x04
+#define kEHCIRegStatusInterrupt               BIT0
+#define kEHCIRegStatusErrorInterrupt          BIT1
+#define kEHCIRegStatusPortChange              BIT2
+#define kEHCIRegStatusFrameListRollover       BIT3
+#define kEHCIRegStatusHostSystemError         BIT4
+#define kEHCIRegStatusAsyncAdvance            BIT5
+#define kEHCIRegStatusHalted                  BIT12
+#define kEHCIRegStatusReclamation             BIT13
+#define kEHCIRegStatusPeriodicStatus          BIT14
+#define kEHCIRegStatusAsyncStatus             BIT15
+#define kEHCIRegStatusIntMask                 BITRange(0, 5)
+
+#define kEHCIRegIntEnable                     0x08
+#define kEHCIRegIntEnableInterrupt            BIT0
+#define kEHCIRegIntEnableErrorInterrupt       BIT1
+#define kEHCIRegIntEnablePortChange           BIT2
+#define kEHCIRegIntEnableFrameListRollover    BIT3
+#define kEHCIRegIntEnableHostSystemError      BIT4
+#define kEHCIRegIntEnableAsyncAdvance         BIT5
+
+#define kEHCIRegFrameIndex                    0x0C
+#define kEHCIRegFrameIndexMask                BITRange(0, 13)
+#define kEHCIRegFrameIndexFrameShift          3
+#define kEHCIRegFrameIndexFrameMask           BITRange(0, 9)
+
+#define kEHCIRegCtrlDSSegment                 0x10
+#define kEHCIRegPeriodicListBase              0x14
+#define kEHCIRegAsyncListAddr                 0x18
+
+#define kEHCIRegConfigFlag                    0x40
+#define kEHCIRegConfigFlagRouteEHCI           BIT0
+
+#define kEHCIRegPortStatusBase                0x44
+
+//
+// Port status and control register.
+//
+#define kEHCIRegPortStatusConnect             BIT0
+#define kEHCIRegPortStatusConnectChange       BIT1
+#define kEHCIRegPortStatusEnable              BIT2
+#define kEHCIRegPortStatusEnableChange        BIT3
+#define kEHCIRegPortStatusOverCurrent         BIT4
+#define kEHCIRegPortStatusOverCurrentChange   BIT5
+#define kEHCIRegPortStatusForceResume         BIT6
+#define kEHCIRegPortStatusSuspend             BIT7
+#define kEHCIRegPortStatusReset               BIT8
+#define kEHCIRegPortStatusLineStatusMask      BITRange(10, 11)
+#define kEHCIRegPortStatusLineStatusKState    (1 << 10)
+#define kEHCIRegPortStatusPower               BIT12
+#define kEHCIRegPortStatusOwner               BIT13
+#define kEHCIRegPortStatusChangeMask          (kEHCIRegPortStatusConnectChange | kEHCIRegPortStatusEnableChange | kEHCIRegPortStatusOverCurrentChange)
+
+//
+// Hollywood EHCI control register, offset from the capability registers.
+// Interrupts are not forwarded to Broadway unless enabled here.
+//
+#define kEHCIRegHollywoodControl              0xCC
+#define kEHCIRegHollywoodControlIntEnable     BIT15
+
+//
+// Periodic frame list.
+//
+#define kEHCIFrameListSize                    1024
+
+//
+// Link pointers, used by the frame list and queue head horizontal links.
+//
+#define kEHCILinkTerminate                    BIT0
+#define kEHCILinkTypeIsoTD                    (0 << 1)
+#define kEHCILinkTypeQueueHead                (1 << 1)
+#define kEHCILinkTypeSplitIsoTD               (2 << 1)
+#define kEHCILinkTypeFrameSpan                (3 << 1)
+#define kEHCILinkPhysAddrMask                 BITRange(5, 31)
+
+//
+// EHCI queue element transfer descriptor (qTD).
+//
+// All fields must be little endian.
+// This structure must be 32-byte aligned.
+//
+#define kEHCIQueueTDAlignment                 32
+#define kEHCIQueueTDBufferCount               5
+
+typedef struct {
+  // Next qTD.
+  volatile UInt32 nextTDPhysAddr;
+  // Next qTD on short packet.
+  volatile UInt32 altNextTDPhysAddr;
+  // Status and control token.
+  volatile UInt32 token;
+  // Buffer page pointers. First includes the current offset.
+  volatile UInt32 bufferPhysAddr[kEHCIQueueTDBufferCount];
+} EHCIQueueTransferDescriptor;
+OSCompileAssert(sizeof (EHCIQueueTransferDescriptor) == kEHCIQueueTDAlignment);
+
+#define kEHCIQueueTDTokenStatusPing           BIT0
+#define kEHCIQueueTDTokenStatusSplitState     BIT1
+#define kEHCIQueueTDTokenStatusMissedFrame    BIT2
+#define kEHCIQueueTDTokenStatusXactError      BIT3
+#define kEHCIQueueTDTokenStatusBabble         BIT4
+#define kEHCIQueueTDTokenStatusBufferError    BIT5
+#define kEHCIQueueTDTokenStatusHalted         BIT6
+#define kEHCIQueueTDTokenStatusActive         BIT7
+#define kEHCIQueueTDTokenStatusMask           BITRange(0, 7)
+#define kEHCIQueueTDTokenPIDOut               (0 << 8)
+#define kEHCIQueueTDTokenPIDIn                (1 << 8)
+#define kEHCIQueueTDTokenPIDSetup             (2 << 8)
+#define kEHCIQueueTDTokenPIDMask              BITRange(8, 9)
+#define kEHCIQueueTDTokenErrorCountMask       BITRange(10, 11)
+#define kEHCIQueueTDTokenErrorCountShift      10
+#define kEHCIQueueTDTokenCurrentPageMask      BITRange(12, 14)
+#define kEHCIQueueTDTokenIOC                  BIT15
+#define kEHCIQueueTDTokenBytesMask            BITRange(16, 30)
+#define kEHCIQueueTDTokenBytesShift           16
+#define kEHCIQueueTDTokenDataToggle           BIT31
+
+#define kEHCIQueueTDErrorCountMax             3
+
+//
+// EHCI queue head (QH).
+//
+// All fields must be little endian.
+// This structure must be 32-byte aligned, it is padded to 64 bytes to keep each on separate cache lines.
+//
+#define kEHCIQueueHeadAlignment               64
+
+typedef struct {
+  // Next queue head or other periodic structure.
+  volatile UInt32 horizLinkPhysAddr;
+  // Endpoint characteristics.
+  volatile UInt32 flags;
+  // Endpoint capabilities, including split transaction info.
+  volatile UInt32 splitFlags;
+  // Current qTD.
+  volatile UInt32 currentTDPhysAddr;
+  // Transfer overlay area.
+  volatile UInt32 nextTDPhysAddr;
+  volatile UInt32 altNextTDPhysAddr;
+  volatile UInt32 token;
+  volatile UInt32 bufferPhysAddr[kEHCIQueueTDBufferCount];
+  // Padding.
+  UInt32          reserved[4];
+} EHCIQueueHead;
+OSCompileAssert(sizeof (EHCIQueueHead) == kEHCIQueueHeadAlignment);
+
+#define kEHCIQHFlagsFuncMask                  BITRange(0, 6)
+#define kEHCIQHFlagsInactivate                BIT7
+#define kEHCIQHFlagsEndpointMask              BITRange(8, 11)
+#define kEHCIQHFlagsEndpointShift             8
+#define kEHCIQHFlagsSpeedFull                 (0 << 12)
+#define kEHCIQHFlagsSpeedLow                  (1 << 12)
+#define kEHCIQHFlagsSpeedHigh                 (2 << 12)
+#define kEHCIQHFlagsSpeedMask                 BITRange(12, 13)
+#define kEHCIQHFlagsDataToggleControl         BIT14
+#define kEHCIQHFlagsHead                      BIT15
+#define kEHCIQHFlagsMaxPktSizeMask            BITRange(16, 26)
+#define kEHCIQHFlagsMaxPktSizeShift           16
+#define kEHCIQHFlagsControlEndpoint           BIT27
+#define kEHCIQHFlagsNakReloadMask             BITRange(28, 31)
+#define kEHCIQHFlagsNakReloadShift            28
+
+#define kEHCIQHSplitFlagsStartMaskMask        BITRange(0, 7)
+#define kEHCIQHSplitFlagsCompleteMaskMask     BITRange(8, 15)
+#define kEHCIQHSplitFlagsCompleteMaskShift    8
+#define kEHCIQHSplitFlagsHubAddrMask          BITRange(16, 22)
+#define kEHCIQHSplitFlagsHubAddrShift         16
+#define kEHCIQHSplitFlagsPortMask             BITRange(23, 29)
+#define kEHCIQHSplitFlagsPortShift            23
+#define kEHCIQHSplitFlagsMultMask             BITRange(30, 31)
+#define kEHCIQHSplitFlagsMultShift            30
+
+//
+// NAK counter reload for high speed asynchronous endpoints. Must be zero for split and periodic endpoints.
+//
+#define kEHCIQHNakReloadHighSpeed             4
+
+//
+// Start split in microframe 0, complete splits in microframes 2-4.
+//
+#define kEHCIQHSplitStartMask                 BIT0
+#define kEHCIQHSplitCompleteMask              (BIT2 | BIT3 | BIT4)
+
+//
+// Microframes per frame.
+//
+#define kEHCIMicroframesPerFrame              8
+
+struct EHCITransferData;
+
+//
+// EHCI bounce buffer data.
+//
+typedef struct EHCIBounceBuffer {
+  // Pointer to next linked bounce buffer, used for free linked lists.
+  struct EHCIBounceBuffer *next;
+  // Is bounce buffer jumbo?
+  bool                    jumbo;
+
+  // Bounce buffer descriptor (Wii U only).
+  IOMemoryDescriptor      *desc;
+  // Bounce buffer physical address.
+  IOPhysicalAddress       physAddr;
+  // Bounce buffer mapped into kernel memory.
+  void                    *buf;
+} EHCIBounceBuffer;
+
+//
+// EHCI endpoint data.
+//
+typedef struct EHCIEndpointData {
+  // EHCI queue head used by the host controller.
+  EHCIQueueHead             *qh;
+  // Physical address of the queue head.
+  UInt32                    physAddr;
+  // Pointer to next linked endpoint in the same schedule list.
+  struct EHCIEndpointData   *nextEndpoint;
+  // Pointer to next active endpoint, used for completion scanning and lookups.
+  struct EHCIEndpointData   *nextActiveEndpoint;
+
+  // Endpoint type mask.
+  UInt8                     type;
+  // Function address.
+  UInt8                     functionNumber;
+  // Endpoint number.
+  UInt8                     endpointNumber;
+  // Endpoint direction.
+  UInt8                     direction;
+  // Endpoint speed.
+  UInt8                     speed;
+  // Max packet size.
+  UInt16                    maxPacketSize;
+  // Interrupt tree node, if an interrupt endpoint.
+  UInt8                     interruptNode;
+  // Periodic bandwidth reserved at the interrupt node, in bytes.
+  UInt16                    bandwidth;
+
+  // Oldest transfer still owned by the host controller.
+  struct EHCITransferData   *transferHead;
+  // Dummy tail transfer, the next transfer is built here.
+  struct EHCITransferData   *transferTail;
+
+  // Pointer to next endpoint waiting on the controller after a nested unlink.
+  struct EHCIEndpointData   *nextUnlinkEndpoint;
+  // Operation to finish once the controller has released the queue head.
+  UInt8                     unlinkOperation;
+} EHCIEndpointData;
+
+//
+// EHCI transfer data.
+//
+typedef struct EHCITransferData {
+  // EHCI queue element transfer descriptor used by the host controller.
+  EHCIQueueTransferDescriptor *td;
+  // Physical address of the transfer descriptor.
+  UInt32                      physAddr;
+  // Pointer to next linked transfer.
+  struct EHCITransferData     *nextTransfer;
+  // Pointer to parent endpoint.
+  EHCIEndpointData            *endpoint;
+  // Is transfer the last for a transaction.
+  bool                        last;
+
+  // Bounce buffer.
+  EHCIBounceBuffer    *bounceBuffer;
+  // Used bounce buffer size.
+  UInt32              actualBufferSize;
+  // Original buffer descriptor.
+  IOMemoryDescriptor  *srcBuffer;
+  // Completion callback.
+  IOUSBCompletion     completion;
+} EHCITransferData;
+
+//
+// EHCI interrupt tree node.
+//
+typedef struct {
+  // Static queue head for this node.
+  EHCIEndpointData  *headEndpoint;
+  // Parent node, one polling rate faster.
+  UInt8             parentNode;
+  // Bandwidth used by endpoints placed on this node.
+  UInt32            bandwidth;
+} EHCIIntEndpoint;
+
+#endif
@@ -0,0 +1,339 @@
+//
+//  WiiEHCI.cpp
+//  Wii EHCI USB controller interface
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include <IOKit/IOPlatformExpert.h>
+#include "WiiEHCI.hpp"
+
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+
+OSDefineMetaClassAndStructors(WiiEHCI, super);
+
+//
+// Overrides IOUSBController::init().
+//
+bool WiiEHCI::init(OSDictionary *dictionary) {
+  WiiCheckDebugArgs();
+
+  _memoryMap              = NULL;
+  _mem2Service            = NULL;
+  _mem2Client             = NULL;
+  _baseAddr               = NULL;
+  _opRegOffset            = 0;
+  _numPorts               = 0;
+  _interruptEventSource   = NULL;
+
+  _intTransferComplete    = false;
+  _intPortChange          = false;
+  _intHostSystemError     = false;
+
+  _unlinkThreadCall       = NULL;
+  _unlinkBusy             = false;
+  _unlinkSleeping         = false;
+  _unlinkDepth            = 0;
+  _asyncAdvanceDone       = false;
+  _unlinkEndpointHeadPtr  = NULL;
+  _unlinkTransferHeadPtr  = NULL;
+
+  _invalidateCacheFunc    = NULL;
+
+  _descriptorBufferHeadPtr  = NULL;
+  _freeEndpointHeadPtr      = NULL;
+  _activeEndpointHeadPtr    = NULL;
+  _asyncHeadEndpoint        = NULL;
+  bzero(_interruptEndpoints, sizeof (_interruptEndpoints));
+  bzero(_microframeLoad, sizeof (_microframeLoad));
+
+  _freeBounceBufferHeadPtr      = NULL;
+  _freeBounceBufferJumboHeadPtr = NULL;
+  _freeTransferHeadPtr          = NULL;
+
+  _frameListDesc      = NULL;
+  _frameListPhysAddr  = 0;
+  _frameListPtr       = NULL;
+  _frameNumber        = 0;
+
+  _rootHubAddress         = 0;
+  _rootHubPortResetChange = 0;
+
+  _rootHubInterruptTransLock = IOLockAlloc();
+  if (_rootHubInterruptTransLock == NULL) {
+    return false;
+  }
+  bzero(_rootHubInterruptTransactions, sizeof (_rootHubInterruptTransactions));
+
+  return super::init(dictionary);
+}
+
+//
+// Overrides IOUSBController::UIMInitialize().
+//
+// Initializes the USB controller.
+// Called from IOUSBController::start().
+//
+IOReturn WiiEHCI::UIMInitialize(IOService *provider) {
+  const OSSymbol    *functionSymbol;
+  EHCIBounceBuffer  *bounceBuffer;
+  UInt32            hcsParams;
+  IOReturn          status;
+
+  WiiSetDebugLocation(provider->getLocation());
+
+  //
+  // Map controller memory.
+  //
+  _memoryMap = provider->mapDeviceMemoryWithIndex(0);
+  if (_memoryMap == NULL) {
+    WIISYSLOG("Failed to map EHCI memory");
+    return kIOReturnNoResources;
+  }
+  _baseAddr = (volatile void *)_memoryMap->getVirtualAddress();
+  WIIDBGLOG("Mapped registers to %p (physical 0x%X), length: 0x%X", _baseAddr,
+    _memoryMap->getPhysicalAddress(), _memoryMap->getLength());
+
+  //
+  // Get cache invalidation function.
+  //
+  functionSymbol = OSSymbol::withCString(kWiiFuncPlatformGetInvalidateCache);
+  if (functionSymbol == NULL) {
+    return kIOReturnNoResources;
+  }
+  status = getPlatform()->callPlatformFunction(functionSymbol, false, &_invalidateCacheFunc, 0, 0, 0);
+  functionSymbol->release();
+  if (status != kIOReturnSuccess) {
+    return status;
+  }
+
+  if (_invalidateCacheFunc == NULL) {
+    WIISYSLOG("Failed to get cache invalidation function");
+    return kIOReturnUnsupported;
+  }
+
+  //
+  // Get MEM2 allocation service and create a client for this controller if on Wii.
+  //
+  if (!checkPlatformCafe()) {
+    functionSymbol = OSSymbol::withCString(kWiiFuncPlatformGetMem2Service);
+    if (functionSymbol == NULL) {
+      return kIOReturnNoResources;
+    }
+    status = getPlatform()->callPlatformFunction(functionSymbol, false, &_mem2Service, 0, 0, 0);
+    functionSymbol->release();
+    if (status != kIOReturnSuccess) {
+      return status;
+    }
+
+    if (_mem2Service == NULL) {
+      WIISYSLOG("Failed to get MEM2 allocation service on Wii");
+      return kIOReturnUnsupported;
+    }
+    _mem2Client = _mem2Service->createClient(getName(), kWiiEHCIMem2Quota);
+    if (_mem2Client == NULL) {
+      return kIOReturnNoResources;
+    }
+  }
+
+  //
+  // Get operational register offset and port count.
+  //
+  _opRegOffset = readReg32(kEHCIRegCapLength) & kEHCIRegCapLengthMask;
+  hcsParams    = readReg32(kEHCIRegHCSParams);
+  _numPorts    = hcsParams & kEHCIRegHCSParamsNumPortsMask;
+  WIIDBGLOG("EHCI version: 0x%X, ports: %u, companions: %u",
+    (readReg32(kEHCIRegCapLength) & kEHCIRegCapVersionMask) >> kEHCIRegCapVersionShift, _numPorts,
+    (hcsParams & kEHCIRegHCSParamsNumCCMask) >> kEHCIRegHCSParamsNumCCShift);
+
+  //
+  // Create interrupt.
+  //
+  _interruptEventSource = IOFilterInterruptEventSource::filterInterruptEventSource(this,
+    OSMemberFunctionCast(IOFilterInterruptEventSource::Action, this, &WiiEHCI::handleInterrupt),
+    OSMemberFunctionCast(IOFilterInterruptEventSource::Filter, this, &WiiEHCI::filterInterrupt),
+    provider, 0);
+  if (_interruptEventSource == NULL) {
+    WIISYSLOG("Failed to create interrupt");
+    return kIOReturnNoResources;
+  }
+  _workLoop->addEventSource(_interruptEventSource);
+
+  //
+  // Create unlink thread call, wakes unlink operations waiting on the controller.
+  //
+  _unlinkThreadCall = thread_call_allocate(handleUnlinkThreadCall, this);
+  if (_unlinkThreadCall == NULL) {
+    WIISYSLOG("Failed to create unlink thread call");
+    return kIOReturnNoResources;
+  }
+
+  //
+  // Stop and reset the controller.
+  //
+  writeOpReg32(kEHCIRegIntEnable, 0);
+  writeOpReg32(kEHCIRegCommand, readOpReg32(kEHCIRegCommand) & ~(kEHCIRegCommandRun));
+  for (UInt32 i = 0; (readOpReg32(kEHCIRegStatus) & kEHCIRegStatusHalted) == 0; i++) {
+    if (i >= kWiiEHCIHaltTimeoutUS) {
+      WIISYSLOG("Timed out waiting for the controller to halt");
+      return kIOReturnTimeout;
+    }
+    IODelay(1);
+  }
+
+  writeOpReg32(kEHCIRegCommand, kEHCIRegCommandHostControllerReset);
+  for (UInt32 i = 0; readOpReg32(kEHCIRegCommand) & kEHCIRegCommandHostControllerReset; i++) {
+    if (i >= kWiiEHCIResetTimeoutUS) {
+      WIISYSLOG("Timed out waiting for the controller to reset");
+      return kIOReturnTimeout;
+    }
+    IODelay(1);
+  }
+
+  if (readReg32(kEHCIRegHCCParams) & kEHCIRegHCCParams64Bit) {
+    writeOpReg32(kEHCIRegCtrlDSSegment, 0);
+  }
+
+  //
+  // Setup schedules.
+  //
+  status = initAsyncSchedule();
+  if (status != kIOReturnSuccess) {
+    WIISYSLOG("Failed to configure asynchronous schedule");
+    return status;
+  }
+
+  status = initPeriodicSchedule();
+  if (status != kIOReturnSuccess) {
+    WIISYSLOG("Failed to configure periodic schedule");
+    return status;
+  }
+
+  //
+  // Allocate initial bounce buffers.
+  //
+  for (UInt32 i = 0; i < kWiiEHCIBounceBufferInitialCount; i++) {
+    bounceBuffer = allocateBounceBuffer(false);
+    if (bounceBuffer == NULL) {
+      return kIOReturnNoMemory;
+    }
+    returnBounceBuffer(bounceBuffer);
+  }
+
+  for (UInt32 i = 0; i < kWiiEHCIBounceBufferJumboInitialCount; i++) {
+    bounceBuffer = allocateBounceBuffer(true);
+    if (bounceBuffer == NULL) {
+      return kIOReturnNoMemory;
+    }
+    returnBounceBuffer(bounceBuffer);
+  }
+
+  //
+  // On Wii, interrupts need to be enabled in the Hollywood-specific control register.
+  //
+  if (!checkPlatformCafe()) {
+    writeReg32(kEHCIRegHollywoodControl, readReg32(kEHCIRegHollywoodControl) | kEHCIRegHollywoodControlIntEnable);
+  }
+
+  //
+  // Start the controller with both schedules enabled, then route all ports to it.
+  //
+  writeOpReg32(kEHCIRegStatus, kEHCIRegStatusIntMask);
+  writeOpReg32(kEHCIRegCommand, kEHCIRegCommandIntThreshold1 | kEHCIRegCommandFrameListSize1024
+    | kEHCIRegCommandPeriodicEnable | kEHCIRegCommandAsyncEnable | kEHCIRegCommandRun);
+  writeOpReg32(kEHCIRegConfigFlag, kEHCIRegConfigFlagRouteEHCI);
+  IOSleep(5);
+
+  //
+  // Enable power to ports, if switchable.
+  //
+  if (hcsParams & kEHCIRegHCSParamsPortPower) {
+    for (UInt16 port = 1; port <= _numPorts; port++) {
+      writeRootHubPort32(port, (readRootHubPort32(port) & ~(kEHCIRegPortStatusChangeMask)) | kEHCIRegPortStatusPower);
+    }
+    IOSleep(20);
+  }
+
+  //
+  // Root hub starts at 1.
+  //
+  _rootHubAddress = 1;
+
+  //
+  // Enable interrupts.
+  //
+  _interruptEventSource->enable();
+  writeOpReg32(kEHCIRegIntEnable, kEHCIRegIntEnableInterrupt | kEHCIRegIntEnableErrorInterrupt
+    | kEHCIRegIntEnablePortChange | kEHCIRegIntEnableFrameListRollover | kEHCIRegIntEnableHostSystemError
+    | kEHCIRegIntEnableAsyncAdvance);
+
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::UIMFinalize().
+//
+// Cleans up the USB controller.
+// Called from IOUSBController::stop().
+//
+IOReturn WiiEHCI::UIMFinalize(void) {
+  WIIDBGLOG("start");
+
+  //
+  // Stop the controller and hand all ports back to the companion controllers.
+  //
+  if (_baseAddr != NULL) {
+    writeOpReg32(kEHCIRegIntEnable, 0);
+    writeOpReg32(kEHCIRegCommand, readOpReg32(kEHCIRegCommand) & ~(kEHCIRegCommandRun));
+    writeOpReg32(kEHCIRegConfigFlag, 0);
+  }
+
+  if (_unlinkThreadCall != NULL) {
+    thread_call_cancel(_unlinkThreadCall);
+    thread_call_free(_unlinkThreadCall);
+    _unlinkThreadCall = NULL;
+  }
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::GetBandwidthAvailable().
+//
+// Gets the number of bytes available per frame for isochronous transfers.
+// Isochronous transfers are not supported, no bandwidth is ever available so clients fail before queuing any.
+// Full and low speed devices plugged directly into a root port are handed to the companion OHCI controller instead.
+//
+UInt32 WiiEHCI::GetBandwidthAvailable(void) {
+  return 0;
+}
+
+//
+// Overrides IOUSBController::GetFrameNumber().
+//
+// Gets the current frame number.
+//
+UInt64 WiiEHCI::GetFrameNumber(void) {
+  UInt64 fullFrameNumber;
+  UInt32 hcFrameNumber;
+
+  hcFrameNumber   = (readOpReg32(kEHCIRegFrameIndex) >> kEHCIRegFrameIndexFrameShift) & kEHCIRegFrameIndexFrameMask;
+  fullFrameNumber = _frameNumber + hcFrameNumber;
+  if (hcFrameNumber < 200) {
+    if (readOpReg32(kEHCIRegStatus) & kEHCIRegStatusFrameListRollover) {
+      fullFrameNumber += kEHCIFrameListSize;
+    }
+  }
+
+  return fullFrameNumber;
+}
+
+//
+// Overrides IOUSBController::GetFrameNumber32().
+//
+// Gets the least significant 32 bits of the current frame number.
+//
+UInt32 WiiEHCI::GetFrameNumber32(void) {
+  return (UInt32) GetFrameNumber();
+}
+
+#endif
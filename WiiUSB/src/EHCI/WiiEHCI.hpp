@@ -0,0 +1,361 @@
+//
+//  WiiEHCI.hpp
+//  Wii EHCI USB controller interface
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef WiiEHCI_hpp
+#define WiiEHCI_hpp
+
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include <IOKit/IOFilterInterruptEventSource.h>
+
+#include <kern/thread_call.h>
+
+#include "WiiCacheCopy.hpp"
+#include "WiiCommon.hpp"
+#include "WiiMem2.hpp"
+
+//
+// High speed support in IOUSBFamily requires IOUSBControllerV2, which first shipped with 10.2.
+// On older releases all ports remain routed to the companion OHCI controllers.
+//
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+
+#include <IOKit/usb/IOUSBControllerV2.h>
+#include "EHCIRegs.hpp"
+
+//
+// On Wii, located in MEM2. On Wii U, located anywhere.
+// Regular buffers hold a single high speed bulk packet, jumbo buffers are a full page.
+// Both are aligned to their size so each only ever needs the first qTD buffer pointer.
+//
+#define kWiiEHCIBounceBufferSize              0x200
+#define kWiiEHCIBounceBufferInitialCount      64
+#define kWiiEHCIBounceBufferJumboSize         PAGE_SIZE
+#define kWiiEHCIBounceBufferJumboInitialCount 32
+// MEM2 quota on Wii, bounce buffers are reused so this only limits runaway growth.
+#define kWiiEHCIMem2Quota                     0x100000
+
+//
+// Total interrupt nodes in tree, same layout as OHCI.
+// 32 32ms nodes, 16 16ms nodes, 8 8ms nodes, 4 4ms nodes, 2 2ms nodes, 1 1ms node
+//
+#define kWiiEHCIInterruptNodeCount    (32 + 16 + 8 + 4 + 2 + 1)
+#define kWiiEHCIInterruptRootNode     (kWiiEHCIInterruptNodeCount - 1)
+#define kWiiEHCIInterruptLeafCount    32
+#define kWiiEHCIInterruptNodeNone     0xFF
+
+//
+// Controller halt and reset timeouts.
+//
+#define kWiiEHCIHaltTimeoutUS           2000
+#define kWiiEHCIResetTimeoutUS          250000
+
+//
+// Time to wait for the controller to release unlinked queue heads, checked once per microframe.
+//
+#define kWiiEHCIUnlinkTimeoutUS         5000
+#define kWiiEHCIUnlinkTickUS            125
+
+//
+// Port reset timings.
+//
+#define kWiiEHCIPortResetMS             50
+#define kWiiEHCIPortResetDoneTimeoutUS  2000
+#define kWiiEHCIPortResumeMS            20
+
+//
+// Endpoint type masks.
+//
+#define kWiiEHCIEndpointTypeControl             BIT0
+#define kWiiEHCIEndpointTypeInterrupt           BIT1
+#define kWiiEHCIEndpointTypeBulk                BIT2
+#define kWiiEHCIEndpointTypeIsochronous         BIT3
+#define kWiiEHCIEndpointTypeAll                 BITRange(0, 4)
+
+//
+// Operations left to finish on endpoints unlinked by nested unlinks, in increasing precedence.
+//
+#define kWiiEHCIUnlinkOpNone                    0
+#define kWiiEHCIUnlinkOpRelink                  1
+#define kWiiEHCIUnlinkOpClearStall              2
+#define kWiiEHCIUnlinkOpRelease                 3
+
+#define kWiiEHCIEndpointsPerBuffer        (PAGE_SIZE / sizeof (EHCIQueueHead))
+#define kWiiEHCITransfersPerBuffer        (PAGE_SIZE / sizeof (EHCIQueueTransferDescriptor))
+
+//
+// EHCI descriptor memory buffer.
+// Holds a page of either queue heads or queue element transfer descriptors.
+//
+class WiiEHCIDescriptorBuffer : public OSObject {
+  OSDeclareDefaultStructors(WiiEHCIDescriptorBuffer);
+  typedef OSObject super;
+
+private:
+  IOBufferMemoryDescriptor  *_buffer;
+  IOPhysicalAddress         _physicalAddr;
+  void                      *_descriptors;
+  void                      *_data;
+  IOByteCount               _dataLength;
+  WiiEHCIDescriptorBuffer   *_nextBuffer;
+
+public:
+  //
+  // Overrides.
+  //
+  void free();
+
+  //
+  // Buffer functions.
+  //
+  static WiiEHCIDescriptorBuffer *descriptorBuffer(IOByteCount dataLength);
+  void setNextBuffer(WiiEHCIDescriptorBuffer *buffer);
+  WiiEHCIDescriptorBuffer *getNextBuffer(void);
+  IOPhysicalAddress getPhysAddr(void);
+  void *getDescriptors(void);
+  void *getData(void);
+};
+
+//
+// Represents the Wii EHCI USB controller.
+//
+class WiiEHCI : public IOUSBControllerV2 {
+  OSDeclareDefaultStructors(WiiEHCI);
+  WiiDeclareLogFunctions("ehci");
+  typedef IOUSBControllerV2 super;
+
+private:
+  IOMemoryMap             *_memoryMap;
+  volatile void           *_baseAddr;
+  UInt32                  _opRegOffset;
+  UInt8                   _numPorts;
+  const WiiMem2Service    *_mem2Service;
+  WiiMem2Client           *_mem2Client;
+
+  //
+  // Interrupts.
+  //
+  IOFilterInterruptEventSource  *_interruptEventSource;
+  volatile bool                 _intTransferComplete;
+  volatile bool                 _intPortChange;
+  volatile bool                 _intHostSystemError;
+
+  //
+  // Queue head unlinking.
+  // The command gate is released while waiting on the controller, so unlinks are serialized.
+  // Waiters are woken from the primary interrupt and a thread call, never the workloop, as the workloop thread may be the one waiting.
+  // Nested unlinks cannot release the gate, their endpoints and removed transfers are kept until the owner has waited.
+  //
+  thread_call_t                 _unlinkThreadCall;
+  bool                          _unlinkBusy;
+  bool                          _unlinkSleeping;
+  UInt32                        _unlinkDepth;
+  volatile bool                 _asyncAdvanceDone;
+  EHCIEndpointData              *_unlinkEndpointHeadPtr;
+  EHCITransferData              *_unlinkTransferHeadPtr;
+
+  // _invalidate_dcache pointer. This function is not exported on 10.4
+  WiiInvalidateDataCacheFunc  _invalidateCacheFunc;
+
+  //
+  // Endpoints.
+  //
+  WiiEHCIDescriptorBuffer *_descriptorBufferHeadPtr;
+
+  // Free endpoints.
+  EHCIEndpointData      *_freeEndpointHeadPtr;
+
+  // All endpoints with a queue head on a schedule, used for lookups and completion scanning.
+  EHCIEndpointData      *_activeEndpointHeadPtr;
+
+  // Asynchronous schedule reclamation head.
+  EHCIEndpointData      *_asyncHeadEndpoint;
+
+  // Interrupt endpoints.
+  EHCIIntEndpoint       _interruptEndpoints[kWiiEHCIInterruptNodeCount];
+  UInt32                _microframeLoad[kEHCIMicroframesPerFrame];
+
+  //
+  // Transfers.
+  //
+  // Bounce buffers.
+  EHCIBounceBuffer      *_freeBounceBufferHeadPtr;
+  EHCIBounceBuffer      *_freeBounceBufferJumboHeadPtr;
+
+  // Transfer descriptors.
+  EHCITransferData      *_freeTransferHeadPtr;
+
+  // Periodic frame list.
+  IOBufferMemoryDescriptor  *_frameListDesc;
+  IOPhysicalAddress         _frameListPhysAddr;
+  volatile UInt32           *_frameListPtr;
+  volatile UInt64           _frameNumber;
+
+  // Root hub.
+  UInt16  _rootHubAddress;
+  UInt32  _rootHubPortResetChange;
+  struct WiiEHCIRootHubIntTransaction {
+    IOMemoryDescriptor  *buffer;
+    UInt32              bufferLength;
+    IOUSBCompletion     completion;
+  } _rootHubInterruptTransactions[4];
+  IOLock  *_rootHubInterruptTransLock;
+
+  inline UInt32 readReg32(UInt32 offset) {
+    return OSReadBigInt32(_baseAddr, offset);
+  }
+  inline void writeReg32(UInt32 offset, UInt32 data) {
+    OSWriteBigInt32(_baseAddr, offset, data);
+  }
+  inline UInt32 readOpReg32(UInt32 offset) {
+    return readReg32(_opRegOffset + offset);
+  }
+  inline void writeOpReg32(UInt32 offset, UInt32 data) {
+    writeReg32(_opRegOffset + offset, data);
+  }
+  inline UInt32 readRootHubPort32(UInt16 port) {
+    return readOpReg32(kEHCIRegPortStatusBase + ((port - 1) * sizeof (UInt32)));
+  }
+  inline void writeRootHubPort32(UInt16 port, UInt32 data) {
+    writeOpReg32(kEHCIRegPortStatusBase + ((port - 1) * sizeof (UInt32)), data);
+  }
+
+  //
+  // Interrupt functions.
+  //
+  bool filterInterrupt(IOFilterInterruptEventSource *filterIntEventSource);
+  void handleInterrupt(IOInterruptEventSource *intEventSource, int count);
+  static void handleUnlinkThreadCall(thread_call_param_t param0, thread_call_param_t param1);
+
+  IOReturn simulateRootHubControlEDCreate(UInt8 endpointNumber, UInt16 maxPacketSize, UInt8 speed);
+  IOReturn simulateRootHubInterruptEDCreate(short endpointNumber, UInt8 direction, short speed, UInt16 maxPacketSize);
+  void simulateRootHubInterruptTransfer(short endpointNumber, IOUSBCompletion completion,
+                                        IOMemoryDescriptor *CBP, bool bufferRounding, UInt32 bufferSize, short direction);
+  void completeRootHubInterruptTransfer(bool abort);
+  IOReturn resetRootHubPort(UInt16 port);
+
+  //
+  // Buffer functions.
+  //
+  EHCIBounceBuffer *allocateBounceBuffer(bool jumbo);
+  EHCIBounceBuffer *getFreeBounceBuffer(bool jumbo);
+  void returnBounceBuffer(EHCIBounceBuffer *bounceBuffer);
+
+  //
+  // Descriptor functions.
+  //
+  IOReturn convertTDStatus(UInt32 token);
+  IOReturn allocateFreeEndpoints(void);
+  IOReturn allocateFreeTransfers(void);
+  EHCIEndpointData *getFreeEndpoint(void);
+  EHCITransferData *getFreeTransfer(EHCIEndpointData *endpoint);
+  void returnEndpoint(EHCIEndpointData *endpoint);
+  void returnTransfer(EHCITransferData *transfer);
+
+  IOReturn initAsyncSchedule(void);
+  IOReturn initPeriodicSchedule(void);
+  EHCIEndpointData *getEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt8 direction, UInt8 *type);
+  UInt8 getInterruptNode(UInt8 pollingFrames);
+  UInt8 getInterruptMicroframe(UInt32 bandwidth);
+  IOReturn addNewEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt16 maxPacketSize, UInt8 speed,
+                          UInt8 direction, UInt8 type, USBDeviceAddress highSpeedHub, int highSpeedPort,
+                          EHCIEndpointData **outEndpoint);
+  void linkEndpoint(EHCIEndpointData *endpoint, EHCIEndpointData *headEndpoint);
+  void acquireUnlink(void);
+  void releaseUnlink(void);
+  bool unlinkEndpoint(EHCIEndpointData *endpoint);
+  void deferUnlinkedEndpoint(EHCIEndpointData *endpoint, UInt8 operation);
+  void finishDeferredUnlinks(void);
+  void waitUnlinkTick(void);
+  void waitAsyncAdvance(void);
+  void waitFrameAdvance(void);
+  EHCIEndpointData *getEndpointHead(EHCIEndpointData *endpoint);
+  void resetEndpointQueue(EHCIEndpointData *endpoint, bool resetDataToggle);
+  void removeEndpointTransfers(EHCIEndpointData *endpoint, IOReturn status, bool released);
+
+  //
+  // Transfers.
+  //
+  IOReturn doGeneralTransfer(EHCIEndpointData *endpoint, IOUSBCompletion completion,
+                             IOMemoryDescriptor *buffer, UInt32 bufferSize, UInt32 pid, bool dataToggle);
+  void completeTransaction(EHCITransferData *transfer, IOReturn status, UInt32 bufferSizeRemaining);
+  void scanEndpointTransfers(EHCIEndpointData *endpoint, IOUSBCompletionAction safeAction = NULL);
+  void scanCompletedTransfers(IOUSBCompletionAction safeAction = NULL);
+
+protected:
+  //
+  // Overrides.
+  //
+  IOReturn UIMInitialize(IOService *provider);
+  IOReturn UIMFinalize(void);
+  IOReturn UIMCreateControlEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt16 maxPacketSize, UInt8 speed);
+  IOReturn UIMCreateControlEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt16 maxPacketSize, UInt8 speed,
+                                    USBDeviceAddress highSpeedHub, int highSpeedPort);
+  IOReturn UIMCreateControlTransfer(short functionNumber, short endpointNumber, IOUSBCompletion completion, void *CBP,
+                                    bool bufferRounding, UInt32 bufferSize, short direction);
+  IOReturn UIMCreateControlTransfer(short functionNumber, short endpointNumber, IOUSBCompletion completion,
+                                    IOMemoryDescriptor *CBP, bool bufferRounding, UInt32 bufferSize, short direction);
+  IOReturn UIMCreateControlTransfer(short functionNumber, short endpointNumber, IOUSBCommand* command,
+                                    void *CBP, bool bufferRounding, UInt32 bufferSize, short direction);
+  IOReturn UIMCreateControlTransfer(short functionNumber, short endpointNumber, IOUSBCommand* command,
+                                    IOMemoryDescriptor *CBP, bool bufferRounding, UInt32 bufferSize, short direction);
+  IOReturn UIMCreateBulkEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt8 direction, UInt8 speed, UInt8 maxPacketSize);
+  IOReturn UIMCreateBulkEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt8 direction, UInt8 speed,
+                                 UInt16 maxPacketSize, USBDeviceAddress highSpeedHub, int highSpeedPort);
+  IOReturn UIMCreateBulkTransfer(short functionNumber, short endpointNumber, IOUSBCompletion completion,
+                                 IOMemoryDescriptor *CBP, bool bufferRounding, UInt32 bufferSize, short direction);
+  IOReturn UIMCreateInterruptEndpoint(short functionAddress, short endpointNumber, UInt8 direction,
+                                      short speed, UInt16 maxPacketSize, short pollingRate);
+  IOReturn UIMCreateInterruptEndpoint(short functionAddress, short endpointNumber, UInt8 direction, short speed,
+                                      UInt16 maxPacketSize, short pollingRate, USBDeviceAddress highSpeedHub, int highSpeedPort);
+  IOReturn UIMCreateInterruptTransfer(short functionNumber, short endpointNumber, IOUSBCompletion completion,
+                                      IOMemoryDescriptor *CBP, bool bufferRounding, UInt32 bufferSize, short direction);
+  IOReturn UIMCreateIsochEndpoint(short functionAddress, short endpointNumber, UInt32 maxPacketSize, UInt8 direction);
+  IOReturn UIMCreateIsochEndpoint(short functionAddress, short endpointNumber, UInt32 maxPacketSize, UInt8 direction,
+                                  USBDeviceAddress highSpeedHub, int highSpeedPort);
+  IOReturn UIMCreateIsochTransfer(short functionAddress, short endpointNumber, IOUSBIsocCompletion completion, UInt8 direction,
+                                  UInt64 frameStart, IOMemoryDescriptor *pBuffer, UInt32 frameCount, IOUSBIsocFrame *pFrames);
+  IOReturn UIMAbortEndpoint(short functionNumber, short endpointNumber, short direction);
+  IOReturn UIMDeleteEndpoint(short functionNumber, short endpointNumber, short direction);
+  IOReturn UIMClearEndpointStall(short functionNumber, short endpointNumber, short direction);
+  IOReturn UIMHubMaintenance(USBDeviceAddress highSpeedHub, UInt32 highSpeedPort, UInt32 command, UInt32 flags);
+  void UIMRootHubStatusChange(void);
+  void UIMRootHubStatusChange(bool abort);
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_3
+  IOReturn UIMCreateIsochTransfer(short functionAddress, short endpointNumber, IOUSBIsocCompletion completion,
+                                  UInt8 direction, UInt64 frameStart, IOMemoryDescriptor *pBuffer, UInt32 frameCount,
+                                  IOUSBLowLatencyIsocFrame *pFrames, UInt32 updateFrequency);
+#endif
+
+public:
+  //
+  // Overrides.
+  //
+  bool init(OSDictionary *dictionary = 0);
+
+  IOReturn GetRootHubDeviceDescriptor(IOUSBDeviceDescriptor *desc);
+  IOReturn GetRootHubDescriptor(IOUSBHubDescriptor *desc);
+  IOReturn SetRootHubDescriptor(OSData *buffer);
+  IOReturn GetRootHubConfDescriptor(OSData *desc);
+  IOReturn GetRootHubStatus(IOUSBHubStatus *status);
+  IOReturn SetRootHubFeature(UInt16 wValue);
+  IOReturn ClearRootHubFeature(UInt16 wValue);
+  IOReturn GetRootHubPortStatus(IOUSBHubPortStatus *status, UInt16 port);
+  IOReturn SetRootHubPortFeature(UInt16 wValue, UInt16 port);
+  IOReturn ClearRootHubPortFeature(UInt16 wValue, UInt16 port);
+  IOReturn GetRootHubPortState(UInt8 *state, UInt16 port);
+  IOReturn SetHubAddress(UInt16 wValue);
+  UInt32 GetBandwidthAvailable(void);
+  UInt64 GetFrameNumber(void);
+  UInt32 GetFrameNumber32(void);
+  void PollInterrupts(IOUSBCompletionAction safeAction = 0);
+
+  IOReturn GetRootHubStringDescriptor(UInt8 index, OSData *desc);
+};
+
+#endif
+
+#endif
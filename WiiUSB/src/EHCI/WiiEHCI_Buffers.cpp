@@ -0,0 +1,184 @@
+//
+//  WiiEHCI_Buffers.cpp
+//  Wii EHCI USB controller interface
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "WiiEHCI.hpp"
+
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+
+OSDefineMetaClassAndStructors(WiiEHCIDescriptorBuffer, super);
+
+//
+// Overrides OSObject::free().
+//
+void WiiEHCIDescriptorBuffer::free(void) {
+  if (_buffer != NULL) {
+    _buffer->complete();
+    OSSafeReleaseNULL(_buffer);
+  }
+  if (_data != NULL) {
+    IOFree(_data, _dataLength);
+    _data = NULL;
+  }
+  super::free();
+}
+
+//
+// Allocates a new descriptor buffer, along with the specified length of driver data for the descriptors.
+//
+WiiEHCIDescriptorBuffer *WiiEHCIDescriptorBuffer::descriptorBuffer(IOByteCount dataLength) {
+  WiiEHCIDescriptorBuffer *descBuffer;
+  IOByteCount             length;
+
+  descBuffer = new WiiEHCIDescriptorBuffer;
+  if (descBuffer == NULL) {
+    return NULL;
+  }
+
+  descBuffer->_dataLength = dataLength;
+  descBuffer->_data       = IOMalloc(dataLength);
+  if (descBuffer->_data == NULL) {
+    descBuffer->release();
+    return NULL;
+  }
+  bzero(descBuffer->_data, dataLength);
+
+  //
+  // Allocate host controller descriptors out of a page.
+  // Wii platforms are not cache coherent, host controller structures must be non-cacheable.
+  //
+  descBuffer->_buffer = IOBufferMemoryDescriptor::withOptions(kIOMemoryPhysicallyContiguous, PAGE_SIZE, PAGE_SIZE);
+  if (descBuffer->_buffer == NULL) {
+    descBuffer->release();
+    return NULL;
+  }
+
+  descBuffer->_buffer->prepare();
+  descBuffer->_descriptors  = descBuffer->_buffer->getBytesNoCopy();
+  descBuffer->_physicalAddr = descBuffer->_buffer->getPhysicalSegment(0, &length);
+  IOSetProcessorCacheMode(kernel_task, (IOVirtualAddress) descBuffer->_descriptors, PAGE_SIZE, kIOInhibitCache);
+  bzero(descBuffer->_descriptors, PAGE_SIZE);
+
+  return descBuffer;
+}
+
+//
+// Sets the next buffer in the linked list.
+//
+void WiiEHCIDescriptorBuffer::setNextBuffer(WiiEHCIDescriptorBuffer *buffer) {
+  _nextBuffer = buffer;
+}
+
+//
+// Gets the next buffer in the linked list.
+//
+WiiEHCIDescriptorBuffer *WiiEHCIDescriptorBuffer::getNextBuffer(void) {
+  return _nextBuffer;
+}
+
+//
+// Gets the starting physical address of the buffer.
+//
+IOPhysicalAddress WiiEHCIDescriptorBuffer::getPhysAddr(void) {
+  return _physicalAddr;
+}
+
+//
+// Gets the host controller descriptors.
+//
+void *WiiEHCIDescriptorBuffer::getDescriptors(void) {
+  return _descriptors;
+}
+
+//
+// Gets the driver data for the descriptors.
+//
+void *WiiEHCIDescriptorBuffer::getData(void) {
+  return _data;
+}
+
+//
+// Allocates a new bounce buffer.
+//
+EHCIBounceBuffer *WiiEHCI::allocateBounceBuffer(bool jumbo) {
+  EHCIBounceBuffer  *bounceBuffer;
+  IOByteCount       length;
+  IOByteCount       bufferLength;
+
+  bounceBuffer = (EHCIBounceBuffer*) IOMalloc(sizeof (EHCIBounceBuffer));
+  if (bounceBuffer == NULL) {
+    return NULL;
+  }
+
+  bounceBuffer->jumbo = jumbo;
+  bounceBuffer->next  = NULL;
+  bufferLength = jumbo ? kWiiEHCIBounceBufferJumboSize : kWiiEHCIBounceBufferSize;
+
+  //
+  // If a MEM2 client was created, use that. Otherwise just allocate from regular kernel memory.
+  // Buffers are aligned to their length so they never cross a page boundary.
+  //
+  if (_mem2Client != NULL) {
+    if (_mem2Service->allocate(_mem2Client, bufferLength, kWiiMem2CacheModeCopyback,
+                               &bounceBuffer->physAddr, &bounceBuffer->buf) != kIOReturnSuccess) {
+      IOFree(bounceBuffer, sizeof (EHCIBounceBuffer));
+      return NULL;
+    }
+    bounceBuffer->desc = NULL;
+  } else {
+    bounceBuffer->desc = IOBufferMemoryDescriptor::withOptions(kIOMemoryPhysicallyContiguous, bufferLength, bufferLength);
+    if (bounceBuffer->desc == NULL) {
+      return NULL;
+    }
+
+    bounceBuffer->physAddr = bounceBuffer->desc->getPhysicalSegment(0, &length);
+    bounceBuffer->buf      = ((IOBufferMemoryDescriptor*) bounceBuffer->desc)->getBytesNoCopy();
+  }
+
+  return bounceBuffer;
+}
+
+//
+// Gets a free bounce buffer, or allocates ones if needed.
+//
+EHCIBounceBuffer *WiiEHCI::getFreeBounceBuffer(bool jumbo) {
+  EHCIBounceBuffer  *bounceBuffer;
+
+  if (jumbo) {
+    bounceBuffer = _freeBounceBufferJumboHeadPtr;
+    if (bounceBuffer != NULL) {
+      _freeBounceBufferJumboHeadPtr = bounceBuffer->next;
+      bounceBuffer->next            = NULL;
+    }
+  } else {
+    bounceBuffer = _freeBounceBufferHeadPtr;
+    if (bounceBuffer != NULL) {
+      _freeBounceBufferHeadPtr = bounceBuffer->next;
+      bounceBuffer->next       = NULL;
+    }
+  }
+
+  if (bounceBuffer == NULL) {
+    bounceBuffer = allocateBounceBuffer(jumbo);
+  }
+
+  return bounceBuffer;
+}
+
+//
+// Returns a bounce buffer to the free list.
+//
+void WiiEHCI::returnBounceBuffer(EHCIBounceBuffer *bounceBuffer) {
+  if (bounceBuffer->jumbo) {
+    bounceBuffer->next = _freeBounceBufferJumboHeadPtr;
+    _freeBounceBufferJumboHeadPtr = bounceBuffer;
+  } else {
+    bounceBuffer->next = _freeBounceBufferHeadPtr;
+    _freeBounceBufferHeadPtr = bounceBuffer;
+  }
+}
+
+#endif
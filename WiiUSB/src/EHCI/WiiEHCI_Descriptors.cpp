@@ -0,0 +1,785 @@
+//
+//  WiiEHCI_Descriptors.cpp
+//  Wii EHCI USB controller interface
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "WiiEHCI.hpp"
+
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+
+//
+// Converts the status of a queue element transfer descriptor to I/O Kit status.
+//
+IOReturn WiiEHCI::convertTDStatus(UInt32 token) {
+  if ((token & kEHCIQueueTDTokenStatusHalted) == 0) {
+    return kIOReturnSuccess;
+  }
+
+  //
+  // Halted with no other error bits is a stall from the device.
+  //
+  if (token & kEHCIQueueTDTokenStatusBabble) {
+    return kIOReturnOverrun;
+  } else if (token & kEHCIQueueTDTokenStatusBufferError) {
+    return ((token & kEHCIQueueTDTokenPIDMask) == kEHCIQueueTDTokenPIDIn) ? kIOUSBBufferOverrunErr : kIOUSBBufferUnderrunErr;
+  } else if (token & (kEHCIQueueTDTokenStatusXactError | kEHCIQueueTDTokenStatusMissedFrame)) {
+    return kIOReturnNotResponding;
+  }
+  return kIOUSBPipeStalled;
+}
+
+//
+// Allocates and adds a page of new endpoints to the free list.
+//
+IOReturn WiiEHCI::allocateFreeEndpoints(void) {
+  WiiEHCIDescriptorBuffer *descBuffer;
+  EHCIEndpointData        *endpoints;
+  EHCIEndpointData        *endpoint;
+
+  descBuffer = WiiEHCIDescriptorBuffer::descriptorBuffer(kWiiEHCIEndpointsPerBuffer * sizeof (EHCIEndpointData));
+  if (descBuffer == NULL) {
+    return kIOReturnNoMemory;
+  }
+  descBuffer->setNextBuffer(_descriptorBufferHeadPtr);
+  _descriptorBufferHeadPtr = descBuffer;
+
+  //
+  // Add the endpoints to the free list.
+  //
+  endpoints = (EHCIEndpointData*) descBuffer->getData();
+  for (UInt32 i = 0; i < kWiiEHCIEndpointsPerBuffer; i++) {
+    endpoint           = &endpoints[i];
+    endpoint->qh       = &((EHCIQueueHead*) descBuffer->getDescriptors())[i];
+    endpoint->physAddr = descBuffer->getPhysAddr() + (i * sizeof (EHCIQueueHead));
+
+    endpoint->nextEndpoint = _freeEndpointHeadPtr;
+    _freeEndpointHeadPtr   = endpoint;
+  }
+
+  return kIOReturnSuccess;
+}
+
+//
+// Allocates and adds a page of new transfers to the free list.
+//
+IOReturn WiiEHCI::allocateFreeTransfers(void) {
+  WiiEHCIDescriptorBuffer *descBuffer;
+  EHCITransferData        *transfers;
+  EHCITransferData        *transfer;
+
+  descBuffer = WiiEHCIDescriptorBuffer::descriptorBuffer(kWiiEHCITransfersPerBuffer * sizeof (EHCITransferData));
+  if (descBuffer == NULL) {
+    return kIOReturnNoMemory;
+  }
+  descBuffer->setNextBuffer(_descriptorBufferHeadPtr);
+  _descriptorBufferHeadPtr = descBuffer;
+
+  //
+  // Add the transfers to the free list.
+  //
+  transfers = (EHCITransferData*) descBuffer->getData();
+  for (UInt32 i = 0; i < kWiiEHCITransfersPerBuffer; i++) {
+    transfer           = &transfers[i];
+    transfer->td       = &((EHCIQueueTransferDescriptor*) descBuffer->getDescriptors())[i];
+    transfer->physAddr = descBuffer->getPhysAddr() + (i * sizeof (EHCIQueueTransferDescriptor));
+
+    transfer->nextTransfer = _freeTransferHeadPtr;
+    _freeTransferHeadPtr   = transfer;
+  }
+
+  return kIOReturnSuccess;
+}
+
+//
+// Gets a free endpoint from the free linked list.
+//
+EHCIEndpointData *WiiEHCI::getFreeEndpoint(void) {
+  EHCIEndpointData *endpoint;
+
+  if (_freeEndpointHeadPtr == NULL) {
+    if (allocateFreeEndpoints() != kIOReturnSuccess) {
+      return NULL;
+    }
+  }
+  endpoint = _freeEndpointHeadPtr;
+
+  //
+  // Adjust linkage for remaining free endpoints.
+  //
+  _freeEndpointHeadPtr         = endpoint->nextEndpoint;
+  endpoint->nextEndpoint       = NULL;
+  endpoint->nextActiveEndpoint = NULL;
+  endpoint->interruptNode      = kWiiEHCIInterruptNodeNone;
+  endpoint->bandwidth          = 0;
+  endpoint->transferHead       = NULL;
+  endpoint->transferTail       = NULL;
+  endpoint->nextUnlinkEndpoint = NULL;
+  endpoint->unlinkOperation    = kWiiEHCIUnlinkOpNone;
+
+  return endpoint;
+}
+
+//
+// Gets a free transfer from the free linked list.
+// The transfer is left inactive and halted, so the controller will not advance past it.
+//
+EHCITransferData *WiiEHCI::getFreeTransfer(EHCIEndpointData *endpoint) {
+  EHCITransferData *transfer;
+
+  if (_freeTransferHeadPtr == NULL) {
+    if (allocateFreeTransfers() != kIOReturnSuccess) {
+      return NULL;
+    }
+  }
+
+  transfer             = _freeTransferHeadPtr;
+  _freeTransferHeadPtr = transfer->nextTransfer;
+
+  transfer->td->nextTDPhysAddr    = HostToUSBLong(kEHCILinkTerminate);
+  transfer->td->altNextTDPhysAddr = HostToUSBLong(kEHCILinkTerminate);
+  transfer->td->token             = HostToUSBLong(kEHCIQueueTDTokenStatusHalted);
+  for (UInt32 i = 0; i < kEHCIQueueTDBufferCount; i++) {
+    transfer->td->bufferPhysAddr[i] = 0;
+  }
+
+  transfer->nextTransfer     = NULL;
+  transfer->endpoint         = endpoint;
+  transfer->last             = false;
+  transfer->bounceBuffer     = NULL;
+  transfer->actualBufferSize = 0;
+  transfer->srcBuffer        = NULL;
+
+  return transfer;
+}
+
+//
+// Returns an endpoint to the free linked list.
+//
+void WiiEHCI::returnEndpoint(EHCIEndpointData *endpoint) {
+  //
+  // Remove the tail transfer.
+  //
+  if (endpoint->transferTail != NULL) {
+    returnTransfer(endpoint->transferTail);
+    endpoint->transferTail = NULL;
+  }
+
+  endpoint->nextEndpoint = _freeEndpointHeadPtr;
+  _freeEndpointHeadPtr   = endpoint;
+}
+
+//
+// Returns a transfer to the free linked list.
+//
+void WiiEHCI::returnTransfer(EHCITransferData *transfer) {
+  if (transfer->bounceBuffer != NULL) {
+    returnBounceBuffer(transfer->bounceBuffer);
+    transfer->bounceBuffer = NULL;
+  }
+  OSSafeReleaseNULL(transfer->srcBuffer);
+
+  transfer->nextTransfer = _freeTransferHeadPtr;
+  _freeTransferHeadPtr   = transfer;
+}
+
+//
+// Initializes the asynchronous schedule.
+//
+IOReturn WiiEHCI::initAsyncSchedule(void) {
+  EHCIQueueHead *qh;
+
+  //
+  // Create the reclamation head queue head.
+  // The controller never executes it, and with no other queue heads it simply links back to itself.
+  //
+  _asyncHeadEndpoint = getFreeEndpoint();
+  if (_asyncHeadEndpoint == NULL) {
+    return kIOReturnNoMemory;
+  }
+
+  qh = _asyncHeadEndpoint->qh;
+  qh->horizLinkPhysAddr = HostToUSBLong(_asyncHeadEndpoint->physAddr | kEHCILinkTypeQueueHead);
+  qh->flags             = HostToUSBLong(kEHCIQHFlagsHead | kEHCIQHFlagsSpeedHigh);
+  qh->splitFlags        = HostToUSBLong(1 << kEHCIQHSplitFlagsMultShift);
+  qh->currentTDPhysAddr = 0;
+  qh->nextTDPhysAddr    = HostToUSBLong(kEHCILinkTerminate);
+  qh->altNextTDPhysAddr = HostToUSBLong(kEHCILinkTerminate);
+  qh->token             = HostToUSBLong(kEHCIQueueTDTokenStatusHalted);
+
+  _asyncHeadEndpoint->type         = kWiiEHCIEndpointTypeControl | kWiiEHCIEndpointTypeBulk;
+  _asyncHeadEndpoint->nextEndpoint = NULL;
+
+  writeOpReg32(kEHCIRegAsyncListAddr, _asyncHeadEndpoint->physAddr);
+  return kIOReturnSuccess;
+}
+
+//
+// Initializes the periodic schedule interrupt tree and frame list.
+//
+IOReturn WiiEHCI::initPeriodicSchedule(void) {
+  EHCIQueueHead *qh;
+  IOByteCount   length;
+
+  //
+  // Allocate the frame list. Must be page aligned.
+  //
+  _frameListDesc = IOBufferMemoryDescriptor::withOptions(kIOMemoryPhysicallyContiguous,
+                                                         kEHCIFrameListSize * sizeof (UInt32), PAGE_SIZE);
+  if (_frameListDesc == NULL) {
+    return kIOReturnNoMemory;
+  }
+  _frameListDesc->prepare();
+  _frameListPtr      = (volatile UInt32*) _frameListDesc->getBytesNoCopy();
+  _frameListPhysAddr = _frameListDesc->getPhysicalSegment(0, &length);
+  IOSetProcessorCacheMode(kernel_task, (IOVirtualAddress) _frameListPtr, kEHCIFrameListSize * sizeof (UInt32), kIOInhibitCache);
+
+  //
+  // Allocate all static interrupt queue heads.
+  // These are never executed as their overlay is halted, and are in place to support placing
+  // later allocated endpoints at various poll timings.
+  //
+  for (unsigned int i = 0; i < kWiiEHCIInterruptNodeCount; i++) {
+    _interruptEndpoints[i].headEndpoint = getFreeEndpoint();
+    if (_interruptEndpoints[i].headEndpoint == NULL) {
+      return kIOReturnNoMemory;
+    }
+
+    qh = _interruptEndpoints[i].headEndpoint->qh;
+    qh->horizLinkPhysAddr = HostToUSBLong(kEHCILinkTerminate);
+    qh->flags             = HostToUSBLong(kEHCIQHFlagsSpeedHigh);
+    qh->splitFlags        = HostToUSBLong((1 << kEHCIQHSplitFlagsMultShift) | kEHCIQHSplitStartMask);
+    qh->currentTDPhysAddr = 0;
+    qh->nextTDPhysAddr    = HostToUSBLong(kEHCILinkTerminate);
+    qh->altNextTDPhysAddr = HostToUSBLong(kEHCILinkTerminate);
+    qh->token             = HostToUSBLong(kEHCIQueueTDTokenStatusHalted);
+
+    _interruptEndpoints[i].headEndpoint->type         = kWiiEHCIEndpointTypeInterrupt;
+    _interruptEndpoints[i].headEndpoint->nextEndpoint = NULL;
+    _interruptEndpoints[i].parentNode                 = kWiiEHCIInterruptNodeNone;
+    _interruptEndpoints[i].bandwidth                  = 0;
+  }
+
+  //
+  // Build out the tree, same as OHCI.
+  // 32ms - 16ms - 8ms - 4ms - 2ms - 1ms
+  //
+  for (unsigned int i = 0, p = 0, q = 32, z = 0; i < (kWiiEHCIInterruptNodeCount - 1); i++) {
+    if (i < ((q / 2) + p)) {
+      z = i + q;
+    } else {
+      z = i + (q / 2);
+    }
+
+    //
+    // Move up the tree to next lowest polling rate.
+    //
+    if (i == (p + q - 1)) {
+      p = p + q;
+      q = q / 2;
+    }
+
+    //
+    // Link queue heads together.
+    //
+    _interruptEndpoints[i].headEndpoint->qh->horizLinkPhysAddr =
+      HostToUSBLong(_interruptEndpoints[z].headEndpoint->physAddr | kEHCILinkTypeQueueHead);
+    _interruptEndpoints[i].headEndpoint->nextEndpoint = _interruptEndpoints[z].headEndpoint;
+    _interruptEndpoints[i].parentNode                 = z;
+  }
+
+  //
+  // Each frame list entry points to the 32ms leaf for that frame.
+  //
+  for (unsigned int i = 0; i < kEHCIFrameListSize; i++) {
+    _frameListPtr[i] = HostToUSBLong(_interruptEndpoints[i % kWiiEHCIInterruptLeafCount].headEndpoint->physAddr | kEHCILinkTypeQueueHead);
+  }
+
+  writeOpReg32(kEHCIRegPeriodicListBase, _frameListPhysAddr);
+  return kIOReturnSuccess;
+}
+
+//
+// Gets the endpoint data for the specified function/endpoint.
+//
+EHCIEndpointData *WiiEHCI::getEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt8 direction, UInt8 *type) {
+  EHCIEndpointData *endpoint;
+
+  endpoint = _activeEndpointHeadPtr;
+  while (endpoint != NULL) {
+    //
+    // Control endpoints are bidirectional and do not use the direction.
+    //
+    if ((endpoint->functionNumber == functionNumber) && (endpoint->endpointNumber == endpointNumber)
+        && (endpoint->type & *type)
+        && ((endpoint->type == kWiiEHCIEndpointTypeControl) || (endpoint->direction == direction))) {
+      *type = endpoint->type;
+      return endpoint;
+    }
+
+    endpoint = endpoint->nextActiveEndpoint;
+  }
+
+  return NULL;
+}
+
+//
+// Gets the least used interrupt node for the specified polling rate in frames.
+//
+UInt8 WiiEHCI::getInterruptNode(UInt8 pollingFrames) {
+  UInt8   node;
+  UInt32  start;
+  UInt32  count;
+
+  //
+  // Move down the tree until the level polls at least as often as requested.
+  //
+  start = 0;
+  count = kWiiEHCIInterruptLeafCount;
+  while ((count > 1) && (count > pollingFrames)) {
+    start += count;
+    count /= 2;
+  }
+
+  node = start;
+  for (UInt32 i = start; i < start + count; i++) {
+    if (_interruptEndpoints[i].bandwidth < _interruptEndpoints[node].bandwidth) {
+      node = i;
+    }
+  }
+
+  return node;
+}
+
+//
+// Gets the least used microframe for a high speed interrupt endpoint.
+//
+UInt8 WiiEHCI::getInterruptMicroframe(UInt32 bandwidth) {
+  UInt8 microframe;
+
+  microframe = 0;
+  for (UInt32 i = 1; i < kEHCIMicroframesPerFrame; i++) {
+    if (_microframeLoad[i] < _microframeLoad[microframe]) {
+      microframe = i;
+    }
+  }
+
+  WIIDBGLOG("Using microframe %u with load %u for %u bytes", microframe, _microframeLoad[microframe], bandwidth);
+  return microframe;
+}
+
+//
+// Creates a new endpoint and its queue head. The endpoint is not yet linked into a schedule.
+//
+IOReturn WiiEHCI::addNewEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt16 maxPacketSize, UInt8 speed,
+                                 UInt8 direction, UInt8 type, USBDeviceAddress highSpeedHub, int highSpeedPort,
+                                 EHCIEndpointData **outEndpoint) {
+  EHCIEndpointData  *endpoint;
+  EHCITransferData  *transfer;
+  EHCIQueueHead     *qh;
+  UInt32            flags;
+  UInt32            splitFlags;
+
+  endpoint = getFreeEndpoint();
+  if (endpoint == NULL) {
+    return kIOReturnNoMemory;
+  }
+
+  //
+  // Create the dummy tail transfer. It stays halted until a transfer is built into it.
+  //
+  transfer = getFreeTransfer(endpoint);
+  if (transfer == NULL) {
+    returnEndpoint(endpoint);
+    return kIOReturnNoMemory;
+  }
+
+  //
+  // Build queue head characteristics.
+  //
+  flags = (functionNumber & kEHCIQHFlagsFuncMask)
+    | ((endpointNumber << kEHCIQHFlagsEndpointShift) & kEHCIQHFlagsEndpointMask)
+    | ((maxPacketSize << kEHCIQHFlagsMaxPktSizeShift) & kEHCIQHFlagsMaxPktSizeMask);
+  if (speed == kUSBDeviceSpeedHigh) {
+    flags |= kEHCIQHFlagsSpeedHigh;
+  } else if (speed == kUSBDeviceSpeedLow) {
+    flags |= kEHCIQHFlagsSpeedLow;
+  } else {
+    flags |= kEHCIQHFlagsSpeedFull;
+  }
+
+  //
+  // Control endpoints take the data toggle from each transfer descriptor,
+  // and need the control endpoint flag when behind a transaction translator.
+  //
+  if (type == kWiiEHCIEndpointTypeControl) {
+    flags |= kEHCIQHFlagsDataToggleControl;
+    if (speed != kUSBDeviceSpeedHigh) {
+      flags |= kEHCIQHFlagsControlEndpoint;
+    }
+  }
+  if ((speed == kUSBDeviceSpeedHigh) && (type != kWiiEHCIEndpointTypeInterrupt)) {
+    flags |= kEHCIQHNakReloadHighSpeed << kEHCIQHFlagsNakReloadShift;
+  }
+
+  //
+  // High bandwidth high speed endpoints carry extra transactions per microframe in bits 11-12 of the packet size.
+  // Full and low speed endpoints are accessed through split transactions to the parent high speed hub.
+  //
+  if (speed == kUSBDeviceSpeedHigh) {
+    splitFlags = (1 + ((maxPacketSize >> 11) & 0x3)) << kEHCIQHSplitFlagsMultShift;
+  } else {
+    splitFlags = (1 << kEHCIQHSplitFlagsMultShift)
+      | ((highSpeedHub << kEHCIQHSplitFlagsHubAddrShift) & kEHCIQHSplitFlagsHubAddrMask)
+      | ((highSpeedPort << kEHCIQHSplitFlagsPortShift) & kEHCIQHSplitFlagsPortMask);
+  }
+
+  qh = endpoint->qh;
+  qh->horizLinkPhysAddr = HostToUSBLong(kEHCILinkTerminate);
+  qh->flags             = HostToUSBLong(flags);
+  qh->splitFlags        = HostToUSBLong(splitFlags);
+  qh->currentTDPhysAddr = 0;
+  qh->nextTDPhysAddr    = HostToUSBLong(transfer->physAddr);
+  qh->altNextTDPhysAddr = HostToUSBLong(kEHCILinkTerminate);
+  qh->token             = 0;
+  for (UInt32 i = 0; i < kEHCIQueueTDBufferCount; i++) {
+    qh->bufferPhysAddr[i] = 0;
+  }
+
+  endpoint->type           = type;
+  endpoint->functionNumber = functionNumber;
+  endpoint->endpointNumber = endpointNumber;
+  endpoint->direction      = direction;
+  endpoint->speed          = speed;
+  endpoint->maxPacketSize  = maxPacketSize & BITRange(0, 10);
+  endpoint->transferHead   = transfer;
+  endpoint->transferTail   = transfer;
+
+  //
+  // Add to active endpoints.
+  //
+  endpoint->nextActiveEndpoint = _activeEndpointHeadPtr;
+  _activeEndpointHeadPtr       = endpoint;
+
+  *outEndpoint = endpoint;
+  return kIOReturnSuccess;
+}
+
+//
+// Links an endpoint into a schedule, directly after the specified head.
+//
+void WiiEHCI::linkEndpoint(EHCIEndpointData *endpoint, EHCIEndpointData *headEndpoint) {
+  endpoint->qh->horizLinkPhysAddr = headEndpoint->qh->horizLinkPhysAddr;
+  endpoint->nextEndpoint          = headEndpoint->nextEndpoint;
+
+  //
+  // Queue head must be fully visible before the controller can reach it.
+  //
+  syncMemory();
+  headEndpoint->qh->horizLinkPhysAddr = HostToUSBLong(endpoint->physAddr | kEHCILinkTypeQueueHead);
+  headEndpoint->nextEndpoint          = endpoint;
+}
+
+//
+// Takes ownership of queue head unlinking, waiting for any other unlink in progress.
+// Callers hold this across the whole operation, as the command gate is released while unlinking.
+//
+// The owner only releases the gate while sleeping on the controller. Finding unlinking owned but the owner
+// not sleeping means this is a nested call from a completion on the owner's own thread.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiEHCI::acquireUnlink(void) {
+  if (_unlinkBusy && !_unlinkSleeping) {
+    _unlinkDepth++;
+    return;
+  }
+
+  while (_unlinkBusy) {
+    _commandGate->commandSleep(&_unlinkBusy);
+  }
+  _unlinkBusy  = true;
+  _unlinkDepth = 1;
+}
+
+//
+// Releases queue head unlinking.
+// The outermost owner first finishes any operations nested unlinks left waiting on the controller.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiEHCI::releaseUnlink(void) {
+  if (_unlinkDepth > 1) {
+    _unlinkDepth--;
+    return;
+  }
+
+  while (_unlinkEndpointHeadPtr != NULL) {
+    finishDeferredUnlinks();
+  }
+  _unlinkDepth = 0;
+  _unlinkBusy  = false;
+  _commandGate->commandWakeup(&_unlinkBusy);
+}
+
+//
+// Unlinks an endpoint from its schedule. Unlinking must be owned by the caller.
+//
+// Returns true once the controller no longer references the queue head. Nested unlinks run from completions while
+// the owner is partway through its own operation, releasing the gate there would let the interrupt handler see that
+// operation half done. They return false without waiting, and the caller passes the endpoint to deferUnlinkedEndpoint().
+//
+// This function is gated and called within the workloop context.
+//
+bool WiiEHCI::unlinkEndpoint(EHCIEndpointData *endpoint) {
+  EHCIEndpointData *prevEndpoint;
+
+  //
+  // An endpoint already left by a nested unlink is off its schedule until the owner finishes it.
+  //
+  if (endpoint->unlinkOperation != kWiiEHCIUnlinkOpNone) {
+    return false;
+  }
+
+  prevEndpoint = getEndpointHead(endpoint);
+  while (prevEndpoint->nextEndpoint != endpoint) {
+    if (prevEndpoint->nextEndpoint == NULL) {
+      return true;
+    }
+    prevEndpoint = prevEndpoint->nextEndpoint;
+  }
+
+  prevEndpoint->qh->horizLinkPhysAddr = endpoint->qh->horizLinkPhysAddr;
+  prevEndpoint->nextEndpoint          = endpoint->nextEndpoint;
+  endpoint->nextEndpoint              = NULL;
+  syncMemory();
+
+  if (_unlinkDepth > 1) {
+    return false;
+  }
+
+  if (endpoint->type == kWiiEHCIEndpointTypeInterrupt) {
+    waitFrameAdvance();
+  } else {
+    waitAsyncAdvance();
+  }
+  return true;
+}
+
+//
+// Queues an endpoint left by a nested unlink, for the owner to finish once the controller has released it.
+// An endpoint queued more than once keeps the operation with the most effect.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiEHCI::deferUnlinkedEndpoint(EHCIEndpointData *endpoint, UInt8 operation) {
+  if (endpoint->unlinkOperation == kWiiEHCIUnlinkOpNone) {
+    endpoint->nextUnlinkEndpoint = _unlinkEndpointHeadPtr;
+    _unlinkEndpointHeadPtr       = endpoint;
+  }
+  if (operation > endpoint->unlinkOperation) {
+    endpoint->unlinkOperation = operation;
+  }
+}
+
+//
+// Waits for the controller to release the queue heads left by nested unlinks, then frees their removed transfers
+// and finishes each operation. A single doorbell covers all of the asynchronous queue heads.
+// Unlinking must be owned by the caller at the outermost level.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiEHCI::finishDeferredUnlinks(void) {
+  EHCIEndpointData  *endpoint;
+  EHCIEndpointData  *nextEndpoint;
+  EHCITransferData  *transfer;
+  EHCITransferData  *nextTransfer;
+  UInt8             operation;
+  bool              asyncUnlinked;
+  bool              periodicUnlinked;
+
+  asyncUnlinked    = false;
+  periodicUnlinked = false;
+  for (endpoint = _unlinkEndpointHeadPtr; endpoint != NULL; endpoint = endpoint->nextUnlinkEndpoint) {
+    if (endpoint->type == kWiiEHCIEndpointTypeInterrupt) {
+      periodicUnlinked = true;
+    } else {
+      asyncUnlinked = true;
+    }
+  }
+
+  if (asyncUnlinked) {
+    waitAsyncAdvance();
+  }
+  if (periodicUnlinked) {
+    waitFrameAdvance();
+  }
+
+  transfer               = _unlinkTransferHeadPtr;
+  _unlinkTransferHeadPtr = NULL;
+  while (transfer != NULL) {
+    nextTransfer = transfer->nextTransfer;
+    returnTransfer(transfer);
+    transfer = nextTransfer;
+  }
+
+  endpoint               = _unlinkEndpointHeadPtr;
+  _unlinkEndpointHeadPtr = NULL;
+  while (endpoint != NULL) {
+    nextEndpoint                 = endpoint->nextUnlinkEndpoint;
+    operation                    = endpoint->unlinkOperation;
+    endpoint->nextUnlinkEndpoint = NULL;
+    endpoint->unlinkOperation    = kWiiEHCIUnlinkOpNone;
+
+    if (operation == kWiiEHCIUnlinkOpRelease) {
+      returnEndpoint(endpoint);
+    } else {
+      resetEndpointQueue(endpoint, operation == kWiiEHCIUnlinkOpClearStall);
+      linkEndpoint(endpoint, getEndpointHead(endpoint));
+    }
+    endpoint = nextEndpoint;
+  }
+}
+
+//
+// Waits up to one microframe for the controller while unlinking.
+// The command gate is released, the async advance interrupt or the unlink thread call wakes the caller.
+// Only the outermost owner of unlinking waits, nested unlinks are finished by it.
+//
+void WiiEHCI::waitUnlinkTick(void) {
+  AbsoluteTime deadline;
+
+  clock_interval_to_deadline(kWiiEHCIUnlinkTickUS, kMicrosecondScale, &deadline);
+  thread_call_enter_delayed(_unlinkThreadCall, deadline);
+
+  _unlinkSleeping = true;
+  _commandGate->commandSleep((void *) &_asyncAdvanceDone);
+  _unlinkSleeping = false;
+
+  thread_call_cancel(_unlinkThreadCall);
+}
+
+//
+// Waits for the controller to release any cached asynchronous queue heads.
+//
+void WiiEHCI::waitAsyncAdvance(void) {
+  if ((readOpReg32(kEHCIRegStatus) & kEHCIRegStatusAsyncStatus) == 0) {
+    return;
+  }
+
+  //
+  // Ring the doorbell, the controller interrupts once it no longer holds any unlinked queue heads.
+  //
+  _asyncAdvanceDone = false;
+  writeOpReg32(kEHCIRegCommand, readOpReg32(kEHCIRegCommand) | kEHCIRegCommandAsyncAdvanceDoorbell);
+  for (UInt32 i = 0; !_asyncAdvanceDone; i += kWiiEHCIUnlinkTickUS) {
+    if (i >= kWiiEHCIUnlinkTimeoutUS) {
+      WIISYSLOG("Timed out waiting for async advance");
+      break;
+    }
+    waitUnlinkTick();
+  }
+}
+
+//
+// Waits for the controller to move past the current frame, releasing any unlinked periodic queue heads.
+//
+void WiiEHCI::waitFrameAdvance(void) {
+  UInt32 frameIndex;
+
+  if ((readOpReg32(kEHCIRegStatus) & kEHCIRegStatusPeriodicStatus) == 0) {
+    return;
+  }
+
+  //
+  // The current frame may still be processing the queue head, wait for two frame boundaries.
+  //
+  frameIndex = (readOpReg32(kEHCIRegFrameIndex) >> kEHCIRegFrameIndexFrameShift) & kEHCIRegFrameIndexFrameMask;
+  for (UInt32 i = 0; (((readOpReg32(kEHCIRegFrameIndex) >> kEHCIRegFrameIndexFrameShift) - frameIndex)
+                       & kEHCIRegFrameIndexFrameMask) < 2; i += kWiiEHCIUnlinkTickUS) {
+    if (i >= kWiiEHCIUnlinkTimeoutUS) {
+      WIISYSLOG("Timed out waiting for frame advance");
+      break;
+    }
+    waitUnlinkTick();
+  }
+}
+
+//
+// Gets the static head of the schedule an endpoint is linked into.
+//
+EHCIEndpointData *WiiEHCI::getEndpointHead(EHCIEndpointData *endpoint) {
+  if (endpoint->type == kWiiEHCIEndpointTypeInterrupt) {
+    return _interruptEndpoints[endpoint->interruptNode].headEndpoint;
+  }
+  return _asyncHeadEndpoint;
+}
+
+//
+// Resets the queue head overlay to resume at the oldest remaining transfer, the dummy tail if there are none.
+// The queue head must not be in use by the controller, either unlinked or halted.
+//
+void WiiEHCI::resetEndpointQueue(EHCIEndpointData *endpoint, bool resetDataToggle) {
+  EHCIQueueHead *qh;
+  UInt32        token;
+
+  qh    = endpoint->qh;
+  token = resetDataToggle ? 0 : (USBToHostLong(qh->token) & kEHCIQueueTDTokenDataToggle);
+
+  qh->currentTDPhysAddr = 0;
+  qh->nextTDPhysAddr    = HostToUSBLong(endpoint->transferHead->physAddr);
+  qh->altNextTDPhysAddr = HostToUSBLong(kEHCILinkTerminate);
+  for (UInt32 i = 0; i < kEHCIQueueTDBufferCount; i++) {
+    qh->bufferPhysAddr[i] = 0;
+  }
+  syncMemory();
+  qh->token = HostToUSBLong(token);
+}
+
+//
+// Completes any finished transfers, then removes all remaining transfers from an endpoint.
+// The queue head must be unlinked. If the controller has released it, the transfers are freed and the queue is reset.
+// Otherwise the transfers are kept until finishDeferredUnlinks(), which resets the queue once the controller has.
+//
+void WiiEHCI::removeEndpointTransfers(EHCIEndpointData *endpoint, IOReturn status, bool released) {
+  EHCITransferData  *transfer;
+  EHCITransferData  *nextTransfer;
+  UInt32            token;
+  UInt32            bufferSizeRemaining;
+
+  scanEndpointTransfers(endpoint);
+
+  bufferSizeRemaining = 0;
+  transfer = endpoint->transferHead;
+  while (transfer != endpoint->transferTail) {
+    nextTransfer = transfer->nextTransfer;
+
+    token = USBToHostLong(transfer->td->token);
+    if (token & kEHCIQueueTDTokenStatusActive) {
+      bufferSizeRemaining += transfer->actualBufferSize;
+    } else {
+      bufferSizeRemaining += (token & kEHCIQueueTDTokenBytesMask) >> kEHCIQueueTDTokenBytesShift;
+    }
+
+    if (transfer->last) {
+      completeTransaction(transfer, status, bufferSizeRemaining);
+      bufferSizeRemaining = 0;
+    }
+
+    if (released) {
+      returnTransfer(transfer);
+    } else {
+      transfer->nextTransfer = _unlinkTransferHeadPtr;
+      _unlinkTransferHeadPtr = transfer;
+    }
+    transfer = nextTransfer;
+  }
+  endpoint->transferHead = endpoint->transferTail;
+
+  if (released) {
+    resetEndpointQueue(endpoint, false);
+  }
+}
+
+#endif
@@ -0,0 +1,159 @@
+//
+//  WiiEHCI_Interrupts.cpp
+//  Wii EHCI USB controller interface
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "WiiEHCI.hpp"
+
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+
+//
+// Interrupt handler filter function.
+//
+// This function runs in the primary interrupt handler context and should be as simple as possible.
+// This may run concurrently with the secondary handler and any workloop functions.
+//
+bool WiiEHCI::filterInterrupt(IOFilterInterruptEventSource *filterIntEventSource) {
+  UInt32  intEnable;
+  UInt32  intStatus;
+  bool    signalSecondaryInt;
+
+  intEnable = readOpReg32(kEHCIRegIntEnable);
+  intStatus = intEnable & readOpReg32(kEHCIRegStatus) & kEHCIRegStatusIntMask;
+  if (intStatus == 0) {
+    return false;
+  }
+  signalSecondaryInt = false;
+
+  //
+  // Frame list rollover.
+  // Increment frame number counter.
+  //
+  if (intStatus & kEHCIRegStatusFrameListRollover) {
+    _frameNumber += kEHCIFrameListSize;
+  }
+
+  //
+  // Port change.
+  // Disabled until the next root hub interrupt transfer is queued.
+  //
+  if (intStatus & kEHCIRegStatusPortChange) {
+    writeOpReg32(kEHCIRegIntEnable, intEnable & ~(kEHCIRegIntEnablePortChange));
+    _intPortChange     = true;
+    signalSecondaryInt = true;
+  }
+
+  //
+  // Transfers completed, either normally or with an error.
+  //
+  if (intStatus & (kEHCIRegStatusInterrupt | kEHCIRegStatusErrorInterrupt)) {
+    _intTransferComplete = true;
+    signalSecondaryInt   = true;
+  }
+
+  //
+  // Host system error, controller has halted.
+  //
+  if (intStatus & kEHCIRegStatusHostSystemError) {
+    _intHostSystemError = true;
+    signalSecondaryInt  = true;
+  }
+
+  //
+  // Async advance doorbell acknowledged, unlinked queue heads are no longer in use.
+  // The unlink is woken directly, the workloop thread may be the one waiting on it.
+  //
+  if (intStatus & kEHCIRegStatusAsyncAdvance) {
+    _asyncAdvanceDone = true;
+    _commandGate->commandWakeup((void *) &_asyncAdvanceDone);
+  }
+
+  writeOpReg32(kEHCIRegStatus, intStatus);
+  OSSynchronizeIO();
+
+  //
+  // Signal the secondary handler manually so the primary is never disabled.
+  //
+  if (signalSecondaryInt) {
+    _interruptEventSource->signalInterrupt();
+  }
+  return false;
+}
+
+//
+// Handles interrupts.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiEHCI::handleInterrupt(IOInterruptEventSource *intEventSource, int count) {
+  WIIDBGLOG("Interrupt: TC: %u, PC: %u, HSE: %u", _intTransferComplete, _intPortChange, _intHostSystemError);
+
+  //
+  // Transfers completed.
+  //
+  if (_intTransferComplete) {
+    _intTransferComplete = false;
+    scanCompletedTransfers();
+  }
+
+  //
+  // Host system error.
+  //
+  if (_intHostSystemError) {
+    _intHostSystemError = false;
+    WIISYSLOG("Host system error, controller status: 0x%X", readOpReg32(kEHCIRegStatus));
+  }
+
+  //
+  // Port change.
+  //
+  if (_intPortChange) {
+    _intPortChange = false;
+    completeRootHubInterruptTransfer(false);
+  }
+}
+
+//
+// Handles the unlink thread call, waking an unlink to check on the controller again.
+//
+void WiiEHCI::handleUnlinkThreadCall(thread_call_param_t param0, thread_call_param_t param1) {
+  WiiEHCI *ehci = (WiiEHCI *) param0;
+  ehci->_commandGate->commandWakeup((void *) &ehci->_asyncAdvanceDone);
+}
+
+//
+// Overrides IOUSBController::PollInterrupts().
+//
+// Processes completed transfers without waiting for the interrupt, used by the debugger and during panic or shutdown.
+// Only transfers whose completion is the safe action are completed, others are left for the interrupt handler.
+//
+void WiiEHCI::PollInterrupts(IOUSBCompletionAction safeAction) {
+  UInt32 intStatus;
+
+  //
+  // Other status bits are left for the primary interrupt handler, it also tracks frame list rollovers.
+  //
+  intStatus = readOpReg32(kEHCIRegStatus) & (kEHCIRegStatusInterrupt | kEHCIRegStatusErrorInterrupt);
+  if (intStatus != 0) {
+    writeOpReg32(kEHCIRegStatus, intStatus);
+    OSSynchronizeIO();
+    _intTransferComplete = true;
+  }
+
+  if (_intTransferComplete) {
+    _intTransferComplete = false;
+    scanCompletedTransfers(safeAction);
+
+    //
+    // Have the workloop pick up any transfers that were not safe to complete here.
+    //
+    if (safeAction != NULL) {
+      _intTransferComplete = true;
+      _interruptEventSource->signalInterrupt();
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,667 @@
+//
+//  WiiEHCI_RootHub.cpp
+//  Wii EHCI USB controller interface
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "WiiEHCI.hpp"
+
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+
+#define kWiiRootHubProductStringIndex   1
+#define kWiiRootHubVendorStringIndex    2
+
+//
+// Overrides IOUSBController::GetRootHubDeviceDescriptor().
+//
+// Returns the device descriptor for the emulated root hub.
+//
+IOReturn WiiEHCI::GetRootHubDeviceDescriptor(IOUSBDeviceDescriptor *desc) {
+  if (desc == NULL) {
+    return kIOReturnNoMemory;
+  }
+
+  //
+  // Populate the device descriptor for the root hub.
+  //
+  desc->bLength             = sizeof (*desc);
+  desc->bDescriptorType     = kUSBDeviceDesc;
+  desc->bcdUSB              = USB_CONSTANT16(kUSBRel20);
+  desc->bDeviceClass        = kUSBHubClass;
+  desc->bDeviceSubClass     = kUSBHubSubClass;
+  desc->bDeviceProtocol     = 1;
+  desc->bMaxPacketSize0     = 64;
+  desc->idVendor            = USB_CONSTANT16(kAppleVendorID);
+  desc->idProduct           = USB_CONSTANT16(kPrdRootHubAppleE);
+  desc->bcdDevice           = USB_CONSTANT16(0x0200);
+  desc->iManufacturer       = kWiiRootHubVendorStringIndex;
+  desc->iProduct            = kWiiRootHubProductStringIndex;
+  desc->iSerialNumber       = 0;
+  desc->bNumConfigurations  = 1;
+
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::GetRootHubDescriptor().
+//
+// Returns the hub descriptor for the emulated root hub.
+//
+IOReturn WiiEHCI::GetRootHubDescriptor(IOUSBHubDescriptor *desc) {
+  UInt32  hcsParams;
+
+  if (desc == NULL) {
+    return kIOReturnNoMemory;
+  }
+
+  hcsParams = readReg32(kEHCIRegHCSParams);
+  WIIDBGLOG("HCS params: 0x%08X", hcsParams);
+
+  //
+  // Populate the hub descriptor for the root hub.
+  //
+  desc->length        = sizeof (*desc);
+  desc->hubType       = kUSBHubDescriptorType;
+  desc->numPorts      = _numPorts;
+  desc->powerOnToGood = 10;
+  desc->hubCurrent    = 0;
+
+  //
+  // Charactistics are little endian.
+  // EHCI has per-port over-current reporting, and per-port power switching if port power control is present.
+  //
+  desc->characteristics  = kPerPortOverCurrentBit;
+  desc->characteristics |= (hcsParams & kEHCIRegHCSParamsPortPower) ? kPerPortSwitchingBit : kNoPowerSwitchingBit;
+  desc->characteristics  = HostToUSBWord(desc->characteristics);
+
+  //
+  // All ports are removable.
+  //
+  *((UInt32*)&desc->removablePortFlags[0]) = 0;
+  *((UInt32*)&desc->removablePortFlags[4]) = 0;
+
+  //
+  // Create bitmap specifying power mode for each port.
+  //
+  *((UInt16*)&desc->pwrCtlPortFlags[0]) = 0xFFFF;
+  *((UInt16*)&desc->pwrCtlPortFlags[2]) = 0;
+  *((UInt32*)&desc->pwrCtlPortFlags[4]) = 0;
+
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::SetRootHubDescriptor().
+//
+// Sets the hub descriptor for the emulated root hub.
+//
+IOReturn WiiEHCI::SetRootHubDescriptor(OSData *buffer) {
+  //
+  // Not implemented.
+  //
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::GetRootHubConfDescriptor().
+//
+// Gets the configuration descriptor for the emulated root hub.
+//
+IOReturn WiiEHCI::GetRootHubConfDescriptor(OSData *desc) {
+  //
+  // Root hub configuration descriptor.
+  //
+  IOUSBConfigurationDescriptor confDescriptor = {
+    sizeof (IOUSBConfigurationDescriptor),  // Length.
+    kUSBConfDesc,                           // Type.
+    USB_CONSTANT16(sizeof (IOUSBConfigurationDescriptor) +
+                   sizeof (IOUSBInterfaceDescriptor) +
+                   sizeof (IOUSBEndpointDescriptor)),   // Total length.
+    1,            // Interface count.
+    1,            // Configuration value.
+    0,            // Configuration string index (none).
+    0x60,         // Attributes (self-powered).
+    0             // Max power.
+  };
+
+  //
+  // Root hub interface descriptor.
+  //
+  IOUSBInterfaceDescriptor interfaceDescriptor = {
+    sizeof (IOUSBInterfaceDescriptor),  // Length.
+    kUSBInterfaceDesc,                  // Type.
+    0,                // Interface number.
+    0,                // Alternate setting.
+    1,                // Endpoint count.
+    kUSBHubClass,     // Class (hub).
+    kUSBHubSubClass,  // Subclass (hub).
+    0,                // Interface procotol.
+    0                 // Interface string index (none).
+  };
+
+  //
+  // Root hub endpoint descriptor.
+  //
+  IOUSBEndpointDescriptor endpointDescriptor = {
+    sizeof (IOUSBEndpointDescriptor),   // Length.
+    kUSBEndpointDesc,                   // Type.
+    0x81,               // Endpoint address.
+    kUSBInterrupt,      // Attributes.
+    HostToUSBWord(8),   // Max packet size.
+    12                  // Interval (2^11 microframes).
+  };
+
+  if (desc == NULL) {
+    return kIOReturnNoMemory;
+  }
+
+  if (!desc->appendBytes(&confDescriptor, confDescriptor.bLength)) {
+    return kIOReturnNoMemory;
+  }
+  if (!desc->appendBytes(&interfaceDescriptor, interfaceDescriptor.bLength)) {
+    return kIOReturnNoMemory;
+  }
+  if (!desc->appendBytes(&endpointDescriptor, endpointDescriptor.bLength)) {
+    return kIOReturnNoMemory;
+  }
+
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::GetRootHubStatus().
+//
+// Gets the root hub status. EHCI has no hub-wide status.
+//
+IOReturn WiiEHCI::GetRootHubStatus(IOUSBHubStatus *status) {
+  status->statusFlags = 0;
+  status->changeFlags = 0;
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::SetRootHubFeature().
+//
+// Sets a root hub feature.
+//
+IOReturn WiiEHCI::SetRootHubFeature(UInt16 wValue) {
+  //
+  // Not implemented.
+  //
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::ClearRootHubFeature().
+//
+// Clears a root hub feature.
+//
+IOReturn WiiEHCI::ClearRootHubFeature(UInt16 wValue) {
+  //
+  // Not implemented.
+  //
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::GetRootHubPortStatus().
+//
+// Gets the status of the specified port on the root hub.
+//
+IOReturn WiiEHCI::GetRootHubPortStatus(IOUSBHubPortStatus *status, UInt16 port) {
+  UInt32 portStatus;
+  UInt16 statusFlags;
+  UInt16 changeFlags;
+
+  if ((port < 1) || (port > _numPorts)) {
+    return kIOReturnBadArgument;
+  }
+
+  portStatus = readRootHubPort32(port);
+  WIIDBGLOG("P%u status: 0x%X", port, portStatus);
+
+  //
+  // EHCI port status is not in hub format, convert it.
+  // Ports handed off to the companion controller are reported as disconnected.
+  //
+  statusFlags = 0;
+  changeFlags = 0;
+  if ((portStatus & kEHCIRegPortStatusOwner) == 0) {
+    statusFlags |= (portStatus & kEHCIRegPortStatusConnect)     ? kHubPortConnection  : 0;
+    statusFlags |= (portStatus & kEHCIRegPortStatusEnable)      ? (kHubPortEnabled | kHubPortHighSpeed) : 0;
+    statusFlags |= (portStatus & kEHCIRegPortStatusSuspend)     ? kHubPortSuspend     : 0;
+    statusFlags |= (portStatus & kEHCIRegPortStatusOverCurrent) ? kHubPortOverCurrent : 0;
+    statusFlags |= (portStatus & kEHCIRegPortStatusReset)       ? kHubPortBeingReset  : 0;
+  }
+  statusFlags |= (portStatus & kEHCIRegPortStatusPower) ? kHubPortPower : 0;
+
+  changeFlags |= (portStatus & kEHCIRegPortStatusConnectChange)     ? kHubPortConnection  : 0;
+  changeFlags |= (portStatus & kEHCIRegPortStatusEnableChange)      ? kHubPortEnabled     : 0;
+  changeFlags |= (portStatus & kEHCIRegPortStatusOverCurrentChange) ? kHubPortOverCurrent : 0;
+  changeFlags |= (_rootHubPortResetChange & (1 << port))            ? kHubPortBeingReset  : 0;
+
+  //
+  // IOUSBFamily expects little endian values.
+  //
+  status->statusFlags = HostToUSBWord(statusFlags);
+  status->changeFlags = HostToUSBWord(changeFlags);
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::SetRootHubPortFeature().
+//
+// Sets a root hub port feature.
+//
+IOReturn WiiEHCI::SetRootHubPortFeature(UInt16 wValue, UInt16 port) {
+  UInt32 value;
+
+  WIIDBGLOG("Port: %u, feature: 0x%X", port, wValue);
+  if ((port < 1) || (port > _numPorts)) {
+    return kIOReturnBadArgument;
+  }
+
+  //
+  // Avoid clearing any change bits when updating the port.
+  //
+  value = readRootHubPort32(port) & ~(kEHCIRegPortStatusChangeMask);
+  switch (wValue) {
+    case kUSBHubPortEnableFeature:
+      //
+      // Ports can only be enabled by the controller during reset.
+      //
+      return kIOReturnSuccess;
+
+    case kUSBHubPortSuspendFeature:
+      value |= kEHCIRegPortStatusSuspend;
+      break;
+
+    case kUSBHubPortResetFeature:
+      return resetRootHubPort(port);
+
+    case kUSBHubPortPowerFeature:
+      value |= kEHCIRegPortStatusPower;
+      break;
+
+    default:
+      WIISYSLOG("Unknown port %u feature set: 0x%X", port, wValue);
+      return kIOReturnUnsupported;
+  }
+
+  writeRootHubPort32(port, value);
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::ClearRootHubPortFeature().
+//
+// Clears a root hub port feature.
+//
+IOReturn WiiEHCI::ClearRootHubPortFeature(UInt16 wValue, UInt16 port) {
+  UInt32 value;
+
+  WIIDBGLOG("Port: %u, feature: 0x%X", port, wValue);
+  if ((port < 1) || (port > _numPorts)) {
+    return kIOReturnBadArgument;
+  }
+
+  //
+  // Avoid clearing any other change bits when updating the port.
+  //
+  value = readRootHubPort32(port) & ~(kEHCIRegPortStatusChangeMask);
+  switch (wValue) {
+    case kUSBHubPortEnableFeature:
+      value &= ~(kEHCIRegPortStatusEnable);
+      break;
+
+    case kUSBHubPortSuspendFeature:
+      //
+      // Drive resume signaling, then end it.
+      //
+      writeRootHubPort32(port, value | kEHCIRegPortStatusForceResume);
+      IOSleep(kWiiEHCIPortResumeMS);
+      value = readRootHubPort32(port) & ~(kEHCIRegPortStatusChangeMask | kEHCIRegPortStatusForceResume);
+      break;
+
+    case kUSBHubPortPowerFeature:
+      value &= ~(kEHCIRegPortStatusPower);
+      break;
+
+    case kUSBHubPortConnectionChangeFeature:
+      value |= kEHCIRegPortStatusConnectChange;
+      break;
+
+    case kUSBHubPortEnableChangeFeature :
+      value |= kEHCIRegPortStatusEnableChange;
+      break;
+
+    case kUSBHubPortSuspendChangeFeature :
+      return kIOReturnSuccess;
+
+    case kUSBHubPortOverCurrentChangeFeature :
+      value |= kEHCIRegPortStatusOverCurrentChange;
+      break;
+
+    case kUSBHubPortResetChangeFeature :
+      _rootHubPortResetChange &= ~(1 << port);
+      return kIOReturnSuccess;
+
+    default:
+      WIISYSLOG("Unknown port %u feature clear: 0x%X", port, wValue);
+      return kIOReturnUnsupported;
+  }
+
+  writeRootHubPort32(port, value);
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::GetRootHubPortState().
+//
+// Gets the state of the specified port on the root hub.
+//
+IOReturn WiiEHCI::GetRootHubPortState(UInt8 *state, UInt16 port) {
+  //
+  // Not implemented.
+  //
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::SetHubAddress().
+//
+// Sets the address of the root hub.
+//
+IOReturn WiiEHCI::SetHubAddress(UInt16 wValue) {
+  WIIDBGLOG("New root hub address: %u", wValue);
+  _rootHubAddress = wValue;
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::GetRootHubStringDescriptor().
+//
+// Gets a string descriptor for the emulated root hub.
+//
+IOReturn WiiEHCI::GetRootHubStringDescriptor(UInt8 index, OSData *desc) {
+  //
+  // Strings are in Unicode.
+  //
+  UInt8 productName[] = {
+    0,          // Length.
+    kUSBStringDesc, // Descriptor type.
+    0x45, 0x00, // "E"
+    0x48, 0x00, // "H"
+    0x43, 0x00, // "C"
+    0x49, 0x00, // "I"
+    0x20, 0x00, // " "
+    0x52, 0x00, // "R"
+    0x6F, 0x00, // "o"
+    0x6F, 0x00, // "o"
+    0x74, 0x00, // "t"
+    0x20, 0x00, // " "
+    0x48, 0x00, // "H"
+    0x75, 0x00, // "u"
+    0x62, 0x00, // "b"
+    0x20, 0x00, // " "
+    0x53, 0x00, // "S"
+    0x69, 0x00, // "i"
+    0x6d, 0x00, // "m"
+    0x75, 0x00, // "u"
+    0x6C, 0x00, // "l"
+    0x61, 0x00, // "a"
+    0x74, 0x00, // "t"
+    0x69, 0x00, // "i"
+    0x6F, 0x00, // "o"
+    0x6E, 0x00, // "n"
+  };
+
+  UInt8 vendorName[] = {
+    0,          // Length.
+    kUSBStringDesc, // Descriptor type.
+    0x41, 0x00, // "A"
+    0x70, 0x00, // "p"
+    0x70, 0x00, // "p"
+    0x6C, 0x00, // "l"
+    0x65, 0x00, // "e"
+    0x20, 0x00, // " "
+    0x43, 0x00, // "C"
+    0x6F, 0x00, // "o"
+    0x6D, 0x00, // "m"
+    0x70, 0x00, // "p"
+    0x75, 0x00, // "u"
+    0x74, 0x00, // "t"
+    0x65, 0x00, // "e"
+    0x72, 0x00, // "r"
+    0x2C, 0x00, // ","
+    0x20, 0x00, // " "
+    0x49, 0x00, // "I"
+    0x6E, 0x00, // "n"
+    0x63, 0x00, // "c"
+    0x2E, 0x00  // "."
+  };
+
+  if (index > kWiiRootHubVendorStringIndex) {
+    return kIOReturnBadArgument;
+  }
+
+  //
+  // Set string lengths.
+  //
+  vendorName[0]   = sizeof (vendorName);
+  productName[0]  = sizeof (productName);
+
+  //
+  // Handle product string.
+  //
+  if (index == kWiiRootHubProductStringIndex) {
+    if (desc == NULL) {
+      return kIOReturnNoMemory;
+    }
+    if (!desc->appendBytes(&productName, productName[0])) {
+      return kIOReturnNoMemory;
+    }
+  }
+
+  //
+  // Handle vendor string.
+  //
+  if (index == kWiiRootHubVendorStringIndex) {
+    if (desc == NULL) {
+      return kIOReturnNoMemory;
+    }
+    if (!desc->appendBytes(&vendorName, vendorName[0])) {
+      return kIOReturnNoMemory;
+    }
+  }
+
+  return kIOReturnSuccess;
+}
+
+//
+// Resets a root hub port.
+//
+// Low and full speed devices are handed off to the companion OHCI controller,
+// as they cannot be used directly from the EHCI root hub.
+//
+IOReturn WiiEHCI::resetRootHubPort(UInt16 port) {
+  UInt32 portStatus;
+
+  portStatus = readRootHubPort32(port) & ~(kEHCIRegPortStatusChangeMask);
+
+  //
+  // K-state on the data lines before reset means a low speed device.
+  //
+  if ((portStatus & kEHCIRegPortStatusLineStatusMask) == kEHCIRegPortStatusLineStatusKState) {
+    WIIDBGLOG("Low speed device on port %u, handing off to companion controller", port);
+    writeRootHubPort32(port, portStatus | kEHCIRegPortStatusOwner);
+  } else {
+    //
+    // Drive reset, then wait for the controller to finish it.
+    //
+    writeRootHubPort32(port, (portStatus & ~(kEHCIRegPortStatusEnable)) | kEHCIRegPortStatusReset);
+    IOSleep(kWiiEHCIPortResetMS);
+    writeRootHubPort32(port, readRootHubPort32(port) & ~(kEHCIRegPortStatusChangeMask | kEHCIRegPortStatusReset));
+
+    for (UInt32 i = 0; i < kWiiEHCIPortResetDoneTimeoutUS; i += 10) {
+      if ((readRootHubPort32(port) & kEHCIRegPortStatusReset) == 0) {
+        break;
+      }
+      IODelay(10);
+    }
+
+    //
+    // A full speed device will not be enabled after reset.
+    //
+    portStatus = readRootHubPort32(port) & ~(kEHCIRegPortStatusChangeMask);
+    if ((portStatus & kEHCIRegPortStatusConnect) && ((portStatus & kEHCIRegPortStatusEnable) == 0)) {
+      WIIDBGLOG("Full speed device on port %u, handing off to companion controller", port);
+      writeRootHubPort32(port, portStatus | kEHCIRegPortStatusOwner);
+    }
+  }
+
+  //
+  // EHCI does not report reset completion, report it here and notify the hub driver.
+  //
+  _rootHubPortResetChange |= (1 << port);
+  completeRootHubInterruptTransfer(false);
+  return kIOReturnSuccess;
+}
+
+//
+// Simulates a control endpoint creation for the root hub.
+//
+IOReturn WiiEHCI::simulateRootHubControlEDCreate(UInt8 endpointNumber, UInt16 maxPacketSize, UInt8 speed) {
+  if ((endpointNumber != 0) || (speed != kUSBDeviceSpeedHigh)) {
+    return kIOReturnBadArgument;
+  }
+  return kIOReturnSuccess;
+}
+
+//
+// Simulates an interrupt endpoint creation for the root hub.
+//
+IOReturn WiiEHCI::simulateRootHubInterruptEDCreate(short endpointNumber, UInt8 direction, short speed, UInt16 maxPacketSize) {
+  if ((endpointNumber != 1) || (speed != kUSBDeviceSpeedHigh) || (direction != kUSBIn)) {
+    return kIOReturnBadArgument;
+  }
+  return kIOReturnSuccess;
+}
+
+//
+// Simulates an interrupt transfer for the root hub.
+//
+void WiiEHCI::simulateRootHubInterruptTransfer(short endpointNumber, IOUSBCompletion completion,
+                                               IOMemoryDescriptor *CBP, bool bufferRounding, UInt32 bufferSize, short direction) {
+  //
+  // Only endpoint 1 is supported.
+  //
+  if ((endpointNumber != 1) || (direction != kUSBIn)) {
+    Complete(completion, kIOReturnBadArgument, bufferSize);
+    return;
+  }
+
+  //
+  // Find a free slot to simulate the root hub interrupt transfer.
+  //
+  IOLockLock(_rootHubInterruptTransLock);
+  for (unsigned int i = 0; i < ARRSIZE(_rootHubInterruptTransactions); i++) {
+    if (_rootHubInterruptTransactions[i].completion.action == NULL) {
+      _rootHubInterruptTransactions[i].buffer       = CBP;
+      _rootHubInterruptTransactions[i].bufferLength = bufferSize;
+      _rootHubInterruptTransactions[i].completion   = completion;
+      IOLockUnlock(_rootHubInterruptTransLock);
+
+      //
+      // Enable the port change interrupt.
+      // These interrupt transfers will get completed when that arrives.
+      //
+      WIIDBGLOG("Queuing root hub change interrupt transfer");
+      writeOpReg32(kEHCIRegIntEnable, readOpReg32(kEHCIRegIntEnable) | kEHCIRegIntEnablePortChange);
+      return;
+    }
+  }
+
+  //
+  // No available slots.
+  //
+  IOLockUnlock(_rootHubInterruptTransLock);
+  Complete(completion, kIOReturnNoMemory, bufferSize);
+}
+
+//
+// Completes any pending root hub interrupt transfers, triggered on the port change interrupt.
+//
+void WiiEHCI::completeRootHubInterruptTransfer(bool abort) {
+  struct WiiEHCIRootHubIntTransaction lastTransaction;
+  IOUSBHubPortStatus  portStatus;
+  UInt16              statusChangedBitmap;
+  UInt32              bufferLengthDelta;
+
+  statusChangedBitmap = 0;
+
+  if (!abort) {
+    //
+    // Encode any port changes into the bitmap.
+    //
+    // EHCI only supports 15 ports, 16-bit bitmap is enough:
+    // bit 0: Root hub status changed, never set.
+    // bit 1: Root hub port 1 status changed.
+    // ...
+    // bit 15: Root hub port 15 status changed.
+    //
+    for (UInt8 port = 1; port <= _numPorts; port++) {
+      GetRootHubPortStatus(&portStatus, port);
+      portStatus.changeFlags = USBToHostWord(portStatus.changeFlags);
+      WIIDBGLOG("Port %u change: 0x%X", port, portStatus.changeFlags);
+      if (portStatus.changeFlags != 0) {
+        statusChangedBitmap |= (1 << port);
+      }
+    }
+
+    //
+    // Convert the bitmap to little-endian if needed.
+    //
+    WIIDBGLOG("Bitmap: 0x%X", statusChangedBitmap);
+    statusChangedBitmap = HostToUSBWord(statusChangedBitmap);
+  }
+
+  if (abort || ((statusChangedBitmap != 0) && (_rootHubInterruptTransactions[0].completion.action != NULL))) {
+    //
+    // Get first one and move all others forward.
+    //
+    IOTakeLock(_rootHubInterruptTransLock);
+    lastTransaction = _rootHubInterruptTransactions[0];
+    for (unsigned int i = 1; i < ARRSIZE(_rootHubInterruptTransactions); i++) {
+      _rootHubInterruptTransactions[i - 1] = _rootHubInterruptTransactions[i];
+      if (_rootHubInterruptTransactions[i].completion.action == NULL) {
+        break;
+      }
+    }
+    IOUnlock(_rootHubInterruptTransLock);
+
+    //
+    // Copy the change bitmap and complete the transfer.
+    //
+    bufferLengthDelta = lastTransaction.bufferLength;
+    if (bufferLengthDelta > sizeof (statusChangedBitmap)) {
+      bufferLengthDelta = sizeof (statusChangedBitmap);
+    }
+    if (_numPorts < 8) {
+      bufferLengthDelta = 1;
+    }
+
+    WIIDBGLOG("Completing root hub change interrupt transfer");
+    lastTransaction.buffer->writeBytes(0, &statusChangedBitmap, bufferLengthDelta);
+    Complete(lastTransaction.completion, abort ? kIOReturnAborted : kIOReturnSuccess, lastTransaction.bufferLength - bufferLengthDelta);
+  } else if (statusChangedBitmap == 0) {
+    //
+    // Re-enable the interrupt, no actual change occurred here.
+    //
+    WIIDBGLOG("No root hub port change, re-arming interrupt");
+    writeOpReg32(kEHCIRegIntEnable, readOpReg32(kEHCIRegIntEnable) | kEHCIRegIntEnablePortChange);
+  }
+}
+
+#endif
@@ -0,0 +1,889 @@
+//
+//  WiiEHCI_UIM.cpp
+//  Wii EHCI USB controller interface
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "WiiEHCI.hpp"
+
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+
+//
+// Submits a control, bulk, or interrupt transfer to be executed by the EHCI controller.
+//
+// Transfers are built starting in the halted dummy tail of the endpoint, with a new dummy tail allocated after them.
+// The first transfer descriptor is only activated once the rest of the chain is in place.
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::doGeneralTransfer(EHCIEndpointData *endpoint, IOUSBCompletion completion,
+                                    IOMemoryDescriptor *buffer, UInt32 bufferSize, UInt32 pid, bool dataToggle) {
+  EHCITransferData  *transferFirst;
+  EHCITransferData  *transferCurr;
+  EHCITransferData  *transferNext;
+  EHCITransferData  *transferTail;
+  UInt32            bufferRemaining;
+  UInt32            transferSize;
+  UInt32            offset;
+  UInt32            packetCount;
+  UInt32            token;
+  UInt32            tokenFirst;
+  IOReturn          status;
+
+  //
+  // Ensure the endpoint is not halted. A stall cleared by a nested unlink is reset once the controller lets go.
+  //
+  if ((USBToHostLong(endpoint->qh->token) & kEHCIQueueTDTokenStatusHalted)
+      && (endpoint->unlinkOperation != kWiiEHCIUnlinkOpClearStall)) {
+    WIISYSLOG("Pipe is stalled (EP Flags: 0x%X)", USBToHostLong(endpoint->qh->flags));
+    return kIOUSBPipeStalled;
+  }
+
+  //
+  // Allocate the new dummy tail. Short packets skip ahead to it.
+  //
+  transferTail = getFreeTransfer(endpoint);
+  if (transferTail == NULL) {
+    return kIOReturnNoMemory;
+  }
+
+  transferFirst   = endpoint->transferTail;
+  transferCurr    = transferFirst;
+  tokenFirst      = 0;
+  offset          = 0;
+  bufferRemaining = bufferSize;
+  status          = kIOReturnSuccess;
+
+  do {
+    transferSize = 0;
+    if (bufferRemaining > 0) {
+      //
+      // Get a bounce buffer.
+      //
+      transferCurr->bounceBuffer = getFreeBounceBuffer(bufferRemaining > kWiiEHCIBounceBufferSize);
+      if (transferCurr->bounceBuffer == NULL) {
+        status = kIOReturnNoMemory;
+        break;
+      }
+
+      if (transferCurr->bounceBuffer->jumbo) {
+        transferSize = (bufferRemaining > kWiiEHCIBounceBufferJumboSize) ? kWiiEHCIBounceBufferJumboSize : bufferRemaining;
+      } else {
+        transferSize = bufferRemaining;
+      }
+      transferCurr->srcBuffer = IOMemoryDescriptor::withSubRange(buffer, offset, transferSize, buffer->getDirection());
+      if (transferCurr->srcBuffer == NULL) {
+        WIISYSLOG("Failed to get sub memory descriptor");
+        status = kIOReturnDMAError;
+        break;
+      }
+
+      //
+      // Copy data to bounce buffer if writing to a USB device.
+      //
+      if (transferCurr->srcBuffer->getDirection() & kIODirectionOut) {
+        if (readToDMABuffer(transferCurr->srcBuffer, 0, transferCurr->bounceBuffer->buf, transferSize) != transferSize) {
+          WIISYSLOG("Failed to copy all bytes into bounce buffer");
+          status = kIOReturnDMAError;
+          break;
+        }
+      }
+
+      offset          += transferSize;
+      bufferRemaining -= transferSize;
+    }
+
+    //
+    // Get the next transfer in the chain, or the new dummy tail if this is the last one.
+    //
+    if (bufferRemaining > 0) {
+      transferNext = getFreeTransfer(endpoint);
+      if (transferNext == NULL) {
+        status = kIOReturnNoMemory;
+        break;
+      }
+    } else {
+      transferNext = transferTail;
+    }
+
+    transferCurr->actualBufferSize = transferSize;
+    transferCurr->completion       = completion;
+    transferCurr->last             = (transferNext == transferTail);
+    transferCurr->nextTransfer     = transferNext;
+
+    transferCurr->td->nextTDPhysAddr    = HostToUSBLong(transferNext->physAddr);
+    transferCurr->td->altNextTDPhysAddr = HostToUSBLong(transferTail->physAddr);
+    transferCurr->td->bufferPhysAddr[0] = HostToUSBLong((transferCurr->bounceBuffer != NULL) ? transferCurr->bounceBuffer->physAddr : 0);
+
+    token = pid | kEHCIQueueTDTokenStatusActive
+      | (kEHCIQueueTDErrorCountMax << kEHCIQueueTDTokenErrorCountShift)
+      | ((transferSize << kEHCIQueueTDTokenBytesShift) & kEHCIQueueTDTokenBytesMask);
+    if (dataToggle) {
+      token |= kEHCIQueueTDTokenDataToggle;
+    }
+    if (transferCurr->last) {
+      token |= kEHCIQueueTDTokenIOC;
+    }
+
+    //
+    // Control transfers carry the data toggle in each descriptor, flip it for an odd number of packets.
+    //
+    packetCount = (endpoint->maxPacketSize > 0) ? ((transferSize + endpoint->maxPacketSize - 1) / endpoint->maxPacketSize) : 1;
+    if ((packetCount == 0) || (packetCount & 1)) {
+      dataToggle = !dataToggle;
+    }
+
+    if (transferCurr == transferFirst) {
+      tokenFirst = token;
+    } else {
+      transferCurr->td->token = HostToUSBLong(token);
+    }
+
+    WIIDBGLOG("qTD phys 0x%X, next 0x%X, token 0x%X, sz %u", transferCurr->physAddr, transferNext->physAddr, token, transferSize);
+    transferCurr = transferNext;
+  } while (bufferRemaining > 0);
+
+  //
+  // Undo the partially built chain on failure. The first transfer remains the dummy tail.
+  //
+  if (status != kIOReturnSuccess) {
+    while (transferCurr != transferFirst) {
+      transferNext = transferFirst->nextTransfer;
+      transferFirst->nextTransfer = (transferNext == transferCurr) ? NULL : transferNext->nextTransfer;
+      returnTransfer(transferNext);
+      if (transferNext == transferCurr) {
+        break;
+      }
+    }
+    if (transferFirst->bounceBuffer != NULL) {
+      returnBounceBuffer(transferFirst->bounceBuffer);
+      transferFirst->bounceBuffer = NULL;
+    }
+    OSSafeReleaseNULL(transferFirst->srcBuffer);
+    transferFirst->td->nextTDPhysAddr    = HostToUSBLong(kEHCILinkTerminate);
+    transferFirst->td->altNextTDPhysAddr = HostToUSBLong(kEHCILinkTerminate);
+    transferFirst->nextTransfer          = NULL;
+    transferFirst->last                  = false;
+    returnTransfer(transferTail);
+    return status;
+  }
+
+  //
+  // Activate the chain. Everything else must be visible to the controller first.
+  //
+  endpoint->transferTail = transferTail;
+  syncMemory();
+  transferFirst->td->token = HostToUSBLong(tokenFirst);
+
+  return kIOReturnSuccess;
+}
+
+//
+// Completes a transaction, calling its completion.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiEHCI::completeTransaction(EHCITransferData *transfer, IOReturn status, UInt32 bufferSizeRemaining) {
+  if (status != kIOReturnSuccess) {
+    WIIDBGLOG("Transaction failed status: 0x%X, qh flags 0x%X, %u bytes left", status,
+      USBToHostLong(transfer->endpoint->qh->flags), bufferSizeRemaining);
+  }
+  Complete(transfer->completion, status, bufferSizeRemaining);
+}
+
+//
+// Completes any finished transactions on an endpoint.
+// If a safe action is specified, scanning stops at the first transaction with a different completion action.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiEHCI::scanEndpointTransfers(EHCIEndpointData *endpoint, IOUSBCompletionAction safeAction) {
+  EHCITransferData  *transfer;
+  EHCITransferData  *nextTransfer;
+  UInt32            token;
+  UInt32            bytesRemaining;
+  UInt32            bufferSizeRemaining;
+  IOReturn          status;
+  bool              skipping;
+  bool              halted;
+  bool              transactionStart;
+
+  bufferSizeRemaining = 0;
+  status              = kIOReturnSuccess;
+  skipping            = false;
+  halted              = false;
+  transactionStart    = true;
+
+  transfer = endpoint->transferHead;
+  while (transfer != endpoint->transferTail) {
+    if (transactionStart && (safeAction != NULL) && (transfer->completion.action != safeAction)) {
+      break;
+    }
+    transactionStart = false;
+
+    if (!skipping) {
+      token = USBToHostLong(transfer->td->token);
+      if (token & kEHCIQueueTDTokenStatusActive) {
+        break;
+      }
+
+      bytesRemaining = (token & kEHCIQueueTDTokenBytesMask) >> kEHCIQueueTDTokenBytesShift;
+      if (bytesRemaining > transfer->actualBufferSize) {
+        bytesRemaining = transfer->actualBufferSize;
+      }
+
+      //
+      // On a halt or a short packet, the controller has moved on from the rest of this transaction.
+      //
+      if (token & kEHCIQueueTDTokenStatusHalted) {
+        status   = convertTDStatus(token);
+        skipping = true;
+        halted   = true;
+      } else if (bytesRemaining != 0) {
+        skipping = true;
+      }
+
+      //
+      // Copy data back into original buffer if this was a read, and only if we actually transfered data.
+      //
+      if ((transfer->srcBuffer != NULL) && (transfer->srcBuffer->getDirection() & kIODirectionIn)
+          && ((transfer->actualBufferSize - bytesRemaining) > 0)) {
+        writeFromDMABuffer(transfer->srcBuffer, 0, transfer->bounceBuffer->buf, transfer->actualBufferSize - bytesRemaining,
+                           _invalidateCacheFunc);
+      }
+      bufferSizeRemaining += bytesRemaining;
+    } else {
+      bufferSizeRemaining += transfer->actualBufferSize;
+    }
+
+    nextTransfer           = transfer->nextTransfer;
+    endpoint->transferHead = nextTransfer;
+
+    if (transfer->last) {
+      completeTransaction(transfer, status, bufferSizeRemaining);
+      bufferSizeRemaining = 0;
+      status              = kIOReturnSuccess;
+      skipping            = false;
+      transactionStart    = true;
+    }
+    returnTransfer(transfer);
+
+    //
+    // A halted endpoint keeps the remaining transactions until the stall is cleared.
+    //
+    if (halted && !skipping) {
+      break;
+    }
+    transfer = nextTransfer;
+  }
+}
+
+//
+// Completes finished transactions on all active endpoints.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiEHCI::scanCompletedTransfers(IOUSBCompletionAction safeAction) {
+  EHCIEndpointData *endpoint;
+
+  endpoint = _activeEndpointHeadPtr;
+  while (endpoint != NULL) {
+    if (endpoint->transferHead != endpoint->transferTail) {
+      scanEndpointTransfers(endpoint, safeAction);
+    }
+    endpoint = endpoint->nextActiveEndpoint;
+  }
+}
+
+//
+// Overrides IOUSBController::UIMCreateControlEndpoint().
+//
+// Creates a control endpoint.
+// Called from IOUSBController::DoCreateEP().
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMCreateControlEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt16 maxPacketSize, UInt8 speed) {
+  return UIMCreateControlEndpoint(functionNumber, endpointNumber, maxPacketSize, speed, 0, 0);
+}
+
+//
+// Overrides IOUSBControllerV2::UIMCreateControlEndpoint().
+//
+// Creates a control endpoint, optionally behind a high speed hub transaction translator.
+// Called from IOUSBControllerV2::DoCreateEP().
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMCreateControlEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt16 maxPacketSize, UInt8 speed,
+                                           USBDeviceAddress highSpeedHub, int highSpeedPort) {
+  EHCIEndpointData  *endpoint;
+  IOReturn          status;
+
+  WIIDBGLOG("F: %d, EP: %u, spd: %u, psz: %u, hub: %u, port: %d", functionNumber, endpointNumber,
+    speed, maxPacketSize, highSpeedHub, highSpeedPort);
+
+  //
+  // Simulate root hub control endpoint creation.
+  //
+  if (functionNumber == _rootHubAddress) {
+    return simulateRootHubControlEDCreate(endpointNumber, maxPacketSize, speed);
+  }
+
+  //
+  // Add a new control endpoint to the asynchronous schedule.
+  //
+  status = addNewEndpoint(functionNumber, endpointNumber, maxPacketSize, speed, kUSBAnyDirn,
+    kWiiEHCIEndpointTypeControl, highSpeedHub, highSpeedPort, &endpoint);
+  if (status != kIOReturnSuccess) {
+    return status;
+  }
+  linkEndpoint(endpoint, _asyncHeadEndpoint);
+
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::UIMCreateControlTransfer() (void* version).
+//
+// Executes a USB control transfer.
+// Called from IOUSBController::ControlTransaction().
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMCreateControlTransfer(short functionNumber, short endpointNumber, IOUSBCompletion completion, void *CBP,
+                                           bool bufferRounding, UInt32 bufferSize, short direction) {
+  IOMemoryDescriptor    *desc = NULL;
+  IODirection           descDirection;
+  IOReturn              status;
+
+  if (direction == kUSBIn) {
+    descDirection = kIODirectionIn;
+  } else {
+    descDirection = kIODirectionOut;
+  }
+
+  //
+  // Create memory descriptor for other function type.
+  //
+  if (bufferSize != 0) {
+    desc = IOMemoryDescriptor::withAddress(CBP, bufferSize, descDirection);
+    if (desc == NULL) {
+      return kIOReturnNoMemory;
+    }
+  }
+
+  status = UIMCreateControlTransfer(functionNumber, endpointNumber, completion, desc, bufferRounding, bufferSize, direction);
+
+  if (desc != NULL) {
+    desc->release();
+  }
+  return status;
+}
+
+//
+// Overrides IOUSBController::UIMCreateControlTransfer() (IOMemoryDescriptor* version).
+//
+// Executes a USB control transfer.
+// Called from IOUSBController::ControlTransaction().
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMCreateControlTransfer(short functionNumber, short endpointNumber, IOUSBCompletion completion,
+                                           IOMemoryDescriptor *CBP, bool bufferRounding, UInt32 bufferSize, short direction) {
+  EHCIEndpointData  *endpoint;
+  UInt8             endpointType;
+
+  WIIDBGLOG("F: %d, EP: %u, dir: %d, sz: %u", functionNumber, endpointNumber, direction, bufferSize);
+
+  //
+  // Locate the control endpoint.
+  //
+  endpointType = kWiiEHCIEndpointTypeControl;
+  endpoint     = getEndpoint(functionNumber, endpointNumber, direction, &endpointType);
+  if (endpoint == NULL) {
+    WIIDBGLOG("Endpoint not found");
+    return kIOUSBEndpointNotFound;
+  }
+
+  //
+  // SETUP always uses DATA0, DATA and STATUS stages start with DATA1.
+  //
+  if (direction == kUSBOut) {
+    return doGeneralTransfer(endpoint, completion, CBP, bufferSize, kEHCIQueueTDTokenPIDOut, true);
+  } else if (direction == kUSBIn) {
+    return doGeneralTransfer(endpoint, completion, CBP, bufferSize, kEHCIQueueTDTokenPIDIn, true);
+  }
+  return doGeneralTransfer(endpoint, completion, CBP, bufferSize, kEHCIQueueTDTokenPIDSetup, false);
+}
+
+//
+// Overrides IOUSBController::UIMCreateControlTransfer() (void* version).
+//
+// Executes a USB control transfer.
+// Called from IOUSBController::ControlTransaction().
+//
+// This function is gated and called within the workloop context.
+//
+// In IOUSBFamily, this calls the old-style UIMCreateControlTransfer with a log function that always prints.
+// Implementing the same thing here to prevent that. The bulk/interrupt versions do not do any logging, no need to override those.
+//
+IOReturn WiiEHCI::UIMCreateControlTransfer(short functionNumber, short endpointNumber, IOUSBCommand* command,
+                                           void *CBP, bool bufferRounding, UInt32 bufferSize, short direction) {
+  return UIMCreateControlTransfer(functionNumber, endpointNumber, command->GetUSLCompletion(), CBP, bufferRounding, bufferSize, direction);
+}
+
+//
+// Overrides IOUSBController::UIMCreateControlTransfer() (IOMemoryDescriptor* version).
+//
+// Executes a USB control transfer.
+// Called from IOUSBController::ControlTransaction().
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMCreateControlTransfer(short functionNumber, short endpointNumber, IOUSBCommand* command,
+                                           IOMemoryDescriptor *CBP, bool bufferRounding, UInt32 bufferSize, short direction) {
+  return UIMCreateControlTransfer(functionNumber, endpointNumber, command->GetUSLCompletion(), CBP, bufferRounding, bufferSize, direction);
+}
+
+//
+// Overrides IOUSBController::UIMCreateBulkEndpoint().
+//
+// Creates a bulk endpoint.
+// Called from IOUSBController::DoCreateEP().
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMCreateBulkEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt8 direction, UInt8 speed, UInt8 maxPacketSize) {
+  return UIMCreateBulkEndpoint(functionNumber, endpointNumber, direction, speed, maxPacketSize, 0, 0);
+}
+
+//
+// Overrides IOUSBControllerV2::UIMCreateBulkEndpoint().
+//
+// Creates a bulk endpoint, optionally behind a high speed hub transaction translator.
+// Called from IOUSBControllerV2::DoCreateEP().
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMCreateBulkEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt8 direction, UInt8 speed,
+                                        UInt16 maxPacketSize, USBDeviceAddress highSpeedHub, int highSpeedPort) {
+  EHCIEndpointData  *endpoint;
+  IOReturn          status;
+
+  WIIDBGLOG("F: %d, EP: %u, dir: %u, spd: %u, psz: %u, hub: %u, port: %d", functionNumber, endpointNumber,
+    direction, speed, maxPacketSize, highSpeedHub, highSpeedPort);
+
+  //
+  // Add a new bulk endpoint to the asynchronous schedule.
+  //
+  status = addNewEndpoint(functionNumber, endpointNumber, maxPacketSize, speed, direction,
+    kWiiEHCIEndpointTypeBulk, highSpeedHub, highSpeedPort, &endpoint);
+  if (status != kIOReturnSuccess) {
+    return status;
+  }
+  linkEndpoint(endpoint, _asyncHeadEndpoint);
+
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::UIMCreateBulkTransfer().
+//
+// Executes a USB bulk transfer.
+// Called from IOUSBController::BulkTransaction().
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMCreateBulkTransfer(short functionNumber, short endpointNumber, IOUSBCompletion completion,
+                                        IOMemoryDescriptor *CBP, bool bufferRounding, UInt32 bufferSize, short direction) {
+  EHCIEndpointData  *endpoint;
+  UInt8             endpointType;
+
+  WIIDBGLOG("F: %d, EP: %u, dir: %d, sz: %u", functionNumber, endpointNumber, direction, bufferSize);
+
+  //
+  // Locate the bulk endpoint.
+  //
+  endpointType = kWiiEHCIEndpointTypeBulk;
+  endpoint     = getEndpoint(functionNumber, endpointNumber, direction, &endpointType);
+  if (endpoint == NULL) {
+    WIIDBGLOG("Endpoint not found");
+    return kIOUSBEndpointNotFound;
+  }
+
+  //
+  // Data toggle is tracked by the queue head.
+  //
+  return doGeneralTransfer(endpoint, completion, CBP, bufferSize,
+    (direction == kUSBIn) ? kEHCIQueueTDTokenPIDIn : kEHCIQueueTDTokenPIDOut, false);
+}
+
+//
+// Overrides IOUSBController::UIMCreateInterruptEndpoint().
+//
+// Creates an interrupt endpoint.
+// Called from IOUSBController::DoCreateEP().
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMCreateInterruptEndpoint(short functionAddress, short endpointNumber, UInt8 direction,
+                                             short speed, UInt16 maxPacketSize, short pollingRate) {
+  return UIMCreateInterruptEndpoint(functionAddress, endpointNumber, direction, speed, maxPacketSize, pollingRate, 0, 0);
+}
+
+//
+// Overrides IOUSBControllerV2::UIMCreateInterruptEndpoint().
+//
+// Creates an interrupt endpoint, optionally behind a high speed hub transaction translator.
+// Called from IOUSBControllerV2::DoCreateEP().
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMCreateInterruptEndpoint(short functionAddress, short endpointNumber, UInt8 direction, short speed,
+                                             UInt16 maxPacketSize, short pollingRate, USBDeviceAddress highSpeedHub, int highSpeedPort) {
+  EHCIEndpointData  *endpoint;
+  UInt32            bandwidth;
+  UInt32            intervalMicroframes;
+  UInt32            splitFlags;
+  UInt8             pollingFrames;
+  UInt8             node;
+  IOReturn          status;
+
+  WIIDBGLOG("F: %d, EP: %u, dir: %d, spd: %d, sz: %u, pr: %d, hub: %u, port: %d", functionAddress, endpointNumber, direction,
+    speed, maxPacketSize, pollingRate, highSpeedHub, highSpeedPort);
+
+  //
+  // Simulate root hub interrupt endpoint creation.
+  //
+  if (functionAddress == _rootHubAddress) {
+    return simulateRootHubInterruptEDCreate(endpointNumber, direction, speed, maxPacketSize);
+  }
+
+  if (speed == kUSBDeviceSpeedHigh) {
+    //
+    // High speed polling rate is an exponent, 2^(rate - 1) microframes.
+    // Faster than once per frame is scheduled in multiple microframes of every frame.
+    //
+    if (pollingRate < 1) {
+      pollingRate = 1;
+    } else if (pollingRate > 16) {
+      pollingRate = 16;
+    }
+    intervalMicroframes = 1 << (pollingRate - 1);
+    bandwidth           = (maxPacketSize & BITRange(0, 10)) * (1 + ((maxPacketSize >> 11) & 0x3));
+
+    if (intervalMicroframes < kEHCIMicroframesPerFrame) {
+      pollingFrames = 1;
+      splitFlags    = (intervalMicroframes == 1) ? 0xFF : ((intervalMicroframes == 2) ? 0x55 : 0x11);
+    } else {
+      intervalMicroframes /= kEHCIMicroframesPerFrame;
+      pollingFrames = (intervalMicroframes > kWiiEHCIInterruptLeafCount) ? kWiiEHCIInterruptLeafCount : intervalMicroframes;
+      splitFlags    = 1 << getInterruptMicroframe(bandwidth);
+    }
+  } else {
+    //
+    // Full and low speed endpoints start a split in microframe 0 and complete it in the following microframes.
+    //
+    pollingFrames = (pollingRate < 1) ? 1 : ((pollingRate > kWiiEHCIInterruptLeafCount) ? kWiiEHCIInterruptLeafCount : pollingRate);
+    bandwidth     = maxPacketSize;
+    splitFlags    = kEHCIQHSplitStartMask | (kEHCIQHSplitCompleteMask << kEHCIQHSplitFlagsCompleteMaskShift);
+  }
+  node = getInterruptNode(pollingFrames);
+
+  //
+  // Create an endpoint linked to the node.
+  //
+  status = addNewEndpoint(functionAddress, endpointNumber, maxPacketSize, speed, direction,
+    kWiiEHCIEndpointTypeInterrupt, highSpeedHub, highSpeedPort, &endpoint);
+  if (status != kIOReturnSuccess) {
+    return status;
+  }
+  endpoint->qh->splitFlags |= HostToUSBLong(splitFlags);
+
+  endpoint->interruptNode             = node;
+  endpoint->bandwidth                 = bandwidth;
+  _interruptEndpoints[node].bandwidth += bandwidth;
+  if (speed == kUSBDeviceSpeedHigh) {
+    for (UInt32 i = 0; i < kEHCIMicroframesPerFrame; i++) {
+      if (splitFlags & (1 << i)) {
+        _microframeLoad[i] += bandwidth;
+      }
+    }
+  }
+  linkEndpoint(endpoint, _interruptEndpoints[node].headEndpoint);
+
+  WIIDBGLOG("Placed interrupt EP phys: 0x%X in node %u, bandwidth: %u, split flags: 0x%X", endpoint->physAddr, node, bandwidth, splitFlags);
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::UIMCreateInterruptTransfer().
+//
+// Executes a USB interrupt transfer.
+// Called from IOUSBController::InterruptTransaction().
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMCreateInterruptTransfer(short functionNumber, short endpointNumber, IOUSBCompletion completion,
+                                             IOMemoryDescriptor *CBP, bool bufferRounding, UInt32 bufferSize, short direction) {
+  EHCIEndpointData  *endpoint;
+  UInt8             endpointType;
+
+  WIIDBGLOG("F: %d, EP: %u, dir: %d, sz: %u", functionNumber, endpointNumber, direction, bufferSize);
+
+  //
+  // Simulate root hub interrupt transfer.
+  //
+  if (functionNumber == _rootHubAddress) {
+    simulateRootHubInterruptTransfer(endpointNumber, completion, CBP, bufferRounding, bufferSize, direction);
+    return kIOReturnSuccess;
+  }
+
+  //
+  // Locate the interrupt endpoint.
+  //
+  endpointType = kWiiEHCIEndpointTypeInterrupt;
+  endpoint     = getEndpoint(functionNumber, endpointNumber, direction, &endpointType);
+  if (endpoint == NULL) {
+    return kIOUSBEndpointNotFound;
+  }
+
+  return doGeneralTransfer(endpoint, completion, CBP, bufferSize,
+    (direction == kUSBIn) ? kEHCIQueueTDTokenPIDIn : kEHCIQueueTDTokenPIDOut, false);
+}
+
+//
+// Overrides IOUSBController::UIMCreateIsochEndpoint().
+//
+// Isochronous endpoints are not supported on the EHCI controller, devices needing them are used through the companion controller.
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMCreateIsochEndpoint(short functionAddress, short endpointNumber, UInt32 maxPacketSize, UInt8 direction) {
+  return UIMCreateIsochEndpoint(functionAddress, endpointNumber, maxPacketSize, direction, 0, 0);
+}
+
+//
+// Overrides IOUSBControllerV2::UIMCreateIsochEndpoint().
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMCreateIsochEndpoint(short functionAddress, short endpointNumber, UInt32 maxPacketSize, UInt8 direction,
+                                         USBDeviceAddress highSpeedHub, int highSpeedPort) {
+  WIISYSLOG("Isochronous endpoints are not supported (F: %d, EP: %u, dir: %d, sz: %u)",
+    functionAddress, endpointNumber, direction, maxPacketSize);
+  return kIOReturnUnsupported;
+}
+
+//
+// Overrides IOUSBController::UIMCreateIsochTransfer().
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMCreateIsochTransfer(short functionAddress, short endpointNumber, IOUSBIsocCompletion completion, UInt8 direction,
+                                         UInt64 frameStart, IOMemoryDescriptor *pBuffer, UInt32 frameCount, IOUSBIsocFrame *pFrames) {
+  return kIOReturnUnsupported;
+}
+
+//
+// Overrides IOUSBController::UIMAbortEndpoint().
+//
+// Removes any transfers for an endpoint.
+// Called from IOUSBController::DoAbortEP().
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMAbortEndpoint(short functionNumber, short endpointNumber, short direction) {
+  EHCIEndpointData  *endpoint;
+  UInt8             endpointType;
+  bool              released;
+
+  WIIDBGLOG("F: %d, EP: %d, dir: %d", functionNumber, endpointNumber, direction);
+
+  //
+  // Locate the endpoint, once unlinking is owned so no other operation is waiting on it.
+  //
+  acquireUnlink();
+  endpointType = kWiiEHCIEndpointTypeAll;
+  endpoint     = getEndpoint(functionNumber, endpointNumber, direction, &endpointType);
+  if (endpoint == NULL) {
+    releaseUnlink();
+    return kIOUSBEndpointNotFound;
+  }
+  WIIDBGLOG("Aborting EP phys: 0x%X", endpoint->physAddr);
+
+  //
+  // Take the queue head off the schedule while the overlay is rewritten, keeping the data toggle.
+  // Aborts nested within another unlink are relinked once the controller has released the queue head.
+  //
+  released = unlinkEndpoint(endpoint);
+  removeEndpointTransfers(endpoint, kIOReturnAborted, released);
+  if (released) {
+    linkEndpoint(endpoint, getEndpointHead(endpoint));
+  } else {
+    deferUnlinkedEndpoint(endpoint, kWiiEHCIUnlinkOpRelink);
+  }
+  releaseUnlink();
+
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::UIMDeleteEndpoint().
+//
+// Removes an endpoint for the list of active endpoints.
+// Called from IOUSBController::DoDeleteEP().
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMDeleteEndpoint(short functionNumber, short endpointNumber, short direction) {
+  EHCIEndpointData  *endpoint;
+  EHCIEndpointData  *prevEndpoint;
+  UInt8             endpointType;
+  UInt32            startMask;
+  bool              released;
+
+  WIIDBGLOG("F: %d, EP: %d, dir: %d", functionNumber, endpointNumber, direction);
+
+  //
+  // Locate the endpoint, once unlinking is owned so no other operation is waiting on it.
+  //
+  acquireUnlink();
+  endpointType = kWiiEHCIEndpointTypeAll;
+  endpoint     = getEndpoint(functionNumber, endpointNumber, direction, &endpointType);
+  if (endpoint == NULL) {
+    releaseUnlink();
+    return kIOUSBEndpointNotFound;
+  }
+  WIIDBGLOG("Deleting EP phys: 0x%X, type: 0x%X", endpoint->physAddr, endpointType);
+
+  //
+  // Remove from the schedule, then complete all transfers.
+  //
+  released = unlinkEndpoint(endpoint);
+  removeEndpointTransfers(endpoint, kIOReturnAborted, released);
+
+  //
+  // Free bandwidth from interrupt endpoints.
+  //
+  if (endpointType == kWiiEHCIEndpointTypeInterrupt) {
+    _interruptEndpoints[endpoint->interruptNode].bandwidth -= endpoint->bandwidth;
+    if (endpoint->speed == kUSBDeviceSpeedHigh) {
+      startMask = USBToHostLong(endpoint->qh->splitFlags) & kEHCIQHSplitFlagsStartMaskMask;
+      for (UInt32 i = 0; i < kEHCIMicroframesPerFrame; i++) {
+        if (startMask & (1 << i)) {
+          _microframeLoad[i] -= endpoint->bandwidth;
+        }
+      }
+    }
+    WIIDBGLOG("Returned interrupt bandwidth: %u bytes from node %u", endpoint->bandwidth, endpoint->interruptNode);
+  }
+
+  //
+  // Remove from active endpoints.
+  //
+  if (_activeEndpointHeadPtr == endpoint) {
+    _activeEndpointHeadPtr = endpoint->nextActiveEndpoint;
+  } else {
+    prevEndpoint = _activeEndpointHeadPtr;
+    while (prevEndpoint->nextActiveEndpoint != endpoint) {
+      prevEndpoint = prevEndpoint->nextActiveEndpoint;
+    }
+    prevEndpoint->nextActiveEndpoint = endpoint->nextActiveEndpoint;
+  }
+  endpoint->nextActiveEndpoint = NULL;
+
+  //
+  // Endpoints deleted within another unlink are freed once the controller has released the queue head.
+  //
+  if (released) {
+    returnEndpoint(endpoint);
+  } else {
+    deferUnlinkedEndpoint(endpoint, kWiiEHCIUnlinkOpRelease);
+  }
+  releaseUnlink();
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBController::UIMClearEndpointStall().
+//
+// Clears all pending transfers and the stall condition from an endpoint.
+// Called from IOUSBController::DoClearEPStall() and others.
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMClearEndpointStall(short functionNumber, short endpointNumber, short direction) {
+  EHCIEndpointData  *endpoint;
+  UInt8             endpointType;
+  bool              released;
+
+  WIIDBGLOG("F: %d, EP: %d, dir: %d", functionNumber, endpointNumber, direction);
+
+  //
+  // Locate the endpoint, once unlinking is owned so no other operation is waiting on it.
+  //
+  acquireUnlink();
+  endpointType = kWiiEHCIEndpointTypeAll;
+  endpoint     = getEndpoint(functionNumber, endpointNumber, direction, &endpointType);
+  if (endpoint == NULL) {
+    releaseUnlink();
+    return kIOUSBEndpointNotFound;
+  }
+  WIIDBGLOG("Clearing EP phys: 0x%X, type 0%X", endpoint->physAddr, endpointType);
+
+  //
+  // Reset the transfer queue by removing all transfers.
+  // Clearing the overlay also clears the halt and resets the data toggle to DATA0.
+  //
+  released = unlinkEndpoint(endpoint);
+  removeEndpointTransfers(endpoint, kIOReturnAborted, released);
+  if (released) {
+    resetEndpointQueue(endpoint, true);
+    linkEndpoint(endpoint, getEndpointHead(endpoint));
+  } else {
+    deferUnlinkedEndpoint(endpoint, kWiiEHCIUnlinkOpClearStall);
+  }
+  releaseUnlink();
+
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUSBControllerV2::UIMHubMaintenance().
+//
+// Transaction translator state is kept per queue head, nothing is needed when hubs come and go.
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiEHCI::UIMHubMaintenance(USBDeviceAddress highSpeedHub, UInt32 highSpeedPort, UInt32 command, UInt32 flags) {
+  WIIDBGLOG("Hub: %u, port: %u, cmd: %u, flags: 0x%X", highSpeedHub, highSpeedPort, command, flags);
+  return kIOReturnSuccess;
+}
+
+void WiiEHCI::UIMRootHubStatusChange(void) {
+WIIDBGLOG("start");
+}
+
+void WiiEHCI::UIMRootHubStatusChange(bool abort) {
+WIIDBGLOG("start");
+}
+
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_3
+//
+// Overrides IOUSBController::UIMCreateIsochTransfer().
+//
+// This function is gated and called within the workloop context.
+//
+// This function is specific to 10.3 and newer.
+//
+IOReturn WiiEHCI::UIMCreateIsochTransfer(short functionAddress, short endpointNumber, IOUSBIsocCompletion completion,
+                                         UInt8 direction, UInt64 frameStart, IOMemoryDescriptor *pBuffer, UInt32 frameCount,
+                                         IOUSBLowLatencyIsocFrame *pFrames, UInt32 updateFrequency) {
+  return kIOReturnUnsupported;
+}
+#endif
+
+#endif
@@ -11,7 +11,7 @@
 #include <IOKit/usb/USB.h>
 #include "WiiCommon.hpp"
 
-#define USB_CONSTANT16(x)	((((x) >> 8) & 0x0FF) | ((x & 0xFF) << 8))
+#define USB_CONSTANT16(x)	((((x) >> 8) & 0x0FF) | (((x) & 0xFF) << 8))
 
 //
 // Revision 1.0 for OHCI.
@@ -203,6 +203,13 @@ typedef struct {
 } OHCIEndpointDescriptor;
 OSCompileAssert(sizeof (OHCIEndpointDescriptor) == kOHCIEndpointDescriptorAlignment);
 
+//
+// OHCI endpoint completion latency histogram.
+// Bucket 0 is under 500us, each following bucket doubles, last bucket is 32ms and over.
+//
+#define kOHCIEndpointLatencyBucketCount   8
+#define kOHCIEndpointLatencyBucketBaseUS  500
+
 //
 // OHCI endpoint data.
 //
@@ -217,6 +224,47 @@ typedef struct OHCIEndpointData {
   struct OHCITransferData *transferTail;
   // Pointer to the next endpoint.
   struct OHCIEndpointData *nextEndpoint;
+
+  // Endpoint type.
+  UInt8                   type;
+  // Lookup key, function/endpoint number/direction in endpoint descriptor flag format.
+  UInt16                  key;
+  // Pointer to the head endpoint of the list this endpoint is linked into.
+  struct OHCIEndpointData *headEndpoint;
+  // Interrupt tree node this endpoint is linked into (interrupt only).
+  UInt8                   interruptNode;
+  // Bandwidth reserved per frame in bytes (interrupt only).
+  UInt16                  bandwidth;
+
+  // Statistics, reset when the endpoint is created.
+  // Isochronous endpoints count each frame as a transfer for bytes and errors.
+  UInt32                  statTransfers;
+  UInt64                  statBytes;
+  UInt32                  statShortPackets;
+  UInt32                  statErrors;
+  UInt32                  statStalls;
+  UInt32                  statJumboBounceBuffers;
+  UInt32                  statLockedCacheMoves;
+  UInt32                  statLatencyHistogram[kOHCIEndpointLatencyBucketCount];
+
+  // Pending retire operations, processed once the controller has passed a start of frame.
+  UInt8                   retireFlags;
+  // Start of frame count when the operations were queued.
+  UInt32                  retireFrame;
+  // Transfer an abort stops at, later transfers were queued after the abort.
+  struct OHCITransferData *retireTail;
+  // Status and remaining buffer size of a failed transaction.
+  IOReturn                retireStatus;
+  UInt32                  retireBufferRemaining;
+  // Control or bulk list disabled until a deleted endpoint is released.
+  UInt32                  retireListMask;
+  // Pointer to the next endpoint pending retire operations.
+  struct OHCIEndpointData *retireNext;
+
+  // Prequeued transfer ring (streaming bulk IN only).
+  struct OHCIBulkStream   *stream;
+  // Traced bytes transferred so far by the current isochronous transaction.
+  UInt32                  traceActualLength;
 } OHCIEndpointData;
 
 //
@@ -225,6 +273,10 @@ typedef struct OHCIEndpointData {
 typedef struct {
   OHCIEndpointData  *headEndpoint;
   OHCIEndpointData  *tailEndpoint;
+  // Index of the next node towards the 1ms node.
+  UInt8             parentNode;
+  // Total bandwidth of endpoints linked to this node in bytes.
+  UInt32            bandwidth;
 } OHCIIntEndpoint;
 
 //
@@ -351,21 +403,70 @@ typedef struct OHCIBounceBuffer {
   struct OHCIBounceBuffer *next;
   // Is bounce buffer jumbo?
   bool                    jumbo;
+  // Is bounce buffer a control transfer slot?
+  bool                    controlSlot;
 
-  // Bounce buffer descriptor.
+  // Bounce buffer descriptor, only set on the first control slot of a page (Wii U only).
   IOMemoryDescriptor      *desc;
-  // Bounce buffer map (Wii only).
-  IOMemoryMap             *map;
   // Bounce buffer physical address.
   IOPhysicalAddress       physAddr;
   // Bounce buffer mapped into kernel memory.
   void                    *buf;
 } OHCIBounceBuffer;
 
+//
+// OHCI bulk IN streaming ring.
+// Jumbo bounce buffers are kept queued to the controller, and client requests are filled from received data.
+//
+#define kOHCIBulkStreamBufferCount  4
+#define kOHCIBulkStreamRequestCount 16
+
+typedef struct {
+  // Completion callback.
+  IOUSBCompletion     completion;
+  // Client buffer.
+  IOMemoryDescriptor  *buffer;
+  // Size of client buffer.
+  UInt32              bufferSize;
+  // Bytes filled so far.
+  UInt32              actualSize;
+  // Short transfers are not an error.
+  bool                bufferRounding;
+} OHCIBulkStreamRequest;
+
+typedef struct {
+  // Bounce buffer holding the received data.
+  OHCIBounceBuffer    *bounceBuffer;
+  // Bytes received.
+  UInt32              actualSize;
+  // Bytes already given to client requests.
+  UInt32              offset;
+  // Transfer ended with a short packet, ending the current client request.
+  bool                shortPacket;
+  // Transfer status.
+  IOReturn            status;
+} OHCIBulkStreamData;
+
+typedef struct OHCIBulkStream {
+  // Ring is running, stopped on abort until the next client request.
+  bool                  started;
+  // Bounce buffers neither queued nor holding data.
+  OHCIBounceBuffer      *freeBuffers[kOHCIBulkStreamBufferCount];
+  UInt32                freeCount;
+  // Received data, oldest first.
+  OHCIBulkStreamData    data[kOHCIBulkStreamBufferCount];
+  UInt32                dataHead;
+  UInt32                dataCount;
+  // Client requests, oldest first.
+  OHCIBulkStreamRequest requests[kOHCIBulkStreamRequestCount];
+  UInt32                requestHead;
+  UInt32                requestCount;
+} OHCIBulkStream;
+
 //
 // OHCI transfer data type.
 //
-typedef enum {
+enum {
   kOHCITransferTypeGeneral = 0,
   kOHCITransferTypeIsochronous,
   kOHCITransferTypeIsochronousLowLatency
@@ -419,6 +520,15 @@ typedef struct OHCITransferData {
   UInt32          isoFrameIndex;
   // Source buffer was copied to/from bounce buffer.
   bool            isoBufferCopied;
+  // Physical address of the client buffer targeted directly, zero if a bounce buffer is used.
+  UInt32          isoDirectPhysAddr;
+  // Timebase when the transfer was taken off the done queue.
+  UInt64          isoDoneTimebase;
+  // Timebase when the transaction was submitted (general transfers only).
+  UInt64          genSubmitTimebase;
+  // Trace ID and requested length of the transaction, zero when not traced.
+  UInt32          traceId;
+  UInt32          traceLength;
 } OHCIGenTransferData;
 
 #endif
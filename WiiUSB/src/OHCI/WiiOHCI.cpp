@@ -17,41 +17,66 @@ bool WiiOHCI::init(OSDictionary *dictionary) {
   WiiCheckDebugArgs();
 
   _memoryMap              = NULL;
-  _mem2Allocator          = NULL;
+  _mem2Service            = NULL;
+  _mem2Client             = NULL;
+  _lockedCacheService     = NULL;
+  _lockedCacheStage       = NULL;
   _baseAddr               = NULL;
   _interruptEventSource   = NULL;
-  _isoInTimerWorkLoop     = NULL;
   _isoInTimerEventSource  = NULL;
-  _isoOutTimerWorkLoop    = NULL;
   _isoOutTimerEventSource = NULL;
 
   _intWriteDoneHead       = false;
+  _intIsoInDone           = false;
   _intResumeDetected      = false;
   _intUnrecoverableError  = false;
   _intRootHubStatus       = false;
+  _intStartOfFrame        = false;
+  _startOfFrameCount      = 0;
 
   _invalidateCacheFunc    = NULL;
 
+  _transfersCached                = checkKernelArgument(kWiiOHCICachedTransfersArg);
+  _doneQueuePendingTicks          = 0;
+  _doneQueuePendingTransfers      = 0;
+  _doneQueueTimebaseTicks         = 0;
+  _doneQueueTransfers             = 0;
+  _doneQueueStatsPublishTimebase  = 0;
+
+  _traceRecords   = NULL;
+  _traceHead      = 0;
+  _traceTail      = 0;
+  _traceDropped   = 0;
+  _traceSequence  = 0;
+
   _endpointBufferHeadPtr  = NULL;
   _freeEndpointHeadPtr    = NULL;
+  _endpointHashCount      = 0;
+  bzero(_endpointHashTable, sizeof (_endpointHashTable));
+  _retireEndpointHeadPtr  = NULL;
+  _bulkStreaming          = checkKernelArgument(kWiiOHCIBulkStreamArg);
 
   _freeBounceBufferHeadPtr      = NULL;
   _freeBounceBufferJumboHeadPtr = NULL;
+  _freeControlSlotHeadPtr       = NULL;
+  _freeBounceBufferCount        = 0;
+  _freeBounceBufferJumboCount   = 0;
   _transferBufferHeadPtr        = NULL;
   _freeGenTransferHeadPtr       = NULL;
   _freeIsoTransferHeadPtr       = NULL;
 
   _frameNumber  = 0;
 
-  _writeDoneHeadLock = IOSimpleLockAlloc();
-  if (_writeDoneHeadLock == NULL) {
-    return false;
-  }
+  _writeDoneHeadPtr = NULL;
+  _isoInHeadPtr     = NULL;
+  _pollDeferredHead = NULL;
 
-  _isoInHeadLock = IOSimpleLockAlloc();
-  if (_isoInHeadLock == NULL) {
-    return false;
-  }
+  _isoOutPrefillPending   = false;
+  _isoInServicedInterrupt = 0;
+  _isoInServicedTimer     = 0;
+  _isoInStatsPublishTicks = 0;
+  _isoInDirect            = checkKernelArgument(kWiiOHCIIsoInDirectArg);
+  bzero(_isoInLatencyHistogram, sizeof (_isoInLatencyHistogram));
 
   _intRootHubStatusLock = IOSimpleLockAlloc();
   if (_intRootHubStatusLock == NULL) {
@@ -118,24 +143,47 @@ IOReturn WiiOHCI::UIMInitialize(IOService *provider) {
   }
 
   //
-  // Get MEM2 allocator if on Wii.
+  // Get MEM2 allocation service and create a client for this controller if on Wii.
   //
   if (!checkPlatformCafe()) {
-    functionSymbol = OSSymbol::withCString(kWiiFuncPlatformGetMem2Allocator);
+    functionSymbol = OSSymbol::withCString(kWiiFuncPlatformGetMem2Service);
     if (functionSymbol == NULL) {
       return kIOReturnNoResources;
     }
-    status = getPlatform()->callPlatformFunction(functionSymbol, false, &_mem2Allocator, 0, 0, 0);
+    status = getPlatform()->callPlatformFunction(functionSymbol, false, &_mem2Service, 0, 0, 0);
     functionSymbol->release();
     if (status != kIOReturnSuccess) {
       return status;
     }
 
-    if (_mem2Allocator == NULL) {
-      WIISYSLOG("Failed to get MEM2 allocator on Wii");
+    if (_mem2Service == NULL) {
+      WIISYSLOG("Failed to get MEM2 allocation service on Wii");
       return kIOReturnUnsupported;
     }
-    _mem2Allocator->retain();
+    _mem2Client = _mem2Service->createClient(getName(), kWiiOHCIMem2Quota);
+    if (_mem2Client == NULL) {
+      return kIOReturnNoResources;
+    }
+  }
+
+  //
+  // Get the locked cache service and allocate the outbound copy stage if enabled.
+  // This is not fatal, outbound data is copied through the data cache without it.
+  //
+  if (checkKernelArgument(kWiiOHCILockedCacheArg)) {
+    functionSymbol = OSSymbol::withCString(kWiiFuncPlatformGetLockedCacheService);
+    if (functionSymbol == NULL) {
+      return kIOReturnNoResources;
+    }
+    status = getPlatform()->callPlatformFunction(functionSymbol, false, &_lockedCacheService, 0, 0, 0);
+    functionSymbol->release();
+
+    if ((status == kIOReturnSuccess) && (_lockedCacheService != NULL)) {
+      _lockedCacheStage = _lockedCacheService->allocate(kWiiOHCILockedCacheStageSize);
+    }
+    if (_lockedCacheStage == NULL) {
+      WIISYSLOG("Locked cache is unavailable, outbound data will be copied through the data cache");
+    }
   }
 
   //
@@ -164,6 +212,7 @@ IOReturn WiiOHCI::UIMInitialize(IOService *provider) {
     return kIOReturnNoResources;
   }
   _workLoop->addEventSource(_interruptEventSource);
+  applyInterruptAffinity(this, provider, 0);
 
   //
   // Create memory cursor.
@@ -186,23 +235,16 @@ IOReturn WiiOHCI::UIMInitialize(IOService *provider) {
   //
   // Wii platforms are not cache coherent, host controller structures must be non-cacheable.
   //
-  if (_mem2Allocator != NULL) {
+  if (_mem2Client != NULL) {
     //
-    // Allocate HCCA from MEM2 region.
+    // Allocate HCCA from MEM2 region, aligned to its size.
     // Wii has issues with device reads/writes that are smaller than 4 bytes to MEM1.
     //
-    if (!_mem2Allocator->allocate(sizeof (*_hccaPtr), &_hccaPhysAddr, sizeof (*_hccaPtr))) {
-      return kIOReturnNoMemory;
-    }
-    _hccaDesc = IOMemoryDescriptor::withPhysicalAddress(_hccaPhysAddr, sizeof (*_hccaPtr), kIODirectionInOut);
-    if (_hccaDesc == NULL) {
-      return kIOReturnNoMemory;
-    }
-    _hccaMap = _hccaDesc->map(kIOMapInhibitCache);
-    if (_hccaMap == NULL) {
-      return kIOReturnNoMemory;
+    status = _mem2Service->allocate(_mem2Client, sizeof (*_hccaPtr), kWiiMem2CacheModeInhibit,
+                                    &_hccaPhysAddr, (void **) &_hccaPtr);
+    if (status != kIOReturnSuccess) {
+      return status;
     }
-    _hccaPtr = (OHCIHostControllerCommArea*) _hccaMap->getVirtualAddress();
   } else {
     //
     // Allocate HCCA from any memory.
@@ -247,6 +289,12 @@ IOReturn WiiOHCI::UIMInitialize(IOService *provider) {
   //
   writeReg32(kOHCIRegHCCA, _hccaPhysAddr);
 
+  //
+  // Transfer descriptors are allocated with the endpoint lists, cache mode must be known before then.
+  //
+  setProperty(kWiiOHCITransferCacheModeKey, _transfersCached ? "CopybackCache" : "InhibitCache");
+  WIIDBGLOG("Transfer descriptors are %s", _transfersCached ? "cacheable" : "cache-inhibited");
+
   //
   // Setup endpoint lists.
   //
@@ -273,6 +321,7 @@ IOReturn WiiOHCI::UIMInitialize(IOService *provider) {
     WIISYSLOG("Failed to configure interrupt endpoints");
     return status;
   }
+  publishInterruptLoadMap();
 
   //
   // Allocate initial bounce buffers.
@@ -293,15 +342,19 @@ IOReturn WiiOHCI::UIMInitialize(IOService *provider) {
     returnBounceBuffer(bounceBuffer);
   }
 
-  //
-  // Configure isochronous inbound bounce buffer refresh timer.
-  // Timer is on its own workloop to avoid any delays.
-  //
-  _isoInTimerWorkLoop = IOWorkLoop::workLoop();
-  if (_isoInTimerWorkLoop == NULL) {
-    return kIOReturnNoMemory;
+  status = allocateControlSlots();
+  if (status != kIOReturnSuccess) {
+    return status;
   }
 
+  setProperty(kWiiOHCIIsoInDirectModeKey, _isoInDirect ? "Direct" : "BounceBuffer");
+  setProperty(kWiiOHCIBulkStreamKey, _bulkStreaming);
+  setProperty(kWiiOHCILockedCacheKey, _lockedCacheStage != NULL);
+
+  //
+  // Configure isochronous bounce buffer timers.
+  // Buffers are serviced from the done queue interrupt and at submission, these are only a safety net.
+  //
   _isoInTimerEventSource = IOTimerEventSource::timerEventSource(this,
 #if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
     OSMemberFunctionCast(IOTimerEventSource::Action, this, &WiiOHCI::handleIsoInTimer)
@@ -312,17 +365,7 @@ IOReturn WiiOHCI::UIMInitialize(IOService *provider) {
   if (_isoInTimerEventSource == NULL) {
     return kIOReturnNoMemory;
   }
-  _isoInTimerWorkLoop->addEventSource(_isoInTimerEventSource);
-  _isoInTimerEventSource->disable();
-
-  //
-  // Configure isochronous outbound bounce buffer refresh timer.
-  // Timer is on its own workloop to avoid any delays.
-  //
-  _isoOutTimerWorkLoop = IOWorkLoop::workLoop();
-  if (_isoOutTimerWorkLoop == NULL) {
-    return kIOReturnNoMemory;
-  }
+  _workLoop->addEventSource(_isoInTimerEventSource);
 
   _isoOutTimerEventSource = IOTimerEventSource::timerEventSource(this,
 #if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
@@ -334,8 +377,15 @@ IOReturn WiiOHCI::UIMInitialize(IOService *provider) {
   if (_isoOutTimerEventSource == NULL) {
     return kIOReturnNoMemory;
   }
-  _isoOutTimerWorkLoop->addEventSource(_isoOutTimerEventSource);
-  _isoOutTimerEventSource->disable();
+  _workLoop->addEventSource(_isoOutTimerEventSource);
+
+  //
+  // Get timebase rate for latency and done queue statistics.
+  //
+  _timebaseTicksPerUS = gPEClockFrequencyInfo.dec_clock_rate_hz / MHz;
+  if (_timebaseTicksPerUS == 0) {
+    _timebaseTicksPerUS = 1;
+  }
 
   //
   // Disable all interrupts.
@@ -387,7 +437,34 @@ IOReturn WiiOHCI::UIMInitialize(IOService *provider) {
 // Called from IOUSBController::stop().
 //
 IOReturn WiiOHCI::UIMFinalize(void) {
+  OHCIBounceBuffer *bounceBuffer;
+
   WIIDBGLOG("start");
+
+  //
+  // Free idle bounce buffers, all transfers have been aborted by now.
+  //
+  while (_freeBounceBufferHeadPtr != NULL) {
+    bounceBuffer             = _freeBounceBufferHeadPtr;
+    _freeBounceBufferHeadPtr = bounceBuffer->next;
+    freeBounceBuffer(bounceBuffer);
+  }
+  while (_freeBounceBufferJumboHeadPtr != NULL) {
+    bounceBuffer                  = _freeBounceBufferJumboHeadPtr;
+    _freeBounceBufferJumboHeadPtr = bounceBuffer->next;
+    freeBounceBuffer(bounceBuffer);
+  }
+  _freeBounceBufferCount      = 0;
+  _freeBounceBufferJumboCount = 0;
+
+  //
+  // Free the locked cache stage, disabling the locked cache if nothing else holds it.
+  //
+  if (_lockedCacheStage != NULL) {
+    _lockedCacheService->deallocate(_lockedCacheStage, kWiiOHCILockedCacheStageSize);
+    _lockedCacheStage = NULL;
+  }
+
   return kIOReturnSuccess;
 }
 
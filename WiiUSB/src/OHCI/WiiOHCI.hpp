@@ -11,12 +11,17 @@
 #include <IOKit/IOBufferMemoryDescriptor.h>
 #include <IOKit/IOFilterInterruptEventSource.h>
 #include <IOKit/IOMemoryCursor.h>
-#include <IOKit/IORangeAllocator.h>
 #include <IOKit/IOTimerEventSource.h>
 #include <IOKit/usb/IOUSBController.h>
+#include <libkern/OSAtomic.h>
 
+#include "WiiCacheCopy.hpp"
 #include "WiiCommon.hpp"
+#include "WiiLockedCache.hpp"
+#include "WiiMem2.hpp"
 #include "OHCIRegs.hpp"
+#include "WiiOHCIStatistics.h"
+#include "WiiOHCITrace.h"
 
 // On Wii, located in MEM2. On Wii U, located anywhere.
 #define kWiiOHCIBounceBufferSize              0x100
@@ -24,8 +29,58 @@
 // Located in any memory.
 #define kWiiOHCIBounceBufferJumboSize         0x800
 #define kWiiOHCIBounceBufferJumboInitialCount 64
-// Refresh rate for isochronous transfer buffers.
-#define kWiiOHCIIsoTimerRefreshUS             500
+// Control transfer slots, carved out of a page located in MEM2 on Wii, anywhere on Wii U.
+// Setup packets and single packet data stages are bounced here.
+#define kWiiOHCIControlSlotSize               64
+// Bounce buffers beyond the initial count are freed once returned, so bursts do not keep memory allocated.
+// MEM2 quota on Wii, bounce buffers are reused so this only limits runaway growth.
+#define kWiiOHCIMem2Quota                     0x100000
+// Number of frames ahead of the controller that outbound isochronous bounce buffers are filled.
+#define kWiiOHCIIsoOutPrefillFrames           3
+// Safety net refresh rate for inbound isochronous transfer buffers.
+// These are normally serviced from the done queue interrupt.
+#define kWiiOHCIIsoInSafetyTimerMS            8
+
+//
+// Inbound isochronous copy-back latency histogram.
+// Bucket 0 is under 16us, each following bucket doubles, last bucket is 1024us and over.
+//
+#define kWiiOHCIIsoLatencyBucketCount         8
+#define kWiiOHCIIsoLatencyBucketBaseUS        16
+#define kWiiOHCIIsoStatsPublishIntervalMS     1000
+
+#define kWiiOHCIIsoInLatencyHistogramKey      "IsoInLatencyHistogram"
+#define kWiiOHCIIsoInServicedInterruptKey     "IsoInServicedInterrupt"
+#define kWiiOHCIIsoInServicedTimerKey         "IsoInServicedTimer"
+
+//
+// Direct low latency inbound isochronous mode.
+// Transfer descriptors point straight at the client buffer when it is physically contiguous and DMA-safe,
+// so completed packets are visible from the primary interrupt without a bounce buffer copy.
+// On Wii, only MEM2 is DMA-safe for the controller.
+//
+#define kWiiOHCIIsoInDirectArg                "-wiiohcidirectiso"
+#define kWiiOHCIIsoInDirectModeKey            "IsoInLowLatencyMode"
+#define kWiiOHCIMem2PhysStart                 0x10000000
+#define kWiiOHCIMem2PhysEnd                   0x14000000
+
+//
+// Bulk IN streaming mode.
+// Bulk IN endpoints keep a ring of transfers queued so the bus does not idle between client requests.
+//
+#define kWiiOHCIBulkStreamArg                 "-wiiohcibulkstream"
+#define kWiiOHCIBulkStreamKey                 "BulkInStreaming"
+
+//
+// Locked cache outbound copy mode.
+// Outbound data is moved into bounce buffers by the locked cache DMA engine, through a scratchpad stage as large as
+// a jumbo bounce buffer, so it never passes through the data cache. Only client buffers that are cache line aligned
+// in every physical segment can be moved, others are copied as before.
+// Holding the stage keeps the locked cache enabled, halving the data cache for everything else. Only available on Wii.
+//
+#define kWiiOHCILockedCacheArg                "-wiiohcilockedcache"
+#define kWiiOHCILockedCacheStageSize          kWiiOHCIBounceBufferJumboSize
+#define kWiiOHCILockedCacheKey                "OutboundLockedCacheCopy"
 
 //
 // Total interrupt nodes in tree.
@@ -33,6 +88,19 @@
 //
 #define kWiiOHCIInterruptNodeCount    (32 + 16 + 8 + 4 + 2 + 1)
 #define kWiiOHCIInterruptIsoNode      (kWiiOHCIInterruptNodeCount - 1)
+#define kWiiOHCIInterruptLeafCount    32
+#define kWiiOHCIInterruptNodeNone     0xFF
+
+//
+// Periodic bandwidth accounting, in bytes per frame.
+// USB 1.1 allows up to 90% of a 12 Mbps frame for periodic (interrupt and isochronous) transfers.
+// Low speed packets take 8 times as long on the bus.
+//
+#define kWiiOHCIPeriodicBandwidthBudget   ((1500 * 9) / 10)
+#define kWiiOHCIInterruptOverheadBytes    13
+#define kWiiOHCILowSpeedCostMultiplier    8
+
+#define kWiiOHCIInterruptLoadMapKey       "InterruptLoadMap"
 
 //
 // Endpoint type masks.
@@ -43,9 +111,39 @@
 #define kWiiOHCIEndpointTypeIsochronous         BIT3
 #define kWiiOHCIEndpointTypeAll                 BITRange(0, 4)
 
+//
+// Endpoint retire operations.
+// Endpoints are skipped and only touched again once the controller has passed the next start of frame.
+// The first start of frame counted after an operation is queued may have happened before the skip took effect,
+// so operations wait for two.
+//
+#define kWiiOHCIRetireFailed                    BIT0
+#define kWiiOHCIRetireAbort                     BIT1
+#define kWiiOHCIRetireDelete                    BIT2
+#define kWiiOHCIRetireStartOfFrames             2
+
+//
+// Endpoint lookup hash table.
+// Table is kept at most 3/4 full to keep probe sequences short.
+//
+#define kWiiOHCIEndpointHashBits          9
+#define kWiiOHCIEndpointHashSize          (1 << kWiiOHCIEndpointHashBits)
+#define kWiiOHCIEndpointHashMaxCount      ((kWiiOHCIEndpointHashSize * 3) / 4)
+
 #define kWiiOHCIEndpointsPerBuffer        (PAGE_SIZE / sizeof (OHCIEndpointDescriptor))
-#define kWiiOHCIGenTransfersPerBuffer     (PAGE_SIZE / sizeof (OHCIGenTransferDescriptor))
-#define kWiiOHCIIsoTransfersPerBuffer     (PAGE_SIZE / sizeof (OHCIIsoTransferDescriptor))
+
+//
+// Cacheable transfer descriptor mode.
+// Transfer descriptors are mapped copy-back and flushed/invalidated at each ownership handoff instead.
+// Endpoint descriptors and the HCCA are written by both sides concurrently and always remain cache-inhibited.
+//
+#define kWiiOHCICachedTransfersArg        "-wiiohcicachedtd"
+#define kWiiOHCIDescriptorCacheLineSize   32
+
+#define kWiiOHCITransferCacheModeKey      "TransferDescriptorCacheMode"
+#define kWiiOHCIDoneQueueTransfersKey     "DoneQueueTransfers"
+#define kWiiOHCIDoneQueueTimebaseTicksKey "DoneQueueTimebaseTicks"
+#define kWiiOHCIDoneQueueStatsIntervalMS  1000
 
 //
 // OHCI endpoint memory buffer.
@@ -88,10 +186,9 @@ private:
   IOBufferMemoryDescriptor  *_buffer;
   IOPhysicalAddress         _physicalAddr;
   bool                      _isochronous;
-  union {
-    OHCIGenTransferDescriptor *_genTDs;
-    OHCIIsoTransferDescriptor *_isoTDs;
-  };
+  UInt8                     *_descriptors;
+  UInt32                    _descriptorStride;
+  UInt32                    _transferCount;
   OHCITransferData          *_transfers;
   WiiOHCITransferBuffer     *_nextBuffer;
 
@@ -104,12 +201,13 @@ public:
   //
   // Buffer functions.
   //
-  static WiiOHCITransferBuffer *transferBuffer(bool isochronous);
+  static WiiOHCITransferBuffer *transferBuffer(bool isochronous, bool cacheable);
   void setNextBuffer(WiiOHCITransferBuffer *buffer);
   WiiOHCITransferBuffer *getNextBuffer(void);
   IOPhysicalAddress getPhysAddr(void);
   OHCITransferData *getTransfer(UInt32 index);
   OHCITransferData *getTransferFromPhysAddr(IOPhysicalAddress physAddr);
+  UInt32 getTransferCount(void);
 };
 
 //
@@ -120,33 +218,61 @@ class WiiOHCI : public IOUSBController {
   WiiDeclareLogFunctions("ohci");
   typedef IOUSBController super;
 
+#if defined(WII_HOST_TEST)
+  //
+  // Host tests call internal functions through their driver subclass.
+  //
+  friend class TestOHCI;
+#endif
+
 private:
   IOMemoryMap             *_memoryMap;
   volatile void           *_baseAddr;
-  IORangeAllocator        *_mem2Allocator;
+  const WiiMem2Service    *_mem2Service;
+  WiiMem2Client           *_mem2Client;
   IONaturalMemoryCursor   *_memoryCursor;
 
+  // Locked cache scratchpad stage for outbound copies, only allocated in locked cache copy mode.
+  const WiiLockedCacheService *_lockedCacheService;
+  void                        *_lockedCacheStage;
+
   //
   // Interrupts.
   //
   IOFilterInterruptEventSource  *_interruptEventSource;
-  IOWorkLoop                    *_isoInTimerWorkLoop;
-  IOWorkLoop                    *_isoOutTimerWorkLoop;
   IOTimerEventSource            *_isoInTimerEventSource;
   IOTimerEventSource            *_isoOutTimerEventSource;
-  IOSimpleLock                  *_writeDoneHeadLock;
-  volatile OHCITransferData     *_writeDoneHeadPtr;
-  IOSimpleLock                  *_isoInHeadLock;
-  volatile OHCITransferData     *_isoInHeadPtr;
+  OHCITransferData * volatile   _writeDoneHeadPtr;
+  OHCITransferData * volatile   _isoInHeadPtr;
+  OHCITransferData              *_pollDeferredHead;
   volatile bool                 _intWriteDoneHead;
+  volatile bool                 _intIsoInDone;
   volatile bool                 _intResumeDetected;
   volatile bool                 _intUnrecoverableError;
+  volatile bool                 _intStartOfFrame;
+  volatile UInt32               _startOfFrameCount;
   IOSimpleLock                  *_intRootHubStatusLock;
   volatile bool                 _intRootHubStatus;
 
   // _invalidate_dcache pointer. This function is not exported on 10.4
   WiiInvalidateDataCacheFunc  _invalidateCacheFunc;
 
+  // Transfer descriptor cache mode and done queue processing cost.
+  // Pending counters are added to by the filter and drained atomically into the totals.
+  bool                        _transfersCached;
+  volatile UInt32             _doneQueuePendingTicks;
+  volatile UInt32             _doneQueuePendingTransfers;
+  UInt64                      _doneQueueTimebaseTicks;
+  UInt64                      _doneQueueTransfers;
+  UInt64                      _doneQueueStatsPublishTimebase;
+
+  // Transaction trace ring, only allocated while a user client is tracing.
+  WiiOHCITraceRecord          *_traceRecords;
+  UInt32                      _traceHead;
+  UInt32                      _traceTail;
+  UInt32                      _traceDropped;
+  UInt32                      _traceSequence;
+
   //
   // Endpoints.
   //
@@ -155,6 +281,13 @@ private:
   // Free endpoints.
   OHCIEndpointData      *_freeEndpointHeadPtr;
 
+  // Active endpoint lookup table, open-addressed with linear probing.
+  OHCIEndpointData      *_endpointHashTable[kWiiOHCIEndpointHashSize];
+  UInt32                _endpointHashCount;
+
+  // Endpoints pending retire operations.
+  OHCIEndpointData      *_retireEndpointHeadPtr;
+
   // Control endpoints.
   OHCIEndpointData      *_controlEndpointHeadPtr;
   OHCIEndpointData      *_controlEndpointTailPtr;
@@ -162,11 +295,21 @@ private:
   // Bulk endpoints.
   OHCIEndpointData      *_bulkEndpointHeadPtr;
   OHCIEndpointData      *_bulkEndpointTailPtr;
+  bool                  _bulkStreaming;
 
   // Isochronous endpoints.
   OHCIEndpointData      *_isoEndpointHeadPtr;
   OHCIEndpointData      *_isoEndpointTailPtr;
   UInt32						    _isoBandwidthAvailable;
+  bool                  _isoOutPrefillPending;
+
+  // Isochronous inbound servicing statistics.
+  UInt32                _timebaseTicksPerUS;
+  UInt32                _isoInLatencyHistogram[kWiiOHCIIsoLatencyBucketCount];
+  UInt32                _isoInServicedInterrupt;
+  UInt32                _isoInServicedTimer;
+  UInt32                _isoInStatsPublishTicks;
+  bool                  _isoInDirect;
 
   // Interrupt endpoints.
   OHCIIntEndpoint       _interruptEndpoints[kWiiOHCIInterruptNodeCount];
@@ -177,6 +320,9 @@ private:
   // Bounce buffers.
   OHCIBounceBuffer          *_freeBounceBufferHeadPtr;
   OHCIBounceBuffer          *_freeBounceBufferJumboHeadPtr;
+  OHCIBounceBuffer          *_freeControlSlotHeadPtr;
+  UInt32                    _freeBounceBufferCount;
+  UInt32                    _freeBounceBufferJumboCount;
 
   // Transfer buffers.
   WiiOHCITransferBuffer     *_transferBufferHeadPtr;
@@ -185,7 +331,6 @@ private:
 
   // HCCA.
   IOMemoryDescriptor          *_hccaDesc;
-  IOMemoryMap                 *_hccaMap;
   IOPhysicalAddress           _hccaPhysAddr;
   OHCIHostControllerCommArea  *_hccaPtr;
   volatile UInt64				      _frameNumber;
@@ -211,14 +356,65 @@ private:
   inline void writeRootHubPort32(UInt16 port, UInt32 data) {
     return writeReg32(kOHCIRegRhPortStatusBase + ((port - 1) * sizeof (UInt32)), data);
   }
+  inline UInt16 getEndpointKey(UInt8 functionNumber, UInt8 endpointNumber, UInt8 direction) {
+    UInt16 key;
+
+    key = (functionNumber & kOHCIEDFlagsFuncMask) | ((endpointNumber << kOHCIEDFlagsEndpointShift) & kOHCIEDFlagsEndpointMask);
+    if (direction == kUSBOut) {
+      key |= kOHCIEDFlagsDirectionOut;
+    } else if (direction == kUSBIn) {
+      key |= kOHCIEDFlagsDirectionIn;
+    } else {
+      key |= kOHCIEDFlagsDirectionTD;
+    }
+    return key;
+  }
+  //
+  // Gets the list enable bit that must be cleared while a deleted endpoint is unlinked.
+  // Periodic lists are read again from the HCCA each frame and stay enabled.
+  //
+  inline UInt32 getEndpointListMask(UInt8 type) {
+    if (type == kWiiOHCIEndpointTypeControl) {
+      return kOHCIRegControlControlListEnable;
+    } else if (type == kWiiOHCIEndpointTypeBulk) {
+      return kOHCIRegControlBulkListEnable;
+    }
+    return 0;
+  }
+  inline UInt32 getEndpointHashIndex(UInt16 key) {
+    return (((UInt32) key) * 0x9E3779B1) >> (32 - kWiiOHCIEndpointHashBits);
+  }
+  //
+  // Hands a transfer descriptor written by the CPU over to the host controller.
+  //
+  inline void flushTransferDescriptor(OHCITransferData *transfer) {
+    if (_transfersCached) {
+      flushDataCache(transfer->genTD, kWiiOHCIDescriptorCacheLineSize);
+    }
+  }
+  //
+  // Discards any stale cached copy of a transfer descriptor before the CPU reads host controller updates.
+  //
+  inline void invalidateTransferDescriptor(OHCITransferData *transfer) {
+    if (_transfersCached) {
+      _invalidateCacheFunc((vm_offset_t) transfer->genTD, kWiiOHCIDescriptorCacheLineSize, false);
+    }
+  }
 
   //
   // Interrupt functions.
   //
+  void pushTransferList(OHCITransferData * volatile *listHeadPtr, OHCITransferData *headTransfer, OHCITransferData *tailTransfer);
+  OHCITransferData *takeTransferList(OHCITransferData * volatile *listHeadPtr);
+  OHCITransferData *takeDoneQueue(void);
   bool filterInterrupt(IOFilterInterruptEventSource *filterIntEventSource);
   void handleInterrupt(IOInterruptEventSource *intEventSource, int count);
   void handleIsoInTimer(IOTimerEventSource *sender);
   void handleIsoOutTimer(IOTimerEventSource *sender);
+  void serviceIsoInTransfers(bool fromTimer);
+  void serviceIsoOutTransfers(void);
+  void publishIsoInStatistics(void);
+  void publishDoneQueueStatistics(void);
 
   IOReturn simulateRootHubControlEDCreate(UInt8 endpointNumber, UInt16 maxPacketSize, UInt8 speed);
   IOReturn simulateRootHubInterruptEDCreate(short endpointNumber, UInt8 direction, short speed, UInt16 maxPacketSize);
@@ -230,8 +426,12 @@ private:
   // Buffer functions.
   //
   OHCIBounceBuffer *allocateBounceBuffer(bool jumbo);
+  void freeBounceBuffer(OHCIBounceBuffer *bounceBuffer);
   OHCIBounceBuffer *getFreeBounceBuffer(bool jumbo);
+  IOReturn allocateControlSlots(void);
+  OHCIBounceBuffer *getFreeControlSlot(void);
   void returnBounceBuffer(OHCIBounceBuffer *bounceBuffer);
+  bool moveToBounceBuffer(IOMemoryDescriptor *srcBuffer, OHCIBounceBuffer *bounceBuffer, UInt32 length);
 
   //
   // Descriptor functions.
@@ -250,22 +450,37 @@ private:
   IOReturn initBulkEndpoints(void);
   IOReturn initIsoEndpoints(void);
   IOReturn initInterruptEndpoints(void);
+  bool insertEndpointHash(OHCIEndpointData *endpoint);
+  void removeEndpointHash(OHCIEndpointData *endpoint);
+  OHCIEndpointData *findEndpointHash(UInt16 key, UInt8 typeMask);
   OHCIEndpointData *getEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt8 direction,
                                 UInt8 *type, OHCIEndpointData **outPrevEndpoint = NULL);
-  OHCIEndpointData *getInterruptEndpointHead(UInt8 pollingRate);
+  UInt32 getInterruptFrameLoad(UInt8 leafNode, UInt8 throughNode = kWiiOHCIInterruptNodeNone);
+  UInt32 getInterruptPeakLoad(UInt8 throughNode = kWiiOHCIInterruptNodeNone);
+  UInt32 getIsoBandwidthReserved(void);
+  UInt8 getInterruptNode(UInt8 pollingRate, UInt32 bandwidth);
+  void publishInterruptLoadMap(void);
+  void updateEndpointStatistics(OHCIEndpointData *endpoint, IOReturn status, UInt32 bytes);
+  void completeEndpointStatistics(OHCIEndpointData *endpoint, UInt64 submitTimebase);
+  void publishEndpointStatistics(void);
   IOReturn addNewEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt16 maxPacketSize,
-                          UInt8 speed, UInt8 direction, OHCIEndpointData *endpointHeadPtr,
-                          bool isochronous = false);
-  IOReturn removeEndpoint(UInt8 functionNumber, UInt8 endpointNumber,
-                          OHCIEndpointData *endpointHeadPtr, OHCIEndpointData *endpointTailPtr);
-  void removeEndpointTransfers(OHCIEndpointData *endpoint);
+                          UInt8 speed, UInt8 direction, OHCIEndpointData *endpointHeadPtr, UInt8 type,
+                          OHCIEndpointData **outEndpoint = NULL);
+  void removeEndpoint(OHCIEndpointData *endpoint, OHCIEndpointData *prevEndpoint);
+  void removeEndpointTransfers(OHCIEndpointData *endpoint, OHCITransferData *stopTransfer);
   void completeFailedEndpointGenTransfers(OHCIEndpointData *endpoint, IOReturn tdStatus, UInt32 bufferSizeRemaining);
+  void retireEndpoint(OHCIEndpointData *endpoint, UInt8 retireFlags);
+  UInt8 takeRetiredEndpoint(OHCIEndpointData *endpoint);
+  void completeRetiredEndpoint(OHCIEndpointData *endpoint, UInt8 retireFlags);
+  void completeDeletedEndpoint(OHCIEndpointData *endpoint);
+  void processRetiredEndpoints(void);
 
   //
   // Transfers.
   //
   IOReturn doGeneralTransfer(OHCIEndpointData *endpoint, IOUSBCompletion completion,
                              IOMemoryDescriptor *buffer, UInt32 bufferSize, UInt32 flags, UInt32 cmdBits);
+  UInt32 getIsoInDirectPhysAddr(IOMemoryDescriptor *buffer, UInt32 transferSize);
   IOReturn prepareIsochTransfer(OHCITransferData *transfer, IOMemoryDescriptor *buffer, UInt32 offset, UInt32 transferSize,
                                 UInt16 numPackets, UInt32 flags);
   IOReturn doIsochTransfer(short functionAddress, short endpointNumber, IOUSBIsocCompletion completion, UInt8 direction,
@@ -275,6 +490,37 @@ private:
   void completeIsochTransfer(OHCITransferData *transfer, IOReturn status);
   void completeTransferQueue(OHCITransferData *headTransfer);
 
+  //
+  // Transaction tracing.
+  //
+  inline UInt32 getTraceId(void) {
+    return (_traceRecords != NULL) ? ++_traceSequence : 0;
+  }
+  inline void traceEvent(UInt8 event, OHCIEndpointData *endpoint, UInt32 id, UInt32 length,
+                         UInt32 actualLength = 0, IOReturn status = kIOReturnSuccess, UInt8 conditionCode = 0) {
+    if ((_traceRecords != NULL) && (id != 0)) {
+      recordTraceEvent(event, endpoint, id, length, actualLength, status, conditionCode);
+    }
+  }
+  void recordTraceEvent(UInt8 event, OHCIEndpointData *endpoint, UInt32 id, UInt32 length,
+                        UInt32 actualLength, IOReturn status, UInt8 conditionCode);
+  IOReturn startTraceGated(void);
+  IOReturn stopTraceGated(void);
+  IOReturn readTraceGated(WiiOHCITraceRecord *records, UInt32 *count);
+
+  //
+  // Bulk IN streaming.
+  //
+  static void bulkStreamCompletionAction(void *target, void *parameter, IOReturn status, UInt32 bufferSizeRemaining);
+  bool createBulkStream(OHCIEndpointData *endpoint);
+  void destroyBulkStream(OHCIEndpointData *endpoint);
+  void abortBulkStream(OHCIEndpointData *endpoint);
+  IOReturn queueBulkStreamRequest(OHCIEndpointData *endpoint, IOUSBCompletion completion,
+                                  IOMemoryDescriptor *buffer, UInt32 bufferSize, bool bufferRounding);
+  IOReturn queueBulkStreamTransfer(OHCIEndpointData *endpoint, OHCIBounceBuffer *bounceBuffer);
+  void completeBulkStreamTransfer(OHCITransferData *transfer, IOReturn status, UInt32 bufferSizeRemaining);
+  void serviceBulkStream(OHCIEndpointData *endpoint);
+
 protected:
   //
   // Overrides.
@@ -341,6 +587,14 @@ public:
   void PollInterrupts(IOUSBCompletionAction safeAction = 0);
 
   IOReturn GetRootHubStringDescriptor(UInt8 index, OSData *desc);
+
+  //
+  // Transaction tracing, used by the user client.
+  //
+  IOReturn startTrace(void);
+  void stopTrace(void);
+  IOReturn readTrace(WiiOHCITraceRecord *records, UInt32 *count);
+  void getTraceInfo(UInt32 *ticksPerUS, UInt32 *dropped);
 };
 
 #endif
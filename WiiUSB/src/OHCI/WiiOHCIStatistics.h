@@ -0,0 +1,29 @@
+//
+//  WiiOHCIStatistics.h
+//  Wii OHCI USB per-endpoint statistics properties
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  Shared between the kernel extension and user space tools, must remain plain C.
+//
+
+#ifndef WiiOHCIStatistics_h
+#define WiiOHCIStatistics_h
+
+//
+// Per-endpoint statistics, published with the done queue statistics.
+// Each endpoint is keyed by function, endpoint number, and direction, such as "F3-EP1-In".
+// Counters are reset when the endpoint is created. Type holds the same values as trace record types.
+//
+#define kWiiOHCIEndpointStatisticsKey       "EndpointStatistics"
+#define kWiiOHCIEndpointStatTypeKey         "Type"
+#define kWiiOHCIEndpointStatTransfersKey    "Transfers"
+#define kWiiOHCIEndpointStatBytesKey        "Bytes"
+#define kWiiOHCIEndpointStatShortPacketsKey "ShortPackets"
+#define kWiiOHCIEndpointStatErrorsKey       "Errors"
+#define kWiiOHCIEndpointStatStallsKey       "Stalls"
+#define kWiiOHCIEndpointStatJumboBuffersKey "JumboBounceBuffers"
+#define kWiiOHCIEndpointStatLockedCacheKey  "LockedCacheMoves"
+#define kWiiOHCIEndpointStatLatencyKey      "LatencyHistogram"
+
+#endif
@@ -0,0 +1,78 @@
+//
+//  WiiOHCITrace.h
+//  Wii OHCI USB transaction trace interface
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  Shared between the kernel extension and user space tools, must remain plain C.
+//
+
+#ifndef WiiOHCITrace_h
+#define WiiOHCITrace_h
+
+//
+// User client methods.
+//
+// GetInfo:     no inputs, outputs timebase ticks per microsecond, dropped records, and ring capacity.
+// ReadRecords: no inputs, outputs as many pending records as fit in the structure.
+//
+enum {
+  kWiiOHCITraceMethodGetInfo      = 0,
+  kWiiOHCITraceMethodReadRecords  = 1,
+  kWiiOHCITraceMethodCount
+};
+
+//
+// Trace events.
+//
+#define kWiiOHCITraceEventSubmit    'S'
+#define kWiiOHCITraceEventComplete  'C'
+
+// Condition code for completions not reported by the controller, such as aborts.
+#define kWiiOHCITraceConditionCodeNone  0xFF
+
+//
+// Record key and type fields, matching the endpoint descriptor flags and driver endpoint types.
+//
+#define kWiiOHCITraceKeyFunctionMask    0x007F
+#define kWiiOHCITraceKeyEndpointShift   7
+#define kWiiOHCITraceKeyEndpointMask    0x000F
+#define kWiiOHCITraceKeyDirectionIn     0x1000
+
+#define kWiiOHCITraceTypeControl        0x01
+#define kWiiOHCITraceTypeInterrupt      0x02
+#define kWiiOHCITraceTypeBulk           0x04
+#define kWiiOHCITraceTypeIsochronous    0x08
+
+//
+// Trace record, big endian as written by the controller driver.
+// Submit and complete records for the same transaction have the same ID.
+//
+typedef struct {
+  // Processor timebase when the record was written.
+  UInt64  timebase;
+  // Transaction ID.
+  UInt32  id;
+  // Requested length in bytes.
+  UInt32  length;
+  // Transferred length in bytes (complete only).
+  UInt32  actualLength;
+  // Completion status (complete only).
+  UInt32  status;
+  // Function/endpoint number/direction in endpoint descriptor flag format.
+  UInt16  key;
+  // Controller frame number.
+  UInt16  frameNumber;
+  // Event type.
+  UInt8   event;
+  // Endpoint type mask.
+  UInt8   type;
+  // OHCI condition code of the last transfer descriptor (complete only).
+  UInt8   conditionCode;
+  UInt8   reserved;
+} WiiOHCITraceRecord;
+
+#define kWiiOHCITraceRecordCount      4096
+#define kWiiOHCITraceReadMaxRecords   (4096 / sizeof (WiiOHCITraceRecord))
+
+#endif
@@ -0,0 +1,117 @@
+//
+//  WiiOHCIUserClient.cpp
+//  Wii OHCI USB transaction trace user client
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "WiiOHCIUserClient.hpp"
+
+OSDefineMetaClassAndStructors(WiiOHCIUserClient, super);
+
+//
+// Overrides IOUserClient::initWithTask().
+//
+bool WiiOHCIUserClient::initWithTask(task_t owningTask, void *securityToken, UInt32 type) {
+  WiiCheckDebugArgs();
+
+  //
+  // Traces expose every transaction on the bus, restrict to administrators.
+  //
+  if (clientHasPrivilege(securityToken, kIOClientPrivilegeAdministrator) != kIOReturnSuccess) {
+    return false;
+  }
+
+  _controller = NULL;
+
+  return super::initWithTask(owningTask, securityToken, type);
+}
+
+//
+// Overrides IOUserClient::start().
+//
+bool WiiOHCIUserClient::start(IOService *provider) {
+  _controller = OSDynamicCast(WiiOHCI, provider);
+  if (_controller == NULL) {
+    return false;
+  }
+
+  if (!super::start(provider)) {
+    return false;
+  }
+
+  //
+  // Only one client may trace at a time.
+  //
+  if (_controller->startTrace() != kIOReturnSuccess) {
+    WIISYSLOG("Failed to start transaction tracing");
+    _controller = NULL;
+    super::stop(provider);
+    return false;
+  }
+
+  _methods[kWiiOHCITraceMethodGetInfo].object = this;
+  _methods[kWiiOHCITraceMethodGetInfo].func   = (IOMethod) &WiiOHCIUserClient::getInfo;
+  _methods[kWiiOHCITraceMethodGetInfo].flags  = kIOUCScalarIScalarO;
+  _methods[kWiiOHCITraceMethodGetInfo].count0 = 0;
+  _methods[kWiiOHCITraceMethodGetInfo].count1 = 3;
+
+  _methods[kWiiOHCITraceMethodReadRecords].object = this;
+  _methods[kWiiOHCITraceMethodReadRecords].func   = (IOMethod) &WiiOHCIUserClient::readRecords;
+  _methods[kWiiOHCITraceMethodReadRecords].flags  = kIOUCScalarIStructO;
+  _methods[kWiiOHCITraceMethodReadRecords].count0 = 0;
+  _methods[kWiiOHCITraceMethodReadRecords].count1 = 0xFFFFFFFF;
+
+  return true;
+}
+
+//
+// Overrides IOUserClient::clientClose().
+//
+IOReturn WiiOHCIUserClient::clientClose(void) {
+  if (_controller != NULL) {
+    _controller->stopTrace();
+    _controller = NULL;
+  }
+
+  terminate();
+  return kIOReturnSuccess;
+}
+
+//
+// Overrides IOUserClient::getTargetAndMethodForIndex().
+//
+IOExternalMethod *WiiOHCIUserClient::getTargetAndMethodForIndex(IOService **targetP, UInt32 index) {
+  if ((index >= kWiiOHCITraceMethodCount) || (_controller == NULL)) {
+    return NULL;
+  }
+
+  *targetP = this;
+  return &_methods[index];
+}
+
+//
+// Gets the timebase frequency, number of dropped records, and capacity of the trace ring.
+//
+IOReturn WiiOHCIUserClient::getInfo(UInt32 *ticksPerUS, UInt32 *dropped, UInt32 *capacity) {
+  _controller->getTraceInfo(ticksPerUS, dropped);
+  *capacity = kWiiOHCITraceRecordCount;
+  return kIOReturnSuccess;
+}
+
+//
+// Reads pending records into the output structure.
+//
+IOReturn WiiOHCIUserClient::readRecords(WiiOHCITraceRecord *records, IOByteCount *recordsSize) {
+  UInt32    count;
+  IOReturn  status;
+
+  count = *recordsSize / sizeof (WiiOHCITraceRecord);
+  if (count > kWiiOHCITraceReadMaxRecords) {
+    count = kWiiOHCITraceReadMaxRecords;
+  }
+
+  status = _controller->readTrace(records, &count);
+  *recordsSize = (status == kIOReturnSuccess) ? (count * sizeof (WiiOHCITraceRecord)) : 0;
+  return status;
+}
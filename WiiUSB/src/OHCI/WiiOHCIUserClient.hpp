@@ -0,0 +1,38 @@
+//
+//  WiiOHCIUserClient.hpp
+//  Wii OHCI USB transaction trace user client
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef WiiOHCIUserClient_hpp
+#define WiiOHCIUserClient_hpp
+
+#include <IOKit/IOUserClient.h>
+
+#include "WiiOHCI.hpp"
+
+//
+// Represents a user client tracing transactions on the controller.
+// Tracing runs only while a client is open, one client at a time.
+//
+class WiiOHCIUserClient : public IOUserClient {
+  OSDeclareDefaultStructors(WiiOHCIUserClient);
+  WiiDeclareLogFunctions("ohci");
+  typedef IOUserClient super;
+
+private:
+  WiiOHCI           *_controller;
+  IOExternalMethod  _methods[kWiiOHCITraceMethodCount];
+
+public:
+  bool initWithTask(task_t owningTask, void *securityToken, UInt32 type);
+  bool start(IOService *provider);
+  IOReturn clientClose(void);
+  IOExternalMethod *getTargetAndMethodForIndex(IOService **targetP, UInt32 index);
+
+  IOReturn getInfo(UInt32 *ticksPerUS, UInt32 *dropped, UInt32 *capacity);
+  IOReturn readRecords(WiiOHCITraceRecord *records, IOByteCount *recordsSize);
+};
+
+#endif
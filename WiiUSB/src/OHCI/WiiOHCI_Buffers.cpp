@@ -99,15 +99,19 @@ void WiiOHCITransferBuffer::free(void) {
     _buffer->complete();
     OSSafeReleaseNULL(_buffer);
   }
+  if (_transfers != NULL) {
+    IOFree(_transfers, _transferCount * sizeof (OHCITransferData));
+    _transfers = NULL;
+  }
   super::free();
 }
 
 //
 // Allocates a new transfer buffer.
 //
-WiiOHCITransferBuffer *WiiOHCITransferBuffer::transferBuffer(bool isochronous) {
+WiiOHCITransferBuffer *WiiOHCITransferBuffer::transferBuffer(bool isochronous, bool cacheable) {
   WiiOHCITransferBuffer   *transferBuffer;
-  IOByteCount             numTransfers;
+  IOByteCount             descriptorSize;
   IOByteCount             length;
 
   transferBuffer = new WiiOHCITransferBuffer;
@@ -116,19 +120,30 @@ WiiOHCITransferBuffer *WiiOHCITransferBuffer::transferBuffer(bool isochronous) {
   }
   transferBuffer->_isochronous = isochronous;
 
+  //
+  // Cacheable descriptors are placed one per cache line.
+  // A flush or invalidate of one descriptor must never touch a neighbor owned by the host controller.
+  //
+  descriptorSize = isochronous ? sizeof (OHCIIsoTransferDescriptor) : sizeof (OHCIGenTransferDescriptor);
+  if (cacheable && (descriptorSize < kWiiOHCIDescriptorCacheLineSize)) {
+    descriptorSize = kWiiOHCIDescriptorCacheLineSize;
+  }
+  transferBuffer->_descriptorStride = descriptorSize;
+  transferBuffer->_transferCount    = PAGE_SIZE / descriptorSize;
+
   //
   // Allocate the transfer data.
   //
-  numTransfers = isochronous ? kWiiOHCIIsoTransfersPerBuffer : kWiiOHCIGenTransfersPerBuffer;
-  transferBuffer->_transfers = (OHCITransferData *) IOMalloc(numTransfers * sizeof (OHCITransferData));
+  transferBuffer->_transfers = (OHCITransferData *) IOMalloc(transferBuffer->_transferCount * sizeof (OHCITransferData));
   if (transferBuffer->_transfers == NULL) {
     transferBuffer->release();
     return NULL;
   }
 
   //
-  // Allocate host controller endpoint descriptors out of a page.
-  // Wii platforms are not cache coherent, host controller structures must be non-cacheable.
+  // Allocate host controller transfer descriptors out of a page.
+  // Wii platforms are not cache coherent, host controller structures must be non-cacheable
+  // unless the caller manages coherency at each ownership handoff.
   //
   transferBuffer->_buffer = IOBufferMemoryDescriptor::withOptions(kIOMemoryPhysicallyContiguous, PAGE_SIZE, PAGE_SIZE);
   if (transferBuffer->_buffer == NULL) {
@@ -138,26 +153,24 @@ WiiOHCITransferBuffer *WiiOHCITransferBuffer::transferBuffer(bool isochronous) {
 
   transferBuffer->_buffer->prepare();
   transferBuffer->_physicalAddr = transferBuffer->_buffer->getPhysicalSegment(0, &length);
-  if (isochronous) {
-    transferBuffer->_isoTDs = (OHCIIsoTransferDescriptor *) transferBuffer->_buffer->getBytesNoCopy();
-    IOSetProcessorCacheMode(kernel_task, (IOVirtualAddress) transferBuffer->_isoTDs, PAGE_SIZE, kIOInhibitCache);
+  transferBuffer->_descriptors  = (UInt8 *) transferBuffer->_buffer->getBytesNoCopy();
+  if (cacheable) {
+    flushDataCache(transferBuffer->_descriptors, PAGE_SIZE);
   } else {
-    transferBuffer->_genTDs = (OHCIGenTransferDescriptor *) transferBuffer->_buffer->getBytesNoCopy();
-    IOSetProcessorCacheMode(kernel_task, (IOVirtualAddress) transferBuffer->_genTDs, PAGE_SIZE, kIOInhibitCache);
+    IOSetProcessorCacheMode(kernel_task, (IOVirtualAddress) transferBuffer->_descriptors, PAGE_SIZE, kIOInhibitCache);
   }
 
   //
   // Configure transfer data.
   //
-  for (UInt32 i = 0; i < (isochronous ? kWiiOHCIIsoTransfersPerBuffer : kWiiOHCIGenTransfersPerBuffer); i++) {
+  for (UInt32 i = 0; i < transferBuffer->_transferCount; i++) {
     transferBuffer->_transfers[i].type = isochronous ? kOHCITransferTypeIsochronous : kOHCITransferTypeGeneral;
     if (isochronous) {
-      transferBuffer->_transfers[i].isoTD    = &transferBuffer->_isoTDs[i];
-      transferBuffer->_transfers[i].physAddr = transferBuffer->_physicalAddr + (i * sizeof (transferBuffer->_isoTDs[0]));
+      transferBuffer->_transfers[i].isoTD = (OHCIIsoTransferDescriptor *) &transferBuffer->_descriptors[i * descriptorSize];
     } else {
-      transferBuffer->_transfers[i].genTD    = &transferBuffer->_genTDs[i];
-      transferBuffer->_transfers[i].physAddr = transferBuffer->_physicalAddr + (i * sizeof (transferBuffer->_genTDs[0]));
+      transferBuffer->_transfers[i].genTD = (OHCIGenTransferDescriptor *) &transferBuffer->_descriptors[i * descriptorSize];
     }
+    transferBuffer->_transfers[i].physAddr     = transferBuffer->_physicalAddr + (i * descriptorSize);
     transferBuffer->_transfers[i].nextTransfer = NULL;
   }
 
@@ -190,7 +203,7 @@ IOPhysicalAddress WiiOHCITransferBuffer::getPhysAddr(void) {
 // Gets a transfer at the specified index.
 //
 OHCITransferData *WiiOHCITransferBuffer::getTransfer(UInt32 index) {
-  if (index >= (_isochronous ? kWiiOHCIIsoTransfersPerBuffer : kWiiOHCIGenTransfersPerBuffer)) {
+  if (index >= _transferCount) {
     return NULL;
   }
   return &_transfers[index];
@@ -203,7 +216,14 @@ OHCITransferData *WiiOHCITransferBuffer::getTransferFromPhysAddr(IOPhysicalAddre
   if ((physAddr & ~(PAGE_MASK)) != _physicalAddr) {
     return NULL;
   }
-  return &_transfers[(physAddr & PAGE_MASK) / (_isochronous ? sizeof (_isoTDs[0]) : sizeof (_genTDs[0]))];
+  return &_transfers[(physAddr & PAGE_MASK) / _descriptorStride];
+}
+
+//
+// Gets the number of transfers in the buffer.
+//
+UInt32 WiiOHCITransferBuffer::getTransferCount(void) {
+  return _transferCount;
 }
 
 //
@@ -219,35 +239,28 @@ OHCIBounceBuffer *WiiOHCI::allocateBounceBuffer(bool jumbo) {
     return NULL;
   }
 
-  bounceBuffer->jumbo = jumbo;
-  bounceBuffer->next  = NULL;
+  bounceBuffer->jumbo       = jumbo;
+  bounceBuffer->controlSlot = false;
+  bounceBuffer->next        = NULL;
   bufferLength = jumbo ? kWiiOHCIBounceBufferJumboSize : kWiiOHCIBounceBufferSize;
 
   //
-  // If allocator was provided, use that. Otherwise just allocate from regular kernel memory.
+  // If a MEM2 client was created, use that. Otherwise just allocate from regular kernel memory.
   //
-  if (_mem2Allocator != NULL) {
-    if (!_mem2Allocator->allocate(bufferLength, &bounceBuffer->physAddr, bufferLength)) {
-      return NULL;
-    }
-
-    bounceBuffer->desc = IOMemoryDescriptor::withPhysicalAddress(bounceBuffer->physAddr, bufferLength, kIODirectionInOut);
-    if (bounceBuffer->desc == NULL) {
+  if (_mem2Client != NULL) {
+    if (_mem2Service->allocate(_mem2Client, bufferLength, kWiiMem2CacheModeCopyback,
+                               &bounceBuffer->physAddr, &bounceBuffer->buf) != kIOReturnSuccess) {
+      IOFree(bounceBuffer, sizeof (OHCIBounceBuffer));
       return NULL;
     }
-    bounceBuffer->map = bounceBuffer->desc->map(kIOMapCopybackCache);
-    if (bounceBuffer->map == NULL) {
-      return NULL;
-    }
-
-    bounceBuffer->buf = (void*) bounceBuffer->map->getVirtualAddress();
+    bounceBuffer->desc = NULL;
   } else {
     bounceBuffer->desc = IOBufferMemoryDescriptor::withOptions(kIOMemoryPhysicallyContiguous, bufferLength, bufferLength);
     if (bounceBuffer->desc == NULL) {
+      IOFree(bounceBuffer, sizeof (OHCIBounceBuffer));
       return NULL;
     }
 
-    bounceBuffer->map      = NULL;
     bounceBuffer->physAddr = bounceBuffer->desc->getPhysicalSegment(0, &length);
     bounceBuffer->buf      = ((IOBufferMemoryDescriptor*) bounceBuffer->desc)->getBytesNoCopy();
   }
@@ -255,6 +268,19 @@ OHCIBounceBuffer *WiiOHCI::allocateBounceBuffer(bool jumbo) {
   return bounceBuffer;
 }
 
+//
+// Frees a bounce buffer, returning its memory to MEM2 or the kernel.
+// Control slots are never freed, they share pages.
+//
+void WiiOHCI::freeBounceBuffer(OHCIBounceBuffer *bounceBuffer) {
+  if (bounceBuffer->desc != NULL) {
+    bounceBuffer->desc->release();
+  } else {
+    _mem2Service->deallocate(_mem2Client, bounceBuffer->physAddr);
+  }
+  IOFree(bounceBuffer, sizeof (OHCIBounceBuffer));
+}
+
 //
 // Gets a free bounce buffer, or allocates ones if needed.
 //
@@ -266,12 +292,14 @@ OHCIBounceBuffer *WiiOHCI::getFreeBounceBuffer(bool jumbo) {
     if (bounceBuffer != NULL) {
       _freeBounceBufferJumboHeadPtr = bounceBuffer->next;
       bounceBuffer->next            = NULL;
+      _freeBounceBufferJumboCount--;
     }
   } else {
     bounceBuffer = _freeBounceBufferHeadPtr;
     if (bounceBuffer != NULL) {
       _freeBounceBufferHeadPtr = bounceBuffer->next;
       bounceBuffer->next       = NULL;
+      _freeBounceBufferCount--;
     }
   }
 
@@ -283,14 +311,155 @@ OHCIBounceBuffer *WiiOHCI::getFreeBounceBuffer(bool jumbo) {
 }
 
 //
-// Returns a bounce buffer to the free list.
+// Allocates a page of control transfer slots and adds them to the free list.
+//
+IOReturn WiiOHCI::allocateControlSlots(void) {
+  OHCIBounceBuffer          *slots;
+  IOBufferMemoryDescriptor  *desc;
+  IOPhysicalAddress         physAddr;
+  IOByteCount               length;
+  UInt8                     *buf;
+
+  slots = (OHCIBounceBuffer *) IOMalloc(sizeof (OHCIBounceBuffer) * (PAGE_SIZE / kWiiOHCIControlSlotSize));
+  if (slots == NULL) {
+    return kIOReturnNoMemory;
+  }
+
+  //
+  // Same placement rules as regular bounce buffers.
+  //
+  if (_mem2Client != NULL) {
+    if (_mem2Service->allocate(_mem2Client, PAGE_SIZE, kWiiMem2CacheModeCopyback,
+                               &physAddr, (void **) &buf) != kIOReturnSuccess) {
+      IOFree(slots, sizeof (OHCIBounceBuffer) * (PAGE_SIZE / kWiiOHCIControlSlotSize));
+      return kIOReturnNoMemory;
+    }
+    desc = NULL;
+  } else {
+    desc = IOBufferMemoryDescriptor::withOptions(kIOMemoryPhysicallyContiguous, PAGE_SIZE, PAGE_SIZE);
+    if (desc == NULL) {
+      IOFree(slots, sizeof (OHCIBounceBuffer) * (PAGE_SIZE / kWiiOHCIControlSlotSize));
+      return kIOReturnNoMemory;
+    }
+
+    physAddr = desc->getPhysicalSegment(0, &length);
+    buf      = (UInt8 *) desc->getBytesNoCopy();
+    if ((physAddr == 0) || (length < PAGE_SIZE) || (buf == NULL)) {
+      desc->release();
+      IOFree(slots, sizeof (OHCIBounceBuffer) * (PAGE_SIZE / kWiiOHCIControlSlotSize));
+      return kIOReturnNoMemory;
+    }
+  }
+
+  for (UInt32 i = 0; i < (PAGE_SIZE / kWiiOHCIControlSlotSize); i++) {
+    slots[i].jumbo       = false;
+    slots[i].controlSlot = true;
+    slots[i].desc        = (i == 0) ? desc : NULL;
+    slots[i].physAddr    = physAddr + (i * kWiiOHCIControlSlotSize);
+    slots[i].buf         = buf + (i * kWiiOHCIControlSlotSize);
+    slots[i].next        = _freeControlSlotHeadPtr;
+    _freeControlSlotHeadPtr = &slots[i];
+  }
+
+  return kIOReturnSuccess;
+}
+
+//
+// Gets a free control transfer slot, or allocates more if needed.
+//
+OHCIBounceBuffer *WiiOHCI::getFreeControlSlot(void) {
+  OHCIBounceBuffer  *slot;
+
+  if (_freeControlSlotHeadPtr == NULL) {
+    if (allocateControlSlots() != kIOReturnSuccess) {
+      return NULL;
+    }
+  }
+
+  slot                    = _freeControlSlotHeadPtr;
+  _freeControlSlotHeadPtr = slot->next;
+  slot->next              = NULL;
+  return slot;
+}
+
+//
+// Returns a bounce buffer to the free list, or frees it if the free list already holds the initial count.
 //
 void WiiOHCI::returnBounceBuffer(OHCIBounceBuffer *bounceBuffer) {
-  if (bounceBuffer->jumbo) {
+  if (bounceBuffer->controlSlot) {
+    bounceBuffer->next      = _freeControlSlotHeadPtr;
+    _freeControlSlotHeadPtr = bounceBuffer;
+  } else if (bounceBuffer->jumbo) {
+    if (_freeBounceBufferJumboCount >= kWiiOHCIBounceBufferJumboInitialCount) {
+      freeBounceBuffer(bounceBuffer);
+      return;
+    }
     bounceBuffer->next = _freeBounceBufferJumboHeadPtr;
     _freeBounceBufferJumboHeadPtr = bounceBuffer;
+    _freeBounceBufferJumboCount++;
   } else {
+    if (_freeBounceBufferCount >= kWiiOHCIBounceBufferInitialCount) {
+      freeBounceBuffer(bounceBuffer);
+      return;
+    }
     bounceBuffer->next = _freeBounceBufferHeadPtr;
     _freeBounceBufferHeadPtr = bounceBuffer;
+    _freeBounceBufferCount++;
+  }
+}
+
+//
+// Moves outbound data into a bounce buffer with the locked cache DMA engine, through the scratchpad stage.
+// Returns false if the data cannot be moved this way, the caller then copies it through the data cache.
+//
+bool WiiOHCI::moveToBounceBuffer(IOMemoryDescriptor *srcBuffer, OHCIBounceBuffer *bounceBuffer, UInt32 length) {
+  IOPhysicalAddress     physAddr;
+  IOByteCount           segmentLength;
+  UInt32                offset;
+  WiiLockedCacheTicket  ticket;
+
+  if ((_lockedCacheStage == NULL) || (length == 0) || (length > kWiiOHCILockedCacheStageSize)
+      || ((length % kWiiLockedCacheLineSize) != 0) || ((bounceBuffer->physAddr % kWiiLockedCacheLineSize) != 0)) {
+    return false;
+  }
+
+  //
+  // Every physical segment must start on a cache line.
+  // Segments otherwise end on page boundaries, so with a whole number of lines they also end on a cache line.
+  //
+  offset = 0;
+  while (offset < length) {
+    physAddr = srcBuffer->getPhysicalSegment(offset, &segmentLength);
+    if ((physAddr == 0) || (segmentLength == 0) || ((physAddr % kWiiLockedCacheLineSize) != 0)) {
+      return false;
+    }
+    offset += segmentLength;
+  }
+
+  //
+  // Load each segment into the stage, then store the stage into the bounce buffer.
+  // DMA runs in submission order, the store ticket completes only once all of it is done.
+  //
+  offset = 0;
+  while (offset < length) {
+    physAddr = srcBuffer->getPhysicalSegment(offset, &segmentLength);
+    if (segmentLength > (length - offset)) {
+      segmentLength = length - offset;
+    }
+
+    if (_lockedCacheService->load(((UInt8 *) _lockedCacheStage) + offset, physAddr, segmentLength, &ticket) != kIOReturnSuccess) {
+      if (offset != 0) {
+        _lockedCacheService->wait(ticket);
+      }
+      return false;
+    }
+    offset += segmentLength;
+  }
+
+  if (_lockedCacheService->store(_lockedCacheStage, bounceBuffer->physAddr, length, &ticket) != kIOReturnSuccess) {
+    _lockedCacheService->wait(ticket);
+    return false;
   }
+  _lockedCacheService->wait(ticket);
+  return true;
 }
@@ -0,0 +1,344 @@
+//
+//  WiiOHCI_BulkStream.cpp
+//  Wii OHCI USB controller interface
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "WiiOHCI.hpp"
+
+//
+// Completion action for streaming ring transfers.
+//
+void WiiOHCI::bulkStreamCompletionAction(void *target, void *parameter, IOReturn status, UInt32 bufferSizeRemaining) {
+  ((WiiOHCI *) target)->completeBulkStreamTransfer((OHCITransferData *) parameter, status, bufferSizeRemaining);
+}
+
+//
+// Creates the streaming ring for a bulk IN endpoint.
+// The ring is started by the first client request.
+//
+bool WiiOHCI::createBulkStream(OHCIEndpointData *endpoint) {
+  OHCIBulkStream *stream;
+
+  stream = (OHCIBulkStream *) IOMalloc(sizeof (OHCIBulkStream));
+  if (stream == NULL) {
+    return false;
+  }
+  bzero(stream, sizeof (*stream));
+
+  for (UInt32 i = 0; i < kOHCIBulkStreamBufferCount; i++) {
+    stream->freeBuffers[i] = getFreeBounceBuffer(true);
+    if (stream->freeBuffers[i] == NULL) {
+      for (UInt32 j = 0; j < i; j++) {
+        returnBounceBuffer(stream->freeBuffers[j]);
+      }
+      IOFree(stream, sizeof (OHCIBulkStream));
+      return false;
+    }
+  }
+  stream->freeCount = kOHCIBulkStreamBufferCount;
+
+  endpoint->stream = stream;
+  return true;
+}
+
+//
+// Destroys the streaming ring of a deleted endpoint.
+// All ring transfers must have already been removed from the endpoint.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiOHCI::destroyBulkStream(OHCIEndpointData *endpoint) {
+  OHCIBulkStream *stream;
+
+  abortBulkStream(endpoint);
+
+  //
+  // Received data that was never read is discarded with the endpoint.
+  //
+  stream = endpoint->stream;
+  while (stream->dataCount > 0) {
+    stream->freeBuffers[stream->freeCount++] = stream->data[stream->dataHead].bounceBuffer;
+    stream->dataHead = (stream->dataHead + 1) % kOHCIBulkStreamBufferCount;
+    stream->dataCount--;
+  }
+
+  for (UInt32 i = 0; i < stream->freeCount; i++) {
+    returnBounceBuffer(stream->freeBuffers[i]);
+  }
+  if (stream->freeCount != kOHCIBulkStreamBufferCount) {
+    WIISYSLOG("Streaming ring on EP phys 0x%X still has %u buffers queued", endpoint->physAddr, kOHCIBulkStreamBufferCount - stream->freeCount);
+  }
+
+  IOFree(stream, sizeof (OHCIBulkStream));
+  endpoint->stream = NULL;
+}
+
+//
+// Stops the streaming ring and completes all client requests as aborted.
+// Queued ring transfers are returned as they are removed from the endpoint.
+//
+// Data already received was prefetched before any client asked for it, and the device will not send it again.
+// It is kept for the next read. Errors are dropped, the abort or stall clear resets the condition they reported.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiOHCI::abortBulkStream(OHCIEndpointData *endpoint) {
+  OHCIBulkStream        *stream;
+  OHCIBulkStreamRequest request;
+  UInt32                dataCount;
+  UInt32                dataIndex;
+
+  stream          = endpoint->stream;
+  stream->started = false;
+
+  dataCount         = stream->dataCount;
+  stream->dataCount = 0;
+  for (UInt32 i = 0; i < dataCount; i++) {
+    dataIndex = (stream->dataHead + i) % kOHCIBulkStreamBufferCount;
+    if ((stream->data[dataIndex].status != kIOReturnSuccess) || (stream->data[dataIndex].offset == stream->data[dataIndex].actualSize)) {
+      stream->freeBuffers[stream->freeCount++] = stream->data[dataIndex].bounceBuffer;
+      continue;
+    }
+    stream->data[(stream->dataHead + stream->dataCount) % kOHCIBulkStreamBufferCount] = stream->data[dataIndex];
+    stream->dataCount++;
+  }
+
+  //
+  // Requests are removed before completion, clients may queue new ones from the completion.
+  //
+  while (stream->requestCount > 0) {
+    request = stream->requests[stream->requestHead];
+    stream->requestHead = (stream->requestHead + 1) % kOHCIBulkStreamRequestCount;
+    stream->requestCount--;
+
+    request.buffer->release();
+    Complete(request.completion, kIOReturnAborted, request.bufferSize - request.actualSize);
+  }
+}
+
+//
+// Queues a client bulk IN request to be filled from the streaming ring.
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiOHCI::queueBulkStreamRequest(OHCIEndpointData *endpoint, IOUSBCompletion completion,
+                                         IOMemoryDescriptor *buffer, UInt32 bufferSize, bool bufferRounding) {
+  OHCIBulkStream        *stream;
+  OHCIBulkStreamRequest *request;
+
+  //
+  // A halted endpoint with no error left to hand out will not receive anything until cleared.
+  //
+  stream = endpoint->stream;
+  if ((USBToHostLong(endpoint->ed->headTDPhysAddr) & kOHCIEDTDHeadHalted) && (stream->dataCount == 0)) {
+    WIISYSLOG("Pipe is stalled (EP Flags: 0x%X)", USBToHostLong(endpoint->ed->flags));
+    return kIOUSBPipeStalled;
+  }
+
+  if (stream->requestCount >= kOHCIBulkStreamRequestCount) {
+    WIISYSLOG("Too many streaming requests on EP phys 0x%X", endpoint->physAddr);
+    return kIOReturnNoResources;
+  }
+
+  request = &stream->requests[(stream->requestHead + stream->requestCount) % kOHCIBulkStreamRequestCount];
+  request->completion     = completion;
+  request->buffer         = buffer;
+  request->bufferSize     = bufferSize;
+  request->actualSize     = 0;
+  request->bufferRounding = bufferRounding;
+  buffer->retain();
+  stream->requestCount++;
+
+  stream->started = true;
+  serviceBulkStream(endpoint);
+  return kIOReturnSuccess;
+}
+
+//
+// Queues a ring transfer using the specified bounce buffer.
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiOHCI::queueBulkStreamTransfer(OHCIEndpointData *endpoint, OHCIBounceBuffer *bounceBuffer) {
+  OHCITransferData  *transferCurr;
+  OHCITransferData  *transferTail;
+  UInt32            flags;
+
+  transferTail = getFreeTransfer(endpoint);
+  if (transferTail == NULL) {
+    return kIOReturnNoMemory;
+  }
+  transferCurr = endpoint->transferTail;
+
+  //
+  // Ring transfers are always jumbo sized, a multiple of any full speed bulk packet size.
+  // Buffer rounding lets a short packet end the transfer without halting the endpoint.
+  //
+  flags = kOHCIGenTDFlagsDirectionIn | kOHCIGenTDFlagsBufferRounding
+    | ((kOHCITDConditionCodeNotAccessed << kOHCIGenTDFlagsConditionCodeShift) & kOHCIGenTDFlagsConditionCodeMask);
+
+  transferCurr->genTD->flags                    = HostToUSBLong(flags);
+  transferCurr->genTD->currentBufferPtrPhysAddr = HostToUSBLong(bounceBuffer->physAddr);
+  transferCurr->genTD->bufferEndPhysAddr        = HostToUSBLong(bounceBuffer->physAddr + kWiiOHCIBounceBufferJumboSize - 1);
+  transferCurr->genTD->nextTDPhysAddr           = HostToUSBLong(transferTail->physAddr);
+  transferCurr->bounceBuffer                    = bounceBuffer;
+  transferCurr->actualBufferSize                = kWiiOHCIBounceBufferJumboSize;
+  transferCurr->srcBuffer                       = NULL;
+  transferCurr->genCompletion.target            = this;
+  transferCurr->genCompletion.action            = &WiiOHCI::bulkStreamCompletionAction;
+  transferCurr->genCompletion.parameter         = transferCurr;
+  transferCurr->genSubmitTimebase               = getProcessorTimebase();
+  transferCurr->traceId                         = getTraceId();
+  transferCurr->traceLength                     = kWiiOHCIBounceBufferJumboSize;
+  transferCurr->nextTransfer                    = transferTail;
+  transferCurr->last                            = true;
+
+  _invalidateCacheFunc((vm_offset_t) bounceBuffer->buf, kWiiOHCIBounceBufferJumboSize, false);
+  flushTransferDescriptor(transferCurr);
+
+  endpoint->transferTail       = transferTail;
+  endpoint->ed->tailTDPhysAddr = HostToUSBLong(transferTail->physAddr);
+  writeReg32(kOHCIRegCmdStatus, kOHCIRegCmdStatusBulkListFilled);
+
+  traceEvent(kWiiOHCITraceEventSubmit, endpoint, transferCurr->traceId, kWiiOHCIBounceBufferJumboSize);
+  return kIOReturnSuccess;
+}
+
+//
+// Handles completion of a ring transfer, called from the normal transfer completion paths.
+// The bounce buffer is taken back from the transfer before it is returned.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiOHCI::completeBulkStreamTransfer(OHCITransferData *transfer, IOReturn status, UInt32 bufferSizeRemaining) {
+  OHCIEndpointData    *endpoint;
+  OHCIBulkStream      *stream;
+  OHCIBulkStreamData  *data;
+  OHCIBounceBuffer    *bounceBuffer;
+
+  endpoint               = transfer->endpoint;
+  stream                 = endpoint->stream;
+  bounceBuffer           = transfer->bounceBuffer;
+  transfer->bounceBuffer = NULL;
+
+  //
+  // Ring was already destroyed, the transfer came off the done queue after the endpoint was retired.
+  //
+  if (stream == NULL) {
+    returnBounceBuffer(bounceBuffer);
+    return;
+  }
+
+  //
+  // Aborted transfers may have received part of their buffer before being removed, that is kept for the next read.
+  // The transfer was cut short, not ended by the device.
+  //
+  if ((status == kIOReturnAborted) && (bufferSizeRemaining >= kWiiOHCIBounceBufferJumboSize)) {
+    stream->freeBuffers[stream->freeCount++] = bounceBuffer;
+    return;
+  }
+
+  data = &stream->data[(stream->dataHead + stream->dataCount) % kOHCIBulkStreamBufferCount];
+  data->bounceBuffer = bounceBuffer;
+  data->actualSize   = kWiiOHCIBounceBufferJumboSize - bufferSizeRemaining;
+  data->offset       = 0;
+  data->shortPacket  = (bufferSizeRemaining > 0) && (status != kIOReturnAborted);
+  data->status       = ((status == kIOReturnUnderrun) || (status == kIOReturnAborted)) ? kIOReturnSuccess : status;
+  stream->dataCount++;
+
+  _invalidateCacheFunc((vm_offset_t) bounceBuffer->buf, data->actualSize, false);
+
+  //
+  // Endpoints being deleted are not refilled, the ring is destroyed once all transfers are removed.
+  //
+  if (endpoint->headEndpoint != NULL) {
+    serviceBulkStream(endpoint);
+  }
+}
+
+//
+// Fills client requests from received data, and queues free buffers back to the controller.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiOHCI::serviceBulkStream(OHCIEndpointData *endpoint) {
+  OHCIBulkStream        *stream;
+  OHCIBulkStreamData    *data;
+  OHCIBulkStreamRequest *request;
+  OHCIBulkStreamRequest completedRequest;
+  IOReturn              completedStatus;
+  UInt32                copySize;
+  bool                  requestDone;
+
+  stream = endpoint->stream;
+
+  while ((stream->requestCount > 0) && (stream->dataCount > 0)) {
+    request = &stream->requests[stream->requestHead];
+    data    = &stream->data[stream->dataHead];
+
+    //
+    // Errors complete the current request after any data received before them.
+    //
+    if (data->status != kIOReturnSuccess) {
+      completedStatus = data->status;
+      requestDone     = true;
+    } else {
+      copySize = request->bufferSize - request->actualSize;
+      if (copySize > (data->actualSize - data->offset)) {
+        copySize = data->actualSize - data->offset;
+      }
+      if (copySize > 0) {
+        request->buffer->writeBytes(request->actualSize, (UInt8 *) data->bounceBuffer->buf + data->offset, copySize);
+        request->actualSize += copySize;
+        data->offset        += copySize;
+      }
+
+      //
+      // Requests end when full, or when the data that ended with a short packet is used up.
+      //
+      requestDone = (request->actualSize == request->bufferSize);
+      if ((data->offset == data->actualSize) && data->shortPacket) {
+        requestDone = true;
+      }
+
+      completedStatus = kIOReturnSuccess;
+      if ((request->actualSize < request->bufferSize) && !request->bufferRounding) {
+        completedStatus = kIOReturnUnderrun;
+      }
+    }
+
+    if ((data->offset == data->actualSize) || (data->status != kIOReturnSuccess)) {
+      stream->freeBuffers[stream->freeCount++] = data->bounceBuffer;
+      stream->dataHead = (stream->dataHead + 1) % kOHCIBulkStreamBufferCount;
+      stream->dataCount--;
+    }
+
+    //
+    // Requests are removed before completion, clients may queue new ones from the completion.
+    //
+    if (requestDone) {
+      completedRequest    = *request;
+      stream->requestHead = (stream->requestHead + 1) % kOHCIBulkStreamRequestCount;
+      stream->requestCount--;
+
+      completedRequest.buffer->release();
+      Complete(completedRequest.completion, completedStatus, completedRequest.bufferSize - completedRequest.actualSize);
+    }
+  }
+
+  //
+  // Keep every free buffer queued to the controller while the ring is running.
+  // Nothing is queued while retire operations are pending, those still need to find the end of the queue.
+  //
+  if (!stream->started || (endpoint->retireFlags != 0)) {
+    return;
+  }
+  while (stream->freeCount > 0) {
+    if (queueBulkStreamTransfer(endpoint, stream->freeBuffers[stream->freeCount - 1]) != kIOReturnSuccess) {
+      break;
+    }
+    stream->freeCount--;
+  }
+}
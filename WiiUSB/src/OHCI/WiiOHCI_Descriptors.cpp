@@ -11,7 +11,7 @@
 // Converts the status of a transfer descriptor to I/O Kit status.
 //
 IOReturn WiiOHCI::convertTDStatus(UInt8 ohciStatus) {
-  static const UInt32 statusToErrorMap[] = {
+  static const IOReturn statusToErrorMap[] = {
     kIOReturnSuccess,
     kIOUSBCRCErr,
     kIOUSBBitstufErr,
@@ -108,7 +108,7 @@ IOReturn WiiOHCI::allocateFreeTransfers(bool isochronous) {
   WiiOHCITransferBuffer *transferBuffer;
   OHCITransferData      *transfer;
 
-  transferBuffer = WiiOHCITransferBuffer::transferBuffer(isochronous);
+  transferBuffer = WiiOHCITransferBuffer::transferBuffer(isochronous, _transfersCached);
   if (transferBuffer == NULL) {
     return kIOReturnNoMemory;
   }
@@ -118,7 +118,7 @@ IOReturn WiiOHCI::allocateFreeTransfers(bool isochronous) {
   //
   // Add the endpoints to the free list.
   //
-  for (UInt32 i = 0; i < (isochronous ? kWiiOHCIIsoTransfersPerBuffer : kWiiOHCIGenTransfersPerBuffer); i++) {
+  for (UInt32 i = 0; i < transferBuffer->getTransferCount(); i++) {
     transfer = transferBuffer->getTransfer(i);
 
     if (isochronous) {
@@ -191,9 +191,12 @@ OHCITransferData *WiiOHCI::getFreeTransfer(OHCIEndpointData *endpoint) {
   } else {
     transfer->genTD->nextTDPhysAddr = 0;
   }
+  flushTransferDescriptor(transfer);
 
   transfer->bounceBuffer       = NULL;
   transfer->endpoint           = endpoint;
+  transfer->traceId            = 0;
+  transfer->traceLength        = 0;
 
   return transfer;
 }
@@ -372,6 +375,8 @@ IOReturn WiiOHCI::initInterruptEndpoints(void) {
     _interruptEndpoints[i].headEndpoint->ed->flags          = HostToUSBLong(kOHCIEDFlagsSkip);
     _interruptEndpoints[i].headEndpoint->ed->nextEDPhysAddr = HostToUSBLong(0);
     _interruptEndpoints[i].headEndpoint->nextEndpoint       = NULL;
+    _interruptEndpoints[i].parentNode                       = kWiiOHCIInterruptNodeNone;
+    _interruptEndpoints[i].bandwidth                        = 0;
 
     //
     // First 32 will be static heads in the HCCA.
@@ -407,6 +412,7 @@ IOReturn WiiOHCI::initInterruptEndpoints(void) {
     _interruptEndpoints[i].headEndpoint->ed->nextEDPhysAddr = HostToUSBLong(_interruptEndpoints[z].headEndpoint->physAddr);
     _interruptEndpoints[i].headEndpoint->nextEndpoint       = _interruptEndpoints[z].headEndpoint;
     _interruptEndpoints[i].tailEndpoint                     = _interruptEndpoints[i].headEndpoint->nextEndpoint;
+    _interruptEndpoints[i].parentNode                       = z;
   }
 
   //
@@ -420,175 +426,392 @@ IOReturn WiiOHCI::initInterruptEndpoints(void) {
 }
 
 //
-// Gets the endpoint data for the specified function/endpoint.
+// Inserts an endpoint into the lookup table.
 //
-OHCIEndpointData *WiiOHCI::getEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt8 direction,
-                                       UInt8 *type, OHCIEndpointData **outPrevEndpoint) {
-  OHCIEndpointData  *currEndpoint;
-  OHCIEndpointData  *prevEndpoint;
-  UInt32            endpointId;
+bool WiiOHCI::insertEndpointHash(OHCIEndpointData *endpoint) {
+  UInt32 index;
+
+  if (_endpointHashCount >= kWiiOHCIEndpointHashMaxCount) {
+    WIISYSLOG("Endpoint lookup table is full");
+    return false;
+  }
 
   //
-  // Search for control endpoint.
+  // Linear probe for the next empty slot.
   //
-  if (*type & kWiiOHCIEndpointTypeControl) {
-    endpointId = (functionNumber & kOHCIEDFlagsFuncMask) | (((UInt32)endpointNumber << kOHCIEDFlagsEndpointShift) & kOHCIEDFlagsEndpointMask);
+  index = getEndpointHashIndex(endpoint->key);
+  while (_endpointHashTable[index] != NULL) {
+    index = (index + 1) & (kWiiOHCIEndpointHashSize - 1);
+  }
 
-    prevEndpoint = _controlEndpointHeadPtr;
-    currEndpoint = prevEndpoint->nextEndpoint;
-    while (currEndpoint != _controlEndpointTailPtr) {
-      //
-      // Check if current endpoint matches.
-      //
-      if ((USBToHostLong(currEndpoint->ed->flags) & (kOHCIEDFlagsFuncMask | kOHCIEDFlagsEndpointMask)) == endpointId) {
-        *type = kWiiOHCIEndpointTypeControl;
-        if (outPrevEndpoint != NULL) {
-          *outPrevEndpoint = prevEndpoint;
-        }
-        return currEndpoint;
-      }
+  _endpointHashTable[index] = endpoint;
+  _endpointHashCount++;
+  return true;
+}
+
+//
+// Removes an endpoint from the lookup table.
+//
+void WiiOHCI::removeEndpointHash(OHCIEndpointData *endpoint) {
+  UInt32 index;
+  UInt32 nextIndex;
+  UInt32 homeIndex;
 
-      prevEndpoint = currEndpoint;
-      currEndpoint = prevEndpoint->nextEndpoint;
+  //
+  // Locate the endpoint.
+  //
+  index = getEndpointHashIndex(endpoint->key);
+  while (_endpointHashTable[index] != endpoint) {
+    if (_endpointHashTable[index] == NULL) {
+      return;
     }
+    index = (index + 1) & (kWiiOHCIEndpointHashSize - 1);
   }
+  _endpointHashTable[index] = NULL;
+  _endpointHashCount--;
 
   //
-  // Search for bulk endpoint.
+  // Shift back any following entries in the probe sequence so lookups do not stop early at the new hole.
+  // An entry can only move into the hole if its home slot is not between the hole and its current slot.
   //
-  if (*type & kWiiOHCIEndpointTypeBulk) {
-    endpointId = (functionNumber & kOHCIEDFlagsFuncMask) | (((UInt32)endpointNumber << kOHCIEDFlagsEndpointShift) & kOHCIEDFlagsEndpointMask);
-    if (direction == kUSBOut) {
-      endpointId |= kOHCIEDFlagsDirectionOut;
-    } else if (direction == kUSBIn) {
-      endpointId |= kOHCIEDFlagsDirectionIn;
-    } else {
-      endpointId |= kOHCIEDFlagsDirectionTD;
+  nextIndex = (index + 1) & (kWiiOHCIEndpointHashSize - 1);
+  while (_endpointHashTable[nextIndex] != NULL) {
+    homeIndex = getEndpointHashIndex(_endpointHashTable[nextIndex]->key);
+    if (((nextIndex - homeIndex) & (kWiiOHCIEndpointHashSize - 1)) >= ((nextIndex - index) & (kWiiOHCIEndpointHashSize - 1))) {
+      _endpointHashTable[index]     = _endpointHashTable[nextIndex];
+      _endpointHashTable[nextIndex] = NULL;
+      index = nextIndex;
     }
+    nextIndex = (nextIndex + 1) & (kWiiOHCIEndpointHashSize - 1);
+  }
+}
 
-    prevEndpoint = _bulkEndpointHeadPtr;
-    currEndpoint = prevEndpoint->nextEndpoint;
-    while (currEndpoint != _bulkEndpointTailPtr) {
-      //
-      // Check if current endpoint matches.
-      //
-      if ((USBToHostLong(currEndpoint->ed->flags) & (kOHCIEDFlagsFuncMask | kOHCIEDFlagsEndpointMask | kOHCIEDFlagsDirectionMask)) == endpointId) {
-        *type = kWiiOHCIEndpointTypeBulk;
-        if (outPrevEndpoint != NULL) {
-          *outPrevEndpoint = prevEndpoint;
-        }
-        return currEndpoint;
-      }
+//
+// Finds an endpoint of the specified types in the lookup table.
+//
+OHCIEndpointData *WiiOHCI::findEndpointHash(UInt16 key, UInt8 typeMask) {
+  OHCIEndpointData  *endpoint;
+  UInt32            index;
 
-      prevEndpoint = currEndpoint;
-      currEndpoint = prevEndpoint->nextEndpoint;
+  index    = getEndpointHashIndex(key);
+  endpoint = _endpointHashTable[index];
+  while (endpoint != NULL) {
+    if ((endpoint->key == key) && (endpoint->type & typeMask)) {
+      return endpoint;
     }
+
+    index    = (index + 1) & (kWiiOHCIEndpointHashSize - 1);
+    endpoint = _endpointHashTable[index];
   }
 
+  return NULL;
+}
+
+//
+// Gets the endpoint data for the specified function/endpoint.
+//
+OHCIEndpointData *WiiOHCI::getEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt8 direction,
+                                       UInt8 *type, OHCIEndpointData **outPrevEndpoint) {
+  OHCIEndpointData  *endpoint;
+  OHCIEndpointData  *prevEndpoint;
+
   //
-  // Search for isochronous endpoint.
+  // Control endpoints are bidirectional and do not use the direction.
   //
-  if (*type & kWiiOHCIEndpointTypeIsochronous) {
-    endpointId = (functionNumber & kOHCIEDFlagsFuncMask) | (((UInt32)endpointNumber << kOHCIEDFlagsEndpointShift) & kOHCIEDFlagsEndpointMask);
-    if (direction == kUSBOut) {
-      endpointId |= kOHCIEDFlagsDirectionOut;
-    } else if (direction == kUSBIn) {
-      endpointId |= kOHCIEDFlagsDirectionIn;
-    } else {
-      endpointId |= kOHCIEDFlagsDirectionTD;
-    }
+  endpoint = NULL;
+  if (*type & kWiiOHCIEndpointTypeControl) {
+    endpoint = findEndpointHash(getEndpointKey(functionNumber, endpointNumber, kUSBAnyDirn), kWiiOHCIEndpointTypeControl);
+  }
+  if ((endpoint == NULL) && (*type & ~(kWiiOHCIEndpointTypeControl))) {
+    endpoint = findEndpointHash(getEndpointKey(functionNumber, endpointNumber, direction), *type & ~(kWiiOHCIEndpointTypeControl));
+  }
 
-    prevEndpoint = _isoEndpointHeadPtr;
-    currEndpoint = prevEndpoint->nextEndpoint;
-    while (currEndpoint != _isoEndpointTailPtr) {
-      //
-      // Check if current endpoint matches.
-      //
-      if ((USBToHostLong(currEndpoint->ed->flags) & (kOHCIEDFlagsFuncMask | kOHCIEDFlagsEndpointMask | kOHCIEDFlagsDirectionMask)) == endpointId) {
-        *type = kWiiOHCIEndpointTypeIsochronous;
-        if (outPrevEndpoint != NULL) {
-          *outPrevEndpoint = prevEndpoint;
-        }
-        return currEndpoint;
-      }
+  if (endpoint == NULL) {
+    return NULL;
+  }
+  *type = endpoint->type;
 
-      prevEndpoint = currEndpoint;
-      currEndpoint = prevEndpoint->nextEndpoint;
+  //
+  // Locate the previous endpoint if requested.
+  // Only the list the endpoint is linked into needs to be walked.
+  //
+  if (outPrevEndpoint != NULL) {
+    prevEndpoint = endpoint->headEndpoint;
+    while (prevEndpoint->nextEndpoint != endpoint) {
+      prevEndpoint = prevEndpoint->nextEndpoint;
     }
+    *outPrevEndpoint = prevEndpoint;
   }
 
+  return endpoint;
+}
+
+//
+// Gets the interrupt bandwidth used in the frames serviced by a 32ms leaf node.
+// If a node is specified, only frames that also pass through that node are counted.
+//
+UInt32 WiiOHCI::getInterruptFrameLoad(UInt8 leafNode, UInt8 throughNode) {
+  UInt32  load;
+  UInt8   node;
+  bool    passesThrough;
+
+  load          = 0;
+  passesThrough = (throughNode == kWiiOHCIInterruptNodeNone);
+
   //
-  // Search for interrupt endpoint.
+  // Walk from the leaf to the 1ms node.
   //
-  if (*type & kWiiOHCIEndpointTypeInterrupt) {
-    endpointId = (functionNumber & kOHCIEDFlagsFuncMask) | (((UInt32)endpointNumber << kOHCIEDFlagsEndpointShift) & kOHCIEDFlagsEndpointMask);
-    if (direction == kUSBOut) {
-      endpointId |= kOHCIEDFlagsDirectionOut;
-    } else if (direction == kUSBIn) {
-      endpointId |= kOHCIEDFlagsDirectionIn;
-    } else {
-      endpointId |= kOHCIEDFlagsDirectionTD;
+  node = leafNode;
+  while (node != kWiiOHCIInterruptNodeNone) {
+    load += _interruptEndpoints[node].bandwidth;
+    if (node == throughNode) {
+      passesThrough = true;
     }
+    node = _interruptEndpoints[node].parentNode;
+  }
 
-    for (unsigned int i = 0; i < ARRSIZE(_interruptEndpoints); i++) {
-      currEndpoint = _interruptEndpoints[i].headEndpoint->nextEndpoint;
-      prevEndpoint = _interruptEndpoints[i].headEndpoint;
-
-      while (currEndpoint != _interruptEndpoints[i].tailEndpoint) {
-        if ((USBToHostLong(currEndpoint->ed->flags) & (kOHCIEDFlagsFuncMask | kOHCIEDFlagsEndpointMask | kOHCIEDFlagsDirectionMask)) == endpointId) {
-          *type = kWiiOHCIEndpointTypeInterrupt;
-          if (outPrevEndpoint != NULL) {
-            *outPrevEndpoint = prevEndpoint;
-          }
-          return currEndpoint;
-        }
+  return passesThrough ? load : 0;
+}
 
-        prevEndpoint = currEndpoint;
-        currEndpoint = currEndpoint->nextEndpoint;
-      }
+//
+// Gets the highest interrupt bandwidth used in any frame.
+// If a node is specified, only frames that pass through that node are counted.
+//
+UInt32 WiiOHCI::getInterruptPeakLoad(UInt8 throughNode) {
+  UInt32 load;
+  UInt32 peakLoad;
+
+  peakLoad = 0;
+  for (UInt8 i = 0; i < kWiiOHCIInterruptLeafCount; i++) {
+    load = getInterruptFrameLoad(i, throughNode);
+    if (load > peakLoad) {
+      peakLoad = load;
     }
   }
 
-  return NULL;
+  return peakLoad;
 }
 
 //
-// Gets an interrupt endpoint head for the specified polling rate.
+// Gets the bandwidth reserved per frame by isochronous endpoints.
 //
-OHCIEndpointData *WiiOHCI::getInterruptEndpointHead(UInt8 pollingRate) {
-  UInt16 frameNumber;
+UInt32 WiiOHCI::getIsoBandwidthReserved(void) {
+  return kUSBMaxFSIsocEndpointReqCount - _isoBandwidthAvailable;
+}
 
-  //
-  // Get frame number for randomness.
-  //
-  frameNumber = (UInt16)(readReg32(kOHCIRegFmNumber) & kOHCIRegFmNumberMask);
+//
+// Gets the least loaded interrupt node for the specified polling rate.
+//
+// Returns kWiiOHCIInterruptNodeNone if the endpoint would exceed the periodic budget in every candidate node.
+//
+UInt8 WiiOHCI::getInterruptNode(UInt8 pollingRate, UInt32 bandwidth) {
+  UInt8   firstNode;
+  UInt8   nodeCount;
+  UInt8   bestNode;
+  UInt32  bestLoad;
+  UInt32  load;
 
   if (pollingRate < 1) {
-    return NULL;
+    return kWiiOHCIInterruptNodeNone;
   } else if (pollingRate < 2) {
-    return _interruptEndpoints[62].headEndpoint; // 1ms.
+    firstNode = 62; // 1ms.
+    nodeCount = 1;
   } else if (pollingRate < 4) {
-    return _interruptEndpoints[60 + (frameNumber % 2)].headEndpoint; // 2ms.
+    firstNode = 60; // 2ms.
+    nodeCount = 2;
   } else if (pollingRate < 8) {
-    return _interruptEndpoints[56 + (frameNumber % 4)].headEndpoint; // 4ms.
+    firstNode = 56; // 4ms.
+    nodeCount = 4;
   } else if (pollingRate < 16) {
-    return _interruptEndpoints[48 + (frameNumber % 8)].headEndpoint; // 8ms.
+    firstNode = 48; // 8ms.
+    nodeCount = 8;
   } else if (pollingRate < 32) {
-    return _interruptEndpoints[32 + (frameNumber % 16)].headEndpoint; // 16ms.
+    firstNode = 32; // 16ms.
+    nodeCount = 16;
   } else {
-    return _interruptEndpoints[frameNumber % 32].headEndpoint; // 32ms.
+    firstNode = 0;  // 32ms.
+    nodeCount = 32;
+  }
+
+  //
+  // Pick the node whose busiest frame is the least loaded.
+  //
+  bestNode = kWiiOHCIInterruptNodeNone;
+  bestLoad = 0;
+  for (UInt8 i = firstNode; i < (firstNode + nodeCount); i++) {
+    load = getInterruptPeakLoad(i);
+    if ((bestNode == kWiiOHCIInterruptNodeNone) || (load < bestLoad)) {
+      bestNode = i;
+      bestLoad = load;
+    }
+  }
+
+  //
+  // Admission control against the periodic budget, isochronous reservations are in every frame.
+  //
+  if ((bestLoad + bandwidth + getIsoBandwidthReserved()) > kWiiOHCIPeriodicBandwidthBudget) {
+    WIISYSLOG("No periodic bandwidth for %u bytes, peak load: %u, iso reserved: %u", bandwidth, bestLoad, getIsoBandwidthReserved());
+    return kWiiOHCIInterruptNodeNone;
+  }
+
+  return bestNode;
+}
+
+//
+// Publishes the interrupt bandwidth used in each of the 32 frames.
+//
+void WiiOHCI::publishInterruptLoadMap(void) {
+  OSArray   *loadMap;
+  OSNumber  *load;
+
+  loadMap = OSArray::withCapacity(kWiiOHCIInterruptLeafCount);
+  if (loadMap == NULL) {
+    return;
+  }
+
+  for (UInt8 i = 0; i < kWiiOHCIInterruptLeafCount; i++) {
+    load = OSNumber::withNumber(getInterruptFrameLoad(i), 32);
+    if (load == NULL) {
+      loadMap->release();
+      return;
+    }
+    loadMap->setObject(load);
+    load->release();
+  }
+
+  setProperty(kWiiOHCIInterruptLoadMapKey, loadMap);
+  loadMap->release();
+}
+
+//
+// Counts the bytes and status of a completed transfer descriptor or isochronous frame.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiOHCI::updateEndpointStatistics(OHCIEndpointData *endpoint, IOReturn status, UInt32 bytes) {
+  endpoint->statBytes += bytes;
+
+  //
+  // Underruns are short packets, expected on bulk and interrupt IN endpoints.
+  // NAKs are retried by the controller and never reach the done queue, so a STALL handshake is the only visible stall.
+  //
+  if (status == kIOReturnUnderrun) {
+    endpoint->statShortPackets++;
+  } else if (status != kIOReturnSuccess) {
+    endpoint->statErrors++;
+    if (status == kIOUSBPipeStalled) {
+      endpoint->statStalls++;
+    }
+  }
+}
+
+//
+// Counts a completed transaction and its latency from submission to completion.
+// A submit timebase of zero skips the latency histogram.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiOHCI::completeEndpointStatistics(OHCIEndpointData *endpoint, UInt64 submitTimebase) {
+  UInt64 latencyTicks;
+  UInt32 bucket;
+
+  endpoint->statTransfers++;
+  if (submitTimebase == 0) {
+    return;
+  }
+
+  //
+  // Compare in timebase ticks to avoid a 64-bit divide, interrupt IN transfers can be pending for minutes.
+  //
+  latencyTicks = getProcessorTimebase() - submitTimebase;
+  bucket       = 0;
+  while ((bucket < (kOHCIEndpointLatencyBucketCount - 1))
+         && (latencyTicks >= ((UInt64) _timebaseTicksPerUS * (kOHCIEndpointLatencyBucketBaseUS << bucket)))) {
+    bucket++;
+  }
+  endpoint->statLatencyHistogram[bucket]++;
+}
+
+//
+// Publishes the statistics of each endpoint.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiOHCI::publishEndpointStatistics(void) {
+  OHCIEndpointData  *endpoint;
+  OSDictionary      *statistics;
+  OSDictionary      *endpointStats;
+  OSArray           *histogram;
+  OSNumber          *number;
+  char              name[32];
+  UInt16            key;
+
+  statistics = OSDictionary::withCapacity(8);
+  if (statistics == NULL) {
+    return;
+  }
+
+  //
+  // All endpoints other than the list heads are in the hash table.
+  //
+  for (UInt32 i = 0; i < kWiiOHCIEndpointHashSize; i++) {
+    endpoint = _endpointHashTable[i];
+    if (endpoint == NULL) {
+      continue;
+    }
+
+    endpointStats = OSDictionary::withCapacity(8);
+    histogram     = OSArray::withCapacity(kOHCIEndpointLatencyBucketCount);
+    if ((endpointStats == NULL) || (histogram == NULL)) {
+      OSSafeReleaseNULL(endpointStats);
+      OSSafeReleaseNULL(histogram);
+      break;
+    }
+
+    for (UInt32 b = 0; b < kOHCIEndpointLatencyBucketCount; b++) {
+      number = OSNumber::withNumber(endpoint->statLatencyHistogram[b], 32);
+      if (number != NULL) {
+        histogram->setObject(number);
+        number->release();
+      }
+    }
+    endpointStats->setObject(kWiiOHCIEndpointStatLatencyKey, histogram);
+    histogram->release();
+
+    setDictionaryNumber(endpointStats, kWiiOHCIEndpointStatTypeKey, endpoint->type, 8);
+    setDictionaryNumber(endpointStats, kWiiOHCIEndpointStatTransfersKey, endpoint->statTransfers, 32);
+    setDictionaryNumber(endpointStats, kWiiOHCIEndpointStatBytesKey, endpoint->statBytes, 64);
+    setDictionaryNumber(endpointStats, kWiiOHCIEndpointStatShortPacketsKey, endpoint->statShortPackets, 32);
+    setDictionaryNumber(endpointStats, kWiiOHCIEndpointStatErrorsKey, endpoint->statErrors, 32);
+    setDictionaryNumber(endpointStats, kWiiOHCIEndpointStatStallsKey, endpoint->statStalls, 32);
+    setDictionaryNumber(endpointStats, kWiiOHCIEndpointStatJumboBuffersKey, endpoint->statJumboBounceBuffers, 32);
+    setDictionaryNumber(endpointStats, kWiiOHCIEndpointStatLockedCacheKey, endpoint->statLockedCacheMoves, 32);
+
+    key = endpoint->key;
+    snprintf(name, sizeof (name), "F%u-EP%u-%s", key & kOHCIEDFlagsFuncMask,
+      (key & kOHCIEDFlagsEndpointMask) >> kOHCIEDFlagsEndpointShift,
+      ((key & kOHCIEDFlagsDirectionMask) == kOHCIEDFlagsDirectionIn) ? "In" :
+      (((key & kOHCIEDFlagsDirectionMask) == kOHCIEDFlagsDirectionOut) ? "Out" : "Ctrl"));
+    statistics->setObject(name, endpointStats);
+    endpointStats->release();
   }
+
+  setProperty(kWiiOHCIEndpointStatisticsKey, statistics);
+  statistics->release();
 }
 
 //
 // Adds a new endpoint to the specified list.
 //
 IOReturn WiiOHCI::addNewEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt16 maxPacketSize,
-                                 UInt8 speed, UInt8 direction, OHCIEndpointData *endpointHeadPtr,
-                                 bool isochronous) {
+                                 UInt8 speed, UInt8 direction, OHCIEndpointData *endpointHeadPtr, UInt8 type,
+                                 OHCIEndpointData **outEndpoint) {
   OHCIEndpointData  *endpoint;
   OHCITransferData  *transferTail;
   UInt32            flags;
+  bool              isochronous;
+
+  isochronous = (type == kWiiOHCIEndpointTypeIsochronous);
 
   //
   // Get a free endpoint.
@@ -601,19 +824,33 @@ IOReturn WiiOHCI::addNewEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UIn
   //
   // Configure flags indicating what device this endpoint is for.
   //
-  flags = (functionNumber & kOHCIEDFlagsFuncMask)
-    | ((endpointNumber << kOHCIEDFlagsEndpointShift) & kOHCIEDFlagsEndpointMask)
+  endpoint->type          = type;
+  endpoint->key           = getEndpointKey(functionNumber, endpointNumber, direction);
+  endpoint->headEndpoint  = endpointHeadPtr;
+  endpoint->interruptNode = kWiiOHCIInterruptNodeNone;
+  endpoint->bandwidth     = 0;
+
+  endpoint->statTransfers           = 0;
+  endpoint->statBytes               = 0;
+  endpoint->statShortPackets        = 0;
+  endpoint->statErrors              = 0;
+  endpoint->statStalls              = 0;
+  endpoint->statJumboBounceBuffers  = 0;
+  endpoint->statLockedCacheMoves    = 0;
+  bzero(endpoint->statLatencyHistogram, sizeof (endpoint->statLatencyHistogram));
+
+  endpoint->retireFlags    = 0;
+  endpoint->retireTail     = NULL;
+  endpoint->retireListMask = 0;
+  endpoint->retireNext     = NULL;
+  endpoint->stream         = NULL;
+
+  endpoint->traceActualLength = 0;
+
+  flags = endpoint->key
     | ((speed == kUSBDeviceSpeedLow) ? kOHCIEDFlagsLowSpeed : 0)
     | ((maxPacketSize << kOHCIEDFlagsMaxPktSizeShift) & kOHCIEDFlagsMaxPktSizeMask)
     | (isochronous ? kOHCIEDFlagsIsochronous: 0);
-
-  if (direction == kUSBOut) {
-    flags |= kOHCIEDFlagsDirectionOut;
-  } else if (direction == kUSBIn) {
-    flags |= kOHCIEDFlagsDirectionIn;
-  } else {
-    flags |= kOHCIEDFlagsDirectionTD;
-  }
   endpoint->ed->flags = HostToUSBLong(flags);
 
   //
@@ -632,6 +869,14 @@ IOReturn WiiOHCI::addNewEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UIn
   endpoint->ed->headTDPhysAddr = HostToUSBLong(transferTail->physAddr);
   endpoint->ed->tailTDPhysAddr = HostToUSBLong(transferTail->physAddr);
 
+  //
+  // Add to the lookup table.
+  //
+  if (!insertEndpointHash(endpoint)) {
+    returnEndpoint(endpoint);
+    return kIOReturnNoResources;
+  }
+
   //
   // Insert new endpoint into linked list.
   //
@@ -640,40 +885,30 @@ IOReturn WiiOHCI::addNewEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UIn
   endpoint->ed->nextEDPhysAddr        = endpointHeadPtr->ed->nextEDPhysAddr;
   endpointHeadPtr->ed->nextEDPhysAddr = HostToUSBLong(endpoint->physAddr);
 
+  if (outEndpoint != NULL) {
+    *outEndpoint = endpoint;
+  }
   return kIOReturnSuccess;
 }
 
 //
-// Removes an endpoint from the specified list.
+// Removes an endpoint from its list and the lookup table.
 //
-IOReturn WiiOHCI::removeEndpoint(UInt8 functionNumber, UInt8 endpointNumber,
-                                 OHCIEndpointData *endpointHeadPtr, OHCIEndpointData *endpointTailPtr) {
-  OHCIEndpointData  *currentEndpoint;
-  UInt32            deviceNumber;
-
-  deviceNumber    = (functionNumber & kOHCIEDFlagsFuncMask) | (((UInt32)endpointNumber << kOHCIEDFlagsEndpointShift) & kOHCIEDFlagsEndpointMask);
-  currentEndpoint = endpointHeadPtr->nextEndpoint;
-  while (currentEndpoint != endpointTailPtr) {
-    //
-    // Check if current endpoint matches.
-    //
-    if ((USBToHostLong(currentEndpoint->ed->flags) & (kOHCIEDFlagsFuncMask | kOHCIEDFlagsEndpointMask)) == deviceNumber) {
-      //
-      // Remove the endpoint.
-      //
-      return kIOReturnSuccess;
-    }
-
-    currentEndpoint = currentEndpoint->nextEndpoint;
-  }
+// The list containing the endpoint should not be processed by the controller during this call.
+//
+void WiiOHCI::removeEndpoint(OHCIEndpointData *endpoint, OHCIEndpointData *prevEndpoint) {
+  prevEndpoint->nextEndpoint       = endpoint->nextEndpoint;
+  prevEndpoint->ed->nextEDPhysAddr = endpoint->ed->nextEDPhysAddr;
 
-  return kIOUSBEndpointNotFound;
+  removeEndpointHash(endpoint);
+  endpoint->headEndpoint = NULL;
 }
 
 //
-// Removes and completes all transfers linked to the specified endpoint.
+// Removes and completes all transfers linked to the specified endpoint, up until the stop transfer.
+// The endpoint must be skipped or halted, and the controller past the frame that last used it.
 //
-void WiiOHCI::removeEndpointTransfers(OHCIEndpointData *endpoint) {
+void WiiOHCI::removeEndpointTransfers(OHCIEndpointData *endpoint, OHCITransferData *stopTransfer) {
   OHCITransferData  *transferCurr;
   OHCITransferData  *transferNext;
   UInt32            bufferSizeRemaining;
@@ -686,19 +921,20 @@ void WiiOHCI::removeEndpointTransfers(OHCIEndpointData *endpoint) {
   WIIDBGLOG("TD head phys: 0x%X, tail phys: 0x%X", USBToHostLong(endpoint->ed->headTDPhysAddr), USBToHostLong(endpoint->ed->tailTDPhysAddr));
   transferCurr = getTransferFromPhys(USBToHostLong(endpoint->ed->headTDPhysAddr) & kOHCIEDTDHeadMask);
 
-  endpoint->ed->headTDPhysAddr = endpoint->ed->tailTDPhysAddr;
+  endpoint->ed->headTDPhysAddr = HostToUSBLong(stopTransfer->physAddr);
 
   //
   // Iterate through chain.
   //
   bufferSizeRemaining = 0;
   if (endpoint->isochronous) {
-    while (transferCurr != endpoint->transferTail) {
+    while (transferCurr != stopTransfer) {
       if (transferCurr == NULL) {
         // Shouldn't occur.
         WIISYSLOG("Got an invalid IsoTD here");
         return;
       }
+      invalidateTransferDescriptor(transferCurr);
 
       WIIDBGLOG("Unlinking IsoTD phys 0x%X, next 0x%X, buf %p", transferCurr->physAddr,
         USBToHostLong(transferCurr->isoTD->nextTDPhysAddr), transferCurr->srcBuffer);
@@ -710,12 +946,13 @@ void WiiOHCI::removeEndpointTransfers(OHCIEndpointData *endpoint) {
       transferCurr = transferNext;
     }
   } else {
-    while (transferCurr != endpoint->transferTail) {
+    while (transferCurr != stopTransfer) {
       if (transferCurr == NULL) {
         // Shouldn't occur.
         WIISYSLOG("Got an invalid GenTD here");
         return;
       }
+      invalidateTransferDescriptor(transferCurr);
 
       WIIDBGLOG("Unlinking GenTD phys 0x%X, next 0x%X, buf %p", transferCurr->physAddr,
         USBToHostLong(transferCurr->genTD->nextTDPhysAddr), transferCurr->srcBuffer);
@@ -735,6 +972,8 @@ void WiiOHCI::removeEndpointTransfers(OHCIEndpointData *endpoint) {
       // Invoke completion for final transfer.
       //
       if (transferCurr->last) {
+        traceEvent(kWiiOHCITraceEventComplete, endpoint, transferCurr->traceId, transferCurr->traceLength,
+          transferCurr->traceLength - bufferSizeRemaining, kIOReturnAborted, kWiiOHCITraceConditionCodeNone);
         Complete(transferCurr->genCompletion, kIOReturnAborted, bufferSizeRemaining);
         bufferSizeRemaining = 0;
       }
@@ -748,20 +987,12 @@ void WiiOHCI::removeEndpointTransfers(OHCIEndpointData *endpoint) {
 
 //
 // Removes all transfers up until and including one with a completion.
+// Called from the retire list once the controller has passed the frame the transfer failed in.
 //
 void WiiOHCI::completeFailedEndpointGenTransfers(OHCIEndpointData *endpoint, IOReturn tdStatus, UInt32 bufferSizeRemaining) {
   OHCITransferData  *transferCurr;
   OHCITransferData  *transferNext;
 
-  //
-  // Mark endpoint as skipped and wait until next frame.
-  //
-  endpoint->ed->flags |= HostToUSBLong(kOHCIEDFlagsSkip);
-  writeReg32(kOHCIRegIntStatus, kOHCIRegIntStatusStartOfFrame);
-  while ((readReg32(kOHCIRegIntStatus) & kOHCIRegIntStatusStartOfFrame) == 0) {
-    IODelay(10);
-  }
-
   transferCurr = getTransferFromPhys(USBToHostLong(endpoint->ed->headTDPhysAddr) & kOHCIEDTDHeadMask);
   while (transferCurr != endpoint->transferTail) {
     if (transferCurr == NULL) {
@@ -769,6 +1000,7 @@ void WiiOHCI::completeFailedEndpointGenTransfers(OHCIEndpointData *endpoint, IOR
       WIISYSLOG("Got an invalid TD here");
       return;
     }
+    invalidateTransferDescriptor(transferCurr);
 
     //
     // Unlink the transfer descriptor and get the buffer size.
@@ -793,7 +1025,9 @@ void WiiOHCI::completeFailedEndpointGenTransfers(OHCIEndpointData *endpoint, IOR
       if (tdStatus != kIOReturnSuccess) {
         WIIDBGLOG("Completing failed transfer with %u bytes remaining", bufferSizeRemaining);
       }
-      endpoint->ed->flags &= ~(HostToUSBLong(kOHCIEDFlagsSkip));
+      completeEndpointStatistics(endpoint, transferCurr->genSubmitTimebase);
+      traceEvent(kWiiOHCITraceEventComplete, endpoint, transferCurr->traceId, transferCurr->traceLength,
+        transferCurr->traceLength - bufferSizeRemaining, tdStatus, kWiiOHCITraceConditionCodeNone);
       Complete(transferCurr->genCompletion, tdStatus, bufferSizeRemaining);
       returnTransfer(transferCurr);
       if (tdStatus != kIOReturnSuccess) {
@@ -807,3 +1041,169 @@ void WiiOHCI::completeFailedEndpointGenTransfers(OHCIEndpointData *endpoint, IOR
     transferCurr = transferNext;
   }
 }
+
+//
+// Skips an endpoint and queues operations to be done once the controller has passed the next start of frame.
+// Neither the caller nor the workloop waits for the controller to release the endpoint.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiOHCI::retireEndpoint(OHCIEndpointData *endpoint, UInt8 retireFlags) {
+  //
+  // Take the start of frame count before skipping the endpoint.
+  // The primary interrupt may count a start of frame that happened before the skip, two are waited for.
+  //
+  endpoint->retireFrame = _startOfFrameCount;
+  OSSynchronizeIO();
+  endpoint->ed->flags |= HostToUSBLong(kOHCIEDFlagsSkip);
+
+  if (endpoint->retireFlags == 0) {
+    endpoint->retireNext   = _retireEndpointHeadPtr;
+    _retireEndpointHeadPtr = endpoint;
+  }
+  endpoint->retireFlags |= retireFlags;
+  WIIDBGLOG("Retiring EP phys: 0x%X, flags: 0x%X, SOF: %u", endpoint->physAddr, endpoint->retireFlags, endpoint->retireFrame);
+
+  //
+  // Clear any stale start of frame status, so the interrupt is for a frame started after the endpoint was skipped.
+  //
+  writeReg32(kOHCIRegIntStatus, kOHCIRegIntStatusStartOfFrame);
+  writeReg32(kOHCIRegIntEnable, kOHCIRegIntEnableStartOfFrame);
+}
+
+//
+// Removes an endpoint from the retire list if it is on it, and returns the operations that were pending.
+//
+// This function is gated and called within the workloop context.
+//
+UInt8 WiiOHCI::takeRetiredEndpoint(OHCIEndpointData *endpoint) {
+  OHCIEndpointData  *currEndpoint;
+  OHCIEndpointData  *prevEndpoint;
+  UInt8             retireFlags;
+
+  prevEndpoint = NULL;
+  currEndpoint = _retireEndpointHeadPtr;
+  while ((currEndpoint != NULL) && (currEndpoint != endpoint)) {
+    prevEndpoint = currEndpoint;
+    currEndpoint = currEndpoint->retireNext;
+  }
+  if (currEndpoint == NULL) {
+    return 0;
+  }
+
+  if (prevEndpoint == NULL) {
+    _retireEndpointHeadPtr = endpoint->retireNext;
+  } else {
+    prevEndpoint->retireNext = endpoint->retireNext;
+  }
+  retireFlags           = endpoint->retireFlags;
+  endpoint->retireFlags = 0;
+  endpoint->retireNext  = NULL;
+  return retireFlags;
+}
+
+//
+// Completes retire operations on an endpoint the controller has released.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiOHCI::completeRetiredEndpoint(OHCIEndpointData *endpoint, UInt8 retireFlags) {
+  WIIDBGLOG("Retired EP phys: 0x%X, flags: 0x%X", endpoint->physAddr, retireFlags);
+
+  //
+  // Finish a failed transaction first so it completes with its own status instead of as aborted.
+  //
+  if (retireFlags & kWiiOHCIRetireFailed) {
+    completeFailedEndpointGenTransfers(endpoint, endpoint->retireStatus, endpoint->retireBufferRemaining);
+  }
+  if (retireFlags & kWiiOHCIRetireAbort) {
+    removeEndpointTransfers(endpoint, endpoint->retireTail);
+  }
+  if (retireFlags & kWiiOHCIRetireDelete) {
+    completeDeletedEndpoint(endpoint);
+  }
+}
+
+//
+// Frees a deleted endpoint the controller has released, aborting any outstanding transfers.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiOHCI::completeDeletedEndpoint(OHCIEndpointData *endpoint) {
+  OHCIEndpointData  *currEndpoint;
+  UInt32            listMask;
+
+  //
+  // The controller may still have a deleted control or bulk endpoint as the current endpoint.
+  //
+  listMask = endpoint->retireListMask;
+  if (listMask != 0) {
+    if (readReg32(kOHCIRegControlCurrentED) == endpoint->physAddr) {
+      writeReg32(kOHCIRegControlCurrentED, 0);
+    }
+    if (readReg32(kOHCIRegBulkCurrentED) == endpoint->physAddr) {
+      writeReg32(kOHCIRegBulkCurrentED, 0);
+    }
+  }
+
+  removeEndpointTransfers(endpoint, endpoint->transferTail);
+  if (endpoint->stream != NULL) {
+    destroyBulkStream(endpoint);
+  }
+  returnEndpoint(endpoint);
+  WIIDBGLOG("Deleted EP phys: 0x%X", endpoint->physAddr);
+
+  //
+  // Resume the control or bulk list unless another deleted endpoint on it has not been released yet.
+  //
+  for (currEndpoint = _retireEndpointHeadPtr; currEndpoint != NULL; currEndpoint = currEndpoint->retireNext) {
+    if (currEndpoint->retireFlags & kWiiOHCIRetireDelete) {
+      listMask &= ~(currEndpoint->retireListMask);
+    }
+  }
+  if (listMask != 0) {
+    writeReg32(kOHCIRegControl, readReg32(kOHCIRegControl) | listMask);
+  }
+}
+
+//
+// Processes endpoints whose retire operations were queued before the last start of frame.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiOHCI::processRetiredEndpoints(void) {
+  OHCIEndpointData  *endpoint;
+
+  while (true) {
+    //
+    // Take the first ready endpoint.
+    // Completions may queue further operations, so the list is searched again each time.
+    //
+    endpoint = _retireEndpointHeadPtr;
+    while ((endpoint != NULL) && ((_startOfFrameCount - endpoint->retireFrame) < kWiiOHCIRetireStartOfFrames)) {
+      endpoint = endpoint->retireNext;
+    }
+    if (endpoint == NULL) {
+      break;
+    }
+    completeRetiredEndpoint(endpoint, takeRetiredEndpoint(endpoint));
+
+    //
+    // Re-activate the endpoint unless more operations were queued or it was deleted during completions.
+    //
+    if ((endpoint->headEndpoint != NULL) && (endpoint->retireFlags == 0)) {
+      endpoint->ed->flags &= ~(HostToUSBLong(kOHCIEDFlagsSkip));
+      if (endpoint->stream != NULL) {
+        serviceBulkStream(endpoint);
+      }
+    }
+  }
+
+  //
+  // Wait for another frame if operations were queued after the last start of frame.
+  //
+  if (_retireEndpointHeadPtr != NULL) {
+    writeReg32(kOHCIRegIntStatus, kOHCIRegIntStatusStartOfFrame);
+    writeReg32(kOHCIRegIntEnable, kOHCIRegIntEnableStartOfFrame);
+  }
+}
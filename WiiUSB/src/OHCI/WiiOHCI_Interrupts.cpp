@@ -7,6 +7,76 @@
 
 #include "WiiOHCI.hpp"
 
+//
+// Pushes a list of transfers onto a pending transfer list.
+//
+// The primary interrupt filter is the only producer, and consumers only ever take the entire list.
+// Lists are kept newest first, and reversed when taken.
+//
+void WiiOHCI::pushTransferList(OHCITransferData * volatile *listHeadPtr, OHCITransferData *headTransfer, OHCITransferData *tailTransfer) {
+  OHCITransferData *oldHeadTransfer;
+
+  do {
+    oldHeadTransfer            = *listHeadPtr;
+    tailTransfer->nextTransfer = oldHeadTransfer;
+    syncMemory();
+  } while (!compareAndSwapPointer(oldHeadTransfer, headTransfer, (void * volatile *) listHeadPtr));
+}
+
+//
+// Takes all transfers from a pending transfer list.
+//
+// Returned list is in completion order, oldest first.
+//
+OHCITransferData *WiiOHCI::takeTransferList(OHCITransferData * volatile *listHeadPtr) {
+  OHCITransferData *currTransfer;
+  OHCITransferData *prevTransfer;
+  OHCITransferData *nextTransfer;
+
+  do {
+    currTransfer = *listHeadPtr;
+  } while (!compareAndSwapPointer(currTransfer, NULL, (void * volatile *) listHeadPtr));
+
+  //
+  // Reverse the list.
+  //
+  prevTransfer = NULL;
+  while (currTransfer != NULL) {
+    nextTransfer               = currTransfer->nextTransfer;
+    currTransfer->nextTransfer = prevTransfer;
+    prevTransfer               = currTransfer;
+    currTransfer               = nextTransfer;
+  }
+
+  return prevTransfer;
+}
+
+//
+// Takes all completed general and outbound isochronous transfers, oldest first.
+// Transfers left by PollInterrupts() are older than any still on the pending list.
+//
+// This function is gated and called within the workloop context.
+//
+OHCITransferData *WiiOHCI::takeDoneQueue(void) {
+  OHCITransferData *headTransfer;
+  OHCITransferData *tailTransfer;
+
+  headTransfer = takeTransferList(&_writeDoneHeadPtr);
+  if (_pollDeferredHead == NULL) {
+    return headTransfer;
+  }
+
+  tailTransfer = _pollDeferredHead;
+  while (tailTransfer->nextTransfer != NULL) {
+    tailTransfer = tailTransfer->nextTransfer;
+  }
+  tailTransfer->nextTransfer = headTransfer;
+
+  headTransfer      = _pollDeferredHead;
+  _pollDeferredHead = NULL;
+  return headTransfer;
+}
+
 //
 // Interrupt handler filter function.
 //
@@ -21,9 +91,10 @@ bool WiiOHCI::filterInterrupt(IOFilterInterruptEventSource *filterIntEventSource
 
   IOPhysicalAddress newWriteDoneHeadPhysAddr;
   AbsoluteTime      timeStamp;
+  UInt64            doneTimebase;
   UInt16            frameCount;
   UInt16            pktOffStatus;
-  UInt16            hcFrameNumber;
+  UInt32            doneTransfers;
   OHCITransferData  *tailTransfer;
   OHCITransferData  *tailIsoInTransfer;
   OHCITransferData  *currTransfer;
@@ -55,6 +126,7 @@ bool WiiOHCI::filterInterrupt(IOFilterInterruptEventSource *filterIntEventSource
   //
   if (intStatus & kOHCIRegIntStatusWritebackDoneHead) {
     clock_get_uptime(&timeStamp);
+    doneTimebase = getProcessorTimebase();
 
     //
     // Get the queue head from HCCA and notify controller its been taken.
@@ -65,19 +137,30 @@ bool WiiOHCI::filterInterrupt(IOFilterInterruptEventSource *filterIntEventSource
     OSSynchronizeIO();
 
     //
-    // Reverse the queue and get the pointers to transfer data.
-    // The host controller links the newest descriptors to the head of the queue.
+    // Get the pointers to transfer data.
+    // The host controller links the newest descriptors to the head of the queue, this order is kept until the lists are taken.
     //
     newDoneHeadTransfer   = NULL;
     newIsoInHeadTransfer  = NULL;
     tailTransfer          = NULL;
     tailIsoInTransfer     = NULL;
+    doneTransfers         = 0;
     currTransfer          = getTransferFromPhys(newWriteDoneHeadPhysAddr);
     while (currTransfer != NULL) {
+      invalidateTransferDescriptor(currTransfer);
+      doneTransfers++;
+
       //
       // Update timestamp and status for low latency isochronous transfers.
       //
       if (currTransfer->type == kOHCITransferTypeIsochronousLowLatency) {
+        //
+        // Direct inbound data is in the client buffer already, drop stale lines before the status is visible.
+        //
+        if (currTransfer->isoDirectPhysAddr != 0) {
+          _invalidateCacheFunc(currTransfer->isoDirectPhysAddr, currTransfer->actualBufferSize, true);
+        }
+
         frameCount = ((USBToHostLong(currTransfer->isoTD->flags) & kOHCIIsoTDFlagsFrameCountMask) >> kOHCIIsoTDFlagsFrameCountShift) + 1;
         for (UInt16 i = 0; i < frameCount; i++) {
           pktOffStatus = USBToHostWord(currTransfer->isoTD->packetOffsetStatus[i]);
@@ -99,22 +182,24 @@ bool WiiOHCI::filterInterrupt(IOFilterInterruptEventSource *filterIntEventSource
 
       //
       // Link the transfer to the correct list.
-      // Inbound isochronous transfers go to a different linked list for post-transfer copies.
+      // Inbound isochronous transfers go to a different linked list for post-transfer copies, unless there is nothing to copy.
       //
-      if (((currTransfer->type == kOHCITransferTypeIsochronous) || (currTransfer->type == kOHCITransferTypeIsochronousLowLatency)) && (currTransfer->direction == kUSBIn)) {
-        currTransfer->nextTransfer = newIsoInHeadTransfer;
-        newIsoInHeadTransfer       = currTransfer;
-
+      if (((currTransfer->type == kOHCITransferTypeIsochronous) || (currTransfer->type == kOHCITransferTypeIsochronousLowLatency))
+          && (currTransfer->direction == kUSBIn) && (currTransfer->isoDirectPhysAddr == 0)) {
+        currTransfer->isoDoneTimebase = doneTimebase;
         if (tailIsoInTransfer == NULL) {
-          tailIsoInTransfer = currTransfer;
+          newIsoInHeadTransfer = currTransfer;
+        } else {
+          tailIsoInTransfer->nextTransfer = currTransfer;
         }
+        tailIsoInTransfer = currTransfer;
       } else {
-        currTransfer->nextTransfer = newDoneHeadTransfer;
-        newDoneHeadTransfer        = currTransfer;
-
         if (tailTransfer == NULL) {
-          tailTransfer = currTransfer;
+          newDoneHeadTransfer = currTransfer;
+        } else {
+          tailTransfer->nextTransfer = currTransfer;
         }
+        tailTransfer = currTransfer;
       }
 
       currTransfer = getTransferFromPhys(USBToHostLong(currTransfer->genTD->nextTDPhysAddr));
@@ -124,30 +209,30 @@ bool WiiOHCI::filterInterrupt(IOFilterInterruptEventSource *filterIntEventSource
     // Update the current unprocessed linked lists.
     //
     if (newDoneHeadTransfer != NULL) {
-      IOSimpleLockLock(_writeDoneHeadLock);
-
-      tailTransfer->nextTransfer = (OHCITransferData*) _writeDoneHeadPtr;
-      _writeDoneHeadPtr = newDoneHeadTransfer;
-
-      IOSimpleLockUnlock(_writeDoneHeadLock);
+      pushTransferList(&_writeDoneHeadPtr, newDoneHeadTransfer, tailTransfer);
 
       _intWriteDoneHead  = true;
       signalSecondaryInt = true;
     }
 
     if (newIsoInHeadTransfer != NULL) {
-      IOSimpleLockLock(_isoInHeadLock);
+      pushTransferList(&_isoInHeadPtr, newIsoInHeadTransfer, tailIsoInTransfer);
 
-      tailIsoInTransfer->nextTransfer = (OHCITransferData*) _isoInHeadPtr;
-      _isoInHeadPtr = newIsoInHeadTransfer;
-
-      IOSimpleLockUnlock(_isoInHeadLock);
+      _intIsoInDone      = true;
+      signalSecondaryInt = true;
     }
+
+    //
+    // Account the time spent walking the done queue for comparing descriptor cache modes.
+    // The workloop drains these counters concurrently, updates must be atomic.
+    //
+    OSAddAtomic((SInt32) (getProcessorTimebase() - doneTimebase), (volatile SInt32 *) &_doneQueuePendingTicks);
+    OSAddAtomic((SInt32) doneTransfers, (volatile SInt32 *) &_doneQueuePendingTransfers);
   }
 
   //
   // Start of frame.
-  // Clear/disable and move on.
+  // Only enabled while endpoints are pending retire operations, the controller is no longer using them.
   //
   if (intStatus & kOHCIRegIntStatusStartOfFrame) {
     writeReg32(kOHCIRegIntStatus, kOHCIRegIntStatusStartOfFrame);
@@ -155,6 +240,10 @@ bool WiiOHCI::filterInterrupt(IOFilterInterruptEventSource *filterIntEventSource
 
     writeReg32(kOHCIRegIntDisable, kOHCIRegIntDisableStartOfFrame);
     OSSynchronizeIO();
+
+    OSIncrementAtomic((volatile SInt32 *) &_startOfFrameCount);
+    _intStartOfFrame   = true;
+    signalSecondaryInt = true;
   }
 
   //
@@ -232,25 +321,39 @@ bool WiiOHCI::filterInterrupt(IOFilterInterruptEventSource *filterIntEventSource
 //
 void WiiOHCI::handleInterrupt(IOInterruptEventSource *intEventSource, int count) {
   IOInterruptState  intState;
-  UInt32            newWriteHeadDoneProducerCount;
-  volatile OHCITransferData  *newDoneTransfer;
 
-  WIIDBGLOG("Interrupt: WH: %u, RH: %u", _intWriteDoneHead, _intRootHubStatus);
+  WIIDBGLOG("Interrupt: WH: %u, II: %u, RH: %u", _intWriteDoneHead, _intIsoInDone, _intRootHubStatus);
+
+  //
+  // Inbound isochronous transfers completed.
+  // Copy data back to the client buffers as soon as possible.
+  //
+  if (_intIsoInDone) {
+    _intIsoInDone = false;
+    serviceIsoInTransfers(false);
+  }
 
   //
   // Done queue head written.
   //
   if (_intWriteDoneHead) {
     _intWriteDoneHead = false;
+    completeTransferQueue(takeDoneQueue());
+  }
 
-    intState = IOSimpleLockLockDisableInterrupt(_writeDoneHeadLock);
-
-    newDoneTransfer   = _writeDoneHeadPtr;
-    _writeDoneHeadPtr = NULL;
-
-    IOSimpleLockUnlockEnableInterrupt(_writeDoneHeadLock, intState);
+  //
+  // Start of frame passed, retire skipped endpoints.
+  //
+  if (_intStartOfFrame) {
+    _intStartOfFrame = false;
+    processRetiredEndpoints();
+  }
 
-    completeTransferQueue((OHCITransferData*) newDoneTransfer);
+  //
+  // Completed outbound isochronous transfers move later ones into the prefill window.
+  //
+  if (_isoOutPrefillPending) {
+    serviceIsoOutTransfers();
   }
 
   //
@@ -262,78 +365,88 @@ void WiiOHCI::handleInterrupt(IOInterruptEventSource *intEventSource, int count)
     IOSimpleLockUnlockEnableInterrupt(_intRootHubStatusLock, intState);
     completeRootHubInterruptTransfer(false);
   }
+
+  //
+  // Periodically publish done queue processing cost and endpoint statistics.
+  //
+  if ((getProcessorTimebase() - _doneQueueStatsPublishTimebase) >= ((UInt64) _timebaseTicksPerUS * kWiiOHCIDoneQueueStatsIntervalMS * kWiiMicrosecondMS)) {
+    publishDoneQueueStatistics();
+    publishEndpointStatistics();
+  }
 }
 
 //
-// Handles isochronous inbound timer events.
+// Copies completed inbound isochronous transfers back to the source buffers and completes them.
 //
-// This function is not called within the regular workloop context.
-// This timer is running when isochronous endpoints are present.
+// This function is gated and called within the workloop context.
 //
-void WiiOHCI::handleIsoInTimer(IOTimerEventSource *sender) {
-  IOInterruptState  intState;
+void WiiOHCI::serviceIsoInTransfers(bool fromTimer) {
   OHCITransferData  *currTransfer;
-  OHCITransferData  *prevTransfer;
   OHCITransferData  *headIsoInTransfer;
+  UInt32            latencyUS;
+  UInt32            bucket;
 
   //
   // Get the current list of the inbound isochronous transfers.
   //
-  intState = IOSimpleLockLockDisableInterrupt(_isoInHeadLock);
-
-  headIsoInTransfer = (OHCITransferData*) _isoInHeadPtr;
-  _isoInHeadPtr     = NULL;
-
-  IOSimpleLockUnlockEnableInterrupt(_isoInHeadLock, intState);
+  headIsoInTransfer = takeTransferList(&_isoInHeadPtr);
+  if (headIsoInTransfer == NULL) {
+    return;
+  }
 
   //
   // Iterate through the chain and copy data back to the source buffers.
+  // Packets are at their requested offsets in the bounce buffer, so the whole buffer is copied.
+  // Frame counts are not known yet, they are filled in when the transfers complete.
   //
-  prevTransfer = NULL;
   currTransfer = headIsoInTransfer;
   while (currTransfer != NULL) {
     if (currTransfer->srcBuffer != NULL) {
-      _invalidateCacheFunc((vm_offset_t) currTransfer->bounceBuffer->buf, currTransfer->actualBufferSize, false);
-      currTransfer->srcBuffer->writeBytes(0, currTransfer->bounceBuffer->buf, currTransfer->isoFrames[currTransfer->isoFrameIndex].frActCount);
+      writeFromDMABuffer(currTransfer->srcBuffer, 0, currTransfer->bounceBuffer->buf,
+                         currTransfer->actualBufferSize, _invalidateCacheFunc);
+    }
+
+    //
+    // Track time between the done queue interrupt and the data being available to the client.
+    //
+    latencyUS = ((UInt32) (getProcessorTimebase() - currTransfer->isoDoneTimebase)) / _timebaseTicksPerUS;
+    bucket    = 0;
+    while ((bucket < (kWiiOHCIIsoLatencyBucketCount - 1)) && (latencyUS >= ((UInt32) kWiiOHCIIsoLatencyBucketBaseUS << bucket))) {
+      bucket++;
+    }
+    _isoInLatencyHistogram[bucket]++;
+
+    if (fromTimer) {
+      _isoInServicedTimer++;
+    } else {
+      _isoInServicedInterrupt++;
     }
 
-    prevTransfer = currTransfer;
     currTransfer = currTransfer->nextTransfer;
   }
 
   //
-  // Link to the main completed transfer chain.
+  // Complete the transfers.
   //
-  if (headIsoInTransfer != NULL) {
-    intState = IOSimpleLockLockDisableInterrupt(_writeDoneHeadLock);
-
-    prevTransfer->nextTransfer = (OHCITransferData*) _writeDoneHeadPtr;
-    _writeDoneHeadPtr          = (OHCITransferData*)  headIsoInTransfer;
-
-    IOSimpleLockUnlockEnableInterrupt(_writeDoneHeadLock, intState);
-
-    //
-    // Signal the main handler there are new completed transfers.
-    //
-    _intWriteDoneHead = true;
-    _interruptEventSource->signalInterrupt();
-  }
-
-  _isoInTimerEventSource->setTimeoutUS(kWiiOHCIIsoTimerRefreshUS);
+  completeTransferQueue(headIsoInTransfer);
 }
 
 //
-// Handles isochronous outbound timer events.
+// Copies outbound isochronous source buffers into bounce buffers for transfers about to be sent.
 //
-// This function is not called within the regular workloop context.
-// This timer is running when isochronous endpoints are present.
-// The timer is stopped/started when the endpoint list has items removed.
+// This function is gated and called within the workloop context.
+// The outbound timer is armed for the next transfer that will enter the prefill window, if any.
 //
-void WiiOHCI::handleIsoOutTimer(IOTimerEventSource *sender) {
+void WiiOHCI::serviceIsoOutTransfers(void) {
   UInt16            hcFrameNumber;
+  SInt16            framesUntilStart;
+  UInt32            nextFrames;
   OHCIEndpointData  *currEndpoint;
   OHCITransferData  *currTransfer;
 
+  nextFrames    = 0;
+  hcFrameNumber = USBToHostWord(_hccaPtr->frameNumber);
+
   //
   // Iterate through each outbound isochronous endpoint and check for transfer descriptors that are about to be sent.
   //
@@ -349,17 +462,19 @@ void WiiOHCI::handleIsoOutTimer(IOTimerEventSource *sender) {
     // Iterate through each transfer descriptor.
     //
     while (currTransfer != currEndpoint->transferTail) {
-      //
-      // Check if transfer hasn't already been copied, and is going to be transferred shortly if outbound.
-      //
-      hcFrameNumber = USBToHostWord(_hccaPtr->frameNumber);
-      if ((currTransfer->direction == kUSBOut) && !currTransfer->isoBufferCopied && (currTransfer->isoFrameStart > hcFrameNumber)) { // TODO: Better calculation here
-        if ((currTransfer->isoFrameStart - hcFrameNumber) < 3) {
+      if ((currTransfer->direction == kUSBOut) && !currTransfer->isoBufferCopied) {
+        //
+        // Copy if the transfer will be sent shortly, or is already late.
+        // Frame numbers are 16-bit and wrap.
+        //
+        framesUntilStart = (SInt16) (currTransfer->isoFrameStart - hcFrameNumber);
+        if (framesUntilStart < kWiiOHCIIsoOutPrefillFrames) {
           if (currTransfer->srcBuffer != NULL) {
-            currTransfer->srcBuffer->readBytes(0, currTransfer->bounceBuffer->buf, currTransfer->actualBufferSize);
-            flushDataCache(currTransfer->bounceBuffer->buf, currTransfer->actualBufferSize);
+            readToDMABuffer(currTransfer->srcBuffer, 0, currTransfer->bounceBuffer->buf, currTransfer->actualBufferSize);
           }
           currTransfer->isoBufferCopied = true;
+        } else if ((nextFrames == 0) || ((UInt32) (framesUntilStart - kWiiOHCIIsoOutPrefillFrames + 1) < nextFrames)) {
+          nextFrames = framesUntilStart - kWiiOHCIIsoOutPrefillFrames + 1;
         }
       }
 
@@ -369,12 +484,180 @@ void WiiOHCI::handleIsoOutTimer(IOTimerEventSource *sender) {
     currEndpoint = currEndpoint->nextEndpoint;
   }
 
-  _isoOutTimerEventSource->setTimeoutUS(kWiiOHCIIsoTimerRefreshUS);
+  //
+  // Arm the timer only if there are still transfers waiting to be copied.
+  // Each frame is 1ms.
+  //
+  _isoOutPrefillPending = (nextFrames > 0);
+  if (_isoOutPrefillPending) {
+    _isoOutTimerEventSource->setTimeoutMS(nextFrames);
+  } else {
+    _isoOutTimerEventSource->cancelTimeout();
+  }
+}
+
+//
+// Publishes the inbound isochronous servicing statistics.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiOHCI::publishIsoInStatistics(void) {
+  OSArray   *histogram;
+  OSNumber  *count;
+
+  histogram = OSArray::withCapacity(kWiiOHCIIsoLatencyBucketCount);
+  if (histogram == NULL) {
+    return;
+  }
+
+  for (UInt32 i = 0; i < kWiiOHCIIsoLatencyBucketCount; i++) {
+    count = OSNumber::withNumber(_isoInLatencyHistogram[i], 32);
+    if (count == NULL) {
+      histogram->release();
+      return;
+    }
+    histogram->setObject(count);
+    count->release();
+  }
+
+  setProperty(kWiiOHCIIsoInLatencyHistogramKey, histogram);
+  setProperty(kWiiOHCIIsoInServicedInterruptKey, _isoInServicedInterrupt, 32);
+  setProperty(kWiiOHCIIsoInServicedTimerKey, _isoInServicedTimer, 32);
+  histogram->release();
+}
+
+//
+// Publishes the total timebase ticks spent walking the done queue in the primary interrupt, and the transfers walked.
+// Dividing the two gives the per transfer descriptor cost for the active descriptor cache mode.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiOHCI::publishDoneQueueStatistics(void) {
+  UInt32 ticks;
+  UInt32 transfers;
+
+  ticks     = _doneQueuePendingTicks;
+  transfers = _doneQueuePendingTransfers;
+  OSAddAtomic(-((SInt32) ticks), (volatile SInt32 *) &_doneQueuePendingTicks);
+  OSAddAtomic(-((SInt32) transfers), (volatile SInt32 *) &_doneQueuePendingTransfers);
+
+  _doneQueueTimebaseTicks        += ticks;
+  _doneQueueTransfers            += transfers;
+  _doneQueueStatsPublishTimebase  = getProcessorTimebase();
+
+  setProperty(kWiiOHCIDoneQueueTimebaseTicksKey, _doneQueueTimebaseTicks, 64);
+  setProperty(kWiiOHCIDoneQueueTransfersKey, _doneQueueTransfers, 64);
+}
+
+//
+// Handles isochronous inbound timer events.
+//
+// This function is gated and called within the workloop context.
+// This timer is running when isochronous endpoints are present, and only catches transfers missed by the interrupt.
+//
+void WiiOHCI::handleIsoInTimer(IOTimerEventSource *sender) {
+  serviceIsoInTransfers(true);
+
+  //
+  // Periodically publish statistics.
+  //
+  _isoInStatsPublishTicks++;
+  if (_isoInStatsPublishTicks >= (kWiiOHCIIsoStatsPublishIntervalMS / kWiiOHCIIsoInSafetyTimerMS)) {
+    _isoInStatsPublishTicks = 0;
+    publishIsoInStatistics();
+  }
+
+  _isoInTimerEventSource->setTimeoutMS(kWiiOHCIIsoInSafetyTimerMS);
+}
+
+//
+// Handles isochronous outbound timer events.
+//
+// This function is gated and called within the workloop context.
+// This timer is only armed when outbound transfers are waiting to enter the prefill window.
+//
+void WiiOHCI::handleIsoOutTimer(IOTimerEventSource *sender) {
+  serviceIsoOutTransfers();
 }
 
 //
 // Overrides IOUSBController::PollInterrupts().
 //
+// Processes completed transfers without waiting for the interrupt, used by the debugger and during panic or shutdown.
+// Only transfers whose completion is the safe action are completed, others are left for the interrupt handler.
+//
 void WiiOHCI::PollInterrupts(IOUSBCompletionAction safeAction) {
-  WIIDBGLOG("start");
+  OHCITransferData  *currTransfer;
+  OHCITransferData  *nextTransfer;
+  OHCITransferData  *safeHeadTransfer;
+  OHCITransferData  *safeTailTransfer;
+  OHCITransferData  *deferredTailTransfer;
+  OHCITransferData  *checkTransfer;
+  bool              safe;
+
+  //
+  // Run the filter to take the done queue from the controller, it signals the workloop for everything else.
+  //
+  filterInterrupt(_interruptEventSource);
+  if (!_intWriteDoneHead && (_pollDeferredHead == NULL)) {
+    return;
+  }
+  _intWriteDoneHead = false;
+
+  //
+  // Without a safe action everything is completed, as the interrupt handler would.
+  //
+  if (safeAction == NULL) {
+    serviceIsoInTransfers(false);
+    completeTransferQueue(takeDoneQueue());
+    return;
+  }
+
+  //
+  // Split the queue into the safe transfers and those left for the workloop.
+  // Each transfer descriptor carries the completion of its transaction, isochronous transfers are never safe.
+  // Once a transfer on an endpoint is left, later transfers on it are left too so they still complete in order.
+  //
+  safeHeadTransfer     = NULL;
+  safeTailTransfer     = NULL;
+  deferredTailTransfer = NULL;
+  currTransfer         = takeDoneQueue();
+  while (currTransfer != NULL) {
+    nextTransfer = currTransfer->nextTransfer;
+
+    safe = (currTransfer->type == kOHCITransferTypeGeneral) && (currTransfer->genCompletion.action == safeAction);
+    for (checkTransfer = _pollDeferredHead; safe && (checkTransfer != NULL); checkTransfer = checkTransfer->nextTransfer) {
+      if (checkTransfer->endpoint == currTransfer->endpoint) {
+        safe = false;
+      }
+    }
+
+    currTransfer->nextTransfer = NULL;
+    if (safe) {
+      if (safeTailTransfer == NULL) {
+        safeHeadTransfer = currTransfer;
+      } else {
+        safeTailTransfer->nextTransfer = currTransfer;
+      }
+      safeTailTransfer = currTransfer;
+    } else {
+      if (deferredTailTransfer == NULL) {
+        _pollDeferredHead = currTransfer;
+      } else {
+        deferredTailTransfer->nextTransfer = currTransfer;
+      }
+      deferredTailTransfer = currTransfer;
+    }
+
+    currTransfer = nextTransfer;
+  }
+  completeTransferQueue(safeHeadTransfer);
+
+  //
+  // Have the workloop pick up any transfers that were not safe to complete here.
+  //
+  if (_pollDeferredHead != NULL) {
+    _intWriteDoneHead = true;
+    _interruptEventSource->signalInterrupt();
+  }
 }
@@ -0,0 +1,150 @@
+//
+//  WiiOHCI_Trace.cpp
+//  Wii OHCI USB controller interface
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "WiiOHCI.hpp"
+
+//
+// Records a trace event into the ring.
+// Events are dropped if the ring is full, the user client has not kept up.
+//
+// This function is gated and called within the workloop context.
+//
+void WiiOHCI::recordTraceEvent(UInt8 event, OHCIEndpointData *endpoint, UInt32 id, UInt32 length,
+                               UInt32 actualLength, IOReturn status, UInt8 conditionCode) {
+  WiiOHCITraceRecord *record;
+
+  if ((_traceHead - _traceTail) >= kWiiOHCITraceRecordCount) {
+    _traceDropped++;
+    return;
+  }
+
+  record = &_traceRecords[_traceHead % kWiiOHCITraceRecordCount];
+  record->timebase      = getProcessorTimebase();
+  record->id            = id;
+  record->length        = length;
+  record->actualLength  = actualLength;
+  record->status        = status;
+  record->key           = endpoint->key;
+  record->frameNumber   = USBToHostWord(_hccaPtr->frameNumber);
+  record->event         = event;
+  record->type          = endpoint->type;
+  record->conditionCode = conditionCode;
+  record->reserved      = 0;
+  _traceHead++;
+}
+
+//
+// Allocates the trace ring and starts recording.
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiOHCI::startTraceGated(void) {
+  if (_traceRecords != NULL) {
+    return kIOReturnExclusiveAccess;
+  }
+
+  _traceRecords = (WiiOHCITraceRecord *) IOMalloc(sizeof (WiiOHCITraceRecord) * kWiiOHCITraceRecordCount);
+  if (_traceRecords == NULL) {
+    return kIOReturnNoMemory;
+  }
+  _traceHead    = 0;
+  _traceTail    = 0;
+  _traceDropped = 0;
+
+  WIIDBGLOG("Started transaction tracing");
+  return kIOReturnSuccess;
+}
+
+//
+// Stops recording and frees the trace ring.
+// Transactions in flight complete without trace IDs being recorded.
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiOHCI::stopTraceGated(void) {
+  if (_traceRecords == NULL) {
+    return kIOReturnNotOpen;
+  }
+
+  IOFree(_traceRecords, sizeof (WiiOHCITraceRecord) * kWiiOHCITraceRecordCount);
+  _traceRecords = NULL;
+
+  WIIDBGLOG("Stopped transaction tracing, %u events dropped", _traceDropped);
+  return kIOReturnSuccess;
+}
+
+//
+// Copies pending records out of the trace ring.
+// On input count is the number of records that fit, on output the number copied.
+//
+// This function is gated and called within the workloop context.
+//
+IOReturn WiiOHCI::readTraceGated(WiiOHCITraceRecord *records, UInt32 *count) {
+  UInt32 copied;
+
+  if (_traceRecords == NULL) {
+    return kIOReturnNotOpen;
+  }
+
+  copied = 0;
+  while ((copied < *count) && (_traceTail != _traceHead)) {
+    records[copied++] = _traceRecords[_traceTail % kWiiOHCITraceRecordCount];
+    _traceTail++;
+  }
+
+  *count = copied;
+  return kIOReturnSuccess;
+}
+
+//
+// Starts transaction tracing.
+//
+IOReturn WiiOHCI::startTrace(void) {
+  return _commandGate->runAction(
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+    OSMemberFunctionCast(IOCommandGate::Action, this, &WiiOHCI::startTraceGated));
+#else
+    (IOCommandGate::Action) &WiiOHCI::startTraceGated);
+#endif
+}
+
+//
+// Stops transaction tracing.
+//
+void WiiOHCI::stopTrace(void) {
+  _commandGate->runAction(
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+    OSMemberFunctionCast(IOCommandGate::Action, this, &WiiOHCI::stopTraceGated));
+#else
+    (IOCommandGate::Action) &WiiOHCI::stopTraceGated);
+#endif
+}
+
+//
+// Reads pending trace records.
+//
+IOReturn WiiOHCI::readTrace(WiiOHCITraceRecord *records, UInt32 *count) {
+  if ((records == NULL) || (count == NULL)) {
+    return kIOReturnBadArgument;
+  }
+
+  return _commandGate->runAction(
+#if __MAC_OS_X_VERSION_MIN_REQUIRED >= __MAC_10_2
+    OSMemberFunctionCast(IOCommandGate::Action, this, &WiiOHCI::readTraceGated),
+#else
+    (IOCommandGate::Action) &WiiOHCI::readTraceGated,
+#endif
+    records, count);
+}
+
+//
+// Gets the timebase frequency and number of dropped trace records.
+//
+void WiiOHCI::getTraceInfo(UInt32 *ticksPerUS, UInt32 *dropped) {
+  *ticksPerUS = _timebaseTicksPerUS;
+  *dropped    = _traceDropped;
+}
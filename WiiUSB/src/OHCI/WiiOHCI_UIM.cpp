@@ -7,6 +7,18 @@
 
 #include "WiiOHCI.hpp"
 
+//
+// Control transfer descriptor flags for each stage, indexed by direction.
+// SETUP should have only bit 1 on.
+// DATA will have bit 0 as well, alternating on and off for additional data packets.
+// STATUS will always have bit 1 and 0.
+//
+static const UInt32 kWiiOHCIControlTDFlags[] = {
+  kOHCIGenTDFlagsDirectionOut | kOHCIGenTDFlagsDataToggleData1 | kOHCIGenTDFlagsDataToggleData0,  // kUSBOut
+  kOHCIGenTDFlagsDirectionIn | kOHCIGenTDFlagsDataToggleData1 | kOHCIGenTDFlagsDataToggleData0,   // kUSBIn
+  kOHCIGenTDFlagsDirectionSetup | kOHCIGenTDFlagsDataToggleData1                                  // kUSBNone
+};
+
 //
 // Submits a general transfer to be executed by the OHCI controller.
 //
@@ -19,15 +31,19 @@ IOReturn WiiOHCI::doGeneralTransfer(OHCIEndpointData *endpoint, IOUSBCompletion
   UInt32            bufferRemaining;
   UInt32            transferSize;
   UInt32            offset;
+  UInt32            traceId;
 
   //
   // Ensure the endpoint is not halted.
+  // A halt from a failed transfer waiting on the retire list is cleared or kept when it is processed.
   //
-  if (USBToHostLong(endpoint->ed->headTDPhysAddr) & kOHCIEDTDHeadHalted) {
+  if ((USBToHostLong(endpoint->ed->headTDPhysAddr) & kOHCIEDTDHeadHalted) && ((endpoint->retireFlags & kWiiOHCIRetireFailed) == 0)) {
     WIISYSLOG("Pipe is stalled (EP Flags: 0x%X)", USBToHostLong(endpoint->ed->flags));
     return kIOUSBPipeStalled;
   }
 
+  traceId = getTraceId();
+
   flags &= ~(kOHCIGenTDFlagsConditionCodeMask);
   flags |= ((kOHCITDConditionCodeNotAccessed << kOHCIGenTDFlagsConditionCodeShift) & kOHCIGenTDFlagsConditionCodeMask);
 
@@ -49,39 +65,65 @@ IOReturn WiiOHCI::doGeneralTransfer(OHCIEndpointData *endpoint, IOUSBCompletion
 
       //
       // Get a bounce buffer.
+      // Control stages that fit in a single packet, including all setup packets, use a control slot instead.
       //
-      genTransferCurr->bounceBuffer = getFreeBounceBuffer(bufferRemaining > kWiiOHCIBounceBufferSize);
+      if ((endpoint->type == kWiiOHCIEndpointTypeControl) && (bufferRemaining <= kWiiOHCIControlSlotSize)) {
+        genTransferCurr->bounceBuffer = getFreeControlSlot();
+      } else {
+        genTransferCurr->bounceBuffer = getFreeBounceBuffer(bufferRemaining > kWiiOHCIBounceBufferSize);
+      }
+      if (genTransferCurr->bounceBuffer == NULL) {
+        return kIOReturnNoMemory;
+      }
 
       if (genTransferCurr->bounceBuffer->jumbo) {
+        endpoint->statJumboBounceBuffers++;
         transferSize = (bufferRemaining > kWiiOHCIBounceBufferJumboSize) ? kWiiOHCIBounceBufferJumboSize : bufferRemaining;
       } else {
         transferSize = (bufferRemaining > kWiiOHCIBounceBufferSize) ? kWiiOHCIBounceBufferSize : bufferRemaining;
       }
-      genTransferCurr->srcBuffer = IOMemoryDescriptor::withSubRange(buffer, offset, transferSize, buffer->getDirection());
-      if (genTransferCurr->srcBuffer == NULL) {
-        WIISYSLOG("Failed to get sub memory descriptor");
-        return kIOReturnDMAError;
+
+      //
+      // Buffers that fit in a single transfer descriptor are used as is, no sub range is needed.
+      //
+      if (transferSize == bufferSize) {
+        buffer->retain();
+        genTransferCurr->srcBuffer = buffer;
+      } else {
+        genTransferCurr->srcBuffer = IOMemoryDescriptor::withSubRange(buffer, offset, transferSize, buffer->getDirection());
+        if (genTransferCurr->srcBuffer == NULL) {
+          WIISYSLOG("Failed to get sub memory descriptor");
+          return kIOReturnDMAError;
+        }
       }
 
       //
       // Copy data to bounce buffer if writing to a USB device.
       // This is located in MEM2, MEM1 buffers can work but seem to have issues with non-aligned buffers
       // and buffers not a multiple of 4 on Wii.
+      // In locked cache copy mode, cache line aligned data is moved by the locked cache DMA engine instead.
       //
       if (genTransferCurr->srcBuffer->getDirection() & kIODirectionOut) {
-        if (genTransferCurr->srcBuffer->readBytes(0, genTransferCurr->bounceBuffer->buf, transferSize) != transferSize) {
+        if (moveToBounceBuffer(genTransferCurr->srcBuffer, genTransferCurr->bounceBuffer, transferSize)) {
+          endpoint->statLockedCacheMoves++;
+        } else if (readToDMABuffer(genTransferCurr->srcBuffer, 0, genTransferCurr->bounceBuffer->buf, transferSize) != transferSize) {
           WIISYSLOG("Failed to copy all bytes into bounce buffer");
           return kIOReturnDMAError;
         }
-        flushDataCache(genTransferCurr->bounceBuffer->buf, transferSize);
       }
 
       offset          += transferSize;
       bufferRemaining -= transferSize;
+      //
+      // Every descriptor carries the completion so PollInterrupts() can tell which are safe, only the last one calls it.
+      //
+      genTransferCurr->genCompletion = completion;
       if (offset >= bufferSize) {
-        genTransferCurr->genTD->flags  = HostToUSBLong(flags);
-        genTransferCurr->genCompletion = completion;
-        genTransferCurr->last          = true;
+        genTransferCurr->genTD->flags      = HostToUSBLong(flags);
+        genTransferCurr->genSubmitTimebase = getProcessorTimebase();
+        genTransferCurr->traceId           = traceId;
+        genTransferCurr->traceLength       = bufferSize;
+        genTransferCurr->last              = true;
       } else {
         genTransferCurr->genTD->flags  = HostToUSBLong(flags & ~(kOHCIGenTDFlagsBufferRounding));
         genTransferCurr->last          = false;
@@ -95,6 +137,7 @@ IOReturn WiiOHCI::doGeneralTransfer(OHCIEndpointData *endpoint, IOUSBCompletion
 
       WIIDBGLOG("GenTD phys: 0x%X, next 0x%X, buf 0x%X, ep 0x%X, frm 0x%X", genTransferCurr->physAddr, USBToHostLong(genTransferCurr->genTD->nextTDPhysAddr),
         USBToHostLong(genTransferCurr->genTD->currentBufferPtrPhysAddr), endpoint->physAddr, readReg32(kOHCIRegFmNumber));
+      flushTransferDescriptor(genTransferCurr);
 
       endpoint->transferTail       = genTransferTail;
       endpoint->ed->tailTDPhysAddr = HostToUSBLong(genTransferTail->physAddr);
@@ -121,19 +164,56 @@ IOReturn WiiOHCI::doGeneralTransfer(OHCIEndpointData *endpoint, IOUSBCompletion
     genTransferCurr->actualBufferSize                = 0;
     genTransferCurr->srcBuffer                       = NULL;
     genTransferCurr->genCompletion                   = completion;
+    genTransferCurr->genSubmitTimebase               = getProcessorTimebase();
+    genTransferCurr->traceId                         = traceId;
     genTransferCurr->nextTransfer                    = genTransferTail;
     genTransferCurr->last                            = true;
 
     WIIDBGLOG("Added non-data gen TD phys 0x%X, next 0x%X", genTransferCurr->physAddr, USBToHostLong(genTransferCurr->genTD->nextTDPhysAddr));
+    flushTransferDescriptor(genTransferCurr);
 
     endpoint->transferTail       = genTransferTail;
     endpoint->ed->tailTDPhysAddr = HostToUSBLong(genTransferTail->physAddr);
     writeReg32(kOHCIRegCmdStatus, cmdBits);
   }
 
+  traceEvent(kWiiOHCITraceEventSubmit, endpoint, traceId, bufferSize);
   return kIOReturnSuccess;
 }
 
+//
+// Gets the physical address of a low latency inbound isochronous buffer the controller can write to directly.
+// Returns zero if a bounce buffer must be used instead.
+//
+UInt32 WiiOHCI::getIsoInDirectPhysAddr(IOMemoryDescriptor *buffer, UInt32 transferSize) {
+  IOPhysicalAddress physAddr;
+  IOByteCount       length;
+
+  if (transferSize == 0) {
+    return 0;
+  }
+
+  //
+  // Buffer must be physically contiguous, and an isochronous descriptor can only cross a single page boundary.
+  //
+  physAddr = buffer->getPhysicalSegment(0, &length);
+  if ((physAddr == 0) || (length < transferSize) || (((physAddr & PAGE_MASK) + transferSize) > (PAGE_SIZE * 2))) {
+    return 0;
+  }
+
+  //
+  // Same restrictions as bounce buffers, MEM1 DMA has issues with non-aligned buffers on Wii.
+  //
+  if (physAddr & (sizeof (UInt32) - 1)) {
+    return 0;
+  }
+  if (!checkPlatformCafe() && ((physAddr < kWiiOHCIMem2PhysStart) || ((physAddr + transferSize) > kWiiOHCIMem2PhysEnd))) {
+    return 0;
+  }
+
+  return physAddr;
+}
+
 //
 // Prepares the bounce buffer and descriptor for an isochronous transfer.
 //
@@ -141,6 +221,7 @@ IOReturn WiiOHCI::doGeneralTransfer(OHCIEndpointData *endpoint, IOUSBCompletion
 //
 IOReturn WiiOHCI::prepareIsochTransfer(OHCITransferData *transfer, IOMemoryDescriptor *buffer, UInt32 offset, UInt32 transferSize,
                                        UInt16 numPackets, UInt32 flags) {
+  UInt32 bufferPhysAddr;
   UInt32 bufferPage;
   UInt16 packetOffset;
 
@@ -148,14 +229,8 @@ IOReturn WiiOHCI::prepareIsochTransfer(OHCITransferData *transfer, IOMemoryDescr
     offset, transferSize, flags & kOHCIIsoTDFlagsStartingFrameMask, numPackets);
 
   //
-  // Create bounce buffer and grab the source buffer.
-  // Data will be copied in later just before the frame is sent.
+  // Grab and wire the source buffer.
   //
-  transfer->bounceBuffer = getFreeBounceBuffer(transferSize > kWiiOHCIBounceBufferSize);
-  if (transfer->bounceBuffer == NULL) {
-    WIISYSLOG("Failed to get a bounce buffer");
-    return kIOReturnDMAError;
-  }
   transfer->srcBuffer = IOMemoryDescriptor::withSubRange(buffer, offset, transferSize, buffer->getDirection());
   if (transfer->srcBuffer == NULL) {
     WIISYSLOG("Failed to get sub memory descriptor");
@@ -163,15 +238,40 @@ IOReturn WiiOHCI::prepareIsochTransfer(OHCITransferData *transfer, IOMemoryDescr
   }
   transfer->srcBuffer->prepare();
 
-  transfer->isoBufferCopied  = false;
-  transfer->actualBufferSize = transferSize;
+  transfer->isoBufferCopied   = false;
+  transfer->isoDirectPhysAddr = 0;
+  transfer->actualBufferSize  = transferSize;
+
+  //
+  // Low latency inbound transfers can target the client buffer directly.
+  // Any dirty lines are written back now so they cannot overwrite the received data later.
+  //
+  if (_isoInDirect && (transfer->type == kOHCITransferTypeIsochronousLowLatency) && (transfer->direction == kUSBIn)) {
+    transfer->isoDirectPhysAddr = getIsoInDirectPhysAddr(transfer->srcBuffer, transferSize);
+  }
+
+  if (transfer->isoDirectPhysAddr != 0) {
+    flushDataCachePhys(transfer->isoDirectPhysAddr, transferSize);
+    bufferPhysAddr = transfer->isoDirectPhysAddr;
+  } else {
+    //
+    // Create bounce buffer.
+    // Data will be copied in later just before the frame is sent.
+    //
+    transfer->bounceBuffer = getFreeBounceBuffer(transferSize > kWiiOHCIBounceBufferSize);
+    if (transfer->bounceBuffer == NULL) {
+      WIISYSLOG("Failed to get a bounce buffer");
+      return kIOReturnDMAError;
+    }
+    bufferPhysAddr = transfer->bounceBuffer->physAddr;
+  }
 
   //
   // Calculate offsets for packets.
-  // Each one will be consecutive in the bounce buffer.
+  // Each one will be consecutive in the buffer.
   //
-  bufferPage   = transfer->bounceBuffer->physAddr & ~(PAGE_MASK);
-  packetOffset = ((UInt16) (transfer->bounceBuffer->physAddr & PAGE_MASK));
+  bufferPage   = bufferPhysAddr & ~(PAGE_MASK);
+  packetOffset = ((UInt16) (bufferPhysAddr & PAGE_MASK));
   for (UInt32 i = 0; i < numPackets; i++) {
     transfer->isoTD->packetOffsetStatus[i] = HostToUSBWord(
       (packetOffset & kOHCIIsoTDPktOffsetMask) |
@@ -223,8 +323,8 @@ IOReturn WiiOHCI::doIsochTransfer(short functionAddress, short endpointNumber, I
   UInt32            offset;
   UInt32            currReqFrameIndex;
   UInt32            currPacketIndex;
-  UInt16            currPacketOffset;
   UInt32            currReqFrameSize;
+  UInt32            traceId;
   IOReturn          status;
 
   if ((frameCount == 0) || (frameCount > 1000)) {
@@ -261,7 +361,8 @@ IOReturn WiiOHCI::doIsochTransfer(short functionAddress, short endpointNumber, I
   //
   // Get the total buffer size.
   //
-  bufferSize = 0;
+  bufferSize   = 0;
+  framesLowPtr = NULL;
   if (isLowLatency) {
     framesLowPtr = (IOUSBLowLatencyIsocFrame *) pFrames;
     for (UInt32 i = 0; i < frameCount; i++) {
@@ -292,6 +393,7 @@ IOReturn WiiOHCI::doIsochTransfer(short functionAddress, short endpointNumber, I
 
   currTransfer    = endpoint->transferTail;
   currPacketIndex = 0;
+  traceId         = getTraceId();
 
   //
   // Iterate through frames and construct transfer descriptors.
@@ -299,6 +401,7 @@ IOReturn WiiOHCI::doIsochTransfer(short functionAddress, short endpointNumber, I
   currReqFrameIndex = 0;
   transferSize      = 0;
   offset            = 0;
+  flags             = 0;
   status            = kIOReturnSuccess;
   while (currReqFrameIndex < frameCount) {
     currReqFrameSize = (isLowLatency ? framesLowPtr[currReqFrameIndex].frReqCount : pFrames[currReqFrameIndex].frReqCount);
@@ -324,6 +427,7 @@ IOReturn WiiOHCI::doIsochTransfer(short functionAddress, short endpointNumber, I
       currTransfer->last                  = false;
       currTransfer->nextTransfer          = tailTransfer;
       currTransfer->isoTD->nextTDPhysAddr = HostToUSBLong(tailTransfer->physAddr);
+      flushTransferDescriptor(currTransfer);
 
       currTransfer    = tailTransfer;
       currPacketIndex = 0;
@@ -341,8 +445,10 @@ IOReturn WiiOHCI::doIsochTransfer(short functionAddress, short endpointNumber, I
       currTransfer->isoFrameStart = ((UInt16) (currReqFrameIndex + (UInt16) frameStart)) & kOHCIIsoTDFlagsStartingFrameMask;
       flags = currTransfer->isoFrameStart & kOHCIIsoTDFlagsStartingFrameMask;
 
-      currTransfer->type      = isLowLatency ? kOHCITransferTypeIsochronousLowLatency : kOHCITransferTypeIsochronous;
-      currTransfer->direction = direction;
+      currTransfer->type        = isLowLatency ? kOHCITransferTypeIsochronousLowLatency : kOHCITransferTypeIsochronous;
+      currTransfer->direction   = direction;
+      currTransfer->traceId     = traceId;
+      currTransfer->traceLength = bufferSize;
       if (isLowLatency) {
         currTransfer->isoLowFrames = framesLowPtr;
       } else {
@@ -385,14 +491,24 @@ IOReturn WiiOHCI::doIsochTransfer(short functionAddress, short endpointNumber, I
 
   currTransfer->nextTransfer          = tailTransfer;
   currTransfer->isoTD->nextTDPhysAddr = HostToUSBLong(tailTransfer->physAddr);
+  flushTransferDescriptor(currTransfer);
+
+  //
+  // Prefill outbound bounce buffers for transfers starting shortly, before the controller can see them.
+  // Later transfers are filled as earlier ones complete, or by the timer.
+  //
+  endpoint->transferTail = tailTransfer;
+  if (direction == kUSBOut) {
+    serviceIsoOutTransfers();
+  }
 
   //
   // Update the tail on the endpoint to process these newly-linked descriptors.
   // Isochronous is a periodic transfer, no status bits to flip to indicate new data.
   //
-  endpoint->transferTail       = tailTransfer;
   endpoint->ed->tailTDPhysAddr = HostToUSBLong(tailTransfer->physAddr);
 
+  traceEvent(kWiiOHCITraceEventSubmit, endpoint, traceId, bufferSize);
   return kIOReturnSuccess;
 }
 
@@ -432,6 +548,7 @@ void WiiOHCI::completeGeneralTransfer(OHCITransferData *transfer) {
       USBToHostLong(buf[4]), USBToHostLong(buf[5]), USBToHostLong(buf[6]), USBToHostLong(buf[7]));
   }
 
+  updateEndpointStatistics(transfer->endpoint, tdStatus, transfer->actualBufferSize - bufferSizeRemaining);
   if (tdStatus != kIOReturnSuccess && tdStatus != kIOReturnUnderrun) {
     WIIDBGLOG("GenTD failed status: 0x%X, ep flags 0x%X, last %u", tdStatus, USBToHostLong(transfer->endpoint->ed->flags), transfer->last);
   }
@@ -441,16 +558,21 @@ void WiiOHCI::completeGeneralTransfer(OHCITransferData *transfer) {
   //
   if (transfer->last) {
     WIIDBGLOG("Calling completion");
+    completeEndpointStatistics(transfer->endpoint, transfer->genSubmitTimebase);
+    traceEvent(kWiiOHCITraceEventComplete, transfer->endpoint, transfer->traceId, transfer->traceLength,
+      transfer->traceLength - bufferSizeRemaining, tdStatus, transferStatus);
     Complete(transfer->genCompletion, tdStatus, bufferSizeRemaining);
   } else {
     WIIDBGLOG("No completion");
 
     //
-    // If there was an error, need to finish the rest of the chain.
+    // If there was an error, need to finish the rest of the chain once the controller has passed this frame.
     //
     if (tdStatus != kIOReturnSuccess) {
       WIIDBGLOG("Completing short packet");
-      completeFailedEndpointGenTransfers(transfer->endpoint, tdStatus, bufferSizeRemaining);
+      transfer->endpoint->retireStatus          = tdStatus;
+      transfer->endpoint->retireBufferRemaining = bufferSizeRemaining;
+      retireEndpoint(transfer->endpoint, kWiiOHCIRetireFailed);
     }
   }
 }
@@ -462,20 +584,19 @@ void WiiOHCI::completeGeneralTransfer(OHCITransferData *transfer) {
 //
 void WiiOHCI::completeIsochTransfer(OHCITransferData *transfer, IOReturn status) {
   UInt32    hcStatus;
-  UInt32    bufferSizeRemaining;
   UInt16    frameCount;
   IOReturn  frameStatus;
-  UInt32    offset;
   UInt16    pktOffStatus;
   bool      underrun;
   IOReturn  aggStatus;
+  UInt32    actualLength;
 
   hcStatus   = (USBToHostLong(transfer->isoTD->flags) & kOHCIIsoTDFlagsConditionCodeMask) >> kOHCIIsoTDFlagsConditionCodeShift;
   frameCount = ((USBToHostLong(transfer->isoTD->flags) & kOHCIIsoTDFlagsFrameCountMask) >> kOHCIIsoTDFlagsFrameCountShift) + 1;
 
-  offset    = 0;
-  underrun  = false;
-  aggStatus = kIOReturnSuccess;
+  underrun     = false;
+  aggStatus    = kIOReturnSuccess;
+  actualLength = 0;
 
   //
   // Overruns indicate a no bandwidth condition per the OHCI spec (see 4.3.2.3.5.3 Time Errors).
@@ -534,6 +655,8 @@ void WiiOHCI::completeIsochTransfer(OHCITransferData *transfer, IOReturn status)
         }
       }
       transfer->isoLowFrames[transfer->isoFrameIndex + i].frStatus = frameStatus;
+      updateEndpointStatistics(transfer->endpoint, frameStatus, transfer->isoLowFrames[transfer->isoFrameIndex + i].frActCount);
+      actualLength += transfer->isoLowFrames[transfer->isoFrameIndex + i].frActCount;
     } else {
       //
       // Check if frame was even accessed.
@@ -571,9 +694,18 @@ void WiiOHCI::completeIsochTransfer(OHCITransferData *transfer, IOReturn status)
         }
       }
       transfer->isoFrames[transfer->isoFrameIndex + i].frStatus = frameStatus;
+      updateEndpointStatistics(transfer->endpoint, frameStatus, transfer->isoFrames[transfer->isoFrameIndex + i].frActCount);
+      actualLength += transfer->isoFrames[transfer->isoFrameIndex + i].frActCount;
     }
   }
 
+  //
+  // Transactions span multiple descriptors, which complete in order on the endpoint.
+  //
+  if (transfer->traceId != 0) {
+    transfer->endpoint->traceActualLength += actualLength;
+  }
+
   //
   // Release source buffer.
   //
@@ -597,6 +729,10 @@ void WiiOHCI::completeIsochTransfer(OHCITransferData *transfer, IOReturn status)
       status = aggStatus;
     }
 
+    completeEndpointStatistics(transfer->endpoint, 0);
+    traceEvent(kWiiOHCITraceEventComplete, transfer->endpoint, transfer->traceId, transfer->traceLength,
+      transfer->endpoint->traceActualLength, status, hcStatus);
+    transfer->endpoint->traceActualLength = 0;
     WIIDBGLOG("IsoTD phys 0x%X, fs %u complete with status 0x%X", transfer->physAddr,
       transfer->isoFrameStart, status);
     (*transfer->isoCompletion.action)(transfer->isoCompletion.target, transfer->isoCompletion.parameter, status, transfer->isoFrames);
@@ -609,7 +745,6 @@ void WiiOHCI::completeIsochTransfer(OHCITransferData *transfer, IOReturn status)
 // This function is gated and called within the workloop context.
 //
 void WiiOHCI::completeTransferQueue(OHCITransferData *headTransfer) {
-  OHCITransferData  *prevTransfer;
   OHCITransferData  *currTransfer;
   OHCITransferData  *nextTransfer;
   UInt8             hcStatus;
@@ -662,7 +797,8 @@ IOReturn WiiOHCI::UIMCreateControlEndpoint(UInt8 functionNumber, UInt8 endpointN
   //
   // Add a new control endpoint.
   //
-  return addNewEndpoint(functionNumber, endpointNumber, maxPacketSize, speed, kUSBAnyDirn, _controlEndpointHeadPtr);
+  return addNewEndpoint(functionNumber, endpointNumber, maxPacketSize, speed, kUSBAnyDirn,
+    _controlEndpointHeadPtr, kWiiOHCIEndpointTypeControl);
 }
 
 //
@@ -733,19 +869,7 @@ IOReturn WiiOHCI::UIMCreateControlTransfer(short functionNumber, short endpointN
     return kIOUSBEndpointNotFound;
   }
 
-  //
-  // SETUP should have only bit 1 on.
-  // DATA will have bit 0 as well, alternating on and off for additional data packets.
-  // STATUS will always have bit 1 and 0.
-  //
-  flags = kOHCIGenTDFlagsDataToggleData1;
-  if (direction == kUSBOut) {
-    flags |= kOHCIGenTDFlagsDirectionOut | kOHCIGenTDFlagsDataToggleData0;
-  } else if (direction == kUSBIn) {
-    flags |= kOHCIGenTDFlagsDirectionIn | kOHCIGenTDFlagsDataToggleData0;
-  } else {
-    flags |= kOHCIGenTDFlagsDirectionSetup;
-  }
+  flags = kWiiOHCIControlTDFlags[((direction == kUSBOut) || (direction == kUSBIn)) ? direction : kUSBNone];
   if (bufferRounding) {
     flags |= kOHCIGenTDFlagsBufferRounding;
   }
@@ -765,13 +889,31 @@ IOReturn WiiOHCI::UIMCreateControlTransfer(short functionNumber, short endpointN
 // This function is gated and called within the workloop context.
 //
 IOReturn WiiOHCI::UIMCreateBulkEndpoint(UInt8 functionNumber, UInt8 endpointNumber, UInt8 direction, UInt8 speed, UInt8 maxPacketSize) {
+  OHCIEndpointData  *endpoint;
+  IOReturn          status;
+
   WIIDBGLOG("F: %d, EP: %u, spd: %s, psz: %u", functionNumber, endpointNumber,
     (speed == kUSBDeviceSpeedFull) ? "full" : "low", maxPacketSize);
 
   //
   // Add a new bulk endpoint.
   //
-  return addNewEndpoint(functionNumber, endpointNumber, maxPacketSize, speed, direction, _bulkEndpointHeadPtr);
+  status = addNewEndpoint(functionNumber, endpointNumber, maxPacketSize, speed, direction,
+    _bulkEndpointHeadPtr, kWiiOHCIEndpointTypeBulk, &endpoint);
+  if (status != kIOReturnSuccess) {
+    return status;
+  }
+
+  //
+  // Inbound endpoints get a streaming ring if enabled, falling back to normal transfers if it cannot be allocated.
+  //
+  if (_bulkStreaming && (direction == kUSBIn)) {
+    if (!createBulkStream(endpoint)) {
+      WIISYSLOG("Failed to create streaming ring for EP phys 0x%X", endpoint->physAddr);
+    }
+  }
+
+  return kIOReturnSuccess;
 }
 
 //
@@ -800,6 +942,13 @@ IOReturn WiiOHCI::UIMCreateBulkTransfer(short functionNumber, short endpointNumb
     return kIOUSBEndpointNotFound;
   }
 
+  //
+  // Streaming endpoints fill requests from the ring.
+  //
+  if (endpoint->stream != NULL) {
+    return queueBulkStreamRequest(endpoint, completion, CBP, bufferSize, bufferRounding);
+  }
+
   flags = 0;
   if (direction == kUSBOut) {
     flags |= kOHCIGenTDFlagsDirectionOut;
@@ -828,7 +977,10 @@ IOReturn WiiOHCI::UIMCreateBulkTransfer(short functionNumber, short endpointNumb
 //
 IOReturn WiiOHCI::UIMCreateInterruptEndpoint(short functionAddress, short endpointNumber, UInt8 direction,
                                              short speed, UInt16 maxPacketSize, short pollingRate) {
-  OHCIEndpointData  *endpointIntHead;
+  OHCIEndpointData  *endpoint;
+  UInt32            bandwidth;
+  UInt8             node;
+  IOReturn          status;
 
   WIIDBGLOG("F: %d, EP: %u, dir: %d, spd: %s, sz: %u, pr: %d", functionAddress, endpointNumber, direction,
     (speed == kUSBDeviceSpeedFull) ? "full" : "low", maxPacketSize, pollingRate);
@@ -841,17 +993,33 @@ IOReturn WiiOHCI::UIMCreateInterruptEndpoint(short functionAddress, short endpoi
   }
 
   //
-  // Get the correct head for the desired polling rate.
+  // Get the least loaded node for the desired polling rate.
   //
-  endpointIntHead = getInterruptEndpointHead(pollingRate);
-  if (endpointIntHead == NULL) {
+  bandwidth = maxPacketSize + kWiiOHCIInterruptOverheadBytes;
+  if (speed == kUSBDeviceSpeedLow) {
+    bandwidth *= kWiiOHCILowSpeedCostMultiplier;
+  }
+  node = getInterruptNode(pollingRate, bandwidth);
+  if (node == kWiiOHCIInterruptNodeNone) {
     return kIOReturnNoBandwidth;
   }
 
   //
-  // Create an endpoint linked to the desired polling rate head.
+  // Create an endpoint linked to the node.
   //
-  return addNewEndpoint(functionAddress, endpointNumber, maxPacketSize, speed, direction, endpointIntHead);
+  status = addNewEndpoint(functionAddress, endpointNumber, maxPacketSize, speed, direction,
+    _interruptEndpoints[node].headEndpoint, kWiiOHCIEndpointTypeInterrupt, &endpoint);
+  if (status != kIOReturnSuccess) {
+    return status;
+  }
+
+  endpoint->interruptNode             = node;
+  endpoint->bandwidth                 = bandwidth;
+  _interruptEndpoints[node].bandwidth += bandwidth;
+  WIIDBGLOG("Placed interrupt EP phys: 0x%X in node %u, bandwidth: %u", endpoint->physAddr, node, bandwidth);
+
+  publishInterruptLoadMap();
+  return kIOReturnSuccess;
 }
 
 //
@@ -944,6 +1112,10 @@ IOReturn WiiOHCI::UIMCreateIsochEndpoint(short functionAddress, short endpointNu
         WIIDBGLOG("No remaining iso bandwidth for sz: %u, available: %u", diffMaxPacketSize, _isoBandwidthAvailable);
         return kIOReturnNoBandwidth;
       }
+      if ((getIsoBandwidthReserved() + diffMaxPacketSize + getInterruptPeakLoad()) > kWiiOHCIPeriodicBandwidthBudget) {
+        WIIDBGLOG("No remaining periodic bandwidth for sz: %u, interrupt peak load: %u", diffMaxPacketSize, getInterruptPeakLoad());
+        return kIOReturnNoBandwidth;
+      }
       _isoBandwidthAvailable -= diffMaxPacketSize;
 
     //
@@ -967,25 +1139,27 @@ IOReturn WiiOHCI::UIMCreateIsochEndpoint(short functionAddress, short endpointNu
     WIIDBGLOG("No remaining iso bandwidth for sz: %u, available: %u", maxPacketSize, _isoBandwidthAvailable);
     return kIOReturnNoBandwidth;
   }
+  if ((getIsoBandwidthReserved() + maxPacketSize + getInterruptPeakLoad()) > kWiiOHCIPeriodicBandwidthBudget) {
+    WIIDBGLOG("No remaining periodic bandwidth for sz: %u, interrupt peak load: %u", maxPacketSize, getInterruptPeakLoad());
+    return kIOReturnNoBandwidth;
+  }
   firstEndpoint = (_isoEndpointHeadPtr->nextEndpoint == _isoEndpointTailPtr);
 
   //
   // Add new isochronous endpoint.
   //
   status = addNewEndpoint(functionAddress, endpointNumber, maxPacketSize, kUSBDeviceSpeedFull,
-    direction, _isoEndpointHeadPtr, true);
+    direction, _isoEndpointHeadPtr, kWiiOHCIEndpointTypeIsochronous);
   if (status != kIOReturnSuccess) {
     return status;
   }
 
   //
-  // Startup the isochronous refresh timers if this is the first endpoint. TODO: Maybe can run only applicable timers.
+  // Startup the isochronous inbound safety timer if this is the first endpoint.
+  // The outbound timer is armed on demand as transfers are submitted.
   //
   if (firstEndpoint) {
-    _isoInTimerEventSource->enable();
-    _isoOutTimerEventSource->enable();
-    _isoInTimerEventSource->setTimeoutUS(kWiiOHCIIsoTimerRefreshUS);
-    _isoOutTimerEventSource->setTimeoutUS(kWiiOHCIIsoTimerRefreshUS);
+    _isoInTimerEventSource->setTimeoutMS(kWiiOHCIIsoInSafetyTimerMS);
   }
 
   _isoBandwidthAvailable -= maxPacketSize;
@@ -1033,16 +1207,14 @@ IOReturn WiiOHCI::UIMAbortEndpoint(short functionNumber, short endpointNumber, s
   WIIDBGLOG("Aborting EP phys: 0x%X", endpoint->physAddr);
 
   //
-  // Mark endpoint as skipped and wait until next frame.
-  //
-  endpoint->ed->flags |= HostToUSBLong(kOHCIEDFlagsSkip);
-  IOSleep(2);
-
-  //
-  // Remove all transfers associated with endpoint and re-activate the endpoint.
+  // Skip the endpoint, transfers queued so far are completed as aborted after the next frame.
+  // The endpoint is re-activated afterwards with any transfers queued in the meantime.
   //
-  removeEndpointTransfers(endpoint);
-  endpoint->ed->flags &= ~(HostToUSBLong(kOHCIEDFlagsSkip));
+  if (endpoint->stream != NULL) {
+    abortBulkStream(endpoint);
+  }
+  endpoint->retireTail = endpoint->transferTail;
+  retireEndpoint(endpoint, kWiiOHCIRetireAbort);
 
   return kIOReturnSuccess;
 }
@@ -1074,53 +1246,32 @@ IOReturn WiiOHCI::UIMDeleteEndpoint(short functionNumber, short endpointNumber,
   }
   WIIDBGLOG("Deleting EP phys: 0x%X, previous EP phys: 0x%X, type: 0x%X", endpoint->physAddr, prevEndpoint->physAddr, endpointType);
 
-  switch (endpointType) {
-    case kWiiOHCIEndpointTypeControl:
-      listMask = kOHCIRegControlControlListEnable;
-      break;
-
-    case kWiiOHCIEndpointTypeInterrupt:
-      listMask = kOHCIRegControlPeriodicListEnable;
-      break;
-
-    case kWiiOHCIEndpointTypeBulk:
-      listMask = kOHCIRegControlBulkListEnable;
-      break;
-
-    case kWiiOHCIEndpointTypeIsochronous:
-      listMask = kOHCIRegControlIsochronousEnable;
-      break;
-
-    default:
-      return kIOReturnBadArgument;
-  }
-
   //
-  // Mark endpoint as skipped.
+  // Skip the endpoint and stop processing of the control or bulk list while it is unlinked.
+  // Outstanding transfers are aborted and the endpoint freed once the controller has passed the next start of frame.
   //
-  endpoint->ed->flags |= HostToUSBLong(kOHCIEDFlagsSkip);
+  listMask = getEndpointListMask(endpointType);
+  if (listMask != 0) {
+    writeReg32(kOHCIRegControl, readReg32(kOHCIRegControl) & ~(listMask));
+  }
+  endpoint->retireListMask = listMask;
+  retireEndpoint(endpoint, kWiiOHCIRetireDelete);
 
   //
-  // Stop processing of endpoints.
+  // Remove endpoint from linked list.
+  // The endpoint still points to the rest of the list for the controller until the next frame.
   //
-  writeReg32(kOHCIRegControl, readReg32(kOHCIRegControl) & ~(listMask));
-  if (endpoint->isochronous) {
-    _isoOutTimerEventSource->cancelTimeout();
-    _isoOutTimerEventSource->disable();
-  }
-  IOSleep(2);
+  removeEndpoint(endpoint, prevEndpoint);
+  WIIDBGLOG("Unlinked EP phys: 0x%X", endpoint->physAddr);
 
   //
-  // Remove endpoint from linked list and resume endpoint processing.
+  // Free bandwidth from interrupt endpoints.
   //
-  prevEndpoint->nextEndpoint       = endpoint->nextEndpoint;
-  prevEndpoint->ed->nextEDPhysAddr = endpoint->ed->nextEDPhysAddr;
-  writeReg32(kOHCIRegControl, readReg32(kOHCIRegControl) | listMask);
-  if (endpoint->isochronous) {
-    _isoOutTimerEventSource->enable();
-    _isoOutTimerEventSource->setTimeoutUS(kWiiOHCIIsoTimerRefreshUS);
+  if (endpointType == kWiiOHCIEndpointTypeInterrupt) {
+    _interruptEndpoints[endpoint->interruptNode].bandwidth -= endpoint->bandwidth;
+    WIIDBGLOG("Returned interrupt bandwidth: %u bytes from node %u", endpoint->bandwidth, endpoint->interruptNode);
+    publishInterruptLoadMap();
   }
-  WIIDBGLOG("Unlinked EP phys: 0x%X", endpoint->physAddr);
 
   //
   // Free bandwidth from isochronous endpoints.
@@ -1129,23 +1280,17 @@ IOReturn WiiOHCI::UIMDeleteEndpoint(short functionNumber, short endpointNumber,
     maxPacketSize = (USBToHostLong(endpoint->ed->flags) & kOHCIEDFlagsMaxPktSizeMask) >> kOHCIEDFlagsMaxPktSizeShift;
     _isoBandwidthAvailable += maxPacketSize;
     WIIDBGLOG("Returned iso bandwidth: %u bytes, available: %u", maxPacketSize, _isoBandwidthAvailable);
-
-    //
-    // If there are no longer any active isochronous endpoints, stop the timers.
-    //
-    if (_isoEndpointHeadPtr->nextEndpoint == _isoEndpointTailPtr) {
-      _isoInTimerEventSource->cancelTimeout();
-      _isoOutTimerEventSource->cancelTimeout();
-      _isoInTimerEventSource->disable();
-      _isoOutTimerEventSource->disable();
-    }
   }
 
   //
-  // Remove all transfers associated with endpoint and remove the endpoint.
+  // If there are no longer any active isochronous endpoints, stop the timers.
   //
-  removeEndpointTransfers(endpoint);
-  returnEndpoint(endpoint);
+  if (endpoint->isochronous && (_isoEndpointHeadPtr->nextEndpoint == _isoEndpointTailPtr)) {
+    _isoInTimerEventSource->cancelTimeout();
+    _isoOutTimerEventSource->cancelTimeout();
+    _isoOutPrefillPending = false;
+    publishIsoInStatistics();
+  }
 
   return kIOReturnSuccess;
 }
@@ -1178,7 +1323,17 @@ IOReturn WiiOHCI::UIMClearEndpointStall(short functionNumber, short endpointNumb
   // Reset the transfer queue by unlinking all transfers.
   // This will also clear the current stall bit on the endpoint.
   //
-  removeEndpointTransfers(endpoint);
+  removeEndpointTransfers(endpoint, endpoint->transferTail);
+  if (endpoint->stream != NULL) {
+    abortBulkStream(endpoint);
+  }
+
+  //
+  // A pending abort now has nothing left to remove.
+  //
+  if (endpoint->retireFlags & kWiiOHCIRetireAbort) {
+    endpoint->retireTail = endpoint->transferTail;
+  }
 
   return kIOReturnSuccess;
 }
@@ -0,0 +1,312 @@
+//
+//  wiiusbstats.c
+//  Wii OHCI USB per-endpoint statistics tool
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  Reads the per-endpoint statistics WiiOHCI publishes and ranks the endpoints, to find the device saturating the
+//  bus, failing transfers, or needing the most jumbo bounce buffers.
+//  Not built as part of the kernel extensions, build on the target with:
+//    cc -o wiiusbstats wiiusbstats.c -I../src/OHCI -framework IOKit -framework CoreFoundation
+//
+//  Usage: wiiusbstats [-c controller] [-s bytes|errors|bounce] [-i seconds]
+//  Counters are totals since each endpoint was created. With an interval, endpoints are ranked by what they did
+//  between two readings instead. The driver publishes the statistics once a second.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <IOKit/IOKitLib.h>
+
+#include "WiiOHCIStatistics.h"
+#include "WiiOHCITrace.h"
+
+#define kMaxEndpoints     128
+#define kMaxNameLength    32
+
+//
+// Ranking orders.
+//
+enum {
+  kSortBytes = 0,
+  kSortErrors,
+  kSortBounce
+};
+
+//
+// Statistics of a single endpoint.
+//
+typedef struct {
+  char    name[kMaxNameLength];
+  UInt32  type;
+  UInt64  transfers;
+  UInt64  bytes;
+  UInt64  shortPackets;
+  UInt64  errors;
+  UInt64  stalls;
+  UInt64  jumboBuffers;
+  UInt64  lockedCacheMoves;
+} EndpointStats;
+
+static int gSortOrder = kSortBytes;
+
+//
+// Gets a number from an endpoint dictionary, missing numbers read as zero.
+//
+static UInt64 getNumber(CFDictionaryRef dict, CFStringRef key) {
+  CFNumberRef number;
+  SInt64      value;
+
+  number = (CFNumberRef) CFDictionaryGetValue(dict, key);
+  if ((number == NULL) || (CFGetTypeID(number) != CFNumberGetTypeID())
+      || !CFNumberGetValue(number, kCFNumberSInt64Type, &value)) {
+    return 0;
+  }
+  return (UInt64) value;
+}
+
+//
+// Reads the statistics of every endpoint on a controller.
+// Returns the number of endpoints read, or -1 if the controller has not published any.
+//
+static int readStatistics(io_service_t service, EndpointStats *stats, int maxCount) {
+  CFDictionaryRef statistics;
+  CFStringRef     *names;
+  CFDictionaryRef *endpoints;
+  CFIndex         count;
+  CFIndex         i;
+  int             statsCount;
+
+  statistics = (CFDictionaryRef) IORegistryEntryCreateCFProperty(service, CFSTR(kWiiOHCIEndpointStatisticsKey),
+                                                                 kCFAllocatorDefault, 0);
+  if (statistics == NULL) {
+    return -1;
+  }
+  if (CFGetTypeID(statistics) != CFDictionaryGetTypeID()) {
+    CFRelease(statistics);
+    return -1;
+  }
+
+  count     = CFDictionaryGetCount(statistics);
+  names     = (CFStringRef *) malloc(count * sizeof (*names));
+  endpoints = (CFDictionaryRef *) malloc(count * sizeof (*endpoints));
+  if ((count > 0) && ((names == NULL) || (endpoints == NULL))) {
+    free(names);
+    free(endpoints);
+    CFRelease(statistics);
+    return -1;
+  }
+  CFDictionaryGetKeysAndValues(statistics, (const void **) names, (const void **) endpoints);
+
+  statsCount = 0;
+  for (i = 0; (i < count) && (statsCount < maxCount); i++) {
+    if ((CFGetTypeID(names[i]) != CFStringGetTypeID()) || (CFGetTypeID(endpoints[i]) != CFDictionaryGetTypeID())) {
+      continue;
+    }
+
+    memset(&stats[statsCount], 0, sizeof (stats[statsCount]));
+    CFStringGetCString(names[i], stats[statsCount].name, sizeof (stats[statsCount].name), kCFStringEncodingASCII);
+    stats[statsCount].type              = (UInt32) getNumber(endpoints[i], CFSTR(kWiiOHCIEndpointStatTypeKey));
+    stats[statsCount].transfers         = getNumber(endpoints[i], CFSTR(kWiiOHCIEndpointStatTransfersKey));
+    stats[statsCount].bytes             = getNumber(endpoints[i], CFSTR(kWiiOHCIEndpointStatBytesKey));
+    stats[statsCount].shortPackets      = getNumber(endpoints[i], CFSTR(kWiiOHCIEndpointStatShortPacketsKey));
+    stats[statsCount].errors            = getNumber(endpoints[i], CFSTR(kWiiOHCIEndpointStatErrorsKey));
+    stats[statsCount].stalls            = getNumber(endpoints[i], CFSTR(kWiiOHCIEndpointStatStallsKey));
+    stats[statsCount].jumboBuffers      = getNumber(endpoints[i], CFSTR(kWiiOHCIEndpointStatJumboBuffersKey));
+    stats[statsCount].lockedCacheMoves  = getNumber(endpoints[i], CFSTR(kWiiOHCIEndpointStatLockedCacheKey));
+    statsCount++;
+  }
+
+  free(names);
+  free(endpoints);
+  CFRelease(statistics);
+  return statsCount;
+}
+
+//
+// Subtracts an earlier reading from each endpoint.
+// Endpoints that were not there before, or were created again since, keep their counters as they are.
+//
+static void subtractStatistics(EndpointStats *stats, int count, const EndpointStats *before, int beforeCount) {
+  const EndpointStats *old;
+  int                 i;
+  int                 j;
+
+  for (i = 0; i < count; i++) {
+    old = NULL;
+    for (j = 0; j < beforeCount; j++) {
+      if (strcmp(stats[i].name, before[j].name) == 0) {
+        old = &before[j];
+        break;
+      }
+    }
+    if ((old == NULL) || (stats[i].transfers < old->transfers) || (stats[i].bytes < old->bytes)) {
+      continue;
+    }
+
+    stats[i].transfers        -= old->transfers;
+    stats[i].bytes            -= old->bytes;
+    stats[i].shortPackets     -= old->shortPackets;
+    stats[i].errors           -= old->errors;
+    stats[i].stalls           -= old->stalls;
+    stats[i].jumboBuffers     -= old->jumboBuffers;
+    stats[i].lockedCacheMoves -= old->lockedCacheMoves;
+  }
+}
+
+//
+// Orders endpoints by the selected counter, largest first, then by bytes.
+// Bounce pressure is the number of transfer descriptors that needed a jumbo bounce buffer.
+//
+static int compareStatistics(const void *a, const void *b) {
+  const EndpointStats *statsA;
+  const EndpointStats *statsB;
+  UInt64              valueA;
+  UInt64              valueB;
+
+  statsA = (const EndpointStats *) a;
+  statsB = (const EndpointStats *) b;
+  switch (gSortOrder) {
+    case kSortErrors:
+      valueA = statsA->errors + statsA->stalls;
+      valueB = statsB->errors + statsB->stalls;
+      break;
+    case kSortBounce:
+      valueA = statsA->jumboBuffers;
+      valueB = statsB->jumboBuffers;
+      break;
+    default:
+      valueA = statsA->bytes;
+      valueB = statsB->bytes;
+      break;
+  }
+
+  if (valueA == valueB) {
+    valueA = statsA->bytes;
+    valueB = statsB->bytes;
+  }
+  if (valueA == valueB) {
+    return strcmp(statsA->name, statsB->name);
+  }
+  return (valueA > valueB) ? -1 : 1;
+}
+
+static const char *getTypeName(UInt32 type) {
+  switch (type) {
+    case kWiiOHCITraceTypeControl:
+      return "Control";
+    case kWiiOHCITraceTypeInterrupt:
+      return "Interrupt";
+    case kWiiOHCITraceTypeBulk:
+      return "Bulk";
+    case kWiiOHCITraceTypeIsochronous:
+      return "Isoch";
+    default:
+      return "Unknown";
+  }
+}
+
+//
+// Gets the specified WiiOHCI controller.
+//
+static io_service_t getController(UInt32 index) {
+  io_iterator_t iterator;
+  io_service_t  service;
+
+  if (IOServiceGetMatchingServices(kIOMasterPortDefault, IOServiceMatching("WiiOHCI"), &iterator) != KERN_SUCCESS) {
+    return IO_OBJECT_NULL;
+  }
+
+  while ((service = IOIteratorNext(iterator)) != IO_OBJECT_NULL) {
+    if (index-- == 0) {
+      break;
+    }
+    IOObjectRelease(service);
+  }
+
+  IOObjectRelease(iterator);
+  return service;
+}
+
+static void printUsage(const char *name) {
+  fprintf(stderr, "usage: %s [-c controller] [-s bytes|errors|bounce] [-i seconds]\n", name);
+}
+
+int main(int argc, char **argv) {
+  EndpointStats stats[kMaxEndpoints];
+  EndpointStats before[kMaxEndpoints];
+  io_service_t  service;
+  UInt32        controller;
+  UInt32        interval;
+  int           count;
+  int           beforeCount;
+  int           i;
+  int           opt;
+
+  controller  = 0;
+  interval    = 0;
+  beforeCount = 0;
+  while ((opt = getopt(argc, argv, "c:s:i:")) != -1) {
+    if (opt == 'c') {
+      controller = (UInt32) strtoul(optarg, NULL, 0);
+    } else if (opt == 'i') {
+      interval = (UInt32) strtoul(optarg, NULL, 0);
+    } else if ((opt == 's') && (strcmp(optarg, "bytes") == 0)) {
+      gSortOrder = kSortBytes;
+    } else if ((opt == 's') && (strcmp(optarg, "errors") == 0)) {
+      gSortOrder = kSortErrors;
+    } else if ((opt == 's') && (strcmp(optarg, "bounce") == 0)) {
+      gSortOrder = kSortBounce;
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (optind != argc) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  service = getController(controller);
+  if (service == IO_OBJECT_NULL) {
+    fprintf(stderr, "WiiOHCI controller %u not found\n", controller);
+    return 1;
+  }
+
+  //
+  // With an interval, read twice and keep the difference.
+  //
+  if (interval > 0) {
+    beforeCount = readStatistics(service, before, kMaxEndpoints);
+    sleep(interval);
+  }
+  count = readStatistics(service, stats, kMaxEndpoints);
+  IOObjectRelease(service);
+  if (count < 0) {
+    fprintf(stderr, "Controller %u has not published endpoint statistics\n", controller);
+    return 1;
+  }
+  if ((interval > 0) && (beforeCount > 0)) {
+    subtractStatistics(stats, count, before, beforeCount);
+  }
+
+  qsort(stats, count, sizeof (stats[0]), compareStatistics);
+
+  if (interval > 0) {
+    printf("Controller %u, %d endpoints, over %u seconds\n", controller, count, interval);
+  } else {
+    printf("Controller %u, %d endpoints, since each was created\n", controller, count);
+  }
+  printf("%-14s %-9s %10s %14s %8s %8s %8s %8s %11s\n", "Endpoint", "Type", "Transfers", "Bytes",
+    "Short", "Errors", "Stalls", "Jumbo", "LockedCache");
+  for (i = 0; i < count; i++) {
+    printf("%-14s %-9s %10llu %14llu %8llu %8llu %8llu %8llu %11llu\n", stats[i].name, getTypeName(stats[i].type),
+      stats[i].transfers, stats[i].bytes, stats[i].shortPackets, stats[i].errors, stats[i].stalls,
+      stats[i].jumboBuffers, stats[i].lockedCacheMoves);
+  }
+  return 0;
+}
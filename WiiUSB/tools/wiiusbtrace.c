@@ -0,0 +1,299 @@
+//
+//  wiiusbtrace.c
+//  Wii OHCI USB transaction trace capture tool
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  Drains the WiiOHCI transaction trace into a pcap file readable by Wireshark (usbmon link type).
+//  Not built as part of the kernel extensions, build on the target with:
+//    cc -o wiiusbtrace wiiusbtrace.c -I../src/OHCI -framework IOKit -framework CoreFoundation
+//
+//  Usage: wiiusbtrace [-c controller] output.pcap
+//  Must be run as root, capture stops on interrupt.
+//
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <IOKit/IOKitLib.h>
+#include <IOKit/usb/USB.h>
+
+#include "WiiOHCITrace.h"
+
+#define kPcapMagic          0xA1B2C3D4
+#define kPcapLinkTypeUSB    189
+#define kPollIntervalUS     10000
+
+//
+// pcap file and record headers.
+//
+typedef struct {
+  UInt32  magic;
+  UInt16  versionMajor;
+  UInt16  versionMinor;
+  SInt32  thisZone;
+  UInt32  sigFigs;
+  UInt32  snapLength;
+  UInt32  linkType;
+} PcapFileHeader;
+
+typedef struct {
+  UInt32  tsSec;
+  UInt32  tsUSec;
+  UInt32  capLength;
+  UInt32  length;
+} PcapRecordHeader;
+
+//
+// Linux usbmon packet header, written in host byte order as indicated by the pcap magic.
+//
+typedef struct {
+  UInt64  id;
+  UInt8   type;
+  UInt8   transferType;
+  UInt8   endpointNumber;
+  UInt8   deviceAddress;
+  UInt16  busNumber;
+  SInt8   flagSetup;
+  SInt8   flagData;
+  SInt64  tsSec;
+  SInt32  tsUSec;
+  SInt32  status;
+  UInt32  length;
+  UInt32  capLength;
+  UInt8   setup[8];
+} UsbmonHeader;
+
+static volatile sig_atomic_t gStop = 0;
+
+static void handleSignal(int sig) {
+  gStop = 1;
+}
+
+//
+// Converts a driver completion status to the Linux URB status usbmon reports.
+//
+static SInt32 convertStatus(const WiiOHCITraceRecord *record) {
+  if (record->event == kWiiOHCITraceEventSubmit) {
+    return -EINPROGRESS;
+  }
+
+  switch (record->status) {
+    case kIOReturnSuccess:
+    case kIOReturnUnderrun:
+      return 0;
+    case kIOUSBPipeStalled:
+      return -EPIPE;
+    case kIOReturnAborted:
+      return -ENOENT;
+    case kIOReturnOverrun:
+      return -EOVERFLOW;
+    case kIOReturnNotResponding:
+      return -ETIMEDOUT;
+    default:
+      return -EPROTO;
+  }
+}
+
+//
+// Converts a driver endpoint type to the usbmon transfer type.
+//
+static UInt8 convertType(UInt8 type) {
+  switch (type) {
+    case kWiiOHCITraceTypeIsochronous:
+      return 0;
+    case kWiiOHCITraceTypeInterrupt:
+      return 1;
+    case kWiiOHCITraceTypeControl:
+      return 2;
+    default:
+      return 3;
+  }
+}
+
+//
+// Writes a trace record as a pcap packet.
+//
+static int writeRecord(FILE *file, const WiiOHCITraceRecord *record, UInt16 busNumber,
+                       UInt64 baseTimebase, UInt32 ticksPerUS, const struct timeval *baseTime) {
+  PcapRecordHeader  recordHeader;
+  UsbmonHeader      header;
+  UInt64            us;
+
+  us = (UInt64) baseTime->tv_usec + ((record->timebase - baseTimebase) / ticksPerUS);
+
+  memset(&header, 0, sizeof (header));
+  header.id             = record->id;
+  header.type           = record->event;
+  header.transferType   = convertType(record->type);
+  header.endpointNumber = (record->key >> kWiiOHCITraceKeyEndpointShift) & kWiiOHCITraceKeyEndpointMask;
+  if (record->key & kWiiOHCITraceKeyDirectionIn) {
+    header.endpointNumber |= 0x80;
+  }
+  header.deviceAddress  = record->key & kWiiOHCITraceKeyFunctionMask;
+  header.busNumber      = busNumber;
+  header.flagSetup      = '-';
+  header.flagData       = '<';
+  header.tsSec          = baseTime->tv_sec + (us / 1000000);
+  header.tsUSec         = us % 1000000;
+  header.status         = convertStatus(record);
+  header.length         = (record->event == kWiiOHCITraceEventSubmit) ? record->length : record->actualLength;
+  header.capLength      = 0;
+
+  recordHeader.tsSec     = (UInt32) header.tsSec;
+  recordHeader.tsUSec    = header.tsUSec;
+  recordHeader.capLength = sizeof (header);
+  recordHeader.length    = sizeof (header);
+
+  if (fwrite(&recordHeader, sizeof (recordHeader), 1, file) != 1) {
+    return -1;
+  }
+  if (fwrite(&header, sizeof (header), 1, file) != 1) {
+    return -1;
+  }
+  return 0;
+}
+
+//
+// Gets the specified WiiOHCI controller.
+//
+static io_service_t getController(UInt32 index) {
+  io_iterator_t iterator;
+  io_service_t  service;
+
+  if (IOServiceGetMatchingServices(kIOMasterPortDefault, IOServiceMatching("WiiOHCI"), &iterator) != KERN_SUCCESS) {
+    return IO_OBJECT_NULL;
+  }
+
+  while ((service = IOIteratorNext(iterator)) != IO_OBJECT_NULL) {
+    if (index-- == 0) {
+      break;
+    }
+    IOObjectRelease(service);
+  }
+
+  IOObjectRelease(iterator);
+  return service;
+}
+
+int main(int argc, char **argv) {
+  WiiOHCITraceRecord  records[kWiiOHCITraceReadMaxRecords];
+  PcapFileHeader      fileHeader;
+  io_service_t        service;
+  io_connect_t        connect;
+  FILE                *file;
+  struct timeval      baseTime;
+  UInt64              baseTimebase;
+  Boolean             haveBase;
+  UInt32              controller;
+  UInt32              ticksPerUS;
+  UInt32              dropped;
+  UInt32              capacity;
+  UInt32              count;
+  UInt32              i;
+  UInt32              total;
+  IOByteCount         size;
+  kern_return_t       status;
+  int                 opt;
+
+  controller = 0;
+  while ((opt = getopt(argc, argv, "c:")) != -1) {
+    if (opt == 'c') {
+      controller = (UInt32) strtoul(optarg, NULL, 0);
+    } else {
+      fprintf(stderr, "usage: %s [-c controller] output.pcap\n", argv[0]);
+      return 1;
+    }
+  }
+  if (optind != (argc - 1)) {
+    fprintf(stderr, "usage: %s [-c controller] output.pcap\n", argv[0]);
+    return 1;
+  }
+
+  service = getController(controller);
+  if (service == IO_OBJECT_NULL) {
+    fprintf(stderr, "WiiOHCI controller %u not found\n", controller);
+    return 1;
+  }
+
+  status = IOServiceOpen(service, mach_task_self(), 0, &connect);
+  IOObjectRelease(service);
+  if (status != KERN_SUCCESS) {
+    fprintf(stderr, "Failed to open controller: 0x%X\n", status);
+    return 1;
+  }
+
+  status = IOConnectMethodScalarIScalarO(connect, kWiiOHCITraceMethodGetInfo, 0, 3, &ticksPerUS, &dropped, &capacity);
+  if ((status != KERN_SUCCESS) || (ticksPerUS == 0)) {
+    fprintf(stderr, "Failed to get trace info: 0x%X\n", status);
+    IOServiceClose(connect);
+    return 1;
+  }
+
+  file = fopen(argv[optind], "wb");
+  if (file == NULL) {
+    perror(argv[optind]);
+    IOServiceClose(connect);
+    return 1;
+  }
+
+  fileHeader.magic        = kPcapMagic;
+  fileHeader.versionMajor = 2;
+  fileHeader.versionMinor = 4;
+  fileHeader.thisZone     = 0;
+  fileHeader.sigFigs      = 0;
+  fileHeader.snapLength   = sizeof (UsbmonHeader);
+  fileHeader.linkType     = kPcapLinkTypeUSB;
+  fwrite(&fileHeader, sizeof (fileHeader), 1, file);
+
+  signal(SIGINT, handleSignal);
+  signal(SIGTERM, handleSignal);
+  fprintf(stderr, "Tracing controller %u (%u record ring), interrupt to stop\n", controller, capacity);
+
+  //
+  // Records carry processor timebase values, anchor the first one to the current time of day.
+  //
+  haveBase     = FALSE;
+  baseTimebase = 0;
+  total        = 0;
+  while (!gStop) {
+    size   = sizeof (records);
+    status = IOConnectMethodScalarIStructureO(connect, kWiiOHCITraceMethodReadRecords, 0, &size, records);
+    if (status != KERN_SUCCESS) {
+      fprintf(stderr, "Failed to read trace records: 0x%X\n", status);
+      break;
+    }
+
+    count = (UInt32) (size / sizeof (WiiOHCITraceRecord));
+    for (i = 0; i < count; i++) {
+      if (!haveBase) {
+        gettimeofday(&baseTime, NULL);
+        baseTimebase = records[i].timebase;
+        haveBase     = TRUE;
+      }
+      if (writeRecord(file, &records[i], controller + 1, baseTimebase, ticksPerUS, &baseTime) != 0) {
+        perror(argv[optind]);
+        gStop = 1;
+        break;
+      }
+    }
+    total += count;
+
+    if (count == 0) {
+      usleep(kPollIntervalUS);
+    }
+  }
+
+  IOConnectMethodScalarIScalarO(connect, kWiiOHCITraceMethodGetInfo, 0, 3, &ticksPerUS, &dropped, &capacity);
+  fprintf(stderr, "Captured %u records, %u dropped\n", total, dropped);
+
+  fclose(file);
+  IOServiceClose(connect);
+  return 0;
+}
@@ -61,6 +61,15 @@ endif
 endif
 endif
 
+#
+# Info.plist sections only supported on 10.2 and newer are bracketed by markers, and removed for older versions.
+#
+ifeq ($(OSX_VERSION),$(filter $(OSX_VERSION),$(OSX_VERSIONS_GCC2)))
+PLIST_SED	:=	-e '/__BEGIN_10_2__/,/__END_10_2__/d'
+else
+PLIST_SED	:=	-e '/__BEGIN_10_2__/d' -e '/__END_10_2__/d'
+endif
+
 #
 # Folders. These must be relative to the kext Makefiles, Darling can't deal with absolute paths.
 #
@@ -118,7 +127,7 @@ $(KEXT_PLIST): Info.plist
 	@test -d $(dir $@) || mkdir $(dir $@)
 	@cat $< | sed -e s/__BUNDLE__/$(KEXT_BUNDLE_ID)/ \
 		-e s/__MODULE__/$(KEXT_NAME)/ \
-		-e s/__VERSION__/$(KEXT_VERSION)/ > $@
+		-e s/__VERSION__/$(KEXT_VERSION)/ $(PLIST_SED) > $@
 
 # Kext bundle
 $(KEXT_BUNDLE): $(KEXT_BIN) $(KEXT_PLIST)
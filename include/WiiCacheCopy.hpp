@@ -0,0 +1,107 @@
+//
+//  WiiCacheCopy.hpp
+//  Wii cache line aware copy functions
+//
+// Broadway and Espresso have 32 byte data cache lines. Storing to a line that is not cached reads the whole line
+// from memory first, even if it is about to be completely overwritten. These functions establish destination lines
+// with dcbz instead, and handle the cache maintenance needed around buffers used for DMA.
+// Other architectures zero the lines with bzero, which is what dcbz leaves in them.
+//
+// Buffers must be in cacheable memory, dcbz on cache inhibited memory causes an alignment exception.
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef WiiCacheCopy_hpp
+#define WiiCacheCopy_hpp
+
+#include <IOKit/IOMemoryDescriptor.h>
+
+#include "WiiCommon.hpp"
+
+#define kWiiCacheLineSize         32
+#define kWiiCacheLineMask         (kWiiCacheLineSize - 1)
+
+//
+// Bytes of destination lines established ahead of each part of an outbound copy.
+// Well within the 32 KB L1 data cache, so the lines are still cached when the copy stores to them.
+//
+#define kWiiCacheCopyChunkSize    4096
+
+//
+// Zeroes every cache line entirely within a buffer without reading it from memory.
+// Partial lines at either end are not touched.
+//
+inline void zeroCacheLines(void *buffer, UInt32 length) {
+  vm_offset_t start;
+  vm_offset_t end;
+
+  start = (((vm_offset_t) buffer) + kWiiCacheLineMask) & ~((vm_offset_t) kWiiCacheLineMask);
+  end   = (((vm_offset_t) buffer) + length) & ~((vm_offset_t) kWiiCacheLineMask);
+  for (; start < end; start += kWiiCacheLineSize) {
+#if defined(__ppc__)
+    __asm__ volatile("dcbz 0, %0" : : "r" (start) : "memory");
+#else
+    bzero((void *) start, kWiiCacheLineSize);
+#endif
+  }
+}
+
+//
+// Hints that a cache line will be read soon.
+//
+inline void prefetchCacheLine(const void *buffer) {
+#if defined(__ppc__)
+  __asm__ volatile("dcbt 0, %0" : : "r" (buffer));
+#endif
+}
+
+//
+// Copies from a memory descriptor into a buffer used for outbound DMA, and flushes the buffer.
+// Returns the number of bytes copied.
+//
+inline IOByteCount readToDMABuffer(IOMemoryDescriptor *desc, IOByteCount offset, void *buffer, IOByteCount length) {
+  IOByteCount copied;
+  IOByteCount chunkCopied;
+  IOByteCount chunkLength;
+
+  //
+  // Lines wholly overwritten by the copy do not need to be read from memory.
+  // Establishing them all up front would evict the first lines again on large copies, so each part of the copy
+  // establishes its own lines just before storing to them.
+  //
+  copied = 0;
+  while (copied < length) {
+    chunkLength = length - copied;
+    if (chunkLength > kWiiCacheCopyChunkSize) {
+      chunkLength = kWiiCacheCopyChunkSize;
+    }
+
+    zeroCacheLines((UInt8 *) buffer + copied, chunkLength);
+    chunkCopied = desc->readBytes(offset + copied, (UInt8 *) buffer + copied, chunkLength);
+    copied += chunkCopied;
+    if (chunkCopied != chunkLength) {
+      break;
+    }
+  }
+
+  flushDataCache(buffer, length);
+  return copied;
+}
+
+//
+// Invalidates a buffer used for inbound DMA, and copies it to a memory descriptor.
+// Returns the number of bytes copied.
+//
+inline IOByteCount writeFromDMABuffer(IOMemoryDescriptor *desc, IOByteCount offset, const void *buffer, IOByteCount length,
+                                      WiiInvalidateDataCacheFunc invalidateCacheFunc) {
+  if (length == 0) {
+    return 0;
+  }
+
+  invalidateCacheFunc((vm_offset_t) buffer, length, false);
+  prefetchCacheLine(buffer);
+  return desc->writeBytes(offset, buffer, length);
+}
+
+#endif
@@ -9,6 +9,8 @@
 #define WiiCommon_hpp
 
 #include <IOKit/IOLib.h>
+#include <IOKit/IOPlatformExpert.h>
+#include <libkern/OSAtomic.h>
 
 #define ARRSIZE(x)    ((sizeof (x) / sizeof ((x)[0])))
 
@@ -61,12 +63,38 @@
 //
 // Platform functions.
 //
-#define kWiiFuncPlatformGetInvalidateCache  "PlatformGetInvalidateCache"
-#define kWiiFuncPlatformGetMem2Allocator    "PlatformGetMem2Allocator"
-#define kWiiFuncIPCGetRTCBias               "IPCGetRTCBias"
-#define kWiiFuncIPCCafeLog                  "IPCCafeLog"
-#define kWiiFuncIPCRvlStartFB               "IPCRvlStartFB"
-#define kWiiFuncIPCRvlStopFB                "IPCRvlStopFB"
+#define kWiiFuncPlatformGetInvalidateCache    "PlatformGetInvalidateCache"
+#define kWiiFuncPlatformGetMem2Service        "PlatformGetMem2Service"
+#define kWiiFuncPlatformGetLockedCacheService "PlatformGetLockedCacheService"
+#define kWiiFuncPlatformSetIntAffinity        "PlatformSetInterruptAffinity"
+#define kWiiFuncPlatformGetLogLevel           "PlatformGetLogLevel"
+#define kWiiFuncPlatformGetLogService         "PlatformGetLogService"
+#define kWiiFuncIntSetVectorAffinity          "InterruptSetVectorAffinity"
+#define kWiiFuncIPCGetRTCBias                 "IPCGetRTCBias"
+#define kWiiFuncIPCCafeLog                    "IPCCafeLog"
+#define kWiiFuncIPCRvlStartFB                 "IPCRvlStartFB"
+#define kWiiFuncIPCRvlStopFB                  "IPCRvlStopFB"
+#define kWiiFuncIPCSendMessageAsync           "IPCSendMessageAsync"
+#define kWiiFuncCryptoGetService              "CryptoGetService"
+
+//
+// Kernel symbol resolution with kWiiFuncPlatformResolveSymbols, only available until the BSD layer has started.
+// Takes an array of symbol names, an array receiving their addresses, and the count.
+// Unresolved symbols are set to zero and kIOReturnNotFound is returned.
+//
+#define kWiiFuncPlatformResolveSymbols        "PlatformResolveSymbols"
+
+//
+// IPC message completion, called from the IPC work loop or a thread waiting on another message.
+// Reply is the ARM message at the time the message was acknowledged.
+//
+typedef void (*WiiIPCCompletionAction)(void *target, void *parameter, IOReturn status, UInt32 reply);
+
+typedef struct {
+  WiiIPCCompletionAction  action;
+  void                    *target;
+  void                    *parameter;
+} WiiIPCCompletion;
 
 //
 // Major kernel version exported from XNU.
@@ -98,13 +126,118 @@ inline bool checkKernelArgument(const char *name) {
   return PE_parse_boot_arg(name, val);
 }
 
+//
+// Interrupt affinity, personality property with a mask of Wii U cores a driver's interrupt should be steered to.
+//
+#define kWiiInterruptCoreMaskKey  "InterruptCoreMask"
+
+//
+// Steers an interrupt of a nub to the specified mask of cores (Wii U only).
+//
+inline IOReturn setInterruptAffinity(IOService *nub, int source, UInt32 coreMask) {
+  return IOService::getPlatform()->callPlatformFunction(kWiiFuncPlatformSetIntAffinity, false,
+    nub, (void *) source, (void *) coreMask, NULL);
+}
+
+//
+// Applies the interrupt affinity from a driver's personality to an interrupt of its nub, if one is specified.
+//
+inline void applyInterruptAffinity(IOService *driver, IOService *nub, int source) {
+  OSNumber *coreMask;
+
+  coreMask = OSDynamicCast(OSNumber, driver->getProperty(kWiiInterruptCoreMaskKey));
+  if (coreMask != NULL) {
+    setInterruptAffinity(nub, source, coreMask->unsigned32BitValue());
+  }
+}
+
 //
 // Gets the processor PVR.
 //
 inline UInt32 getProcessorPVR(void) {
+#if defined(__ppc__)
   UInt32 pvr;
   asm volatile ("mfpvr %0" : "=r"(pvr));
   return pvr;
+#elif defined(WII_HOST_TEST)
+  return hostGetProcessorPVR();
+#else
+  return 0;
+#endif
+}
+
+//
+// Gets the index of the highest set bit. Value must not be zero.
+//
+inline UInt32 getHighestBit32(UInt32 value) {
+#if defined(__ppc__)
+  UInt32 leadingZeros;
+  asm ("cntlzw %0, %1" : "=r"(leadingZeros) : "r"(value));
+  return 31 - leadingZeros;
+#else
+  return 31 - __builtin_clz(value);
+#endif
+}
+
+//
+// Gets the processor timebase.
+//
+inline UInt64 getProcessorTimebase(void) {
+#if defined(__ppc__)
+  UInt32 tbu;
+  UInt32 tbl;
+  UInt32 tbuCheck;
+
+  //
+  // Upper half may roll over between reads, retry until consistent.
+  //
+  do {
+    asm volatile ("mftbu %0" : "=r"(tbu));
+    asm volatile ("mftb %0" : "=r"(tbl));
+    asm volatile ("mftbu %0" : "=r"(tbuCheck));
+  } while (tbu != tbuCheck);
+
+  return (((UInt64) tbu) << 32) | tbl;
+#elif defined(WII_HOST_TEST)
+  return hostGetProcessorTimebase();
+#else
+  return 0;
+#endif
+}
+
+//
+// Sets a number in a dictionary, used for statistics properties.
+//
+inline void setDictionaryNumber(OSDictionary *dictionary, const char *key, UInt64 value, UInt32 numberOfBits) {
+  OSNumber *number;
+
+  number = OSNumber::withNumber(value, numberOfBits);
+  if (number != NULL) {
+    dictionary->setObject(key, number);
+    number->release();
+  }
+}
+
+//
+// Orders all prior memory accesses before any later ones.
+//
+inline void syncMemory(void) {
+#if defined(__ppc__)
+  asm volatile ("sync" : : : "memory");
+#else
+  __sync_synchronize();
+#endif
+}
+
+//
+// Atomically replaces a pointer if it still holds the expected value.
+//
+inline bool compareAndSwapPointer(void *oldValue, void *newValue, void * volatile *address) {
+#if defined(__ppc__)
+  return OSCompareAndSwap((UInt32) oldValue, (UInt32) newValue, (volatile UInt32 *) address);
+#else
+  return __sync_bool_compare_and_swap(address, oldValue, newValue);
+#endif
 }
 
 //
@@ -133,57 +266,171 @@ inline void flushDataCachePhys(UInt32 physAddr, UInt32 size) {
 
 typedef void (*WiiInvalidateDataCacheFunc)(vm_offset_t va, unsigned length, boolean_t phys);
 
-#if DEBUG
 //
-// Debug logging function.
+// Log levels, set per subsystem with the -wii<subsystem>dbg boot argument or at runtime
+// through the platform expert's WiiLogLevels property.
 //
-inline void logPrint(const char *className, const char *locationName, const char *funcName, const char *format, va_list va) {
-  char tmp[256];
-  tmp[0] = '\0';
-  vsnprintf(tmp, sizeof (tmp), format, va);
+#define kWiiLogLevelNone          0
+#define kWiiLogLevelDebug         1
+#define kWiiLogLevelData          2
+#define kWiiLogLevelsKey          "WiiLogLevels"
+
+//
+// Logging service of the platform expert, obtained with kWiiFuncPlatformGetLogService.
+//
+// logLine:     formats and prints a line immediately to the system log and, on Wii U, over IPC.
+// logDeferred: stores the format and arguments in the per-CPU log ring, formatted and printed later by a drain thread.
+//              Callable from interrupt context. String arguments are copied, but the format, class, location,
+//              and function name strings must remain valid until printed.
+//
+typedef void (*WiiLogFunc)(const char *className, const char *locationName, const char *funcName,
+                           const char *format, va_list va);
+
+typedef struct {
+  WiiLogFunc  logLine;
+  WiiLogFunc  logDeferred;
+} WiiLogService;
+
+#define kWiiLogLineLength         256
+
+//
+// Formats the class, location, and function prefix of a log line, returning its length.
+//
+inline int logFormatPrefix(char *line, const char *className, const char *locationName, const char *funcName) {
+  int length;
+
   if (locationName != NULL) {
-    IOLog("%s[%s]::%s(): %s\n", className, locationName, funcName, tmp);
+    length = snprintf(line, kWiiLogLineLength, "%s[%s]::%s(): ", className, locationName, funcName);
   } else {
-    IOLog("%s::%s(): %s\n", className, funcName, tmp);
+    length = snprintf(line, kWiiLogLineLength, "%s::%s(): ", className, funcName);
   }
+  if ((length < 0) || (length > (kWiiLogLineLength - 2))) {
+    length = kWiiLogLineLength - 2;
+  }
+  return length;
+}
+
+//
+// Terminates a log line at the specified length, leaving room for the newline.
+//
+inline void logTerminateLine(char *line, int length) {
+  if ((length < 0) || (length > (kWiiLogLineLength - 2))) {
+    length = kWiiLogLineLength - 2;
+  }
+  line[length]     = '\n';
+  line[length + 1] = '\0';
+}
+
+//
+// Formats a complete log line.
+//
+inline void logFormatLine(char *line, const char *className, const char *locationName, const char *funcName,
+                          const char *format, va_list va) {
+  int length;
+
+  length = logFormatPrefix(line, className, locationName, funcName);
+  length += vsnprintf(&line[length], kWiiLogLineLength - 1 - length, format, va);
+  logTerminateLine(line, length);
+}
+
+#if DEBUG
+//
+// Debug logging function, routed through the platform expert's logging service once available.
+// Anything logging before that only goes to the system log.
+//
+inline void logPrint(const WiiLogService *logService, bool deferred, const char *className, const char *locationName,
+                     const char *funcName, const char *format, va_list va) {
+  char msg[kWiiLogLineLength];
 
-  if (checkPlatformCafe()) {
-    mach_timespec_t  t;
-    t.tv_sec = 2;
-    t.tv_nsec = 0;
-
-    IOService *ipcService = IOService::waitForService(IOService::nameMatching("WiiIPC"), &t);
-    if (ipcService != NULL) {
-      char msg[256];
-      if (locationName != NULL) {
-        snprintf(msg, sizeof (msg), "%s[%s]::%s(): %s\n", className, locationName, funcName, tmp);
-      } else {
-        snprintf(msg, sizeof (msg), "%s::%s(): %s\n", className, funcName, tmp);
-      }
-      ipcService->callPlatformFunction(kWiiFuncIPCCafeLog, true, (void*) msg, NULL, NULL, NULL);
+  if (logService != NULL) {
+    if (deferred) {
+      logService->logDeferred(className, locationName, funcName, format, va);
+    } else {
+      logService->logLine(className, locationName, funcName, format, va);
     }
+    return;
+  }
+
+  logFormatLine(msg, className, locationName, funcName, format, va);
+  IOLog("%s", msg);
+}
+
+//
+// Gets the platform expert's logging service.
+//
+inline const WiiLogService *getLogService(void) {
+  IOPlatformExpert    *platform;
+  const WiiLogService *logService;
+
+  platform = IOService::getPlatform();
+  if (platform == NULL) {
+    return NULL;
   }
+
+  logService = NULL;
+  if (platform->callPlatformFunction(kWiiFuncPlatformGetLogService, false, (void *) &logService,
+                                     NULL, NULL, NULL) != kIOReturnSuccess) {
+    return NULL;
+  }
+  return logService;
+}
+
+//
+// Gets the shared log level for a subsystem from the platform expert.
+// The platform expert itself and anything started before it use the fallback level.
+//
+inline volatile UInt8 *getLogLevel(const char *subsystem, UInt8 initialLevel, volatile UInt8 *fallbackLevel) {
+  IOPlatformExpert  *platform;
+  volatile UInt8    *level;
+
+  *fallbackLevel = initialLevel;
+  platform = IOService::getPlatform();
+  if (platform == NULL) {
+    return fallbackLevel;
+  }
+
+  level = NULL;
+  if ((platform->callPlatformFunction(kWiiFuncPlatformGetLogLevel, false, (void *) subsystem,
+                                      (void *) (UInt32) initialLevel, (void *) &level, NULL) != kIOReturnSuccess)
+      || (level == NULL)) {
+    return fallbackLevel;
+  }
+  return level;
 }
 
 //
 // Log functions for I/O Kit modules.
+// Debug messages before WiiCheckDebugArgs() are dropped, the level is not known until then.
 //
 #define WiiDeclareLogFunctions(a) \
   protected: \
-  bool _debugEnabled; \
+  volatile UInt8 *_debugLevel; \
+  volatile UInt8 _debugLevelLocal; \
+  const WiiLogService *_logService; \
   const char *_debugLocation; \
   inline void WiiCheckDebugArgs() { \
-    _debugEnabled = checkKernelArgument("-wii" a "dbg"); \
+    _debugLevel = getLogLevel(a, checkKernelArgument("-wii" a "dbg") ? kWiiLogLevelDebug : kWiiLogLevelNone, \
+      &_debugLevelLocal); \
+    _logService = getLogService(); \
     _debugLocation = NULL; \
   } \
   inline void WiiSetDebugLocation(const char *location) { \
     _debugLocation = location; \
   } \
   inline void WIIDBGLOG_PRINT(const char *func, const char *str, ...) const { \
-    if (this->_debugEnabled) { \
+    if ((this->_debugLevel != NULL) && (*this->_debugLevel >= kWiiLogLevelDebug)) { \
+      va_list args; \
+      va_start(args, str); \
+      logPrint(_logService, true, this->getMetaClass()->getClassName(), _debugLocation, func, str, args); \
+      va_end(args); \
+    } \
+  } \
+    \
+  inline void WIIDATADBGLOG_PRINT(const char *func, const char *str, ...) const { \
+    if ((this->_debugLevel != NULL) && (*this->_debugLevel >= kWiiLogLevelData)) { \
       va_list args; \
       va_start(args, str); \
-      logPrint(this->getMetaClass()->getClassName(), _debugLocation, func, str, args); \
+      logPrint(_logService, true, this->getMetaClass()->getClassName(), _debugLocation, func, str, args); \
       va_end(args); \
     } \
   } \
@@ -191,7 +438,7 @@ inline void logPrint(const char *className, const char *locationName, const char
   inline void WIISYSLOG_PRINT(const char *func, const char *str, ...) const { \
     va_list args; \
     va_start(args, str); \
-    logPrint(this->getMetaClass()->getClassName(), _debugLocation, func, str, args); \
+    logPrint(_logService, false, this->getMetaClass()->getClassName(), _debugLocation, func, str, args); \
     va_end(args); \
   } \
   protected:
@@ -234,6 +481,7 @@ inline void logPrint(const char *className, const char *locationName, const char
     _debugLocation = location; \
   } \
   inline void WIIDBGLOG(const char *str, ...) const { } \
+  inline void WIIDATADBGLOG(const char *str, ...) const { } \
     \
   inline void WIISYSLOG(const char *str, ...) const { \
     va_list args; \
@@ -0,0 +1,48 @@
+//
+//  WiiCryptoService.hpp
+//  Wii AES and SHA-1 engine service
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef WiiCryptoService_hpp
+#define WiiCryptoService_hpp
+
+#include <IOKit/IOMemoryDescriptor.h>
+
+#include "WiiCommon.hpp"
+
+#define kWiiCryptoAESKeySize        16
+#define kWiiCryptoAESBlockSize      16
+#define kWiiCryptoSHA1BlockSize     64
+#define kWiiCryptoSHA1DigestSize    20
+
+//
+// SHA-1 hash in progress. Partial blocks are kept in the context until more data or the final call.
+//
+typedef struct {
+  UInt32  h[5];
+  UInt64  length;
+  UInt8   buffer[kWiiCryptoSHA1BlockSize];
+} WiiCryptoSHA1Context;
+
+//
+// Crypto service, obtained with kWiiFuncCryptoGetService from the WiiCrypto service.
+// Memory descriptors must be prepared by the caller, and can be any mix of physical and virtual ranges.
+// Requests use the Hollywood engines when available to Broadway, otherwise they are done in software.
+//
+// aesCBC:      encrypts or decrypts with AES-128-CBC. Length must be a multiple of the block size.
+//              The IV is updated to continue the chain in a later call.
+// sha1Init:    starts a SHA-1 hash.
+// sha1Update:  adds data to a SHA-1 hash.
+// sha1Final:   finishes a SHA-1 hash and gets the digest.
+//
+typedef struct {
+  IOReturn (*aesCBC)(const UInt8 *key, UInt8 *iv, bool decrypt, IOMemoryDescriptor *src, IOByteCount srcOffset,
+                     IOMemoryDescriptor *dest, IOByteCount destOffset, IOByteCount length);
+  void (*sha1Init)(WiiCryptoSHA1Context *context);
+  IOReturn (*sha1Update)(WiiCryptoSHA1Context *context, IOMemoryDescriptor *src, IOByteCount offset, IOByteCount length);
+  IOReturn (*sha1Final)(WiiCryptoSHA1Context *context, UInt8 *digest);
+} WiiCryptoService;
+
+#endif
@@ -0,0 +1,48 @@
+//
+//  WiiLockedCache.hpp
+//  Wii locked L1 data cache scratchpad service
+//
+// See https://wiibrew.org/wiki/Locked_cache.
+// Broadway can lock half of its L1 data cache as a 16 KB scratchpad that never writes back to memory,
+// with a DMA engine that moves whole cache lines between the scratchpad and main memory.
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef WiiLockedCache_hpp
+#define WiiLockedCache_hpp
+
+#include "WiiCommon.hpp"
+
+#define kWiiLockedCacheSize             (16 * kByte)
+#define kWiiLockedCacheLineSize         32
+
+//
+// DMA tickets complete in submission order. A ticket is complete once all DMA up to and including it has finished.
+//
+typedef UInt32 WiiLockedCacheTicket;
+
+//
+// Locked cache service, obtained with kWiiFuncPlatformGetLockedCacheService. Only available on Wii.
+//
+// The scratchpad is enabled while any buffer is allocated, which halves the L1 data cache for everything else.
+// Buffers, physical addresses, and lengths must all be cache line aligned.
+//
+// allocate:    allocates a scratchpad buffer.
+// deallocate:  frees a scratchpad buffer. All DMA using it must be complete.
+// load:        starts DMA from main memory into a scratchpad buffer. The source range is flushed first.
+// store:       starts DMA from a scratchpad buffer to main memory. The destination range is invalidated first,
+//              it must not be read until the DMA is complete.
+// isComplete:  checks if DMA for a ticket is complete.
+// wait:        spins until DMA for a ticket is complete.
+//
+typedef struct {
+  void *(*allocate)(IOByteCount length);
+  void (*deallocate)(void *buffer, IOByteCount length);
+  IOReturn (*load)(void *buffer, IOPhysicalAddress physAddr, IOByteCount length, WiiLockedCacheTicket *ticket);
+  IOReturn (*store)(const void *buffer, IOPhysicalAddress physAddr, IOByteCount length, WiiLockedCacheTicket *ticket);
+  bool (*isComplete)(WiiLockedCacheTicket ticket);
+  void (*wait)(WiiLockedCacheTicket ticket);
+} WiiLockedCacheService;
+
+#endif
@@ -0,0 +1,53 @@
+//
+//  WiiMem2.hpp
+//  Wii MEM2 DMA memory allocation service
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef WiiMem2_hpp
+#define WiiMem2_hpp
+
+#include "WiiCommon.hpp"
+
+//
+// Cache modes for MEM2 allocations.
+//
+enum {
+  kWiiMem2CacheModeCopyback = 0,
+  kWiiMem2CacheModeInhibit  = 1,
+  kWiiMem2CacheModeCount
+};
+
+//
+// All allocations are aligned to at least a cache line.
+// Allocations up to kWiiMem2SlabMaxSize are aligned to their rounded up power of two size and never cross a page,
+// larger allocations are page aligned and physically contiguous.
+//
+#define kWiiMem2MinAlignment        32
+#define kWiiMem2SlabMaxSize         2048
+
+//
+// Opaque client handle. Each client has its own quota, statistics, and per-size magazine caches.
+// Calls using a client handle are not locked against each other and must be serialized by the client,
+// typically by only calling within the client's workloop.
+//
+typedef struct WiiMem2Client WiiMem2Client;
+
+//
+// MEM2 allocation service, obtained with kWiiFuncPlatformGetMem2Service.
+//
+// createClient:  creates a client, quota is in bytes with zero being unlimited.
+// destroyClient: destroys a client. Outstanding allocations are not freed.
+// allocate:      allocates a buffer mapped with the specified cache mode, returning both addresses.
+// deallocate:    frees a buffer by its physical address.
+//
+typedef struct {
+  WiiMem2Client *(*createClient)(const char *name, IOByteCount quota);
+  void (*destroyClient)(WiiMem2Client *client);
+  IOReturn (*allocate)(WiiMem2Client *client, IOByteCount length, UInt32 cacheMode,
+                       IOPhysicalAddress *physAddr, void **buffer);
+  void (*deallocate)(WiiMem2Client *client, IOPhysicalAddress physAddr);
+} WiiMem2Service;
+
+#endif
@@ -0,0 +1,176 @@
+//
+//  WiiPairedSingle.hpp
+//  Wii paired-single floating point functions
+//
+// See https://wiibrew.org/wiki/Paired_single.
+// Broadway and Espresso pair two single precision values in each FPR, with quantized loads and stores that
+// convert to and from integer formats through the GQRs. The conversion has a scalar reference implementation
+// that produces bit-identical results, used for any unpaired remainder and when not building for the kernel.
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef WiiPairedSingle_hpp
+#define WiiPairedSingle_hpp
+
+#include "WiiCommon.hpp"
+
+//
+// HID2 and GQR SPRs.
+//
+#define kWiiPSSPRHID2               920
+#define kWiiPSSPRGQR6               918
+#define kWiiPSSPRGQR7               919
+
+#define kWiiPSHID2LoadStoreQuantize BIT31
+#define kWiiPSHID2PairedSingle      BIT29
+
+//
+// Quantization registers used by these functions, GQR6 is unscaled float and GQR7 is signed 16-bit with a scale of 15.
+// Quantized loads divide by 2^scale, stores multiply by 2^scale then saturate and truncate toward zero.
+//
+#define kWiiPSGQRFloat              6
+#define kWiiPSGQRSInt16             7
+
+#define kWiiPSGQRTypeFloat          0
+#define kWiiPSGQRTypeSInt16         7
+#define WiiPSGQRValue(type, scale)  (((scale) << 24) | ((type) << 16) | ((scale) << 8) | (type))
+
+//
+// Pairs processed per paired-single section. Interrupts are disabled for each section, this bounds the latency.
+//
+#define kWiiPSSectionPairs          128
+
+//
+// Instruction encodings, the kernel assembler does not know the paired-single mnemonics.
+// Registers are numbers, not names.
+//
+#define kWiiPSOpPsqLU               57
+#define kWiiPSOpPsqStU              61
+#define kWiiPSXOMulS0               12
+
+#define WiiPSQuantized(op, frS, d, rA, gqr) \
+  (((op) << 26) | ((frS) << 21) | ((rA) << 16) | ((gqr) << 12) | ((d) & 0xFFF))
+#define WiiPSArith(xo, frD, frA, frB, frC) \
+  ((4 << 26) | ((frD) << 21) | ((frA) << 16) | ((frB) << 11) | ((frC) << 6) | ((xo) << 1))
+
+//
+// Clip loop body, r9 and r10 point one pair before the input and output and f2 holds the scale.
+// Loads a float pair with update, scales it, and stores it as a signed 16-bit pair with update.
+//
+#define kWiiPSClipLoad              WiiPSQuantized(kWiiPSOpPsqLU, 0, 8, 9, kWiiPSGQRFloat)
+#define kWiiPSClipScale             WiiPSArith(kWiiPSXOMulS0, 0, 0, 0, 2)
+#define kWiiPSClipStore             WiiPSQuantized(kWiiPSOpPsqStU, 0, 4, 10, kWiiPSGQRSInt16)
+
+#define WiiPSStringify2(x)  #x
+#define WiiPSStringify(x)   WiiPSStringify2(x)
+#define WiiPSInstruction(x) ".long " WiiPSStringify(x) "\n"
+
+//
+// Saved state for a paired-single section.
+//
+typedef struct {
+  UInt32    hid2;
+  UInt32    gqrFloat;
+  UInt32    gqrSInt16;
+  boolean_t interruptsEnabled;
+} WiiPairedSingleContext;
+
+//
+// Scalar reference implementation.
+//
+// Converts floats to signed 16-bit samples, scaled by a factor and saturated to [-1.0, 1.0).
+//
+inline void convertFloatToSInt16Reference(const float *in, SInt16 *out, UInt32 count, float scale) {
+  float value;
+
+  for (UInt32 i = 0; i < count; i++) {
+    value  = in[i] * scale;
+    value *= 32768.0f;
+    if (value >= 32767.0f) {
+      out[i] = 32767;
+    } else if (value <= -32768.0f) {
+      out[i] = -32768;
+    } else {
+      out[i] = (SInt16) value;
+    }
+  }
+}
+
+#if defined(KERNEL) && defined(__ppc__)
+//
+// Starts a paired-single section, enabling paired-single and quantized load/store instructions and loading the GQRs.
+//
+// The kernel only saves the first half of each FPR and none of HID2 or the GQRs on a context switch, interrupts are
+// disabled until the section ends so nothing else can run on this processor in between.
+// The caller must already be using the FPU.
+//
+inline void beginPairedSingle(WiiPairedSingleContext *context) {
+  context->interruptsEnabled = ml_set_interrupts_enabled(false);
+
+  __asm__ volatile("mfspr %0, %1" : "=r" (context->hid2) : "i" (kWiiPSSPRHID2));
+  __asm__ volatile("mfspr %0, %1" : "=r" (context->gqrFloat) : "i" (kWiiPSSPRGQR6));
+  __asm__ volatile("mfspr %0, %1" : "=r" (context->gqrSInt16) : "i" (kWiiPSSPRGQR7));
+
+  __asm__ volatile("mtspr %0, %1; isync" : : "i" (kWiiPSSPRHID2),
+                   "r" (context->hid2 | kWiiPSHID2LoadStoreQuantize | kWiiPSHID2PairedSingle));
+  __asm__ volatile("mtspr %0, %1" : : "i" (kWiiPSSPRGQR6), "r" (WiiPSGQRValue(kWiiPSGQRTypeFloat, 0)));
+  __asm__ volatile("mtspr %0, %1; isync" : : "i" (kWiiPSSPRGQR7), "r" (WiiPSGQRValue(kWiiPSGQRTypeSInt16, 15)));
+}
+
+//
+// Ends a paired-single section, restoring the GQRs, HID2, and interrupts.
+//
+inline void endPairedSingle(WiiPairedSingleContext *context) {
+  __asm__ volatile("mtspr %0, %1" : : "i" (kWiiPSSPRGQR6), "r" (context->gqrFloat));
+  __asm__ volatile("mtspr %0, %1" : : "i" (kWiiPSSPRGQR7), "r" (context->gqrSInt16));
+  __asm__ volatile("sync; mtspr %0, %1; isync" : : "i" (kWiiPSSPRHID2), "r" (context->hid2) : "memory");
+
+  ml_set_interrupts_enabled(context->interruptsEnabled);
+}
+#endif
+
+//
+// Converts floats to signed 16-bit samples, scaled by a factor and saturated to [-1.0, 1.0).
+//
+inline void convertFloatToSInt16(const float *in, SInt16 *out, UInt32 count, float scale) {
+#if defined(KERNEL) && defined(__ppc__)
+  WiiPairedSingleContext  context;
+  UInt32                  pairs;
+
+  //
+  // Quantized stores of a pair must be word aligned.
+  //
+  if ((count > 0) && (((UInt32) out) & 0x2)) {
+    convertFloatToSInt16Reference(in++, out++, 1, scale);
+    count--;
+  }
+
+  while (count >= 2) {
+    pairs = ((count / 2) > kWiiPSSectionPairs) ? kWiiPSSectionPairs : (count / 2);
+
+    beginPairedSingle(&context);
+    __asm__ volatile(
+      "fmr    f2, %2\n"
+      "mtctr  %3\n"
+      "addi   r9, %0, -8\n"
+      "addi   r10, %1, -4\n"
+      "1:\n"
+      WiiPSInstruction(kWiiPSClipLoad)
+      WiiPSInstruction(kWiiPSClipScale)
+      WiiPSInstruction(kWiiPSClipStore)
+      "bdnz   1b\n"
+      : : "b" (in), "b" (out), "f" (scale), "r" (pairs)
+      : "r9", "r10", "ctr", "fr0", "fr2", "memory");
+    endPairedSingle(&context);
+
+    in    += pairs * 2;
+    out   += pairs * 2;
+    count -= pairs * 2;
+  }
+#endif
+
+  convertFloatToSInt16Reference(in, out, count, scale);
+}
+
+#endif
@@ -66,8 +66,12 @@
 #define kWiiPIRegFifoCurrentWritePointer      0x14
 
 // Interrupt cause/mask (Wii U).
+// Each core has its own cause and mask register pair.
 #define kWiiPIRegCafeInterruptCPU0Base        0x78
 #define kWiiPIRegCafeInterruptCauseBase       0x78
 #define kWiiPIRegCafeInterruptMaskBase        0x7C
+#define kWiiPIRegCafeInterruptCoreLength      0x08
+#define kWiiPIRegCafeInterruptCause(core)     (kWiiPIRegCafeInterruptCauseBase + ((core) * kWiiPIRegCafeInterruptCoreLength))
+#define kWiiPIRegCafeInterruptMask(core)      (kWiiPIRegCafeInterruptMaskBase + ((core) * kWiiPIRegCafeInterruptCoreLength))
 
 #endif
@@ -0,0 +1,104 @@
+//
+//  TestEHCIDriver.h
+//  EHCI driver as used by the host tests
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef TestEHCIDriver_h
+#define TestEHCIDriver_h
+
+#include "TestPlatform.h"
+#include "WiiEHCI.hpp"
+
+//
+// Driver with the UIM functions callable from the test, entered through the work loop gate as the USB family does.
+// Endpoints are created through the IOUSBControllerV2 functions, as for a device directly on a root port.
+//
+class TestEHCI : public WiiEHCI {
+  OSDeclareDefaultStructors(TestEHCI);
+
+public:
+  IOReturn createControlEndpoint(UInt8 function, UInt8 endpoint, UInt16 maxPacketSize) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMCreateControlEndpoint(function, endpoint, maxPacketSize, kUSBDeviceSpeedHigh, 0, 0);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn createControlTransfer(UInt8 function, UInt8 endpoint, IOUSBCompletion completion,
+                                 IOMemoryDescriptor *buffer, UInt32 bufferSize, short direction) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMCreateControlTransfer(function, endpoint, completion, buffer, true, bufferSize, direction);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn createBulkEndpoint(UInt8 function, UInt8 endpoint, UInt8 direction, UInt16 maxPacketSize) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMCreateBulkEndpoint(function, endpoint, direction, kUSBDeviceSpeedHigh, maxPacketSize, 0, 0);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn createBulkTransfer(UInt8 function, UInt8 endpoint, IOUSBCompletion completion,
+                              IOMemoryDescriptor *buffer, bool bufferRounding, UInt32 bufferSize, short direction) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMCreateBulkTransfer(function, endpoint, completion, buffer, bufferRounding, bufferSize, direction);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn createInterruptEndpoint(UInt8 function, UInt8 endpoint, UInt8 direction, UInt16 maxPacketSize, short pollingRate) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMCreateInterruptEndpoint(function, endpoint, direction, kUSBDeviceSpeedHigh, maxPacketSize, pollingRate, 0, 0);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn createInterruptTransfer(UInt8 function, UInt8 endpoint, IOUSBCompletion completion,
+                                   IOMemoryDescriptor *buffer, UInt32 bufferSize, short direction) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMCreateInterruptTransfer(function, endpoint, completion, buffer, true, bufferSize, direction);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn abortEndpoint(UInt8 function, UInt8 endpoint, short direction) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMAbortEndpoint(function, endpoint, direction);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn deleteEndpoint(UInt8 function, UInt8 endpoint, short direction) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMDeleteEndpoint(function, endpoint, direction);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn clearEndpointStall(UInt8 function, UInt8 endpoint, short direction) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMClearEndpointStall(function, endpoint, direction);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  void pollInterrupts(IOUSBCompletionAction safeAction) {
+    getWorkLoop()->closeGate();
+    PollInterrupts(safeAction);
+    getWorkLoop()->openGate();
+  }
+};
+
+#endif
@@ -0,0 +1,755 @@
+//
+//  TestEHCIModel.cpp
+//  Software EHCI host controller for the host tests
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "TestEHCIModel.h"
+
+#define kTestEHCIVersion              0x0100
+#define kTestEHCICompanionCount       2
+#define kTestEHCIBufferPageSize       0x1000
+#define kTestEHCICurrentPageShift     12
+#define kTestEHCIMaxAsyncVisits       100000
+#define kTestEHCIMaxPeriodicVisits    1024
+#define kTestEHCIMaxLateFrames        4
+#define kTestEHCIMaxPacketSize        1024
+#define kTestEHCIPortEmpty            0xFF
+#define kTestEHCILineStatusJState     (2 << 10)
+
+static UInt64 getMonotonicNanoseconds(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (((UInt64) ts.tv_sec) * 1000000000ULL) + ts.tv_nsec;
+}
+
+TestEHCIModel::TestEHCIModel(IOService *nub) {
+  _nub           = nub;
+  _running       = false;
+  _endpointCount = 0;
+  bzero(_endpoints, sizeof (_endpoints));
+  pthread_mutex_init(&_mutex, NULL);
+
+  //
+  // Ports start unpowered and owned by the companion controllers, until the configure flag is set.
+  //
+  for (UInt32 i = 0; i < kTestEHCIRootHubPorts; i++) {
+    _portStatus[i] = kEHCIRegPortStatusOwner;
+    _portSpeed[i]  = kTestEHCIPortEmpty;
+    _portResets[i] = 0;
+  }
+  _hollywoodControl = 0;
+
+  _frames           = 0;
+  _retiredTransfers = 0;
+  _asyncAdvances    = 0;
+  reset();
+}
+
+TestEHCIModel::~TestEHCIModel(void) {
+  stop();
+  pthread_mutex_destroy(&_mutex);
+}
+
+//
+// Resets the controller registers, devices stay connected to the ports.
+//
+void TestEHCIModel::reset(void) {
+  _command              = 0;
+  _status               = 0;
+  _intEnable            = 0;
+  _frameIndex           = 0;
+  _periodicListBase     = 0;
+  _asyncListAddr        = 0;
+  _asyncCurrentQH       = 0;
+  _asyncAdvancePending  = false;
+  _configFlag           = 0;
+
+  for (UInt32 i = 0; i < kTestEHCIRootHubPorts; i++) {
+    setPortOwner(i, true);
+  }
+}
+
+UInt32 TestEHCIModel::readReg32(UInt32 offset) {
+  UInt32 value;
+
+  lock();
+  switch (offset) {
+    case kEHCIRegCapLength:
+      value = kTestEHCICapLength | (kTestEHCIVersion << kEHCIRegCapVersionShift);
+      break;
+
+    case kEHCIRegHCSParams:
+      value = kTestEHCIRootHubPorts | kEHCIRegHCSParamsPortPower | (kTestEHCICompanionCount << kEHCIRegHCSParamsNumCCShift);
+      break;
+
+    case kEHCIRegHCCParams:
+      value = 0;
+      break;
+
+    case kEHCIRegHollywoodControl:
+      value = _hollywoodControl;
+      break;
+
+    default:
+      value = (offset >= kTestEHCICapLength) ? readOpReg32(offset - kTestEHCICapLength) : 0;
+      break;
+  }
+  unlock();
+  return value;
+}
+
+void TestEHCIModel::writeReg32(UInt32 offset, UInt32 data) {
+  lock();
+  if (offset == kEHCIRegHollywoodControl) {
+    _hollywoodControl = data;
+  } else if (offset >= kTestEHCICapLength) {
+    writeOpReg32(offset - kTestEHCICapLength, data);
+  }
+  unlock();
+}
+
+//
+// Schedule status follows the command register at once, the controller halts as soon as it is stopped.
+//
+UInt32 TestEHCIModel::readOpReg32(UInt32 offset) {
+  UInt32 value;
+  UInt32 port;
+
+  switch (offset) {
+    case kEHCIRegCommand:
+      return _command;
+
+    case kEHCIRegStatus:
+      value = _status;
+      if (_command & kEHCIRegCommandRun) {
+        value |= (_command & kEHCIRegCommandAsyncEnable) ? kEHCIRegStatusAsyncStatus : 0;
+        value |= (_command & kEHCIRegCommandPeriodicEnable) ? kEHCIRegStatusPeriodicStatus : 0;
+      } else {
+        value |= kEHCIRegStatusHalted;
+      }
+      return value;
+
+    case kEHCIRegIntEnable:         return _intEnable;
+    case kEHCIRegFrameIndex:        return _frameIndex;
+    case kEHCIRegPeriodicListBase:  return _periodicListBase;
+    case kEHCIRegAsyncListAddr:     return _asyncCurrentQH;
+    case kEHCIRegConfigFlag:        return _configFlag;
+
+    default:
+      port = (offset - kEHCIRegPortStatusBase) / sizeof (UInt32);
+      return ((offset >= kEHCIRegPortStatusBase) && (port < kTestEHCIRootHubPorts)) ? _portStatus[port] : 0;
+  }
+}
+
+void TestEHCIModel::writeOpReg32(UInt32 offset, UInt32 data) {
+  UInt32 port;
+
+  switch (offset) {
+    //
+    // Reset completes immediately. The doorbell stays set until it is answered.
+    //
+    case kEHCIRegCommand:
+      if (data & kEHCIRegCommandHostControllerReset) {
+        reset();
+        break;
+      }
+      if (data & kEHCIRegCommandAsyncAdvanceDoorbell) {
+        _asyncAdvancePending = true;
+      }
+      _command = data & ~(kEHCIRegCommandAsyncAdvanceDoorbell);
+      if (_asyncAdvancePending) {
+        _command |= kEHCIRegCommandAsyncAdvanceDoorbell;
+      }
+      break;
+
+    case kEHCIRegStatus:
+      _status &= ~(data & kEHCIRegStatusIntMask);
+      break;
+
+    case kEHCIRegIntEnable:
+      _intEnable = data & kEHCIRegStatusIntMask;
+      break;
+
+    case kEHCIRegFrameIndex:
+      if ((_command & kEHCIRegCommandRun) == 0) {
+        _frameIndex = data & kEHCIRegFrameIndexMask;
+      }
+      break;
+
+    case kEHCIRegPeriodicListBase:
+      _periodicListBase = data & ~(kTestEHCIBufferPageSize - 1);
+      break;
+
+    case kEHCIRegAsyncListAddr:
+      _asyncListAddr  = data & kEHCILinkPhysAddrMask;
+      _asyncCurrentQH = _asyncListAddr;
+      break;
+
+    //
+    // Setting the configure flag routes every port here, clearing it routes them all to the companions.
+    //
+    case kEHCIRegConfigFlag:
+      if ((data & kEHCIRegConfigFlagRouteEHCI) != (_configFlag & kEHCIRegConfigFlagRouteEHCI)) {
+        for (UInt32 i = 0; i < kTestEHCIRootHubPorts; i++) {
+          setPortOwner(i, (data & kEHCIRegConfigFlagRouteEHCI) == 0);
+        }
+      }
+      _configFlag = data & kEHCIRegConfigFlagRouteEHCI;
+      break;
+
+    default:
+      port = (offset - kEHCIRegPortStatusBase) / sizeof (UInt32);
+      if ((offset >= kEHCIRegPortStatusBase) && (port < kTestEHCIRootHubPorts)) {
+        writePortStatus(port, data);
+      }
+      break;
+  }
+}
+
+//
+// Change bits are write 1 to clear, and the enable bit can only be cleared by software.
+// A reset runs until software ends it, then only enables the port for a high speed device.
+//
+void TestEHCIModel::writePortStatus(UInt32 port, UInt32 data) {
+  UInt32 *portStatus;
+
+  portStatus = &_portStatus[port];
+  if ((data & kEHCIRegPortStatusOwner) != (*portStatus & kEHCIRegPortStatusOwner)) {
+    setPortOwner(port, (data & kEHCIRegPortStatusOwner) != 0);
+  }
+  if (*portStatus & kEHCIRegPortStatusOwner) {
+    return;
+  }
+
+  *portStatus &= ~(data & kEHCIRegPortStatusChangeMask);
+  if ((data & kEHCIRegPortStatusEnable) == 0) {
+    *portStatus &= ~(kEHCIRegPortStatusEnable);
+  }
+
+  if (data & kEHCIRegPortStatusPower) {
+    *portStatus |= kEHCIRegPortStatusPower;
+  } else {
+    *portStatus &= ~(kEHCIRegPortStatusPower | kEHCIRegPortStatusEnable);
+  }
+  if ((data & kEHCIRegPortStatusSuspend) && (*portStatus & kEHCIRegPortStatusEnable)) {
+    *portStatus |= kEHCIRegPortStatusSuspend;
+  }
+  if (data & kEHCIRegPortStatusForceResume) {
+    *portStatus |= kEHCIRegPortStatusForceResume;
+  } else if (*portStatus & kEHCIRegPortStatusForceResume) {
+    *portStatus &= ~(kEHCIRegPortStatusForceResume | kEHCIRegPortStatusSuspend);
+  }
+
+  if ((data & kEHCIRegPortStatusReset) && ((*portStatus & kEHCIRegPortStatusReset) == 0)) {
+    *portStatus = (*portStatus & ~(kEHCIRegPortStatusEnable | kEHCIRegPortStatusSuspend)) | kEHCIRegPortStatusReset;
+    _portResets[port]++;
+  } else if (((data & kEHCIRegPortStatusReset) == 0) && (*portStatus & kEHCIRegPortStatusReset)) {
+    *portStatus &= ~(kEHCIRegPortStatusReset);
+    if ((*portStatus & kEHCIRegPortStatusConnect) && (_portSpeed[port] == kUSBDeviceSpeedHigh)) {
+      *portStatus |= kEHCIRegPortStatusEnable;
+    }
+  }
+}
+
+//
+// Hands a port to the companion controller, where the device is no longer seen here, or takes it back.
+//
+void TestEHCIModel::setPortOwner(UInt32 port, bool companion) {
+  UInt32 *portStatus;
+
+  portStatus = &_portStatus[port];
+  if (companion) {
+    *portStatus = (*portStatus & kEHCIRegPortStatusPower) | kEHCIRegPortStatusOwner;
+  } else {
+    *portStatus &= ~(kEHCIRegPortStatusOwner);
+    if (_portSpeed[port] != kTestEHCIPortEmpty) {
+      *portStatus |= kEHCIRegPortStatusConnect | kEHCIRegPortStatusConnectChange
+        | ((_portSpeed[port] == kUSBDeviceSpeedLow) ? kEHCIRegPortStatusLineStatusKState : kTestEHCILineStatusJState);
+      _status |= kEHCIRegStatusPortChange;
+    }
+  }
+}
+
+void TestEHCIModel::start(void) {
+  _running = true;
+  pthread_create(&_thread, NULL, threadMain, this);
+}
+
+void TestEHCIModel::stop(void) {
+  if (_running) {
+    _running = false;
+    pthread_join(_thread, NULL);
+  }
+}
+
+TestUSBEndpoint *TestEHCIModel::addEndpoint(UInt8 function, UInt8 endpoint, UInt8 direction) {
+  TestUSBEndpoint *device;
+
+  if (_endpointCount == kTestEHCIMaxDeviceEndpoints) {
+    return NULL;
+  }
+
+  lock();
+  device = &_endpoints[_endpointCount++];
+  bzero(device, sizeof (*device));
+  device->function    = function;
+  device->endpoint    = endpoint;
+  device->direction   = direction;
+  device->inAvailable = kTestUSBUnlimited;
+  unlock();
+  return device;
+}
+
+void TestEHCIModel::connectPort(UInt32 port, UInt8 speed) {
+  lock();
+  _portSpeed[port - 1] = speed;
+  if ((_portStatus[port - 1] & kEHCIRegPortStatusOwner) == 0) {
+    setPortOwner(port - 1, false);
+  }
+  unlock();
+}
+
+bool TestEHCIModel::isPortCompanionOwned(UInt32 port) {
+  bool owned;
+
+  lock();
+  owned = (_portStatus[port - 1] & kEHCIRegPortStatusOwner) != 0;
+  unlock();
+  return owned;
+}
+
+void *TestEHCIModel::threadMain(void *param) {
+  TestEHCIModel   *model;
+  UInt64          nextFrame;
+  UInt64          now;
+  struct timespec ts;
+
+  model     = (TestEHCIModel *) param;
+  nextFrame = getMonotonicNanoseconds();
+  while (model->_running) {
+    model->runFrame();
+
+    //
+    // Frames missed by more than a few intervals are dropped rather than run in a burst.
+    //
+    nextFrame += kTestEHCIFrameIntervalUS * 1000ULL;
+    now        = getMonotonicNanoseconds();
+    if (now > (nextFrame + (kTestEHCIFrameIntervalUS * 1000ULL * kTestEHCIMaxLateFrames))) {
+      nextFrame = now;
+    } else if (now < nextFrame) {
+      ts.tv_sec  = nextFrame / 1000000000ULL;
+      ts.tv_nsec = nextFrame % 1000000000ULL;
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+  }
+  return NULL;
+}
+
+//
+// The Hollywood control register is kept but does not hold back interrupts, the tests run the driver as on Wii U.
+//
+bool TestEHCIModel::isInterruptPending(void) {
+  return (_status & _intEnable & kEHCIRegStatusIntMask) != 0;
+}
+
+//
+// Interrupts are raised without the lock held, the driver's filter reads and writes registers.
+//
+void TestEHCIModel::raiseInterrupt(bool pending) {
+  if (pending) {
+    _nub->hostRaiseInterrupt(0);
+  }
+}
+
+//
+// Runs a single frame.
+//
+void TestEHCIModel::runFrame(void) {
+  bool pending;
+
+  lock();
+  if ((_command & kEHCIRegCommandRun) == 0) {
+    unlock();
+    return;
+  }
+
+  _frameIndex = (_frameIndex + kEHCIMicroframesPerFrame) & kEHCIRegFrameIndexMask;
+  if (((_frameIndex >> kEHCIRegFrameIndexFrameShift) & kEHCIRegFrameIndexFrameMask) == 0) {
+    _status |= kEHCIRegStatusFrameListRollover;
+  }
+  _frames++;
+
+  //
+  // Periodic schedule goes first, the asynchronous schedule uses the rest of the frame.
+  //
+  _frameBytes = kTestEHCIFrameBytes;
+  if (_command & kEHCIRegCommandPeriodicEnable) {
+    processPeriodicSchedule();
+  }
+  if (_command & kEHCIRegCommandAsyncEnable) {
+    processAsyncSchedule();
+  }
+
+  //
+  // Answer the doorbell once the frame is done, the controller no longer holds any queue head it was given.
+  //
+  if (_asyncAdvancePending) {
+    _asyncAdvancePending = false;
+    _command            &= ~(kEHCIRegCommandAsyncAdvanceDoorbell);
+    _status             |= kEHCIRegStatusAsyncAdvance;
+    _asyncCurrentQH      = _asyncListAddr;
+    _asyncAdvances++;
+  }
+
+  pending = isInterruptPending();
+  unlock();
+  raiseInterrupt(pending);
+}
+
+//
+// Finds the device endpoint addressed by a queue head.
+//
+TestUSBEndpoint *TestEHCIModel::findEndpoint(UInt32 qhFlags, UInt8 direction) {
+  UInt8 function;
+  UInt8 endpoint;
+
+  function = qhFlags & kEHCIQHFlagsFuncMask;
+  endpoint = (qhFlags & kEHCIQHFlagsEndpointMask) >> kEHCIQHFlagsEndpointShift;
+  for (UInt32 i = 0; i < _endpointCount; i++) {
+    if ((_endpoints[i].function == function) && (_endpoints[i].endpoint == endpoint)
+        && ((_endpoints[i].direction == kUSBNone) || (_endpoints[i].direction == direction))) {
+      return &_endpoints[i];
+    }
+  }
+  return NULL;
+}
+
+UInt32 TestEHCIModel::getPacketCost(UInt32 qhFlags, UInt32 length) {
+  UInt32 cost;
+
+  cost = length + kTestEHCIPacketOverheadBytes;
+  if ((qhFlags & kEHCIQHFlagsSpeedMask) == kEHCIQHFlagsSpeedFull) {
+    cost *= kTestEHCIFullSpeedMultiplier;
+  } else if ((qhFlags & kEHCIQHFlagsSpeedMask) == kEHCIQHFlagsSpeedLow) {
+    cost *= kTestEHCILowSpeedMultiplier;
+  }
+  return cost;
+}
+
+//
+// Copies a packet between the current position of the overlay's buffer pages and a packet buffer.
+// Returns false if the buffer runs off the last page or is not mapped.
+//
+bool TestEHCIModel::copyBuffer(EHCIQueueHead *qh, UInt8 *packet, UInt32 length, bool toDevice) {
+  UInt8   *buffer;
+  UInt32  page;
+  UInt32  pageOffset;
+  UInt32  chunk;
+  UInt32  done;
+
+  page       = (USBToHostLong(qh->token) & kEHCIQueueTDTokenCurrentPageMask) >> kTestEHCICurrentPageShift;
+  pageOffset = USBToHostLong(qh->bufferPhysAddr[0]) & (kTestEHCIBufferPageSize - 1);
+  done       = 0;
+  while (done < length) {
+    if (page >= kEHCIQueueTDBufferCount) {
+      return false;
+    }
+
+    chunk = kTestEHCIBufferPageSize - pageOffset;
+    if (chunk > (length - done)) {
+      chunk = length - done;
+    }
+    buffer = (UInt8 *) hostPhysToVirt((USBToHostLong(qh->bufferPhysAddr[page]) & ~(kTestEHCIBufferPageSize - 1)) + pageOffset);
+    if (buffer == NULL) {
+      return false;
+    }
+
+    if (toDevice) {
+      memcpy(&packet[done], buffer, chunk);
+    } else {
+      memcpy(buffer, &packet[done], chunk);
+    }
+    done       += chunk;
+    pageOffset += chunk;
+    if (pageOffset == kTestEHCIBufferPageSize) {
+      page++;
+      pageOffset = 0;
+    }
+  }
+  return true;
+}
+
+//
+// Loads the next transfer descriptor into the queue head overlay.
+// After a short packet the alternate next pointer is taken if it is valid.
+// Returns false if the next descriptor is not active.
+//
+bool TestEHCIModel::loadTransfer(EHCIQueueHead *qh) {
+  EHCIQueueTransferDescriptor *td;
+  UInt32                      link;
+  UInt32                      token;
+  UInt32                      tdToken;
+
+  token = USBToHostLong(qh->token);
+  link  = USBToHostLong(qh->altNextTDPhysAddr);
+  if ((((token & kEHCIQueueTDTokenBytesMask) >> kEHCIQueueTDTokenBytesShift) == 0) || (link & kEHCILinkTerminate)) {
+    link = USBToHostLong(qh->nextTDPhysAddr);
+  }
+  if (link & kEHCILinkTerminate) {
+    return false;
+  }
+
+  td = (EHCIQueueTransferDescriptor *) hostPhysToVirt(link & ~(kEHCIQueueTDAlignment - 1));
+  if (td == NULL) {
+    _status |= kEHCIRegStatusHostSystemError;
+    return false;
+  }
+  hostCheckDeviceRead(td, sizeof (*td));
+  tdToken = USBToHostLong(td->token);
+  if ((tdToken & kEHCIQueueTDTokenStatusActive) == 0) {
+    return false;
+  }
+
+  //
+  // The data toggle comes from the descriptor only if the queue head defers to it.
+  //
+  if ((USBToHostLong(qh->flags) & kEHCIQHFlagsDataToggleControl) == 0) {
+    tdToken = (tdToken & ~(kEHCIQueueTDTokenDataToggle)) | (token & kEHCIQueueTDTokenDataToggle);
+  }
+
+  qh->currentTDPhysAddr = HostToUSBLong(link & ~(kEHCIQueueTDAlignment - 1));
+  qh->nextTDPhysAddr    = td->nextTDPhysAddr;
+  qh->altNextTDPhysAddr = td->altNextTDPhysAddr;
+  for (UInt32 i = 0; i < kEHCIQueueTDBufferCount; i++) {
+    qh->bufferPhysAddr[i] = td->bufferPhysAddr[i];
+  }
+  qh->token = HostToUSBLong(tdToken);
+  return true;
+}
+
+//
+// Writes the overlay back to the current transfer descriptor, which is then done.
+//
+void TestEHCIModel::retireTransfer(EHCIQueueHead *qh, UInt32 token) {
+  EHCIQueueTransferDescriptor *td;
+
+  qh->token = HostToUSBLong(token);
+  td = (EHCIQueueTransferDescriptor *) hostPhysToVirt(USBToHostLong(qh->currentTDPhysAddr));
+  if (td == NULL) {
+    _status |= kEHCIRegStatusHostSystemError;
+    return;
+  }
+
+  td->bufferPhysAddr[0] = qh->bufferPhysAddr[0];
+  td->token             = HostToUSBLong(token);
+  hostDeviceWrote(td, sizeof (*td));
+  _retiredTransfers++;
+
+  //
+  // Short packets interrupt as if the descriptor asked for it.
+  //
+  if (token & kEHCIQueueTDTokenStatusHalted) {
+    _status |= kEHCIRegStatusErrorInterrupt;
+  } else if ((token & kEHCIQueueTDTokenIOC) || ((token & kEHCIQueueTDTokenBytesMask) != 0)) {
+    _status |= kEHCIRegStatusInterrupt;
+  }
+}
+
+//
+// Sends a single packet for the transfer in a queue head's overlay, loading the next transfer first if needed.
+// Returns true if a packet was sent or the transfer failed, false if the queue head is idle or the packet was NAKed.
+//
+bool TestEHCIModel::processQueueHead(EHCIQueueHead *qh, bool *noBandwidth) {
+  TestUSBEndpoint *device;
+  UInt8           packet[kTestEHCIMaxPacketSize];
+  UInt32          qhFlags;
+  UInt32          token;
+  UInt32          bytes;
+  UInt32          maxPacketSize;
+  UInt32          length;
+  UInt32          actual;
+  UInt32          cost;
+  UInt32          position;
+  UInt8           direction;
+  bool            sent;
+
+  token = USBToHostLong(qh->token);
+  if (token & kEHCIQueueTDTokenStatusHalted) {
+    return false;
+  }
+  if ((token & kEHCIQueueTDTokenStatusActive) == 0) {
+    if (!loadTransfer(qh)) {
+      return false;
+    }
+    token = USBToHostLong(qh->token);
+  }
+
+  qhFlags = USBToHostLong(qh->flags);
+  if ((token & kEHCIQueueTDTokenPIDMask) == kEHCIQueueTDTokenPIDIn) {
+    direction = kUSBIn;
+  } else if ((token & kEHCIQueueTDTokenPIDMask) == kEHCIQueueTDTokenPIDOut) {
+    direction = kUSBOut;
+  } else {
+    direction = kUSBNone;
+  }
+
+  maxPacketSize = (qhFlags & kEHCIQHFlagsMaxPktSizeMask) >> kEHCIQHFlagsMaxPktSizeShift;
+  if (maxPacketSize > kTestEHCIMaxPacketSize) {
+    maxPacketSize = kTestEHCIMaxPacketSize;
+  }
+  bytes  = (token & kEHCIQueueTDTokenBytesMask) >> kEHCIQueueTDTokenBytesShift;
+  length = (bytes < maxPacketSize) ? bytes : maxPacketSize;
+
+  //
+  // Inbound packets may be full sized whatever is left in the buffer.
+  //
+  cost = getPacketCost(qhFlags, (direction == kUSBIn) ? maxPacketSize : length);
+  if ((SInt32) cost > _frameBytes) {
+    *noBandwidth = true;
+    return false;
+  }
+  _frameBytes -= cost;
+
+  //
+  // Missing devices fail the transaction as the error counter runs out, stalls halt the queue head.
+  //
+  device = findEndpoint(qhFlags, direction);
+  if (device == NULL) {
+    retireTransfer(qh, (token & ~(kEHCIQueueTDTokenStatusActive | kEHCIQueueTDTokenErrorCountMask))
+      | kEHCIQueueTDTokenStatusHalted | kEHCIQueueTDTokenStatusXactError);
+    return true;
+  }
+  if (device->stalled) {
+    device->packets++;
+    retireTransfer(qh, (token & ~(kEHCIQueueTDTokenStatusActive)) | kEHCIQueueTDTokenStatusHalted);
+    return true;
+  }
+
+  //
+  // Move the packet.
+  //
+  actual = length;
+  if (direction == kUSBIn) {
+    sent = testUSBInPacket(device, packet, length, maxPacketSize, &actual);
+    if (sent && !copyBuffer(qh, packet, actual, false)) {
+      _status |= kEHCIRegStatusHostSystemError;
+      return false;
+    }
+  } else {
+    if (!copyBuffer(qh, packet, length, true)) {
+      _status |= kEHCIRegStatusHostSystemError;
+      return false;
+    }
+    sent = (direction == kUSBOut) ? testUSBOutPacket(device, packet, length) : testUSBSetupPacket(device, packet, length);
+  }
+  if (!sent) {
+    return false;
+  }
+
+  //
+  // Advance the buffer position and byte count, and flip the data toggle.
+  //
+  position = (USBToHostLong(qh->bufferPhysAddr[0]) & (kTestEHCIBufferPageSize - 1)) + actual;
+  qh->bufferPhysAddr[0] = HostToUSBLong((USBToHostLong(qh->bufferPhysAddr[0]) & ~(kTestEHCIBufferPageSize - 1))
+    | (position & (kTestEHCIBufferPageSize - 1)));
+  token += (position / kTestEHCIBufferPageSize) << kTestEHCICurrentPageShift;
+  token  = (token & ~(kEHCIQueueTDTokenBytesMask)) | ((bytes - actual) << kEHCIQueueTDTokenBytesShift);
+  token ^= kEHCIQueueTDTokenDataToggle;
+
+  //
+  // The descriptor is done once its buffer is, or a short packet ends it.
+  //
+  if ((actual == bytes) || (actual < length)) {
+    retireTransfer(qh, token & ~(kEHCIQueueTDTokenStatusActive));
+  } else {
+    qh->token = HostToUSBLong(token);
+  }
+  return true;
+}
+
+//
+// Runs the queue heads linked from the frame list entry of the current frame.
+// High speed queue heads get a packet for each microframe in their start mask, others get one per frame.
+//
+void TestEHCIModel::processPeriodicSchedule(void) {
+  volatile UInt32 *frameList;
+  EHCIQueueHead   *qh;
+  UInt32          link;
+  UInt32          startMask;
+  UInt32          packets;
+  bool            noBandwidth;
+
+  frameList = (volatile UInt32 *) hostPhysToVirt(_periodicListBase);
+  if (frameList == NULL) {
+    _status |= kEHCIRegStatusHostSystemError;
+    return;
+  }
+
+  noBandwidth = false;
+  link        = USBToHostLong(frameList[(_frameIndex >> kEHCIRegFrameIndexFrameShift) & kEHCIRegFrameIndexFrameMask]);
+  for (UInt32 visits = 0; (visits < kTestEHCIMaxPeriodicVisits) && ((link & kEHCILinkTerminate) == 0); visits++) {
+    //
+    // Only queue heads are modelled.
+    //
+    if ((link & (kEHCILinkTypeFrameSpan)) != kEHCILinkTypeQueueHead) {
+      break;
+    }
+    qh = (EHCIQueueHead *) hostPhysToVirt(link & kEHCILinkPhysAddrMask);
+    if (qh == NULL) {
+      _status |= kEHCIRegStatusHostSystemError;
+      return;
+    }
+
+    startMask = USBToHostLong(qh->splitFlags) & kEHCIQHSplitFlagsStartMaskMask;
+    if (startMask != 0) {
+      packets = ((USBToHostLong(qh->flags) & kEHCIQHFlagsSpeedMask) == kEHCIQHFlagsSpeedHigh) ? __builtin_popcount(startMask) : 1;
+      for (UInt32 i = 0; (i < packets) && processQueueHead(qh, &noBandwidth); i++) { }
+    }
+    link = USBToHostLong(qh->horizLinkPhysAddr);
+  }
+}
+
+//
+// Goes round the asynchronous schedule from the next queue head, until a whole pass from the reclamation head
+// sends nothing or the frame is out of bus time.
+//
+void TestEHCIModel::processAsyncSchedule(void) {
+  EHCIQueueHead *qh;
+  bool          sentSinceHead;
+  bool          noBandwidth;
+
+  if (_asyncCurrentQH == 0) {
+    return;
+  }
+
+  sentSinceHead = false;
+  noBandwidth   = false;
+  for (UInt32 visits = 0; visits < kTestEHCIMaxAsyncVisits; visits++) {
+    qh = (EHCIQueueHead *) hostPhysToVirt(_asyncCurrentQH);
+    if (qh == NULL) {
+      _status |= kEHCIRegStatusHostSystemError;
+      return;
+    }
+
+    if (USBToHostLong(qh->flags) & kEHCIQHFlagsHead) {
+      if ((visits > 0) && !sentSinceHead) {
+        return;
+      }
+      sentSinceHead = false;
+    }
+
+    //
+    // A queue head without the bus time for its packet is visited first next frame.
+    //
+    if (processQueueHead(qh, &noBandwidth)) {
+      sentSinceHead = true;
+    }
+    if (noBandwidth) {
+      return;
+    }
+    _asyncCurrentQH = USBToHostLong(qh->horizLinkPhysAddr) & kEHCILinkPhysAddrMask;
+  }
+}
@@ -0,0 +1,140 @@
+//
+//  TestEHCIModel.h
+//  Software EHCI host controller for the host tests
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  The controller runs frames on its own host thread, paced at the 1ms USB frame rate. Each frame it walks the
+//  periodic frame list entry for the frame, then goes round the asynchronous schedule from where it last stopped
+//  until a whole pass from the reclamation head moves no data. Queue heads load queue element transfer descriptors
+//  into their overlay and execute them against the virtual devices, writing each back once done as the EHCI
+//  specification describes, including the alternate next pointer taken after a short packet.
+//
+//  The asynchronous schedule is only let go of when the doorbell is answered, which happens at the end of the next
+//  frame. Until then the controller keeps its place in the schedule, which may be a queue head the driver unlinked.
+//
+//  Bus time is counted in bytes, a frame has kTestEHCIFrameBytes and each packet costs its data plus
+//  kTestEHCIPacketOverheadBytes, scaled for full and low speed endpoints as split transactions take that much of
+//  the high speed bus. Only one packet is sent per queue head visit, or per set bit of the start mask for periodic
+//  queue heads.
+//
+//  Not modelled are split transaction state, isochronous descriptors, transmission errors and the error counter,
+//  ping, suspend and resume, and microframe timing within a frame. Stalls, NAKs and devices that are not present are
+//  the only failures a device can report. Ports handed to the companion controller simply go away.
+//
+
+#ifndef TestEHCIModel_h
+#define TestEHCIModel_h
+
+#include "HostKernel.h"
+#include "EHCIRegs.hpp"
+#include "TestUSBDevice.h"
+
+#define kTestEHCIRegsSize             0x100
+#define kTestEHCICapLength            0x10
+#define kTestEHCIRootHubPorts         4
+#define kTestEHCIFrameBytes           60000
+#define kTestEHCIPacketOverheadBytes  20
+#define kTestEHCIFullSpeedMultiplier  40
+#define kTestEHCILowSpeedMultiplier   320
+#define kTestEHCIMaxDeviceEndpoints   16
+#define kTestEHCIFrameIntervalUS      1000
+
+//
+// Software EHCI controller.
+//
+class TestEHCIModel : public HostDevice {
+  IOService       *_nub;
+  pthread_mutex_t _mutex;
+  pthread_t       _thread;
+  volatile bool   _running;
+
+  // Registers.
+  UInt32  _command;
+  UInt32  _status;
+  UInt32  _intEnable;
+  UInt32  _frameIndex;
+  UInt32  _periodicListBase;
+  UInt32  _asyncListAddr;
+  UInt32  _configFlag;
+  UInt32  _portStatus[kTestEHCIRootHubPorts];
+  UInt32  _hollywoodControl;
+
+  // Next asynchronous queue head to visit.
+  UInt32  _asyncCurrentQH;
+  // Doorbell rung and not yet answered.
+  bool    _asyncAdvancePending;
+  // Bus time left in the current frame.
+  SInt32  _frameBytes;
+
+  TestUSBEndpoint _endpoints[kTestEHCIMaxDeviceEndpoints];
+  UInt32          _endpointCount;
+  // Speed of the device on each port, only high speed devices are enabled by a reset.
+  UInt8           _portSpeed[kTestEHCIRootHubPorts];
+
+  // Statistics.
+  volatile UInt64 _frames;
+  volatile UInt64 _retiredTransfers;
+  volatile UInt32 _asyncAdvances;
+  volatile UInt32 _portResets[kTestEHCIRootHubPorts];
+
+  static void *threadMain(void *param);
+  void reset(void);
+  UInt32 readOpReg32(UInt32 offset);
+  void writeOpReg32(UInt32 offset, UInt32 data);
+  void writePortStatus(UInt32 port, UInt32 data);
+  void setPortOwner(UInt32 port, bool companion);
+  bool isInterruptPending(void);
+  void raiseInterrupt(bool pending);
+  void runFrame(void);
+  TestUSBEndpoint *findEndpoint(UInt32 qhFlags, UInt8 direction);
+  UInt32 getPacketCost(UInt32 qhFlags, UInt32 length);
+  bool copyBuffer(EHCIQueueHead *qh, UInt8 *packet, UInt32 length, bool toDevice);
+  bool loadTransfer(EHCIQueueHead *qh);
+  void retireTransfer(EHCIQueueHead *qh, UInt32 token);
+  bool processQueueHead(EHCIQueueHead *qh, bool *noBandwidth);
+  void processPeriodicSchedule(void);
+  void processAsyncSchedule(void);
+
+public:
+  TestEHCIModel(IOService *nub);
+  ~TestEHCIModel(void);
+
+  UInt32 readReg32(UInt32 offset);
+  void writeReg32(UInt32 offset, UInt32 data);
+
+  void start(void);
+  void stop(void);
+
+  void lock(void) {
+    pthread_mutex_lock(&_mutex);
+  }
+  void unlock(void) {
+    pthread_mutex_unlock(&_mutex);
+  }
+
+  //
+  // Adds a device endpoint, control endpoints use kUSBNone.
+  //
+  TestUSBEndpoint *addEndpoint(UInt8 function, UInt8 endpoint, UInt8 direction);
+  //
+  // Connects a device of the given speed to a port, low speed devices show a K state on the data lines.
+  //
+  void connectPort(UInt32 port, UInt8 speed);
+  bool isPortCompanionOwned(UInt32 port);
+
+  UInt64 getFrames(void) const {
+    return _frames;
+  }
+  UInt64 getRetiredTransfers(void) const {
+    return _retiredTransfers;
+  }
+  UInt32 getAsyncAdvances(void) const {
+    return _asyncAdvances;
+  }
+  UInt32 getPortResets(UInt32 port) const {
+    return _portResets[port - 1];
+  }
+};
+
+#endif
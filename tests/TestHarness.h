@@ -0,0 +1,61 @@
+//
+//  TestHarness.h
+//  Host test checks and timing
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef TestHarness_h
+#define TestHarness_h
+
+#include "HostKernel.h"
+
+static UInt32 gTestChecks;
+static UInt32 gTestFailures;
+
+//
+// Records a check, printing the failed condition.
+//
+#define TEST_CHECK(cond) testCheck((cond), #cond, __FILE__, __LINE__)
+
+inline void testCheck(bool result, const char *condition, const char *file, int line) {
+  gTestChecks++;
+  if (!result) {
+    gTestFailures++;
+    printf("FAIL %s:%d: %s\n", file, line, condition);
+  }
+}
+
+//
+// Prints the result of a test, returns the process exit status.
+//
+inline int testFinish(const char *name) {
+  printf("%s: %u checks, %u failures\n", name, gTestChecks, gTestFailures);
+  return (gTestFailures == 0) ? 0 : 1;
+}
+
+//
+// Gets a monotonic time in nanoseconds, for benchmarks.
+//
+inline UInt64 testGetNanoseconds(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (((UInt64) ts.tv_sec) * 1000000000ULL) + ts.tv_nsec;
+}
+
+//
+// Simple xorshift generator, so runs are repeatable.
+//
+inline UInt32 testRandom(UInt32 *state) {
+  UInt32 x;
+
+  x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+#endif
@@ -0,0 +1,182 @@
+//
+//  TestLockedCacheModel.cpp
+//  Software locked cache DMA engine for the host tests
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "TestLockedCacheModel.h"
+
+static UInt64 getMonotonicNanoseconds(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (((UInt64) ts.tv_sec) * 1000000000ULL) + ts.tv_nsec;
+}
+
+TestLockedCacheModel::TestLockedCacheModel(void) {
+  _running        = false;
+  _hid2           = 0;
+  _dmaUpper       = 0;
+  _queueHead      = 0;
+  _queueLength    = 0;
+  _lineDelayNS    = 0;
+  _commands       = 0;
+  _loadLines      = 0;
+  _storeLines     = 0;
+  _maxQueueLength = 0;
+  _errors         = 0;
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_cond, NULL);
+}
+
+TestLockedCacheModel::~TestLockedCacheModel(void) {
+  stop();
+  pthread_cond_destroy(&_cond);
+  pthread_mutex_destroy(&_mutex);
+}
+
+UInt32 TestLockedCacheModel::readReg32(UInt32 offset) {
+  UInt32 queueLength;
+
+  if (offset != kWiiLCSPRHID2) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&_mutex);
+  queueLength = _queueLength;
+  pthread_mutex_unlock(&_mutex);
+  return (_hid2 & ~kWiiLCHID2DMAQueueLengthMask) | ((queueLength << kWiiLCHID2DMAQueueLengthShift) & kWiiLCHID2DMAQueueLengthMask);
+}
+
+void TestLockedCacheModel::writeReg32(UInt32 offset, UInt32 data) {
+  TestLockedCacheCommand *command;
+  UInt32                 lines;
+
+  switch (offset) {
+    case kWiiLCSPRHID2:
+      _hid2 = data & ~kWiiLCHID2DMAQueueLengthMask;
+      break;
+
+    case kWiiLCSPRDMAUpper:
+      _dmaUpper = data;
+      break;
+
+    //
+    // Writing the lower register with the trigger bit queues a command, the length is split between both registers.
+    //
+    case kWiiLCSPRDMALower:
+      if ((data & kWiiLCDMALowerTrigger) == 0) {
+        break;
+      }
+
+      pthread_mutex_lock(&_mutex);
+      if (!isEnabled() || (_queueLength >= kWiiLCDMAQueueMax)) {
+        _errors++;
+        pthread_mutex_unlock(&_mutex);
+        break;
+      }
+
+      lines = ((_dmaUpper & kWiiLCDMAUpperLengthMask) << kWiiLCDMAUpperLengthShift) | ((data & kWiiLCDMALowerLengthMask) >> 2);
+      command = &_queue[(_queueHead + _queueLength) % kTestLCQueueSize];
+      command->memPhysAddr = _dmaUpper & kWiiLCDMAAddressMask;
+      command->lcPhysAddr  = data & kWiiLCDMAAddressMask;
+      command->lines       = (lines == 0) ? kWiiLCDMAMaxLines : lines;
+      command->load        = (data & kWiiLCDMALowerLoad) != 0;
+      _queueLength++;
+      _commands++;
+      if (_queueLength > _maxQueueLength) {
+        _maxQueueLength = _queueLength;
+      }
+      pthread_cond_signal(&_cond);
+      pthread_mutex_unlock(&_mutex);
+      break;
+
+    default:
+      break;
+  }
+}
+
+void TestLockedCacheModel::start(void) {
+  _running = true;
+  pthread_create(&_thread, NULL, threadMain, this);
+}
+
+void TestLockedCacheModel::stop(void) {
+  if (_running) {
+    pthread_mutex_lock(&_mutex);
+    _running = false;
+    pthread_cond_signal(&_cond);
+    pthread_mutex_unlock(&_mutex);
+    pthread_join(_thread, NULL);
+  }
+}
+
+//
+// Copies the lines of a command, taking the set time for each.
+//
+void TestLockedCacheModel::runCommand(const TestLockedCacheCommand *command) {
+  UInt8           *memory;
+  UInt8           *scratchpad;
+  UInt32          length;
+  UInt64          end;
+  UInt64          now;
+  struct timespec delay;
+
+  length     = command->lines * kWiiLockedCacheLineSize;
+  end        = getMonotonicNanoseconds() + ((UInt64) command->lines * _lineDelayNS);
+  memory     = (UInt8 *) hostPhysToVirt(command->memPhysAddr);
+  scratchpad = (UInt8 *) hostPhysToVirt(command->lcPhysAddr);
+  if ((memory == NULL) || (scratchpad == NULL) || (hostPhysToVirt(command->memPhysAddr + length - 1) != (memory + length - 1))
+      || (hostPhysToVirt(command->lcPhysAddr + length - 1) != (scratchpad + length - 1))) {
+    _errors++;
+    return;
+  }
+
+  if (command->load) {
+    hostCheckDeviceRead(memory, length);
+    memcpy(scratchpad, memory, length);
+    _loadLines += command->lines;
+  } else {
+    memcpy(memory, scratchpad, length);
+    hostDeviceWrote(memory, length);
+    _storeLines += command->lines;
+  }
+
+  //
+  // Sleep rather than spin so the submitting thread keeps running on a single processor.
+  //
+  now = getMonotonicNanoseconds();
+  if (now < end) {
+    delay.tv_sec  = (end - now) / 1000000000ULL;
+    delay.tv_nsec = (end - now) % 1000000000ULL;
+    nanosleep(&delay, NULL);
+  }
+}
+
+void *TestLockedCacheModel::threadMain(void *param) {
+  TestLockedCacheModel    *model;
+  TestLockedCacheCommand  command;
+
+  model = (TestLockedCacheModel *) param;
+  pthread_mutex_lock(&model->_mutex);
+  while (model->_running) {
+    if (model->_queueLength == 0) {
+      pthread_cond_wait(&model->_cond, &model->_mutex);
+      continue;
+    }
+
+    //
+    // The command stays counted in the queue length until it has finished.
+    //
+    command = model->_queue[model->_queueHead];
+    pthread_mutex_unlock(&model->_mutex);
+    model->runCommand(&command);
+    pthread_mutex_lock(&model->_mutex);
+
+    model->_queueHead = (model->_queueHead + 1) % kTestLCQueueSize;
+    model->_queueLength--;
+  }
+  pthread_mutex_unlock(&model->_mutex);
+  return NULL;
+}
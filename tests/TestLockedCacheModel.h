@@ -0,0 +1,103 @@
+//
+//  TestLockedCacheModel.h
+//  Software locked cache DMA engine for the host tests
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  The model stands in for HID2 and the locked cache DMA registers, reached through the shim's special purpose
+//  register hooks. Triggered commands are queued and run in order on their own host thread, copying whole lines
+//  between main memory and the scratchpad through their host physical mappings. HID2 reports the commands not yet
+//  finished, including the one running, as the hardware queue length does.
+//
+//  Each line can be made to take a set time, so callers see DMA still in progress. Loads check that main memory was
+//  flushed before the engine read it, and stores are recorded as device writes. Commands triggered with the locked
+//  cache disabled, with the queue full, or with addresses that have no host mapping are counted as errors and dropped.
+//
+//  Not modelled are the flush command, the cache itself, and any bus contention with the processor.
+//
+
+#ifndef TestLockedCacheModel_h
+#define TestLockedCacheModel_h
+
+#include "HostKernel.h"
+#include "WiiLockedCacheController.hpp"
+
+#define kTestLCQueueSize    16
+
+typedef struct {
+  UInt32  memPhysAddr;
+  UInt32  lcPhysAddr;
+  UInt32  lines;
+  bool    load;
+} TestLockedCacheCommand;
+
+//
+// Software locked cache DMA engine.
+//
+class TestLockedCacheModel : public HostDevice {
+  pthread_mutex_t _mutex;
+  pthread_cond_t  _cond;
+  pthread_t       _thread;
+  volatile bool   _running;
+
+  // Registers.
+  UInt32  _hid2;
+  UInt32  _dmaUpper;
+
+  // Commands queued, the head is running.
+  TestLockedCacheCommand  _queue[kTestLCQueueSize];
+  UInt32                  _queueHead;
+  volatile UInt32         _queueLength;
+  UInt32                  _lineDelayNS;
+
+  // Statistics.
+  volatile UInt32 _commands;
+  volatile UInt32 _loadLines;
+  volatile UInt32 _storeLines;
+  volatile UInt32 _maxQueueLength;
+  volatile UInt32 _errors;
+
+  static void *threadMain(void *param);
+  void runCommand(const TestLockedCacheCommand *command);
+
+public:
+  TestLockedCacheModel(void);
+  ~TestLockedCacheModel(void);
+
+  UInt32 readReg32(UInt32 offset);
+  void writeReg32(UInt32 offset, UInt32 data);
+
+  void start(void);
+  void stop(void);
+
+  //
+  // Sets the time each line takes, zero runs commands as fast as the host copies.
+  //
+  void setLineDelay(UInt32 nanoseconds) {
+    _lineDelayNS = nanoseconds;
+  }
+
+  bool isEnabled(void) const {
+    return (_hid2 & kWiiLCHID2LockedCacheEnable) != 0;
+  }
+  UInt32 getQueueLength(void) const {
+    return _queueLength;
+  }
+  UInt32 getCommands(void) const {
+    return _commands;
+  }
+  UInt32 getLoadLines(void) const {
+    return _loadLines;
+  }
+  UInt32 getStoreLines(void) const {
+    return _storeLines;
+  }
+  UInt32 getMaxQueueLength(void) const {
+    return _maxQueueLength;
+  }
+  UInt32 getErrors(void) const {
+    return _errors;
+  }
+};
+
+#endif
@@ -0,0 +1,155 @@
+//
+//  TestOHCIDriver.h
+//  OHCI driver as used by the host tests and benchmarks
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef TestOHCIDriver_h
+#define TestOHCIDriver_h
+
+#include "TestPlatform.h"
+#include "WiiOHCI.hpp"
+
+//
+// Driver with the UIM functions callable from the test, entered through the work loop gate as the USB family does.
+//
+class TestOHCI : public WiiOHCI {
+  OSDeclareDefaultStructors(TestOHCI);
+
+public:
+  IOReturn createControlEndpoint(UInt8 function, UInt8 endpoint, UInt16 maxPacketSize, UInt8 speed) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMCreateControlEndpoint(function, endpoint, maxPacketSize, speed);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn createControlTransfer(UInt8 function, UInt8 endpoint, IOUSBCompletion completion,
+                                 IOMemoryDescriptor *buffer, UInt32 bufferSize, short direction) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMCreateControlTransfer(function, endpoint, completion, buffer, true, bufferSize, direction);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn createBulkEndpoint(UInt8 function, UInt8 endpoint, UInt8 direction, UInt8 maxPacketSize) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMCreateBulkEndpoint(function, endpoint, direction, kUSBDeviceSpeedFull, maxPacketSize);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn createBulkTransfer(UInt8 function, UInt8 endpoint, IOUSBCompletion completion,
+                              IOMemoryDescriptor *buffer, bool bufferRounding, UInt32 bufferSize, short direction) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMCreateBulkTransfer(function, endpoint, completion, buffer, bufferRounding, bufferSize, direction);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn createInterruptEndpoint(UInt8 function, UInt8 endpoint, UInt8 direction, UInt16 maxPacketSize, short pollingRate) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMCreateInterruptEndpoint(function, endpoint, direction, kUSBDeviceSpeedFull, maxPacketSize, pollingRate);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn createInterruptTransfer(UInt8 function, UInt8 endpoint, IOUSBCompletion completion,
+                                   IOMemoryDescriptor *buffer, UInt32 bufferSize, short direction) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMCreateInterruptTransfer(function, endpoint, completion, buffer, true, bufferSize, direction);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn createIsochEndpoint(UInt8 function, UInt8 endpoint, UInt32 maxPacketSize, UInt8 direction) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMCreateIsochEndpoint(function, endpoint, maxPacketSize, direction);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn createIsochTransfer(UInt8 function, UInt8 endpoint, IOUSBIsocCompletion completion, UInt8 direction,
+                               UInt64 frameStart, IOMemoryDescriptor *buffer, UInt32 frameCount, IOUSBIsocFrame *frames) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMCreateIsochTransfer(function, endpoint, completion, direction, frameStart, buffer, frameCount, frames);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn abortEndpoint(UInt8 function, UInt8 endpoint, short direction) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMAbortEndpoint(function, endpoint, direction);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn deleteEndpoint(UInt8 function, UInt8 endpoint, short direction) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMDeleteEndpoint(function, endpoint, direction);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  IOReturn clearEndpointStall(UInt8 function, UInt8 endpoint, short direction) {
+    IOReturn status;
+
+    getWorkLoop()->closeGate();
+    status = UIMClearEndpointStall(function, endpoint, direction);
+    getWorkLoop()->openGate();
+    return status;
+  }
+  void pollInterrupts(IOUSBCompletionAction safeAction) {
+    getWorkLoop()->closeGate();
+    PollInterrupts(safeAction);
+    getWorkLoop()->openGate();
+  }
+
+  //
+  // Pending transfer lists, called directly as the interrupt filter and the secondary interrupt handler do.
+  //
+  void pushTransfers(OHCITransferData * volatile *listHeadPtr, OHCITransferData *headTransfer, OHCITransferData *tailTransfer) {
+    pushTransferList(listHeadPtr, headTransfer, tailTransfer);
+  }
+  OHCITransferData *takeTransfers(OHCITransferData * volatile *listHeadPtr) {
+    return takeTransferList(listHeadPtr);
+  }
+
+  //
+  // Endpoint lookup table, called directly with endpoints that are not linked for the controller.
+  //
+  UInt16 getKey(UInt8 function, UInt8 endpoint, UInt8 direction) {
+    return getEndpointKey(function, endpoint, direction);
+  }
+  UInt32 getHashIndex(UInt16 key) {
+    return getEndpointHashIndex(key);
+  }
+  bool insertHashEndpoint(OHCIEndpointData *endpoint) {
+    return insertEndpointHash(endpoint);
+  }
+  void removeHashEndpoint(OHCIEndpointData *endpoint) {
+    removeEndpointHash(endpoint);
+  }
+  OHCIEndpointData *lookupEndpoint(UInt8 function, UInt8 endpoint, UInt8 direction, UInt8 type) {
+    return getEndpoint(function, endpoint, direction, &type, NULL);
+  }
+  OHCIEndpointData *getHashSlot(UInt32 index) {
+    return _endpointHashTable[index];
+  }
+  UInt32 getHashCount(void) {
+    return _endpointHashCount;
+  }
+};
+
+#endif
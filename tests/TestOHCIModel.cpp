@@ -0,0 +1,796 @@
+//
+//  TestOHCIModel.cpp
+//  Software OHCI host controller and virtual USB devices for the host tests and benchmarks
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include <sched.h>
+#include "TestOHCIModel.h"
+
+#define kTestOHCIRevision             0x10
+#define kTestOHCIFrameIntervalReset   0x2EDF
+#define kTestOHCIDoneDelayNone        7
+#define kTestOHCIMaxListEndpoints     1024
+#define kTestOHCIMaxIsoRetires        8
+#define kTestOHCIMaxLateFrames        4
+
+static UInt64 getThreadNanoseconds(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (((UInt64) ts.tv_sec) * 1000000000ULL) + ts.tv_nsec;
+}
+
+static UInt64 getMonotonicNanoseconds(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (((UInt64) ts.tv_sec) * 1000000000ULL) + ts.tv_nsec;
+}
+
+TestOHCIModel::TestOHCIModel(IOService *nub) {
+  _nub           = nub;
+  _running       = false;
+  _endpointCount = 0;
+  bzero(_endpoints, sizeof (_endpoints));
+  pthread_mutex_init(&_mutex, NULL);
+
+  _rhDescriptorA = kTestOHCIRootHubPorts | kOHCIRegRhDescriptorANoOverCurrent
+    | (2 << kOHCIRegRhDescriptorAPowerOnToPowerGoodTimeShift);
+  _rhDescriptorB = 0;
+  _rhStatus      = 0;
+  bzero(_rhPortStatus, sizeof (_rhPortStatus));
+
+  _frames            = 0;
+  _retiredTransfers  = 0;
+  _engineNanoseconds = 0;
+  _filterNanoseconds = 0;
+  _doneWriteTime     = 0;
+  reset();
+}
+
+TestOHCIModel::~TestOHCIModel(void) {
+  stop();
+  pthread_mutex_destroy(&_mutex);
+}
+
+//
+// Resets the controller registers, the root hub keeps its state.
+//
+void TestOHCIModel::reset(void) {
+  _control          = kOHCIRegControlFuncStateReset;
+  _cmdStatus        = 0;
+  _intStatus        = 0;
+  _intEnable        = 0;
+  _hccaPhysAddr     = 0;
+  _controlHeadED    = 0;
+  _controlCurrentED = 0;
+  _bulkHeadED       = 0;
+  _bulkCurrentED    = 0;
+  _doneHead         = 0;
+  _frameInterval    = kTestOHCIFrameIntervalReset;
+  _frameNumber      = 0;
+  _periodicStart    = 0;
+  _lsThreshold      = 0;
+  _doneDelay        = kTestOHCIDoneDelayNone;
+}
+
+UInt32 TestOHCIModel::readReg32(UInt32 offset) {
+  UInt32 value;
+  UInt32 port;
+
+  lock();
+  switch (offset) {
+    case kOHCIRegRevision:          value = kTestOHCIRevision; break;
+    case kOHCIRegControl:           value = _control; break;
+    case kOHCIRegCmdStatus:         value = _cmdStatus; break;
+    case kOHCIRegIntStatus:         value = _intStatus; break;
+    case kOHCIRegIntEnable:
+    case kOHCIRegIntDisable:        value = _intEnable; break;
+    case kOHCIRegHCCA:              value = _hccaPhysAddr; break;
+    case kOHCIRegControlHeadED:     value = _controlHeadED; break;
+    case kOHCIRegControlCurrentED:  value = _controlCurrentED; break;
+    case kOHCIRegBulkHeadED:        value = _bulkHeadED; break;
+    case kOHCIRegBulkCurrentED:     value = _bulkCurrentED; break;
+    case kOHCIRegDoneHead:          value = _doneHead; break;
+    case kOHCIRegFrameInterval:     value = _frameInterval; break;
+    case kOHCIRegFmNumber:          value = _frameNumber; break;
+    case kOHCIRegPeriodicStart:     value = _periodicStart; break;
+    case kOHCIRegLSThreshold:       value = _lsThreshold; break;
+    case kOHCIRegRhDescriptorA:     value = _rhDescriptorA; break;
+    case kOHCIRegRhDescriptorB:     value = _rhDescriptorB; break;
+    case kOHCIRegRhStatus:          value = _rhStatus; break;
+    default:
+      port  = (offset - kOHCIRegRhPortStatusBase) / sizeof (UInt32);
+      value = ((offset >= kOHCIRegRhPortStatusBase) && (port < kTestOHCIRootHubPorts)) ? _rhPortStatus[port] : 0;
+      break;
+  }
+  unlock();
+  return value;
+}
+
+void TestOHCIModel::writeReg32(UInt32 offset, UInt32 data) {
+  UInt32 port;
+  UInt32 *portStatus;
+
+  lock();
+  switch (offset) {
+    case kOHCIRegControl:
+      _control = data;
+      break;
+
+    //
+    // Reset completes immediately, the other command bits are set only.
+    //
+    case kOHCIRegCmdStatus:
+      if (data & kOHCIRegCmdStatusHostControllerReset) {
+        reset();
+      }
+      _cmdStatus |= data & (kOHCIRegCmdStatusControlListFilled | kOHCIRegCmdStatusBulkListFilled);
+      break;
+
+    case kOHCIRegIntStatus:
+      _intStatus &= ~data;
+      break;
+
+    case kOHCIRegIntEnable:
+      _intEnable |= data;
+      break;
+
+    case kOHCIRegIntDisable:
+      _intEnable &= ~data;
+      break;
+
+    case kOHCIRegHCCA:
+      _hccaPhysAddr = data & ~0xFF;
+      break;
+
+    case kOHCIRegControlHeadED:
+      _controlHeadED = data & kOHCIEDTDHeadMask;
+      break;
+
+    case kOHCIRegControlCurrentED:
+      _controlCurrentED = data & kOHCIEDTDHeadMask;
+      break;
+
+    case kOHCIRegBulkHeadED:
+      _bulkHeadED = data & kOHCIEDTDHeadMask;
+      break;
+
+    case kOHCIRegBulkCurrentED:
+      _bulkCurrentED = data & kOHCIEDTDHeadMask;
+      break;
+
+    case kOHCIRegFrameInterval:
+      _frameInterval = data;
+      break;
+
+    case kOHCIRegPeriodicStart:
+      _periodicStart = data & kOHCIRegPeriodicStartMask;
+      break;
+
+    case kOHCIRegLSThreshold:
+      _lsThreshold = data & kOHCIRegLSThresholdMask;
+      break;
+
+    case kOHCIRegRhDescriptorA:
+      _rhDescriptorA = data;
+      break;
+
+    case kOHCIRegRhDescriptorB:
+      _rhDescriptorB = data;
+      break;
+
+    case kOHCIRegRhStatus:
+      if (data & kOHCIRegRhStatusSetGlobalPower) {
+        _rhStatus |= kOHCIRegRhStatusLocalPowerStatus;
+      } else if (data & kOHCIRegRhStatusClearGlobalPower) {
+        _rhStatus &= ~kOHCIRegRhStatusLocalPowerStatus;
+      }
+      _rhStatus &= ~(data & kOHCIRegRhStatusOverCurrentIndicatorChange);
+      break;
+
+    //
+    // Port writes set or clear state, change bits are write 1 to clear.
+    // Resets complete immediately.
+    //
+    default:
+      port = (offset - kOHCIRegRhPortStatusBase) / sizeof (UInt32);
+      if ((offset < kOHCIRegRhPortStatusBase) || (port >= kTestOHCIRootHubPorts)) {
+        break;
+      }
+
+      portStatus = &_rhPortStatus[port];
+      if (data & kOHCIRegRhPortStatusClearPortEnable) {
+        *portStatus &= ~kOHCIRegRhPortStatusPortEnableStatus;
+      }
+      if ((data & kOHCIRegRhPortStatusSetPortEnable) && (*portStatus & kOHCIRegRhPortStatusCurrentConnectStatus)) {
+        *portStatus |= kOHCIRegRhPortStatusPortEnableStatus;
+      }
+      if ((data & kOHCIRegRhPortStatusSetPortReset) && (*portStatus & kOHCIRegRhPortStatusCurrentConnectStatus)) {
+        *portStatus |= kOHCIRegRhPortStatusPortEnableStatus | kOHCIRegRhPortStatusPortResetStatusChange;
+        _intStatus  |= kOHCIRegIntStatusRootHubStatusChange;
+      }
+      if (data & kOHCIRegRhPortStatusSetPortPower) {
+        *portStatus |= kOHCIRegRhPortStatusPortPowerStatus;
+      }
+      if (data & kOHCIRegRhPortStatusClearPortPower) {
+        *portStatus &= ~(kOHCIRegRhPortStatusPortPowerStatus | kOHCIRegRhPortStatusPortEnableStatus);
+      }
+      *portStatus &= ~(data & (kOHCIRegRhPortStatusConnectStatusChange | kOHCIRegRhPortStatusPortEnableStatusChange
+        | kOHCIRegRhPortStatusPortSuspendStatusChange | kOHCIRegRhPortStatusPortOverCurrentIndicatorChange
+        | kOHCIRegRhPortStatusPortResetStatusChange));
+      break;
+  }
+  unlock();
+}
+
+void TestOHCIModel::start(UInt32 frameIntervalUS) {
+  _frameIntervalUS = frameIntervalUS;
+  _running         = true;
+  pthread_create(&_thread, NULL, threadMain, this);
+}
+
+void TestOHCIModel::stop(void) {
+  if (_running) {
+    _running = false;
+    pthread_join(_thread, NULL);
+  }
+}
+
+TestUSBEndpoint *TestOHCIModel::addEndpoint(UInt8 function, UInt8 endpoint, UInt8 direction) {
+  TestUSBEndpoint *device;
+
+  if (_endpointCount == kTestOHCIMaxDeviceEndpoints) {
+    return NULL;
+  }
+
+  lock();
+  device = &_endpoints[_endpointCount++];
+  bzero(device, sizeof (*device));
+  device->function    = function;
+  device->endpoint    = endpoint;
+  device->direction   = direction;
+  device->inAvailable = kTestUSBUnlimited;
+  unlock();
+  return device;
+}
+
+void TestOHCIModel::connectPort(UInt32 port, bool lowSpeed) {
+  lock();
+  _rhPortStatus[port - 1] |= kOHCIRegRhPortStatusCurrentConnectStatus | kOHCIRegRhPortStatusConnectStatusChange
+    | (lowSpeed ? kOHCIRegRhPortStatusLowSpeedDeviceAttached : 0);
+  _intStatus |= kOHCIRegIntStatusRootHubStatusChange;
+  unlock();
+}
+
+void *TestOHCIModel::threadMain(void *param) {
+  TestOHCIModel   *model;
+  UInt64          nextFrame;
+  UInt64          now;
+  struct timespec ts;
+
+  model     = (TestOHCIModel *) param;
+  nextFrame = getMonotonicNanoseconds();
+  while (model->_running) {
+    model->runFrame();
+    model->_engineNanoseconds = getThreadNanoseconds() - model->_filterNanoseconds;
+
+    //
+    // Unpaced frames still give up the processor, the driver threads may share it.
+    //
+    if (model->_frameIntervalUS == kTestOHCIFrameIntervalNone) {
+      sched_yield();
+      continue;
+    }
+
+    //
+    // Frames missed by more than a few intervals are dropped rather than run in a burst.
+    //
+    nextFrame += model->_frameIntervalUS * 1000ULL;
+    now        = getMonotonicNanoseconds();
+    if (now > (nextFrame + (model->_frameIntervalUS * 1000ULL * kTestOHCIMaxLateFrames))) {
+      nextFrame = now;
+    } else if (now < nextFrame) {
+      ts.tv_sec  = nextFrame / 1000000000ULL;
+      ts.tv_nsec = nextFrame % 1000000000ULL;
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+  }
+  return NULL;
+}
+
+bool TestOHCIModel::isInterruptPending(void) {
+  return ((_intEnable & kOHCIRegIntEnableMasterInterruptEnable) != 0)
+    && ((_intStatus & _intEnable & ~kOHCIRegIntEnableMasterInterruptEnable) != 0);
+}
+
+//
+// Interrupts are raised without the lock held, the driver's filter reads and writes registers.
+// The filter runs on the frame thread, its time is kept apart from the controller's.
+//
+void TestOHCIModel::raiseInterrupt(bool pending) {
+  UInt64 filterStart;
+
+  if (pending) {
+    filterStart = getThreadNanoseconds();
+    _nub->hostRaiseInterrupt(0);
+    _filterNanoseconds += getThreadNanoseconds() - filterStart;
+  }
+}
+
+//
+// Runs a single frame.
+//
+void TestOHCIModel::runFrame(void) {
+  OHCIHostControllerCommArea  *hcca;
+  bool                        pending;
+
+  //
+  // Frames only run while operational, the frame number is written to the HCCA at the start of each.
+  //
+  lock();
+  hcca = (OHCIHostControllerCommArea *) hostPhysToVirt(_hccaPhysAddr);
+  if (((_control & kOHCIRegControlFuncStateMask) != kOHCIRegControlFuncStateOperational) || (hcca == NULL)) {
+    unlock();
+    return;
+  }
+
+  _frameNumber      = (_frameNumber + 1) & kOHCIRegFmNumberMask;
+  hcca->frameNumber = HostToUSBWord((UInt16) _frameNumber);
+  hcca->padding     = 0;
+  if ((_frameNumber & (BIT15 - 1)) == 0) {
+    _intStatus |= kOHCIRegIntStatusFrameNumberOverflow;
+  }
+  _intStatus |= kOHCIRegIntStatusStartOfFrame;
+  _frames++;
+  pending = isInterruptPending();
+  unlock();
+  raiseInterrupt(pending);
+
+  //
+  // Periodic lists go first, control and bulk use the rest of the frame.
+  //
+  lock();
+  _frameBytes = kTestOHCIFrameBytes;
+  if (_control & kOHCIRegControlPeriodicListEnable) {
+    processPeriodicList();
+  }
+  processNonPeriodicLists();
+  writeDoneQueue();
+  pending = isInterruptPending();
+  unlock();
+  raiseInterrupt(pending);
+}
+
+//
+// Finds the device endpoint addressed by an endpoint descriptor.
+//
+TestUSBEndpoint *TestOHCIModel::findEndpoint(UInt32 edFlags, UInt8 direction) {
+  UInt8 function;
+  UInt8 endpoint;
+
+  function = edFlags & kOHCIEDFlagsFuncMask;
+  endpoint = (edFlags & kOHCIEDFlagsEndpointMask) >> kOHCIEDFlagsEndpointShift;
+  for (UInt32 i = 0; i < _endpointCount; i++) {
+    if ((_endpoints[i].function == function) && (_endpoints[i].endpoint == endpoint)
+        && ((_endpoints[i].direction == kUSBNone) || (_endpoints[i].direction == direction))) {
+      return &_endpoints[i];
+    }
+  }
+  return NULL;
+}
+
+UInt32 TestOHCIModel::getPacketCost(UInt32 edFlags, UInt32 length) {
+  UInt32 cost;
+
+  cost = length + kTestOHCIPacketOverheadBytes;
+  if (edFlags & kOHCIEDFlagsLowSpeed) {
+    cost *= kTestOHCILowSpeedMultiplier;
+  }
+  return cost;
+}
+
+//
+// Retires a transfer descriptor to the done queue and advances the endpoint.
+// General and isochronous descriptors share the flags and next descriptor layout.
+//
+void TestOHCIModel::retireTransfer(OHCIEndpointDescriptor *ed, UInt32 tdPhysAddr, UInt32 tdFlags,
+                                   UInt8 conditionCode, bool halt, UInt32 toggle) {
+  OHCIGenTransferDescriptor *td;
+  UInt32                    headFlags;
+  UInt32                    delay;
+
+  td      = (OHCIGenTransferDescriptor *) hostPhysToVirt(tdPhysAddr);
+  tdFlags = (tdFlags & ~kOHCIGenTDFlagsConditionCodeMask) | (((UInt32) conditionCode) << kOHCIGenTDFlagsConditionCodeShift);
+  td->flags = HostToUSBLong(tdFlags);
+
+  headFlags = toggle ? kOHCIEDTDHeadCarry : 0;
+  if (halt) {
+    headFlags |= kOHCIEDTDHeadHalted;
+  }
+  ed->headTDPhysAddr = HostToUSBLong((USBToHostLong(td->nextTDPhysAddr) & kOHCIEDTDHeadMask) | headFlags);
+
+  td->nextTDPhysAddr = HostToUSBLong(_doneHead);
+  _doneHead          = tdPhysAddr;
+  _retiredTransfers++;
+  hostDeviceWrote(td, sizeof (*td));
+
+  delay = (tdFlags & kOHCIGenTDFlagsDelayInterruptMask) >> kOHCIGenTDFlagsDelayInterruptShift;
+  if ((delay != kTestOHCIDoneDelayNone) && (delay < _doneDelay)) {
+    _doneDelay = delay;
+  }
+}
+
+//
+// Sends a single packet for the head transfer descriptor of a general endpoint.
+// Returns false if the endpoint has nothing to send.
+//
+bool TestOHCIModel::processGenEndpoint(OHCIEndpointDescriptor *ed, bool *noBandwidth) {
+  OHCIGenTransferDescriptor *td;
+  TestUSBEndpoint           *device;
+  UInt8                     *buffer;
+  UInt32                    edFlags;
+  UInt32                    headPhysAddr;
+  UInt32                    tdPhysAddr;
+  UInt32                    tdFlags;
+  UInt32                    currentPhysAddr;
+  UInt32                    maxPacketSize;
+  UInt32                    remaining;
+  UInt32                    length;
+  UInt32                    actual;
+  UInt32                    toggle;
+  UInt32                    cost;
+  UInt8                     direction;
+
+  edFlags      = USBToHostLong(ed->flags);
+  headPhysAddr = USBToHostLong(ed->headTDPhysAddr);
+  tdPhysAddr   = headPhysAddr & kOHCIEDTDHeadMask;
+  if ((edFlags & kOHCIEDFlagsSkip) || (headPhysAddr & kOHCIEDTDHeadHalted)
+      || (tdPhysAddr == (USBToHostLong(ed->tailTDPhysAddr) & kOHCIEDTDHeadMask))) {
+    return false;
+  }
+
+  td = (OHCIGenTransferDescriptor *) hostPhysToVirt(tdPhysAddr);
+  if (td == NULL) {
+    _intStatus |= kOHCIRegIntStatusUnrecoverableError;
+    return false;
+  }
+  hostCheckDeviceRead(td, sizeof (*td));
+  tdFlags = USBToHostLong(td->flags);
+
+  //
+  // Direction comes from the endpoint unless it defers to the transfer descriptor.
+  //
+  if ((edFlags & kOHCIEDFlagsDirectionMask) == kOHCIEDFlagsDirectionIn) {
+    direction = kUSBIn;
+  } else if ((edFlags & kOHCIEDFlagsDirectionMask) == kOHCIEDFlagsDirectionOut) {
+    direction = kUSBOut;
+  } else if ((tdFlags & kOHCIGenTDFlagsDirectionMask) == kOHCIGenTDFlagsDirectionIn) {
+    direction = kUSBIn;
+  } else if ((tdFlags & kOHCIGenTDFlagsDirectionMask) == kOHCIGenTDFlagsDirectionOut) {
+    direction = kUSBOut;
+  } else {
+    direction = kUSBNone;
+  }
+
+  maxPacketSize   = (edFlags & kOHCIEDFlagsMaxPktSizeMask) >> kOHCIEDFlagsMaxPktSizeShift;
+  currentPhysAddr = USBToHostLong(td->currentBufferPtrPhysAddr);
+  remaining       = (currentPhysAddr != 0) ? (USBToHostLong(td->bufferEndPhysAddr) - currentPhysAddr + 1) : 0;
+  length          = (remaining < maxPacketSize) ? remaining : maxPacketSize;
+
+  //
+  // Inbound packets may be full sized whatever is left in the buffer.
+  //
+  cost = getPacketCost(edFlags, (direction == kUSBIn) ? maxPacketSize : length);
+  if ((SInt32) cost > _frameBytes) {
+    *noBandwidth = true;
+    return true;
+  }
+  _frameBytes -= cost;
+
+  if (tdFlags & kOHCIGenTDFlagsDataToggleData1) {
+    toggle = (tdFlags & kOHCIGenTDFlagsDataToggleData0) ? 1 : 0;
+  } else {
+    toggle = (headPhysAddr & kOHCIEDTDHeadCarry) ? 1 : 0;
+  }
+
+  device = findEndpoint(edFlags, direction);
+  if (device == NULL) {
+    retireTransfer(ed, tdPhysAddr, tdFlags, kOHCITDConditionCodeDeviceNotResponding, true, toggle);
+    return true;
+  }
+  if (device->stalled) {
+    device->packets++;
+    retireTransfer(ed, tdPhysAddr, tdFlags, kOHCITDConditionCodeStall, true, toggle);
+    return true;
+  }
+
+  buffer = (length > 0) ? (UInt8 *) hostPhysToVirt(currentPhysAddr) : NULL;
+  if ((length > 0) && (buffer == NULL)) {
+    _intStatus |= kOHCIRegIntStatusUnrecoverableError;
+    return true;
+  }
+
+  //
+  // Move the packet.
+  //
+  actual = length;
+  if (direction == kUSBNone) {
+    if (!testUSBSetupPacket(device, buffer, length)) {
+      return true;
+    }
+  } else if (direction == kUSBOut) {
+    if (!testUSBOutPacket(device, buffer, length)) {
+      return true;
+    }
+  } else if (!testUSBInPacket(device, buffer, length, maxPacketSize, &actual)) {
+    return true;
+  }
+  toggle ^= 1;
+
+  //
+  // Retire the descriptor once its buffer is done or a short packet ends it.
+  // Short packets are an error unless buffer rounding is allowed.
+  //
+  if (actual < length) {
+    td->currentBufferPtrPhysAddr = HostToUSBLong(currentPhysAddr + actual);
+    if (tdFlags & kOHCIGenTDFlagsBufferRounding) {
+      retireTransfer(ed, tdPhysAddr, tdFlags, kOHCITDConditionCodeNoError, false, toggle);
+    } else {
+      retireTransfer(ed, tdPhysAddr, tdFlags, kOHCITDConditionCodeDataUnderrun, true, toggle);
+    }
+  } else if (actual == remaining) {
+    td->currentBufferPtrPhysAddr = 0;
+    retireTransfer(ed, tdPhysAddr, tdFlags, kOHCITDConditionCodeNoError, false, toggle);
+  } else {
+    td->currentBufferPtrPhysAddr = HostToUSBLong(currentPhysAddr + actual);
+    td->flags = HostToUSBLong((tdFlags & ~(kOHCIGenTDFlagsDataToggleData0 | kOHCIGenTDFlagsErrorCountMask))
+      | kOHCIGenTDFlagsDataToggleData1 | (toggle ? kOHCIGenTDFlagsDataToggleData0 : 0));
+    hostDeviceWrote(td, sizeof (*td));
+  }
+  return true;
+}
+
+//
+// Sends the packet of the current frame for the head transfer descriptor of an isochronous endpoint.
+//
+void TestOHCIModel::processIsoEndpoint(OHCIEndpointDescriptor *ed) {
+  OHCIIsoTransferDescriptor *td;
+  TestUSBEndpoint           *device;
+  UInt8                     *buffer;
+  UInt32                    edFlags;
+  UInt32                    headPhysAddr;
+  UInt32                    tdPhysAddr;
+  UInt32                    tdFlags;
+  UInt32                    bufferEnd;
+  UInt32                    packetStart;
+  UInt32                    packetEnd;
+  UInt32                    length;
+  UInt32                    actual;
+  UInt16                    offsetStatus;
+  UInt16                    packetStatus;
+  SInt16                    relativeFrame;
+  UInt8                     frameCount;
+  UInt8                     direction;
+
+  edFlags   = USBToHostLong(ed->flags);
+  direction = ((edFlags & kOHCIEDFlagsDirectionMask) == kOHCIEDFlagsDirectionIn) ? kUSBIn : kUSBOut;
+
+  for (UInt32 retires = 0; retires < kTestOHCIMaxIsoRetires; retires++) {
+    headPhysAddr = USBToHostLong(ed->headTDPhysAddr);
+    tdPhysAddr   = headPhysAddr & kOHCIEDTDHeadMask;
+    if ((edFlags & kOHCIEDFlagsSkip) || (headPhysAddr & kOHCIEDTDHeadHalted)
+        || (tdPhysAddr == (USBToHostLong(ed->tailTDPhysAddr) & kOHCIEDTDHeadMask))) {
+      return;
+    }
+
+    td = (OHCIIsoTransferDescriptor *) hostPhysToVirt(tdPhysAddr);
+    if (td == NULL) {
+      _intStatus |= kOHCIRegIntStatusUnrecoverableError;
+      return;
+    }
+    hostCheckDeviceRead(td, sizeof (*td));
+    tdFlags       = USBToHostLong(td->flags);
+    frameCount    = ((tdFlags & kOHCIIsoTDFlagsFrameCountMask) >> kOHCIIsoTDFlagsFrameCountShift) + 1;
+    relativeFrame = (SInt16) (_frameNumber - (tdFlags & kOHCIIsoTDFlagsStartingFrameMask));
+    if (relativeFrame < 0) {
+      return;
+    }
+
+    //
+    // Descriptors whose frames have all passed are retired unsent, and the next one is checked.
+    //
+    if (relativeFrame >= frameCount) {
+      retireTransfer(ed, tdPhysAddr, tdFlags, kOHCITDConditionCodeDataOverrun, false, 0);
+      continue;
+    }
+
+    //
+    // Packets run up to the next packet's offset, the last one to the end of the buffer.
+    // Offsets select the first page, or with the page select bit, the page of the buffer end.
+    //
+    bufferEnd    = USBToHostLong(td->bufferEndPhysAddr);
+    offsetStatus = USBToHostWord(td->packetOffsetStatus[relativeFrame]);
+    packetStart  = ((offsetStatus & kOHCIIsoTDPktOffsetPageSelect) ? (bufferEnd & ~PAGE_MASK)
+      : (USBToHostLong(td->bufferPhysPage) & ~PAGE_MASK)) + (offsetStatus & kOHCIIsoTDPktOffsetMask);
+    if ((relativeFrame + 1) < frameCount) {
+      offsetStatus = USBToHostWord(td->packetOffsetStatus[relativeFrame + 1]);
+      packetEnd    = ((offsetStatus & kOHCIIsoTDPktOffsetPageSelect) ? (bufferEnd & ~PAGE_MASK)
+        : (USBToHostLong(td->bufferPhysPage) & ~PAGE_MASK)) + (offsetStatus & kOHCIIsoTDPktOffsetMask);
+    } else {
+      packetEnd = bufferEnd + 1;
+    }
+    length  = (packetEnd > packetStart) ? (packetEnd - packetStart) : 0;
+    buffer  = (length > 0) ? (UInt8 *) hostPhysToVirt(packetStart) : NULL;
+    _frameBytes -= getPacketCost(edFlags, length);
+
+    //
+    // Outbound packet status has a size of zero, inbound has the size received.
+    //
+    device = findEndpoint(edFlags, direction);
+    if ((device == NULL) || ((length > 0) && (buffer == NULL))) {
+      packetStatus = kOHCITDConditionCodeDeviceNotResponding << kOHCIIsoTDPktStatusConditionCodeShift;
+    } else if (direction == kUSBIn) {
+      actual = length;
+      if ((device->isoPacketLength != 0) && (actual > device->isoPacketLength)) {
+        actual = device->isoPacketLength;
+      }
+      if ((device->inAvailable != kTestUSBUnlimited) && (actual > device->inAvailable)) {
+        actual = device->inAvailable;
+      }
+      for (UInt32 i = 0; i < actual; i++) {
+        buffer[i] = (UInt8) device->inSequence++;
+      }
+      if (device->inAvailable != kTestUSBUnlimited) {
+        device->inAvailable -= actual;
+      }
+      device->inBytes += actual;
+      device->packets++;
+
+      packetStatus = (actual & kOHCIIsoTDPktStatusSizeMask)
+        | (((actual < length) ? kOHCITDConditionCodeDataUnderrun : kOHCITDConditionCodeNoError) << kOHCIIsoTDPktStatusConditionCodeShift);
+    } else {
+      for (UInt32 i = 0; i < length; i++) {
+        if (buffer[i] != (UInt8) device->outSequence++) {
+          device->outMismatches++;
+        }
+      }
+      device->outBytes += length;
+      device->packets++;
+      packetStatus = kOHCITDConditionCodeNoError << kOHCIIsoTDPktStatusConditionCodeShift;
+    }
+    td->packetOffsetStatus[relativeFrame] = HostToUSBWord(packetStatus);
+    hostDeviceWrote(td, sizeof (*td));
+
+    if ((relativeFrame + 1) == frameCount) {
+      retireTransfer(ed, tdPhysAddr, tdFlags, kOHCITDConditionCodeNoError, false, 0);
+    }
+    return;
+  }
+}
+
+//
+// Walks the interrupt tree from the HCCA head for this frame, the isochronous endpoints hang off its root.
+//
+void TestOHCIModel::processPeriodicList(void) {
+  OHCIHostControllerCommArea  *hcca;
+  OHCIEndpointDescriptor      *ed;
+  UInt32                      edPhysAddr;
+  bool                        noBandwidth;
+
+  hcca       = (OHCIHostControllerCommArea *) hostPhysToVirt(_hccaPhysAddr);
+  edPhysAddr = USBToHostLong(hcca->interruptTablePhysAddr[_frameNumber % kOHCINumInterruptHeads]) & kOHCIEDTDHeadMask;
+  for (UInt32 i = 0; (edPhysAddr != 0) && (i < kTestOHCIMaxListEndpoints); i++) {
+    ed = (OHCIEndpointDescriptor *) hostPhysToVirt(edPhysAddr);
+    if (ed == NULL) {
+      _intStatus |= kOHCIRegIntStatusUnrecoverableError;
+      return;
+    }
+
+    if (USBToHostLong(ed->flags) & kOHCIEDFlagsIsochronous) {
+      if ((_control & kOHCIRegControlIsochronousEnable) == 0) {
+        return;
+      }
+      processIsoEndpoint(ed);
+    } else {
+      noBandwidth = false;
+      processGenEndpoint(ed, &noBandwidth);
+    }
+    edPhysAddr = USBToHostLong(ed->nextEDPhysAddr) & kOHCIEDTDHeadMask;
+  }
+}
+
+//
+// Visits each endpoint of a control or bulk list once, from where the last visit stopped.
+// The list filled bit is cleared when starting from the head, and set again if any endpoint has work.
+// Returns true if any endpoint had work.
+//
+bool TestOHCIModel::processList(UInt32 headED, UInt32 *currentED, UInt32 filledBit, bool *noBandwidth) {
+  OHCIEndpointDescriptor  *ed;
+  UInt32                  edPhysAddr;
+  bool                    found;
+
+  if (*currentED == 0) {
+    if ((_cmdStatus & filledBit) == 0) {
+      return false;
+    }
+    _cmdStatus &= ~filledBit;
+    *currentED  = headED;
+  }
+
+  found      = false;
+  edPhysAddr = *currentED;
+  for (UInt32 i = 0; (edPhysAddr != 0) && (i < kTestOHCIMaxListEndpoints); i++) {
+    ed = (OHCIEndpointDescriptor *) hostPhysToVirt(edPhysAddr);
+    if (ed == NULL) {
+      _intStatus |= kOHCIRegIntStatusUnrecoverableError;
+      break;
+    }
+
+    if (processGenEndpoint(ed, noBandwidth)) {
+      found       = true;
+      _cmdStatus |= filledBit;
+    }
+    if (*noBandwidth) {
+      *currentED = edPhysAddr;
+      return found;
+    }
+    edPhysAddr = USBToHostLong(ed->nextEDPhysAddr) & kOHCIEDTDHeadMask;
+  }
+
+  *currentED = 0;
+  return found;
+}
+
+//
+// Serves the control and bulk lists until they have no work or the frame is full.
+//
+void TestOHCIModel::processNonPeriodicLists(void) {
+  UInt32  ratio;
+  bool    found;
+  bool    noBandwidth;
+
+  ratio       = (_control & kOHCIRegControlCBSRMask) + 1;
+  noBandwidth = false;
+  do {
+    found = false;
+    if (_control & kOHCIRegControlControlListEnable) {
+      for (UInt32 i = 0; (i < ratio) && !noBandwidth; i++) {
+        found |= processList(_controlHeadED, &_controlCurrentED, kOHCIRegCmdStatusControlListFilled, &noBandwidth);
+      }
+    }
+    if ((_control & kOHCIRegControlBulkListEnable) && !noBandwidth) {
+      found |= processList(_bulkHeadED, &_bulkCurrentED, kOHCIRegCmdStatusBulkListFilled, &noBandwidth);
+    }
+  } while (found && !noBandwidth);
+}
+
+//
+// Writes the done queue to the HCCA at the end of a frame, once the delay of the retired descriptors has passed
+// and the driver has taken the previous one.
+//
+void TestOHCIModel::writeDoneQueue(void) {
+  OHCIHostControllerCommArea *hcca;
+
+  if (_doneHead == 0) {
+    return;
+  }
+  if (_doneDelay > 0) {
+    if (_doneDelay != kTestOHCIDoneDelayNone) {
+      _doneDelay--;
+    }
+    return;
+  }
+  if (_intStatus & kOHCIRegIntStatusWritebackDoneHead) {
+    return;
+  }
+
+  hcca = (OHCIHostControllerCommArea *) hostPhysToVirt(_hccaPhysAddr);
+  hcca->doneHeadPhysAddr = HostToUSBLong(_doneHead);
+  _doneHead       = 0;
+  _doneDelay      = kTestOHCIDoneDelayNone;
+  _intStatus     |= kOHCIRegIntStatusWritebackDoneHead;
+  _doneWriteTime  = getMonotonicNanoseconds();
+}
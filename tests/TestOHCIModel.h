@@ -0,0 +1,152 @@
+//
+//  TestOHCIModel.h
+//  Software OHCI host controller and virtual USB devices for the host tests and benchmarks
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  The controller runs frames on its own host thread, either paced at the 1ms USB frame rate or back to back.
+//  Each frame it walks the HCCA interrupt tree and the isochronous, control and bulk lists in simulated physical
+//  memory, moves data between transfer descriptors and virtual devices, and retires descriptors to the done queue
+//  as the OHCI specification describes. Registers are plain host values, as the driver reads them big endian.
+//
+//  Bus time is counted in bytes, a full speed frame has kTestOHCIFrameBytes and each packet costs its data plus
+//  kTestOHCIPacketOverheadBytes, eight times that at low speed. Only one packet is sent per endpoint visit, and the
+//  control list gets the visits set by the control bulk service ratio, so endpoints share the bus as on hardware.
+//
+//  Transfer descriptor reads and writes are reported to the host cache handoff checks, which tests may enable.
+//
+//  Not modelled are transmission errors and retries, the error counter, scheduling overruns, remote wakeup, and
+//  suspend and resume. Stalls, NAKs and devices that are not present are the only failures a device can report.
+//
+
+#ifndef TestOHCIModel_h
+#define TestOHCIModel_h
+
+#include "HostKernel.h"
+#include "OHCIRegs.hpp"
+#include "TestUSBDevice.h"
+
+#define kTestOHCIRegsSize             0x100
+#define kTestOHCIRootHubPorts         2
+#define kTestOHCIFrameBytes           1500
+#define kTestOHCIPacketOverheadBytes  13
+#define kTestOHCILowSpeedMultiplier   8
+#define kTestOHCIMaxDeviceEndpoints   16
+#define kTestOHCIFrameIntervalUS      1000
+
+// Frame interval running frames back to back.
+#define kTestOHCIFrameIntervalNone    0
+
+//
+// Software OHCI controller.
+//
+class TestOHCIModel : public HostDevice {
+  IOService       *_nub;
+  pthread_mutex_t _mutex;
+  pthread_t       _thread;
+  volatile bool   _running;
+  UInt32          _frameIntervalUS;
+
+  // Registers.
+  UInt32  _control;
+  UInt32  _cmdStatus;
+  UInt32  _intStatus;
+  UInt32  _intEnable;
+  UInt32  _hccaPhysAddr;
+  UInt32  _controlHeadED;
+  UInt32  _controlCurrentED;
+  UInt32  _bulkHeadED;
+  UInt32  _bulkCurrentED;
+  UInt32  _doneHead;
+  UInt32  _frameInterval;
+  UInt32  _frameNumber;
+  UInt32  _periodicStart;
+  UInt32  _lsThreshold;
+  UInt32  _rhDescriptorA;
+  UInt32  _rhDescriptorB;
+  UInt32  _rhStatus;
+  UInt32  _rhPortStatus[kTestOHCIRootHubPorts];
+
+  // Frames left before the done queue is written back, 7 for none.
+  UInt32  _doneDelay;
+  // Bus time left in the current frame.
+  SInt32  _frameBytes;
+
+  TestUSBEndpoint _endpoints[kTestOHCIMaxDeviceEndpoints];
+  UInt32          _endpointCount;
+
+  // Statistics.
+  volatile UInt64 _frames;
+  volatile UInt64 _retiredTransfers;
+  volatile UInt64 _engineNanoseconds;
+  volatile UInt64 _filterNanoseconds;
+  volatile UInt64 _doneWriteTime;
+
+  static void *threadMain(void *param);
+  void reset(void);
+  bool isInterruptPending(void);
+  void raiseInterrupt(bool pending);
+  void runFrame(void);
+  TestUSBEndpoint *findEndpoint(UInt32 edFlags, UInt8 direction);
+  UInt32 getPacketCost(UInt32 edFlags, UInt32 length);
+  void retireTransfer(OHCIEndpointDescriptor *ed, UInt32 tdPhysAddr, UInt32 tdFlags, UInt8 conditionCode, bool halt, UInt32 toggle);
+  bool processGenEndpoint(OHCIEndpointDescriptor *ed, bool *noBandwidth);
+  void processIsoEndpoint(OHCIEndpointDescriptor *ed);
+  void processPeriodicList(void);
+  bool processList(UInt32 headED, UInt32 *currentED, UInt32 filledBit, bool *noBandwidth);
+  void processNonPeriodicLists(void);
+  void writeDoneQueue(void);
+
+public:
+  TestOHCIModel(IOService *nub);
+  ~TestOHCIModel(void);
+
+  UInt32 readReg32(UInt32 offset);
+  void writeReg32(UInt32 offset, UInt32 data);
+
+  //
+  // Starts running frames, at most one per interval.
+  //
+  void start(UInt32 frameIntervalUS);
+  void stop(void);
+
+  void lock(void) {
+    pthread_mutex_lock(&_mutex);
+  }
+  void unlock(void) {
+    pthread_mutex_unlock(&_mutex);
+  }
+
+  //
+  // Adds a device endpoint, control endpoints use kUSBNone.
+  //
+  TestUSBEndpoint *addEndpoint(UInt8 function, UInt8 endpoint, UInt8 direction);
+  void connectPort(UInt32 port, bool lowSpeed);
+
+  UInt64 getFrames(void) const {
+    return _frames;
+  }
+  UInt64 getRetiredTransfers(void) const {
+    return _retiredTransfers;
+  }
+  //
+  // Gets the CPU time of the frame thread, not counting the driver's interrupt filter run on it.
+  //
+  UInt64 getEngineNanoseconds(void) const {
+    return _engineNanoseconds;
+  }
+  //
+  // Gets the CPU time of the driver's interrupt filter, run on the frame thread.
+  //
+  UInt64 getFilterNanoseconds(void) const {
+    return _filterNanoseconds;
+  }
+  //
+  // Gets the monotonic time the done queue was last written back.
+  //
+  UInt64 getDoneWriteTime(void) const {
+    return _doneWriteTime;
+  }
+};
+
+#endif
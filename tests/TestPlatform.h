@@ -0,0 +1,43 @@
+//
+//  TestPlatform.h
+//  Platform expert as used by the host tests of the USB controller drivers
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#ifndef TestPlatform_h
+#define TestPlatform_h
+
+#include <IOKit/IOPlatformExpert.h>
+#include "WiiCommon.hpp"
+#include "WiiLockedCache.hpp"
+
+#define kTestPVRCafe    0x70010201
+
+//
+// Platform expert answering the functions the driver asks for.
+//
+class TestPlatform : public IOPlatformExpert {
+  OSDeclareDefaultStructors(TestPlatform);
+
+public:
+  //
+  // Locked cache service given to the driver, none unless a test sets one.
+  //
+  const WiiLockedCacheService *lockedCacheService;
+
+  IOReturn callPlatformFunction(const OSSymbol *functionName, bool waitForFunction,
+                                void *param1, void *param2, void *param3, void *param4) {
+    if (functionName->isEqualTo(kWiiFuncPlatformGetInvalidateCache)) {
+      *((WiiInvalidateDataCacheFunc *) param1) = invalidate_dcache;
+      return kIOReturnSuccess;
+    }
+    if (functionName->isEqualTo(kWiiFuncPlatformGetLockedCacheService) && (lockedCacheService != NULL)) {
+      *((const WiiLockedCacheService **) param1) = lockedCacheService;
+      return kIOReturnSuccess;
+    }
+    return kIOReturnUnsupported;
+  }
+};
+
+#endif
@@ -0,0 +1,84 @@
+//
+//  TestUSBDevice.cpp
+//  Virtual USB device endpoints behind the software host controller models
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "TestUSBDevice.h"
+
+bool testUSBSetupPacket(TestUSBEndpoint *device, const UInt8 *buffer, UInt32 length) {
+  if (device->nak) {
+    device->naks++;
+    return false;
+  }
+
+  memcpy(device->setup, buffer, (length < sizeof (device->setup)) ? length : sizeof (device->setup));
+  device->controlOffset = 0;
+  device->setupPackets++;
+  device->packets++;
+  return true;
+}
+
+bool testUSBOutPacket(TestUSBEndpoint *device, const UInt8 *buffer, UInt32 length) {
+  if (device->nak) {
+    device->naks++;
+    return false;
+  }
+
+  if (device->direction == kUSBNone) {
+    for (UInt32 i = 0; (i < length) && (device->controlOffset < sizeof (device->controlData)); i++) {
+      device->controlData[device->controlOffset++] = buffer[i];
+    }
+  } else {
+    for (UInt32 i = 0; i < length; i++) {
+      if (buffer[i] != (UInt8) device->outSequence++) {
+        device->outMismatches++;
+      }
+    }
+  }
+  device->outBytes += length;
+  device->packets++;
+  return true;
+}
+
+bool testUSBInPacket(TestUSBEndpoint *device, UInt8 *buffer, UInt32 length, UInt32 maxPacketSize, UInt32 *actual) {
+  //
+  // Control data stages are never NAKed, they send what is left of the control data.
+  //
+  *actual = length;
+  if (device->direction == kUSBNone) {
+    if (*actual > (device->controlLength - device->controlOffset)) {
+      *actual = device->controlLength - device->controlOffset;
+    }
+    memcpy(buffer, &device->controlData[device->controlOffset], *actual);
+    device->controlOffset += *actual;
+  } else {
+    if (device->nak || (device->inAvailable == 0)) {
+      device->naks++;
+      return false;
+    }
+    if ((device->inAvailable != kTestUSBUnlimited) && (*actual > device->inAvailable)) {
+      *actual = device->inAvailable;
+    }
+
+    if ((device->messageLength != 0) && (*actual > (device->messageLength - device->messageOffset))) {
+      *actual = device->messageLength - device->messageOffset;
+    }
+    for (UInt32 i = 0; i < *actual; i++) {
+      buffer[i] = (UInt8) device->inSequence++;
+    }
+    if (device->inAvailable != kTestUSBUnlimited) {
+      device->inAvailable -= *actual;
+    }
+    if (device->messageLength != 0) {
+      device->messageOffset += *actual;
+      if ((device->messageOffset == device->messageLength) && (*actual < maxPacketSize)) {
+        device->messageOffset = 0;
+      }
+    }
+  }
+  device->inBytes += *actual;
+  device->packets++;
+  return true;
+}
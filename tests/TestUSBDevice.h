@@ -0,0 +1,74 @@
+//
+//  TestUSBDevice.h
+//  Virtual USB device endpoints behind the software host controller models
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  Each controller model walks its own schedules and descriptors, then moves packets to and from the endpoints here,
+//  so both models see devices that behave the same.
+//
+
+#ifndef TestUSBDevice_h
+#define TestUSBDevice_h
+
+#include "HostKernel.h"
+#include "HostUSB.h"
+
+// Bytes available from an inbound endpoint that never runs out.
+#define kTestUSBUnlimited             0xFFFFFFFF
+
+//
+// Endpoint of a virtual device.
+//
+// Inbound endpoints send a counting byte pattern starting at inSequence, outbound endpoints check received data
+// against the same pattern starting at outSequence. Control endpoints keep the last setup packet, send data stages
+// from controlData, and store received data stages in it.
+//
+// Fields are changed by the tests while the controller is running, only under the controller model's lock().
+//
+typedef struct {
+  UInt8   function;
+  UInt8   endpoint;
+  UInt8   direction;
+
+  // Bytes left to send before the endpoint NAKs.
+  UInt32  inAvailable;
+  // Inbound transfers end with a short packet every messageLength bytes, zero for no message boundaries.
+  UInt32  messageLength;
+  UInt32  messageOffset;
+  // Bytes per isochronous inbound packet, zero to fill the packet.
+  UInt32  isoPacketLength;
+  UInt32  inSequence;
+  UInt32  outSequence;
+  UInt32  outMismatches;
+
+  // All packets are NAKed.
+  bool    nak;
+  // All packets are stalled until the test clears this, as a halted device endpoint is.
+  bool    stalled;
+
+  UInt8   setup[8];
+  UInt8   controlData[256];
+  UInt32  controlLength;
+  UInt32  controlOffset;
+
+  // Counters.
+  UInt32  setupPackets;
+  UInt32  packets;
+  UInt32  naks;
+  UInt64  inBytes;
+  UInt64  outBytes;
+} TestUSBEndpoint;
+
+//
+// Moves a single packet of a control, bulk or interrupt transfer, the endpoint must not be stalled.
+// Each returns false if the endpoint NAKs the packet.
+//
+bool testUSBSetupPacket(TestUSBEndpoint *device, const UInt8 *buffer, UInt32 length);
+bool testUSBOutPacket(TestUSBEndpoint *device, const UInt8 *buffer, UInt32 length);
+//
+// Inbound packets may be shorter than asked for, a message that ends on a full packet is followed by a zero length packet.
+//
+bool testUSBInPacket(TestUSBEndpoint *device, UInt8 *buffer, UInt32 length, UInt32 maxPacketSize, UInt32 *actual);
+
+#endif
@@ -0,0 +1,151 @@
+//
+//  bench_interrupt_dispatch.cpp
+//  Compares the bit-scan interrupt dispatch against scanning every vector
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  Cause words are random with one to four asserted vectors, weighted towards one as on real hardware.
+//  Both paths time each handler with two timebase reads, which are clock reads on the host and cost far more than
+//  the timebase register, so the difference between the paths is the figure to compare.
+//
+
+#include "TestHarness.h"
+#include "WiiInterruptDispatch.hpp"
+
+#define kBenchVectorCount     32
+#define kBenchCauseCount      4096
+#define kBenchIterations      2000000
+
+class BenchInterruptController : public IOInterruptController {
+  OSDeclareDefaultStructors(BenchInterruptController);
+
+public:
+  IOInterruptVector *getVectors(void) {
+    return vectors;
+  }
+  void setVectors(IOInterruptVector *newVectors) {
+    vectors = newVectors;
+  }
+};
+
+static UInt32 gDispatchOrder[kBenchVectorCount];
+static UInt32 gDispatchCount;
+
+static void benchHandler(void *target, void *refCon, void *nub, int source) {
+  gDispatchOrder[gDispatchCount % kBenchVectorCount] = source;
+  gDispatchCount++;
+}
+
+//
+// Dispatch as done before bit scanning, every vector is checked in order.
+//
+static void dispatchLinear(IOInterruptController *controller, IOInterruptVector *vectors,
+                           WiiInterruptVectorStats *stats, UInt32 cause) {
+  for (UInt32 vectorIndex = 0; vectorIndex < kBenchVectorCount; vectorIndex++) {
+    if ((cause & (1 << vectorIndex)) == 0) {
+      continue;
+    }
+    dispatchInterruptVector(controller, vectors, stats, vectorIndex);
+  }
+}
+
+static UInt32 makeCause(UInt32 *seed) {
+  UInt32 bits;
+  UInt32 weight;
+  UInt32 cause;
+
+  weight = testRandom(seed) % 100;
+  bits   = (weight < 70) ? 1 : ((weight < 95) ? 2 : 4);
+  cause  = 0;
+  while (bits > 0) {
+    cause |= 1 << (testRandom(seed) % kBenchVectorCount);
+    bits--;
+  }
+  return cause;
+}
+
+int main(void) {
+  BenchInterruptController  controller;
+  IOInterruptVector         vectors[kBenchVectorCount];
+  WiiInterruptVectorStats   stats[kBenchVectorCount];
+  UInt32                    causes[kBenchCauseCount];
+  UInt8                     priorityVectors[2] = { 5, 14 };
+  UInt32                    seed;
+  UInt32                    pending;
+  UInt32                    expected;
+  UInt64                    start;
+  UInt64                    linearNS;
+  UInt64                    scanNS;
+  UInt64                    priorityNS;
+
+  bzero(vectors, sizeof (vectors));
+  bzero(stats, sizeof (stats));
+  for (UInt32 i = 0; i < kBenchVectorCount; i++) {
+    vectors[i].interruptRegistered = 1;
+    vectors[i].handler             = benchHandler;
+    vectors[i].source              = i;
+  }
+  controller.setVectors(vectors);
+
+  seed = 0x1234567;
+  for (UInt32 i = 0; i < kBenchCauseCount; i++) {
+    causes[i] = makeCause(&seed);
+  }
+
+  //
+  // Both dispatch every asserted vector once. Bit scanning goes priority vectors first, then highest first.
+  //
+  for (UInt32 i = 0; i < kBenchCauseCount; i++) {
+    gDispatchCount = 0;
+    dispatchLinear(&controller, vectors, stats, causes[i]);
+    expected = gDispatchCount;
+
+    gDispatchCount = 0;
+    pending = causes[i];
+    dispatchPendingVectors(&controller, vectors, stats, priorityVectors, 2, &pending, 1);
+    TEST_CHECK(gDispatchCount == expected);
+    TEST_CHECK(pending == 0);
+
+    pending = causes[i];
+    for (UInt32 j = 0; j < gDispatchCount; j++) {
+      TEST_CHECK(pending & (1 << gDispatchOrder[j]));
+      if ((j > 0) && !(causes[i] & ((1 << priorityVectors[0]) | (1 << priorityVectors[1])))) {
+        TEST_CHECK(gDispatchOrder[j] < gDispatchOrder[j - 1]);
+      }
+      pending &= ~(1 << gDispatchOrder[j]);
+    }
+    if ((causes[i] & (1 << priorityVectors[0])) && (gDispatchCount > 0)) {
+      TEST_CHECK(gDispatchOrder[0] == priorityVectors[0]);
+    }
+  }
+
+  //
+  // Time each.
+  //
+  start = testGetNanoseconds();
+  for (UInt32 i = 0; i < kBenchIterations; i++) {
+    dispatchLinear(&controller, vectors, stats, causes[i % kBenchCauseCount]);
+  }
+  linearNS = testGetNanoseconds() - start;
+
+  start = testGetNanoseconds();
+  for (UInt32 i = 0; i < kBenchIterations; i++) {
+    pending = causes[i % kBenchCauseCount];
+    dispatchPendingVectors(&controller, vectors, stats, priorityVectors, 0, &pending, 1);
+  }
+  scanNS = testGetNanoseconds() - start;
+
+  start = testGetNanoseconds();
+  for (UInt32 i = 0; i < kBenchIterations; i++) {
+    pending = causes[i % kBenchCauseCount];
+    dispatchPendingVectors(&controller, vectors, stats, priorityVectors, 2, &pending, 1);
+  }
+  priorityNS = testGetNanoseconds() - start;
+
+  printf("interrupt_dispatch: %u interrupts\n", kBenchIterations);
+  printf("  linear scan:               %6.1f ns/interrupt\n", (double) linearNS / kBenchIterations);
+  printf("  bit scan:                  %6.1f ns/interrupt\n", (double) scanNS / kBenchIterations);
+  printf("  bit scan, 2 priority:      %6.1f ns/interrupt\n", (double) priorityNS / kBenchIterations);
+
+  return testFinish("interrupt_dispatch");
+}
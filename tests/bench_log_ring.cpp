@@ -0,0 +1,93 @@
+//
+//  bench_log_ring.cpp
+//  Compares the caller's cost of deferred logging against formatting and printing each line immediately
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  The system log is disabled and the IPC service discards lines, so only formatting and capture are measured.
+//  Deferred lines are drained in batches between timed bursts, the drain is not part of the caller's cost.
+//
+
+#include "TestHarness.h"
+#include "WiiLogger.hpp"
+
+#define kBenchBurstLines    (kWiiLogRingRecordCount / 2)
+#define kBenchBursts        4000
+
+class BenchIPC : public IOService {
+  OSDeclareDefaultStructors(BenchIPC);
+
+public:
+  IOReturn callPlatformFunction(const OSSymbol *functionName, bool waitForFunction,
+                                void *param1, void *param2, void *param3, void *param4) {
+    return kIOReturnSuccess;
+  }
+};
+
+static const WiiLogService *gLogService;
+
+static void logLine(const char *format, ...) {
+  va_list va;
+
+  va_start(va, format);
+  gLogService->logLine("BenchClass", "bench@0", "benchFunc", format, va);
+  va_end(va);
+}
+
+static void logDeferred(const char *format, ...) {
+  va_list va;
+
+  va_start(va, format);
+  gLogService->logDeferred("BenchClass", "bench@0", "benchFunc", format, va);
+  va_end(va);
+}
+
+int main(void) {
+  WiiLogger *logger;
+  BenchIPC  *ipc;
+  UInt64    start;
+  UInt64    lineNS;
+  UInt64    deferredNS;
+
+  hostSetProcessorPVR(0x70010201);
+  hostSetLogOutput(false);
+
+  logger = WiiLogger::logger();
+  TEST_CHECK(logger != NULL);
+  if (logger == NULL) {
+    return testFinish("log_ring");
+  }
+  gLogService = logger->getService();
+  ipc = new BenchIPC;
+  IOService::hostPublishService(ipc, "WiiIPC");
+
+  //
+  // A typical transfer debug line, with a few numbers and a short string.
+  //
+  lineNS = 0;
+  for (UInt32 burst = 0; burst < kBenchBursts; burst++) {
+    start = testGetNanoseconds();
+    for (UInt32 i = 0; i < kBenchBurstLines; i++) {
+      logLine("Transfer %u on endpoint 0x%X, length %u, status 0x%X (%s)", i, 0x81, 512, 0, "bulk");
+    }
+    lineNS += testGetNanoseconds() - start;
+  }
+
+  deferredNS = 0;
+  for (UInt32 burst = 0; burst < kBenchBursts; burst++) {
+    start = testGetNanoseconds();
+    for (UInt32 i = 0; i < kBenchBurstLines; i++) {
+      logDeferred("Transfer %u on endpoint 0x%X, length %u, status 0x%X (%s)", i, 0x81, 512, 0, "bulk");
+    }
+    deferredNS += testGetNanoseconds() - start;
+    logger->flush();
+  }
+
+  printf("log_ring: %u lines\n", kBenchBursts * kBenchBurstLines);
+  printf("  immediate:                 %6.1f ns/line\n", (double) lineNS / (kBenchBursts * kBenchBurstLines));
+  printf("  deferred, caller:          %6.1f ns/line\n", (double) deferredNS / (kBenchBursts * kBenchBurstLines));
+
+  logger->release();
+  hostSetLogOutput(true);
+  return testFinish("log_ring");
+}
@@ -0,0 +1,372 @@
+//
+//  bench_ohci.cpp
+//  Measures OHCI driver transfer rates, CPU time per transfer descriptor, and completion latency on the controller model
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  Each workload keeps a few transfers queued on one endpoint, resubmitting from the completion as a client driver
+//  does. Bulk and interrupt workloads run frames back to back, so the rate is bound by the driver and host rather
+//  than the USB frame clock, and isochronous runs at the USB frame rate. CPU time per descriptor is the process CPU
+//  time less the controller model's own, so it covers submission, the interrupt filter, done queue handling and
+//  completion, along with the host shim's work loop and locking.
+//
+//  Latency runs a single transfer at a time at the USB frame rate, from the model writing back the done queue to the
+//  completion being called, which is the interrupt, work loop wakeup and done queue walk.
+//
+//  Bulk IN streaming is compared with and without -wiiohcibulkstream on clients keeping one read outstanding at the
+//  USB frame rate, USB Ethernet with 1514 byte frames ending in a short packet and mass storage with 64 KB reads.
+//  Without streaming the bus idles from each read completing to the next being queued, and a full speed frame holds
+//  at most 19 packets of 64 bytes in the model, about 1216 KB/s.
+//
+//  Interrupt handling is compared with cache-inhibited and cacheable (-wiiohcicachedtd) transfer descriptors, as the
+//  interrupt filter's CPU time and the driver's CPU time per descriptor. Host memory is always cached and the flushes
+//  and invalidates cost nothing here, so this shows the cost of the extra calls and checks only. The saving from
+//  cached descriptor reads is only seen on the PowerPC.
+//
+//  Host figures are for comparing driver changes, the PowerPC and the real controller costs differ.
+//
+
+#include "TestHarness.h"
+#include "TestOHCIDriver.h"
+#include "TestOHCIModel.h"
+
+#define kBenchFunction          2
+#define kBenchEndpoint          1
+#define kBenchBulkMPS           64
+#define kBenchIntMPS            8
+#define kBenchIsoMPS            192
+#define kBenchIsoFrames         8
+#define kBenchQueueDepth        4
+#define kBenchWarmupMS          100
+#define kBenchDurationMS        1000
+#define kBenchLatencyTransfers  500
+#define kBenchBufferSize        65536
+#define kBenchEthernetFrame     1514
+#define kBenchEthernetRead      2048
+#define kBenchStorageRead       65536
+
+typedef struct {
+  const char  *name;
+  UInt8       type;
+  UInt8       direction;
+  UInt32      length;
+  UInt32      messageLength;
+  UInt32      queueDepth;
+  UInt32      frameIntervalUS;
+} BenchWorkload;
+
+//
+// Endpoint kept busy by resubmitting from completions.
+//
+typedef struct {
+  TestOHCI            *ohci;
+  TestOHCIModel       *model;
+  const BenchWorkload *workload;
+  IOMemoryDescriptor  *buffers[kBenchQueueDepth];
+  IOUSBIsocFrame      isoFrames[kBenchQueueDepth][kBenchIsoFrames];
+  UInt64              isoNextFrame;
+  volatile bool       running;
+  volatile UInt32     inFlight;
+  volatile UInt32     completed;
+  volatile UInt32     errors;
+  volatile UInt64     bytes;
+
+  // Latency, done queue writeback to completion.
+  UInt64              latencyTotalNS;
+  UInt64              latencyMaxNS;
+} BenchStream;
+
+static UInt8  gControlRegs[kTestOHCIRegsSize];
+static UInt8  *gBuffers[kBenchQueueDepth];
+
+static void completeBenchTransfer(void *target, void *parameter, IOReturn status, UInt32 bufferSizeRemaining);
+static void completeBenchIsochTransfer(void *target, void *parameter, IOReturn status, IOUSBIsocFrame *frames);
+
+static UInt64 getProcessNanoseconds(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (((UInt64) ts.tv_sec) * 1000000000ULL) + ts.tv_nsec;
+}
+
+//
+// Submits the transfer for a queue slot, called from completions within the work loop.
+//
+static IOReturn submitBenchTransfer(BenchStream *stream, UInt32 slot) {
+  IOUSBCompletion     completion;
+  IOUSBIsocCompletion isoCompletion;
+  IOReturn            status;
+
+  completion.target    = stream;
+  completion.action    = completeBenchTransfer;
+  completion.parameter = (void *) (uintptr_t) slot;
+  switch (stream->workload->type) {
+    case kUSBBulk:
+      status = stream->ohci->createBulkTransfer(kBenchFunction, kBenchEndpoint, completion, stream->buffers[slot],
+                                                true, stream->workload->length, stream->workload->direction);
+      break;
+
+    case kUSBInterrupt:
+      status = stream->ohci->createInterruptTransfer(kBenchFunction, kBenchEndpoint, completion, stream->buffers[slot],
+                                                     stream->workload->length, stream->workload->direction);
+      break;
+
+    //
+    // Isochronous transfers follow each other, starting again a little ahead if the queue ran dry.
+    //
+    default:
+      for (UInt32 i = 0; i < kBenchIsoFrames; i++) {
+        stream->isoFrames[slot][i].frStatus   = kIOReturnNotReady;
+        stream->isoFrames[slot][i].frReqCount = kBenchIsoMPS;
+        stream->isoFrames[slot][i].frActCount = 0;
+      }
+      if (stream->isoNextFrame <= (stream->ohci->GetFrameNumber() + 1)) {
+        stream->isoNextFrame = stream->ohci->GetFrameNumber() + 4;
+      }
+      isoCompletion.target    = stream;
+      isoCompletion.action    = completeBenchIsochTransfer;
+      isoCompletion.parameter = (void *) (uintptr_t) slot;
+      status = stream->ohci->createIsochTransfer(kBenchFunction, kBenchEndpoint, isoCompletion, stream->workload->direction,
+                                                 stream->isoNextFrame, stream->buffers[slot], kBenchIsoFrames,
+                                                 stream->isoFrames[slot]);
+      stream->isoNextFrame += kBenchIsoFrames;
+      break;
+  }
+
+  if (status == kIOReturnSuccess) {
+    stream->inFlight++;
+  }
+  return status;
+}
+
+static void completeBenchTransfer(void *target, void *parameter, IOReturn status, UInt32 bufferSizeRemaining) {
+  BenchStream *stream;
+  UInt64      latencyNS;
+
+  stream = (BenchStream *) target;
+  stream->inFlight--;
+  stream->completed++;
+  stream->bytes += stream->workload->length - bufferSizeRemaining;
+  if ((status != kIOReturnSuccess) && (status != kIOReturnUnderrun)) {
+    stream->errors++;
+  }
+
+  latencyNS = testGetNanoseconds() - stream->model->getDoneWriteTime();
+  stream->latencyTotalNS += latencyNS;
+  if (latencyNS > stream->latencyMaxNS) {
+    stream->latencyMaxNS = latencyNS;
+  }
+
+  if (stream->running) {
+    submitBenchTransfer(stream, (UInt32) (uintptr_t) parameter);
+  }
+}
+
+static void completeBenchIsochTransfer(void *target, void *parameter, IOReturn status, IOUSBIsocFrame *frames) {
+  completeBenchTransfer(target, parameter, status, 0);
+}
+
+//
+// Starts a driver on a fresh controller model, with one endpoint for the workload.
+//
+static bool createBench(BenchStream *stream, IOService **nub, const BenchWorkload *workload) {
+  TestUSBEndpoint *device;
+  IOReturn        status;
+
+  bzero(stream, sizeof (*stream));
+  stream->workload = workload;
+
+  *nub = new IOService;
+  (*nub)->init();
+  (*nub)->hostSetDeviceMemory(0, gControlRegs, sizeof (gControlRegs));
+  stream->model = new TestOHCIModel(*nub);
+  hostAddDevice(stream->model, gControlRegs, sizeof (gControlRegs));
+  device = stream->model->addEndpoint(kBenchFunction, kBenchEndpoint, workload->direction);
+  device->isoPacketLength = kBenchIsoMPS;
+  device->messageLength   = workload->messageLength;
+  stream->model->start(workload->frameIntervalUS);
+
+  stream->ohci = new TestOHCI;
+  stream->ohci->setName("WiiOHCI");
+  if (!stream->ohci->init() || !stream->ohci->start(*nub)) {
+    return false;
+  }
+
+  switch (workload->type) {
+    case kUSBBulk:
+      status = stream->ohci->createBulkEndpoint(kBenchFunction, kBenchEndpoint, workload->direction, kBenchBulkMPS);
+      break;
+
+    case kUSBInterrupt:
+      status = stream->ohci->createInterruptEndpoint(kBenchFunction, kBenchEndpoint, workload->direction, kBenchIntMPS, 1);
+      break;
+
+    default:
+      status = stream->ohci->createIsochEndpoint(kBenchFunction, kBenchEndpoint, kBenchIsoMPS, workload->direction);
+      break;
+  }
+
+  for (UInt32 i = 0; i < kBenchQueueDepth; i++) {
+    stream->buffers[i] = IOMemoryDescriptor::withAddress(gBuffers[i], kBenchBufferSize, kIODirectionOutIn);
+  }
+  return status == kIOReturnSuccess;
+}
+
+//
+// Stops resubmitting, lets the queue drain, and tears down the driver and model.
+//
+static void destroyBench(BenchStream *stream, IOService *nub) {
+  stream->running = false;
+  for (UInt32 i = 0; (i < 1000) && (stream->inFlight > 0); i++) {
+    IOSleep(1);
+  }
+
+  stream->ohci->stop(nub);
+  stream->ohci->release();
+  stream->model->stop();
+  hostRemoveDevice(stream->model);
+  delete stream->model;
+  for (UInt32 i = 0; i < kBenchQueueDepth; i++) {
+    stream->buffers[i]->release();
+  }
+  nub->release();
+}
+
+//
+// Runs a workload, printing data and transfer rates, descriptors per second, and CPU time per descriptor.
+//
+static void benchThroughput(const BenchWorkload *workload, bool streaming, bool cachedTransfers) {
+  BenchStream stream;
+  IOService   *nub;
+  UInt64      start;
+  UInt64      processStart;
+  UInt64      engineStart;
+  UInt64      filterStart;
+  UInt64      descriptorsStart;
+  UInt64      bytesStart;
+  UInt32      completedStart;
+  double      seconds;
+  UInt64      descriptors;
+  UInt64      driverNS;
+  UInt64      filterNS;
+  char        label[64];
+
+  hostSetBootArgument(kWiiOHCIBulkStreamArg, streaming);
+  hostSetBootArgument(kWiiOHCICachedTransfersArg, cachedTransfers);
+  TEST_CHECK(createBench(&stream, &nub, workload));
+
+  stream.running = true;
+  stream.ohci->getWorkLoop()->closeGate();
+  for (UInt32 i = 0; i < workload->queueDepth; i++) {
+    TEST_CHECK(submitBenchTransfer(&stream, i) == kIOReturnSuccess);
+  }
+  stream.ohci->getWorkLoop()->openGate();
+  IOSleep(kBenchWarmupMS);
+
+  start            = testGetNanoseconds();
+  processStart     = getProcessNanoseconds();
+  engineStart      = stream.model->getEngineNanoseconds();
+  filterStart      = stream.model->getFilterNanoseconds();
+  descriptorsStart = stream.model->getRetiredTransfers();
+  bytesStart       = stream.bytes;
+  completedStart   = stream.completed;
+  IOSleep(kBenchDurationMS);
+
+  seconds     = (double) (testGetNanoseconds() - start) / 1000000000.0;
+  descriptors = stream.model->getRetiredTransfers() - descriptorsStart;
+  driverNS    = (getProcessNanoseconds() - processStart) - (stream.model->getEngineNanoseconds() - engineStart);
+  filterNS    = stream.model->getFilterNanoseconds() - filterStart;
+  snprintf(label, sizeof (label), "%s%s%s:", workload->name, streaming ? ", streaming" : "", cachedTransfers ? ", cached TDs" : "");
+  printf("  %-38s %6.0f KB/s, %6.0f transfers/s, %6.0f TDs/s, %6.0f ns CPU/TD, %5.0f ns filter/TD\n", label,
+    (stream.bytes - bytesStart) / seconds / 1024.0, (stream.completed - completedStart) / seconds,
+    descriptors / seconds, (descriptors > 0) ? ((double) driverNS / descriptors) : 0.0,
+    (descriptors > 0) ? ((double) filterNS / descriptors) : 0.0);
+
+  TEST_CHECK(stream.errors == 0);
+  TEST_CHECK(descriptors > 0);
+  destroyBench(&stream, nub);
+  hostSetBootArgument(kWiiOHCIBulkStreamArg, false);
+  hostSetBootArgument(kWiiOHCICachedTransfersArg, false);
+}
+
+//
+// Runs single inbound bulk transfers one after another at the USB frame rate, printing completion latency.
+//
+static void benchLatency(void) {
+  BenchStream   stream;
+  BenchWorkload workload = { "latency", kUSBBulk, kUSBIn, kBenchBulkMPS, 0, 1, kTestOHCIFrameIntervalUS };
+  IOService     *nub;
+  UInt32        completed;
+
+  TEST_CHECK(createBench(&stream, &nub, &workload));
+
+  stream.running = true;
+  stream.ohci->getWorkLoop()->closeGate();
+  TEST_CHECK(submitBenchTransfer(&stream, 0) == kIOReturnSuccess);
+  stream.ohci->getWorkLoop()->openGate();
+  for (UInt32 i = 0; (i < (kBenchLatencyTransfers * 10)) && (stream.completed < kBenchLatencyTransfers); i++) {
+    IOSleep(1);
+  }
+  stream.running = false;
+
+  completed = stream.completed;
+  TEST_CHECK(completed >= kBenchLatencyTransfers);
+  printf("  done queue to completion: %6.1f us mean, %6.1f us max, %u transfers\n",
+    (completed > 0) ? ((double) stream.latencyTotalNS / completed / 1000.0) : 0.0,
+    (double) stream.latencyMaxNS / 1000.0, completed);
+
+  TEST_CHECK(stream.errors == 0);
+  destroyBench(&stream, nub);
+}
+
+int main(void) {
+  TestPlatform *platform;
+  const BenchWorkload workloads[] = {
+    { "bulk IN 4096 bytes",     kUSBBulk,       kUSBIn,   4096,                           0, kBenchQueueDepth, kTestOHCIFrameIntervalNone },
+    { "bulk OUT 4096 bytes",    kUSBBulk,       kUSBOut,  4096,                           0, kBenchQueueDepth, kTestOHCIFrameIntervalNone },
+    { "interrupt IN 8 bytes",   kUSBInterrupt,  kUSBIn,   kBenchIntMPS,                   0, kBenchQueueDepth, kTestOHCIFrameIntervalNone },
+    { "iso IN 8 x 192 bytes",   kUSBIsoc,       kUSBIn,   kBenchIsoFrames * kBenchIsoMPS, 0, kBenchQueueDepth, kTestOHCIFrameIntervalUS }
+  };
+
+  //
+  // Clients reading one request at a time, as USB Ethernet and mass storage drivers do, at the USB frame rate.
+  // Ethernet frames end with a short packet, storage reads fill the request.
+  //
+  const BenchWorkload streamWorkloads[] = {
+    { "ethernet 1514 byte frames", kUSBBulk, kUSBIn, kBenchEthernetRead, kBenchEthernetFrame, 1, kTestOHCIFrameIntervalUS },
+    { "storage 64 KB reads",       kUSBBulk, kUSBIn, kBenchStorageRead,  0,                   1, kTestOHCIFrameIntervalUS }
+  };
+
+  hostSetLogOutput(false);
+  hostSetProcessorPVR(kTestPVRCafe);
+  platform = new TestPlatform;
+  IOService::hostSetPlatform(platform);
+  for (UInt32 i = 0; i < kBenchQueueDepth; i++) {
+    gBuffers[i] = (UInt8 *) IOMalloc(kBenchBufferSize);
+    bzero(gBuffers[i], kBenchBufferSize);
+  }
+
+  printf("ohci: %u transfers queued, %u ms per workload\n", kBenchQueueDepth, kBenchDurationMS);
+  for (UInt32 i = 0; i < ARRSIZE(workloads); i++) {
+    benchThroughput(&workloads[i], false, false);
+  }
+  benchLatency();
+
+  printf("ohci: bulk IN, one read outstanding, with and without streaming\n");
+  for (UInt32 i = 0; i < ARRSIZE(streamWorkloads); i++) {
+    benchThroughput(&streamWorkloads[i], false, false);
+    benchThroughput(&streamWorkloads[i], true, false);
+  }
+
+  printf("ohci: interrupt handling, cache-inhibited and cacheable transfer descriptors\n");
+  for (UInt32 i = 0; i < ARRSIZE(workloads); i++) {
+    benchThroughput(&workloads[i], false, false);
+    benchThroughput(&workloads[i], false, true);
+  }
+
+  for (UInt32 i = 0; i < kBenchQueueDepth; i++) {
+    IOFree(gBuffers[i], kBenchBufferSize);
+  }
+  platform->release();
+  return testFinish("ohci");
+}
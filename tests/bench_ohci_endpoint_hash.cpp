@@ -0,0 +1,165 @@
+//
+//  bench_ohci_endpoint_hash.cpp
+//  Measures OHCI endpoint lookups as the number of open endpoints grows
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  Lookups go through getEndpoint() on a table holding the given number of endpoints, for endpoints that are open
+//  and for ones that are not. The linear walk is the previous lookup, searching each endpoint list in turn, shown
+//  here as a single list holding every endpoint.
+//
+
+#include "TestHarness.h"
+#include "TestOHCIDriver.h"
+
+#define kBenchFunctionCount   127
+#define kBenchEndpointCount   16
+#define kBenchKeyCount        (kBenchFunctionCount * kBenchEndpointCount * 2)
+#define kBenchLookups         4000000
+
+static TestOHCI           *gOHCI;
+static OHCIEndpointData   gEndpoints[kBenchKeyCount];
+static UInt32             gOpenKeys[kWiiOHCIEndpointHashMaxCount];
+static UInt32             gClosedKeys[kWiiOHCIEndpointHashMaxCount];
+
+static UInt8 getFunction(UInt32 keyIndex) {
+  return (keyIndex / (kBenchEndpointCount * 2)) + 1;
+}
+
+static UInt8 getEndpointNumber(UInt32 keyIndex) {
+  return (keyIndex / 2) % kBenchEndpointCount;
+}
+
+static UInt8 getDirection(UInt32 keyIndex) {
+  return ((keyIndex & 1) != 0) ? kUSBIn : kUSBOut;
+}
+
+//
+// Opens a random set of endpoints, and picks as many that are not open.
+//
+static void openEndpoints(UInt32 count) {
+  UInt32  randomState;
+  UInt32  keyIndex;
+  UInt32  closedCount;
+  bool    *open;
+
+  open = (bool *) IOMalloc(kBenchKeyCount);
+  bzero(open, kBenchKeyCount);
+
+  randomState = 0x2545F491;
+  for (UInt32 i = 0; i < count; i++) {
+    do {
+      keyIndex = testRandom(&randomState) % kBenchKeyCount;
+    } while (open[keyIndex]);
+    open[keyIndex] = true;
+
+    bzero(&gEndpoints[keyIndex], sizeof (gEndpoints[keyIndex]));
+    gEndpoints[keyIndex].type = kWiiOHCIEndpointTypeBulk;
+    gEndpoints[keyIndex].key  = gOHCI->getKey(getFunction(keyIndex), getEndpointNumber(keyIndex), getDirection(keyIndex));
+    gOHCI->insertHashEndpoint(&gEndpoints[keyIndex]);
+    gOpenKeys[i] = keyIndex;
+
+    //
+    // Link the endpoints into one list for the linear walk.
+    //
+    gEndpoints[keyIndex].nextEndpoint = (i > 0) ? &gEndpoints[gOpenKeys[i - 1]] : NULL;
+  }
+
+  closedCount = 0;
+  while (closedCount < count) {
+    keyIndex = testRandom(&randomState) % kBenchKeyCount;
+    if (!open[keyIndex]) {
+      gClosedKeys[closedCount++] = keyIndex;
+    }
+  }
+
+  IOFree(open, kBenchKeyCount);
+}
+
+static void closeEndpoints(UInt32 count) {
+  for (UInt32 i = 0; i < count; i++) {
+    gOHCI->removeHashEndpoint(&gEndpoints[gOpenKeys[i]]);
+  }
+}
+
+//
+// Previous lookup, comparing the key of each endpoint in the list.
+//
+static OHCIEndpointData *walkEndpoints(OHCIEndpointData *headEndpoint, UInt16 key) {
+  OHCIEndpointData *endpoint;
+
+  endpoint = headEndpoint;
+  while ((endpoint != NULL) && (endpoint->key != key)) {
+    endpoint = endpoint->nextEndpoint;
+  }
+  return endpoint;
+}
+
+//
+// Times lookups of the given keys, returns nanoseconds per lookup.
+//
+static double timeLookups(const UInt32 *keys, UInt32 count, bool linear, UInt32 *found) {
+  OHCIEndpointData  *headEndpoint;
+  UInt32            keyIndex;
+  UInt64            startTime;
+  UInt64            elapsed;
+
+  headEndpoint = &gEndpoints[gOpenKeys[count - 1]];
+  *found       = 0;
+
+  startTime = testGetNanoseconds();
+  for (UInt32 i = 0; i < kBenchLookups; i++) {
+    keyIndex = keys[i % count];
+    if (linear) {
+      if (walkEndpoints(headEndpoint, gOHCI->getKey(getFunction(keyIndex), getEndpointNumber(keyIndex), getDirection(keyIndex))) != NULL) {
+        (*found)++;
+      }
+    } else {
+      if (gOHCI->lookupEndpoint(getFunction(keyIndex), getEndpointNumber(keyIndex), getDirection(keyIndex),
+                                kWiiOHCIEndpointTypeBulk) != NULL) {
+        (*found)++;
+      }
+    }
+  }
+  elapsed = testGetNanoseconds() - startTime;
+
+  return (double) elapsed / kBenchLookups;
+}
+
+int main(void) {
+  static const UInt32 counts[] = { 4, 16, 64, 128, 256, kWiiOHCIEndpointHashMaxCount };
+  double              openNS;
+  double              closedNS;
+  double              linearOpenNS;
+  double              linearClosedNS;
+  UInt32              openFound;
+  UInt32              closedFound;
+  UInt32              linearOpenFound;
+  UInt32              linearClosedFound;
+
+  hostSetLogOutput(false);
+  gOHCI = new TestOHCI;
+  if (!gOHCI->init()) {
+    return 1;
+  }
+
+  printf("ohci_endpoint_hash: %u lookups per case, %u table slots\n", kBenchLookups, kWiiOHCIEndpointHashSize);
+  for (UInt32 c = 0; c < (sizeof (counts) / sizeof (counts[0])); c++) {
+    openEndpoints(counts[c]);
+    openNS         = timeLookups(gOpenKeys, counts[c], false, &openFound);
+    closedNS       = timeLookups(gClosedKeys, counts[c], false, &closedFound);
+    linearOpenNS   = timeLookups(gOpenKeys, counts[c], true, &linearOpenFound);
+    linearClosedNS = timeLookups(gClosedKeys, counts[c], true, &linearClosedFound);
+    closeEndpoints(counts[c]);
+
+    if ((openFound != kBenchLookups) || (closedFound != 0) || (linearOpenFound != kBenchLookups) || (linearClosedFound != 0)) {
+      printf("  %3u endpoints: lookups returned wrong endpoints\n", counts[c]);
+      return 1;
+    }
+    printf("  %3u endpoints: getEndpoint %5.1f ns open, %5.1f ns not open, linear walk %6.1f ns open, %6.1f ns not open\n",
+           counts[c], openNS, closedNS, linearOpenNS, linearClosedNS);
+  }
+
+  gOHCI->release();
+  return 0;
+}
@@ -0,0 +1,80 @@
+//
+//  bench_paired_single.cpp
+//  Compares the audio clip loop before paired singles against the reference clip now used for remainders
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  Only the scalar paths run on the host, the paired-single loop itself must be timed on a Wii or Wii U.
+//  Buffers are 512 stereo frames, as mixed by the audio engine, with the volume changing between buffers.
+//
+
+#include "TestHarness.h"
+#include "WiiPairedSingle.hpp"
+
+#define kBenchSamples       1024
+#define kBenchBuffers       20000
+#define kBenchVolumes       64
+
+#define kMaxSInt16ValueInFloat           (3.2768000000000e4)
+#define kMaxFloatMinusLSBSInt16          (0.99996948242188)
+#define kMinusOne                        (-1.0)
+
+//
+// Clip loop as it was in WiiAudioEngine::clipOutputSamples().
+//
+static void clipPrevious(const float *in, SInt16 *out, UInt32 count, float adjustment) {
+  float value;
+
+  for (UInt32 i = 0; i < count; i++) {
+    value = in[i] * adjustment;
+    if (value > kMaxFloatMinusLSBSInt16) {
+      value = kMaxFloatMinusLSBSInt16;
+    } else if (value < kMinusOne) {
+      value = kMinusOne;
+    }
+    out[i] = (SInt16) (value * kMaxSInt16ValueInFloat);
+  }
+}
+
+int main(void) {
+  static float  in[kBenchSamples];
+  static SInt16 outPrevious[kBenchSamples];
+  static SInt16 outReference[kBenchSamples];
+  float         volumes[kBenchVolumes];
+  UInt32        seed;
+  UInt32        mismatches;
+  UInt64        start;
+  UInt64        previousNS;
+  UInt64        referenceNS;
+
+  seed = 0x434C4950;
+  for (UInt32 i = 0; i < kBenchSamples; i++) {
+    in[i] = ((float) (SInt32) testRandom(&seed) / 2147483648.0f) * 1.25f;
+  }
+  for (UInt32 i = 0; i < kBenchVolumes; i++) {
+    volumes[i] = (float) (testRandom(&seed) % 65536) / 65535.0f;
+  }
+
+  mismatches  = 0;
+  previousNS  = 0;
+  referenceNS = 0;
+  for (UInt32 buffer = 0; buffer < kBenchBuffers; buffer++) {
+    start = testGetNanoseconds();
+    clipPrevious(in, outPrevious, kBenchSamples, volumes[buffer % kBenchVolumes]);
+    previousNS += testGetNanoseconds() - start;
+
+    start = testGetNanoseconds();
+    convertFloatToSInt16(in, outReference, kBenchSamples, volumes[buffer % kBenchVolumes]);
+    referenceNS += testGetNanoseconds() - start;
+
+    if (memcmp(outPrevious, outReference, sizeof (outPrevious)) != 0) {
+      mismatches++;
+    }
+  }
+  TEST_CHECK(mismatches == 0);
+
+  printf("paired_single: %u buffers of %u samples\n", kBenchBuffers, kBenchSamples);
+  printf("  previous clip loop:        %6.2f ns/sample\n", (double) previousNS / ((UInt64) kBenchBuffers * kBenchSamples));
+  printf("  reference clip:            %6.2f ns/sample\n", (double) referenceNS / ((UInt64) kBenchBuffers * kBenchSamples));
+  return testFinish("paired_single");
+}
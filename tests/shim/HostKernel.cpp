@@ -0,0 +1,1677 @@
+//
+//  HostKernel.cpp
+//  Host stand-ins for the kernel and I/O Kit interfaces used by the code under test
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "HostKernel.h"
+
+//
+// Processor state.
+//
+static __thread boolean_t gHostInterruptsDisabled;
+static __thread int       gHostCPUNumber;
+static UInt32             gHostProcessorPVR;
+static HostDevice         *gHostSPRDevice;
+static bool               gHostLogDisabled;
+static vm_offset_t        gHostFlushAddress;
+static unsigned           gHostFlushCount;
+
+int (*PE_halt_restart)(unsigned int type);
+task_t kernel_task;
+
+void IOLog(const char *format, ...) {
+  va_list va;
+
+  if (gHostLogDisabled) {
+    return;
+  }
+  va_start(va, format);
+  vprintf(format, va);
+  va_end(va);
+}
+
+void hostSetLogOutput(bool enabled) {
+  gHostLogDisabled = !enabled;
+}
+
+//
+// Flag boot arguments set by tests.
+//
+#define kWiiHostMaxBootArguments  8
+
+static const char *gHostBootArguments[kWiiHostMaxBootArguments];
+
+int PE_parse_boot_arg(const char *name, void *value) {
+  for (UInt32 i = 0; i < kWiiHostMaxBootArguments; i++) {
+    if ((gHostBootArguments[i] != NULL) && (strcmp(gHostBootArguments[i], name) == 0)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void hostSetBootArgument(const char *name, bool present) {
+  for (UInt32 i = 0; i < kWiiHostMaxBootArguments; i++) {
+    if ((gHostBootArguments[i] != NULL) && (strcmp(gHostBootArguments[i], name) == 0)) {
+      gHostBootArguments[i] = present ? gHostBootArguments[i] : NULL;
+      return;
+    }
+  }
+  for (UInt32 i = 0; present && (i < kWiiHostMaxBootArguments); i++) {
+    if (gHostBootArguments[i] == NULL) {
+      gHostBootArguments[i] = name;
+      return;
+    }
+  }
+}
+
+//
+// Cache handoff checks, lines are kept in a fixed table found by linear probing.
+//
+#define kHostDataCacheMaxLines  8192
+
+typedef struct {
+  vm_offset_t address;
+  // Contents of the line in memory, once flushed or written by the device.
+  UInt8       memory[kHostDataCacheLineSize];
+  bool        memoryValid;
+  bool        deviceWrote;
+} HostDataCacheLine;
+
+static pthread_mutex_t    gHostDataCacheMutex = PTHREAD_MUTEX_INITIALIZER;
+static bool               gHostDataCacheChecks;
+static HostDataCacheLine  *gHostDataCacheLines;
+static HostDataCacheStats gHostDataCacheStats;
+
+static HostDataCacheLine *hostGetDataCacheLine(vm_offset_t address, bool create) {
+  UInt32 index;
+
+  index = (UInt32) ((address / kHostDataCacheLineSize) % kHostDataCacheMaxLines);
+  for (UInt32 i = 0; i < kHostDataCacheMaxLines; i++) {
+    if (gHostDataCacheLines[index].address == address) {
+      return &gHostDataCacheLines[index];
+    }
+    if (gHostDataCacheLines[index].address == 0) {
+      if (!create) {
+        return NULL;
+      }
+      gHostDataCacheLines[index].address = address;
+      return &gHostDataCacheLines[index];
+    }
+    index = (index + 1) % kHostDataCacheMaxLines;
+  }
+  return NULL;
+}
+
+//
+// Calls the function for each tracked line in a range, with the lock held.
+//
+static void hostForDataCacheLines(vm_offset_t address, UInt32 length, bool create, void (*function)(HostDataCacheLine *line)) {
+  HostDataCacheLine *line;
+
+  pthread_mutex_lock(&gHostDataCacheMutex);
+  if (gHostDataCacheChecks && (length > 0)) {
+    for (vm_offset_t lineAddress = address & ~((vm_offset_t) kHostDataCacheLineSize - 1);
+         lineAddress < (address + length); lineAddress += kHostDataCacheLineSize) {
+      line = hostGetDataCacheLine(lineAddress, create);
+      if (line != NULL) {
+        function(line);
+      }
+    }
+  }
+  pthread_mutex_unlock(&gHostDataCacheMutex);
+}
+
+static void hostFlushLine(HostDataCacheLine *line) {
+  if (line->deviceWrote) {
+    gHostDataCacheStats.lostWrites++;
+    line->deviceWrote = false;
+  }
+  memcpy(line->memory, (const void *) line->address, kHostDataCacheLineSize);
+  line->memoryValid = true;
+  gHostDataCacheStats.flushes++;
+}
+
+static void hostInvalidateLine(HostDataCacheLine *line) {
+  line->deviceWrote = false;
+  memcpy(line->memory, (const void *) line->address, kHostDataCacheLineSize);
+  line->memoryValid = true;
+  gHostDataCacheStats.invalidates++;
+}
+
+//
+// A device read of a line never flushed counts as stale too.
+//
+static void hostDeviceReadLine(HostDataCacheLine *line) {
+  if (!line->memoryValid || (memcmp(line->memory, (const void *) line->address, kHostDataCacheLineSize) != 0)) {
+    gHostDataCacheStats.staleReads++;
+  }
+}
+
+static void hostDeviceWroteLine(HostDataCacheLine *line) {
+  line->deviceWrote = true;
+  memcpy(line->memory, (const void *) line->address, kHostDataCacheLineSize);
+  line->memoryValid = true;
+}
+
+//
+// Physical ranges are checked through their host mapping, ranges with none are not tracked.
+//
+void flush_dcache(vm_offset_t address, unsigned count, boolean_t phys) {
+  gHostFlushAddress = address;
+  gHostFlushCount   = count;
+  if (phys) {
+    address = (vm_offset_t) hostPhysToVirt((UInt32) address);
+  }
+  if (address != 0) {
+    hostForDataCacheLines(address, count, true, hostFlushLine);
+  }
+}
+
+void hostGetLastDataCacheFlush(vm_offset_t *address, unsigned *count) {
+  *address = gHostFlushAddress;
+  *count   = gHostFlushCount;
+}
+
+void invalidate_dcache(vm_offset_t address, unsigned count, boolean_t phys) {
+  if (phys) {
+    address = (vm_offset_t) hostPhysToVirt((UInt32) address);
+  }
+  if (address != 0) {
+    hostForDataCacheLines(address, count, true, hostInvalidateLine);
+  }
+}
+
+void hostSetDataCacheChecks(bool enabled) {
+  pthread_mutex_lock(&gHostDataCacheMutex);
+  if (gHostDataCacheLines == NULL) {
+    gHostDataCacheLines = (HostDataCacheLine *) calloc(kHostDataCacheMaxLines, sizeof (HostDataCacheLine));
+  }
+  bzero(gHostDataCacheLines, kHostDataCacheMaxLines * sizeof (HostDataCacheLine));
+  bzero(&gHostDataCacheStats, sizeof (gHostDataCacheStats));
+  gHostDataCacheChecks = enabled;
+  pthread_mutex_unlock(&gHostDataCacheMutex);
+}
+
+void hostGetDataCacheStats(HostDataCacheStats *stats) {
+  pthread_mutex_lock(&gHostDataCacheMutex);
+  *stats = gHostDataCacheStats;
+  stats->pendingWrites = 0;
+  for (UInt32 i = 0; gHostDataCacheChecks && (i < kHostDataCacheMaxLines); i++) {
+    if ((gHostDataCacheLines[i].address != 0) && gHostDataCacheLines[i].deviceWrote) {
+      stats->pendingWrites++;
+    }
+  }
+  pthread_mutex_unlock(&gHostDataCacheMutex);
+}
+
+void hostCheckDeviceRead(const volatile void *address, UInt32 length) {
+  hostForDataCacheLines((vm_offset_t) address, length, true, hostDeviceReadLine);
+}
+
+void hostDeviceWrote(const volatile void *address, UInt32 length) {
+  hostForDataCacheLines((vm_offset_t) address, length, true, hostDeviceWroteLine);
+}
+
+boolean_t ml_set_interrupts_enabled(boolean_t enable) {
+  boolean_t wasEnabled;
+
+  wasEnabled = !gHostInterruptsDisabled;
+  gHostInterruptsDisabled = !enable;
+  return wasEnabled;
+}
+
+boolean_t ml_get_interrupts_enabled(void) {
+  return !gHostInterruptsDisabled;
+}
+
+UInt32 hostGetProcessorPVR(void) {
+  return gHostProcessorPVR;
+}
+
+void hostSetProcessorPVR(UInt32 pvr) {
+  gHostProcessorPVR = pvr;
+}
+
+void hostSetSPRDevice(HostDevice *device) {
+  gHostSPRDevice = device;
+}
+
+UInt32 hostReadSPR(UInt32 spr) {
+  return (gHostSPRDevice != NULL) ? gHostSPRDevice->readReg32(spr) : 0;
+}
+
+void hostWriteSPR(UInt32 spr, UInt32 value) {
+  if (gHostSPRDevice != NULL) {
+    gHostSPRDevice->writeReg32(spr, value);
+  }
+}
+
+clock_frequency_info_t gPEClockFrequencyInfo = { 0, 0, kSecondScale };
+
+UInt64 hostGetProcessorTimebase(void) {
+  AbsoluteTime now;
+
+  clock_get_uptime(&now);
+  return now;
+}
+
+int cpu_number(void) {
+  return gHostCPUNumber;
+}
+
+void hostSetCPUNumber(int cpu) {
+  gHostCPUNumber = cpu;
+}
+
+//
+// Locks.
+//
+struct IOLock {
+  pthread_mutex_t mutex;
+};
+
+struct IOSimpleLock {
+  pthread_mutex_t mutex;
+};
+
+IOLock *IOLockAlloc(void) {
+  IOLock *lock;
+
+  lock = new IOLock;
+  pthread_mutex_init(&lock->mutex, NULL);
+  return lock;
+}
+
+void IOLockFree(IOLock *lock) {
+  pthread_mutex_destroy(&lock->mutex);
+  delete lock;
+}
+
+void IOLockLock(IOLock *lock) {
+  pthread_mutex_lock(&lock->mutex);
+}
+
+void IOLockUnlock(IOLock *lock) {
+  pthread_mutex_unlock(&lock->mutex);
+}
+
+IOSimpleLock *IOSimpleLockAlloc(void) {
+  IOSimpleLock *lock;
+
+  lock = new IOSimpleLock;
+  pthread_mutex_init(&lock->mutex, NULL);
+  return lock;
+}
+
+void IOSimpleLockFree(IOSimpleLock *lock) {
+  pthread_mutex_destroy(&lock->mutex);
+  delete lock;
+}
+
+void IOSimpleLockLock(IOSimpleLock *lock) {
+  pthread_mutex_lock(&lock->mutex);
+}
+
+void IOSimpleLockUnlock(IOSimpleLock *lock) {
+  pthread_mutex_unlock(&lock->mutex);
+}
+
+IOInterruptState IOSimpleLockLockDisableInterrupt(IOSimpleLock *lock) {
+  IOInterruptState state;
+
+  state = ml_set_interrupts_enabled(false);
+  pthread_mutex_lock(&lock->mutex);
+  return state;
+}
+
+void IOSimpleLockUnlockEnableInterrupt(IOSimpleLock *lock, IOInterruptState state) {
+  pthread_mutex_unlock(&lock->mutex);
+  ml_set_interrupts_enabled(state);
+}
+
+//
+// Time.
+//
+void clock_get_uptime(AbsoluteTime *result) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  *result = (((UInt64) ts.tv_sec) * kSecondScale) + ts.tv_nsec;
+}
+
+void clock_interval_to_deadline(UInt32 interval, UInt32 scaleFactor, AbsoluteTime *result) {
+  AbsoluteTime now;
+
+  clock_get_uptime(&now);
+  *result = now + (((UInt64) interval) * scaleFactor);
+}
+
+//
+// Thread calls, pending calls are kept in a list and run by one thread in deadline order.
+//
+struct thread_call {
+  thread_call_func_t  func;
+  thread_call_param_t param0;
+  thread_call_param_t param1;
+  AbsoluteTime        deadline;
+  bool                pending;
+  thread_call         *next;
+};
+
+static pthread_mutex_t  gThreadCallMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   gThreadCallCond  = PTHREAD_COND_INITIALIZER;
+static thread_call      *gThreadCallHeadPtr;
+static thread_call      *gThreadCallRunning;
+static bool             gThreadCallStarted;
+
+static void *threadCallMain(void *param) {
+  thread_call     *call;
+  AbsoluteTime    now;
+  struct timespec ts;
+
+  pthread_mutex_lock(&gThreadCallMutex);
+  while (true) {
+    if (gThreadCallHeadPtr == NULL) {
+      pthread_cond_wait(&gThreadCallCond, &gThreadCallMutex);
+      continue;
+    }
+
+    clock_get_uptime(&now);
+    call = gThreadCallHeadPtr;
+    if (call->deadline > now) {
+      ts.tv_sec  = call->deadline / kSecondScale;
+      ts.tv_nsec = call->deadline % kSecondScale;
+      pthread_cond_timedwait(&gThreadCallCond, &gThreadCallMutex, &ts);
+      continue;
+    }
+
+    gThreadCallHeadPtr = call->next;
+    call->pending      = false;
+    gThreadCallRunning = call;
+    pthread_mutex_unlock(&gThreadCallMutex);
+
+    call->func(call->param0, call->param1);
+
+    pthread_mutex_lock(&gThreadCallMutex);
+    gThreadCallRunning = NULL;
+    pthread_cond_broadcast(&gThreadCallCond);
+  }
+  return NULL;
+}
+
+//
+// Removes a pending call. Must be called with the thread call lock held.
+//
+static bool threadCallRemove(thread_call *call) {
+  thread_call **callPtr;
+
+  if (!call->pending) {
+    return false;
+  }
+  for (callPtr = &gThreadCallHeadPtr; *callPtr != call; callPtr = &(*callPtr)->next);
+  *callPtr      = call->next;
+  call->pending = false;
+  return true;
+}
+
+static boolean_t threadCallEnter(thread_call *call, thread_call_param_t param1, bool setParam1, AbsoluteTime deadline) {
+  thread_call     **callPtr;
+  pthread_t       thread;
+  pthread_attr_t  attr;
+  bool            wasPending;
+
+  pthread_mutex_lock(&gThreadCallMutex);
+  if (!gThreadCallStarted) {
+    //
+    // The condition uses the realtime clock by default, deadlines are monotonic.
+    //
+    pthread_condattr_t condAttr;
+    pthread_condattr_init(&condAttr);
+    pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+    pthread_cond_init(&gThreadCallCond, &condAttr);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_create(&thread, &attr, threadCallMain, NULL);
+    gThreadCallStarted = true;
+  }
+
+  wasPending = threadCallRemove(call);
+  if (setParam1) {
+    call->param1 = param1;
+  }
+  call->deadline = deadline;
+  call->pending  = true;
+  for (callPtr = &gThreadCallHeadPtr; (*callPtr != NULL) && ((*callPtr)->deadline <= deadline); callPtr = &(*callPtr)->next);
+  call->next = *callPtr;
+  *callPtr   = call;
+
+  pthread_cond_broadcast(&gThreadCallCond);
+  pthread_mutex_unlock(&gThreadCallMutex);
+  return wasPending;
+}
+
+thread_call_t thread_call_allocate(thread_call_func_t func, thread_call_param_t param0) {
+  thread_call *call;
+
+  call = new thread_call;
+  bzero(call, sizeof (*call));
+  call->func   = func;
+  call->param0 = param0;
+  return call;
+}
+
+boolean_t thread_call_free(thread_call_t call) {
+  pthread_mutex_lock(&gThreadCallMutex);
+  threadCallRemove(call);
+  while (gThreadCallRunning == call) {
+    pthread_cond_wait(&gThreadCallCond, &gThreadCallMutex);
+  }
+  pthread_mutex_unlock(&gThreadCallMutex);
+
+  delete call;
+  return true;
+}
+
+boolean_t thread_call_enter(thread_call_t call) {
+  return threadCallEnter(call, NULL, false, 0);
+}
+
+boolean_t thread_call_enter1(thread_call_t call, thread_call_param_t param1) {
+  return threadCallEnter(call, param1, true, 0);
+}
+
+boolean_t thread_call_enter_delayed(thread_call_t call, AbsoluteTime deadline) {
+  return threadCallEnter(call, NULL, false, deadline);
+}
+
+boolean_t thread_call_enter1_delayed(thread_call_t call, thread_call_param_t param1, AbsoluteTime deadline) {
+  return threadCallEnter(call, param1, true, deadline);
+}
+
+boolean_t thread_call_cancel(thread_call_t call) {
+  boolean_t wasPending;
+
+  pthread_mutex_lock(&gThreadCallMutex);
+  wasPending = threadCallRemove(call);
+  pthread_mutex_unlock(&gThreadCallMutex);
+  return wasPending;
+}
+
+//
+// Emulated devices. Devices are expected to be added before the code under test runs.
+//
+#define kWiiHostMaxDevices    8
+
+struct HostDeviceRange {
+  HostDevice          *device;
+  const volatile UInt8 *base;
+  UInt32              length;
+};
+
+volatile UInt32         gHostDeviceCount;
+static HostDeviceRange  gHostDevices[kWiiHostMaxDevices];
+
+void hostAddDevice(HostDevice *device, volatile void *base, UInt32 length) {
+  gHostDevices[gHostDeviceCount].device = device;
+  gHostDevices[gHostDeviceCount].base   = (const volatile UInt8 *) base;
+  gHostDevices[gHostDeviceCount].length = length;
+  gHostDeviceCount++;
+}
+
+void hostRemoveDevice(HostDevice *device) {
+  for (UInt32 i = 0; i < gHostDeviceCount; i++) {
+    if (gHostDevices[i].device == device) {
+      gHostDevices[i] = gHostDevices[gHostDeviceCount - 1];
+      gHostDeviceCount--;
+      return;
+    }
+  }
+}
+
+HostDevice *hostFindDevice(const volatile void *address, UInt32 *offset) {
+  const volatile UInt8 *bytes = (const volatile UInt8 *) address;
+
+  for (UInt32 i = 0; i < gHostDeviceCount; i++) {
+    if ((bytes >= gHostDevices[i].base) && (bytes < (gHostDevices[i].base + gHostDevices[i].length))) {
+      *offset = (UInt32) (bytes - gHostDevices[i].base);
+      return gHostDevices[i].device;
+    }
+  }
+  return NULL;
+}
+
+//
+// Fake physical addresses, assigned page aligned from a fixed base.
+//
+#define kWiiHostPhysBase      0x10000000
+#define kWiiHostMaxPhysRanges 4096
+
+struct HostPhysRange {
+  UInt8   *address;
+  UInt32  physAddr;
+  UInt32  length;
+};
+
+static pthread_mutex_t  gHostPhysMutex = PTHREAD_MUTEX_INITIALIZER;
+static HostPhysRange    gHostPhysRanges[kWiiHostMaxPhysRanges];
+static UInt32           gHostPhysCount;
+static UInt32           gHostPhysNext = kWiiHostPhysBase;
+
+UInt32 hostMapPhysical(void *address, vm_size_t length) {
+  UInt32 physAddr;
+
+  pthread_mutex_lock(&gHostPhysMutex);
+  if (gHostPhysCount == kWiiHostMaxPhysRanges) {
+    pthread_mutex_unlock(&gHostPhysMutex);
+    return 0;
+  }
+
+  physAddr = gHostPhysNext + (UInt32) (((uintptr_t) address) & (PAGE_SIZE - 1));
+  gHostPhysRanges[gHostPhysCount].address  = (UInt8 *) address;
+  gHostPhysRanges[gHostPhysCount].physAddr = physAddr;
+  gHostPhysRanges[gHostPhysCount].length   = (UInt32) length;
+  gHostPhysCount++;
+  gHostPhysNext = (physAddr + length + (2 * PAGE_SIZE)) & ~(PAGE_SIZE - 1);
+  pthread_mutex_unlock(&gHostPhysMutex);
+  return physAddr;
+}
+
+//
+// Maps host memory at a fixed physical address, for registers found through their physical address.
+// The address must be below the range hostMapPhysical() assigns from.
+//
+bool hostMapPhysicalAt(void *address, vm_size_t length, UInt32 physAddr) {
+  pthread_mutex_lock(&gHostPhysMutex);
+  if ((gHostPhysCount == kWiiHostMaxPhysRanges) || ((physAddr + length) > kWiiHostPhysBase)) {
+    pthread_mutex_unlock(&gHostPhysMutex);
+    return false;
+  }
+
+  gHostPhysRanges[gHostPhysCount].address  = (UInt8 *) address;
+  gHostPhysRanges[gHostPhysCount].physAddr = physAddr;
+  gHostPhysRanges[gHostPhysCount].length   = (UInt32) length;
+  gHostPhysCount++;
+  pthread_mutex_unlock(&gHostPhysMutex);
+  return true;
+}
+
+void hostUnmapPhysical(void *address) {
+  pthread_mutex_lock(&gHostPhysMutex);
+  for (UInt32 i = 0; i < gHostPhysCount; i++) {
+    if (gHostPhysRanges[i].address == address) {
+      gHostPhysRanges[i] = gHostPhysRanges[gHostPhysCount - 1];
+      gHostPhysCount--;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&gHostPhysMutex);
+}
+
+void *hostPhysToVirt(UInt32 physAddr) {
+  void *address;
+
+  address = NULL;
+  pthread_mutex_lock(&gHostPhysMutex);
+  for (UInt32 i = 0; i < gHostPhysCount; i++) {
+    if ((physAddr >= gHostPhysRanges[i].physAddr) && (physAddr < (gHostPhysRanges[i].physAddr + gHostPhysRanges[i].length))) {
+      address = gHostPhysRanges[i].address + (physAddr - gHostPhysRanges[i].physAddr);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&gHostPhysMutex);
+  return address;
+}
+
+UInt32 hostVirtToPhys(const volatile void *address) {
+  const volatile UInt8  *bytes = (const volatile UInt8 *) address;
+  UInt32                physAddr;
+
+  physAddr = 0;
+  pthread_mutex_lock(&gHostPhysMutex);
+  for (UInt32 i = 0; i < gHostPhysCount; i++) {
+    if ((bytes >= gHostPhysRanges[i].address) && (bytes < (gHostPhysRanges[i].address + gHostPhysRanges[i].length))) {
+      physAddr = gHostPhysRanges[i].physAddr + (UInt32) (bytes - gHostPhysRanges[i].address);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&gHostPhysMutex);
+  return physAddr;
+}
+
+void *IOMallocContiguous(vm_size_t size, vm_size_t alignment, IOPhysicalAddress *physicalAddress) {
+  void *address;
+
+  address = IOMallocAligned(size, PAGE_SIZE);
+  if (address == NULL) {
+    return NULL;
+  }
+  *physicalAddress = hostMapPhysical(address, size);
+  if (*physicalAddress == 0) {
+    IOFreeAligned(address, size);
+    return NULL;
+  }
+  return address;
+}
+
+void IOFreeContiguous(void *address, vm_size_t size) {
+  hostUnmapPhysical(address);
+  IOFreeAligned(address, size);
+}
+
+//
+// Collections.
+//
+const OSSymbol *OSSymbol::withCString(const char *string) {
+  OSSymbol *symbol;
+
+  symbol = new OSSymbol;
+  symbol->_string = strdup(string);
+  return symbol;
+}
+
+void OSSymbol::free(void) {
+  ::free(_string);
+  OSObject::free();
+}
+
+OSString *OSString::withCString(const char *string) {
+  OSString *result;
+
+  result = new OSString;
+  result->_string = strdup(string);
+  return result;
+}
+
+void OSString::free(void) {
+  ::free(_string);
+  OSObject::free();
+}
+
+OSData *OSData::withCapacity(UInt32 capacity) {
+  OSData *data;
+
+  data = new OSData;
+  data->_capacity = (capacity != 0) ? capacity : 1;
+  data->_length   = 0;
+  data->_bytes    = (UInt8 *) malloc(data->_capacity);
+  return data;
+}
+
+void OSData::free(void) {
+  ::free(_bytes);
+  OSObject::free();
+}
+
+bool OSData::appendBytes(const void *bytes, UInt32 length) {
+  while ((_length + length) > _capacity) {
+    _capacity *= 2;
+    _bytes = (UInt8 *) realloc(_bytes, _capacity);
+  }
+  memcpy(_bytes + _length, bytes, length);
+  _length += length;
+  return true;
+}
+
+OSArray *OSArray::withCapacity(UInt32 capacity) {
+  OSArray *array;
+
+  array = new OSArray;
+  array->_capacity = (capacity != 0) ? capacity : 1;
+  array->_count    = 0;
+  array->_objects  = (OSObject **) malloc(array->_capacity * sizeof (OSObject *));
+  return array;
+}
+
+void OSArray::free(void) {
+  for (UInt32 i = 0; i < _count; i++) {
+    _objects[i]->release();
+  }
+  ::free(_objects);
+  OSObject::free();
+}
+
+bool OSArray::setObject(const OSObject *object) {
+  if (_count == _capacity) {
+    _capacity *= 2;
+    _objects = (OSObject **) realloc(_objects, _capacity * sizeof (OSObject *));
+  }
+  ((OSObject *) object)->retain();
+  _objects[_count++] = (OSObject *) object;
+  return true;
+}
+
+OSDictionary *OSDictionary::withCapacity(UInt32 capacity) {
+  OSDictionary *dictionary;
+
+  dictionary = new OSDictionary;
+  dictionary->_capacity = (capacity != 0) ? capacity : 1;
+  dictionary->_count    = 0;
+  dictionary->_keys     = (char **) malloc(dictionary->_capacity * sizeof (char *));
+  dictionary->_objects  = (OSObject **) malloc(dictionary->_capacity * sizeof (OSObject *));
+  return dictionary;
+}
+
+void OSDictionary::free(void) {
+  for (UInt32 i = 0; i < _count; i++) {
+    ::free(_keys[i]);
+    _objects[i]->release();
+  }
+  ::free(_keys);
+  ::free(_objects);
+  OSObject::free();
+}
+
+bool OSDictionary::setObject(const char *key, const OSObject *object) {
+  ((OSObject *) object)->retain();
+  for (UInt32 i = 0; i < _count; i++) {
+    if (strcmp(_keys[i], key) == 0) {
+      _objects[i]->release();
+      _objects[i] = (OSObject *) object;
+      return true;
+    }
+  }
+
+  if (_count == _capacity) {
+    _capacity *= 2;
+    _keys    = (char **) realloc(_keys, _capacity * sizeof (char *));
+    _objects = (OSObject **) realloc(_objects, _capacity * sizeof (OSObject *));
+  }
+  _keys[_count]    = strdup(key);
+  _objects[_count] = (OSObject *) object;
+  _count++;
+  return true;
+}
+
+OSObject *OSDictionary::getObject(const char *key) const {
+  for (UInt32 i = 0; i < _count; i++) {
+    if (strcmp(_keys[i], key) == 0) {
+      return _objects[i];
+    }
+  }
+  return NULL;
+}
+
+//
+// Registry entries and services.
+//
+const OSSymbol *gIOInterruptSpecifiersKey = OSSymbol::withCString("IOInterruptSpecifiers");
+
+bool IORegistryEntry::init(OSDictionary *dictionary) {
+  _properties = OSDictionary::withCapacity(8);
+  return OSObject::init();
+}
+
+void IORegistryEntry::free(void) {
+  OSSafeReleaseNULL(_properties);
+  OSObject::free();
+}
+
+OSObject *IORegistryEntry::getProperty(const char *key) const {
+  return (_properties != NULL) ? _properties->getObject(key) : NULL;
+}
+
+bool IORegistryEntry::setProperty(const char *key, OSObject *object) {
+  if (_properties == NULL) {
+    _properties = OSDictionary::withCapacity(8);
+  }
+  return _properties->setObject(key, object);
+}
+
+bool IORegistryEntry::setProperty(const char *key, UInt64 value, UInt32 numberOfBits) {
+  OSNumber  *number;
+  bool      result;
+
+  number = OSNumber::withNumber(value, numberOfBits);
+  result = setProperty(key, number);
+  number->release();
+  return result;
+}
+
+bool IORegistryEntry::setProperty(const char *key, const char *string) {
+  OSString  *value;
+  bool      result;
+
+  value  = OSString::withCString(string);
+  result = setProperty(key, value);
+  value->release();
+  return result;
+}
+
+bool IORegistryEntry::setProperty(const char *key, bool value) {
+  return setProperty(key, value ? 1 : 0, 8);
+}
+
+IOService::IOService(void) {
+  _provider = NULL;
+  bzero(_deviceMemory, sizeof (_deviceMemory));
+  bzero(_deviceMemoryLength, sizeof (_deviceMemoryLength));
+  bzero(_interrupts, sizeof (_interrupts));
+}
+
+IOReturn IOService::callPlatformFunction(const char *functionName, bool waitForFunction,
+                                         void *param1, void *param2, void *param3, void *param4) {
+  const OSSymbol  *functionSymbol;
+  IOReturn        status;
+
+  functionSymbol = OSSymbol::withCString(functionName);
+  status = callPlatformFunction(functionSymbol, waitForFunction, param1, param2, param3, param4);
+  ((OSObject *) functionSymbol)->release();
+  return status;
+}
+
+//
+// Service notifications.
+//
+#define kWiiHostMaxNotifiers  8
+
+class HostNotifier : public IONotifier {
+  OSDeclareDefaultStructors(HostNotifier);
+
+public:
+  char                          name[64];
+  IOServiceNotificationHandler  handler;
+  void                          *target;
+  void                          *refCon;
+  bool                          removed;
+
+  virtual void remove(void) {
+    removed = true;
+  }
+};
+
+#define kWiiHostMaxPublished  16
+
+struct HostPublishedService {
+  IOService   *service;
+  const char  *name;
+};
+
+const OSSymbol              *gIOPublishNotification = OSSymbol::withCString("IOServicePublish");
+static HostNotifier         *gHostNotifiers[kWiiHostMaxNotifiers];
+static pthread_mutex_t      gHostPublishedMutex = PTHREAD_MUTEX_INITIALIZER;
+static HostPublishedService gHostPublished[kWiiHostMaxPublished];
+static UInt32               gHostPublishedCount;
+static IOPlatformExpert     *gHostPlatform;
+
+IOPlatformExpert *IOService::getPlatform(void) {
+  return gHostPlatform;
+}
+
+void IOService::hostSetPlatform(IOPlatformExpert *platform) {
+  gHostPlatform = platform;
+}
+
+//
+// Finds the most recently published service with a name, polling until the timeout.
+//
+IOService *IOService::waitForService(OSDictionary *matching, mach_timespec_t *timeout) {
+  OSSymbol  *name;
+  IOService *service;
+  UInt64    waitedUS;
+  UInt64    timeoutUS;
+
+  name      = OSDynamicCast(OSSymbol, matching->getObject("IONameMatch"));
+  service   = NULL;
+  timeoutUS = (timeout != NULL) ? ((((UInt64) timeout->tv_sec) * 1000000ULL) + (timeout->tv_nsec / 1000)) : ~0ULL;
+  for (waitedUS = 0; (service == NULL) && (name != NULL); waitedUS += 1000) {
+    pthread_mutex_lock(&gHostPublishedMutex);
+    for (UInt32 i = gHostPublishedCount; i > 0; i--) {
+      if (strcmp(gHostPublished[i - 1].name, name->getCStringNoCopy()) == 0) {
+        service = gHostPublished[i - 1].service;
+        break;
+      }
+    }
+    pthread_mutex_unlock(&gHostPublishedMutex);
+
+    if ((service == NULL) && (waitedUS >= timeoutUS)) {
+      break;
+    }
+    if (service == NULL) {
+      usleep(1000);
+    }
+  }
+
+  matching->release();
+  return service;
+}
+
+OSDictionary *IOService::nameMatching(const char *name) {
+  OSDictionary *matching;
+
+  matching = OSDictionary::withCapacity(1);
+  matching->setObject("IONameMatch", (const OSObject *) OSSymbol::withCString(name));
+  return matching;
+}
+
+IONotifier *IOService::addNotification(const OSSymbol *type, OSDictionary *matching, IOServiceNotificationHandler handler,
+                                       void *target, void *refCon, SInt32 priority) {
+  HostNotifier  *notifier;
+  OSSymbol      *name;
+
+  name = OSDynamicCast(OSSymbol, matching->getObject("IONameMatch"));
+  for (UInt32 i = 0; i < kWiiHostMaxNotifiers; i++) {
+    if ((gHostNotifiers[i] == NULL) || gHostNotifiers[i]->removed) {
+      if (gHostNotifiers[i] != NULL) {
+        gHostNotifiers[i]->release();
+      }
+      notifier = new HostNotifier;
+      strncpy(notifier->name, (name != NULL) ? name->getCStringNoCopy() : "", sizeof (notifier->name) - 1);
+      notifier->handler = handler;
+      notifier->target  = target;
+      notifier->refCon  = refCon;
+      notifier->removed = false;
+      gHostNotifiers[i] = notifier;
+      matching->release();
+      return notifier;
+    }
+  }
+  matching->release();
+  return NULL;
+}
+
+void IOService::hostPublishService(IOService *service, const char *name) {
+  pthread_mutex_lock(&gHostPublishedMutex);
+  if (gHostPublishedCount < kWiiHostMaxPublished) {
+    gHostPublished[gHostPublishedCount].service = service;
+    gHostPublished[gHostPublishedCount].name    = name;
+    gHostPublishedCount++;
+  }
+  pthread_mutex_unlock(&gHostPublishedMutex);
+
+  for (UInt32 i = 0; i < kWiiHostMaxNotifiers; i++) {
+    if ((gHostNotifiers[i] != NULL) && !gHostNotifiers[i]->removed && (strcmp(gHostNotifiers[i]->name, name) == 0)) {
+      gHostNotifiers[i]->handler(gHostNotifiers[i]->target, gHostNotifiers[i]->refCon, service);
+    }
+  }
+}
+
+IOMemoryMap *IOService::mapDeviceMemoryWithIndex(unsigned int index, IOOptionBits options) {
+  if ((index >= kWiiHostMaxDeviceMemory) || (_deviceMemory[index] == NULL)) {
+    return NULL;
+  }
+  return IOMemoryMap::withAddress(_deviceMemory[index], _deviceMemoryLength[index]);
+}
+
+IOReturn IOService::registerInterrupt(int source, OSObject *target, IOInterruptAction handler, void *refCon) {
+  if ((source < 0) || (source >= kWiiHostMaxInterrupts) || (_interrupts[source].handler != NULL)) {
+    return kIOReturnNoInterrupt;
+  }
+  _interrupts[source].target  = target;
+  _interrupts[source].handler = handler;
+  _interrupts[source].refCon  = refCon;
+  _interrupts[source].enabled = false;
+  return kIOReturnSuccess;
+}
+
+IOReturn IOService::unregisterInterrupt(int source) {
+  if ((source < 0) || (source >= kWiiHostMaxInterrupts)) {
+    return kIOReturnNoInterrupt;
+  }
+  bzero(&_interrupts[source], sizeof (_interrupts[source]));
+  return kIOReturnSuccess;
+}
+
+IOReturn IOService::enableInterrupt(int source) {
+  if ((source < 0) || (source >= kWiiHostMaxInterrupts) || (_interrupts[source].handler == NULL)) {
+    return kIOReturnNoInterrupt;
+  }
+  _interrupts[source].enabled = true;
+  return kIOReturnSuccess;
+}
+
+IOReturn IOService::disableInterrupt(int source) {
+  if ((source < 0) || (source >= kWiiHostMaxInterrupts) || (_interrupts[source].handler == NULL)) {
+    return kIOReturnNoInterrupt;
+  }
+  _interrupts[source].enabled = false;
+  return kIOReturnSuccess;
+}
+
+void IOService::hostSetDeviceMemory(unsigned int index, void *address, IOByteCount length) {
+  _deviceMemory[index]       = address;
+  _deviceMemoryLength[index] = length;
+}
+
+bool IOService::hostRaiseInterrupt(int source) {
+  HostInterrupt *interrupt;
+
+  interrupt = &_interrupts[source];
+  if (!interrupt->enabled || (interrupt->handler == NULL)) {
+    return false;
+  }
+
+  //
+  // Primary interrupt handlers run with interrupts disabled.
+  //
+  boolean_t intsEnabled = ml_set_interrupts_enabled(false);
+  interrupt->handler(interrupt->target, interrupt->refCon, this, source);
+  ml_set_interrupts_enabled(intsEnabled);
+  return true;
+}
+
+//
+// Memory.
+//
+IOReturn IOSetProcessorCacheMode(task_t task, IOVirtualAddress address, IOByteCount length, IOOptionBits cacheMode) {
+  return kIOReturnSuccess;
+}
+
+IOMemoryMap *IOMemoryMap::withAddress(void *address, IOByteCount length, IOOptionBits options) {
+  IOMemoryMap *map;
+
+  map = new IOMemoryMap;
+  map->_address  = (IOVirtualAddress) address;
+  map->_physAddr = hostVirtToPhys(address);
+  map->_length   = length;
+  map->_options  = options;
+  return map;
+}
+
+IOMemoryDescriptor *IOMemoryDescriptor::withAddress(void *address, IOByteCount length, IODirection direction) {
+  IOMemoryDescriptor *desc;
+
+  desc = new IOMemoryDescriptor;
+  desc->_bytes     = (UInt8 *) address;
+  desc->_length    = length;
+  desc->_direction = direction;
+  desc->_physAddr  = hostVirtToPhys(address);
+  if (desc->_physAddr == 0) {
+    desc->_physAddr = hostMapPhysical(address, length);
+  }
+  return desc;
+}
+
+IOMemoryDescriptor *IOMemoryDescriptor::withPhysicalAddress(IOPhysicalAddress address, IOByteCount length,
+                                                            IODirection direction) {
+  IOMemoryDescriptor *desc;
+
+  desc = new IOMemoryDescriptor;
+  desc->_bytes     = (UInt8 *) hostPhysToVirt(address);
+  desc->_length    = length;
+  desc->_direction = direction;
+  desc->_physAddr  = address;
+  if (desc->_bytes == NULL) {
+    desc->release();
+    return NULL;
+  }
+  return desc;
+}
+
+IOMemoryDescriptor *IOMemoryDescriptor::withSubRange(IOMemoryDescriptor *of, IOByteCount offset, IOByteCount length,
+                                                     IODirection direction) {
+  IOMemoryDescriptor *desc;
+
+  if ((offset + length) > of->_length) {
+    return NULL;
+  }
+
+  desc = new IOMemoryDescriptor;
+  desc->_bytes     = of->_bytes + offset;
+  desc->_length    = length;
+  desc->_direction = direction;
+  desc->_physAddr  = of->_physAddr + offset;
+  desc->_parent    = of;
+  of->retain();
+  return desc;
+}
+
+IOMemoryMap *IOMemoryDescriptor::map(IOOptionBits options) {
+  return IOMemoryMap::withAddress(_bytes, _length, options);
+}
+
+void IOMemoryDescriptor::free(void) {
+  OSSafeReleaseNULL(_parent);
+  OSObject::free();
+}
+
+IOPhysicalAddress IOMemoryDescriptor::getPhysicalSegment(IOByteCount offset, IOByteCount *length) {
+  if (offset >= _length) {
+    if (length != NULL) {
+      *length = 0;
+    }
+    return 0;
+  }
+
+  if (length != NULL) {
+    *length = _length - offset;
+  }
+  return hostVirtToPhys(_bytes + offset);
+}
+
+IOByteCount IOMemoryDescriptor::readBytes(IOByteCount offset, void *bytes, IOByteCount length) {
+  if (offset >= _length) {
+    return 0;
+  }
+  if (length > (_length - offset)) {
+    length = _length - offset;
+  }
+  memcpy(bytes, _bytes + offset, length);
+  return length;
+}
+
+IOByteCount IOMemoryDescriptor::writeBytes(IOByteCount offset, const void *bytes, IOByteCount length) {
+  if (offset >= _length) {
+    return 0;
+  }
+  if (length > (_length - offset)) {
+    length = _length - offset;
+  }
+  memcpy(_bytes + offset, bytes, length);
+  return length;
+}
+
+IOBufferMemoryDescriptor *IOBufferMemoryDescriptor::withOptions(IOOptionBits options, vm_size_t capacity, vm_offset_t alignment) {
+  IOBufferMemoryDescriptor  *desc;
+  void                      *bytes;
+
+  if (alignment < sizeof (void *)) {
+    alignment = sizeof (void *);
+  }
+  if (posix_memalign(&bytes, alignment, capacity) != 0) {
+    return NULL;
+  }
+
+  desc = new IOBufferMemoryDescriptor;
+  desc->_bytes     = (UInt8 *) bytes;
+  desc->_length    = capacity;
+  desc->_capacity  = capacity;
+  desc->_direction = kIODirectionOutIn;
+  desc->_physAddr  = hostMapPhysical(bytes, capacity);
+  return desc;
+}
+
+IOBufferMemoryDescriptor *IOBufferMemoryDescriptor::withCapacity(vm_size_t capacity, IODirection direction, bool contiguous) {
+  IOBufferMemoryDescriptor *desc;
+
+  desc = withOptions(contiguous ? kIOMemoryPhysicallyContiguous : 0, capacity, contiguous ? capacity : 1);
+  if (desc != NULL) {
+    desc->_direction = direction;
+  }
+  return desc;
+}
+
+void IOBufferMemoryDescriptor::free(void) {
+  hostUnmapPhysical(_bytes);
+  ::free(_bytes);
+  IOMemoryDescriptor::free();
+}
+
+//
+// Work loops.
+//
+void IOEventSource::signalWorkAvailable(void) {
+  if (workLoop != NULL) {
+    workLoop->signalWorkAvailable();
+  }
+}
+
+IOWorkLoop *IOWorkLoop::workLoop(void) {
+  IOWorkLoop *loop;
+
+  loop = new IOWorkLoop;
+  pthread_mutex_init(&loop->_mutex, NULL);
+  pthread_cond_init(&loop->_cond, NULL);
+  loop->_gateDepth        = 0;
+  loop->_workToDo         = false;
+  loop->_terminate        = false;
+  loop->_eventSourceCount = 0;
+  loop->_sleepers         = NULL;
+  if (pthread_create(&loop->_thread, NULL, threadMain, loop) != 0) {
+    delete loop;
+    return NULL;
+  }
+  return loop;
+}
+
+void IOWorkLoop::free(void) {
+  pthread_mutex_lock(&_mutex);
+  _terminate = true;
+  pthread_cond_broadcast(&_cond);
+  pthread_mutex_unlock(&_mutex);
+  pthread_join(_thread, NULL);
+
+  for (UInt32 i = 0; i < _eventSourceCount; i++) {
+    _eventSources[i]->setWorkLoop(NULL);
+    _eventSources[i]->release();
+  }
+  pthread_cond_destroy(&_cond);
+  pthread_mutex_destroy(&_mutex);
+  OSObject::free();
+}
+
+void *IOWorkLoop::threadMain(void *param) {
+  IOWorkLoop *loop = (IOWorkLoop *) param;
+
+  pthread_mutex_lock(&loop->_mutex);
+  while (!loop->_terminate) {
+    if (!loop->_workToDo) {
+      pthread_cond_wait(&loop->_cond, &loop->_mutex);
+      continue;
+    }
+    loop->_workToDo = false;
+    pthread_mutex_unlock(&loop->_mutex);
+
+    loop->closeGate();
+    loop->runEventSources();
+    loop->openGate();
+
+    pthread_mutex_lock(&loop->_mutex);
+  }
+  pthread_mutex_unlock(&loop->_mutex);
+  return NULL;
+}
+
+//
+// Runs event sources until none have more work. Must be called with the gate closed.
+//
+void IOWorkLoop::runEventSources(void) {
+  bool moreWork;
+
+  do {
+    moreWork = false;
+    for (UInt32 i = 0; i < _eventSourceCount; i++) {
+      if (_eventSources[i]->isEnabled() && _eventSources[i]->checkForWork()) {
+        moreWork = true;
+      }
+    }
+  } while (moreWork);
+}
+
+IOReturn IOWorkLoop::addEventSource(IOEventSource *eventSource) {
+  closeGate();
+  if (_eventSourceCount == kWiiHostMaxEventSources) {
+    openGate();
+    return kIOReturnNoResources;
+  }
+  eventSource->retain();
+  eventSource->setWorkLoop(this);
+  _eventSources[_eventSourceCount++] = eventSource;
+  openGate();
+
+  signalWorkAvailable();
+  return kIOReturnSuccess;
+}
+
+IOReturn IOWorkLoop::removeEventSource(IOEventSource *eventSource) {
+  closeGate();
+  for (UInt32 i = 0; i < _eventSourceCount; i++) {
+    if (_eventSources[i] == eventSource) {
+      memmove(&_eventSources[i], &_eventSources[i + 1], (_eventSourceCount - i - 1) * sizeof (IOEventSource *));
+      _eventSourceCount--;
+      eventSource->setWorkLoop(NULL);
+      eventSource->release();
+      break;
+    }
+  }
+  openGate();
+  return kIOReturnSuccess;
+}
+
+void IOWorkLoop::signalWorkAvailable(void) {
+  pthread_mutex_lock(&_mutex);
+  _workToDo = true;
+  pthread_cond_broadcast(&_cond);
+  pthread_mutex_unlock(&_mutex);
+}
+
+void IOWorkLoop::closeGate(void) {
+  pthread_mutex_lock(&_mutex);
+  while ((_gateDepth != 0) && !pthread_equal(_gateOwner, pthread_self())) {
+    pthread_cond_wait(&_cond, &_mutex);
+  }
+  _gateOwner = pthread_self();
+  _gateDepth++;
+  pthread_mutex_unlock(&_mutex);
+}
+
+void IOWorkLoop::openGate(void) {
+  pthread_mutex_lock(&_mutex);
+  _gateDepth--;
+  if (_gateDepth == 0) {
+    pthread_cond_broadcast(&_cond);
+  }
+  pthread_mutex_unlock(&_mutex);
+}
+
+bool IOWorkLoop::inGate(void) {
+  bool result;
+
+  pthread_mutex_lock(&_mutex);
+  result = (_gateDepth != 0) && pthread_equal(_gateOwner, pthread_self());
+  pthread_mutex_unlock(&_mutex);
+  return result;
+}
+
+//
+// Releases the gate entirely while sleeping, and reacquires it to the same depth.
+//
+int IOWorkLoop::sleepGate(void *event, UInt32 interruptibleType) {
+  HostSleeper   sleeper;
+  HostSleeper   **sleeperPtr;
+  UInt32        depth;
+
+  pthread_mutex_lock(&_mutex);
+  sleeper.event = event;
+  sleeper.woken = false;
+  sleeper.next  = _sleepers;
+  _sleepers     = &sleeper;
+
+  depth      = _gateDepth;
+  _gateDepth = 0;
+  pthread_cond_broadcast(&_cond);
+
+  while (!sleeper.woken) {
+    pthread_cond_wait(&_cond, &_mutex);
+  }
+  for (sleeperPtr = &_sleepers; *sleeperPtr != &sleeper; sleeperPtr = &(*sleeperPtr)->next);
+  *sleeperPtr = sleeper.next;
+
+  while (_gateDepth != 0) {
+    pthread_cond_wait(&_cond, &_mutex);
+  }
+  _gateOwner = pthread_self();
+  _gateDepth = depth;
+  pthread_mutex_unlock(&_mutex);
+  return THREAD_AWAKENED;
+}
+
+void IOWorkLoop::wakeupGate(void *event, bool oneThread) {
+  HostSleeper *sleeper;
+
+  pthread_mutex_lock(&_mutex);
+  for (sleeper = _sleepers; sleeper != NULL; sleeper = sleeper->next) {
+    if ((sleeper->event == event) && !sleeper->woken) {
+      sleeper->woken = true;
+      if (oneThread) {
+        break;
+      }
+    }
+  }
+  pthread_cond_broadcast(&_cond);
+  pthread_mutex_unlock(&_mutex);
+}
+
+IOReturn IOWorkLoop::runAction(Action action, OSObject *target, void *arg0, void *arg1, void *arg2, void *arg3) {
+  IOReturn status;
+
+  closeGate();
+  status = action(target, arg0, arg1, arg2, arg3);
+  openGate();
+  return status;
+}
+
+//
+// Interrupt event sources.
+//
+IOInterruptEventSource *IOInterruptEventSource::interruptEventSource(OSObject *owner, Action action,
+                                                                     IOService *provider, int intIndex) {
+  IOInterruptEventSource *eventSource;
+
+  eventSource = new IOInterruptEventSource;
+  if (!eventSource->init(owner, action, provider, intIndex)) {
+    eventSource->release();
+    return NULL;
+  }
+  return eventSource;
+}
+
+bool IOInterruptEventSource::init(OSObject *inOwner, Action inAction, IOService *inProvider, int inIntIndex) {
+  if (!IOEventSource::init(inOwner)) {
+    return false;
+  }
+
+  action        = inAction;
+  provider      = inProvider;
+  intIndex      = inIntIndex;
+  producerCount = 0;
+  consumerCount = 0;
+  if (provider != NULL) {
+    return provider->registerInterrupt(intIndex, this, handleInterrupt) == kIOReturnSuccess;
+  }
+  return true;
+}
+
+void IOInterruptEventSource::free(void) {
+  if (provider != NULL) {
+    provider->unregisterInterrupt(intIndex);
+  }
+  IOEventSource::free();
+}
+
+void IOInterruptEventSource::enable(void) {
+  if (provider != NULL) {
+    provider->enableInterrupt(intIndex);
+  }
+  IOEventSource::enable();
+}
+
+void IOInterruptEventSource::disable(void) {
+  if (provider != NULL) {
+    provider->disableInterrupt(intIndex);
+  }
+  IOEventSource::disable();
+}
+
+void IOInterruptEventSource::handleInterrupt(OSObject *target, void *refCon, IOService *nub, int source) {
+  ((IOInterruptEventSource *) target)->interruptOccurred(refCon, nub, source);
+}
+
+void IOInterruptEventSource::interruptOccurred(void *refCon, IOService *nub, int source) {
+  __sync_fetch_and_add(&producerCount, 1);
+  signalWorkAvailable();
+}
+
+bool IOInterruptEventSource::checkForWork(void) {
+  UInt32 count;
+
+  count = producerCount;
+  if (count != consumerCount) {
+    action(owner, this, (int) (count - consumerCount));
+    consumerCount = count;
+  }
+  return false;
+}
+
+//
+// Filter interrupt event sources, the filter runs in the primary interrupt handler.
+//
+IOFilterInterruptEventSource *IOFilterInterruptEventSource::filterInterruptEventSource(OSObject *owner, Action action,
+                                                                                       Filter filter, IOService *provider,
+                                                                                       int intIndex) {
+  IOFilterInterruptEventSource *eventSource;
+
+  eventSource = new IOFilterInterruptEventSource;
+  if (!eventSource->init(owner, action, provider, intIndex)) {
+    eventSource->release();
+    return NULL;
+  }
+  eventSource->filterAction = filter;
+  return eventSource;
+}
+
+void IOFilterInterruptEventSource::signalInterrupt(void) {
+  __sync_fetch_and_add(&producerCount, 1);
+  signalWorkAvailable();
+}
+
+void IOFilterInterruptEventSource::interruptOccurred(void *refCon, IOService *nub, int source) {
+  if (filterAction(owner, this)) {
+    signalInterrupt();
+  }
+}
+
+//
+// Timer event sources.
+//
+IOTimerEventSource *IOTimerEventSource::timerEventSource(OSObject *owner, Action action) {
+  IOTimerEventSource *eventSource;
+
+  eventSource = new IOTimerEventSource;
+  eventSource->init(owner);
+  eventSource->action       = action;
+  eventSource->calloutEntry = thread_call_allocate(timeoutCallout, eventSource);
+  eventSource->enabled      = true;
+  return eventSource;
+}
+
+void IOTimerEventSource::free(void) {
+  thread_call_free(calloutEntry);
+  IOEventSource::free();
+}
+
+void IOTimerEventSource::timeoutCallout(thread_call_param_t param0, thread_call_param_t param1) {
+  IOTimerEventSource *eventSource = (IOTimerEventSource *) param0;
+
+  eventSource->timerFired = true;
+  eventSource->signalWorkAvailable();
+}
+
+bool IOTimerEventSource::checkForWork(void) {
+  if (timerFired) {
+    timerFired = false;
+    action(owner, this);
+  }
+  return false;
+}
+
+IOReturn IOTimerEventSource::setTimeoutMS(UInt32 milliseconds) {
+  AbsoluteTime deadline;
+
+  clock_interval_to_deadline(milliseconds, kMillisecondScale, &deadline);
+  thread_call_enter_delayed(calloutEntry, deadline);
+  return kIOReturnSuccess;
+}
+
+void IOTimerEventSource::cancelTimeout(void) {
+  thread_call_cancel(calloutEntry);
+  timerFired = false;
+}
+
+//
+// Command gates.
+//
+IOCommandGate *IOCommandGate::commandGate(OSObject *owner, Action action) {
+  IOCommandGate *gate;
+
+  gate = new IOCommandGate;
+  gate->init(owner);
+  gate->action  = action;
+  gate->enabled = true;
+  return gate;
+}
+
+IOReturn IOCommandGate::runAction(Action inAction, void *arg0, void *arg1, void *arg2, void *arg3) {
+  IOReturn status;
+
+  if ((inAction == NULL) || (workLoop == NULL)) {
+    return kIOReturnBadArgument;
+  }
+
+  workLoop->closeGate();
+  status = inAction(owner, arg0, arg1, arg2, arg3);
+  workLoop->openGate();
+  return status;
+}
+
+IOReturn IOCommandGate::commandSleep(void *event, UInt32 interruptible) {
+  if ((workLoop == NULL) || !workLoop->inGate()) {
+    return kIOReturnNotPermitted;
+  }
+  return (workLoop->sleepGate(event, interruptible) == THREAD_AWAKENED) ? kIOReturnSuccess : kIOReturnAborted;
+}
+
+void IOCommandGate::commandWakeup(void *event, bool oneThread) {
+  if (workLoop != NULL) {
+    workLoop->wakeupGate(event, oneThread);
+  }
+}
+
+//
+// Range allocator.
+//
+IORangeAllocator *IORangeAllocator::withRange(UInt32 endOfRange, UInt32 defaultElementSize, UInt32 capacity,
+                                              IOOptionBits options) {
+  IORangeAllocator *allocator;
+
+  allocator = new IORangeAllocator;
+  allocator->_fragmentCount = 0;
+  if (endOfRange != 0) {
+    allocator->deallocate(0, endOfRange);
+  }
+  return allocator;
+}
+
+void IORangeAllocator::insertFragment(UInt32 index, UInt32 start, UInt32 end) {
+  memmove(&_fragments[index + 1], &_fragments[index], (_fragmentCount - index) * sizeof (Fragment));
+  _fragments[index].start = start;
+  _fragments[index].end   = end;
+  _fragmentCount++;
+}
+
+void IORangeAllocator::removeFragment(UInt32 index) {
+  memmove(&_fragments[index], &_fragments[index + 1], (_fragmentCount - index - 1) * sizeof (Fragment));
+  _fragmentCount--;
+}
+
+bool IORangeAllocator::allocate(UInt32 size, UInt32 *result, UInt32 alignment) {
+  UInt32 start;
+
+  if (alignment == 0) {
+    alignment = 1;
+  }
+  for (UInt32 i = 0; i < _fragmentCount; i++) {
+    start = (_fragments[i].start + alignment - 1) & ~(alignment - 1);
+    if ((start < _fragments[i].start) || ((start + size) > _fragments[i].end) || ((start + size) < start)) {
+      continue;
+    }
+
+    if ((start + size) < _fragments[i].end) {
+      if (_fragmentCount == kWiiHostMaxRangeFragments) {
+        return false;
+      }
+      insertFragment(i + 1, start + size, _fragments[i].end);
+    }
+    if (start > _fragments[i].start) {
+      _fragments[i].end = start;
+    } else {
+      removeFragment(i);
+    }
+    *result = start;
+    return true;
+  }
+  return false;
+}
+
+void IORangeAllocator::deallocate(UInt32 start, UInt32 size) {
+  UInt32 end;
+  UInt32 index;
+
+  end = start + size;
+  for (index = 0; (index < _fragmentCount) && (_fragments[index].start < start); index++);
+
+  if ((index > 0) && (_fragments[index - 1].end == start)) {
+    _fragments[index - 1].end = end;
+    if ((index < _fragmentCount) && (_fragments[index].start == end)) {
+      _fragments[index - 1].end = _fragments[index].end;
+      removeFragment(index);
+    }
+  } else if ((index < _fragmentCount) && (_fragments[index].start == end)) {
+    _fragments[index].start = start;
+  } else if (_fragmentCount < kWiiHostMaxRangeFragments) {
+    insertFragment(index, start, end);
+  }
+}
+
+UInt32 IORangeAllocator::getFreeCount(void) {
+  UInt32 count;
+
+  count = 0;
+  for (UInt32 i = 0; i < _fragmentCount; i++) {
+    count += _fragments[i].end - _fragments[i].start;
+  }
+  return count;
+}
@@ -0,0 +1,1106 @@
+//
+//  HostKernel.h
+//  Host stand-ins for the kernel and I/O Kit interfaces used by the code under test
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  Only what the tested headers and sources use is provided. Functions that are declared but defined in
+//  neither this file nor HostKernel.cpp are referenced by inline code the tests do not call, and fail to
+//  link if they are.
+//
+//  Device registers are emulated by registering a HostDevice for a range of addresses, big and little
+//  endian register accesses within the range are passed to the device. Physical addresses are emulated
+//  by assigning fake 32-bit addresses to host memory with hostMapPhysical().
+//
+
+#ifndef HostKernel_h
+#define HostKernel_h
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+//
+// Basic types, sized as on the 32-bit PowerPC kernel where it matters.
+//
+typedef uint8_t   UInt8;
+typedef uint16_t  UInt16;
+typedef uint32_t  UInt32;
+typedef uint64_t  UInt64;
+typedef int8_t    SInt8;
+typedef int16_t   SInt16;
+typedef int32_t   SInt32;
+typedef int64_t   SInt64;
+
+typedef uintptr_t vm_offset_t;
+typedef uintptr_t vm_address_t;
+typedef uintptr_t vm_size_t;
+typedef int       boolean_t;
+typedef int       kern_return_t;
+typedef void      *task_t;
+typedef UInt32    IOByteCount;
+typedef UInt32    IOPhysicalAddress;
+typedef uintptr_t IOVirtualAddress;
+typedef UInt32    IOOptionBits;
+typedef UInt64    AbsoluteTime;
+typedef SInt32    IOReturn;
+typedef int       IOInterruptState;
+
+typedef struct {
+  unsigned int  tv_sec;
+  int           tv_nsec;
+} mach_timespec_t;
+
+#define KERN_SUCCESS  0
+#define KERN_FAILURE  5
+
+#ifndef PAGE_SIZE
+#define PAGE_SIZE     4096
+#endif
+#ifndef PAGE_MASK
+#define PAGE_MASK     (PAGE_SIZE - 1)
+#endif
+
+#define __MAC_10_0                          1000
+#define __MAC_10_1                          1010
+#define __MAC_10_2                          1020
+#define __MAC_10_3                          1030
+#define __MAC_10_4                          1040
+#define __MAC_OS_X_VERSION_MIN_REQUIRED     __MAC_10_4
+
+#define THREAD_UNINT          0
+#define THREAD_INTERRUPTIBLE  1
+#define THREAD_ABORTSAFE      2
+#define THREAD_AWAKENED       0
+#define THREAD_TIMED_OUT      1
+#define THREAD_INTERRUPTED    2
+
+//
+// Error codes are signed as IOReturn is, so they compare with IOReturn values without sign warnings.
+//
+#define iokit_common_err(return)  ((IOReturn) (0xe0000000 | (return)))
+#define kIOReturnSuccess          0
+#define kIOReturnError            iokit_common_err(0x2bc)
+#define kIOReturnNoMemory         iokit_common_err(0x2bd)
+#define kIOReturnNoResources      iokit_common_err(0x2be)
+#define kIOReturnNoDevice         iokit_common_err(0x2c0)
+#define kIOReturnNotPrivileged    iokit_common_err(0x2c1)
+#define kIOReturnBadArgument      iokit_common_err(0x2c2)
+#define kIOReturnExclusiveAccess  iokit_common_err(0x2c5)
+#define kIOReturnUnsupported      iokit_common_err(0x2c7)
+#define kIOReturnInternalError    iokit_common_err(0x2c9)
+#define kIOReturnIOError          iokit_common_err(0x2ca)
+#define kIOReturnNotOpen          iokit_common_err(0x2cd)
+#define kIOReturnNotAligned       iokit_common_err(0x2d0)
+#define kIOReturnDMAError         iokit_common_err(0x2d4)
+#define kIOReturnBusy             iokit_common_err(0x2d5)
+#define kIOReturnTimeout          iokit_common_err(0x2d6)
+#define kIOReturnNotReady         iokit_common_err(0x2d8)
+#define kIOReturnNoSpace          iokit_common_err(0x2db)
+#define kIOReturnNoInterrupt      iokit_common_err(0x2df)
+#define kIOReturnNotPermitted     iokit_common_err(0x2e2)
+#define kIOReturnNoBandwidth      iokit_common_err(0x2e6)
+#define kIOReturnUnderrun         iokit_common_err(0x2e7)
+#define kIOReturnOverrun          iokit_common_err(0x2e8)
+#define kIOReturnIsoTooOld        iokit_common_err(0x2e9)
+#define kIOReturnIsoTooNew        iokit_common_err(0x2ea)
+#define kIOReturnNotResponding    iokit_common_err(0x2ed)
+#define kIOReturnAborted          iokit_common_err(0x2eb)
+#define kIOReturnNotFound         iokit_common_err(0x2f0)
+
+//
+// Library functions.
+//
+void IOLog(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+//
+// Host only, enables or disables IOLog() output for tests that log heavily.
+//
+void hostSetLogOutput(bool enabled);
+
+inline void *IOMalloc(vm_size_t size) {
+  return malloc(size);
+}
+inline void IOFree(void *address, vm_size_t size) {
+  free(address);
+}
+inline void *IOMallocAligned(vm_size_t size, vm_size_t alignment) {
+  void *address;
+  return (posix_memalign(&address, alignment, size) == 0) ? address : NULL;
+}
+inline void IOFreeAligned(void *address, vm_size_t size) {
+  free(address);
+}
+//
+// Contiguous allocations are page aligned and given a physical address, as with hostMapPhysical().
+//
+void *IOMallocContiguous(vm_size_t size, vm_size_t alignment, IOPhysicalAddress *physicalAddress);
+void IOFreeContiguous(void *address, vm_size_t size);
+//
+// Spins like the kernel's, sleeping would take far longer than short delays ask for.
+//
+inline void IODelay(UInt32 microseconds) {
+  struct timespec start;
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  do {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  } while ((((now.tv_sec - start.tv_sec) * 1000000000LL) + (now.tv_nsec - start.tv_nsec)) < (microseconds * 1000LL));
+}
+inline void IOSleep(UInt32 milliseconds) {
+  usleep(milliseconds * 1000);
+}
+
+int PE_parse_boot_arg(const char *name, void *value);
+
+//
+// Host only, sets or clears a flag boot argument found by PE_parse_boot_arg().
+//
+void hostSetBootArgument(const char *name, bool present);
+
+void flush_dcache(vm_offset_t address, unsigned count, boolean_t phys);
+void invalidate_dcache(vm_offset_t address, unsigned count, boolean_t phys);
+
+//
+// Host only, gets the range of the last data cache flush.
+//
+void hostGetLastDataCacheFlush(vm_offset_t *address, unsigned *count);
+
+//
+// Host only, checks cache handoffs of memory shared with a device, which host memory does not need.
+//
+// While enabled, a flush records each line as the device would see it in memory. A device reading the memory
+// fails the check if the CPU changed it after the last flush. A device writing the memory leaves the lines to be
+// invalidated, flushing them first would have written stale CPU data over the device's update.
+//
+#define kHostDataCacheLineSize  32
+
+typedef struct {
+  // Device reads of lines not flushed since the CPU last changed them.
+  UInt32  staleReads;
+  // Flushes of lines the device wrote that were not invalidated first.
+  UInt32  lostWrites;
+  // Lines the device wrote that are not invalidated yet.
+  UInt32  pendingWrites;
+  UInt32  flushes;
+  UInt32  invalidates;
+} HostDataCacheStats;
+
+void hostSetDataCacheChecks(bool enabled);
+void hostGetDataCacheStats(HostDataCacheStats *stats);
+void hostCheckDeviceRead(const volatile void *address, UInt32 length);
+void hostDeviceWrote(const volatile void *address, UInt32 length);
+
+//
+// Processor state. Interrupts are per host thread, and only tracked for code that checks them.
+//
+boolean_t ml_set_interrupts_enabled(boolean_t enable);
+boolean_t ml_get_interrupts_enabled(void);
+UInt32 hostGetProcessorPVR(void);
+void hostSetProcessorPVR(UInt32 pvr);
+
+//
+// Host only, special purpose registers without a stand-in of their own go to a device set by the test, at the
+// register number as the offset. Reads return zero and writes are dropped while there is none.
+//
+class HostDevice;
+void hostSetSPRDevice(HostDevice *device);
+UInt32 hostReadSPR(UInt32 spr);
+void hostWriteSPR(UInt32 spr, UInt32 value);
+
+//
+// Host only, stands in for the processor timebase, counting in nanoseconds.
+//
+UInt64 hostGetProcessorTimebase(void);
+
+//
+// Processor clock rates, the timebase of hostGetProcessorTimebase() counts at the decrementer rate.
+//
+struct clock_frequency_info_t {
+  unsigned long bus_clock_rate_hz;
+  unsigned long cpu_clock_rate_hz;
+  unsigned long dec_clock_rate_hz;
+};
+extern clock_frequency_info_t gPEClockFrequencyInfo;
+
+//
+// CPU number is per host thread, set by tests simulating multiple cores.
+//
+int cpu_number(void);
+void hostSetCPUNumber(int cpu);
+
+#define kPEHaltCPU      0
+#define kPERestartCPU   1
+extern int (*PE_halt_restart)(unsigned int type);
+
+//
+// Locks.
+//
+typedef struct IOLock IOLock;
+typedef struct IOSimpleLock IOSimpleLock;
+
+IOLock *IOLockAlloc(void);
+void IOLockFree(IOLock *lock);
+void IOLockLock(IOLock *lock);
+void IOLockUnlock(IOLock *lock);
+inline void IOTakeLock(IOLock *lock) {
+  IOLockLock(lock);
+}
+inline void IOUnlock(IOLock *lock) {
+  IOLockUnlock(lock);
+}
+IOSimpleLock *IOSimpleLockAlloc(void);
+void IOSimpleLockFree(IOSimpleLock *lock);
+void IOSimpleLockLock(IOSimpleLock *lock);
+void IOSimpleLockUnlock(IOSimpleLock *lock);
+IOInterruptState IOSimpleLockLockDisableInterrupt(IOSimpleLock *lock);
+void IOSimpleLockUnlockEnableInterrupt(IOSimpleLock *lock, IOInterruptState state);
+
+//
+// Time, absolute time is in nanoseconds.
+//
+enum {
+  kNanosecondScale  = 1,
+  kMicrosecondScale = 1000,
+  kMillisecondScale = 1000 * 1000,
+  kSecondScale      = 1000 * 1000 * 1000
+};
+
+#define CMP_ABSOLUTETIME(t1, t2)  ((*(t1) > *(t2)) ? 1 : ((*(t1) < *(t2)) ? -1 : 0))
+
+void clock_get_uptime(AbsoluteTime *result);
+void clock_interval_to_deadline(UInt32 interval, UInt32 scaleFactor, AbsoluteTime *result);
+inline void absolutetime_to_nanoseconds(AbsoluteTime abstime, UInt64 *result) {
+  *result = abstime;
+}
+inline void nanoseconds_to_absolutetime(UInt64 nanoseconds, AbsoluteTime *result) {
+  *result = nanoseconds;
+}
+
+//
+// Thread calls, run on a single host thread.
+//
+typedef struct thread_call *thread_call_t;
+typedef void *thread_call_param_t;
+typedef void (*thread_call_func_t)(thread_call_param_t param0, thread_call_param_t param1);
+
+thread_call_t thread_call_allocate(thread_call_func_t func, thread_call_param_t param0);
+boolean_t thread_call_free(thread_call_t call);
+boolean_t thread_call_enter(thread_call_t call);
+boolean_t thread_call_enter1(thread_call_t call, thread_call_param_t param1);
+boolean_t thread_call_enter_delayed(thread_call_t call, AbsoluteTime deadline);
+boolean_t thread_call_enter1_delayed(thread_call_t call, thread_call_param_t param1, AbsoluteTime deadline);
+boolean_t thread_call_cancel(thread_call_t call);
+
+//
+// Emulated device registers and physical memory.
+//
+class HostDevice {
+public:
+  virtual ~HostDevice(void) { }
+  virtual UInt32 readReg32(UInt32 offset) = 0;
+  virtual void writeReg32(UInt32 offset, UInt32 data) = 0;
+};
+
+extern volatile UInt32 gHostDeviceCount;
+void hostAddDevice(HostDevice *device, volatile void *base, UInt32 length);
+void hostRemoveDevice(HostDevice *device);
+HostDevice *hostFindDevice(const volatile void *address, UInt32 *offset);
+
+UInt32 hostMapPhysical(void *address, vm_size_t length);
+bool hostMapPhysicalAt(void *address, vm_size_t length, UInt32 physAddr);
+void hostUnmapPhysical(void *address);
+void *hostPhysToVirt(UInt32 physAddr);
+UInt32 hostVirtToPhys(const volatile void *address);
+
+//
+// Byte order and atomics.
+//
+inline UInt16 OSReadBigInt16(const volatile void *base, UInt32 offset) {
+  const volatile UInt8 *bytes = ((const volatile UInt8 *) base) + offset;
+  return (UInt16) ((bytes[0] << 8) | bytes[1]);
+}
+//
+// 32-bit accesses are single loads and stores as on the PowerPC, so they are not torn between threads.
+//
+inline UInt32 OSReadBigInt32(const volatile void *base, UInt32 offset) {
+  const volatile UInt8  *address = ((const volatile UInt8 *) base) + offset;
+  HostDevice            *device;
+  UInt32                deviceOffset;
+
+  if ((gHostDeviceCount != 0) && ((device = hostFindDevice(address, &deviceOffset)) != NULL)) {
+    return device->readReg32(deviceOffset);
+  }
+  return __builtin_bswap32(*((const volatile UInt32 *) address));
+}
+inline void OSWriteBigInt16(volatile void *base, UInt32 offset, UInt16 data) {
+  volatile UInt8 *bytes = ((volatile UInt8 *) base) + offset;
+  bytes[0] = (UInt8) (data >> 8);
+  bytes[1] = (UInt8) data;
+}
+inline void OSWriteBigInt32(volatile void *base, UInt32 offset, UInt32 data) {
+  volatile UInt8  *address = ((volatile UInt8 *) base) + offset;
+  HostDevice      *device;
+  UInt32          deviceOffset;
+
+  if ((gHostDeviceCount != 0) && ((device = hostFindDevice(address, &deviceOffset)) != NULL)) {
+    device->writeReg32(deviceOffset, data);
+    return;
+  }
+  *((volatile UInt32 *) address) = __builtin_bswap32(data);
+}
+inline UInt32 OSReadLittleInt32(const volatile void *base, UInt32 offset) {
+  const volatile UInt8  *address = ((const volatile UInt8 *) base) + offset;
+  HostDevice            *device;
+  UInt32                deviceOffset;
+
+  if ((gHostDeviceCount != 0) && ((device = hostFindDevice(address, &deviceOffset)) != NULL)) {
+    return device->readReg32(deviceOffset);
+  }
+  return *((const volatile UInt32 *) address);
+}
+inline void OSWriteLittleInt32(volatile void *base, UInt32 offset, UInt32 data) {
+  volatile UInt8  *address = ((volatile UInt8 *) base) + offset;
+  HostDevice      *device;
+  UInt32          deviceOffset;
+
+  if ((gHostDeviceCount != 0) && ((device = hostFindDevice(address, &deviceOffset)) != NULL)) {
+    device->writeReg32(deviceOffset, data);
+    return;
+  }
+  *((volatile UInt32 *) address) = data;
+}
+inline UInt32 OSSwapHostToBigInt32(UInt32 data) {
+  return __builtin_bswap32(data);
+}
+inline UInt32 OSSwapBigToHostInt32(UInt32 data) {
+  return __builtin_bswap32(data);
+}
+inline UInt32 OSSwapHostToLittleInt32(UInt32 data) {
+  return data;
+}
+inline UInt32 OSSwapLittleToHostInt32(UInt32 data) {
+  return data;
+}
+inline UInt16 OSSwapHostToLittleInt16(UInt16 data) {
+  return data;
+}
+inline UInt16 OSSwapLittleToHostInt16(UInt16 data) {
+  return data;
+}
+
+#define USBToHostWord   OSSwapLittleToHostInt16
+#define HostToUSBWord   OSSwapHostToLittleInt16
+#define USBToHostLong   OSSwapLittleToHostInt32
+#define HostToUSBLong   OSSwapHostToLittleInt32
+
+inline void OSSynchronizeIO(void) {
+  __sync_synchronize();
+}
+inline SInt32 OSAddAtomic(SInt32 amount, volatile SInt32 *address) {
+  return __sync_fetch_and_add(address, amount);
+}
+inline SInt32 OSIncrementAtomic(volatile SInt32 *address) {
+  return __sync_fetch_and_add(address, 1);
+}
+inline SInt32 OSDecrementAtomic(volatile SInt32 *address) {
+  return __sync_fetch_and_sub(address, 1);
+}
+inline bool OSCompareAndSwap(UInt32 oldValue, UInt32 newValue, volatile UInt32 *address) {
+  return __sync_bool_compare_and_swap(address, oldValue, newValue);
+}
+
+//
+// Processor barriers, from ppc/proc_reg.h.
+//
+inline void sync(void) {
+  __sync_synchronize();
+}
+inline void isync(void) {
+  __sync_synchronize();
+}
+inline void eieio(void) {
+  __sync_synchronize();
+}
+
+//
+// Minimal object model. Classes only need to be declared for the inline code that references them to compile.
+//
+class OSMetaClass {
+  const char *_className;
+
+public:
+  OSMetaClass(const char *className) : _className(className) { }
+  const char *getClassName(void) const {
+    return _className;
+  }
+};
+
+#define OSDeclareDefaultStructors(className) \
+  public: \
+  virtual const OSMetaClass *getMetaClass(void) const { \
+    static const OSMetaClass metaClass(#className); \
+    return &metaClass; \
+  } \
+  private:
+#define OSDefineMetaClassAndStructors(className, superclassName)
+
+class OSObject {
+  OSDeclareDefaultStructors(OSObject);
+
+  mutable int _retainCount;
+
+public:
+  //
+  // Objects are zero filled when allocated, as with the kernel's OSObject.
+  //
+  static void *operator new(size_t size) {
+    return calloc(1, size);
+  }
+  static void operator delete(void *mem, size_t size) {
+    ::free(mem);
+  }
+
+  OSObject(void) : _retainCount(1) { }
+  virtual ~OSObject(void) { }
+  virtual bool init(void) {
+    return true;
+  }
+  virtual void free(void) {
+    delete this;
+  }
+  void retain(void) const {
+    _retainCount++;
+  }
+  void release(void) const {
+    if (--_retainCount == 0) {
+      ((OSObject *) this)->free();
+    }
+  }
+};
+
+#define OSCompileAssert(expr)       static_assert(expr, #expr)
+#define OSDynamicCast(type, inst)   dynamic_cast<type *>((OSObject *) (inst))
+#define OSSafeReleaseNULL(inst)     do { if ((inst) != NULL) { (inst)->release(); } (inst) = NULL; } while (0)
+
+//
+// Member functions are called with the object as the first parameter, as with the kernel's GCC.
+//
+#define OSMemberFunctionCast(cptrtype, self, func)  ((cptrtype) ((self)->*(func)))
+
+class OSSymbol : public OSObject {
+  OSDeclareDefaultStructors(OSSymbol);
+
+  char *_string;
+
+public:
+  static const OSSymbol *withCString(const char *string);
+  virtual void free(void);
+  const char *getCStringNoCopy(void) const {
+    return _string;
+  }
+  bool isEqualTo(const char *string) const {
+    return strcmp(_string, string) == 0;
+  }
+  bool isEqualTo(const OSSymbol *symbol) const {
+    return strcmp(_string, symbol->_string) == 0;
+  }
+};
+
+class OSString : public OSObject {
+  OSDeclareDefaultStructors(OSString);
+
+  char *_string;
+
+public:
+  static OSString *withCString(const char *string);
+  virtual void free(void);
+  const char *getCStringNoCopy(void) const {
+    return _string;
+  }
+};
+
+class OSNumber : public OSObject {
+  OSDeclareDefaultStructors(OSNumber);
+
+  UInt64 _value;
+
+public:
+  static OSNumber *withNumber(UInt64 value, UInt32 numberOfBits) {
+    OSNumber *number = new OSNumber;
+    number->_value = value;
+    return number;
+  }
+  UInt32 unsigned32BitValue(void) const {
+    return (UInt32) _value;
+  }
+  UInt64 unsigned64BitValue(void) const {
+    return _value;
+  }
+};
+
+class OSData : public OSObject {
+  OSDeclareDefaultStructors(OSData);
+
+  UInt8   *_bytes;
+  UInt32  _length;
+  UInt32  _capacity;
+
+public:
+  static OSData *withCapacity(UInt32 capacity);
+  virtual void free(void);
+  UInt32 getLength(void) const {
+    return _length;
+  }
+  const void *getBytesNoCopy(void) const {
+    return _bytes;
+  }
+  bool appendBytes(const void *bytes, UInt32 length);
+};
+
+class OSArray : public OSObject {
+  OSDeclareDefaultStructors(OSArray);
+
+  OSObject  **_objects;
+  UInt32    _count;
+  UInt32    _capacity;
+
+public:
+  static OSArray *withCapacity(UInt32 capacity);
+  virtual void free(void);
+  UInt32 getCount(void) const {
+    return _count;
+  }
+  OSObject *getObject(UInt32 index) const {
+    return (index < _count) ? _objects[index] : NULL;
+  }
+  bool setObject(const OSObject *object);
+};
+
+class OSDictionary : public OSObject {
+  OSDeclareDefaultStructors(OSDictionary);
+
+  char      **_keys;
+  OSObject  **_objects;
+  UInt32    _count;
+  UInt32    _capacity;
+
+public:
+  static OSDictionary *withCapacity(UInt32 capacity);
+  virtual void free(void);
+  UInt32 getCount(void) const {
+    return _count;
+  }
+  bool setObject(const char *key, const OSObject *object);
+  bool setObject(const OSSymbol *key, const OSObject *object) {
+    return setObject(key->getCStringNoCopy(), object);
+  }
+  OSObject *getObject(const char *key) const;
+  OSObject *getObject(const OSSymbol *key) const {
+    return getObject(key->getCStringNoCopy());
+  }
+};
+
+class IORegistryEntry : public OSObject {
+  OSDeclareDefaultStructors(IORegistryEntry);
+
+  OSDictionary *_properties;
+  const char   *_name;
+
+public:
+  IORegistryEntry(void) : _properties(NULL), _name("IORegistryEntry") { }
+  virtual bool init(OSDictionary *dictionary = 0);
+  virtual void free(void);
+  const char *getName(void) const {
+    return _name;
+  }
+  void setName(const char *name) {
+    _name = name;
+  }
+  virtual OSObject *getProperty(const char *key) const;
+  virtual OSObject *getProperty(const OSSymbol *key) const {
+    return getProperty(key->getCStringNoCopy());
+  }
+  virtual bool setProperty(const char *key, OSObject *object);
+  virtual bool setProperty(const OSSymbol *key, OSObject *object) {
+    return setProperty(key->getCStringNoCopy(), object);
+  }
+  virtual bool setProperty(const char *key, UInt64 value, UInt32 numberOfBits);
+  virtual bool setProperty(const char *key, const char *string);
+  virtual bool setProperty(const char *key, bool value);
+  const char *getLocation(void) const {
+    return NULL;
+  }
+};
+
+class IOMemoryMap;
+class IOPlatformExpert;
+class IOService;
+typedef void (*IOInterruptAction)(OSObject *target, void *refCon, class IOService *nub, int source);
+
+//
+// Service notifications. Only name matching is supported, services are published by the test.
+//
+typedef bool (*IOServiceNotificationHandler)(void *target, void *refCon, IOService *newService);
+
+class IONotifier : public OSObject {
+  OSDeclareDefaultStructors(IONotifier);
+
+public:
+  virtual void remove(void) = 0;
+};
+
+extern const OSSymbol *gIOPublishNotification;
+
+extern const OSSymbol *gIOInterruptSpecifiersKey;
+
+//
+// Services. Device memory and interrupts of a nub are set up by the test with the host functions.
+//
+#define kWiiHostMaxDeviceMemory   4
+#define kWiiHostMaxInterrupts     4
+
+class IOService : public IORegistryEntry {
+  OSDeclareDefaultStructors(IOService);
+
+  struct HostInterrupt {
+    OSObject          *target;
+    IOInterruptAction handler;
+    void              *refCon;
+    bool              enabled;
+  };
+
+  IOService       *_provider;
+  void            *_deviceMemory[kWiiHostMaxDeviceMemory];
+  IOByteCount     _deviceMemoryLength[kWiiHostMaxDeviceMemory];
+  HostInterrupt   _interrupts[kWiiHostMaxInterrupts];
+
+public:
+  IOService(void);
+  static IOPlatformExpert *getPlatform(void);
+  static IOService *waitForService(OSDictionary *matching, mach_timespec_t *timeout = NULL);
+  static OSDictionary *nameMatching(const char *name);
+  static IONotifier *addNotification(const OSSymbol *type, OSDictionary *matching, IOServiceNotificationHandler handler,
+                                     void *target, void *refCon = 0, SInt32 priority = 0);
+
+  //
+  // Host only, sets the platform expert returned by getPlatform().
+  //
+  static void hostSetPlatform(IOPlatformExpert *platform);
+
+  //
+  // Host only, makes a service available to waitForService() and calls publish notifications matching the name.
+  //
+  static void hostPublishService(IOService *service, const char *name);
+
+  virtual bool start(IOService *provider) {
+    _provider = provider;
+    return true;
+  }
+  virtual void stop(IOService *provider) { }
+  IOService *getProvider(void) const {
+    return _provider;
+  }
+  void registerService(IOOptionBits options = 0) { }
+
+  IOReturn callPlatformFunction(const char *functionName, bool waitForFunction,
+                                void *param1, void *param2, void *param3, void *param4);
+  virtual IOReturn callPlatformFunction(const OSSymbol *functionName, bool waitForFunction,
+                                        void *param1, void *param2, void *param3, void *param4) {
+    return kIOReturnUnsupported;
+  }
+
+  IOMemoryMap *mapDeviceMemoryWithIndex(unsigned int index, IOOptionBits options = 0);
+  IOReturn registerInterrupt(int source, OSObject *target, IOInterruptAction handler, void *refCon = 0);
+  IOReturn unregisterInterrupt(int source);
+  IOReturn enableInterrupt(int source);
+  IOReturn disableInterrupt(int source);
+
+  //
+  // Host only, sets up device memory for mapDeviceMemoryWithIndex() and raises a registered interrupt.
+  //
+  void hostSetDeviceMemory(unsigned int index, void *address, IOByteCount length);
+  bool hostRaiseInterrupt(int source);
+};
+
+class IOPlatformExpert : public IOService {
+  OSDeclareDefaultStructors(IOPlatformExpert);
+};
+
+//
+// Memory.
+//
+enum {
+  kIODirectionNone  = 0x0,
+  kIODirectionIn    = 0x1,
+  kIODirectionOut   = 0x2,
+  kIODirectionOutIn = kIODirectionIn | kIODirectionOut,
+  kIODirectionInOut = kIODirectionIn | kIODirectionOut
+};
+typedef UInt32 IODirection;
+
+#define kIOMapDefaultCache              0x0000
+#define kIOMapInhibitCache              0x0100
+#define kIOMapWriteThruCache            0x0200
+#define kIOMapCopybackCache             0x0300
+#define kIOMapCacheMask                 0x0700
+
+#define kIOMemoryPhysicallyContiguous   0x00000010
+#define kIODefaultCache                 0
+#define kIOInhibitCache                 1
+
+extern task_t kernel_task;
+IOReturn IOSetProcessorCacheMode(task_t task, IOVirtualAddress address, IOByteCount length, IOOptionBits cacheMode);
+
+class IOMemoryMap : public OSObject {
+  OSDeclareDefaultStructors(IOMemoryMap);
+
+  IOVirtualAddress  _address;
+  IOPhysicalAddress _physAddr;
+  IOByteCount       _length;
+  IOOptionBits      _options;
+
+public:
+  static IOMemoryMap *withAddress(void *address, IOByteCount length, IOOptionBits options = 0);
+  IOVirtualAddress getVirtualAddress(void) const {
+    return _address;
+  }
+  IOPhysicalAddress getPhysicalAddress(void) const {
+    return _physAddr;
+  }
+  IOByteCount getLength(void) const {
+    return _length;
+  }
+
+  //
+  // Host only, gets the options the map was created with.
+  //
+  IOOptionBits hostGetMapOptions(void) const {
+    return _options;
+  }
+};
+
+class IOMemoryDescriptor : public OSObject {
+  OSDeclareDefaultStructors(IOMemoryDescriptor);
+
+protected:
+  UInt8             *_bytes;
+  IOPhysicalAddress _physAddr;
+  IOByteCount       _length;
+  IODirection       _direction;
+  IOMemoryDescriptor *_parent;
+
+public:
+  static IOMemoryDescriptor *withAddress(void *address, IOByteCount length, IODirection direction);
+  static IOMemoryDescriptor *withPhysicalAddress(IOPhysicalAddress address, IOByteCount length, IODirection direction);
+  static IOMemoryDescriptor *withSubRange(IOMemoryDescriptor *of, IOByteCount offset, IOByteCount length, IODirection direction);
+  IOMemoryMap *map(IOOptionBits options = 0);
+  virtual void free(void);
+  IOByteCount getLength(void) const {
+    return _length;
+  }
+  IODirection getDirection(void) const {
+    return _direction;
+  }
+  virtual IOPhysicalAddress getPhysicalSegment(IOByteCount offset, IOByteCount *length);
+  IOByteCount readBytes(IOByteCount offset, void *bytes, IOByteCount length);
+  IOByteCount writeBytes(IOByteCount offset, const void *bytes, IOByteCount length);
+  virtual IOReturn prepare(IODirection forDirection = kIODirectionNone) {
+    return kIOReturnSuccess;
+  }
+  virtual IOReturn complete(IODirection forDirection = kIODirectionNone) {
+    return kIOReturnSuccess;
+  }
+};
+
+class IOBufferMemoryDescriptor : public IOMemoryDescriptor {
+  OSDeclareDefaultStructors(IOBufferMemoryDescriptor);
+
+  IOByteCount _capacity;
+
+public:
+  static IOBufferMemoryDescriptor *withOptions(IOOptionBits options, vm_size_t capacity, vm_offset_t alignment = 1);
+  static IOBufferMemoryDescriptor *withCapacity(vm_size_t capacity, IODirection direction, bool contiguous = false);
+  virtual void free(void);
+  void *getBytesNoCopy(void) {
+    return _bytes;
+  }
+  void *getBytesNoCopy(vm_size_t start, vm_size_t length) {
+    return ((start + length) <= _capacity) ? (_bytes + start) : NULL;
+  }
+  void setLength(vm_size_t length) {
+    _length = length;
+  }
+};
+
+//
+// 32-bit Mach-O symbol table entries.
+//
+struct nlist {
+  union {
+    SInt32  n_strx;
+  } n_un;
+  UInt8     n_type;
+  UInt8     n_sect;
+  SInt16    n_desc;
+  UInt32    n_value;
+};
+
+#define N_STAB    0xE0
+#define N_PEXT    0x10
+#define N_TYPE    0x0E
+#define N_EXT     0x01
+#define N_UNDF    0x0
+#define N_ABS     0x2
+#define N_SECT    0xE
+
+//
+// Range allocator, a sorted list of free fragments.
+//
+#define kWiiHostMaxRangeFragments   1024
+
+class IORangeAllocator : public OSObject {
+  OSDeclareDefaultStructors(IORangeAllocator);
+
+  struct Fragment {
+    UInt32 start;
+    UInt32 end;
+  };
+
+  Fragment  _fragments[kWiiHostMaxRangeFragments];
+  UInt32    _fragmentCount;
+
+  void insertFragment(UInt32 index, UInt32 start, UInt32 end);
+  void removeFragment(UInt32 index);
+
+public:
+  static IORangeAllocator *withRange(UInt32 endOfRange, UInt32 defaultElementSize = 0, UInt32 capacity = 0,
+                                     IOOptionBits options = 0);
+  bool allocate(UInt32 size, UInt32 *result, UInt32 alignment = 0);
+  void deallocate(UInt32 start, UInt32 size);
+  UInt32 getFreeCount(void);
+};
+
+//
+// Work loops and event sources. Each work loop runs on its own host thread, the gate is a recursive lock.
+//
+class IOWorkLoop;
+
+class IOEventSource : public OSObject {
+  OSDeclareDefaultStructors(IOEventSource);
+
+protected:
+  OSObject    *owner;
+  IOWorkLoop  *workLoop;
+  bool        enabled;
+
+public:
+  IOEventSource(void) : owner(NULL), workLoop(NULL), enabled(false) { }
+  virtual bool init(OSObject *inOwner) {
+    owner = inOwner;
+    return true;
+  }
+  virtual bool checkForWork(void) {
+    return false;
+  }
+  virtual void enable(void) {
+    enabled = true;
+    signalWorkAvailable();
+  }
+  virtual void disable(void) {
+    enabled = false;
+  }
+  bool isEnabled(void) const {
+    return enabled;
+  }
+  IOWorkLoop *getWorkLoop(void) const {
+    return workLoop;
+  }
+  virtual void setWorkLoop(IOWorkLoop *inWorkLoop) {
+    workLoop = inWorkLoop;
+  }
+  void signalWorkAvailable(void);
+};
+
+#define kWiiHostMaxEventSources   16
+
+class IOWorkLoop : public OSObject {
+  OSDeclareDefaultStructors(IOWorkLoop);
+
+  struct HostSleeper {
+    void        *event;
+    bool        woken;
+    HostSleeper *next;
+  };
+
+  pthread_t       _thread;
+  pthread_mutex_t _mutex;
+  pthread_cond_t  _cond;
+  pthread_t       _gateOwner;
+  UInt32          _gateDepth;
+  bool            _workToDo;
+  bool            _terminate;
+  IOEventSource   *_eventSources[kWiiHostMaxEventSources];
+  UInt32          _eventSourceCount;
+  HostSleeper     *_sleepers;
+
+  static void *threadMain(void *param);
+  void runEventSources(void);
+
+public:
+  typedef IOReturn (*Action)(OSObject *target, void *arg0, void *arg1, void *arg2, void *arg3);
+
+  static IOWorkLoop *workLoop(void);
+  virtual void free(void);
+  IOReturn addEventSource(IOEventSource *eventSource);
+  IOReturn removeEventSource(IOEventSource *eventSource);
+  void signalWorkAvailable(void);
+  void closeGate(void);
+  void openGate(void);
+  bool inGate(void);
+  int sleepGate(void *event, UInt32 interruptibleType);
+  void wakeupGate(void *event, bool oneThread);
+  IOReturn runAction(Action action, OSObject *target, void *arg0 = 0, void *arg1 = 0, void *arg2 = 0, void *arg3 = 0);
+  bool onThread(void) const {
+    return pthread_equal(pthread_self(), _thread);
+  }
+};
+
+class IOInterruptEventSource : public IOEventSource {
+  OSDeclareDefaultStructors(IOInterruptEventSource);
+
+public:
+  typedef void (*Action)(OSObject *owner, IOInterruptEventSource *sender, int count);
+
+protected:
+  Action          action;
+  IOService       *provider;
+  int             intIndex;
+  volatile UInt32 producerCount;
+  UInt32          consumerCount;
+
+  static void handleInterrupt(OSObject *target, void *refCon, IOService *nub, int source);
+
+public:
+  static IOInterruptEventSource *interruptEventSource(OSObject *owner, Action action, IOService *provider = 0,
+                                                      int intIndex = 0);
+  virtual bool init(OSObject *owner, Action action, IOService *provider = 0, int intIndex = 0);
+  virtual void free(void);
+  virtual void enable(void);
+  virtual void disable(void);
+  virtual bool checkForWork(void);
+  virtual void interruptOccurred(void *refCon, IOService *nub, int source);
+};
+
+class IOFilterInterruptEventSource : public IOInterruptEventSource {
+  OSDeclareDefaultStructors(IOFilterInterruptEventSource);
+
+public:
+  typedef bool (*Filter)(OSObject *owner, IOFilterInterruptEventSource *sender);
+
+protected:
+  Filter filterAction;
+
+public:
+  static IOFilterInterruptEventSource *filterInterruptEventSource(OSObject *owner, Action action, Filter filter,
+                                                                  IOService *provider, int intIndex = 0);
+  virtual void signalInterrupt(void);
+  virtual void interruptOccurred(void *refCon, IOService *nub, int source);
+};
+
+//
+// Timers are armed on the thread call thread and their actions run on the work loop.
+//
+class IOTimerEventSource : public IOEventSource {
+  OSDeclareDefaultStructors(IOTimerEventSource);
+
+public:
+  typedef void (*Action)(OSObject *owner, IOTimerEventSource *sender);
+
+protected:
+  Action          action;
+  thread_call_t   calloutEntry;
+  volatile bool   timerFired;
+
+  static void timeoutCallout(thread_call_param_t param0, thread_call_param_t param1);
+
+public:
+  static IOTimerEventSource *timerEventSource(OSObject *owner, Action action = 0);
+  virtual void free(void);
+  virtual bool checkForWork(void);
+  IOReturn setTimeoutMS(UInt32 milliseconds);
+  void cancelTimeout(void);
+};
+
+class IOCommandGate : public IOEventSource {
+  OSDeclareDefaultStructors(IOCommandGate);
+
+public:
+  typedef IOReturn (*Action)(OSObject *owner, void *arg0, void *arg1, void *arg2, void *arg3);
+
+protected:
+  Action action;
+
+public:
+  static IOCommandGate *commandGate(OSObject *owner, Action action = 0);
+  IOReturn runCommand(void *arg0 = 0, void *arg1 = 0, void *arg2 = 0, void *arg3 = 0) {
+    return runAction(action, arg0, arg1, arg2, arg3);
+  }
+  IOReturn runAction(Action action, void *arg0 = 0, void *arg1 = 0, void *arg2 = 0, void *arg3 = 0);
+  IOReturn commandSleep(void *event, UInt32 interruptible = THREAD_ABORTSAFE);
+  void commandWakeup(void *event, bool oneThread = false);
+};
+
+//
+// Memory cursors. Only created, host memory descriptors give their segments directly.
+//
+class IONaturalMemoryCursor : public OSObject {
+  OSDeclareDefaultStructors(IONaturalMemoryCursor);
+
+public:
+  static IONaturalMemoryCursor *withSpecification(IOPhysicalAddress maxSegmentSize, IOPhysicalAddress maxTransferSize,
+                                                  IOPhysicalAddress alignment = 1) {
+    return new IONaturalMemoryCursor;
+  }
+};
+
+//
+// Interrupt controllers.
+//
+typedef UInt32 IOInterruptVectorNumber;
+typedef void (*IOInterruptHandler)(void *target, void *refCon, void *nub, int source);
+
+typedef struct {
+  volatile char       interruptActive;
+  volatile char       interruptDisabledSoft;
+  volatile char       interruptDisabledHard;
+  volatile char       interruptRegistered;
+  IOLock              *interruptLock;
+  IOService           *nub;
+  long                source;
+  void                *target;
+  IOInterruptHandler  handler;
+  void                *refCon;
+  void                *sharedController;
+} IOInterruptVector;
+
+class IOInterruptController : public IOService {
+  OSDeclareDefaultStructors(IOInterruptController);
+
+protected:
+  IOInterruptVector *vectors;
+
+public:
+  virtual void disableVectorHard(IOInterruptVectorNumber vectorNumber, IOInterruptVector *vector) { }
+  virtual void enableVector(IOInterruptVectorNumber vectorNumber, IOInterruptVector *vector) { }
+};
+
+#endif
@@ -0,0 +1,45 @@
+//
+//  HostUSB.cpp
+//  Host stand-ins for the USB family interfaces used by the code under test
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "HostUSB.h"
+
+//
+// Controllers.
+//
+bool IOUSBController::start(IOService *provider) {
+  if (!IOService::start(provider)) {
+    return false;
+  }
+
+  _workLoop = IOWorkLoop::workLoop();
+  if (_workLoop == NULL) {
+    return false;
+  }
+  _commandGate = IOCommandGate::commandGate(this);
+  if ((_commandGate == NULL) || (_workLoop->addEventSource(_commandGate) != kIOReturnSuccess)) {
+    return false;
+  }
+
+  return UIMInitialize(provider) == kIOReturnSuccess;
+}
+
+void IOUSBController::stop(IOService *provider) {
+  UIMFinalize();
+
+  if (_commandGate != NULL) {
+    _workLoop->removeEventSource(_commandGate);
+    OSSafeReleaseNULL(_commandGate);
+  }
+  OSSafeReleaseNULL(_workLoop);
+  IOService::stop(provider);
+}
+
+void IOUSBController::Complete(IOUSBCompletion completion, IOReturn status, UInt32 actualByteCount) {
+  if (completion.action != NULL) {
+    completion.action(completion.target, completion.parameter, status, actualByteCount);
+  }
+}
@@ -0,0 +1,262 @@
+//
+//  HostUSB.h
+//  Host stand-ins for the USB family interfaces used by the code under test
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  IOUSBController only provides what a controller driver sees of it: the work loop and command gate created in
+//  start() before UIMInitialize() is called, and Complete(). IOUSBControllerV2 adds nothing beyond the high speed
+//  types. Tests call the UIM functions directly in place of the USB family.
+//
+
+#ifndef HostUSB_h
+#define HostUSB_h
+
+#include "HostKernel.h"
+
+//
+// Directions, endpoint types, and speeds.
+//
+enum {
+  kUSBOut     = 0,
+  kUSBIn      = 1,
+  kUSBNone    = 2,
+  kUSBAnyDirn = 3
+};
+
+enum {
+  kUSBControl   = 0,
+  kUSBIsoc      = 1,
+  kUSBBulk      = 2,
+  kUSBInterrupt = 3
+};
+
+enum {
+  kUSBDeviceSpeedLow  = 0,
+  kUSBDeviceSpeedFull = 1,
+  kUSBDeviceSpeedHigh = 2
+};
+
+typedef UInt16 USBDeviceAddress;
+
+#define kUSBMaxFSIsocEndpointReqCount   1023
+// 'llit', spelled out as the host compiler warns on multi-character constants.
+#define kUSBLowLatencyIsochTransferKey  0x6c6c6974
+
+//
+// Descriptors.
+//
+enum {
+  kUSBDeviceDesc        = 1,
+  kUSBConfDesc          = 2,
+  kUSBStringDesc        = 3,
+  kUSBInterfaceDesc     = 4,
+  kUSBEndpointDesc      = 5,
+  kUSBHubDescriptorType = 0x29
+};
+
+#define kUSBHubClass        9
+#define kUSBHubSubClass     0
+#define kUSBRel10           0x0100
+#define kUSBRel20           0x0200
+#define kAppleVendorID      0x05AC
+#define kPrdRootHubApple    0x8005
+#define kPrdRootHubAppleE   0x8006
+
+typedef struct {
+  UInt8   bLength;
+  UInt8   bDescriptorType;
+  UInt16  bcdUSB;
+  UInt8   bDeviceClass;
+  UInt8   bDeviceSubClass;
+  UInt8   bDeviceProtocol;
+  UInt8   bMaxPacketSize0;
+  UInt16  idVendor;
+  UInt16  idProduct;
+  UInt16  bcdDevice;
+  UInt8   iManufacturer;
+  UInt8   iProduct;
+  UInt8   iSerialNumber;
+  UInt8   bNumConfigurations;
+} __attribute__((packed)) IOUSBDeviceDescriptor;
+
+typedef struct {
+  UInt8   bLength;
+  UInt8   bDescriptorType;
+  UInt16  wTotalLength;
+  UInt8   bNumInterfaces;
+  UInt8   bConfigurationValue;
+  UInt8   iConfiguration;
+  UInt8   bmAttributes;
+  UInt8   MaxPower;
+} __attribute__((packed)) IOUSBConfigurationDescriptor;
+
+typedef struct {
+  UInt8   bLength;
+  UInt8   bDescriptorType;
+  UInt8   bInterfaceNumber;
+  UInt8   bAlternateSetting;
+  UInt8   bNumEndpoints;
+  UInt8   bInterfaceClass;
+  UInt8   bInterfaceSubClass;
+  UInt8   bInterfaceProtocol;
+  UInt8   iInterface;
+} __attribute__((packed)) IOUSBInterfaceDescriptor;
+
+typedef struct {
+  UInt8   bLength;
+  UInt8   bDescriptorType;
+  UInt8   bEndpointAddress;
+  UInt8   bmAttributes;
+  UInt16  wMaxPacketSize;
+  UInt8   bInterval;
+} __attribute__((packed)) IOUSBEndpointDescriptor;
+
+//
+// Hubs.
+//
+typedef struct {
+  UInt8   length;
+  UInt8   hubType;
+  UInt8   numPorts;
+  UInt16  characteristics;
+  UInt8   powerOnToGood;
+  UInt8   hubCurrent;
+  UInt8   removablePortFlags[8];
+  UInt8   pwrCtlPortFlags[8];
+} __attribute__((packed)) IOUSBHubDescriptor;
+
+typedef struct {
+  UInt16  statusFlags;
+  UInt16  changeFlags;
+} IOUSBHubStatus;
+typedef IOUSBHubStatus IOUSBHubPortStatus;
+
+enum {
+  kPerPortSwitchingBit    = (1 << 0),
+  kNoPowerSwitchingBit    = (1 << 1),
+  kCompoundDeviceBit      = (1 << 2),
+  kPerPortOverCurrentBit  = (1 << 3),
+  kNoOverCurrentBit       = (1 << 4)
+};
+
+enum {
+  kUSBHubPortConnectionFeature        = 0,
+  kUSBHubPortEnableFeature            = 1,
+  kUSBHubPortSuspendFeature           = 2,
+  kUSBHubPortOverCurrentFeature       = 3,
+  kUSBHubPortResetFeature             = 4,
+  kUSBHubPortPowerFeature             = 8,
+  kUSBHubPortLowSpeedFeature          = 9,
+  kUSBHubPortConnectionChangeFeature  = 16,
+  kUSBHubPortEnableChangeFeature      = 17,
+  kUSBHubPortSuspendChangeFeature     = 18,
+  kUSBHubPortOverCurrentChangeFeature = 19,
+  kUSBHubPortResetChangeFeature       = 20
+};
+
+enum {
+  kHubPortConnection  = 0x0001,
+  kHubPortEnabled     = 0x0002,
+  kHubPortSuspend     = 0x0004,
+  kHubPortOverCurrent = 0x0008,
+  kHubPortBeingReset  = 0x0010,
+  kHubPortPower       = 0x0100,
+  kHubPortLowSpeed    = 0x0200,
+  kHubPortHighSpeed   = 0x0400
+};
+
+//
+// USB family errors.
+//
+#define iokit_usb_err(return)     ((IOReturn) (0xe0004000 | (return)))
+#define kIOUSBCRCErr              iokit_usb_err(0x01)
+#define kIOUSBBitstufErr          iokit_usb_err(0x02)
+#define kIOUSBDataToggleErr       iokit_usb_err(0x03)
+#define kIOUSBPIDCheckErr         iokit_usb_err(0x06)
+#define kIOUSBWrongPIDErr         iokit_usb_err(0x07)
+#define kIOUSBReserved1Err        iokit_usb_err(0x0A)
+#define kIOUSBReserved2Err        iokit_usb_err(0x0B)
+#define kIOUSBBufferOverrunErr    iokit_usb_err(0x0C)
+#define kIOUSBBufferUnderrunErr   iokit_usb_err(0x0D)
+#define kIOUSBNotSent1Err         iokit_usb_err(0x0E)
+#define kIOUSBNotSent2Err         iokit_usb_err(0x0F)
+#define kIOUSBPipeStalled         iokit_usb_err(0x4F)
+#define kIOUSBEndpointNotFound    iokit_usb_err(0x57)
+
+//
+// Completions.
+//
+typedef struct {
+  IOReturn  frStatus;
+  UInt16    frReqCount;
+  UInt16    frActCount;
+} IOUSBIsocFrame;
+
+typedef struct {
+  IOReturn      frStatus;
+  UInt16        frReqCount;
+  UInt16        frActCount;
+  AbsoluteTime  frTimeStamp;
+} IOUSBLowLatencyIsocFrame;
+
+typedef void (*IOUSBCompletionAction)(void *target, void *parameter, IOReturn status, UInt32 bufferSizeRemaining);
+typedef void (*IOUSBIsocCompletionAction)(void *target, void *parameter, IOReturn status, IOUSBIsocFrame *pFrames);
+
+typedef struct {
+  void                  *target;
+  IOUSBCompletionAction action;
+  void                  *parameter;
+} IOUSBCompletion;
+
+typedef struct {
+  void                      *target;
+  IOUSBIsocCompletionAction action;
+  void                      *parameter;
+} IOUSBIsocCompletion;
+
+class IOUSBCommand : public OSObject {
+  OSDeclareDefaultStructors(IOUSBCommand);
+
+  IOUSBCompletion _uslCompletion;
+
+public:
+  IOUSBCompletion GetUSLCompletion(void) {
+    return _uslCompletion;
+  }
+  void SetUSLCompletion(IOUSBCompletion completion) {
+    _uslCompletion = completion;
+  }
+};
+
+//
+// Controllers.
+//
+class IOUSBController : public IOService {
+  OSDeclareDefaultStructors(IOUSBController);
+
+protected:
+  IOWorkLoop    *_workLoop;
+  IOCommandGate *_commandGate;
+
+  virtual IOReturn UIMInitialize(IOService *provider) = 0;
+  virtual IOReturn UIMFinalize(void) = 0;
+
+public:
+  virtual bool start(IOService *provider);
+  virtual void stop(IOService *provider);
+  void Complete(IOUSBCompletion completion, IOReturn status, UInt32 actualByteCount = 0);
+
+  IOWorkLoop *getWorkLoop(void) const {
+    return _workLoop;
+  }
+  IOCommandGate *getCommandGate(void) const {
+    return _commandGate;
+  }
+};
+
+class IOUSBControllerV2 : public IOUSBController {
+  OSDeclareDefaultStructors(IOUSBControllerV2);
+};
+
+#endif
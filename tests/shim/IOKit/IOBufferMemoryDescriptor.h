@@ -0,0 +1,6 @@
+//
+//  IOBufferMemoryDescriptor.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
@@ -0,0 +1,6 @@
+//
+//  IOCommandGate.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
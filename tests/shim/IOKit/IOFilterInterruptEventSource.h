@@ -0,0 +1,6 @@
+//
+//  IOFilterInterruptEventSource.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
@@ -0,0 +1,6 @@
+//
+//  IOInterruptController.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
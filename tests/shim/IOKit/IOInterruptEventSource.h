@@ -0,0 +1,6 @@
+//
+//  IOInterruptEventSource.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
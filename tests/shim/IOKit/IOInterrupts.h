@@ -0,0 +1,6 @@
+//
+//  IOInterrupts.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
@@ -0,0 +1,6 @@
+//
+//  IOLib.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
@@ -0,0 +1,6 @@
+//
+//  IOMemoryCursor.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
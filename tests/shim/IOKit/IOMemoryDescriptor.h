@@ -0,0 +1,6 @@
+//
+//  IOMemoryDescriptor.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
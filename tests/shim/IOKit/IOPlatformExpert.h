@@ -0,0 +1,6 @@
+//
+//  IOPlatformExpert.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
@@ -0,0 +1,6 @@
+//
+//  IORangeAllocator.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
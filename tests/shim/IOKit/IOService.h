@@ -0,0 +1,6 @@
+//
+//  IOService.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
@@ -0,0 +1,6 @@
+//
+//  IOTimerEventSource.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
@@ -0,0 +1,6 @@
+//
+//  IOWorkLoop.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
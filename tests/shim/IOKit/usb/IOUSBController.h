@@ -0,0 +1,6 @@
+//
+//  IOUSBController.h
+//  Host stand-in, see HostUSB.h
+//
+
+#include "../../HostUSB.h"
@@ -0,0 +1,6 @@
+//
+//  IOUSBControllerV2.h
+//  Host stand-in, see HostUSB.h
+//
+
+#include "../../HostUSB.h"
@@ -0,0 +1,6 @@
+//
+//  USB.h
+//  Host stand-in, see HostUSB.h
+//
+
+#include "../../HostUSB.h"
@@ -0,0 +1,6 @@
+//
+//  thread_call.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
@@ -0,0 +1,6 @@
+//
+//  OSAtomic.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
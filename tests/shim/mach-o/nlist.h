@@ -0,0 +1,6 @@
+//
+//  nlist.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
@@ -0,0 +1,6 @@
+//
+//  proc_reg.h
+//  Host stand-in, see HostKernel.h
+//
+
+#include "../HostKernel.h"
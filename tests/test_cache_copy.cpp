@@ -0,0 +1,166 @@
+//
+//  test_cache_copy.cpp
+//  Checks the DMA bounce buffer copies against memcpy with random alignments, offsets and lengths
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  Host builds zero whole lines with bzero in place of dcbz, so the lines touched are the same as on the Wii.
+//  Every buffer is surrounded by guard bytes that must not change. Buffers span several parts of an outbound copy, so
+//  copies that end within a part, or stop early at the end of the descriptor, are covered.
+//
+
+#include "TestHarness.h"
+#include "WiiCacheCopy.hpp"
+
+#define kTestRounds         50000
+#define kTestBufferSize     (kWiiCacheCopyChunkSize * 3)
+#define kTestGuardSize      (kWiiCacheLineSize * 2)
+#define kTestGuardByte      0xA5
+
+static UInt8        gSource[kTestBufferSize];
+static UInt8        gArena[kTestGuardSize + kTestBufferSize + kTestGuardSize] __attribute__((aligned(kWiiCacheLineSize)));
+static vm_offset_t  gInvalidateAddress;
+static unsigned     gInvalidateCount;
+static UInt32       gInvalidateCalls;
+
+static void recordInvalidate(vm_offset_t va, unsigned length, boolean_t phys) {
+  gInvalidateAddress = va;
+  gInvalidateCount   = length;
+  gInvalidateCalls++;
+}
+
+//
+// Checks that every byte of the arena outside a range still holds the guard byte.
+//
+static bool checkGuard(const UInt8 *start, UInt32 length) {
+  for (const UInt8 *ptr = gArena; ptr < (gArena + sizeof (gArena)); ptr++) {
+    if (((ptr < start) || (ptr >= (start + length))) && (*ptr != kTestGuardByte)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// Only lines wholly inside the buffer may be zeroed, and all of them must be.
+//
+static void testZeroCacheLines(UInt32 *seed) {
+  UInt8       *buffer;
+  UInt32      length;
+  vm_offset_t line;
+  bool        zeroed;
+  bool        matches;
+
+  matches = true;
+  for (UInt32 round = 0; round < kTestRounds; round++) {
+    memset(gArena, kTestGuardByte, sizeof (gArena));
+    buffer = gArena + kTestGuardSize + (testRandom(seed) % (kWiiCacheLineSize * 2));
+    length = testRandom(seed) % ((round % 2) ? (kWiiCacheLineSize * 4) : (kTestBufferSize - (kWiiCacheLineSize * 2)));
+
+    zeroCacheLines(buffer, length);
+    for (UInt8 *ptr = gArena; ptr < (gArena + sizeof (gArena)); ptr++) {
+      line   = ((vm_offset_t) ptr) & ~((vm_offset_t) kWiiCacheLineMask);
+      zeroed = (line >= (vm_offset_t) buffer) && ((line + kWiiCacheLineSize) <= ((vm_offset_t) buffer + length));
+      if (*ptr != (zeroed ? 0 : kTestGuardByte)) {
+        matches = false;
+      }
+    }
+  }
+  TEST_CHECK(matches);
+}
+
+//
+// Outbound copies must match memcpy, stop at the end of the descriptor, and flush the whole buffer.
+//
+static void testReadToDMABuffer(IOMemoryDescriptor *desc, UInt32 *seed) {
+  UInt8       *buffer;
+  UInt32      offset;
+  UInt32      length;
+  UInt32      expected;
+  IOByteCount copied;
+  vm_offset_t flushAddress;
+  unsigned    flushCount;
+  bool        matches;
+
+  matches = true;
+  for (UInt32 round = 0; round < kTestRounds; round++) {
+    memset(gArena, kTestGuardByte, sizeof (gArena));
+    buffer = gArena + kTestGuardSize + (testRandom(seed) % kWiiCacheLineSize);
+    offset = testRandom(seed) % (kTestBufferSize + kWiiCacheLineSize);
+    length = testRandom(seed) % ((round % 2) ? (kWiiCacheLineSize * 4) : (kTestBufferSize - kWiiCacheLineSize));
+
+    expected = (offset < kTestBufferSize) ? (kTestBufferSize - offset) : 0;
+    if (expected > length) {
+      expected = length;
+    }
+    copied = readToDMABuffer(desc, offset, buffer, length);
+    hostGetLastDataCacheFlush(&flushAddress, &flushCount);
+
+    if ((copied != expected) || (memcmp(buffer, gSource + offset, expected) != 0) || !checkGuard(buffer, length)
+        || (flushAddress != (vm_offset_t) buffer) || (flushCount != length)) {
+      matches = false;
+    }
+  }
+  TEST_CHECK(matches);
+}
+
+//
+// Inbound copies must match memcpy and invalidate exactly the bytes copied, or nothing if there are none.
+//
+static void testWriteFromDMABuffer(IOMemoryDescriptor *desc, UInt32 *seed) {
+  UInt8       *buffer;
+  UInt32      offset;
+  UInt32      length;
+  UInt32      calls;
+  IOByteCount copied;
+  bool        matches;
+
+  matches = true;
+  for (UInt32 round = 0; round < kTestRounds; round++) {
+    memset(gArena, kTestGuardByte, sizeof (gArena));
+    buffer = gArena + kTestGuardSize + (testRandom(seed) % kWiiCacheLineSize);
+    offset = testRandom(seed) % kTestBufferSize;
+    length = testRandom(seed) % (((round % 4) == 0) ? 1 : (kTestBufferSize - offset + 1));
+    for (UInt32 i = 0; i < length; i++) {
+      buffer[i] = (UInt8) testRandom(seed);
+    }
+
+    calls  = gInvalidateCalls;
+    copied = writeFromDMABuffer(desc, offset, buffer, length, recordInvalidate);
+
+    if ((copied != length) || (memcmp(gSource + offset, buffer, length) != 0)) {
+      matches = false;
+    }
+    if (length == 0) {
+      matches = matches && (gInvalidateCalls == calls);
+    } else {
+      matches = matches && (gInvalidateCalls == (calls + 1)) && (gInvalidateAddress == (vm_offset_t) buffer)
+        && (gInvalidateCount == length);
+    }
+  }
+  TEST_CHECK(matches);
+
+  TEST_CHECK(writeFromDMABuffer(desc, kTestBufferSize, gArena, 16, recordInvalidate) == 0);
+}
+
+int main(void) {
+  IOMemoryDescriptor  *desc;
+  UInt32              seed;
+
+  seed = 0x4C494E45;
+  for (UInt32 i = 0; i < kTestBufferSize; i++) {
+    gSource[i] = (UInt8) testRandom(&seed);
+  }
+  desc = IOMemoryDescriptor::withAddress(gSource, kTestBufferSize, kIODirectionOutIn);
+  TEST_CHECK(desc != NULL);
+  if (desc == NULL) {
+    return testFinish("cache_copy");
+  }
+
+  testZeroCacheLines(&seed);
+  testReadToDMABuffer(desc, &seed);
+  testWriteFromDMABuffer(desc, &seed);
+
+  desc->release();
+  return testFinish("cache_copy");
+}
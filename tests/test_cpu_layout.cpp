@@ -0,0 +1,62 @@
+//
+//  test_cpu_layout.cpp
+//  Checks the per-core processor interface interrupt register layout on Wii U
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+
+#include "TestHarness.h"
+#include "WiiProcessorInterface.hpp"
+
+//
+// Layout from https://wiiubrew.org/wiki/Hardware/Processor_interface, cause then mask for each core.
+//
+static const UInt32 kExpectedCause[] = { 0x78, 0x80, 0x88 };
+static const UInt32 kExpectedMask[]  = { 0x7C, 0x84, 0x8C };
+
+int main(void) {
+  UInt8   regs[kWiiPIBaseLength];
+  UInt32  offsets[kWiiPICafeCoreCount * 2];
+  UInt32  count;
+
+  TEST_CHECK(kWiiPICafeCoreCount == ARRSIZE(kExpectedCause));
+
+  //
+  // Offsets must match the documented layout, be aligned, and fit in the mapped registers.
+  //
+  count = 0;
+  for (UInt32 core = 0; core < kWiiPICafeCoreCount; core++) {
+    TEST_CHECK(kWiiPIRegCafeInterruptCause(core) == kExpectedCause[core]);
+    TEST_CHECK(kWiiPIRegCafeInterruptMask(core) == kExpectedMask[core]);
+    TEST_CHECK((kWiiPIRegCafeInterruptCause(core) % sizeof (UInt32)) == 0);
+    TEST_CHECK((kWiiPIRegCafeInterruptMask(core) + sizeof (UInt32)) <= kWiiPIBaseLength);
+
+    offsets[count++] = kWiiPIRegCafeInterruptCause(core);
+    offsets[count++] = kWiiPIRegCafeInterruptMask(core);
+  }
+  TEST_CHECK(kWiiPIRegCafeInterruptCause(0) == kWiiPIRegCafeInterruptCPU0Base);
+
+  //
+  // No two registers may overlap, nor overlap the Wii registers.
+  //
+  for (UInt32 i = 0; i < count; i++) {
+    for (UInt32 j = i + 1; j < count; j++) {
+      TEST_CHECK(offsets[i] != offsets[j]);
+    }
+    TEST_CHECK(offsets[i] > kWiiPIRegFifoCurrentWritePointer);
+  }
+
+  //
+  // Each core's mask written through the layout must read back from that core only.
+  //
+  bzero(regs, sizeof (regs));
+  for (UInt32 core = 0; core < kWiiPICafeCoreCount; core++) {
+    OSWriteBigInt32(regs, kWiiPIRegCafeInterruptMask(core), 1 << (core + kWiiPIVectorHollywood));
+  }
+  for (UInt32 core = 0; core < kWiiPICafeCoreCount; core++) {
+    TEST_CHECK(OSReadBigInt32(regs, kWiiPIRegCafeInterruptMask(core)) == (UInt32) (1 << (core + kWiiPIVectorHollywood)));
+    TEST_CHECK(OSReadBigInt32(regs, kWiiPIRegCafeInterruptCause(core)) == 0);
+  }
+
+  return testFinish("cpu_layout");
+}
@@ -0,0 +1,500 @@
+//
+//  test_crypto.cpp
+//  Checks AES-128-CBC and SHA-1 against the FIPS 197, SP 800-38A and FIPS 180 vectors, in software and on engine models
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  The engine models follow the register interface the driver programs, and compute with the software implementations
+//  the vectors check. Requests run in software only, on interrupt driven engines, and on polled engines.
+//  Large requests are compared with a single software pass, so chunking and chaining between engine runs are checked.
+//  The models can also hang or lose their interrupt, which must end in a timeout or a late completion.
+//
+
+#include "TestHarness.h"
+#include "WiiCrypto.hpp"
+#include "WiiHollywood.hpp"
+#include "WiiMem2Allocator.hpp"
+
+#define kTestMem2Pages        64
+#define kTestEngineRegsSize   0x20
+#define kTestRandomLength     (100 * 1024)
+#define kTestMillionLength    1000000
+
+#define kTestPVRWii           0x00087102
+#define kTestPVRCafe          0x70010201
+
+typedef enum {
+  kTestEngineNormal,
+  kTestEngineHang,
+  kTestEngineLostInterrupt
+} TestEngineMode;
+
+//
+// Model of the AES or SHA-1 engine registers.
+//
+class TestEngine : public HostDevice {
+public:
+  IOService       *nub;
+  bool            sha;
+  TestEngineMode  mode;
+  UInt32          runs;
+  UInt32          regs[kTestEngineRegsSize / sizeof (UInt32)];
+  UInt32          key[4];
+  UInt32          iv[4];
+  UInt32          keyIndex;
+  UInt32          ivIndex;
+
+  TestEngine(IOService *engineNub, bool isSHA) {
+    nub      = engineNub;
+    sha      = isSHA;
+    mode     = kTestEngineNormal;
+    runs     = 0;
+    keyIndex = 0;
+    ivIndex  = 0;
+    bzero(regs, sizeof (regs));
+  }
+
+  UInt32 readReg32(UInt32 offset) {
+    return regs[offset / sizeof (UInt32)];
+  }
+
+  void writeReg32(UInt32 offset, UInt32 data) {
+    if (!sha && (offset == kWiiAESRegKey)) {
+      key[keyIndex++ % 4] = data;
+    } else if (!sha && (offset == kWiiAESRegIV)) {
+      iv[ivIndex++ % 4] = data;
+    } else {
+      regs[offset / sizeof (UInt32)] = data;
+      if ((offset == 0) && ((data & BIT31) != 0)) {
+        execute(data);
+      }
+    }
+  }
+
+  void execute(UInt32 control);
+};
+
+void TestEngine::execute(UInt32 control) {
+  UInt32  roundKeys[kWiiCryptoAESRoundKeyCount];
+  UInt8   keyBytes[kWiiCryptoAESKeySize];
+  UInt8   ivBytes[kWiiCryptoAESBlockSize];
+  UInt32  h[5];
+  UInt8   *src;
+  UInt8   *dest;
+  UInt32  length;
+
+  runs++;
+  if (mode == kTestEngineHang) {
+    return;
+  }
+
+  if (sha) {
+    length = ((control & kWiiSHAControlBlocksMask) + 1) * kWiiCryptoSHA1BlockSize;
+    src    = (UInt8 *) hostPhysToVirt(regs[kWiiSHARegSource / sizeof (UInt32)]);
+    if ((src == NULL) || ((regs[kWiiSHARegSource / sizeof (UInt32)] % kWiiCryptoDMAAlignment) != 0)) {
+      regs[0] = (control & ~kWiiSHAControlExecute) | kWiiSHAControlError;
+    } else {
+      for (UInt32 i = 0; i < 5; i++) {
+        h[i] = regs[(kWiiSHARegH0 / sizeof (UInt32)) + i];
+      }
+      WiiCrypto::hashSHA1Software(h, src, length);
+      for (UInt32 i = 0; i < 5; i++) {
+        regs[(kWiiSHARegH0 / sizeof (UInt32)) + i] = h[i];
+      }
+      regs[0] = control & ~kWiiSHAControlExecute;
+    }
+  } else {
+    length = ((control & kWiiAESControlBlocksMask) + 1) * kWiiCryptoAESBlockSize;
+    src    = (UInt8 *) hostPhysToVirt(regs[kWiiAESRegSource / sizeof (UInt32)]);
+    dest   = (UInt8 *) hostPhysToVirt(regs[kWiiAESRegDest / sizeof (UInt32)]);
+    if ((src == NULL) || (dest == NULL) || ((regs[kWiiAESRegSource / sizeof (UInt32)] % kWiiCryptoDMAAlignment) != 0)
+        || ((regs[kWiiAESRegDest / sizeof (UInt32)] % kWiiCryptoDMAAlignment) != 0) || ((control & kWiiAESControlEnable) == 0)) {
+      regs[0] = (control & ~kWiiAESControlExecute) | kWiiAESControlError;
+    } else {
+      for (UInt32 i = 0; i < 4; i++) {
+        OSWriteBigInt32(keyBytes, i * sizeof (UInt32), key[i]);
+        OSWriteBigInt32(ivBytes, i * sizeof (UInt32), iv[i]);
+      }
+      WiiCrypto::expandAESKey(keyBytes, roundKeys);
+      if (control & kWiiAESControlDecrypt) {
+        WiiCrypto::decryptAESCBCSoftware(roundKeys, ivBytes, src, dest, length);
+      } else {
+        WiiCrypto::encryptAESCBCSoftware(roundKeys, ivBytes, src, dest, length);
+      }
+      regs[0] = control & ~kWiiAESControlExecute;
+    }
+  }
+
+  if ((control & BIT30) && (mode != kTestEngineLostInterrupt)) {
+    nub->hostRaiseInterrupt(0);
+  }
+}
+
+//
+// Platform expert answering the functions the driver asks for.
+//
+class TestPlatform : public IOPlatformExpert {
+  OSDeclareDefaultStructors(TestPlatform);
+
+public:
+  const WiiMem2Service *mem2Service;
+
+  IOReturn callPlatformFunction(const OSSymbol *functionName, bool waitForFunction,
+                                void *param1, void *param2, void *param3, void *param4) {
+    if (functionName->isEqualTo(kWiiFuncPlatformGetInvalidateCache)) {
+      *((WiiInvalidateDataCacheFunc *) param1) = invalidate_dcache;
+      return kIOReturnSuccess;
+    }
+    if (functionName->isEqualTo(kWiiFuncPlatformGetMem2Service)) {
+      *((const WiiMem2Service **) param1) = mem2Service;
+      return kIOReturnSuccess;
+    }
+    return kIOReturnUnsupported;
+  }
+};
+
+//
+// Test fixture, a started driver with optional engine models.
+//
+typedef struct {
+  IOService   *aesNub;
+  IOService   *shaNub;
+  TestEngine  *aes;
+  TestEngine  *sha;
+  WiiCrypto   *crypto;
+} TestCrypto;
+
+static UInt8  gHollywoodRegs[kWiiHollywoodBaseLength];
+static UInt8  gAESRegs[kTestEngineRegsSize];
+static UInt8  gSHARegs[kTestEngineRegsSize];
+
+static bool createCrypto(TestCrypto *test, bool engines, bool useInterrupts) {
+  OSNumber *interrupt;
+
+  bzero(test, sizeof (*test));
+  hostSetProcessorPVR(engines ? kTestPVRWii : kTestPVRCafe);
+  OSWriteBigInt32(gHollywoodRegs, kWiiHollywoodAHBProtect,
+    engines ? (kWiiHollywoodAHBProtectBroadwayAES | kWiiHollywoodAHBProtectBroadwaySHA1) : 0);
+
+  test->aesNub = new IOService;
+  test->aesNub->init();
+  test->shaNub = new IOService;
+  test->shaNub->init();
+  if (engines) {
+    test->aesNub->hostSetDeviceMemory(0, gAESRegs, sizeof (gAESRegs));
+    test->shaNub->hostSetDeviceMemory(0, gSHARegs, sizeof (gSHARegs));
+    if (useInterrupts) {
+      interrupt = OSNumber::withNumber(1, 32);
+      test->aesNub->setProperty(gIOInterruptSpecifiersKey, interrupt);
+      test->shaNub->setProperty(gIOInterruptSpecifiersKey, interrupt);
+      interrupt->release();
+    }
+
+    test->aes = new TestEngine(test->aesNub, false);
+    test->sha = new TestEngine(test->shaNub, true);
+    hostAddDevice(test->aes, gAESRegs, sizeof (gAESRegs));
+    hostAddDevice(test->sha, gSHARegs, sizeof (gSHARegs));
+    IOService::hostPublishService(test->shaNub, "NTDOY,sha");
+  }
+
+  test->crypto = new WiiCrypto;
+  test->crypto->setName("WiiCrypto");
+  return test->crypto->init() && test->crypto->start(test->aesNub);
+}
+
+static void destroyCrypto(TestCrypto *test) {
+  test->crypto->release();
+  if (test->aes != NULL) {
+    hostRemoveDevice(test->aes);
+    hostRemoveDevice(test->sha);
+    delete test->aes;
+    delete test->sha;
+  }
+}
+
+static void parseHex(const char *hex, UInt8 *bytes) {
+  for (UInt32 i = 0; hex[i * 2] != '\0'; i++) {
+    sscanf(&hex[i * 2], "%2hhx", &bytes[i]);
+  }
+}
+
+//
+// Runs AES-128-CBC on a buffer in place.
+//
+static IOReturn runAES(TestCrypto *test, const UInt8 *key, UInt8 *iv, bool decrypt, UInt8 *buffer, UInt32 length) {
+  IOMemoryDescriptor  *desc;
+  IOReturn            status;
+
+  desc   = IOMemoryDescriptor::withAddress(buffer, length, kIODirectionOutIn);
+  status = test->crypto->aesCBC(key, iv, decrypt, desc, 0, desc, 0, length);
+  desc->release();
+  return status;
+}
+
+//
+// Hashes a buffer, passing it to the driver in pieces of up to a given length.
+//
+static IOReturn runSHA1(TestCrypto *test, const UInt8 *data, UInt32 length, UInt32 pieceLength, UInt8 *digest) {
+  WiiCryptoSHA1Context  context;
+  IOMemoryDescriptor    *desc;
+  IOReturn              status;
+
+  desc   = IOMemoryDescriptor::withAddress((void *) data, length, kIODirectionOut);
+  status = kIOReturnSuccess;
+  test->crypto->sha1Init(&context);
+  for (UInt32 offset = 0; (offset < length) && (status == kIOReturnSuccess); offset += pieceLength) {
+    status = test->crypto->sha1Update(&context, desc, offset, ((length - offset) < pieceLength) ? (length - offset) : pieceLength);
+  }
+  if (status == kIOReturnSuccess) {
+    status = test->crypto->sha1Final(&context, digest);
+  }
+  desc->release();
+  return status;
+}
+
+//
+// Standard vectors. AES requests this short are always done in software, SHA-1 requests are long enough for the engine.
+//
+static void testVectors(TestCrypto *test) {
+  static UInt8  million[kTestMillionLength];
+  UInt8         key[kWiiCryptoAESKeySize];
+  UInt8         iv[kWiiCryptoAESBlockSize];
+  UInt8         buffer[64];
+  UInt8         expected[64];
+  UInt8         digest[kWiiCryptoSHA1DigestSize];
+
+  //
+  // FIPS 197 appendix C.1, a single block with a zero IV.
+  //
+  parseHex("000102030405060708090a0b0c0d0e0f", key);
+  parseHex("00112233445566778899aabbccddeeff", buffer);
+  parseHex("69c4e0d86a7b0430d8cdb78070b4c55a", expected);
+  bzero(iv, sizeof (iv));
+  TEST_CHECK(runAES(test, key, iv, false, buffer, 16) == kIOReturnSuccess);
+  TEST_CHECK(memcmp(buffer, expected, 16) == 0);
+  bzero(iv, sizeof (iv));
+  TEST_CHECK(runAES(test, key, iv, true, buffer, 16) == kIOReturnSuccess);
+  parseHex("00112233445566778899aabbccddeeff", expected);
+  TEST_CHECK(memcmp(buffer, expected, 16) == 0);
+
+  //
+  // SP 800-38A F.2.1 and F.2.2, CBC-AES128, with the chain continued across two requests.
+  //
+  parseHex("2b7e151628aed2a6abf7158809cf4f3c", key);
+  parseHex("000102030405060708090a0b0c0d0e0f", iv);
+  parseHex("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+           "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710", buffer);
+  parseHex("7649abac8119b246cee98e9b12e9197d5086cb9b507219ee95db113a917678b2"
+           "73bed6b8e3c1743b7116e69e222295163ff1caa1681fac09120eca307586e1a7", expected);
+  TEST_CHECK(runAES(test, key, iv, false, buffer, 32) == kIOReturnSuccess);
+  TEST_CHECK(runAES(test, key, iv, false, &buffer[32], 32) == kIOReturnSuccess);
+  TEST_CHECK(memcmp(buffer, expected, 64) == 0);
+  TEST_CHECK(memcmp(iv, &expected[48], 16) == 0);
+  parseHex("000102030405060708090a0b0c0d0e0f", iv);
+  TEST_CHECK(runAES(test, key, iv, true, buffer, 64) == kIOReturnSuccess);
+  parseHex("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+           "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710", expected);
+  TEST_CHECK(memcmp(buffer, expected, 64) == 0);
+
+  //
+  // FIPS 180 examples.
+  //
+  TEST_CHECK(runSHA1(test, NULL, 0, 1, digest) == kIOReturnSuccess);
+  parseHex("da39a3ee5e6b4b0d3255bfef95601890afd80709", expected);
+  TEST_CHECK(memcmp(digest, expected, sizeof (digest)) == 0);
+
+  TEST_CHECK(runSHA1(test, (const UInt8 *) "abc", 3, 3, digest) == kIOReturnSuccess);
+  parseHex("a9993e364706816aba3e25717850c26c9cd0d89d", expected);
+  TEST_CHECK(memcmp(digest, expected, sizeof (digest)) == 0);
+
+  TEST_CHECK(runSHA1(test, (const UInt8 *) "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 56, 7, digest) == kIOReturnSuccess);
+  parseHex("84983e441c3bd26ebaae4aa1f95129e5e54670f1", expected);
+  TEST_CHECK(memcmp(digest, expected, sizeof (digest)) == 0);
+
+  memset(million, 'a', sizeof (million));
+  parseHex("34aa973cd4c4daa4f61eeb2bdbad27316534016f", expected);
+  TEST_CHECK(runSHA1(test, million, sizeof (million), sizeof (million), digest) == kIOReturnSuccess);
+  TEST_CHECK(memcmp(digest, expected, sizeof (digest)) == 0);
+  TEST_CHECK(runSHA1(test, million, sizeof (million), 1000, digest) == kIOReturnSuccess);
+  TEST_CHECK(memcmp(digest, expected, sizeof (digest)) == 0);
+  TEST_CHECK(runSHA1(test, million, sizeof (million), 20011, digest) == kIOReturnSuccess);
+  TEST_CHECK(memcmp(digest, expected, sizeof (digest)) == 0);
+}
+
+//
+// Long requests are compared with one software pass over the whole buffer.
+// Split requests mix chunks long enough for the engine with ones done in software, and must carry the chain.
+//
+static UInt8 gReferenceDigest[kWiiCryptoSHA1DigestSize];
+static bool  gReferenceDigestValid;
+
+static void testLongRequests(TestCrypto *test, UInt32 *seed) {
+  static UInt8  plain[kTestRandomLength];
+  static UInt8  expected[kTestRandomLength];
+  static UInt8  buffer[kTestRandomLength];
+  UInt32        roundKeys[kWiiCryptoAESRoundKeyCount];
+  UInt8         key[kWiiCryptoAESKeySize];
+  UInt8         startIV[kWiiCryptoAESBlockSize];
+  UInt8         expectedIV[kWiiCryptoAESBlockSize];
+  UInt8         iv[kWiiCryptoAESBlockSize];
+  UInt8         digest[kWiiCryptoSHA1DigestSize];
+  UInt8         pieceDigest[kWiiCryptoSHA1DigestSize];
+  UInt32        pieceLengths[] = { 1, 63, 64, 65, 4103, kWiiCryptoChunkSize + kWiiCryptoSHA1BlockSize };
+  UInt32        split;
+  bool          matches;
+
+  for (UInt32 i = 0; i < sizeof (plain); i++) {
+    plain[i] = (UInt8) testRandom(seed);
+  }
+  for (UInt32 i = 0; i < sizeof (key); i++) {
+    key[i]     = (UInt8) testRandom(seed);
+    startIV[i] = (UInt8) testRandom(seed);
+  }
+  WiiCrypto::expandAESKey(key, roundKeys);
+  bcopy(startIV, expectedIV, sizeof (expectedIV));
+  WiiCrypto::encryptAESCBCSoftware(roundKeys, expectedIV, plain, expected, sizeof (plain));
+
+  bcopy(plain, buffer, sizeof (buffer));
+  bcopy(startIV, iv, sizeof (iv));
+  TEST_CHECK(runAES(test, key, iv, false, buffer, sizeof (buffer)) == kIOReturnSuccess);
+  TEST_CHECK(memcmp(buffer, expected, sizeof (buffer)) == 0);
+  TEST_CHECK(memcmp(iv, expectedIV, sizeof (iv)) == 0);
+
+  bcopy(plain, buffer, sizeof (buffer));
+  bcopy(startIV, iv, sizeof (iv));
+  matches = true;
+  for (UInt32 offset = 0, round = 0; offset < sizeof (buffer); offset += split, round++) {
+    split = (round % 2) ? 48 : (kWiiCryptoChunkSize + 512 + (round * 16));
+    if (split > (sizeof (buffer) - offset)) {
+      split = sizeof (buffer) - offset;
+    }
+    matches = matches && (runAES(test, key, iv, false, &buffer[offset], split) == kIOReturnSuccess);
+  }
+  TEST_CHECK(matches);
+  TEST_CHECK(memcmp(buffer, expected, sizeof (buffer)) == 0);
+  TEST_CHECK(memcmp(iv, expectedIV, sizeof (iv)) == 0);
+
+  bcopy(startIV, iv, sizeof (iv));
+  matches = true;
+  for (UInt32 offset = 0, round = 0; offset < sizeof (buffer); offset += split, round++) {
+    split = (round % 2) ? (kWiiCryptoChunkSize - 16) : 1024;
+    if (split > (sizeof (buffer) - offset)) {
+      split = sizeof (buffer) - offset;
+    }
+    matches = matches && (runAES(test, key, iv, true, &buffer[offset], split) == kIOReturnSuccess);
+  }
+  TEST_CHECK(matches);
+  TEST_CHECK(memcmp(buffer, plain, sizeof (buffer)) == 0);
+
+  //
+  // The digest does not depend on how the data is split, or on where it was computed.
+  //
+  TEST_CHECK(runSHA1(test, plain, sizeof (plain), sizeof (plain), digest) == kIOReturnSuccess);
+  for (UInt32 i = 0; i < (sizeof (pieceLengths) / sizeof (pieceLengths[0])); i++) {
+    TEST_CHECK(runSHA1(test, plain, sizeof (plain), pieceLengths[i], pieceDigest) == kIOReturnSuccess);
+    TEST_CHECK(memcmp(digest, pieceDigest, sizeof (digest)) == 0);
+  }
+  if (!gReferenceDigestValid) {
+    bcopy(digest, gReferenceDigest, sizeof (digest));
+    gReferenceDigestValid = true;
+  }
+  TEST_CHECK(memcmp(digest, gReferenceDigest, sizeof (digest)) == 0);
+}
+
+//
+// A hung engine times out and is stopped, and the next request succeeds.
+// A lost interrupt is caught by the timeout, and the finished operation is used.
+//
+static void testEngineFailures(TestCrypto *test, bool useInterrupts) {
+  static UInt8  buffer[4096];
+  static UInt8  expected[4096];
+  UInt32        roundKeys[kWiiCryptoAESRoundKeyCount];
+  UInt8         key[kWiiCryptoAESKeySize];
+  UInt8         iv[kWiiCryptoAESBlockSize];
+  UInt8         digest[kWiiCryptoSHA1DigestSize];
+  UInt64        start;
+  UInt64        elapsedMS;
+
+  bzero(key, sizeof (key));
+  bzero(buffer, sizeof (buffer));
+  bzero(iv, sizeof (iv));
+  WiiCrypto::expandAESKey(key, roundKeys);
+  WiiCrypto::encryptAESCBCSoftware(roundKeys, iv, buffer, expected, sizeof (expected));
+
+  test->aes->mode = kTestEngineHang;
+  bzero(iv, sizeof (iv));
+  start = testGetNanoseconds();
+  TEST_CHECK(runAES(test, key, iv, false, buffer, sizeof (buffer)) == kIOReturnTimeout);
+  elapsedMS = (testGetNanoseconds() - start) / 1000000;
+  TEST_CHECK((elapsedMS >= (kWiiCryptoEngineTimeoutMS - 10)) && (elapsedMS < (kWiiCryptoEngineTimeoutMS * 3)));
+  TEST_CHECK(test->aes->readReg32(kWiiAESRegControl) == 0);
+
+  test->aes->mode = kTestEngineNormal;
+  bzero(buffer, sizeof (buffer));
+  bzero(iv, sizeof (iv));
+  TEST_CHECK(runAES(test, key, iv, false, buffer, sizeof (buffer)) == kIOReturnSuccess);
+  TEST_CHECK(memcmp(buffer, expected, sizeof (buffer)) == 0);
+
+  test->sha->mode = kTestEngineHang;
+  TEST_CHECK(runSHA1(test, buffer, sizeof (buffer), sizeof (buffer), digest) == kIOReturnTimeout);
+  TEST_CHECK(test->sha->readReg32(kWiiSHARegControl) == 0);
+  test->sha->mode = kTestEngineNormal;
+
+  if (useInterrupts) {
+    test->aes->mode = kTestEngineLostInterrupt;
+    bzero(buffer, sizeof (buffer));
+    bzero(iv, sizeof (iv));
+    start = testGetNanoseconds();
+    TEST_CHECK(runAES(test, key, iv, false, buffer, sizeof (buffer)) == kIOReturnSuccess);
+    elapsedMS = (testGetNanoseconds() - start) / 1000000;
+    TEST_CHECK(elapsedMS >= (kWiiCryptoEngineTimeoutMS - 10));
+    TEST_CHECK(memcmp(buffer, expected, sizeof (buffer)) == 0);
+    test->aes->mode = kTestEngineNormal;
+  }
+}
+
+int main(void) {
+  TestPlatform      *platform;
+  WiiMem2Allocator  *allocator;
+  TestCrypto        test;
+  void              *region;
+  UInt32            seed;
+  const char        *names[] = { "software", "interrupt", "polled" };
+
+  hostSetLogOutput(false);
+  if (posix_memalign(&region, PAGE_SIZE, kTestMem2Pages * PAGE_SIZE) != 0) {
+    return 1;
+  }
+  allocator = WiiMem2Allocator::withRange(hostMapPhysical(region, kTestMem2Pages * PAGE_SIZE), kTestMem2Pages * PAGE_SIZE);
+  TEST_CHECK(allocator != NULL);
+  TEST_CHECK(hostMapPhysicalAt(gHollywoodRegs, sizeof (gHollywoodRegs), kWiiHollywoodBaseAddress));
+  if (allocator == NULL) {
+    return testFinish("crypto");
+  }
+
+  platform              = new TestPlatform;
+  platform->mem2Service = allocator->getService();
+  IOService::hostSetPlatform(platform);
+
+  for (UInt32 config = 0; config < 3; config++) {
+    seed = 0x41455331;
+    TEST_CHECK(createCrypto(&test, config != 0, config == 1));
+
+    testVectors(&test);
+    testLongRequests(&test, &seed);
+    if (test.aes != NULL) {
+      TEST_CHECK((test.aes->runs > 0) && (test.sha->runs > 0));
+      printf("crypto: %s, %u AES and %u SHA-1 engine runs\n", names[config], test.aes->runs, test.sha->runs);
+      testEngineFailures(&test, config == 1);
+    } else {
+      printf("crypto: %s\n", names[config]);
+    }
+
+    destroyCrypto(&test);
+  }
+
+  platform->release();
+  allocator->release();
+  hostSetLogOutput(true);
+  return testFinish("crypto");
+}
@@ -0,0 +1,607 @@
+//
+//  test_ehci.cpp
+//  Checks the EHCI driver against the software controller model and its virtual devices
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  The driver is started on the model as on Wii U and the UIM functions are called directly in place of the USB
+//  family, with a high speed device behind root port 1. Frames are paced at the USB rate so unlinks wait on the
+//  doorbell and the frame index as on hardware.
+//
+//  Root port handoff is checked for high, full and low speed devices. Control, bulk and interrupt transfers are
+//  checked end to end against the device counters and byte patterns, with short packets, stalls, NAKs, aborts, aborts
+//  nested in the completions of other aborts and deletes of endpoints with pending transfers.
+//
+
+#include "TestHarness.h"
+#include "TestEHCIDriver.h"
+#include "TestEHCIModel.h"
+
+#define kTestTimeoutMS          2000
+
+// Function 1 is the root hub until the USB family moves it.
+#define kTestFunction           2
+#define kTestControlMPS         64
+#define kTestBulkOutEndpoint    1
+#define kTestBulkInEndpoint     2
+#define kTestIntInEndpoint      3
+#define kTestBulkMPS            512
+#define kTestIntMPS             64
+// Every 2^(4 - 1) microframes, once a frame.
+#define kTestIntPollingRate     4
+#define kTestBufferSize         16384
+
+#define kTestHighSpeedPort      1
+#define kTestFullSpeedPort      2
+#define kTestLowSpeedPort       3
+
+//
+// Completion of a single transfer.
+//
+typedef struct {
+  volatile bool     done;
+  volatile UInt32   order;
+  IOReturn          status;
+  UInt32            remaining;
+  pthread_t         thread;
+} TestCompletion;
+
+static volatile UInt32  gCompletionOrder;
+static UInt8            gControlRegs[kTestEHCIRegsSize];
+
+static void completeTransfer(void *target, void *parameter, IOReturn status, UInt32 bufferSizeRemaining) {
+  TestCompletion *completion;
+
+  completion            = (TestCompletion *) parameter;
+  completion->status    = status;
+  completion->remaining = bufferSizeRemaining;
+  completion->order     = ++gCompletionOrder;
+  completion->thread    = pthread_self();
+  completion->done      = true;
+}
+
+//
+// Same as completeTransfer(), a different action for transfers that are not safe to complete when polling.
+//
+static void completeUnsafeTransfer(void *target, void *parameter, IOReturn status, UInt32 bufferSizeRemaining) {
+  completeTransfer(target, parameter, status, bufferSizeRemaining);
+}
+
+static IOUSBCompletion getCompletion(TestCompletion *completion) {
+  IOUSBCompletion usbCompletion;
+
+  bzero(completion, sizeof (*completion));
+  usbCompletion.target    = NULL;
+  usbCompletion.action    = completeTransfer;
+  usbCompletion.parameter = completion;
+  return usbCompletion;
+}
+
+static bool waitCompletion(TestCompletion *completion) {
+  for (UInt32 i = 0; (i < kTestTimeoutMS) && !completion->done; i++) {
+    IOSleep(1);
+  }
+  return completion->done;
+}
+
+static void fillPattern(UInt8 *buffer, UInt32 length, UInt32 sequence) {
+  for (UInt32 i = 0; i < length; i++) {
+    buffer[i] = (UInt8) (sequence + i);
+  }
+}
+
+static bool checkPattern(const UInt8 *buffer, UInt32 length, UInt32 sequence) {
+  for (UInt32 i = 0; i < length; i++) {
+    if (buffer[i] != (UInt8) (sequence + i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// Test fixture, a started driver on a running controller model.
+//
+typedef struct {
+  IOService       *nub;
+  TestEHCIModel   *model;
+  TestEHCI        *ehci;
+  TestUSBEndpoint *control;
+  TestUSBEndpoint *bulkOut;
+  TestUSBEndpoint *bulkIn;
+  TestUSBEndpoint *intIn;
+
+  // Client buffers, the host descriptors map their ranges for good so they are made once.
+  UInt8               *buffer;
+  IOMemoryDescriptor  *bufferDesc;
+} TestFixture;
+
+static bool createFixture(TestFixture *test) {
+  bzero(test, sizeof (*test));
+  test->nub = new IOService;
+  test->nub->init();
+  test->nub->hostSetDeviceMemory(0, gControlRegs, sizeof (gControlRegs));
+
+  test->model = new TestEHCIModel(test->nub);
+  hostAddDevice(test->model, gControlRegs, sizeof (gControlRegs));
+  test->control = test->model->addEndpoint(kTestFunction, 0, kUSBNone);
+  test->bulkOut = test->model->addEndpoint(kTestFunction, kTestBulkOutEndpoint, kUSBOut);
+  test->bulkIn  = test->model->addEndpoint(kTestFunction, kTestBulkInEndpoint, kUSBIn);
+  test->intIn   = test->model->addEndpoint(kTestFunction, kTestIntInEndpoint, kUSBIn);
+  test->model->start();
+
+  test->ehci = new TestEHCI;
+  test->ehci->setName("WiiEHCI");
+  if (!test->ehci->init() || !test->ehci->start(test->nub)) {
+    return false;
+  }
+
+  test->buffer     = (UInt8 *) IOMalloc(kTestBufferSize);
+  test->bufferDesc = IOMemoryDescriptor::withAddress(test->buffer, kTestBufferSize, kIODirectionOutIn);
+  return test->bufferDesc != NULL;
+}
+
+static void destroyFixture(TestFixture *test) {
+  test->ehci->stop(test->nub);
+  test->ehci->release();
+  test->model->stop();
+  hostRemoveDevice(test->model);
+  delete test->model;
+  test->bufferDesc->release();
+  IOFree(test->buffer, kTestBufferSize);
+  test->nub->release();
+}
+
+//
+// Frames advance and the driver keeps the frame number.
+//
+static void testFrames(TestFixture *test) {
+  UInt64 frame;
+
+  frame = test->ehci->GetFrameNumber();
+  IOSleep(20);
+  TEST_CHECK(test->ehci->GetFrameNumber() > frame);
+  TEST_CHECK(test->model->getFrames() > 0);
+}
+
+//
+// A high speed device is enabled by the port reset. A full speed device is not, and is handed to the companion
+// controller after the reset. A low speed device is seen from the data lines and handed over without one.
+//
+static void testRootHub(TestFixture *test) {
+  IOUSBHubPortStatus  status;
+  UInt16              statusFlags;
+
+  test->model->connectPort(kTestHighSpeedPort, kUSBDeviceSpeedHigh);
+  test->model->connectPort(kTestFullSpeedPort, kUSBDeviceSpeedFull);
+  test->model->connectPort(kTestLowSpeedPort, kUSBDeviceSpeedLow);
+
+  for (UInt16 port = kTestHighSpeedPort; port <= kTestLowSpeedPort; port++) {
+    TEST_CHECK(test->ehci->GetRootHubPortStatus(&status, port) == kIOReturnSuccess);
+    TEST_CHECK((USBToHostWord(status.statusFlags) & kHubPortConnection) != 0);
+    TEST_CHECK((USBToHostWord(status.changeFlags) & kHubPortConnection) != 0);
+    TEST_CHECK(test->ehci->SetRootHubPortFeature(kUSBHubPortResetFeature, port) == kIOReturnSuccess);
+  }
+
+  TEST_CHECK(test->ehci->GetRootHubPortStatus(&status, kTestHighSpeedPort) == kIOReturnSuccess);
+  statusFlags = USBToHostWord(status.statusFlags);
+  TEST_CHECK((statusFlags & (kHubPortConnection | kHubPortEnabled | kHubPortHighSpeed))
+             == (kHubPortConnection | kHubPortEnabled | kHubPortHighSpeed));
+  TEST_CHECK((USBToHostWord(status.changeFlags) & kHubPortBeingReset) != 0);
+  TEST_CHECK(!test->model->isPortCompanionOwned(kTestHighSpeedPort));
+  TEST_CHECK(test->model->getPortResets(kTestHighSpeedPort) == 1);
+
+  TEST_CHECK(test->model->isPortCompanionOwned(kTestFullSpeedPort));
+  TEST_CHECK(test->model->getPortResets(kTestFullSpeedPort) == 1);
+  TEST_CHECK(test->model->isPortCompanionOwned(kTestLowSpeedPort));
+  TEST_CHECK(test->model->getPortResets(kTestLowSpeedPort) == 0);
+
+  //
+  // Handed off ports only report power.
+  //
+  TEST_CHECK(test->ehci->GetRootHubPortStatus(&status, kTestFullSpeedPort) == kIOReturnSuccess);
+  TEST_CHECK(USBToHostWord(status.statusFlags) == kHubPortPower);
+  TEST_CHECK(test->ehci->GetRootHubPortStatus(&status, kTestLowSpeedPort) == kIOReturnSuccess);
+  TEST_CHECK(USBToHostWord(status.statusFlags) == kHubPortPower);
+}
+
+//
+// Control transfer reading a device descriptor: setup, an inbound data stage ending in a short packet, and a status stage.
+//
+static void testControl(TestFixture *test) {
+  TestCompletion  setup;
+  TestCompletion  data;
+  TestCompletion  status;
+  UInt8           request[8] = { 0x80, 0x06, 0x00, 0x01, 0x00, 0x00, 18, 0x00 };
+
+  test->model->lock();
+  fillPattern(test->control->controlData, 18, 0x40);
+  test->control->controlLength = 18;
+  test->model->unlock();
+
+  TEST_CHECK(test->ehci->createControlEndpoint(kTestFunction, 0, kTestControlMPS) == kIOReturnSuccess);
+  memcpy(test->buffer, request, sizeof (request));
+  bzero(&test->buffer[64], 64);
+
+  TEST_CHECK(test->ehci->createControlTransfer(kTestFunction, 0, getCompletion(&setup), test->bufferDesc,
+                                               sizeof (request), kUSBNone) == kIOReturnSuccess);
+  TEST_CHECK(test->ehci->createControlTransfer(kTestFunction, 0, getCompletion(&data), test->bufferDesc,
+                                               64, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(test->ehci->createControlTransfer(kTestFunction, 0, getCompletion(&status), NULL, 0, kUSBOut) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&setup) && waitCompletion(&data) && waitCompletion(&status));
+
+  TEST_CHECK((setup.status == kIOReturnSuccess) && (data.status == kIOReturnSuccess) && (status.status == kIOReturnSuccess));
+  TEST_CHECK(data.remaining == (64 - 18));
+  TEST_CHECK(checkPattern(test->buffer, 18, 0x40));
+  TEST_CHECK(memcmp(test->control->setup, request, sizeof (request)) == 0);
+  TEST_CHECK(test->control->setupPackets == 1);
+  TEST_CHECK((setup.order < data.order) && (data.order < status.order));
+}
+
+//
+// Bulk transfers in both directions, spanning several jumbo bounce buffers.
+//
+static void testBulk(TestFixture *test) {
+  TestCompletion  out;
+  TestCompletion  in;
+  UInt32          length;
+
+  TEST_CHECK(test->ehci->createBulkEndpoint(kTestFunction, kTestBulkOutEndpoint, kUSBOut, kTestBulkMPS) == kIOReturnSuccess);
+  TEST_CHECK(test->ehci->createBulkEndpoint(kTestFunction, kTestBulkInEndpoint, kUSBIn, kTestBulkMPS) == kIOReturnSuccess);
+
+  length = 10000;
+  fillPattern(test->buffer, length, 0);
+  TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkOutEndpoint, getCompletion(&out),
+                                            test->bufferDesc, false, length, kUSBOut) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&out));
+  TEST_CHECK((out.status == kIOReturnSuccess) && (out.remaining == 0));
+  TEST_CHECK((test->bulkOut->outBytes == length) && (test->bulkOut->outMismatches == 0));
+
+  bzero(test->buffer, length);
+  TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in),
+                                            test->bufferDesc, false, length, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&in));
+  TEST_CHECK((in.status == kIOReturnSuccess) && (in.remaining == 0));
+  TEST_CHECK(checkPattern(test->buffer, length, 0));
+
+  //
+  // A message ending in the first descriptor completes the transfer short. The controller takes the alternate next
+  // pointer past the rest of it, so the next transfer continues with the next message.
+  //
+  test->model->lock();
+  test->bulkIn->inSequence    = 0;
+  test->bulkIn->messageLength = 1000;
+  test->bulkIn->messageOffset = 0;
+  test->model->unlock();
+
+  TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in),
+                                            test->bufferDesc, true, 8192, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&in));
+  TEST_CHECK((in.status == kIOReturnSuccess) && (in.remaining == (8192 - 1000)));
+  TEST_CHECK(checkPattern(test->buffer, 1000, 0));
+
+  TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in),
+                                            test->bufferDesc, true, 8192, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&in));
+  TEST_CHECK((in.status == kIOReturnSuccess) && (in.remaining == (8192 - 1000)));
+  TEST_CHECK(checkPattern(test->buffer, 1000, 1000));
+
+  test->model->lock();
+  test->bulkIn->messageLength = 0;
+  test->model->unlock();
+}
+
+//
+// Stalled endpoint: the transfer fails, later ones are refused until the stall is cleared.
+//
+static void testStall(TestFixture *test) {
+  TestCompletion out;
+
+  test->model->lock();
+  test->bulkOut->stalled     = true;
+  test->bulkOut->outSequence = 0;
+  test->model->unlock();
+
+  fillPattern(test->buffer, 256, 0);
+  TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkOutEndpoint, getCompletion(&out),
+                                            test->bufferDesc, false, 256, kUSBOut) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&out));
+  TEST_CHECK(out.status == kIOUSBPipeStalled);
+  TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkOutEndpoint, getCompletion(&out),
+                                            test->bufferDesc, false, 256, kUSBOut) == kIOUSBPipeStalled);
+
+  test->model->lock();
+  test->bulkOut->stalled = false;
+  test->model->unlock();
+  TEST_CHECK(test->ehci->clearEndpointStall(kTestFunction, kTestBulkOutEndpoint, kUSBOut) == kIOReturnSuccess);
+
+  TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkOutEndpoint, getCompletion(&out),
+                                            test->bufferDesc, false, 256, kUSBOut) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&out));
+  TEST_CHECK((out.status == kIOReturnSuccess) && (out.remaining == 0));
+  TEST_CHECK(test->bulkOut->outMismatches == 0);
+}
+
+//
+// Polling with the interrupt disabled completes only transfers with the safe action.
+// Transfers queued behind one that is not safe on the same endpoint are left for the workloop too.
+//
+static void testPollInterrupts(TestFixture *test) {
+  TestCompletion  out;
+  TestCompletion  in[2];
+  IOUSBCompletion unsafeCompletion;
+  UInt64          retired;
+  UInt32          waitMS;
+
+  test->model->lock();
+  test->bulkIn->inSequence   = 0;
+  test->bulkOut->outSequence = 0;
+  test->model->unlock();
+  fillPattern(test->buffer, 256, 0);
+
+  //
+  // Hold the gate so the workloop cannot complete anything until the polling is done.
+  //
+  test->nub->disableInterrupt(0);
+  test->ehci->getWorkLoop()->closeGate();
+
+  retired          = test->model->getRetiredTransfers();
+  unsafeCompletion = getCompletion(&in[0]);
+  unsafeCompletion.action = completeUnsafeTransfer;
+  TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkOutEndpoint, getCompletion(&out),
+                                            test->bufferDesc, false, 256, kUSBOut) == kIOReturnSuccess);
+  TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, unsafeCompletion,
+                                            test->bufferDesc, false, 300, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in[1]),
+                                            test->bufferDesc, false, 300, kUSBIn) == kIOReturnSuccess);
+
+  //
+  // Keep polling until all three have retired, and a little after.
+  //
+  waitMS = 0;
+  while ((waitMS < kTestTimeoutMS) && (test->model->getRetiredTransfers() < (retired + 3))) {
+    test->ehci->pollInterrupts(completeTransfer);
+    IOSleep(1);
+    waitMS++;
+  }
+  for (UInt32 i = 0; i < 5; i++) {
+    test->ehci->pollInterrupts(completeTransfer);
+    IOSleep(1);
+  }
+
+  TEST_CHECK(out.done && (out.status == kIOReturnSuccess));
+  TEST_CHECK(pthread_equal(out.thread, pthread_self()));
+  TEST_CHECK(!in[0].done && !in[1].done);
+
+  test->ehci->getWorkLoop()->openGate();
+  test->nub->enableInterrupt(0);
+
+  TEST_CHECK(waitCompletion(&in[0]) && waitCompletion(&in[1]));
+  TEST_CHECK((in[0].status == kIOReturnSuccess) && (in[1].status == kIOReturnSuccess));
+  TEST_CHECK(!pthread_equal(in[0].thread, pthread_self()) && !pthread_equal(in[1].thread, pthread_self()));
+  TEST_CHECK(in[0].order < in[1].order);
+  TEST_CHECK(test->bulkOut->outMismatches == 0);
+}
+
+//
+// High speed interrupt endpoint polled once a frame, NAKing until data is available.
+//
+static void testInterrupt(TestFixture *test) {
+  TestCompletion  in;
+  UInt64          frames;
+  UInt32          naks;
+
+  test->model->lock();
+  test->intIn->inAvailable = 0;
+  test->model->unlock();
+
+  TEST_CHECK(test->ehci->createInterruptEndpoint(kTestFunction, kTestIntInEndpoint, kUSBIn,
+                                                 kTestIntMPS, kTestIntPollingRate) == kIOReturnSuccess);
+  TEST_CHECK(test->ehci->createInterruptTransfer(kTestFunction, kTestIntInEndpoint, getCompletion(&in),
+                                                 test->bufferDesc, kTestIntMPS, kUSBIn) == kIOReturnSuccess);
+
+  frames = test->model->getFrames();
+  IOSleep(40);
+  test->model->lock();
+  frames = test->model->getFrames() - frames;
+  naks   = test->intIn->naks;
+  test->intIn->inSequence  = 0x10;
+  test->intIn->inAvailable = 4;
+  test->model->unlock();
+
+  //
+  // Polled in a single microframe of each frame, give or take the frames around the sleep.
+  //
+  TEST_CHECK((naks > 0) && (naks <= (frames + 2)));
+  TEST_CHECK(!in.done);
+  TEST_CHECK(waitCompletion(&in));
+  TEST_CHECK((in.status == kIOReturnSuccess) && (in.remaining == (kTestIntMPS - 4)));
+  TEST_CHECK(checkPattern(test->buffer, 4, 0x10));
+
+  //
+  // Interrupt endpoints are unlinked once the frame has moved on, not with the doorbell.
+  //
+  test->model->lock();
+  test->intIn->inAvailable = kTestUSBUnlimited;
+  test->model->unlock();
+  TEST_CHECK(test->ehci->deleteEndpoint(kTestFunction, kTestIntInEndpoint, kUSBIn) == kIOReturnSuccess);
+}
+
+//
+// Aborting an endpoint rings the doorbell and completes its pending transfers, the endpoint is usable afterwards.
+//
+static void testAbort(TestFixture *test) {
+  TestCompletion  in[3];
+  TestCompletion  next;
+  UInt32          asyncAdvances;
+
+  test->model->lock();
+  test->bulkIn->nak = true;
+  test->model->unlock();
+
+  for (UInt32 i = 0; i < 3; i++) {
+    TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in[i]),
+                                              test->bufferDesc, false, 512, kUSBIn) == kIOReturnSuccess);
+  }
+  IOSleep(10);
+  TEST_CHECK(!in[0].done);
+
+  asyncAdvances = test->model->getAsyncAdvances();
+  TEST_CHECK(test->ehci->abortEndpoint(kTestFunction, kTestBulkInEndpoint, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(test->model->getAsyncAdvances() > asyncAdvances);
+  for (UInt32 i = 0; i < 3; i++) {
+    TEST_CHECK(waitCompletion(&in[i]) && (in[i].status == kIOReturnAborted));
+  }
+
+  test->model->lock();
+  test->bulkIn->nak        = false;
+  test->bulkIn->inSequence = 0x80;
+  test->model->unlock();
+
+  TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&next),
+                                            test->bufferDesc, false, 512, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&next));
+  TEST_CHECK((next.status == kIOReturnSuccess) && checkPattern(test->buffer, 512, 0x80));
+}
+
+//
+// Abort made from the completion of another abort, as client drivers do when stopping a pair of pipes.
+//
+typedef struct {
+  TestFixture     *test;
+  TestCompletion  in;
+  TestCompletion  out;
+  TestCompletion  next;
+  bool            outAborted;
+  IOReturn        nextStatus;
+} TestNestedAbort;
+
+static void completeNestedAbort(void *target, void *parameter, IOReturn status, UInt32 bufferSizeRemaining) {
+  TestNestedAbort *nested;
+  IOUSBCompletion usbCompletion;
+
+  nested = (TestNestedAbort *) target;
+  completeTransfer(NULL, parameter, status, bufferSizeRemaining);
+
+  //
+  // The nested abort cannot wait on the controller, its transfers still complete before it returns.
+  // A transfer queued straight after must survive the queue being reset once the controller lets go.
+  //
+  nested->test->ehci->abortEndpoint(kTestFunction, kTestBulkOutEndpoint, kUSBOut);
+  nested->outAborted = nested->out.done && (nested->out.status == kIOReturnAborted);
+
+  usbCompletion = getCompletion(&nested->next);
+  fillPattern(nested->test->buffer, 512, nested->test->bulkOut->outSequence);
+  nested->nextStatus = nested->test->ehci->createBulkTransfer(kTestFunction, kTestBulkOutEndpoint, usbCompletion,
+                                                              nested->test->bufferDesc, false, 512, kUSBOut);
+}
+
+//
+// An abort nested within another is finished once the outer abort has waited, on its own doorbell.
+//
+static void testNestedAbort(TestFixture *test) {
+  TestNestedAbort nested;
+  IOUSBCompletion usbCompletion;
+  UInt32          asyncAdvances;
+  UInt32          outMismatches;
+
+  bzero(&nested, sizeof (nested));
+  nested.test = test;
+
+  test->model->lock();
+  test->bulkIn->nak  = true;
+  test->bulkOut->nak = true;
+  outMismatches      = test->bulkOut->outMismatches;
+  test->model->unlock();
+
+  usbCompletion        = getCompletion(&nested.in);
+  usbCompletion.target = &nested;
+  usbCompletion.action = completeNestedAbort;
+  TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, usbCompletion,
+                                            test->bufferDesc, false, 512, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkOutEndpoint, getCompletion(&nested.out),
+                                            test->bufferDesc, false, 512, kUSBOut) == kIOReturnSuccess);
+  IOSleep(5);
+  TEST_CHECK(!nested.in.done && !nested.out.done);
+
+  asyncAdvances = test->model->getAsyncAdvances();
+  TEST_CHECK(test->ehci->abortEndpoint(kTestFunction, kTestBulkInEndpoint, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(test->model->getAsyncAdvances() >= (asyncAdvances + 2));
+  TEST_CHECK(nested.in.done && (nested.in.status == kIOReturnAborted));
+  TEST_CHECK(nested.outAborted);
+  TEST_CHECK(nested.nextStatus == kIOReturnSuccess);
+  TEST_CHECK(!nested.next.done);
+
+  test->model->lock();
+  test->bulkIn->nak  = false;
+  test->bulkOut->nak = false;
+  test->model->unlock();
+
+  TEST_CHECK(waitCompletion(&nested.next) && (nested.next.status == kIOReturnSuccess));
+  test->model->lock();
+  TEST_CHECK(test->bulkOut->outMismatches == outMismatches);
+  test->model->unlock();
+}
+
+//
+// Deleting an endpoint with a pending transfer completes it as aborted and removes the endpoint.
+//
+static void testDelete(TestFixture *test) {
+  TestCompletion in;
+  TestCompletion reopened;
+
+  test->model->lock();
+  test->bulkIn->nak = true;
+  test->model->unlock();
+
+  TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in),
+                                            test->bufferDesc, false, 512, kUSBIn) == kIOReturnSuccess);
+  IOSleep(5);
+  TEST_CHECK(test->ehci->deleteEndpoint(kTestFunction, kTestBulkInEndpoint, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&in) && (in.status == kIOReturnAborted));
+  TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in),
+                                            test->bufferDesc, false, 512, kUSBIn) == kIOUSBEndpointNotFound);
+
+  test->model->lock();
+  test->bulkIn->nak        = false;
+  test->bulkIn->inSequence = 0;
+  test->model->unlock();
+
+  TEST_CHECK(test->ehci->createBulkEndpoint(kTestFunction, kTestBulkInEndpoint, kUSBIn, kTestBulkMPS) == kIOReturnSuccess);
+  TEST_CHECK(test->ehci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&reopened),
+                                            test->bufferDesc, false, 512, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&reopened) && (reopened.status == kIOReturnSuccess));
+  TEST_CHECK(checkPattern(test->buffer, 512, 0));
+}
+
+int main(void) {
+  TestPlatform  *platform;
+  TestFixture   test;
+
+  hostSetLogOutput(false);
+  hostSetProcessorPVR(kTestPVRCafe);
+  platform = new TestPlatform;
+  IOService::hostSetPlatform(platform);
+
+  TEST_CHECK(createFixture(&test));
+  if (gTestFailures != 0) {
+    return testFinish("ehci");
+  }
+  testFrames(&test);
+  testRootHub(&test);
+  testControl(&test);
+  testBulk(&test);
+  testStall(&test);
+  testPollInterrupts(&test);
+  testInterrupt(&test);
+  testAbort(&test);
+  testNestedAbort(&test);
+  testDelete(&test);
+  printf("ehci: %llu frames, %llu transfer descriptors retired, %u async advances\n",
+    (unsigned long long) test.model->getFrames(), (unsigned long long) test.model->getRetiredTransfers(),
+    test.model->getAsyncAdvances());
+  destroyFixture(&test);
+
+  platform->release();
+  return testFinish("ehci");
+}
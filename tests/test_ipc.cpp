@@ -0,0 +1,657 @@
+//
+//  test_ipc.cpp
+//  Runs WiiIPC against a simulated ARM, checking the request queue and the shared log ring
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  The ARM runs on its own thread behind emulated IPC registers. It acknowledges each message by clearing
+//  X1 and setting Y2, raising the IPC interrupt if enabled, and drains the log ring after acknowledging
+//  each doorbell.
+//
+
+#include "TestHarness.h"
+#include "WiiIPC.hpp"
+
+#define CMD_POWEROFF          0xCAFE0001
+#define CMD_REBOOT            0xCAFE0002
+#define CMD_RTC_BIAS          0xCAFE0003
+#define CMD_PRINT             0xCAFE6400
+#define CMD_PRINT_MASK        0xFFFFFF00
+#define CMD_PRINT_RING_INIT   0xCAFE6500
+#define CMD_PRINT_RING_FLUSH  0xCAFE6501
+
+#define kTestRTCBias          0x12345678
+#define kTestOutputLength     (256 * 1024)
+#define kTestWaitMS           5000
+#define kTestProducerCount    4
+#define kTestProducerLines    500
+#define kTestMaxMessages      65536
+#define kTestSyncThreadCount  4
+#define kTestSyncCount        200
+
+class TestARM : public HostDevice {
+  pthread_mutex_t         _mutex;
+  pthread_cond_t          _cond;
+  pthread_t               _thread;
+  IOService               *_nub;
+  bool                    _stop;
+  bool                    _paused;
+  bool                    _supportsRing;
+  bool                    _expectRingAddress;
+  UInt32                  _ppcMsg;
+  UInt32                  _armMsg;
+  UInt32                  _ctrl;
+
+  static void *threadMain(void *param);
+  void drainRing(void);
+
+public:
+  volatile WiiIPCLogRing  *ring;
+  char                    output[kTestOutputLength];
+  UInt32                  messages[kTestMaxMessages];
+  volatile UInt32         outputLength;
+  volatile UInt32         messageCount;
+  volatile UInt32         printCount;
+  volatile UInt32         doorbellCount;
+
+  TestARM(IOService *nub, bool supportsRing);
+  virtual ~TestARM(void);
+  virtual UInt32 readReg32(UInt32 offset);
+  virtual void writeReg32(UInt32 offset, UInt32 data);
+  void setPaused(bool paused);
+  UInt32 getLastMessage(void);
+};
+
+TestARM::TestARM(IOService *nub, bool supportsRing) {
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_cond, NULL);
+  _nub               = nub;
+  _stop              = false;
+  _paused            = false;
+  _supportsRing      = supportsRing;
+  _expectRingAddress = false;
+  _ppcMsg            = 0;
+  _armMsg            = 0;
+  _ctrl              = 0;
+  ring               = NULL;
+  outputLength       = 0;
+  messageCount       = 0;
+  printCount         = 0;
+  doorbellCount      = 0;
+  pthread_create(&_thread, NULL, threadMain, this);
+}
+
+TestARM::~TestARM(void) {
+  pthread_mutex_lock(&_mutex);
+  _stop = true;
+  pthread_cond_broadcast(&_cond);
+  pthread_mutex_unlock(&_mutex);
+  pthread_join(_thread, NULL);
+}
+
+UInt32 TestARM::readReg32(UInt32 offset) {
+  UInt32 data;
+
+  pthread_mutex_lock(&_mutex);
+  switch (offset) {
+    case kWiiIPCPPCMSG:
+      data = _ppcMsg;
+      break;
+    case kWiiIPCPPCCTRL:
+      data = _ctrl;
+      break;
+    case kWiiIPCARMMSG:
+      data = _armMsg;
+      break;
+    default:
+      data = 0;
+      break;
+  }
+  pthread_mutex_unlock(&_mutex);
+  return data;
+}
+
+//
+// X1 is set by writing one, Y1 and Y2 are cleared by writing one, the interrupt enables are plain bits.
+//
+void TestARM::writeReg32(UInt32 offset, UInt32 data) {
+  pthread_mutex_lock(&_mutex);
+  if (offset == kWiiIPCPPCMSG) {
+    _ppcMsg = data;
+  } else if (offset == kWiiIPCPPCCTRL) {
+    _ctrl &= ~(data & (kWiiIPCCTRLY1 | kWiiIPCCTRLY2));
+    _ctrl  = (_ctrl & ~(kWiiIPCCTRLIY1 | kWiiIPCCTRLIY2)) | (data & (kWiiIPCCTRLIY1 | kWiiIPCCTRLIY2));
+    if (data & kWiiIPCCTRLX1) {
+      _ctrl |= kWiiIPCCTRLX1;
+      pthread_cond_broadcast(&_cond);
+    }
+  }
+  pthread_mutex_unlock(&_mutex);
+}
+
+void TestARM::setPaused(bool paused) {
+  pthread_mutex_lock(&_mutex);
+  _paused = paused;
+  pthread_cond_broadcast(&_cond);
+  pthread_mutex_unlock(&_mutex);
+}
+
+//
+// Gets the last message written by the PowerPC, processed or not.
+//
+UInt32 TestARM::getLastMessage(void) {
+  return readReg32(kWiiIPCPPCMSG);
+}
+
+//
+// Consumes everything published in the ring.
+//
+void TestARM::drainRing(void) {
+  UInt32 head;
+  UInt32 tail;
+
+  head = OSReadBigInt32(&ring->head, 0);
+  tail = OSReadBigInt32(&ring->tail, 0);
+  while (tail != head) {
+    if (outputLength < kTestOutputLength) {
+      output[outputLength++] = ring->data[tail % kWiiIPCLogRingDataSize];
+    }
+    tail++;
+  }
+  __sync_synchronize();
+  OSWriteBigInt32(&ring->tail, 0, tail);
+}
+
+void *TestARM::threadMain(void *param) {
+  TestARM *arm = (TestARM *) param;
+  UInt32  message;
+  UInt32  reply;
+  bool    raiseInterrupt;
+
+  pthread_mutex_lock(&arm->_mutex);
+  while (true) {
+    while (!arm->_stop && (arm->_paused || ((arm->_ctrl & kWiiIPCCTRLX1) == 0))) {
+      pthread_cond_wait(&arm->_cond, &arm->_mutex);
+    }
+    if (arm->_stop) {
+      break;
+    }
+
+    message = arm->_ppcMsg;
+    if (arm->messageCount < kTestMaxMessages) {
+      arm->messages[arm->messageCount] = message;
+    }
+    arm->messageCount++;
+    if (arm->_expectRingAddress) {
+      arm->ring = (volatile WiiIPCLogRing *) hostPhysToVirt(message);
+      arm->_expectRingAddress = false;
+      reply = 0;
+    } else if (message == CMD_RTC_BIAS) {
+      reply = kTestRTCBias;
+    } else if ((message & CMD_PRINT_MASK) == CMD_PRINT) {
+      if (arm->outputLength < kTestOutputLength) {
+        arm->output[arm->outputLength++] = (char) (message & ~CMD_PRINT_MASK);
+      }
+      arm->printCount++;
+      reply = 0;
+    } else if ((message == CMD_PRINT_RING_INIT) && arm->_supportsRing) {
+      arm->_expectRingAddress = true;
+      reply = CMD_PRINT_RING_INIT;
+    } else if ((message == CMD_PRINT_RING_FLUSH) && (arm->ring != NULL)) {
+      arm->doorbellCount++;
+      reply = 0;
+    } else {
+      reply = ~message;
+    }
+
+    //
+    // Acknowledge, then drain the ring for a doorbell.
+    //
+    arm->_armMsg = reply;
+    arm->_ctrl   = (arm->_ctrl & ~kWiiIPCCTRLX1) | kWiiIPCCTRLY2;
+    raiseInterrupt = (arm->_ctrl & kWiiIPCCTRLIY2) != 0;
+    pthread_mutex_unlock(&arm->_mutex);
+
+    if (raiseInterrupt) {
+      arm->_nub->hostRaiseInterrupt(0);
+    }
+    if ((message == CMD_PRINT_RING_FLUSH) && (arm->ring != NULL)) {
+      arm->drainRing();
+    }
+    pthread_mutex_lock(&arm->_mutex);
+  }
+  pthread_mutex_unlock(&arm->_mutex);
+  return NULL;
+}
+
+//
+// Test fixture, an IPC nub with emulated registers and a started WiiIPC.
+//
+typedef struct {
+  IOService   *nub;
+  UInt8       *regs;
+  TestARM     *arm;
+  WiiIPC      *ipc;
+} TestIPC;
+
+static bool createIPC(TestIPC *test, bool cafe, bool supportsRing, bool useInterrupt) {
+  OSNumber *interrupt;
+
+  hostSetProcessorPVR(cafe ? 0x70010201 : 0x00087102);
+
+  test->nub = new IOService;
+  test->nub->init();
+  test->regs = (UInt8 *) calloc(1, PAGE_SIZE);
+  test->nub->hostSetDeviceMemory(0, test->regs, PAGE_SIZE);
+  if (useInterrupt) {
+    interrupt = OSNumber::withNumber(30, 32);
+    test->nub->setProperty(gIOInterruptSpecifiersKey, interrupt);
+    interrupt->release();
+  }
+
+  test->arm = new TestARM(test->nub, supportsRing);
+  hostAddDevice(test->arm, test->regs, PAGE_SIZE);
+
+  test->ipc = new WiiIPC;
+  return test->ipc->init() && test->ipc->start(test->nub);
+}
+
+//
+// The IPC service is left running, as on the real system it is never stopped.
+//
+static void destroyIPC(TestIPC *test) {
+  hostRemoveDevice(test->arm);
+  delete test->arm;
+}
+
+//
+// Calls an IPC platform function as a client would, through IOService.
+//
+static IOReturn callIPC(TestIPC *test, const char *functionName, void *param1) {
+  return ((IOService *) test->ipc)->callPlatformFunction(functionName, true, param1, NULL, NULL, NULL);
+}
+
+static bool waitFor(volatile UInt32 *value, UInt32 expected) {
+  for (UInt32 i = 0; i < kTestWaitMS * 10; i++) {
+    if (*value == expected) {
+      return true;
+    }
+    usleep(100);
+  }
+  return *value == expected;
+}
+
+//
+// Async completions, recorded in order.
+//
+#define kTestMaxCompletions   64
+
+static pthread_mutex_t  gCompletionMutex = PTHREAD_MUTEX_INITIALIZER;
+static UInt32           gCompletionParams[kTestMaxCompletions];
+static UInt32           gCompletionReplies[kTestMaxCompletions];
+static volatile UInt32  gCompletionCount;
+
+static void testCompletion(void *target, void *parameter, IOReturn status, UInt32 reply) {
+  pthread_mutex_lock(&gCompletionMutex);
+  if ((status == kIOReturnSuccess) && (gCompletionCount < kTestMaxCompletions)) {
+    gCompletionParams[gCompletionCount]  = (UInt32) (uintptr_t) parameter;
+    gCompletionReplies[gCompletionCount] = reply;
+  }
+  gCompletionCount++;
+  pthread_mutex_unlock(&gCompletionMutex);
+}
+
+static void testRequestQueue(bool useInterrupt) {
+  TestIPC           test;
+  WiiIPCCompletion  completion;
+  UInt32            reply;
+  UInt32            queued;
+  IOReturn          status;
+
+  TEST_CHECK(createIPC(&test, false, false, useInterrupt));
+
+  //
+  // Sync request with a reply.
+  //
+  reply = 0;
+  TEST_CHECK(callIPC(&test, kWiiFuncIPCGetRTCBias, &reply) == kIOReturnSuccess);
+  TEST_CHECK(reply == kTestRTCBias);
+
+  //
+  // Async requests complete in order with their own replies, even when queued behind each other.
+  //
+  gCompletionCount    = 0;
+  completion.action   = testCompletion;
+  completion.target   = NULL;
+  test.arm->setPaused(true);
+  for (UInt32 i = 0; i < 8; i++) {
+    completion.parameter = (void *) (uintptr_t) i;
+    TEST_CHECK(test.ipc->sendMessageAsync(0x1000 + i, &completion) == kIOReturnSuccess);
+  }
+  test.arm->setPaused(false);
+  if (!useInterrupt) {
+    //
+    // Without the interrupt, acknowledgements are only checked when another message is sent.
+    //
+    TEST_CHECK(test.ipc->sendMessageSync(0x2000, &reply) == kIOReturnSuccess);
+    TEST_CHECK(reply == ~0x2000U);
+  }
+  TEST_CHECK(waitFor(&gCompletionCount, 8));
+  for (UInt32 i = 0; i < 8; i++) {
+    TEST_CHECK(gCompletionParams[i] == i);
+    TEST_CHECK(gCompletionReplies[i] == ~(0x1000U + i));
+  }
+
+  //
+  // The request pool is bounded.
+  //
+  gCompletionCount = 0;
+  test.arm->setPaused(true);
+  queued = 0;
+  while (test.ipc->sendMessageAsync(0x3000 + queued, &completion) == kIOReturnSuccess) {
+    queued++;
+    if (queued > kWiiIPCRequestCount) {
+      break;
+    }
+  }
+  TEST_CHECK(queued == kWiiIPCRequestCount);
+  test.arm->setPaused(false);
+  if (!useInterrupt) {
+    //
+    // Completed async requests return to the pool after the send that found them, so sends may not fit at first.
+    //
+    for (UInt32 i = 0; i < kTestWaitMS * 10; i++) {
+      status = test.ipc->sendMessageSync(0x2001, NULL);
+      if (status != kIOReturnNoResources) {
+        break;
+      }
+      usleep(100);
+    }
+    TEST_CHECK(status == kIOReturnSuccess);
+  }
+  TEST_CHECK(waitFor(&gCompletionCount, kWiiIPCRequestCount));
+
+  //
+  // A sync request that times out is abandoned, and the queue keeps working once the ARM catches up.
+  //
+  test.arm->setPaused(true);
+  status = test.ipc->sendMessageSync(0x4000, &reply, 20);
+  TEST_CHECK(status == kIOReturnTimeout);
+  test.arm->setPaused(false);
+  TEST_CHECK(test.ipc->sendMessageSync(0x4001, &reply) == kIOReturnSuccess);
+  TEST_CHECK(reply == ~0x4001U);
+
+  destroyIPC(&test);
+}
+
+//
+// Log producers, each writing numbered lines.
+// Producers wait for ring space first so nothing is truncated, truncation is checked separately.
+//
+typedef struct {
+  TestIPC   *test;
+  UInt32    index;
+} TestProducer;
+
+static void *producerMain(void *param) {
+  TestProducer  *producer = (TestProducer *) param;
+  char          line[64];
+  UInt32        used;
+
+  for (UInt32 i = 0; i < kTestProducerLines; i++) {
+    snprintf(line, sizeof (line), "P%u %u\n", producer->index, i);
+    do {
+      used = OSReadBigInt32(&producer->test->arm->ring->head, 0) - OSReadBigInt32(&producer->test->arm->ring->tail, 0);
+    } while (used > (kWiiIPCLogRingDataSize - (kTestProducerCount * sizeof (line))));
+
+    callIPC(producer->test, kWiiFuncIPCCafeLog, line);
+  }
+  return NULL;
+}
+
+//
+// Checks every producer line arrived once, whole and in order for that producer.
+//
+static void checkProducerOutput(TestARM *arm) {
+  UInt32  nextLine[kTestProducerCount];
+  UInt32  producerIndex;
+  UInt32  lineIndex;
+  UInt32  lineCount;
+  char    *linePtr;
+  char    *endPtr;
+
+  bzero(nextLine, sizeof (nextLine));
+  lineCount = 0;
+  linePtr   = arm->output;
+  endPtr    = arm->output + arm->outputLength;
+  while (linePtr < endPtr) {
+    if (sscanf(linePtr, "P%u %u\n", &producerIndex, &lineIndex) != 2) {
+      TEST_CHECK(false);
+      break;
+    }
+    TEST_CHECK(producerIndex < kTestProducerCount);
+    if (producerIndex < kTestProducerCount) {
+      TEST_CHECK(lineIndex == nextLine[producerIndex]);
+      nextLine[producerIndex] = lineIndex + 1;
+    }
+    lineCount++;
+
+    linePtr = (char *) memchr(linePtr, '\n', endPtr - linePtr);
+    if (linePtr == NULL) {
+      TEST_CHECK(false);
+      break;
+    }
+    linePtr++;
+  }
+  TEST_CHECK(lineCount == (kTestProducerCount * kTestProducerLines));
+}
+
+static void testLogRing(bool useInterrupt) {
+  TestIPC       test;
+  TestProducer  producers[kTestProducerCount];
+  pthread_t     threads[kTestProducerCount];
+  char          expected[kWiiIPCLogRingDataSize * 2];
+  char          line[32];
+  UInt32        expectedLength;
+  UInt32        length;
+  UInt32        lineCount;
+  UInt64        start;
+  UInt64        elapsed;
+
+  TEST_CHECK(createIPC(&test, true, true, useInterrupt));
+  TEST_CHECK(test.arm->ring != NULL);
+  if (test.arm->ring == NULL) {
+    destroyIPC(&test);
+    return;
+  }
+  TEST_CHECK(OSReadBigInt32(&test.arm->ring->magic, 0) == kWiiIPCLogRingMagic);
+  TEST_CHECK(OSReadBigInt32(&test.arm->ring->size, 0) == kWiiIPCLogRingDataSize);
+
+  //
+  // Concurrent producers.
+  //
+  start = testGetNanoseconds();
+  for (UInt32 i = 0; i < kTestProducerCount; i++) {
+    producers[i].test  = &test;
+    producers[i].index = i;
+    pthread_create(&threads[i], NULL, producerMain, &producers[i]);
+  }
+  for (UInt32 i = 0; i < kTestProducerCount; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  //
+  // The last doorbell may be behind an unacknowledged one when polling, any later message picks it up.
+  //
+  if (!useInterrupt) {
+    test.ipc->sendMessageSync(0x5000, NULL);
+    callIPC(&test, kWiiFuncIPCCafeLog, (void *) "");
+  }
+  TEST_CHECK(waitFor(&test.arm->ring->tail, test.arm->ring->head));
+  elapsed = testGetNanoseconds() - start;
+
+  checkProducerOutput(test.arm);
+  TEST_CHECK(test.arm->printCount == 0);
+  TEST_CHECK(test.arm->doorbellCount <= (kTestProducerCount * kTestProducerLines));
+  printf("ipc: %s, %u lines in %llu us, %u doorbells\n", useInterrupt ? "interrupt" : "polled",
+    kTestProducerCount * kTestProducerLines, (unsigned long long) (elapsed / 1000), test.arm->doorbellCount);
+
+  //
+  // With the ARM stalled, strings that do not fit are truncated to the space left.
+  //
+  test.arm->outputLength = 0;
+  test.arm->setPaused(true);
+  expectedLength = 0;
+  lineCount      = 0;
+  while (expectedLength < sizeof (expected)) {
+    snprintf(line, sizeof (line), "line %u\n", lineCount++);
+    callIPC(&test, kWiiFuncIPCCafeLog, line);
+    length = strlen(line);
+    if (length > (sizeof (expected) - expectedLength)) {
+      length = sizeof (expected) - expectedLength;
+    }
+    memcpy(&expected[expectedLength], line, length);
+    expectedLength += length;
+  }
+  test.arm->setPaused(false);
+  if (!useInterrupt) {
+    test.ipc->sendMessageSync(0x5001, NULL);
+    callIPC(&test, kWiiFuncIPCCafeLog, (void *) "");
+  }
+  TEST_CHECK(waitFor(&test.arm->outputLength, kWiiIPCLogRingDataSize));
+  TEST_CHECK(memcmp(test.arm->output, expected, kWiiIPCLogRingDataSize) == 0);
+
+  destroyIPC(&test);
+}
+
+//
+// Firmware without the ring gets one message per character.
+//
+static void testLegacyLog(void) {
+  TestIPC     test;
+  const char  *str = "legacy log line\n";
+
+  TEST_CHECK(createIPC(&test, true, false, false));
+  TEST_CHECK(test.arm->ring == NULL);
+
+  callIPC(&test, kWiiFuncIPCCafeLog, (void *) str);
+  TEST_CHECK(test.arm->outputLength == strlen(str));
+  TEST_CHECK(memcmp(test.arm->output, str, strlen(str)) == 0);
+  TEST_CHECK(test.arm->printCount == strlen(str));
+
+  destroyIPC(&test);
+}
+
+//
+// Concurrent sync senders, each checking its own replies.
+//
+typedef struct {
+  TestIPC   *test;
+  UInt32    index;
+  UInt32    failures;
+} TestSyncSender;
+
+static void *syncSenderMain(void *param) {
+  TestSyncSender  *sender = (TestSyncSender *) param;
+  UInt32          message;
+  UInt32          reply;
+
+  for (UInt32 i = 0; i < kTestSyncCount; i++) {
+    message = (sender->index << 16) | i;
+    if ((sender->test->ipc->sendMessageSync(message, &reply) != kIOReturnSuccess) || (reply != ~message)) {
+      sender->failures++;
+    }
+  }
+  return NULL;
+}
+
+static void testSyncLatency(bool useInterrupt) {
+  TestIPC         test;
+  TestSyncSender  senders[kTestSyncThreadCount];
+  pthread_t       threads[kTestSyncThreadCount];
+  UInt32          reply;
+  UInt64          start;
+  UInt64          elapsed;
+
+  TEST_CHECK(createIPC(&test, false, false, useInterrupt));
+
+  start = testGetNanoseconds();
+  for (UInt32 i = 0; i < kTestSyncCount; i++) {
+    TEST_CHECK(test.ipc->sendMessageSync(i, &reply) == kIOReturnSuccess);
+    TEST_CHECK(reply == ~i);
+  }
+  elapsed = testGetNanoseconds() - start;
+  printf("ipc: %s, sync message round trip %.1f us\n", useInterrupt ? "interrupt" : "polled",
+    (double) elapsed / (kTestSyncCount * 1000));
+
+  for (UInt32 i = 0; i < kTestSyncThreadCount; i++) {
+    senders[i].test     = &test;
+    senders[i].index    = i + 1;
+    senders[i].failures = 0;
+    pthread_create(&threads[i], NULL, syncSenderMain, &senders[i]);
+  }
+  for (UInt32 i = 0; i < kTestSyncThreadCount; i++) {
+    pthread_join(threads[i], NULL);
+    TEST_CHECK(senders[i].failures == 0);
+  }
+
+  destroyIPC(&test);
+}
+
+//
+// Halt and restart go out after queued messages, and are still sent if the ARM stops acknowledging.
+//
+static void testHaltRestart(bool useInterrupt) {
+  TestIPC   test;
+  UInt32    firstMessage;
+  boolean_t intsEnabled;
+  UInt64    start;
+  UInt64    elapsed;
+
+  TEST_CHECK(createIPC(&test, false, false, useInterrupt));
+  TEST_CHECK(PE_halt_restart != NULL);
+
+  test.arm->setPaused(true);
+  firstMessage = test.arm->messageCount;
+  for (UInt32 i = 0; i < 4; i++) {
+    TEST_CHECK(test.ipc->sendMessageAsync(0x6000 + i, NULL) == kIOReturnSuccess);
+  }
+  test.arm->setPaused(false);
+  TEST_CHECK(PE_halt_restart(kPERestartCPU) == 0);
+  TEST_CHECK(test.arm->messageCount == (firstMessage + 5));
+  for (UInt32 i = 0; i < 4; i++) {
+    TEST_CHECK(test.arm->messages[firstMessage + i] == (0x6000 + i));
+  }
+  TEST_CHECK(test.arm->messages[firstMessage + 4] == CMD_REBOOT);
+
+  //
+  // The ARM is stuck on an earlier message, with interrupts disabled as during a panic.
+  //
+  test.arm->setPaused(true);
+  TEST_CHECK(test.ipc->sendMessageAsync(0x7000, NULL) == kIOReturnSuccess);
+  intsEnabled = ml_set_interrupts_enabled(false);
+  start = testGetNanoseconds();
+  TEST_CHECK(PE_halt_restart(kPEHaltCPU) == 0);
+  elapsed = testGetNanoseconds() - start;
+  ml_set_interrupts_enabled(intsEnabled);
+  TEST_CHECK(test.arm->getLastMessage() == CMD_POWEROFF);
+  TEST_CHECK(elapsed < (2ULL * kWiiIPCPollTimeoutUS * 1000));
+  TEST_CHECK(PE_halt_restart(3) == -1);
+  test.arm->setPaused(false);
+
+  destroyIPC(&test);
+}
+
+int main(void) {
+  testRequestQueue(false);
+  testRequestQueue(true);
+  testSyncLatency(false);
+  testSyncLatency(true);
+  testLogRing(false);
+  testLogRing(true);
+  testLegacyLog();
+  testHaltRestart(false);
+  testHaltRestart(true);
+
+  return testFinish("ipc");
+}
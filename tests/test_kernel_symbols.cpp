@@ -0,0 +1,166 @@
+//
+//  test_kernel_symbols.cpp
+//  Checks the hashed kernel symbol index against a linear search of a synthetic symbol table
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  The table is laid out as in a kernel's __LINKEDIT, with debugging, undefined, unnamed and duplicate entries
+//  mixed in with the defined symbols.
+//
+
+#include "TestHarness.h"
+#include "WiiKernelSymbols.hpp"
+
+#define kTestSymbolCount    12000
+#define kTestStrTabSize     (kTestSymbolCount * 48)
+#define kTestLookupRounds   20
+
+static struct nlist gSymTab[kTestSymbolCount];
+static char         gStrTab[kTestStrTabSize];
+static UInt32       gStrTabSize;
+
+//
+// Adds a name to the string table, returning its offset.
+//
+static UInt32 addString(const char *name) {
+  UInt32 offset;
+
+  offset = gStrTabSize;
+  strcpy(&gStrTab[offset], name);
+  gStrTabSize += strlen(name) + 1;
+  return offset;
+}
+
+//
+// Finds a symbol the way the index must, the first defined, non-debugging symbol with the name.
+//
+static UInt32 findReference(const char *name) {
+  for (UInt32 i = 0; i < kTestSymbolCount; i++) {
+    if (((gSymTab[i].n_type & N_STAB) != 0) || ((gSymTab[i].n_type & N_TYPE) == N_UNDF)
+        || (gSymTab[i].n_un.n_strx == 0) || ((UInt32) gSymTab[i].n_un.n_strx >= gStrTabSize)) {
+      continue;
+    }
+    if (strcmp(name, &gStrTab[gSymTab[i].n_un.n_strx]) == 0) {
+      return gSymTab[i].n_value;
+    }
+  }
+  return 0;
+}
+
+//
+// Builds the synthetic table. Every 7th symbol is a debugging entry and every 11th is undefined.
+// Every 13th symbol repeats an earlier name, so names can have skipped, defined and duplicate entries.
+//
+static void buildSymbolTable(void) {
+  char    name[64];
+  UInt32  seed;
+
+  seed        = 0x5359;
+  gStrTabSize = 0;
+  addString("");
+
+  for (UInt32 i = 0; i < kTestSymbolCount; i++) {
+    if ((i > 0) && ((i % 13) == 0)) {
+      gSymTab[i].n_un.n_strx = gSymTab[testRandom(&seed) % i].n_un.n_strx;
+    } else if ((i % 3) == 0) {
+      snprintf(name, sizeof (name), "__ZN%uIOService%uE", i % 97, i);
+      gSymTab[i].n_un.n_strx = addString(name);
+    } else {
+      snprintf(name, sizeof (name), "_kernel_func_%u", i);
+      gSymTab[i].n_un.n_strx = addString(name);
+    }
+
+    gSymTab[i].n_type  = N_SECT | N_EXT;
+    gSymTab[i].n_sect  = 1;
+    gSymTab[i].n_value = 0x1000 + (i * 4);
+    if ((i % 7) == 0) {
+      gSymTab[i].n_type = 0x24;
+    } else if ((i % 11) == 0) {
+      gSymTab[i].n_type = N_UNDF | N_EXT;
+    }
+  }
+
+  //
+  // Unnamed and out of range names are skipped.
+  //
+  gSymTab[1].n_un.n_strx = 0;
+  gSymTab[2].n_un.n_strx = kTestStrTabSize * 2;
+  gSymTab[5].n_type      = N_ABS | N_EXT;
+}
+
+int main(void) {
+  WiiKernelSymbols  *symbols;
+  const char        *symName;
+  char              name[64];
+  UInt32            checked;
+  UInt32            found;
+  UInt64            start;
+  UInt64            indexNS;
+  UInt64            linearNS;
+  volatile UInt32   sink;
+
+  hostSetLogOutput(false);
+  buildSymbolTable();
+
+  TEST_CHECK(WiiKernelSymbols::withSymbolTable(NULL, kTestSymbolCount, gStrTab, gStrTabSize) == NULL);
+  symbols = WiiKernelSymbols::withSymbolTable(gSymTab, kTestSymbolCount, gStrTab, gStrTabSize);
+  TEST_CHECK(symbols != NULL);
+  if (symbols == NULL) {
+    return testFinish("kernel_symbols");
+  }
+  TEST_CHECK(symbols->isIndexed());
+
+  //
+  // Every name in the table resolves as a linear search would, including to the first of duplicates.
+  //
+  checked = 0;
+  found   = 0;
+  for (UInt32 i = 0; i < kTestSymbolCount; i++) {
+    if (((UInt32) gSymTab[i].n_un.n_strx >= gStrTabSize) || (gSymTab[i].n_un.n_strx == 0)) {
+      continue;
+    }
+    symName = &gStrTab[gSymTab[i].n_un.n_strx];
+    TEST_CHECK(symbols->findSymbol(symName) == findReference(symName));
+    if (findReference(symName) != 0) {
+      found++;
+    }
+    checked++;
+  }
+  TEST_CHECK(found > (kTestSymbolCount / 2));
+
+  TEST_CHECK(symbols->findSymbol("_kernel_func_1") == 0);
+  TEST_CHECK(symbols->findSymbol("_kernel_func_2") == 0);
+  TEST_CHECK(symbols->findSymbol("_kernel_func_4") == (0x1000 + (4 * 4)));
+  TEST_CHECK(symbols->findSymbol("_kernel_func_5") == (0x1000 + (5 * 4)));
+  TEST_CHECK(symbols->findSymbol("") == 0);
+  TEST_CHECK(symbols->findSymbol("_not_a_symbol") == 0);
+  TEST_CHECK(symbols->findSymbol("_kernel_func_") == 0);
+  TEST_CHECK(symbols->findSymbol("_kernel_func_40000") == 0);
+
+  //
+  // Lookup cost against a linear search, for names spread over the table.
+  //
+  indexNS  = 0;
+  linearNS = 0;
+  for (UInt32 round = 0; round < kTestLookupRounds; round++) {
+    snprintf(name, sizeof (name), "_kernel_func_%u", kTestSymbolCount - 1 - (round * 37));
+    start = testGetNanoseconds();
+    for (UInt32 i = 0; i < 100; i++) {
+      sink = symbols->findSymbol(name);
+    }
+    indexNS += testGetNanoseconds() - start;
+
+    start = testGetNanoseconds();
+    for (UInt32 i = 0; i < 100; i++) {
+      sink = findReference(name);
+    }
+    linearNS += testGetNanoseconds() - start;
+  }
+  TEST_CHECK(sink == findReference(name));
+  printf("kernel_symbols: %u names checked, %u defined, lookup %.1f ns indexed, %.1f ns linear\n",
+    checked, found, (double) indexNS / (kTestLookupRounds * 100), (double) linearNS / (kTestLookupRounds * 100));
+
+  symbols->release();
+  hostSetLogOutput(true);
+  return testFinish("kernel_symbols");
+}
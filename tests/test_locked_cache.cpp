@@ -0,0 +1,301 @@
+//
+//  test_locked_cache.cpp
+//  Checks the locked cache scratchpad allocator and its DMA queue against the locked cache model
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  The controller runs as on Wii, with HID2 and the DMA registers answered by the model. Main memory is a host buffer
+//  given fake physical addresses. Copies through the scratchpad are compared with memcpy at random offsets and
+//  lengths, with guard lines around each destination. Tickets are checked while the model is still working through
+//  the queue, and the controller must never overrun the 15 command queue.
+//
+
+#include "TestHarness.h"
+#include "TestLockedCacheModel.h"
+
+#define kTestRounds           2000
+#define kTestMemorySize       (64 * kByte)
+#define kTestMemoryLines      (kTestMemorySize / kWiiLockedCacheLineSize)
+#define kTestGuardByte        0xA5
+#define kTestSlowLineNS       2000
+
+static TestLockedCacheModel         *gModel;
+static WiiLockedCacheController     *gController;
+static const WiiLockedCacheService  *gService;
+static UInt8                        *gMemory;
+static IOPhysicalAddress            gMemoryPhysAddr;
+static UInt8                        *gDest;
+static IOPhysicalAddress            gDestPhysAddr;
+
+//
+// The scratchpad is only enabled while something is allocated from it.
+//
+static void testEnable(void) {
+  void *buffer;
+
+  TEST_CHECK(!gModel->isEnabled());
+  buffer = gService->allocate(kWiiLockedCacheLineSize);
+  TEST_CHECK(buffer != NULL);
+  TEST_CHECK(gModel->isEnabled());
+  gService->deallocate(buffer, kWiiLockedCacheLineSize);
+  TEST_CHECK(!gModel->isEnabled());
+}
+
+//
+// Buffers are line aligned, never overlap, and together fill the scratchpad.
+//
+static void testAllocate(UInt32 *seed) {
+  UInt8       *buffers[kWiiLCLineCount];
+  IOByteCount lengths[kWiiLCLineCount];
+  UInt8       *first;
+  UInt8       *last;
+  UInt8       *swapBuffer;
+  IOByteCount swapLength;
+  UInt32      swapIndex;
+  UInt32      count;
+  UInt32      lines;
+  bool        placed;
+  bool        disjoint;
+
+  TEST_CHECK(gService->allocate(0) == NULL);
+  TEST_CHECK(gService->allocate(kWiiLockedCacheSize + 1) == NULL);
+
+  for (UInt32 round = 0; round < 20; round++) {
+    count  = 0;
+    lines  = 0;
+    first  = NULL;
+    last   = NULL;
+    placed = true;
+    while (lines < kWiiLCLineCount) {
+      lengths[count] = (testRandom(seed) % (kWiiLockedCacheLineSize * 16)) + 1;
+      if (lengths[count] > ((kWiiLCLineCount - lines) * kWiiLockedCacheLineSize)) {
+        lengths[count] = (kWiiLCLineCount - lines) * kWiiLockedCacheLineSize;
+      }
+      buffers[count] = (UInt8 *) gService->allocate(lengths[count]);
+      if (buffers[count] == NULL) {
+        placed = false;
+        break;
+      }
+      if (((vm_offset_t) buffers[count]) & (kWiiLockedCacheLineSize - 1)) {
+        placed = false;
+      }
+      if ((first == NULL) || (buffers[count] < first)) {
+        first = buffers[count];
+      }
+      if ((last == NULL) || ((buffers[count] + lengths[count]) > last)) {
+        last = buffers[count] + lengths[count];
+      }
+      lines += (lengths[count] + kWiiLockedCacheLineSize - 1) / kWiiLockedCacheLineSize;
+      count++;
+    }
+    TEST_CHECK(placed);
+    TEST_CHECK((last - first) <= kWiiLockedCacheSize);
+    TEST_CHECK(gService->allocate(kWiiLockedCacheLineSize) == NULL);
+
+    disjoint = true;
+    for (UInt32 i = 0; i < count; i++) {
+      for (UInt32 j = i + 1; j < count; j++) {
+        if ((buffers[i] < (buffers[j] + lengths[j])) && (buffers[j] < (buffers[i] + lengths[i]))) {
+          disjoint = false;
+        }
+      }
+    }
+    TEST_CHECK(disjoint);
+
+    //
+    // Free in a shuffled order, the scratchpad stays enabled until the last one goes.
+    //
+    for (UInt32 i = count; i > 1; i--) {
+      swapIndex          = testRandom(seed) % i;
+      swapBuffer         = buffers[i - 1];
+      swapLength         = lengths[i - 1];
+      buffers[i - 1]     = buffers[swapIndex];
+      lengths[i - 1]     = lengths[swapIndex];
+      buffers[swapIndex] = swapBuffer;
+      lengths[swapIndex] = swapLength;
+    }
+    for (UInt32 i = 0; i < count; i++) {
+      gService->deallocate(buffers[i], lengths[i]);
+      if ((i + 1) < count) {
+        placed = placed && gModel->isEnabled();
+      }
+    }
+    TEST_CHECK(placed);
+    TEST_CHECK(!gModel->isEnabled());
+  }
+}
+
+//
+// DMA needs line aligned buffers, addresses and lengths, within the scratchpad.
+//
+static void testArguments(void) {
+  WiiLockedCacheTicket  ticket;
+  UInt8                 *buffer;
+
+  buffer = (UInt8 *) gService->allocate(kWiiLockedCacheLineSize * 4);
+  TEST_CHECK(buffer != NULL);
+  TEST_CHECK(gService->load(buffer + 4, gMemoryPhysAddr, kWiiLockedCacheLineSize, &ticket) == kIOReturnBadArgument);
+  TEST_CHECK(gService->load(buffer, gMemoryPhysAddr + 4, kWiiLockedCacheLineSize, &ticket) == kIOReturnBadArgument);
+  TEST_CHECK(gService->load(buffer, gMemoryPhysAddr, kWiiLockedCacheLineSize + 4, &ticket) == kIOReturnBadArgument);
+  TEST_CHECK(gService->load(buffer, gMemoryPhysAddr, 0, &ticket) == kIOReturnBadArgument);
+  TEST_CHECK(gService->load(buffer, gMemoryPhysAddr, kWiiLockedCacheLineSize, NULL) == kIOReturnBadArgument);
+  TEST_CHECK(gService->store(gMemory, gDestPhysAddr, kWiiLockedCacheLineSize, &ticket) == kIOReturnBadArgument);
+  TEST_CHECK(gService->load(buffer, gMemoryPhysAddr, kWiiLockedCacheSize + kWiiLockedCacheLineSize, &ticket) == kIOReturnBadArgument);
+  gService->deallocate(buffer, kWiiLockedCacheLineSize * 4);
+}
+
+//
+// Copies main memory to main memory through the scratchpad, the result must match memcpy and touch nothing else.
+//
+static void testCopy(UInt32 *seed) {
+  WiiLockedCacheTicket  ticket;
+  UInt8                 *buffer;
+  UInt32                lines;
+  UInt32                srcLine;
+  UInt32                destLine;
+  UInt32                length;
+  bool                  matches;
+  bool                  guarded;
+  HostDataCacheStats    stats;
+
+  for (UInt32 i = 0; i < kTestMemorySize; i++) {
+    gMemory[i] = (UInt8) testRandom(seed);
+  }
+
+  hostSetDataCacheChecks(true);
+  matches = true;
+  guarded = true;
+  for (UInt32 round = 0; round < kTestRounds; round++) {
+    lines    = (testRandom(seed) % kWiiLCLineCount) + 1;
+    srcLine  = testRandom(seed) % (kTestMemoryLines - lines + 1);
+    destLine = testRandom(seed) % (kTestMemoryLines - lines + 1);
+    length   = lines * kWiiLockedCacheLineSize;
+    memset(gDest, kTestGuardByte, kTestMemorySize);
+
+    //
+    // Change the source through the processor, the load must flush it before the engine reads it.
+    //
+    gMemory[srcLine * kWiiLockedCacheLineSize] = (UInt8) round;
+
+    buffer = (UInt8 *) gService->allocate(length);
+    if (buffer == NULL) {
+      matches = false;
+      break;
+    }
+    if ((gService->load(buffer, gMemoryPhysAddr + (srcLine * kWiiLockedCacheLineSize), length, &ticket) != kIOReturnSuccess)
+        || (gService->store(buffer, gDestPhysAddr + (destLine * kWiiLockedCacheLineSize), length, &ticket) != kIOReturnSuccess)) {
+      matches = false;
+    }
+    gService->wait(ticket);
+    TEST_CHECK(gService->isComplete(ticket) || !matches);
+
+    if (memcmp(buffer, gMemory + (srcLine * kWiiLockedCacheLineSize), length) != 0) {
+      matches = false;
+    }
+    if (memcmp(gDest + (destLine * kWiiLockedCacheLineSize), gMemory + (srcLine * kWiiLockedCacheLineSize), length) != 0) {
+      matches = false;
+    }
+    for (UInt32 i = 0; i < kTestMemorySize; i++) {
+      if (((i < (destLine * kWiiLockedCacheLineSize)) || (i >= ((destLine * kWiiLockedCacheLineSize) + length)))
+          && (gDest[i] != kTestGuardByte)) {
+        guarded = false;
+        break;
+      }
+    }
+    gService->deallocate(buffer, length);
+  }
+  hostGetDataCacheStats(&stats);
+  hostSetDataCacheChecks(false);
+
+  TEST_CHECK(matches);
+  TEST_CHECK(guarded);
+  TEST_CHECK(stats.staleReads == 0);
+}
+
+//
+// Tickets complete in order, and submissions beyond the queue wait for room rather than overrunning it.
+//
+static void testTickets(void) {
+  WiiLockedCacheTicket  first;
+  WiiLockedCacheTicket  middle;
+  WiiLockedCacheTicket  last;
+  UInt8                 *buffer;
+  UInt32                commands;
+  bool                  ordered;
+
+  gModel->setLineDelay(kTestSlowLineNS);
+  buffer = (UInt8 *) gService->allocate(kWiiLockedCacheSize);
+  TEST_CHECK(buffer != NULL);
+
+  //
+  // The whole scratchpad is 4 commands of 128 lines.
+  //
+  commands = gModel->getCommands();
+  TEST_CHECK(gService->load(buffer, gMemoryPhysAddr, kWiiLockedCacheSize, &first) == kIOReturnSuccess);
+  TEST_CHECK((gModel->getCommands() - commands) == (kWiiLCLineCount / kWiiLCDMAMaxLines));
+  TEST_CHECK(!gService->isComplete(first));
+  gService->wait(first);
+  TEST_CHECK(gService->isComplete(first));
+  TEST_CHECK(memcmp(buffer, gMemory, kWiiLockedCacheSize) == 0);
+
+  //
+  // One line at a time, many more commands than the queue holds.
+  //
+  TEST_CHECK(gService->store(buffer, gDestPhysAddr, kWiiLockedCacheLineSize, &first) == kIOReturnSuccess);
+  for (UInt32 i = 1; i < kWiiLCLineCount; i++) {
+    gService->store(buffer + (i * kWiiLockedCacheLineSize), gDestPhysAddr + (i * kWiiLockedCacheLineSize),
+                    kWiiLockedCacheLineSize, &last);
+  }
+  TEST_CHECK(gModel->getQueueLength() > 0);
+  TEST_CHECK(!gService->isComplete(last));
+
+  middle = first + ((last - first) / 2);
+  gService->wait(middle);
+  ordered = true;
+  for (WiiLockedCacheTicket ticket = first; ticket != (middle + 1); ticket++) {
+    ordered = ordered && gService->isComplete(ticket);
+  }
+  TEST_CHECK(ordered);
+  gService->wait(last);
+  TEST_CHECK(gModel->getMaxQueueLength() <= kWiiLCDMAQueueMax);
+  TEST_CHECK(memcmp(gDest, gMemory, kWiiLockedCacheSize) == 0);
+
+  gService->deallocate(buffer, kWiiLockedCacheSize);
+  gModel->setLineDelay(0);
+}
+
+int main(void) {
+  UInt32 seed;
+
+  hostSetLogOutput(false);
+  gModel = new TestLockedCacheModel;
+  hostSetSPRDevice(gModel);
+  gModel->start();
+
+  gMemory     = (UInt8 *) IOMallocContiguous(kTestMemorySize, PAGE_SIZE, &gMemoryPhysAddr);
+  gDest       = (UInt8 *) IOMallocContiguous(kTestMemorySize, PAGE_SIZE, &gDestPhysAddr);
+  gController = WiiLockedCacheController::lockedCacheController(invalidate_dcache);
+  TEST_CHECK((gMemory != NULL) && (gDest != NULL) && (gController != NULL));
+  if (gTestFailures != 0) {
+    return testFinish("locked_cache");
+  }
+  gService = gController->getService();
+
+  seed = 0x4C4F434B;
+  testEnable();
+  testAllocate(&seed);
+  testArguments();
+  testCopy(&seed);
+  testTickets();
+  TEST_CHECK(gModel->getErrors() == 0);
+  printf("locked_cache: %u commands, %u lines loaded, %u lines stored, queue reached %u\n",
+    gModel->getCommands(), gModel->getLoadLines(), gModel->getStoreLines(), gModel->getMaxQueueLength());
+
+  gController->release();
+  gModel->stop();
+  hostSetSPRDevice(NULL);
+  delete gModel;
+  IOFreeContiguous(gMemory, kTestMemorySize);
+  IOFreeContiguous(gDest, kTestMemorySize);
+  return testFinish("locked_cache");
+}
@@ -0,0 +1,275 @@
+//
+//  test_log_ring.cpp
+//  Checks the deferred logging ring against immediate formatting
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  Lines are captured through a stand-in IPC service, as on Wii U.
+//
+
+#include "TestHarness.h"
+#include "WiiLogger.hpp"
+
+#define kTestClassName      "TestClass"
+#define kTestFuncName       "testFunc"
+#define kTestMaxLines       16384
+#define kTestThreadCount    kWiiPICafeCoreCount
+#define kTestThreadLines    4000
+
+//
+// Stand-in IPC service recording each line it is asked to log.
+//
+class TestIPC : public IOService {
+  OSDeclareDefaultStructors(TestIPC);
+
+public:
+  pthread_mutex_t mutex;
+  char            lines[kTestMaxLines][kWiiLogLineLength];
+  UInt32          lineCount;
+
+  TestIPC(void) {
+    pthread_mutex_init(&mutex, NULL);
+    lineCount = 0;
+  }
+
+  IOReturn callPlatformFunction(const OSSymbol *functionName, bool waitForFunction,
+                                void *param1, void *param2, void *param3, void *param4) {
+    if (!functionName->isEqualTo(kWiiFuncIPCCafeLog)) {
+      return kIOReturnUnsupported;
+    }
+
+    pthread_mutex_lock(&mutex);
+    if (lineCount < kTestMaxLines) {
+      strncpy(lines[lineCount], (const char *) param1, kWiiLogLineLength - 1);
+      lines[lineCount][kWiiLogLineLength - 1] = '\0';
+    }
+    lineCount++;
+    pthread_mutex_unlock(&mutex);
+    return kIOReturnSuccess;
+  }
+
+  void reset(void) {
+    pthread_mutex_lock(&mutex);
+    lineCount = 0;
+    pthread_mutex_unlock(&mutex);
+  }
+};
+
+static WiiLogger            *gLogger;
+static const WiiLogService  *gLogService;
+static TestIPC              *gIPC;
+
+static void logDeferred(const char *format, ...) {
+  va_list va;
+
+  va_start(va, format);
+  gLogService->logDeferred(kTestClassName, NULL, kTestFuncName, format, va);
+  va_end(va);
+}
+
+static void logExpected(char *line, const char *format, ...) {
+  va_list va;
+
+  va_start(va, format);
+  logFormatLine(line, kTestClassName, NULL, kTestFuncName, format, va);
+  va_end(va);
+}
+
+//
+// Logs a line through the ring and formats it immediately, both must match exactly.
+//
+#define CHECK_FORMAT(format, args...)                             \
+  do {                                                            \
+    char expected[kWiiLogLineLength];                             \
+    gIPC->reset();                                                \
+    logDeferred(format, ##args);                                  \
+    gLogger->flush();                                             \
+    logExpected(expected, format, ##args);                        \
+    TEST_CHECK(gIPC->lineCount == 1);                             \
+    TEST_CHECK(strcmp(gIPC->lines[0], expected) == 0);            \
+    if (strcmp(gIPC->lines[0], expected) != 0) {                  \
+      printf("  got:      %s  expected: %s", gIPC->lines[0], expected); \
+    }                                                             \
+  } while (0)
+
+//
+// Conversions supported by the kernel printf must format as they would have immediately.
+//
+static void testFormats(void) {
+  const char  *nullString;
+  char        buffer[32];
+  char        expected[kWiiLogLineLength];
+  char        longString[200];
+
+  nullString = NULL;
+  CHECK_FORMAT("plain text");
+  CHECK_FORMAT("%d %i %u %x %X %o %c", -5, 17, 7u, 0xBEEF, 0xCAFE, 8, 'z');
+  CHECK_FORMAT("%08x|%-6d|%+d|% d|%#x|%5.3d", 0x1F, 42, 3, 4, 0xAB, 7);
+  CHECK_FORMAT("%hhd %hd %hx", -3, -300, 0xFFFF);
+  CHECK_FORMAT("%ld %lu %lx", (long) -1, (unsigned long) 123456, (unsigned long) 0xDEADBEEF);
+  CHECK_FORMAT("%lld %llu %qx", (long long) -1234567890123LL, (unsigned long long) 9876543210ULL, 0x123456789ABCULL);
+  CHECK_FORMAT("%zu bytes", (size_t) 4096);
+  CHECK_FORMAT("%p", (void *) 0x1234);
+  CHECK_FORMAT("%s and %s", "alpha", nullString);
+  CHECK_FORMAT("%*d|%-*s|%.*s|%*.*x", 6, 42, 8, "ab", 3, "abcdef", 8, 4, 0x5A);
+  CHECK_FORMAT("100%% done, %d%% left", 5);
+
+  //
+  // String arguments are copied, the caller's buffer may be reused before the line is printed.
+  //
+  strcpy(buffer, "before");
+  gIPC->reset();
+  logDeferred("buffer: %s", buffer);
+  strcpy(buffer, "after");
+  gLogger->flush();
+  logExpected(expected, "buffer: %s", "before");
+  TEST_CHECK((gIPC->lineCount == 1) && (strcmp(gIPC->lines[0], expected) == 0));
+
+  //
+  // Arguments that do not fit in a record are cut off, and the line is marked.
+  //
+  memset(longString, 'x', sizeof (longString) - 1);
+  longString[sizeof (longString) - 1] = '\0';
+  gIPC->reset();
+  logDeferred("long: %s end", longString);
+  gLogger->flush();
+  logExpected(expected, "long: %s end", longString);
+  TEST_CHECK(gIPC->lineCount == 1);
+  TEST_CHECK(strncmp(gIPC->lines[0], expected, strlen(kTestClassName "::" kTestFuncName "(): long: xxxx")) == 0);
+  TEST_CHECK(strlen(gIPC->lines[0]) < strlen(expected));
+
+  gIPC->reset();
+  logDeferred("%d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d",
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30);
+  gLogger->flush();
+  TEST_CHECK(gIPC->lineCount == 1);
+  TEST_CHECK(strstr(gIPC->lines[0], "1 2 3 4 5 ") != NULL);
+  TEST_CHECK(strstr(gIPC->lines[0], "...\n") != NULL);
+  TEST_CHECK(strstr(gIPC->lines[0], " 30") == NULL);
+
+  //
+  // Unsupported conversions stop formatting.
+  //
+  gIPC->reset();
+  logDeferred("value %d then %f %d", 1, 2);
+  gLogger->flush();
+  logExpected(expected, "value %d then ", 1);
+  TEST_CHECK((gIPC->lineCount == 1) && (strcmp(gIPC->lines[0], expected) == 0));
+}
+
+//
+// Lines logged on different CPUs are printed in the order they were logged.
+//
+static void testOrdering(void) {
+  char    expected[kWiiLogLineLength];
+  UInt32  seed;
+  UInt32  cpu;
+  UInt32  count;
+
+  count = kWiiLogRingRecordCount;
+  seed  = 0xC0FFEE;
+  gIPC->reset();
+  for (UInt32 i = 0; i < count; i++) {
+    cpu = testRandom(&seed) % kTestThreadCount;
+    hostSetCPUNumber(cpu);
+    logDeferred("line %u on cpu %u", i, cpu);
+  }
+  hostSetCPUNumber(0);
+  gLogger->flush();
+
+  TEST_CHECK(gIPC->lineCount == count);
+  seed = 0xC0FFEE;
+  for (UInt32 i = 0; i < count; i++) {
+    cpu = testRandom(&seed) % kTestThreadCount;
+    logExpected(expected, "line %u on cpu %u", i, cpu);
+    TEST_CHECK(strcmp(gIPC->lines[i], expected) == 0);
+  }
+}
+
+//
+// Each thread logs as a different CPU with the drain thread running.
+// Every line is either printed intact and in order for its CPU, or counted as dropped.
+//
+static void *testThreadMain(void *param) {
+  UInt32 cpu;
+
+  cpu = (UInt32) (uintptr_t) param;
+  hostSetCPUNumber(cpu);
+  for (UInt32 i = 0; i < kTestThreadLines; i++) {
+    logDeferred("cpu %u line %u tag %s", cpu, i, "payload");
+    if ((i % 64) == 0) {
+      usleep(100);
+    }
+  }
+  return NULL;
+}
+
+static void testConcurrent(void) {
+  pthread_t threads[kTestThreadCount];
+  SInt32    lastLine[kTestThreadCount];
+  UInt32    receivedCount;
+  UInt32    droppedCount;
+  UInt32    dropped;
+  UInt32    cpu;
+  UInt32    line;
+  char      tag[16];
+
+  gIPC->reset();
+  for (UInt32 i = 0; i < kTestThreadCount; i++) {
+    pthread_create(&threads[i], NULL, testThreadMain, (void *) (uintptr_t) i);
+  }
+  for (UInt32 i = 0; i < kTestThreadCount; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  gLogger->flush();
+
+  for (UInt32 i = 0; i < kTestThreadCount; i++) {
+    lastLine[i] = -1;
+  }
+  receivedCount = 0;
+  droppedCount  = 0;
+  TEST_CHECK(gIPC->lineCount <= kTestMaxLines);
+  for (UInt32 i = 0; (i < gIPC->lineCount) && (i < kTestMaxLines); i++) {
+    if (sscanf(gIPC->lines[i], "WiiLogger: %u lines dropped on CPU %u", &dropped, &cpu) == 2) {
+      droppedCount += dropped;
+      continue;
+    }
+
+    TEST_CHECK(sscanf(gIPC->lines[i], kTestClassName "::" kTestFuncName "(): cpu %u line %u tag %15s",
+      &cpu, &line, tag) == 3);
+    TEST_CHECK(cpu < kTestThreadCount);
+    TEST_CHECK(strcmp(tag, "payload") == 0);
+    if (cpu < kTestThreadCount) {
+      TEST_CHECK((SInt32) line > lastLine[cpu]);
+      lastLine[cpu] = line;
+    }
+    receivedCount++;
+  }
+
+  TEST_CHECK((receivedCount + droppedCount) == (kTestThreadCount * kTestThreadLines));
+  printf("log_ring: %u lines from %u CPUs, %u printed, %u dropped\n",
+    kTestThreadCount * kTestThreadLines, kTestThreadCount, receivedCount, droppedCount);
+}
+
+int main(void) {
+  hostSetProcessorPVR(0x70010201);
+  hostSetLogOutput(false);
+
+  gLogger = WiiLogger::logger();
+  TEST_CHECK(gLogger != NULL);
+  if (gLogger == NULL) {
+    return testFinish("log_ring");
+  }
+  gLogService = gLogger->getService();
+
+  gIPC = new TestIPC;
+  IOService::hostPublishService(gIPC, "WiiIPC");
+
+  testFormats();
+  testOrdering();
+  testConcurrent();
+
+  gLogger->release();
+  hostSetLogOutput(true);
+  return testFinish("log_ring");
+}
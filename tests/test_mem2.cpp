@@ -0,0 +1,334 @@
+//
+//  test_mem2.cpp
+//  Checks the MEM2 slab allocator and client magazines
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  The MEM2 region is a host buffer given fake physical addresses, slabs map it through the stand-in descriptors.
+//
+
+#include "TestHarness.h"
+#include "WiiMem2Allocator.hpp"
+
+#define kTestPageCount      64
+#define kTestRandomCount    200
+#define kTestRandomRounds   20000
+
+static WiiMem2Allocator     *gAllocator;
+static const WiiMem2Service *gService;
+static UInt8                *gRegion;
+static IOPhysicalAddress    gRegionPhysAddr;
+
+typedef struct {
+  IOPhysicalAddress physAddr;
+  UInt8             *buffer;
+  IOByteCount       length;
+  IOByteCount       allocLength;
+  UInt8             pattern;
+} TestAllocation;
+
+//
+// Gets an allocator statistic from the published properties.
+//
+static UInt32 getStatistic(IOService *service, const char *key) {
+  OSDictionary  *statsDict;
+  OSNumber      *number;
+
+  gAllocator->publishStatistics(service);
+  statsDict = OSDynamicCast(OSDictionary, service->getProperty(kWiiMem2StatisticsKey));
+  if (statsDict == NULL) {
+    return 0xFFFFFFFF;
+  }
+  number = OSDynamicCast(OSNumber, statsDict->getObject(key));
+  return (number != NULL) ? number->unsigned32BitValue() : 0xFFFFFFFF;
+}
+
+//
+// Gets the length an allocation is rounded up to.
+//
+static IOByteCount getAllocLength(IOByteCount length) {
+  IOByteCount allocLength;
+
+  if (length > kWiiMem2SlabMaxSize) {
+    return (length + PAGE_MASK) & ~(PAGE_MASK);
+  }
+  for (allocLength = kWiiMem2MinAlignment; allocLength < length; allocLength <<= 1);
+  return allocLength;
+}
+
+//
+// Allocates a buffer and checks its placement.
+//
+static bool allocateChecked(WiiMem2Client *client, IOByteCount length, UInt32 cacheMode, TestAllocation *allocation) {
+  IOPhysicalAddress physAddr;
+  void              *buffer;
+
+  if (gService->allocate(client, length, cacheMode, &physAddr, &buffer) != kIOReturnSuccess) {
+    return false;
+  }
+
+  allocation->physAddr    = physAddr;
+  allocation->buffer      = (UInt8 *) buffer;
+  allocation->length      = length;
+  allocation->allocLength = getAllocLength(length);
+
+  TEST_CHECK((physAddr >= gRegionPhysAddr) && ((physAddr + allocation->allocLength) <= (gRegionPhysAddr + (kTestPageCount * PAGE_SIZE))));
+  TEST_CHECK(hostPhysToVirt(physAddr) == buffer);
+  if (length > kWiiMem2SlabMaxSize) {
+    TEST_CHECK((physAddr & PAGE_MASK) == 0);
+  } else {
+    TEST_CHECK((physAddr & (allocation->allocLength - 1)) == 0);
+    TEST_CHECK((physAddr / PAGE_SIZE) == ((physAddr + allocation->allocLength - 1) / PAGE_SIZE));
+  }
+  return true;
+}
+
+//
+// Size classes, alignment, and magazine refills and flushes.
+//
+static void testSizeClasses(void) {
+  WiiMem2Client   *client;
+  TestAllocation  allocations[kWiiMem2MagazineSize * 2];
+  IOByteCount     lengths[] = { 1, 31, 32, 33, 64, 100, 128, 255, 256, 500, 512, 1000, 1024, 1025, 2047, 2048 };
+  UInt32          hits;
+
+  client = gService->createClient("sizes", 0);
+  TEST_CHECK(client != NULL);
+
+  for (UInt32 i = 0; i < (sizeof (lengths) / sizeof (lengths[0])); i++) {
+    for (UInt32 mode = 0; mode < kWiiMem2CacheModeCount; mode++) {
+      TEST_CHECK(allocateChecked(client, lengths[i], mode, &allocations[0]));
+      TEST_CHECK(client->bytesInUse == allocations[0].allocLength);
+      gService->deallocate(client, allocations[0].physAddr);
+      TEST_CHECK(client->bytesInUse == 0);
+    }
+  }
+
+  gService->destroyClient(client);
+
+  //
+  // The first allocation refills half a magazine, the rest of that half are hits.
+  //
+  client = gService->createClient("magazine", 0);
+  hits   = client->magazineHitCount;
+  for (UInt32 i = 0; i < (kWiiMem2MagazineSize / 2); i++) {
+    TEST_CHECK(allocateChecked(client, 700, kWiiMem2CacheModeInhibit, &allocations[i]));
+  }
+  TEST_CHECK(client->magazineHitCount == (hits + (kWiiMem2MagazineSize / 2) - 1));
+  TEST_CHECK(client->magazines[kWiiMem2CacheModeInhibit][5].count == 0);
+  for (UInt32 i = (kWiiMem2MagazineSize / 2); i < (kWiiMem2MagazineSize * 2); i++) {
+    TEST_CHECK(allocateChecked(client, 700, kWiiMem2CacheModeInhibit, &allocations[i]));
+  }
+
+  //
+  // Freeing past a full magazine flushes half of it back to the slabs.
+  //
+  for (UInt32 i = 0; i < (kWiiMem2MagazineSize * 2); i++) {
+    gService->deallocate(client, allocations[i].physAddr);
+    TEST_CHECK(client->magazines[kWiiMem2CacheModeInhibit][5].count <= kWiiMem2MagazineSize);
+  }
+  TEST_CHECK(client->magazines[kWiiMem2CacheModeInhibit][5].count > (kWiiMem2MagazineSize / 2));
+  TEST_CHECK(client->bytesInUse == 0);
+
+  gService->destroyClient(client);
+}
+
+//
+// Random allocations and frees across clients never overlap, and all memory is returned once freed.
+//
+static void testRandomAllocations(IOService *service) {
+  WiiMem2Client   *clients[3];
+  TestAllocation  *allocations;
+  UInt32          allocationClients[kTestRandomCount];
+  UInt32          seed;
+  UInt32          index;
+  UInt32          failures;
+  IOByteCount     length;
+
+  allocations = (TestAllocation *) calloc(kTestRandomCount, sizeof (TestAllocation));
+  clients[0]  = gService->createClient("random0", 0);
+  clients[1]  = gService->createClient("random1", 0);
+  clients[2]  = gService->createClient("random2", 0);
+
+  seed     = 0x4D454D32;
+  failures = 0;
+  for (UInt32 round = 0; round < kTestRandomRounds; round++) {
+    index = testRandom(&seed) % kTestRandomCount;
+    if (allocations[index].buffer != NULL) {
+      //
+      // Buffer contents must be untouched by any other allocation.
+      //
+      for (UInt32 i = 0; i < allocations[index].length; i++) {
+        if (allocations[index].buffer[i] != allocations[index].pattern) {
+          TEST_CHECK(allocations[index].buffer[i] == allocations[index].pattern);
+          break;
+        }
+      }
+      gService->deallocate(clients[allocationClients[index]], allocations[index].physAddr);
+      allocations[index].buffer = NULL;
+      continue;
+    }
+
+    length = ((testRandom(&seed) % 8) == 0) ? ((testRandom(&seed) % (3 * PAGE_SIZE)) + 1) : ((testRandom(&seed) % kWiiMem2SlabMaxSize) + 1);
+    allocationClients[index] = testRandom(&seed) % 3;
+    if (!allocateChecked(clients[allocationClients[index]], length, testRandom(&seed) % kWiiMem2CacheModeCount, &allocations[index])) {
+      allocations[index].buffer = NULL;
+      failures++;
+      continue;
+    }
+    allocations[index].pattern = (UInt8) round;
+    memset(allocations[index].buffer, allocations[index].pattern, length);
+  }
+
+  for (UInt32 i = 0; i < kTestRandomCount; i++) {
+    if (allocations[i].buffer != NULL) {
+      gService->deallocate(clients[allocationClients[i]], allocations[i].physAddr);
+    }
+  }
+  TEST_CHECK(getStatistic(service, kWiiMem2StatLargeKey) == 0);
+  for (UInt32 i = 0; i < 3; i++) {
+    TEST_CHECK(clients[i]->bytesInUse == 0);
+    gService->destroyClient(clients[i]);
+  }
+
+  //
+  // With the magazines returned, only one empty slab per size class and mode may remain.
+  //
+  TEST_CHECK(getStatistic(service, kWiiMem2StatSlabsKey) <= (kWiiMem2CacheModeCount * kWiiMem2SizeClassCount));
+  TEST_CHECK(getStatistic(service, kWiiMem2StatMappedKey) == (getStatistic(service, kWiiMem2StatSlabsKey) * PAGE_SIZE));
+  printf("mem2: %u rounds, %u allocation failures\n", kTestRandomRounds, failures);
+  free(allocations);
+}
+
+//
+// Quotas, large allocations, and invalid frees.
+// Run first, so the only slab left behind is at the start of the region and large allocations fill the rest.
+//
+static void testLimits(IOService *service) {
+  WiiMem2Client   *client;
+  TestAllocation  allocation;
+  TestAllocation  large[kTestPageCount];
+  UInt32          largeCount;
+  UInt32          slabCount;
+  IOPhysicalAddress physAddr;
+  void            *buffer;
+
+  client = gService->createClient("quota", 1024);
+  TEST_CHECK(allocateChecked(client, 512, kWiiMem2CacheModeCopyback, &allocation));
+  TEST_CHECK(gService->allocate(client, 1024, kWiiMem2CacheModeCopyback, &physAddr, &buffer) == kIOReturnNoSpace);
+  TEST_CHECK(client->failureCount == 1);
+  TEST_CHECK(gService->allocate(client, 0, kWiiMem2CacheModeCopyback, &physAddr, &buffer) == kIOReturnBadArgument);
+  TEST_CHECK(gService->allocate(client, 32, kWiiMem2CacheModeCount, &physAddr, &buffer) == kIOReturnBadArgument);
+
+  //
+  // Frees of addresses that were never allocated are ignored.
+  //
+  gService->deallocate(client, gRegionPhysAddr + (kTestPageCount * PAGE_SIZE));
+  gService->deallocate(client, allocation.physAddr + 16);
+  gService->deallocate(client, 0);
+  TEST_CHECK(client->bytesInUse == 512);
+  gService->deallocate(client, allocation.physAddr);
+  TEST_CHECK(client->bytesInUse == 0);
+  gService->destroyClient(client);
+
+  //
+  // Large allocations get their own pages until the region runs out, and give them back when freed.
+  //
+  client    = gService->createClient("large", 0);
+  slabCount = getStatistic(service, kWiiMem2StatSlabsKey);
+  for (largeCount = 0; largeCount < kTestPageCount; largeCount++) {
+    if (!allocateChecked(client, (2 * PAGE_SIZE) + 1, kWiiMem2CacheModeCopyback, &large[largeCount])) {
+      break;
+    }
+    TEST_CHECK(large[largeCount].allocLength == (3 * PAGE_SIZE));
+  }
+  TEST_CHECK(largeCount == ((kTestPageCount - slabCount) / 3));
+  TEST_CHECK(getStatistic(service, kWiiMem2StatLargeKey) == largeCount);
+  TEST_CHECK(client->failureCount == 1);
+
+  gService->deallocate(client, large[0].physAddr + PAGE_SIZE);
+  TEST_CHECK(getStatistic(service, kWiiMem2StatLargeKey) == largeCount);
+  for (UInt32 i = 0; i < largeCount; i++) {
+    gService->deallocate(client, large[i].physAddr);
+  }
+  TEST_CHECK(getStatistic(service, kWiiMem2StatLargeKey) == 0);
+  TEST_CHECK(getStatistic(service, kWiiMem2StatSlabsKey) == slabCount);
+  TEST_CHECK(allocateChecked(client, (kTestPageCount - slabCount) * PAGE_SIZE, kWiiMem2CacheModeInhibit, &large[0]));
+  gService->deallocate(client, large[0].physAddr);
+  gService->destroyClient(client);
+}
+
+//
+// Client statistics are published under the platform expert.
+//
+static void testStatistics(IOService *service) {
+  WiiMem2Client   *client;
+  TestAllocation  allocation;
+  OSDictionary    *statsDict;
+  OSDictionary    *clientDict;
+  OSArray         *clientsArray;
+  OSString        *name;
+  OSNumber        *number;
+
+  client = gService->createClient("stats", 4096);
+  TEST_CHECK(allocateChecked(client, 64, kWiiMem2CacheModeCopyback, &allocation));
+  gAllocator->publishStatistics(service);
+
+  statsDict    = OSDynamicCast(OSDictionary, service->getProperty(kWiiMem2StatisticsKey));
+  TEST_CHECK(statsDict != NULL);
+  clientsArray = (statsDict != NULL) ? OSDynamicCast(OSArray, statsDict->getObject(kWiiMem2StatClientsKey)) : NULL;
+  TEST_CHECK((clientsArray != NULL) && (clientsArray->getCount() == 1));
+  clientDict   = (clientsArray != NULL) ? OSDynamicCast(OSDictionary, clientsArray->getObject(0)) : NULL;
+  TEST_CHECK(clientDict != NULL);
+  if (clientDict != NULL) {
+    name = OSDynamicCast(OSString, clientDict->getObject(kWiiMem2StatNameKey));
+    TEST_CHECK((name != NULL) && (strcmp(name->getCStringNoCopy(), "stats") == 0));
+    number = OSDynamicCast(OSNumber, clientDict->getObject(kWiiMem2StatQuotaKey));
+    TEST_CHECK((number != NULL) && (number->unsigned32BitValue() == 4096));
+    number = OSDynamicCast(OSNumber, clientDict->getObject(kWiiMem2StatInUseKey));
+    TEST_CHECK((number != NULL) && (number->unsigned32BitValue() == 64));
+    number = OSDynamicCast(OSNumber, clientDict->getObject(kWiiMem2StatAllocationsKey));
+    TEST_CHECK((number != NULL) && (number->unsigned32BitValue() == 1));
+  }
+  TEST_CHECK(getStatistic(service, kWiiMem2StatTotalKey) == (kTestPageCount * PAGE_SIZE));
+
+  gService->deallocate(client, allocation.physAddr);
+  gService->destroyClient(client);
+}
+
+int main(void) {
+  IOService *service;
+  void      *region;
+
+  hostSetLogOutput(false);
+  if (posix_memalign(&region, PAGE_SIZE, (kTestPageCount + 1) * PAGE_SIZE) != 0) {
+    return 1;
+  }
+  gRegion         = (UInt8 *) region;
+  gRegionPhysAddr = hostMapPhysical(gRegion, (kTestPageCount + 1) * PAGE_SIZE);
+
+  //
+  // The region is trimmed to whole pages.
+  //
+  TEST_CHECK(WiiMem2Allocator::withRange(gRegionPhysAddr + 1, PAGE_SIZE) == NULL);
+  gAllocator = WiiMem2Allocator::withRange(gRegionPhysAddr + 1, (kTestPageCount + 1) * PAGE_SIZE - 1);
+  TEST_CHECK(gAllocator != NULL);
+  if (gAllocator == NULL) {
+    return testFinish("mem2");
+  }
+  gRegionPhysAddr += PAGE_SIZE;
+  gService = gAllocator->getService();
+  service  = new IOService;
+
+  testLimits(service);
+  testSizeClasses();
+  testRandomAllocations(service);
+  testStatistics(service);
+
+  gAllocator->release();
+  TEST_CHECK(gService->createClient("released", 0) == NULL);
+  service->release();
+  free(region);
+  hostSetLogOutput(true);
+  return testFinish("mem2");
+}
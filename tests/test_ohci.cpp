@@ -0,0 +1,994 @@
+//
+//  test_ohci.cpp
+//  Checks the OHCI driver against the software controller model and its virtual devices
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  The driver is started on the model as on Wii U, so buffers may be anywhere in memory, and the UIM functions are
+//  called directly in place of the USB family. Frames are paced at the USB rate so retire waits, done queue delays,
+//  and isochronous frame numbers behave as on hardware.
+//
+//  Control, bulk, interrupt and isochronous transfers are checked end to end against the device counters and byte
+//  patterns, with short packets, stalls, NAKs, aborts and deletes of endpoints with pending transfers.
+//
+//  Outbound copies through the locked cache are checked with the locked cache model answering the DMA registers,
+//  as the Wii U has no locked cache DMA the driver is simply handed the service.
+//
+
+#include "TestHarness.h"
+#include "TestOHCIDriver.h"
+#include "TestOHCIModel.h"
+#include "TestLockedCacheModel.h"
+
+#define kTestTimeoutMS          2000
+
+// Function 1 is the root hub until the USB family moves it.
+#define kTestFunction           2
+#define kTestControlMPS         8
+#define kTestBulkOutEndpoint    1
+#define kTestBulkInEndpoint     2
+#define kTestIntInEndpoint      3
+#define kTestIsoInEndpoint      4
+#define kTestIsoOutEndpoint     5
+#define kTestBulkMPS            64
+#define kTestIntMPS             8
+#define kTestIntPollingRate     8
+#define kTestIsoMPS             192
+#define kTestIsoInPacketLength  150
+#define kTestIsoFrames          8
+#define kTestIsoOutAttempts     3
+#define kTestIsoOutIntervalUS   4000
+#define kTestBufferSize         8192
+
+// Interrupt tree fill, functions with endpoints 1 to 15 each.
+#define kTestTreeFunction       10
+#define kTestTreeFastFunction   20
+#define kTestTreeEndpoints      15
+#define kTestTreePerNode        2
+#define kTestTreeFastMPS        64
+
+//
+// Completion of a single transfer.
+//
+typedef struct {
+  volatile bool     done;
+  volatile UInt32   order;
+  IOReturn          status;
+  UInt32            remaining;
+  pthread_t         thread;
+} TestCompletion;
+
+static volatile UInt32  gCompletionOrder;
+static UInt8            gControlRegs[kTestOHCIRegsSize];
+
+static void completeTransfer(void *target, void *parameter, IOReturn status, UInt32 bufferSizeRemaining) {
+  TestCompletion *completion;
+
+  completion            = (TestCompletion *) parameter;
+  completion->status    = status;
+  completion->remaining = bufferSizeRemaining;
+  completion->order     = ++gCompletionOrder;
+  completion->thread    = pthread_self();
+  completion->done      = true;
+}
+
+//
+// Same as completeTransfer(), a different action for transfers that are not safe to complete when polling.
+//
+static void completeUnsafeTransfer(void *target, void *parameter, IOReturn status, UInt32 bufferSizeRemaining) {
+  completeTransfer(target, parameter, status, bufferSizeRemaining);
+}
+
+static void completeIsochTransfer(void *target, void *parameter, IOReturn status, IOUSBIsocFrame *frames) {
+  completeTransfer(target, parameter, status, 0);
+}
+
+static IOUSBCompletion getCompletion(TestCompletion *completion) {
+  IOUSBCompletion usbCompletion;
+
+  bzero(completion, sizeof (*completion));
+  usbCompletion.target    = NULL;
+  usbCompletion.action    = completeTransfer;
+  usbCompletion.parameter = completion;
+  return usbCompletion;
+}
+
+static bool waitCompletion(TestCompletion *completion) {
+  for (UInt32 i = 0; (i < kTestTimeoutMS) && !completion->done; i++) {
+    IOSleep(1);
+  }
+  return completion->done;
+}
+
+static void fillPattern(UInt8 *buffer, UInt32 length, UInt32 sequence) {
+  for (UInt32 i = 0; i < length; i++) {
+    buffer[i] = (UInt8) (sequence + i);
+  }
+}
+
+static bool checkPattern(const UInt8 *buffer, UInt32 length, UInt32 sequence) {
+  for (UInt32 i = 0; i < length; i++) {
+    if (buffer[i] != (UInt8) (sequence + i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// Test fixture, a started driver on a running controller model.
+//
+typedef struct {
+  IOService       *nub;
+  TestOHCIModel   *model;
+  TestOHCI        *ohci;
+  TestUSBEndpoint *control;
+  TestUSBEndpoint *bulkOut;
+  TestUSBEndpoint *bulkIn;
+  TestUSBEndpoint *intIn;
+  TestUSBEndpoint *isoIn;
+  TestUSBEndpoint *isoOut;
+
+  // Client buffers, the host descriptors map their ranges for good so they are made once.
+  UInt8               *buffer;
+  IOMemoryDescriptor  *bufferDesc;
+} TestFixture;
+
+static bool createFixture(TestFixture *test) {
+  bzero(test, sizeof (*test));
+  test->nub = new IOService;
+  test->nub->init();
+  test->nub->hostSetDeviceMemory(0, gControlRegs, sizeof (gControlRegs));
+
+  test->model = new TestOHCIModel(test->nub);
+  hostAddDevice(test->model, gControlRegs, sizeof (gControlRegs));
+  test->control = test->model->addEndpoint(kTestFunction, 0, kUSBNone);
+  test->bulkOut = test->model->addEndpoint(kTestFunction, kTestBulkOutEndpoint, kUSBOut);
+  test->bulkIn  = test->model->addEndpoint(kTestFunction, kTestBulkInEndpoint, kUSBIn);
+  test->intIn   = test->model->addEndpoint(kTestFunction, kTestIntInEndpoint, kUSBIn);
+  test->isoIn   = test->model->addEndpoint(kTestFunction, kTestIsoInEndpoint, kUSBIn);
+  test->isoOut  = test->model->addEndpoint(kTestFunction, kTestIsoOutEndpoint, kUSBOut);
+  test->model->start(kTestOHCIFrameIntervalUS);
+
+  test->ohci = new TestOHCI;
+  test->ohci->setName("WiiOHCI");
+  if (!test->ohci->init() || !test->ohci->start(test->nub)) {
+    return false;
+  }
+
+  test->buffer     = (UInt8 *) IOMalloc(kTestBufferSize);
+  test->bufferDesc = IOMemoryDescriptor::withAddress(test->buffer, kTestBufferSize, kIODirectionOutIn);
+  return test->bufferDesc != NULL;
+}
+
+static void destroyFixture(TestFixture *test) {
+  test->ohci->stop(test->nub);
+  test->ohci->release();
+  test->model->stop();
+  hostRemoveDevice(test->model);
+  delete test->model;
+  test->bufferDesc->release();
+  IOFree(test->buffer, kTestBufferSize);
+  test->nub->release();
+}
+
+//
+// Frames advance and the driver keeps the frame number.
+//
+static void testFrames(TestFixture *test) {
+  UInt64 frame;
+
+  frame = test->ohci->GetFrameNumber();
+  IOSleep(20);
+  TEST_CHECK(test->ohci->GetFrameNumber() > frame);
+  TEST_CHECK(test->model->getFrames() > 0);
+}
+
+//
+// Root hub ports see the connect and complete a reset.
+//
+static void testRootHub(TestFixture *test) {
+  IOUSBHubPortStatus status;
+
+  test->model->connectPort(1, false);
+  TEST_CHECK(test->ohci->GetRootHubPortStatus(&status, 1) == kIOReturnSuccess);
+  TEST_CHECK((USBToHostWord(status.statusFlags) & BIT0) != 0);
+  TEST_CHECK((USBToHostWord(status.changeFlags) & BIT0) != 0);
+
+  TEST_CHECK(test->ohci->SetRootHubPortFeature(kUSBHubPortResetFeature, 1) == kIOReturnSuccess);
+  TEST_CHECK(test->ohci->GetRootHubPortStatus(&status, 1) == kIOReturnSuccess);
+  TEST_CHECK((USBToHostWord(status.statusFlags) & BIT1) != 0);
+  TEST_CHECK((USBToHostWord(status.changeFlags) & BIT4) != 0);
+}
+
+//
+// Control transfer reading a device descriptor: setup, an inbound data stage over several packets, and a status stage.
+//
+static void testControl(TestFixture *test) {
+  TestCompletion  setup;
+  TestCompletion  data;
+  TestCompletion  status;
+  UInt8           request[8] = { 0x80, 0x06, 0x00, 0x01, 0x00, 0x00, 18, 0x00 };
+
+  test->model->lock();
+  fillPattern(test->control->controlData, 18, 0x40);
+  test->control->controlLength = 18;
+  test->model->unlock();
+
+  TEST_CHECK(test->ohci->createControlEndpoint(kTestFunction, 0, kTestControlMPS, kUSBDeviceSpeedFull) == kIOReturnSuccess);
+  memcpy(test->buffer, request, sizeof (request));
+  bzero(&test->buffer[64], 64);
+
+  TEST_CHECK(test->ohci->createControlTransfer(kTestFunction, 0, getCompletion(&setup), test->bufferDesc,
+                                               sizeof (request), kUSBNone) == kIOReturnSuccess);
+  TEST_CHECK(test->ohci->createControlTransfer(kTestFunction, 0, getCompletion(&data), test->bufferDesc,
+                                               64, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(test->ohci->createControlTransfer(kTestFunction, 0, getCompletion(&status), NULL, 0, kUSBOut) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&setup) && waitCompletion(&data) && waitCompletion(&status));
+
+  TEST_CHECK((setup.status == kIOReturnSuccess) && (data.status == kIOReturnSuccess) && (status.status == kIOReturnSuccess));
+  TEST_CHECK(data.remaining == (64 - 18));
+  TEST_CHECK(checkPattern(test->buffer, 18, 0x40));
+  TEST_CHECK(memcmp(test->control->setup, request, sizeof (request)) == 0);
+  TEST_CHECK(test->control->setupPackets == 1);
+  TEST_CHECK((setup.order < data.order) && (data.order < status.order));
+}
+
+//
+// Bulk transfers in both directions, larger than a bounce buffer.
+//
+static void testBulk(TestFixture *test) {
+  TestCompletion  out;
+  TestCompletion  in;
+  UInt32          length;
+
+  TEST_CHECK(test->ohci->createBulkEndpoint(kTestFunction, kTestBulkOutEndpoint, kUSBOut, kTestBulkMPS) == kIOReturnSuccess);
+  TEST_CHECK(test->ohci->createBulkEndpoint(kTestFunction, kTestBulkInEndpoint, kUSBIn, kTestBulkMPS) == kIOReturnSuccess);
+
+  length = 5000;
+  fillPattern(test->buffer, length, 0);
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkOutEndpoint, getCompletion(&out),
+                                            test->bufferDesc, false, length, kUSBOut) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&out));
+  TEST_CHECK((out.status == kIOReturnSuccess) && (out.remaining == 0));
+  TEST_CHECK((test->bulkOut->outBytes == length) && (test->bulkOut->outMismatches == 0));
+
+  bzero(test->buffer, length);
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in),
+                                            test->bufferDesc, false, length, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&in));
+  TEST_CHECK((in.status == kIOReturnSuccess) && (in.remaining == 0));
+  TEST_CHECK(checkPattern(test->buffer, length, 0));
+
+  //
+  // A message ending part way through a transfer completes it short, the next transfer continues with the next message.
+  //
+  test->model->lock();
+  test->bulkIn->inSequence    = 0;
+  test->bulkIn->messageLength = 1000;
+  test->bulkIn->messageOffset = 0;
+  test->model->unlock();
+
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in),
+                                            test->bufferDesc, true, 4096, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&in));
+  TEST_CHECK((in.status == kIOReturnSuccess) && (in.remaining == (4096 - 1000)));
+  TEST_CHECK(checkPattern(test->buffer, 1000, 0));
+
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in),
+                                            test->bufferDesc, true, 4096, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&in));
+  TEST_CHECK((in.status == kIOReturnSuccess) && (in.remaining == (4096 - 1000)));
+  TEST_CHECK(checkPattern(test->buffer, 1000, 1000));
+
+  test->model->lock();
+  test->bulkIn->messageLength = 0;
+  test->model->unlock();
+}
+
+//
+// Stalled endpoint: the transfer fails, later ones are refused until the stall is cleared.
+//
+static void testStall(TestFixture *test) {
+  TestCompletion out;
+
+  test->model->lock();
+  test->bulkOut->stalled     = true;
+  test->bulkOut->outSequence = 0;
+  test->model->unlock();
+
+  fillPattern(test->buffer, 256, 0);
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkOutEndpoint, getCompletion(&out),
+                                            test->bufferDesc, false, 256, kUSBOut) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&out));
+  TEST_CHECK(out.status == kIOUSBPipeStalled);
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkOutEndpoint, getCompletion(&out),
+                                            test->bufferDesc, false, 256, kUSBOut) == kIOUSBPipeStalled);
+
+  test->model->lock();
+  test->bulkOut->stalled = false;
+  test->model->unlock();
+  TEST_CHECK(test->ohci->clearEndpointStall(kTestFunction, kTestBulkOutEndpoint, kUSBOut) == kIOReturnSuccess);
+
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkOutEndpoint, getCompletion(&out),
+                                            test->bufferDesc, false, 256, kUSBOut) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&out));
+  TEST_CHECK((out.status == kIOReturnSuccess) && (out.remaining == 0));
+  TEST_CHECK(test->bulkOut->outMismatches == 0);
+}
+
+//
+// Queued transfers complete in order.
+//
+static void testOrdering(TestFixture *test) {
+  TestCompletion  in[4];
+  bool            ordered;
+
+  test->model->lock();
+  test->bulkIn->inSequence = 0;
+  test->model->unlock();
+
+  for (UInt32 i = 0; i < 4; i++) {
+    TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in[i]),
+                                              test->bufferDesc, false, 300, kUSBIn) == kIOReturnSuccess);
+  }
+  ordered = true;
+  for (UInt32 i = 0; i < 4; i++) {
+    TEST_CHECK(waitCompletion(&in[i]) && (in[i].status == kIOReturnSuccess));
+    if ((i > 0) && (in[i].order < in[i - 1].order)) {
+      ordered = false;
+    }
+  }
+  TEST_CHECK(ordered);
+  TEST_CHECK(test->bulkIn->inBytes >= (4 * 300));
+}
+
+//
+// Polling with the interrupt disabled completes only transfers with the safe action.
+// Transfers queued behind one that is not safe on the same endpoint are left for the workloop too.
+//
+static void testPollInterrupts(TestFixture *test) {
+  TestCompletion  out;
+  TestCompletion  in[2];
+  IOUSBCompletion unsafeCompletion;
+  UInt64          retired;
+  UInt32          waitMS;
+
+  test->model->lock();
+  test->bulkIn->inSequence   = 0;
+  test->bulkOut->outSequence = 0;
+  test->model->unlock();
+  fillPattern(test->buffer, 256, 0);
+
+  //
+  // Hold the gate so the workloop cannot complete anything until the polling is done.
+  //
+  test->nub->disableInterrupt(0);
+  test->ohci->getWorkLoop()->closeGate();
+
+  retired          = test->model->getRetiredTransfers();
+  unsafeCompletion = getCompletion(&in[0]);
+  unsafeCompletion.action = completeUnsafeTransfer;
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkOutEndpoint, getCompletion(&out),
+                                            test->bufferDesc, false, 256, kUSBOut) == kIOReturnSuccess);
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, unsafeCompletion,
+                                            test->bufferDesc, false, 300, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in[1]),
+                                            test->bufferDesc, false, 300, kUSBIn) == kIOReturnSuccess);
+
+  //
+  // Keep polling until all three have retired, and long enough after for the done queue to be written back.
+  //
+  waitMS = 0;
+  while ((waitMS < kTestTimeoutMS) && (test->model->getRetiredTransfers() < (retired + 3))) {
+    test->ohci->pollInterrupts(completeTransfer);
+    IOSleep(1);
+    waitMS++;
+  }
+  for (UInt32 i = 0; i < 20; i++) {
+    test->ohci->pollInterrupts(completeTransfer);
+    IOSleep(1);
+  }
+
+  TEST_CHECK(out.done && (out.status == kIOReturnSuccess));
+  TEST_CHECK(pthread_equal(out.thread, pthread_self()));
+  TEST_CHECK(!in[0].done && !in[1].done);
+
+  test->ohci->getWorkLoop()->openGate();
+  test->nub->enableInterrupt(0);
+
+  TEST_CHECK(waitCompletion(&in[0]) && waitCompletion(&in[1]));
+  TEST_CHECK((in[0].status == kIOReturnSuccess) && (in[1].status == kIOReturnSuccess));
+  TEST_CHECK(!pthread_equal(in[0].thread, pthread_self()) && !pthread_equal(in[1].thread, pthread_self()));
+  TEST_CHECK(in[0].order < in[1].order);
+  TEST_CHECK(test->bulkOut->outMismatches == 0);
+}
+
+//
+// Interrupt endpoint polled at its interval, NAKing until data is available.
+//
+static void testInterrupt(TestFixture *test) {
+  TestCompletion  in;
+  UInt64          frames;
+  UInt32          naks;
+
+  test->model->lock();
+  test->intIn->inAvailable = 0;
+  test->model->unlock();
+
+  TEST_CHECK(test->ohci->createInterruptEndpoint(kTestFunction, kTestIntInEndpoint, kUSBIn,
+                                                 kTestIntMPS, kTestIntPollingRate) == kIOReturnSuccess);
+  TEST_CHECK(test->ohci->createInterruptTransfer(kTestFunction, kTestIntInEndpoint, getCompletion(&in),
+                                                 test->bufferDesc, kTestIntMPS, kUSBIn) == kIOReturnSuccess);
+
+  frames = test->model->getFrames();
+  IOSleep(80);
+  test->model->lock();
+  frames = test->model->getFrames() - frames;
+  naks   = test->intIn->naks;
+  test->intIn->inSequence  = 0x10;
+  test->intIn->inAvailable = 4;
+  test->model->unlock();
+
+  //
+  // Polled once every eight frames, give or take the frames around the sleep.
+  //
+  TEST_CHECK((naks > 0) && (naks <= ((frames / kTestIntPollingRate) + 2)));
+  TEST_CHECK(!in.done);
+  TEST_CHECK(waitCompletion(&in));
+  TEST_CHECK((in.status == kIOReturnSuccess) && (in.remaining == (kTestIntMPS - 4)));
+  TEST_CHECK(checkPattern(test->buffer, 4, 0x10));
+
+  test->model->lock();
+  test->intIn->inAvailable = kTestUSBUnlimited;
+  test->model->unlock();
+}
+
+//
+// Reads the interrupt bandwidth the driver publishes for each of the 32 frames.
+//
+static bool getFrameLoads(TestFixture *test, UInt32 *loads) {
+  OSArray   *loadMap;
+  OSNumber  *load;
+
+  loadMap = OSDynamicCast(OSArray, test->ohci->getProperty(kWiiOHCIInterruptLoadMapKey));
+  if ((loadMap == NULL) || (loadMap->getCount() != kWiiOHCIInterruptLeafCount)) {
+    return false;
+  }
+  for (UInt32 i = 0; i < kWiiOHCIInterruptLeafCount; i++) {
+    load = OSDynamicCast(OSNumber, loadMap->getObject(i));
+    if (load == NULL) {
+      return false;
+    }
+    loads[i] = load->unsigned32BitValue();
+  }
+  return true;
+}
+
+static bool checkFrameLoads(TestFixture *test, UInt32 expectedLoad) {
+  UInt32 loads[kWiiOHCIInterruptLeafCount];
+
+  if (!getFrameLoads(test, loads)) {
+    return false;
+  }
+  for (UInt32 i = 0; i < kWiiOHCIInterruptLeafCount; i++) {
+    if (loads[i] != expectedLoad) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// Interrupt endpoints at mixed rates are spread over the sibling nodes of each rate, so every frame carries the
+// same load, and endpoints beyond the periodic budget are refused.
+//
+static void testInterruptTree(TestFixture *test) {
+  static const struct {
+    short   pollingRate;
+    UInt16  maxPacketSize;
+    UInt32  count;
+  } levels[] = {
+    { 32, 8,  kTestTreePerNode * 32 },
+    { 8,  16, kTestTreePerNode * 8 },
+    { 2,  32, kTestTreePerNode * 2 }
+  };
+  UInt32  opened[ARRSIZE(levels)];
+  UInt32  endpointCount;
+  UInt32  frameLoad;
+  UInt32  fastCount;
+  UInt32  fastBandwidth;
+  bool    allOpened;
+
+  //
+  // Open the rates in turn, one endpoint each, so earlier placements constrain later ones.
+  //
+  bzero(opened, sizeof (opened));
+  endpointCount = 0;
+  allOpened     = true;
+  frameLoad     = 0;
+  for (UInt32 round = 0; round < (kTestTreePerNode * 32); round++) {
+    for (UInt32 l = 0; l < ARRSIZE(levels); l++) {
+      if (opened[l] == levels[l].count) {
+        continue;
+      }
+      if (test->ohci->createInterruptEndpoint(kTestTreeFunction + (endpointCount / kTestTreeEndpoints),
+                                              (endpointCount % kTestTreeEndpoints) + 1, kUSBIn,
+                                              levels[l].maxPacketSize, levels[l].pollingRate) != kIOReturnSuccess) {
+        allOpened = false;
+      }
+      opened[l]++;
+      endpointCount++;
+    }
+  }
+  for (UInt32 l = 0; l < ARRSIZE(levels); l++) {
+    frameLoad += kTestTreePerNode * (levels[l].maxPacketSize + kWiiOHCIInterruptOverheadBytes);
+  }
+  TEST_CHECK(allOpened);
+  TEST_CHECK(checkFrameLoads(test, frameLoad));
+
+  //
+  // Fill the rest of the budget from the 1ms node, which is in every frame.
+  //
+  fastBandwidth = kTestTreeFastMPS + kWiiOHCIInterruptOverheadBytes;
+  fastCount     = 0;
+  while ((fastCount < kTestTreeEndpoints)
+         && (test->ohci->createInterruptEndpoint(kTestTreeFastFunction, fastCount + 1, kUSBIn,
+                                                 kTestTreeFastMPS, 1) == kIOReturnSuccess)) {
+    fastCount++;
+  }
+  TEST_CHECK(fastCount == ((kWiiOHCIPeriodicBandwidthBudget - frameLoad) / fastBandwidth));
+  TEST_CHECK(checkFrameLoads(test, frameLoad + (fastCount * fastBandwidth)));
+  TEST_CHECK(test->ohci->createInterruptEndpoint(kTestTreeFastFunction, fastCount + 1, kUSBIn,
+                                                 kTestTreeFastMPS, 1) == kIOReturnNoBandwidth);
+  TEST_CHECK(test->ohci->createInterruptEndpoint(kTestTreeFastFunction, fastCount + 1, kUSBIn,
+                                                 kTestTreeFastMPS, 32) == kIOReturnNoBandwidth);
+
+  //
+  // Deleting an endpoint returns its bandwidth.
+  //
+  TEST_CHECK(test->ohci->deleteEndpoint(kTestTreeFastFunction, fastCount, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(test->ohci->createInterruptEndpoint(kTestTreeFastFunction, fastCount, kUSBIn,
+                                                 kTestTreeFastMPS, 1) == kIOReturnSuccess);
+
+  for (UInt32 i = 0; i < fastCount; i++) {
+    TEST_CHECK(test->ohci->deleteEndpoint(kTestTreeFastFunction, i + 1, kUSBIn) == kIOReturnSuccess);
+  }
+  for (UInt32 i = 0; i < endpointCount; i++) {
+    TEST_CHECK(test->ohci->deleteEndpoint(kTestTreeFunction + (i / kTestTreeEndpoints),
+                                          (i % kTestTreeEndpoints) + 1, kUSBIn) == kIOReturnSuccess);
+  }
+  TEST_CHECK(checkFrameLoads(test, 0));
+}
+
+//
+// Sends an outbound isochronous transfer starting the given number of frames ahead, trying again if it was late.
+//
+static void sendIsochOut(TestFixture *test, UInt32 startFrames, UInt32 frameCount, bool retryMismatch) {
+  IOUSBIsocFrame      frames[kTestIsoFrames];
+  IOUSBIsocCompletion completion;
+  TestCompletion      out;
+  UInt64              frameStart;
+
+  completion.target = NULL;
+  completion.action = completeIsochTransfer;
+
+  fillPattern(test->buffer, frameCount * kTestIsoMPS, 0);
+  for (UInt32 attempt = 0; attempt < kTestIsoOutAttempts; attempt++) {
+    test->model->lock();
+    test->isoOut->outSequence   = 0;
+    test->isoOut->outBytes      = 0;
+    test->isoOut->outMismatches = 0;
+    test->model->unlock();
+
+    for (UInt32 i = 0; i < frameCount; i++) {
+      frames[i].frStatus   = kIOReturnNotReady;
+      frames[i].frReqCount = kTestIsoMPS;
+      frames[i].frActCount = 0;
+    }
+    bzero(&out, sizeof (out));
+    completion.parameter = &out;
+    frameStart = test->ohci->GetFrameNumber() + startFrames;
+    TEST_CHECK(test->ohci->createIsochTransfer(kTestFunction, kTestIsoOutEndpoint, completion, kUSBOut, frameStart,
+                                               test->bufferDesc, frameCount, frames) == kIOReturnSuccess);
+    TEST_CHECK(waitCompletion(&out));
+    if ((out.status == kIOReturnSuccess) && ((test->isoOut->outMismatches == 0) || !retryMismatch)) {
+      break;
+    }
+  }
+  TEST_CHECK(out.status == kIOReturnSuccess);
+  TEST_CHECK(test->isoOut->outBytes == (frameCount * kTestIsoMPS));
+  TEST_CHECK(test->isoOut->outMismatches == 0);
+}
+
+//
+// Isochronous transfers, one packet per frame, inbound packets short of the requested size.
+//
+static void testIsochronous(TestFixture *test) {
+  IOUSBIsocFrame      frames[kTestIsoFrames];
+  IOUSBIsocCompletion completion;
+  TestCompletion      in;
+  UInt64              frameStart;
+  bool                framesOK;
+
+  TEST_CHECK(test->ohci->createIsochEndpoint(kTestFunction, kTestIsoInEndpoint, kTestIsoMPS, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(test->ohci->createIsochEndpoint(kTestFunction, kTestIsoOutEndpoint, kTestIsoMPS, kUSBOut) == kIOReturnSuccess);
+
+  test->model->lock();
+  test->isoIn->inSequence      = 0;
+  test->isoIn->isoPacketLength = kTestIsoInPacketLength;
+  test->model->unlock();
+
+  bzero(test->buffer, kTestIsoFrames * kTestIsoMPS);
+  for (UInt32 i = 0; i < kTestIsoFrames; i++) {
+    frames[i].frStatus   = kIOReturnNotReady;
+    frames[i].frReqCount = kTestIsoMPS;
+    frames[i].frActCount = 0;
+  }
+  bzero(&in, sizeof (in));
+  completion.target    = NULL;
+  completion.action    = completeIsochTransfer;
+  completion.parameter = &in;
+  frameStart = test->ohci->GetFrameNumber() + 10;
+  TEST_CHECK(test->ohci->createIsochTransfer(kTestFunction, kTestIsoInEndpoint, completion, kUSBIn, frameStart,
+                                             test->bufferDesc, kTestIsoFrames, frames) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&in));
+
+  //
+  // Each frame's data lands at its own offset in the buffer.
+  //
+  framesOK = true;
+  for (UInt32 i = 0; i < kTestIsoFrames; i++) {
+    if ((frames[i].frActCount != kTestIsoInPacketLength)
+        || !checkPattern(&test->buffer[i * kTestIsoMPS], kTestIsoInPacketLength, i * kTestIsoInPacketLength)) {
+      framesOK = false;
+    }
+  }
+  TEST_CHECK(framesOK);
+  TEST_CHECK(test->isoIn->packets == kTestIsoFrames);
+
+  //
+  // Each outbound frame has its own descriptor, copied a few frames ahead of being sent. A transfer starting within
+  // that window is copied at submission, before the controller can see it. Later frames are copied by a timer, and
+  // host scheduling can hold up the work loop for longer, sending stale data as hardware would. Frames are slowed
+  // while the timer is tested to leave it more time, and a transfer is tried again if it still missed.
+  //
+  sendIsochOut(test, kWiiOHCIIsoOutPrefillFrames - 1, 1, false);
+
+  test->model->stop();
+  test->model->start(kTestIsoOutIntervalUS);
+  sendIsochOut(test, 10, kTestIsoFrames, true);
+  test->model->stop();
+  test->model->start(kTestOHCIFrameIntervalUS);
+}
+
+//
+// Aborting an endpoint completes its pending transfers, and the endpoint is usable afterwards.
+//
+static void testAbort(TestFixture *test) {
+  TestCompletion in[3];
+  TestCompletion next;
+
+  test->model->lock();
+  test->bulkIn->nak = true;
+  test->model->unlock();
+
+  for (UInt32 i = 0; i < 3; i++) {
+    TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in[i]),
+                                              test->bufferDesc, false, 512, kUSBIn) == kIOReturnSuccess);
+  }
+  IOSleep(10);
+  TEST_CHECK(!in[0].done);
+  TEST_CHECK(test->ohci->abortEndpoint(kTestFunction, kTestBulkInEndpoint, kUSBIn) == kIOReturnSuccess);
+  for (UInt32 i = 0; i < 3; i++) {
+    TEST_CHECK(waitCompletion(&in[i]) && (in[i].status == kIOReturnAborted));
+  }
+
+  test->model->lock();
+  test->bulkIn->nak        = false;
+  test->bulkIn->inSequence = 0x80;
+  test->model->unlock();
+
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&next),
+                                            test->bufferDesc, false, 512, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&next));
+  TEST_CHECK((next.status == kIOReturnSuccess) && checkPattern(test->buffer, 512, 0x80));
+}
+
+//
+// Deleting an endpoint with a pending transfer completes it as aborted and removes the endpoint.
+//
+static void testDelete(TestFixture *test) {
+  TestCompletion in;
+  TestCompletion reopened;
+
+  test->model->lock();
+  test->bulkIn->nak = true;
+  test->model->unlock();
+
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in),
+                                            test->bufferDesc, false, 512, kUSBIn) == kIOReturnSuccess);
+  IOSleep(5);
+  TEST_CHECK(test->ohci->deleteEndpoint(kTestFunction, kTestBulkInEndpoint, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&in) && (in.status == kIOReturnAborted));
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in),
+                                            test->bufferDesc, false, 512, kUSBIn) == kIOUSBEndpointNotFound);
+
+  //
+  // Delete does not wait for the controller, the endpoint can be opened again before the old one is released.
+  //
+  TEST_CHECK(test->ohci->createBulkEndpoint(kTestFunction, kTestBulkInEndpoint, kUSBIn, kTestBulkMPS) == kIOReturnSuccess);
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in),
+                                            test->bufferDesc, false, 512, kUSBIn) == kIOReturnSuccess);
+  IOSleep(5);
+  TEST_CHECK(test->ohci->deleteEndpoint(kTestFunction, kTestBulkInEndpoint, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(test->ohci->createBulkEndpoint(kTestFunction, kTestBulkInEndpoint, kUSBIn, kTestBulkMPS) == kIOReturnSuccess);
+
+  test->model->lock();
+  test->bulkIn->nak = false;
+  test->model->unlock();
+
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&reopened),
+                                            test->bufferDesc, false, 512, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&in) && (in.status == kIOReturnAborted));
+  TEST_CHECK(waitCompletion(&reopened) && (reopened.status == kIOReturnSuccess));
+  TEST_CHECK(test->ohci->deleteEndpoint(kTestFunction, kTestBulkInEndpoint, kUSBIn) == kIOReturnSuccess);
+}
+
+//
+// Streaming bulk IN, requests are filled in order from data the ring received ahead, keeping message boundaries.
+//
+static void testBulkStream(TestFixture *test) {
+  TestCompletion  in;
+  OSNumber        *streaming;
+
+  //
+  // Boolean properties are numbers on the host.
+  //
+  streaming = OSDynamicCast(OSNumber, test->ohci->getProperty(kWiiOHCIBulkStreamKey));
+  TEST_CHECK((streaming != NULL) && (streaming->unsigned32BitValue() != 0));
+
+  test->model->lock();
+  test->bulkIn->inSequence    = 0;
+  test->bulkIn->messageLength = 1000;
+  test->bulkIn->messageOffset = 0;
+  test->model->unlock();
+  TEST_CHECK(test->ohci->createBulkEndpoint(kTestFunction, kTestBulkInEndpoint, kUSBIn, kTestBulkMPS) == kIOReturnSuccess);
+
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in),
+                                            test->bufferDesc, true, 4096, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&in));
+  TEST_CHECK((in.status == kIOReturnSuccess) && (in.remaining == (4096 - 1000)));
+  TEST_CHECK(checkPattern(test->buffer, 1000, 0));
+
+  //
+  // A request smaller than the message takes part of it, the next one gets the rest.
+  //
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in),
+                                            test->bufferDesc, false, 512, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&in));
+  TEST_CHECK((in.status == kIOReturnSuccess) && (in.remaining == 0));
+  TEST_CHECK(checkPattern(test->buffer, 512, 1000));
+
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in),
+                                            test->bufferDesc, true, 4096, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&in));
+  TEST_CHECK((in.status == kIOReturnSuccess) && (in.remaining == (4096 - 488)));
+  TEST_CHECK(checkPattern(test->buffer, 488, 1512));
+
+  //
+  // Requests without rounding that end early complete as underruns.
+  //
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkInEndpoint, getCompletion(&in),
+                                            test->bufferDesc, false, 4096, kUSBIn) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&in));
+  TEST_CHECK((in.status == kIOReturnUnderrun) && (in.remaining == (4096 - 1000)));
+  TEST_CHECK(checkPattern(test->buffer, 1000, 2000));
+
+  //
+  // Deleting the endpoint with data still in the ring completes pending requests and frees the ring.
+  //
+  test->model->lock();
+  test->bulkIn->nak = true;
+  test->model->unlock();
+  IOSleep(10);
+  TEST_CHECK(test->ohci->deleteEndpoint(kTestFunction, kTestBulkInEndpoint, kUSBIn) == kIOReturnSuccess);
+  IOSleep(10);
+
+  test->model->lock();
+  test->bulkIn->nak           = false;
+  test->bulkIn->messageLength = 0;
+  test->model->unlock();
+}
+
+//
+// Outbound data in whole cache lines is moved into bounce buffers by the locked cache DMA engine, anything else is
+// still copied. Each jumbo bounce buffer is one load and one store of its lines.
+//
+static void testLockedCache(TestFixture *test, TestLockedCacheModel *lockedCacheModel) {
+  TestCompletion      out;
+  OSNumber            *lockedCache;
+  UInt8               *buffer;
+  IOMemoryDescriptor  *bufferDesc;
+  IOMemoryDescriptor  *unalignedDesc;
+  HostDataCacheStats  stats;
+  UInt32              sequence;
+  UInt32              loadLines;
+
+  lockedCache = OSDynamicCast(OSNumber, test->ohci->getProperty(kWiiOHCILockedCacheKey));
+  TEST_CHECK((lockedCache != NULL) && (lockedCache->unsigned32BitValue() != 0));
+  TEST_CHECK(lockedCacheModel->isEnabled());
+
+  buffer        = (UInt8 *) IOMallocAligned(kTestBufferSize, PAGE_SIZE);
+  bufferDesc    = IOMemoryDescriptor::withAddress(buffer, kTestBufferSize, kIODirectionOutIn);
+  unalignedDesc = IOMemoryDescriptor::withSubRange(bufferDesc, 4, kTestBufferSize - 4, kIODirectionOutIn);
+  TEST_CHECK(test->ohci->createBulkEndpoint(kTestFunction, kTestBulkOutEndpoint, kUSBOut, kTestBulkMPS) == kIOReturnSuccess);
+
+  //
+  // Aligned and whole lines, both bounce buffers are moved.
+  //
+  sequence  = 0;
+  loadLines = lockedCacheModel->getLoadLines();
+  fillPattern(buffer, 4096, sequence);
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkOutEndpoint, getCompletion(&out),
+                                            bufferDesc, false, 4096, kUSBOut) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&out) && (out.status == kIOReturnSuccess) && (out.remaining == 0));
+  TEST_CHECK(lockedCacheModel->getLoadLines() == (loadLines + (4096 / kWiiLockedCacheLineSize)));
+  sequence += 4096;
+
+  //
+  // Only the whole bounce buffers of a transfer ending part way through a line are moved.
+  //
+  loadLines = lockedCacheModel->getLoadLines();
+  fillPattern(buffer, 5000, sequence);
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkOutEndpoint, getCompletion(&out),
+                                            bufferDesc, false, 5000, kUSBOut) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&out) && (out.status == kIOReturnSuccess) && (out.remaining == 0));
+  TEST_CHECK(lockedCacheModel->getLoadLines() == (loadLines + ((kWiiOHCIBounceBufferJumboSize * 2) / kWiiLockedCacheLineSize)));
+  sequence += 5000;
+
+  //
+  // Data not starting on a line is copied.
+  //
+  loadLines = lockedCacheModel->getLoadLines();
+  fillPattern(buffer + 4, 4096, sequence);
+  TEST_CHECK(test->ohci->createBulkTransfer(kTestFunction, kTestBulkOutEndpoint, getCompletion(&out),
+                                            unalignedDesc, false, 4096, kUSBOut) == kIOReturnSuccess);
+  TEST_CHECK(waitCompletion(&out) && (out.status == kIOReturnSuccess) && (out.remaining == 0));
+  TEST_CHECK(lockedCacheModel->getLoadLines() == loadLines);
+  sequence += 4096;
+
+  TEST_CHECK((test->bulkOut->outBytes == sequence) && (test->bulkOut->outMismatches == 0));
+  TEST_CHECK(lockedCacheModel->getErrors() == 0);
+  hostGetDataCacheStats(&stats);
+  TEST_CHECK(stats.staleReads == 0);
+  printf("ohci: locked cache, %u lines loaded, %u lines stored\n", lockedCacheModel->getLoadLines(),
+    lockedCacheModel->getStoreLines());
+
+  TEST_CHECK(test->ohci->deleteEndpoint(kTestFunction, kTestBulkOutEndpoint, kUSBOut) == kIOReturnSuccess);
+  unalignedDesc->release();
+  bufferDesc->release();
+  IOFreeAligned(buffer, kTestBufferSize);
+}
+
+//
+// Runs the transfer tests in order, each leaves the endpoints the next one uses.
+//
+static void testTransfers(TestFixture *test) {
+  testFrames(test);
+  testRootHub(test);
+  testControl(test);
+  testBulk(test);
+  testStall(test);
+  testOrdering(test);
+  testPollInterrupts(test);
+  testInterrupt(test);
+  testIsochronous(test);
+  testAbort(test);
+  testDelete(test);
+  printf("ohci: %llu frames, %llu transfer descriptors retired\n", (unsigned long long) test->model->getFrames(),
+    (unsigned long long) test->model->getRetiredTransfers());
+}
+
+//
+// With cacheable transfer descriptors, every descriptor the controller read was flushed after the driver last
+// changed it, and every descriptor the controller wrote back was invalidated before the driver flushed it again.
+//
+static void testCacheHandoffs(TestFixture *test) {
+  HostDataCacheStats  stats;
+  OSString            *cacheMode;
+
+  cacheMode = OSDynamicCast(OSString, test->ohci->getProperty(kWiiOHCITransferCacheModeKey));
+  TEST_CHECK((cacheMode != NULL) && (strcmp(cacheMode->getCStringNoCopy(), "CopybackCache") == 0));
+
+  //
+  // Let the last retired descriptors reach the done queue before counting pending writes.
+  //
+  IOSleep(20);
+  hostGetDataCacheStats(&stats);
+  printf("ohci: cached descriptors, %u flushes, %u invalidates\n", stats.flushes, stats.invalidates);
+  TEST_CHECK(stats.staleReads == 0);
+  TEST_CHECK(stats.lostWrites == 0);
+  TEST_CHECK(stats.pendingWrites == 0);
+  TEST_CHECK((stats.flushes > 0) && (stats.invalidates > 0));
+}
+
+int main(void) {
+  TestPlatform              *platform;
+  TestFixture               test;
+  TestLockedCacheModel      *lockedCacheModel;
+  WiiLockedCacheController  *lockedCache;
+
+  hostSetLogOutput(false);
+  hostSetProcessorPVR(kTestPVRCafe);
+  platform = new TestPlatform;
+  IOService::hostSetPlatform(platform);
+
+  TEST_CHECK(createFixture(&test));
+  if (gTestFailures != 0) {
+    return testFinish("ohci");
+  }
+  testTransfers(&test);
+  destroyFixture(&test);
+
+  //
+  // Cacheable transfer descriptors are chosen when the driver starts, the same transfers run on a driver of its own.
+  // The checks start before the driver does, so the descriptor pages it flushes when allocating them are seen.
+  //
+  hostSetBootArgument(kWiiOHCICachedTransfersArg, true);
+  hostSetDataCacheChecks(true);
+  TEST_CHECK(createFixture(&test));
+  testTransfers(&test);
+  testCacheHandoffs(&test);
+  destroyFixture(&test);
+  hostSetDataCacheChecks(false);
+  hostSetBootArgument(kWiiOHCICachedTransfersArg, false);
+
+  //
+  // Streaming is chosen when the driver starts, so it gets a driver of its own.
+  //
+  hostSetBootArgument(kWiiOHCIBulkStreamArg, true);
+  TEST_CHECK(createFixture(&test));
+  testBulkStream(&test);
+  destroyFixture(&test);
+  hostSetBootArgument(kWiiOHCIBulkStreamArg, false);
+
+  //
+  // Locked cache copies are chosen when the driver starts, on a driver of its own given the locked cache service.
+  // The driver holds its stage for as long as it runs, the locked cache is disabled again once it stops.
+  // Transfer descriptors are cacheable so that every read by either device is checked against the data cache.
+  //
+  lockedCacheModel = new TestLockedCacheModel;
+  hostSetSPRDevice(lockedCacheModel);
+  lockedCacheModel->start();
+  lockedCache = WiiLockedCacheController::lockedCacheController(invalidate_dcache);
+  TEST_CHECK(lockedCache != NULL);
+  if (lockedCache != NULL) {
+    platform->lockedCacheService = lockedCache->getService();
+    hostSetBootArgument(kWiiOHCILockedCacheArg, true);
+    hostSetBootArgument(kWiiOHCICachedTransfersArg, true);
+    hostSetDataCacheChecks(true);
+    TEST_CHECK(createFixture(&test));
+    testLockedCache(&test, lockedCacheModel);
+    destroyFixture(&test);
+    TEST_CHECK(!lockedCacheModel->isEnabled());
+    hostSetDataCacheChecks(false);
+    hostSetBootArgument(kWiiOHCICachedTransfersArg, false);
+    hostSetBootArgument(kWiiOHCILockedCacheArg, false);
+    platform->lockedCacheService = NULL;
+    lockedCache->release();
+  }
+  lockedCacheModel->stop();
+  hostSetSPRDevice(NULL);
+  delete lockedCacheModel;
+
+  //
+  // The interrupt tree is checked from empty, on a driver of its own.
+  //
+  TEST_CHECK(createFixture(&test));
+  testInterruptTree(&test);
+  destroyFixture(&test);
+
+  platform->release();
+  return testFinish("ohci");
+}
@@ -0,0 +1,228 @@
+//
+//  test_ohci_endpoint_hash.cpp
+//  Checks the OHCI endpoint lookup table against a plain list of the endpoints it should hold
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  Random inserts and removes fill the table to its limit and back, so probe sequences wrap and removes shift
+//  entries back across clusters. After each operation every endpoint in the list must be found, every endpoint
+//  removed must not be, and every entry must be reachable from its home slot without crossing an empty slot.
+//
+
+#include "TestHarness.h"
+#include "TestOHCIDriver.h"
+
+#define kTestFunctionCount    127
+#define kTestEndpointCount    16
+#define kTestKeyCount         (kTestFunctionCount * kTestEndpointCount * 2)
+#define kTestOperations       200000
+#define kTestFullCheckMask    0xFF
+
+static TestOHCI           *gOHCI;
+static OHCIEndpointData   gEndpoints[kTestKeyCount];
+static bool               gPresent[kTestKeyCount];
+static UInt32             gPresentCount;
+
+//
+// Fills in the endpoint for a key index, every index has a distinct function, endpoint and direction.
+//
+static void initEndpoint(UInt32 keyIndex) {
+  OHCIEndpointData *endpoint;
+
+  endpoint = &gEndpoints[keyIndex];
+  bzero(endpoint, sizeof (*endpoint));
+  endpoint->type = kWiiOHCIEndpointTypeBulk;
+  endpoint->key  = gOHCI->getKey((keyIndex / (kTestEndpointCount * 2)) + 1, (keyIndex / 2) % kTestEndpointCount,
+                                 ((keyIndex & 1) != 0) ? kUSBIn : kUSBOut);
+}
+
+static OHCIEndpointData *lookupKeyIndex(UInt32 keyIndex) {
+  return gOHCI->lookupEndpoint((keyIndex / (kTestEndpointCount * 2)) + 1, (keyIndex / 2) % kTestEndpointCount,
+                               ((keyIndex & 1) != 0) ? kUSBIn : kUSBOut, kWiiOHCIEndpointTypeAll);
+}
+
+//
+// Checks that each entry can be reached from its home slot, and the table holds exactly the present endpoints.
+//
+static bool checkTable(void) {
+  OHCIEndpointData  *endpoint;
+  UInt32            index;
+  UInt32            count;
+
+  count = 0;
+  for (UInt32 slot = 0; slot < kWiiOHCIEndpointHashSize; slot++) {
+    endpoint = gOHCI->getHashSlot(slot);
+    if (endpoint == NULL) {
+      continue;
+    }
+    if (!gPresent[endpoint - gEndpoints]) {
+      return false;
+    }
+
+    index = gOHCI->getHashIndex(endpoint->key);
+    while (index != slot) {
+      if (gOHCI->getHashSlot(index) == NULL) {
+        return false;
+      }
+      index = (index + 1) & (kWiiOHCIEndpointHashSize - 1);
+    }
+    count++;
+  }
+
+  return (count == gPresentCount) && (gOHCI->getHashCount() == gPresentCount);
+}
+
+//
+// Checks lookups of every key against the list.
+//
+static bool checkLookups(void) {
+  for (UInt32 i = 0; i < kTestKeyCount; i++) {
+    if (lookupKeyIndex(i) != (gPresent[i] ? &gEndpoints[i] : NULL)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// Random inserts and removes, biased to fill the table and then to empty it again.
+//
+static void testRandomOperations(void) {
+  UInt32  randomState;
+  UInt32  keyIndex;
+  bool    filling;
+  bool    insertsOk;
+  bool    lookupsOk;
+  bool    tablesOk;
+  bool    reachedFull;
+  bool    refusedFull;
+
+  randomState = 0x9E3779B9;
+  filling     = true;
+  insertsOk   = true;
+  lookupsOk   = true;
+  tablesOk    = true;
+  reachedFull = false;
+  refusedFull = false;
+
+  for (UInt32 op = 0; op < kTestOperations; op++) {
+    if (gPresentCount == kWiiOHCIEndpointHashMaxCount) {
+      filling     = false;
+      reachedFull = true;
+    } else if (gPresentCount == 0) {
+      filling = true;
+    }
+
+    keyIndex = testRandom(&randomState) % kTestKeyCount;
+    if (gPresent[keyIndex]) {
+      //
+      // Remove present endpoints more often while emptying.
+      //
+      if (filling && ((testRandom(&randomState) & 3) != 0)) {
+        continue;
+      }
+      gOHCI->removeHashEndpoint(&gEndpoints[keyIndex]);
+      gPresent[keyIndex] = false;
+      gPresentCount--;
+    } else {
+      if (!filling && ((testRandom(&randomState) & 3) != 0)) {
+        continue;
+      }
+
+      initEndpoint(keyIndex);
+      if (gPresentCount == kWiiOHCIEndpointHashMaxCount) {
+        if (gOHCI->insertHashEndpoint(&gEndpoints[keyIndex])) {
+          insertsOk = false;
+        }
+        refusedFull = true;
+        continue;
+      }
+      if (!gOHCI->insertHashEndpoint(&gEndpoints[keyIndex])) {
+        insertsOk = false;
+        continue;
+      }
+      gPresent[keyIndex] = true;
+      gPresentCount++;
+    }
+
+    if (!checkTable()) {
+      tablesOk = false;
+    }
+    if (((op & kTestFullCheckMask) == 0) && !checkLookups()) {
+      lookupsOk = false;
+    }
+  }
+
+  TEST_CHECK(insertsOk);
+  TEST_CHECK(tablesOk);
+  TEST_CHECK(lookupsOk);
+  TEST_CHECK(checkLookups());
+  TEST_CHECK(reachedFull);
+  TEST_CHECK(refusedFull);
+}
+
+//
+// Removing the head of a wrapped cluster shifts each later entry back to the earliest slot it may use.
+//
+static void testClusterRemove(void) {
+  UInt32  homeIndex;
+  UInt32  cluster[4];
+  UInt32  clusterCount;
+  UInt32  slot;
+
+  //
+  // Find keys sharing the last slot as their home, so the cluster wraps to the start of the table.
+  //
+  homeIndex    = kWiiOHCIEndpointHashSize - 1;
+  clusterCount = 0;
+  for (UInt32 i = 0; (i < kTestKeyCount) && (clusterCount < 4); i++) {
+    initEndpoint(i);
+    if (gOHCI->getHashIndex(gEndpoints[i].key) == homeIndex) {
+      cluster[clusterCount++] = i;
+    }
+  }
+  TEST_CHECK(clusterCount >= 2);
+
+  for (UInt32 i = 0; i < clusterCount; i++) {
+    TEST_CHECK(gOHCI->insertHashEndpoint(&gEndpoints[cluster[i]]));
+    gPresent[cluster[i]] = true;
+    gPresentCount++;
+  }
+  TEST_CHECK(gOHCI->getHashSlot(0) == &gEndpoints[cluster[1]]);
+
+  gOHCI->removeHashEndpoint(&gEndpoints[cluster[0]]);
+  gPresent[cluster[0]] = false;
+  gPresentCount--;
+
+  slot = homeIndex;
+  for (UInt32 i = 1; i < clusterCount; i++) {
+    TEST_CHECK(gOHCI->getHashSlot(slot) == &gEndpoints[cluster[i]]);
+    slot = (slot + 1) & (kWiiOHCIEndpointHashSize - 1);
+  }
+  TEST_CHECK(gOHCI->getHashSlot(slot) == NULL);
+  TEST_CHECK(checkTable());
+  TEST_CHECK(checkLookups());
+
+  for (UInt32 i = 1; i < clusterCount; i++) {
+    gOHCI->removeHashEndpoint(&gEndpoints[cluster[i]]);
+    gPresent[cluster[i]] = false;
+    gPresentCount--;
+  }
+  TEST_CHECK(gOHCI->getHashCount() == 0);
+}
+
+int main(void) {
+  hostSetLogOutput(false);
+
+  //
+  // The lookup table does not touch the controller, the driver is initialized but not started.
+  //
+  gOHCI = new TestOHCI;
+  TEST_CHECK(gOHCI->init());
+
+  testClusterRemove();
+  testRandomOperations();
+
+  gOHCI->release();
+  return testFinish("ohci_endpoint_hash");
+}
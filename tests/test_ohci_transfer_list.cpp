@@ -0,0 +1,164 @@
+//
+//  test_ohci_transfer_list.cpp
+//  Checks the OHCI pending transfer lists with a producer and a consumer running at once
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  A producer thread pushes batches of transfers as the interrupt filter does, while the test thread takes whole
+//  lists as the secondary interrupt handler does. Every transfer must come out exactly once and in push order.
+//
+
+#include "TestHarness.h"
+#include "TestOHCIDriver.h"
+
+#define kTestTransferCount    65536
+#define kTestMaxBatch         8
+#define kTestRounds           16
+#define kTestTimeoutMS        10000
+
+//
+// Shared between the producer thread and the test.
+//
+static TestOHCI                     *gOHCI;
+static OHCITransferData             gTransfers[kTestTransferCount];
+static OHCITransferData * volatile  gListHeadPtr;
+static volatile bool                gProducerDone;
+static UInt32                       gRandomState;
+
+//
+// Pushes all transfers in batches of random length.
+// Each batch is linked newest first, as the filter links transfers off the done queue.
+//
+static void *produceTransfers(void *arg) {
+  UInt32 index;
+  UInt32 batchLength;
+
+  index = 0;
+  while (index < kTestTransferCount) {
+    batchLength = (testRandom(&gRandomState) % kTestMaxBatch) + 1;
+    if (batchLength > (kTestTransferCount - index)) {
+      batchLength = kTestTransferCount - index;
+    }
+
+    for (UInt32 i = 1; i < batchLength; i++) {
+      gTransfers[index + i].nextTransfer = &gTransfers[index + i - 1];
+    }
+    gOHCI->pushTransfers(&gListHeadPtr, &gTransfers[index + batchLength - 1], &gTransfers[index]);
+    index += batchLength;
+
+    if ((testRandom(&gRandomState) & 0x3F) == 0) {
+      sched_yield();
+    }
+  }
+
+  gProducerDone = true;
+  return NULL;
+}
+
+//
+// Runs one round, taking lists until every transfer has been seen or the producer is done and the list is empty.
+//
+static void testRound(void) {
+  pthread_t         producer;
+  OHCITransferData  *currTransfer;
+  UInt8             *seen;
+  UInt32            index;
+  UInt32            seenCount;
+  UInt32            expectedIndex;
+  UInt64            checksum;
+  UInt64            startTime;
+  UInt32            takes;
+  bool              inOrder;
+  bool              noDuplicates;
+  bool              inRange;
+  bool              producerDone;
+
+  seen = (UInt8 *) IOMalloc(kTestTransferCount);
+  bzero(seen, kTestTransferCount);
+  bzero(gTransfers, sizeof (gTransfers));
+  gListHeadPtr  = NULL;
+  gProducerDone = false;
+
+  seenCount     = 0;
+  expectedIndex = 0;
+  checksum      = 0;
+  takes         = 0;
+  inOrder       = true;
+  noDuplicates  = true;
+  inRange       = true;
+
+  startTime = testGetNanoseconds();
+  pthread_create(&producer, NULL, produceTransfers, NULL);
+
+  while (seenCount < kTestTransferCount) {
+    //
+    // Check the producer flag before taking, so a final take after it is set sees everything pushed.
+    //
+    producerDone = gProducerDone;
+
+    currTransfer = gOHCI->takeTransfers(&gListHeadPtr);
+    takes++;
+    if ((currTransfer == NULL) && producerDone) {
+      break;
+    }
+    if ((testGetNanoseconds() - startTime) > (kTestTimeoutMS * 1000000ULL)) {
+      break;
+    }
+
+    while (currTransfer != NULL) {
+      index = (UInt32) (currTransfer - gTransfers);
+      if (index >= kTestTransferCount) {
+        inRange = false;
+        break;
+      }
+
+      if (seen[index] != 0) {
+        noDuplicates = false;
+      }
+      if (index != expectedIndex) {
+        inOrder = false;
+      }
+      seen[index]   = 1;
+      expectedIndex = index + 1;
+      checksum     += index;
+      seenCount++;
+
+      currTransfer = currTransfer->nextTransfer;
+    }
+  }
+
+  pthread_join(producer, NULL);
+  TEST_CHECK(gOHCI->takeTransfers(&gListHeadPtr) == NULL);
+
+  TEST_CHECK(inRange);
+  TEST_CHECK(noDuplicates);
+  TEST_CHECK(inOrder);
+  TEST_CHECK(seenCount == kTestTransferCount);
+  TEST_CHECK(checksum == (((UInt64) kTestTransferCount * (kTestTransferCount - 1)) / 2));
+  index = 0;
+  while ((index < kTestTransferCount) && (seen[index] != 0)) {
+    index++;
+  }
+  TEST_CHECK(index == kTestTransferCount);
+  TEST_CHECK(takes > 1);
+
+  IOFree(seen, kTestTransferCount);
+}
+
+int main(void) {
+  hostSetLogOutput(false);
+
+  //
+  // The lists do not touch the controller, the driver is initialized but not started.
+  //
+  gOHCI        = new TestOHCI;
+  gRandomState = 0x12345678;
+  TEST_CHECK(gOHCI->init());
+
+  for (UInt32 round = 0; round < kTestRounds; round++) {
+    testRound();
+  }
+
+  gOHCI->release();
+  return testFinish("ohci_transfer_list");
+}
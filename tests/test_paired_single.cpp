@@ -0,0 +1,229 @@
+//
+//  test_paired_single.cpp
+//  Checks the paired-single clip loop against the scalar reference clip, bit for bit
+//
+//  Copyright © 2025 John Davis. All rights reserved.
+//
+//  The host cannot run paired-single instructions, so the loop body is decoded from the same instruction words
+//  the kernel assembles and run on a model of the quantized load/store unit. The model follows the Broadway
+//  manual: quantized stores multiply by 2^scale, saturate to the integer type, then truncate toward zero.
+//  NaN inputs are not modeled, their conversion is undefined in the reference as well.
+//
+
+#include <math.h>
+
+#include "TestHarness.h"
+#include "WiiPairedSingle.hpp"
+
+#define kTestRandomCount    200000
+#define kTestMaxPairs       64
+
+//
+// Paired-single register state used by the clip loop.
+//
+typedef struct {
+  uintptr_t gpr[32];
+  float     ps[32][2];
+  UInt32    gqr[8];
+} PSModel;
+
+static float getQuantizeScale(UInt32 scale) {
+  //
+  // Scale is a 6-bit signed exponent.
+  //
+  return ldexpf(1.0f, (scale & 0x20) ? ((SInt32) scale - 64) : (SInt32) scale);
+}
+
+static SInt32 getDisplacement(UInt32 instruction) {
+  return ((SInt32) (instruction << 20)) >> 20;
+}
+
+//
+// Runs one instruction, returns false if it is not one the model knows.
+//
+static bool runInstruction(PSModel *model, UInt32 instruction) {
+  UInt32  op;
+  UInt32  frS;
+  UInt32  rA;
+  UInt32  gqr;
+  UInt32  type;
+  float   scale;
+  float   value;
+  UInt8   *ea;
+
+  op  = instruction >> 26;
+  frS = (instruction >> 21) & 0x1F;
+  rA  = (instruction >> 16) & 0x1F;
+  gqr = model->gqr[(instruction >> 12) & 0x7];
+
+  switch (op) {
+    case kWiiPSOpPsqLU:
+      //
+      // W must be clear so both halves are loaded.
+      //
+      if ((instruction & BIT15) != 0) {
+        return false;
+      }
+      ea    = (UInt8 *) (model->gpr[rA] + getDisplacement(instruction));
+      type  = (gqr >> 16) & 0x7;
+      scale = getQuantizeScale((gqr >> 24) & 0x3F);
+      if (type == kWiiPSGQRTypeFloat) {
+        memcpy(model->ps[frS], ea, sizeof (float) * 2);
+      } else if (type == kWiiPSGQRTypeSInt16) {
+        model->ps[frS][0] = (float) ((SInt16 *) ea)[0] / scale;
+        model->ps[frS][1] = (float) ((SInt16 *) ea)[1] / scale;
+      } else {
+        return false;
+      }
+      model->gpr[rA] = (uintptr_t) ea;
+      return true;
+
+    case kWiiPSOpPsqStU:
+      if ((instruction & BIT15) != 0) {
+        return false;
+      }
+      ea    = (UInt8 *) (model->gpr[rA] + getDisplacement(instruction));
+      type  = gqr & 0x7;
+      scale = getQuantizeScale((gqr >> 8) & 0x3F);
+      if (type == kWiiPSGQRTypeFloat) {
+        memcpy(ea, model->ps[frS], sizeof (float) * 2);
+      } else if (type == kWiiPSGQRTypeSInt16) {
+        for (UInt32 i = 0; i < 2; i++) {
+          value = model->ps[frS][i] * scale;
+          if (value > 32767.0f) {
+            value = 32767.0f;
+          } else if (value < -32768.0f) {
+            value = -32768.0f;
+          }
+          ((SInt16 *) ea)[i] = (SInt16) value;
+        }
+      } else {
+        return false;
+      }
+      model->gpr[rA] = (uintptr_t) ea;
+      return true;
+
+    case 4:
+      //
+      // ps_muls0, both halves of frA times the first half of frC.
+      //
+      if (((instruction >> 1) & 0x1F) != kWiiPSXOMulS0) {
+        return false;
+      }
+      value = model->ps[(instruction >> 6) & 0x1F][0];
+      model->ps[frS][0] = model->ps[rA][0] * value;
+      model->ps[frS][1] = model->ps[rA][1] * value;
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+//
+// Runs the clip loop as set up by convertFloatToSInt16().
+//
+static bool runClipLoop(const float *in, SInt16 *out, UInt32 pairs, float scale) {
+  PSModel model;
+  UInt32  loop[] = { (UInt32) kWiiPSClipLoad, (UInt32) kWiiPSClipScale, (UInt32) kWiiPSClipStore };
+
+  memset(&model, 0, sizeof (model));
+  model.gqr[kWiiPSGQRFloat]  = WiiPSGQRValue(kWiiPSGQRTypeFloat, 0);
+  model.gqr[kWiiPSGQRSInt16] = WiiPSGQRValue(kWiiPSGQRTypeSInt16, 15);
+  model.ps[2][0]  = scale;
+  model.gpr[9]    = (uintptr_t) in - 8;
+  model.gpr[10]   = (uintptr_t) out - 4;
+
+  for (UInt32 pair = 0; pair < pairs; pair++) {
+    for (UInt32 i = 0; i < (sizeof (loop) / sizeof (loop[0])); i++) {
+      if (!runInstruction(&model, loop[i])) {
+        return false;
+      }
+    }
+  }
+
+  //
+  // The loop must leave each pointer on the last pair it touched.
+  //
+  return (model.gpr[9] == ((uintptr_t) in + ((pairs - 1) * 8))) && (model.gpr[10] == ((uintptr_t) out + ((pairs - 1) * 4)));
+}
+
+//
+// Clips samples both ways and compares every output.
+//
+static void checkClip(const float *in, UInt32 count, float scale, UInt32 *mismatches) {
+  SInt16 expected[kTestMaxPairs * 2];
+  SInt16 actual[kTestMaxPairs * 2];
+
+  convertFloatToSInt16Reference(in, expected, count, scale);
+  TEST_CHECK(runClipLoop(in, actual, count / 2, scale));
+  for (UInt32 i = 0; i < count; i++) {
+    if (expected[i] != actual[i]) {
+      if (*mismatches == 0) {
+        printf("  %a * %a: reference %d, paired-single %d\n", in[i], scale, expected[i], actual[i]);
+      }
+      (*mismatches)++;
+    }
+  }
+}
+
+int main(void) {
+  float   edges[] = {
+    0.0f, -0.0f, 1.0f, -1.0f, 0.5f, -0.5f, 2.0f, -2.0f, 1e-45f, -1e-45f, 1e-38f, -1e-38f, 1e30f, -1e30f,
+    32767.0f / 32768.0f, -32767.0f / 32768.0f, nextafterf(32767.0f / 32768.0f, 2.0f), nextafterf(-1.0f, -2.0f),
+    nextafterf(1.0f, 0.0f), nextafterf(-1.0f, 0.0f), 1.0f / 32768.0f, -1.0f / 32768.0f, 0.99999f, -0.99999f,
+    0.75f / 32768.0f, -0.75f / 32768.0f, 1.5f / 32768.0f, -1.5f / 32768.0f, INFINITY, -INFINITY
+  };
+  float   scales[] = { 1.0f, 0.0f, 0.5f, 0.70710677f, 0.001f, 1e-30f, 4.0f };
+  float   in[kTestMaxPairs * 2];
+  UInt32  edgeCount;
+  UInt32  mismatches;
+  UInt32  seed;
+  UInt32  bits;
+  float   scale;
+
+  //
+  // The encodings must decode as the intended instructions.
+  //
+  TEST_CHECK(((UInt32) kWiiPSClipLoad >> 26) == 57);
+  TEST_CHECK(((UInt32) kWiiPSClipStore >> 26) == 61);
+  TEST_CHECK(kWiiPSClipScale == 0x10000098);
+  TEST_CHECK(getDisplacement(kWiiPSClipLoad) == 8);
+  TEST_CHECK(getDisplacement(kWiiPSClipStore) == 4);
+  TEST_CHECK(WiiPSGQRValue(kWiiPSGQRTypeSInt16, 15) == 0x0F070F07);
+
+  mismatches = 0;
+  edgeCount  = sizeof (edges) / sizeof (edges[0]);
+  for (UInt32 s = 0; s < (sizeof (scales) / sizeof (scales[0])); s++) {
+    for (UInt32 i = 0; i < edgeCount; i++) {
+      for (UInt32 j = 0; j < edgeCount; j++) {
+        in[0] = edges[i];
+        in[1] = edges[j];
+        checkClip(in, 2, scales[s], &mismatches);
+      }
+    }
+  }
+
+  //
+  // Random samples around full scale, and random bit patterns other than NaN.
+  //
+  seed = 0x50534C;
+  for (UInt32 round = 0; round < kTestRandomCount; round++) {
+    for (UInt32 i = 0; i < (kTestMaxPairs * 2); i++) {
+      if ((round % 2) == 0) {
+        in[i] = ((float) (SInt32) testRandom(&seed) / 2147483648.0f) * 1.25f;
+      } else {
+        do {
+          bits = testRandom(&seed);
+          memcpy(&in[i], &bits, sizeof (in[i]));
+        } while (isnan(in[i]));
+      }
+    }
+    scale = (float) (testRandom(&seed) % 65536) / 65535.0f;
+    checkClip(in, kTestMaxPairs * 2, scale, &mismatches);
+  }
+
+  TEST_CHECK(mismatches == 0);
+  printf("paired_single: %u random buffers of %u samples, %u mismatches\n", kTestRandomCount, kTestMaxPairs * 2, mismatches);
+  return testFinish("paired_single");
+}